@@ -7,6 +7,68 @@ class BmwBleUuids {
   static const String status = '1a2b0003-5e6f-4a5b-8c9d-0e1f2a3b4c5d';
   static const String nowPlaying = '1a2b0004-5e6f-4a5b-8c9d-0e1f2a3b4c5d';
   static const String clusterText = '1a2b0005-5e6f-4a5b-8c9d-0e1f2a3b4c5d';
+  static const String telemetry = '1a2b0006-5e6f-4a5b-8c9d-0e1f2a3b4c5d';
+  static const String command = '1a2b0007-5e6f-4a5b-8c9d-0e1f2a3b4c5d';
+  static const String beaconKey = '1a2b0008-5e6f-4a5b-8c9d-0e1f2a3b4c5d';
+  static const String bulk = '1a2b0009-5e6f-4a5b-8c9d-0e1f2a3b4c5d';
+}
+
+/// History download (see BleBulkTransfer.h): L2CAP CoC on [psm], GATT fallback on BmwBleUuids.bulk.
+class BmwBulk {
+  BmwBulk._();
+
+  static const int psm = 0x0085;
+  static const int opList = 0x01;
+  static const int opRead = 0x02;
+  static const int opAck = 0x03;
+  static const int opCancel = 0x04;
+  static const int opSources = 0x81;
+  static const int opData = 0x82;
+  static const int opEnd = 0x83;
+  static const int opError = 0x84;
+  static const int srcTrip = 0x01;
+  static const int srcIbus = 0x02;
+  static const int srcBattery = 0x03;
+  static const int srcFile = 0x10;
+  static const int window = 8192;
+}
+
+/// Now Playing batch write: [marker][type][len][value]..., durations in ms (uint32 LE).
+class BmwNowPlayingBatch {
+  BmwNowPlayingBatch._();
+
+  static const int marker = 0x01;
+  static const int track = 0x01;
+  static const int artist = 0x02;
+  static const int album = 0x03;
+  static const int duration = 0x04;
+  static const int position = 0x05;
+}
+
+/// Status beacon in advertising manufacturer data (see BleStatusBeacon.h on the ESP32 side).
+class BmwBeacon {
+  BmwBeacon._();
+
+  static const int companyId = 0xFFFF;
+  static const int version = 1;
+  static const int advLen = 8;
+  static const int scanLen = 13;
+}
+
+/// Acknowledged command notifications: [reqId][status][depth][detail].
+class BmwCommandStatus {
+  BmwCommandStatus._();
+
+  static const int ack = 1;
+  static const int done = 2;
+  static const int fail = 3;
+
+  static const int errQueueFull = 1;
+  static const int errUnknownCmd = 2;
+  static const int errNotSynced = 3;
+  static const int errTxFailed = 4;
+  static const int errBadFrame = 5;
+  static const int errTimeout = 6;
 }
 
 /// Control commands (one byte write to control characteristic).
@@ -57,4 +119,20 @@ class BmwControlCmd {
   static const int mirrorFoldOff = 0x97;
   /// Next cluster text write is stored as startup greeting on ESP32.
   static const int startupGreeting = 0x98;
+  /// Phone is held 1 m from the board: store its RSSI calibration for proximity unlock/lock.
+  static const int proximityCalibrate = 0x99;
+  /// Start a timed I-Bus sequence: param [id] (BmwSequence), acknowledged characteristic only.
+  static const int sequenceStart = 0xA0;
+  static const int sequenceStop = 0xA1;
+}
+
+/// Sequence ids for [BmwControlCmd.sequenceStart]; from [file] on, scripts in LittleFS /seq/<id hex>.bin.
+class BmwSequence {
+  BmwSequence._();
+  static const int lightShow = 1;
+  static const int wigWag = 2;
+  static const int panic = 3;
+  static const int goodbye = 4;
+  static const int comfortClose = 5;
+  static const int file = 0x10;
 }
@@ -274,6 +274,42 @@ class BmwBleNotifier extends StateNotifier<BmwBleState> {
     }
   }
 
+  /// One write with everything (batch format, see BleMediaWrite.h): the board debounces and sends
+  /// a single cluster/MID update per song. Text fields are cut to 63 UTF-8 bytes.
+  Future<void> sendNowPlayingBatch({
+    required String track,
+    String artist = '',
+    String album = '',
+    int? durationMs,
+    int? positionMs,
+  }) async {
+    final c = _nowPlayingChar;
+    if (c == null || !state.isConnected) return;
+    List<int> text(String s) {
+      var b = utf8.encode(s);
+      if (b.length <= 63) return b;
+      var n = 63;
+      while (n > 0 && (b[n] & 0xC0) == 0x80) {
+        n--;
+      }
+      return b.sublist(0, n);
+    }
+
+    List<int> u32(int v) => [v & 0xFF, (v >> 8) & 0xFF, (v >> 16) & 0xFF, (v >> 24) & 0xFF];
+    final bytes = <int>[BmwNowPlayingBatch.marker];
+    void tlv(int type, List<int> value) => bytes..add(type)..add(value.length)..addAll(value);
+    tlv(BmwNowPlayingBatch.track, text(track));
+    tlv(BmwNowPlayingBatch.artist, text(artist));
+    if (album.isNotEmpty) tlv(BmwNowPlayingBatch.album, text(album));
+    if (durationMs != null) tlv(BmwNowPlayingBatch.duration, u32(durationMs));
+    if (positionMs != null) tlv(BmwNowPlayingBatch.position, u32(positionMs));
+    try {
+      await c.write(bytes, withoutResponse: false);
+    } catch (e) {
+      state = state.copyWith(error: e.toString());
+    }
+  }
+
   Future<void> sendNowPlaying(String track, String artist) async {
     final c = _nowPlayingChar;
     if (c == null || !state.isConnected) return;
@@ -0,0 +1,109 @@
+/*
+ * NOCTURNE_OS — fixed-capacity inline string for AppState text fields: never allocates, cuts at capacity
+ * on a UTF-8 boundary. Code handling several capacities takes FixedStringBase &.
+ */
+#ifndef NOCTURNE_FIXED_STRING_H
+#define NOCTURNE_FIXED_STRING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+class FixedStringBase {
+ public:
+  const char *c_str() const { return buf_; }
+  size_t length() const { return len_; }
+  size_t capacity() const { return cap_; }
+  bool empty() const { return len_ == 0; }
+  /** The last assignment did not fit and was cut. */
+  bool truncated() const { return truncated_; }
+
+  /** Copy at most capacity() bytes of s[0, n), cut back to a UTF-8 boundary. True if the content changed. */
+  bool assign(const char *s, size_t n) {
+    if (!s) {
+      s = "";
+      n = 0;
+    }
+    truncated_ = n > cap_;
+    if (truncated_)
+      n = utf8Fit(s, n, cap_);
+    if (equals(s, n))
+      return false;
+    memmove(buf_, s, n);
+    buf_[n] = '\0';
+    len_ = (uint16_t)n;
+    return true;
+  }
+  bool assign(const char *s) { return assign(s, s ? strlen(s) : 0); }
+  bool assign(const FixedStringBase &o) { return assign(o.buf_, o.len_); }
+  void clear() { assign("", 0); }
+
+  FixedStringBase &operator=(const char *s) {
+    assign(s);
+    return *this;
+  }
+
+  bool equals(const char *s, size_t n) const { return n == len_ && (n == 0 || memcmp(buf_, s, n) == 0); }
+  bool operator==(const char *s) const { return s && equals(s, strlen(s)); }
+  bool operator!=(const char *s) const { return !(*this == s); }
+  bool operator==(const FixedStringBase &o) const { return equals(o.buf_, o.len_); }
+  bool operator!=(const FixedStringBase &o) const { return !equals(o.buf_, o.len_); }
+
+  /** ASCII letters to upper case in place; UTF-8 sequences are left as they are. */
+  void toUpperCase() {
+    for (size_t i = 0; i < len_; i++)
+      if (buf_[i] >= 'a' && buf_[i] <= 'z')
+        buf_[i] = (char)(buf_[i] - 'a' + 'A');
+  }
+
+  /** Longest prefix of s[0, n) within max bytes that does not end inside a UTF-8 sequence. */
+  static size_t utf8Fit(const char *s, size_t n, size_t max) {
+    if (n <= max)
+      return n;
+    n = max;
+    while (n > 0 && ((uint8_t)s[n] & 0xC0) == 0x80)
+      n--;
+    return n;
+  }
+
+ protected:
+  FixedStringBase(char *buf, size_t cap) : buf_(buf), cap_((uint16_t)cap) { buf_[0] = '\0'; }
+  FixedStringBase(const FixedStringBase &) = delete;
+  FixedStringBase &operator=(const FixedStringBase &o) {
+    assign(o);
+    return *this;
+  }
+
+ private:
+  char *buf_;
+  uint16_t cap_;
+  uint16_t len_ = 0;
+  bool truncated_ = false;
+};
+
+template <size_t N>
+class FixedString : public FixedStringBase {
+  static_assert(N > 0 && N < 0xFFFF, "FixedString capacity");
+
+ public:
+  FixedString() : FixedStringBase(storage_, N) {}
+  FixedString(const char *s) : FixedStringBase(storage_, N) { assign(s); }
+  FixedString(const FixedString &o) : FixedStringBase(storage_, N) { assign(o); }
+  FixedString &operator=(const FixedString &o) {
+    assign(o);
+    return *this;
+  }
+  FixedString &operator=(const FixedStringBase &o) {
+    assign(o);
+    return *this;
+  }
+  FixedString &operator=(const char *s) {
+    assign(s);
+    return *this;
+  }
+
+ private:
+  char storage_[N + 1];
+};
+
+#endif
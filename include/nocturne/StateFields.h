@@ -0,0 +1,87 @@
+/*
+ * NOCTURNE_OS — change bits over AppState: one bit per displayed field (arrays and related values share
+ * one). The monitor decoders report which bits a payload changed; RedrawGate maps each scene to the
+ * bits it shows and skips frames where none of them moved.
+ */
+#ifndef NOCTURNE_STATE_FIELDS_H
+#define NOCTURNE_STATE_FIELDS_H
+
+#include <cstdint>
+#include "nocturne/Types.h"
+
+enum StateField : uint8_t {
+  SF_CT, SF_GT, SF_CL, SF_GL, SF_CC, SF_PW, SF_GH, SF_GV, SF_GCLOCK, SF_VCLOCK, SF_GTDP,
+  SF_RU, SF_RA, SF_ND, SF_NU, SF_PG, SF_CF, SF_S1, SF_S2, SF_GF,
+  SF_FANS,         /* fans[] */
+  SF_FAN_CONTROLS, /* fan_controls[] */
+  SF_HDD,          /* hdd[]: letter, used, total, temp */
+  SF_VU, SF_VT, SF_CH,
+  SF_MB_SYS, SF_MB_VSOC, SF_MB_VRM, SF_MB_CHIPSET,
+  SF_DR, SF_DW,
+  SF_WEATHER,     /* temp, description, code, weatherReceived */
+  SF_TOP_CPU,     /* cpuNames + cpuPercent */
+  SF_TOP_RAM,     /* ramNames + ramMb */
+  SF_ARTIST,
+  SF_TRACK,
+  SF_MEDIA_STATE, /* isPlaying, isIdle, mediaStatus */
+  SF_ALERT,       /* alertActive, alertTargetScene, alertMetric */
+  SF_BATTERY,     /* batteryPct, isCharging, batteryVoltage (header, BatteryManager) */
+  SF_COUNT
+};
+
+typedef uint64_t FieldMask;
+static_assert(SF_COUNT <= 64, "StateField bits must fit a FieldMask");
+
+inline FieldMask fieldBit(StateField f) { return (FieldMask)1 << f; }
+
+/** Bits of the HardwareData fields that differ between a and b. */
+inline FieldMask diffHardware(const HardwareData &a, const HardwareData &b) {
+  FieldMask m = 0;
+#define NOCT_SF_CMP(field, bit) \
+  if (a.field != b.field)       \
+  m |= fieldBit(bit)
+  NOCT_SF_CMP(ct, SF_CT);
+  NOCT_SF_CMP(gt, SF_GT);
+  NOCT_SF_CMP(cl, SF_CL);
+  NOCT_SF_CMP(gl, SF_GL);
+  NOCT_SF_CMP(cc, SF_CC);
+  NOCT_SF_CMP(pw, SF_PW);
+  NOCT_SF_CMP(gh, SF_GH);
+  NOCT_SF_CMP(gv, SF_GV);
+  NOCT_SF_CMP(gclock, SF_GCLOCK);
+  NOCT_SF_CMP(vclock, SF_VCLOCK);
+  NOCT_SF_CMP(gtdp, SF_GTDP);
+  NOCT_SF_CMP(ru, SF_RU);
+  NOCT_SF_CMP(ra, SF_RA);
+  NOCT_SF_CMP(nd, SF_ND);
+  NOCT_SF_CMP(nu, SF_NU);
+  NOCT_SF_CMP(pg, SF_PG);
+  NOCT_SF_CMP(cf, SF_CF);
+  NOCT_SF_CMP(s1, SF_S1);
+  NOCT_SF_CMP(s2, SF_S2);
+  NOCT_SF_CMP(gf, SF_GF);
+  NOCT_SF_CMP(vu, SF_VU);
+  NOCT_SF_CMP(vt, SF_VT);
+  NOCT_SF_CMP(ch, SF_CH);
+  NOCT_SF_CMP(mb_sys, SF_MB_SYS);
+  NOCT_SF_CMP(mb_vsoc, SF_MB_VSOC);
+  NOCT_SF_CMP(mb_vrm, SF_MB_VRM);
+  NOCT_SF_CMP(mb_chipset, SF_MB_CHIPSET);
+  NOCT_SF_CMP(dr, SF_DR);
+  NOCT_SF_CMP(dw, SF_DW);
+#undef NOCT_SF_CMP
+  for (int i = 0; i < NOCT_FAN_COUNT; i++) {
+    if (a.fans[i] != b.fans[i])
+      m |= fieldBit(SF_FANS);
+    if (a.fan_controls[i] != b.fan_controls[i])
+      m |= fieldBit(SF_FAN_CONTROLS);
+  }
+  for (int i = 0; i < NOCT_HDD_COUNT; i++) {
+    const HddEntry &x = a.hdd[i], &y = b.hdd[i];
+    if (x.name[0] != y.name[0] || x.used_gb != y.used_gb || x.total_gb != y.total_gb || x.temp != y.temp)
+      m |= fieldBit(SF_HDD);
+  }
+  return m;
+}
+
+#endif
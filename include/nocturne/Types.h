@@ -1,14 +1,21 @@
 /*
  * NOCTURNE_OS — Shared types: HardwareData (ct, gt, cl, gl, ru, ra, …),
  * WeatherData, MediaData, AppState. Keys match monitor JSON (2-letter).
+ * Text fields are FixedString (inline, no heap): payloads rewrite them many
+ * times a second.
  */
 #ifndef NOCTURNE_TYPES_H
 #define NOCTURNE_TYPES_H
 
-#include <Arduino.h>
+#include "nocturne/FixedString.h"
 
 #define NOCT_HDD_COUNT 4
 #define NOCT_FAN_COUNT 4
+#define NOCT_PROC_NAME_MAX 23 /* bytes: process names (top CPU / RAM) */
+#define NOCT_TEXT_MAX 63      /* bytes: artist, track, weather description */
+
+typedef FixedString<NOCT_PROC_NAME_MAX> ProcName;
+typedef FixedString<NOCT_TEXT_MAX> MetaText;
 
 struct HddEntry {
   char name[2] = {'C', '\0'}; /* Drive letter: C, D, E, F */
@@ -37,23 +44,23 @@ struct HardwareData {
 
 struct WeatherData {
   int temp = 0;
-  String desc = "";
+  MetaText desc;
   int wmoCode = 0;
 };
 
 struct ProcessData {
-  String cpuNames[3] = {"", "", ""};
+  ProcName cpuNames[3];
   int cpuPercent[3] = {0};
-  String ramNames[2] = {"", ""};
+  ProcName ramNames[2];
   int ramMb[2] = {0};
 };
 
 struct MediaData {
-  String artist = "";
-  String track = "";
+  MetaText artist;
+  MetaText track;
   bool isPlaying = false;
   bool isIdle = false;
-  String mediaStatus = "PAUSED"; // "PLAYING" | "PAUSED"
+  FixedString<7> mediaStatus = "PAUSED"; // "PLAYING" | "PAUSED"
 };
 
 struct Settings {
@@ -115,11 +115,35 @@
 
 /* ── Network / TCP (PC monitoring) ─────────────────────────────────────── */
 #define NOCT_TCP_LINE_MAX 4096
+#define NOCT_TCP_RX_BUDGET_US 1500 /* socket reads per loop iteration */
+#ifndef NOCT_MONITOR_BINARY
+#define NOCT_MONITOR_BINARY 1 /* offer the binary protocol in HELO (JSON if the server declines) */
+#endif
+#ifndef NOCT_MONITOR_SUBSCRIBE
+#define NOCT_MONITOR_SUBSCRIBE 1 /* with screen:N, ask for only that scene's fields at per-field rates */
+#endif
+#ifndef NOCT_MONITOR_UDP
+#define NOCT_MONITOR_UDP 1 /* heartbeat to the server's UDP port; TCP only while no datagrams arrive */
+#endif
 #define NOCT_TCP_CONNECT_TIMEOUT_MS 5000
 #define NOCT_TCP_RECONNECT_INTERVAL_MS 2000
 #define NOCT_SIGNAL_TIMEOUT_MS 5000
 #define NOCT_SIGNAL_GRACE_MS 8000
 #define NOCT_WIFI_RETRY_INTERVAL_MS 30000
+#ifndef NOCT_NET_TASK
+#define NOCT_NET_TASK 1 /* Wi-Fi, connect, reads and decoding in their own task; 0 = inline in loop() */
+#endif
+#define NOCT_NET_TASK_STACK 6144
+#define NOCT_NET_TASK_PRIO 1 /* as loop(); blocks in select() between packets */
+#define NOCT_NET_TASK_CORE 0 /* with the Wi-Fi / lwIP tasks; loop() runs on core 1 */
+#define NOCT_NET_WAIT_MS 10  /* longest sleep between steps (screen changes reach the server within it) */
+#ifndef NOCT_MAX_HOSTS
+#define NOCT_MAX_HOSTS 4 /* servers in PC_HOSTS monitored at once; each costs one MonitorLink (~14 KB) */
+#endif
+#if NOCT_MAX_HOSTS < 1 || NOCT_MAX_HOSTS > 8
+#error "NOCT_MAX_HOSTS must be 1..8"
+#endif
+#define NOCT_HOSTS_PAGE_MS 3000 /* overview scene: host rows page every 3 s when they do not fit */
 
 /* ── Timing ────────────────────────────────────────────────────────────── */
 #define NOCT_SPLASH_MS 2500
@@ -132,6 +156,16 @@
 #define NOCT_GLITCH_INTERVAL_MS 10000
 #define NOCT_GLITCH_DURATION_MS 100
 #define NOCT_REDRAW_INTERVAL_MS 17
+#ifndef NOCT_HEAP_STATS
+#define NOCT_HEAP_STATS 0 /* 1 = [HEAP] report on Serial; needs the malloc wrap (env pc_companion_heapstats) */
+#endif
+#define NOCT_HEAP_STATS_INTERVAL_MS 5000
+#ifndef NOCT_DRAW_STATS
+#define NOCT_DRAW_STATS 0 /* 1 = [DRAW] frames drawn / skipped by RedrawGate per minute on Serial */
+#endif
+#ifndef NOCT_LINK_MARKS
+#define NOCT_LINK_MARKS 0 /* 1 = @ack / @frm markers on Serial for tools/monitor_server --serial (LinkMarks.h) */
+#endif
 #define NOCT_GRAPH_SAMPLES 32
 #define NOCT_GRAPH_HEIGHT 11
 
@@ -180,6 +214,8 @@
 #define NOCT_SCENE_MOTHERBOARD 7
 #define NOCT_SCENE_WEATHER 8
 #define NOCT_TOTAL_SCENES 9
+/* Overview across hosts, after the per-host scenes; in the carousel only with two or more hosts. */
+#define NOCT_SCENE_HOSTS NOCT_TOTAL_SCENES
 
 /* alert_metric codes (match monitor.py) */
 #define NOCT_ALERT_CT 0
@@ -198,12 +234,32 @@
 #define NOCT_BMW_DEBUG 1
 #define NOCT_BMW_DEMO_MODE 0
 #define NOCT_BMW_DEMO_INTERVAL_MS 4000
+/* RSSI proximity: unlock + welcome lights when the phone reaches the car, lock when walking away
+ * (instead of unlock on connect / lock on disconnect). 0 = connect/disconnect only. */
+#define NOCT_BLE_PROXIMITY_ENABLED 1
+/* Vehicle status (locks, doors, ignition, temps) in advertising manufacturer data, obfuscated with a
+ * key the app reads once over an encrypted link. 0 = advertise service UUIDs only. */
+#define NOCT_BLE_BEACON_ENABLED 1
 #define NOCT_DEMO_BOOT_HOLD_MS 2500
 
 /* ── OBD-II / ELM327 ──────────────────────────────────────────────────── */
 #define NOCT_OBD_ENABLED 0
 #define NOCT_OBD_TX_PIN 9
 #define NOCT_OBD_RX_PIN 10
+/* Adapter link: UART on the pins above, or a Wi-Fi ELM327 over TCP (builds with Wi-Fi, i.e.
+ * NOCT_FEATURE_MONITORING; the device must be on the adapter's network). */
+#define NOCT_OBD_LINK_UART 0
+#define NOCT_OBD_LINK_TCP 1
+#define NOCT_OBD_LINK NOCT_OBD_LINK_UART
+#define NOCT_OBD_TCP_HOST "192.168.0.10"
+#define NOCT_OBD_TCP_PORT 35000
+/* Shift light (LED + IKE "SHIFT!"): fires when RPM predicted NOCT_SHIFT_LEAD_MS ahead reaches the
+ * threshold of the current gear (gear from km/h per 1000 rpm * 10; unknown gear -> NOCT_SHIFT_RPM). */
+#define NOCT_SHIFT_RPM 5500
+#define NOCT_SHIFT_RPM_GEARS {5300, 5500, 5700, 5800, 5800}  /* 1st..5th */
+#define NOCT_SHIFT_GEAR_RATIOS {92, 155, 236, 321, 391}      /* E39 5-speed, 3.15 final drive */
+#define NOCT_SHIFT_HYSTERESIS_RPM 300
+#define NOCT_SHIFT_LEAD_MS 40                                /* IKE text frame on the bus */
 
 /* ── USB CDC ───────────────────────────────────────────────────────────── */
 #define NOCT_USB_CDC_ENABLED 0
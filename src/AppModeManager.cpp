@@ -107,9 +107,21 @@ void AppModeManager::cleanupMode(AppMode mode)
 
 void AppModeManager::manageWiFiState(AppMode mode)
 {
+#if NOCT_OBD_ENABLED && NOCT_OBD_LINK == NOCT_OBD_LINK_TCP && NOCT_FEATURE_MONITORING
+  /* OBD over Wi-Fi: the network task keeps re-joining the station in BMW mode (monitor links stay closed). */
+  net_.setWantWifi(mode == MODE_BMW_ASSISTANT);
+#endif
   switch (mode)
   {
+#if NOCT_OBD_ENABLED && NOCT_OBD_LINK == NOCT_OBD_LINK_TCP && NOCT_FEATURE_MONITORING
   case MODE_BMW_ASSISTANT:
+    if (WiFi.getMode() != WIFI_STA)
+      WiFi.mode(WIFI_STA);
+    net_.setSuspend(false);
+    break;
+#else
+  case MODE_BMW_ASSISTANT:
+#endif
   case MODE_CHARGE_ONLY:
     if (WiFi.getMode() != WIFI_OFF)
     {
@@ -11,24 +11,23 @@
 #include "freertos/task.h"
 #include <NimBLEDevice.h>
 
-#if NOCT_FEATURE_MONITORING
-#include <ArduinoJson.h>
-#endif
-
 #include "AppModeManager.h"
 #include "InputHandler.h"
 #include "MenuHandler.h"
 #include "modules/display/BootAnim.h"
 #include "modules/display/DisplayEngine.h"
 #include "modules/display/DisplayManager.h"
+#include "modules/display/RedrawGate.h"
 #include "modules/display/SceneManager.h"
 #include "modules/car/BmwManager.h"
 #include "modules/car/ObdClient.h"
 #include "modules/system/BatteryManager.h"
+#include "modules/system/HeapStats.h"
 #include "nocturne/Types.h"
 #include "nocturne/config.h"
 
 #if NOCT_FEATURE_MONITORING
+#include "modules/network/LinkMarks.h"
 #include "modules/network/NetManager.h"
 #include "secrets.h"
 #endif
@@ -51,6 +50,9 @@ AppState state;
 SceneManager sceneManager(display, state);
 DisplayManager displayManager(display, bmwManager);
 BatteryManager batteryManager;
+#if NOCT_HEAP_STATS
+HeapStats heapStats;
+#endif
 
 #if NOCT_FEATURE_MONITORING
 NetManager netManager;
@@ -117,6 +119,10 @@ static bool needRedraw = true;
 AppMode currentMode = MODE_BMW_ASSISTANT;
 
 #if NOCT_FEATURE_MONITORING
+RedrawGate redrawGate;
+#if NOCT_LINK_MARKS
+static LinkMarks linkMarks;
+#endif
 int currentScene = 0;
 int previousScene = 0;
 unsigned long transitionStart = 0;
@@ -129,11 +135,64 @@ bool blinkState = false;
 int alertBlinkCounter = 0;
 bool lastAlertActive = false;
 unsigned long lastBlink = 0;
+static bool hostGraphsStale = false;
+
+/* The display graphs show the selected host: on a switch, its history (MonitorHosts keeps one per host). */
+static void loadHostGraphs()
+{
+  const HostSlot &h = netManager.hosts().host(netManager.selectedHost());
+  display.cpuGraph.clear();
+  display.gpuGraph.clear();
+  display.netDownGraph.clear();
+  display.netUpGraph.clear();
+  for (int age = h.count - 1; age >= 0; age--)
+  {
+    display.cpuGraph.push((float)h.cpuAt(age));
+    display.gpuGraph.push((float)h.gpuAt(age));
+    display.netDownGraph.push((float)h.netDownAt(age));
+    display.netUpGraph.push((float)h.netUpAt(age));
+  }
+}
+
+static void selectHost(int host, unsigned long now)
+{
+  if (!netManager.selectHost(host))
+    return;
+  hostGraphsStale = true;
+#if NOCT_LINK_MARKS
+  linkMarks.reset();
+#endif
+  snprintf(toastMsg, sizeof(toastMsg), "%s", netManager.hostName(host));
+  toastUntil = now + 800;
+}
+
+/* Carousel and button: past the last scene the next host's scenes begin (host rotation). */
+static int nextScene(int scene, unsigned long now)
+{
+  int next = (scene + 1) % sceneManager.totalScenes();
+  if (next == 0 && netManager.hostCount() > 1)
+    selectHost(netManager.hosts().next(), now);
+  return next;
+}
 #endif
 
 #if NOCT_FEATURE_FORZA
 static unsigned long forzaSplashUntil = 0;
 #define FORZA_SPLASH_MS 3000
+
+/* Forza Data Out into the telemetry arbiter: one sample per new packet, stamped with its arrival. Once
+ * the game mode is left nothing is published and the samples go stale within half a second. */
+static void publishForzaTelemetry()
+{
+  static unsigned long lastPacketMs = 0;
+  const ForzaState &fs = forzaManager.getState();
+  if (!fs.connected || fs.lastPacketMs == lastPacketMs)
+    return;
+  lastPacketMs = fs.lastPacketMs;
+  bmwManager.publishTelemetry(TELEM_SRC_FORZA, TELEM_SIG_RPM, (int32_t)fs.currentRpm, (uint32_t)fs.lastPacketMs);
+  bmwManager.publishTelemetry(TELEM_SRC_FORZA, TELEM_SIG_SPEED, (int32_t)(fs.speedMs * 3.6f),
+                              (uint32_t)fs.lastPacketMs);
+}
 #endif
 
 #if NOCT_FEATURE_HACKER
@@ -352,7 +411,12 @@ void setup()
 
 #if NOCT_FEATURE_MONITORING
   netManager.begin(WIFI_SSID, WIFI_PASS);
+#ifdef PC_HOSTS
+  netManager.setServers(PC_HOSTS);
+#else
   netManager.setServer(PC_IP, TCP_PORT);
+#endif
+  sceneManager.setHosts(&netManager.hosts());
   currentMode = MODE_NORMAL;
 #else
   WiFi.disconnect(true);
@@ -360,9 +424,17 @@ void setup()
 #endif
 
 #if NOCT_OBD_ENABLED
+#if NOCT_OBD_LINK == NOCT_OBD_LINK_TCP && NOCT_FEATURE_MONITORING
+  obdClient.beginTcp(NOCT_OBD_TCP_HOST, NOCT_OBD_TCP_PORT);
+#else
   obdClient.begin(NOCT_OBD_TX_PIN, NOCT_OBD_RX_PIN);
+#endif
   obdClient.setDataCallback(
       [](bool c, int r, int co, int o) { bmwManager.setObdData(c, r, co, o); });
+  obdClient.setRpmSampleCallback(
+      [](int r, int kmh, uint32_t at) { bmwManager.addObdRpmSample(r, kmh, at); });
+  obdClient.setSampleCallback(
+      [](uint8_t pid, int32_t v, uint32_t at) { bmwManager.addObdSample(pid, v, at); });
 #endif
 
   batteryManager.update(state);
@@ -621,51 +693,44 @@ void loop()
 
 #if NOCT_FEATURE_MONITORING
   bool pcMonitoringActive = (currentMode == MODE_NORMAL && splashDone && !quickMenuOpen);
-  if (pcMonitoringActive)
-    netManager.tick(now);
-  else if (netManager.isTcpConnected())
-    netManager.disconnectTcp();
+  /* Connecting, reading and decoding run in the network task; receive() only takes its newest snapshot. */
+  netManager.setActive(pcMonitoringActive);
 
-  if (netManager.isTcpConnected())
+  if (netManager.receive(now, &state))
   {
-    while (netManager.available())
+    /* Drawn on the next GUI tick if the visible scene shows a changed field. */
+    redrawGate.markChanged(netManager.takeChanges());
+#if NOCT_LINK_MARKS
+    char mark[LinkMarks::kLineMax];
+    if (linkMarks.ack(netManager.snapshot(), mark, sizeof(mark))) Serial.print(mark);
+#endif
+    HardwareData &hw = state.hw;
+    display.netDownGraph.setMax(2048);
+    display.netUpGraph.setMax(2048);
+    if (hostGraphsStale)
     {
-      char c = (char)netManager.read();
-      if (c == '\n')
-      {
-        char *buf = netManager.getLineBuffer();
-        size_t bufLen = netManager.getLineBufferLen();
-        if (bufLen > 0 && bufLen <= NOCT_TCP_LINE_MAX)
-        {
-          JsonDocument doc;
-          DeserializationError err = deserializeJson(doc, buf, bufLen);
-          if (!err)
-          {
-            netManager.markDataReceived(now);
-            if (netManager.parsePayload(buf, bufLen, &state))
-            {
-              needRedraw = true;
-              HardwareData &hw = state.hw;
-              display.cpuGraph.push((float)hw.cl);
-              display.gpuGraph.push((float)hw.gl);
-              display.netDownGraph.setMax(2048);
-              display.netDownGraph.push((float)hw.nd);
-              display.netUpGraph.setMax(2048);
-              display.netUpGraph.push((float)hw.nu);
-            }
-          }
-        }
-        netManager.clearLineBuffer();
-      }
-      else
-        netManager.appendLineBuffer(c);
+      loadHostGraphs();
+      hostGraphsStale = false;
+    }
+    else
+    {
+      display.cpuGraph.push((float)hw.cl);
+      display.gpuGraph.push((float)hw.gl);
+      display.netDownGraph.push((float)hw.nd);
+      display.netUpGraph.push((float)hw.nu);
     }
   }
+  /* Other hosts only change the overview. */
+  if (netManager.takeHostsChanged() && currentScene == NOCT_SCENE_HOSTS)
+    redrawGate.invalidate();
 #endif
 
 #if NOCT_FEATURE_FORZA
   if (currentMode == MODE_GAME_FORZA)
+  {
     forzaManager.tick();
+    publishForzaTelemetry();
+  }
 #endif
 
   // ── Input ───────────────────────────────────────────────────────────
@@ -692,11 +757,27 @@ void loop()
   // ── Battery ─────────────────────────────────────────────────────────
   if (batTimer.check(now))
   {
+#if NOCT_FEATURE_MONITORING
+    const int prevPct = state.batteryPct;
+    const bool prevCharging = state.isCharging;
+    const float prevVoltage = state.batteryVoltage;
+#endif
     unsigned long nextInterval = batteryManager.update(state);
+#if NOCT_FEATURE_MONITORING
+    if (state.batteryPct != prevPct || state.isCharging != prevCharging ||
+        state.batteryVoltage != prevVoltage)
+      redrawGate.markChanged(fieldBit(SF_BATTERY));
+#endif
     batTimer.intervalMs = nextInterval;
     batTimer.lastMs = now;
+    /* No cell sensed (< 1 V) = running from USB / car supply. */
+    bmwManager.setBatteryState(state.batteryPct, state.isCharging || state.batteryVoltage < 1.0f);
   }
 
+#if NOCT_HEAP_STATS
+  heapStats.tick(now);
+#endif
+
   // ── LED ─────────────────────────────────────────────────────────────
   pinMode(NOCT_LED_ALERT_PIN, OUTPUT);
   if (predatorMode)
@@ -726,7 +807,7 @@ void loop()
 #endif
   else if (currentMode == MODE_BMW_ASSISTANT)
   {
-    if (bmwManager.isObdConnected() && bmwManager.getObdRpm() >= 5500)
+    if (bmwManager.shiftCueActive())
     {
       bool flash = (now / 80) % 2 == 0;
       if (settings.ledEnabled) digitalWrite(NOCT_LED_ALERT_PIN, flash ? HIGH : LOW);
@@ -749,6 +830,10 @@ void loop()
 
 #if NOCT_FEATURE_MONITORING
   // ── Alert & carousel (monitoring) ───────────────────────────────────
+  /* An alert on another host brings that host on screen; its target scene follows with its data. */
+  int alertHost = netManager.hosts().alerting();
+  if (alertHost >= 0 && !state.alertActive)
+    selectHost(alertHost, now);
   if (state.alertActive)
   {
     int total = sceneManager.totalScenes();
@@ -763,20 +848,15 @@ void loop()
     {
       needRedraw = true;
       previousScene = currentScene;
-      currentScene = (currentScene + 1) % sceneManager.totalScenes();
+      currentScene = nextScene(currentScene, now);
       if (previousScene != currentScene)
       { inTransition = true; transitionStart = now; }
       lastCarousel = now;
     }
   }
-  if (pcMonitoringActive && netManager.isTcpConnected() &&
-      netManager.getLastSentScreen() != currentScene)
-  {
-    char screenMsg[16];
-    snprintf(screenMsg, sizeof(screenMsg), "screen:%d\n", currentScene);
-    netManager.print(screenMsg);
-    netManager.setLastSentScreen(currentScene);
-  }
+  /* The next carousel scene is prefetched so it has data the moment it shows. */
+  if (pcMonitoringActive)
+    netManager.setScreen(currentScene, (currentScene + 1) % sceneManager.totalScenes());
   if (now - lastFanAnim >= 50)
   { fanAnimFrame = (fanAnimFrame + 1) % 12; lastFanAnim = now; }
 #endif
@@ -886,7 +966,7 @@ void loop()
       if (event == EV_SHORT && !state.alertActive)
       {
         previousScene = currentScene;
-        currentScene = (currentScene + 1) % sceneManager.totalScenes();
+        currentScene = nextScene(currentScene, now);
         if (previousScene != currentScene)
         { inTransition = true; transitionStart = now; }
         lastCarousel = now;
@@ -973,7 +1053,13 @@ void loop()
     if (now - lastYield > 10) { yield(); lastYield = now; }
     return;
   }
+#if NOCT_FEATURE_MONITORING
+  if (needRedraw) redrawGate.invalidate();
+#endif
   needRedraw = false;
+#if NOCT_FEATURE_MONITORING && NOCT_LINK_MARKS
+  const unsigned long frameStartUs = micros();
+#endif
 
   if (lastInputTime == 0) lastInputTime = now;
   if (!quickMenuOpen && settings.displayTimeoutSec > 0 &&
@@ -983,6 +1069,10 @@ void loop()
     display.u8g2().setContrast(settings.displayContrast);
 
   bool displayManagerSent = false;
+  bool frameSkipped = false; /* data scene unchanged: panel keeps the last frame */
+#if NOCT_FEATURE_MONITORING
+  bool gatedFrame = false;
+#endif
   if (!(currentMode == MODE_BMW_ASSISTANT && !quickMenuOpen))
     display.clearBuffer();
 
@@ -1007,6 +1097,9 @@ void loop()
 
     case MODE_BMW_ASSISTANT:
 #if NOCT_OBD_ENABLED
+#if NOCT_OBD_LINK == NOCT_OBD_LINK_TCP && NOCT_FEATURE_MONITORING
+      obdClient.setNetworkUp(WiFi.status() == WL_CONNECTED);
+#endif
       if (obdClient.isEnabled()) obdClient.tick();
 #endif
       displayManagerSent = displayManager.update(now);
@@ -1016,10 +1109,12 @@ void loop()
     case MODE_NORMAL:
     {
       bool signalLost = netManager.isSignalLost(now);
-      if (signalLost && netManager.isTcpConnected() && netManager.hasReceivedData())
-        netManager.disconnectTcp();
+      if (signalLost && netManager.isLinkUp() && netManager.hasReceivedData())
+        netManager.disconnect();
+      /* The overview shows every host, whatever the selected one's link does. */
+      const bool overview = currentScene == NOCT_SCENE_HOSTS;
 
-      bool idleState = !netManager.isWifiConnected() || !netManager.isTcpConnected();
+      bool idleState = !netManager.isWifiConnected() || (!overview && !netManager.isLinkUp());
       if (!idleState) idleStateEnteredMs = 0;
       if (idleState && idleStateEnteredMs == 0) idleStateEnteredMs = now;
       bool showScreensaver = idleState && idleStateEnteredMs != 0 &&
@@ -1030,17 +1125,25 @@ void loop()
         if (showScreensaver) { sceneManager.drawIdleScreensaver(now); display.applyGlitch(); }
         else sceneManager.drawNoSignal(false, false, 0, blinkState);
       }
-      else if (!netManager.isTcpConnected())
+      else if (!overview && !netManager.isLinkUp())
       {
         if (showScreensaver) { sceneManager.drawIdleScreensaver(now); display.applyGlitch(); }
         else sceneManager.drawConnecting(netManager.rssi(), blinkState);
       }
-      else if (netManager.isSearchMode() || signalLost)
+      else if (!overview && (netManager.isSearchMode() || signalLost))
       {
         sceneManager.drawSearchMode((int)(now / 100) % 12);
       }
+      else if (!inTransition && !settings.glitchEnabled && !(toastUntil && now < toastUntil) &&
+               !redrawGate.shouldDraw(currentScene, sceneManager.animationPhase(currentScene, now)))
+      {
+        frameSkipped = true;
+        gatedFrame = true;
+      }
       else
       {
+        /* A toast frame is not what the scene alone would draw: the gate must repaint after it expires. */
+        gatedFrame = !inTransition && !(toastUntil && now < toastUntil);
         display.drawGlobalHeader(sceneManager.getSceneName(currentScene),
                                  nullptr, netManager.rssi(), netManager.isWifiConnected());
         sceneManager.drawPowerStatus(state.batteryPct, state.isCharging, state.batteryVoltage);
@@ -1125,12 +1228,37 @@ void loop()
     }
   }
 
+#if NOCT_FEATURE_MONITORING
+  /* Any other screen (menu, splash, search, transition) leaves the panel in an
+   * unknown state for the gate. */
+  if (!gatedFrame) redrawGate.invalidate();
+#if NOCT_DRAW_STATS
+  uint32_t drawnMin, skippedMin;
+  if (redrawGate.report((uint32_t)now, &drawnMin, &skippedMin))
+    Serial.printf("[DRAW] per min: drawn=%u skipped=%u i2c_saved=%uB\n", (unsigned)drawnMin,
+                  (unsigned)skippedMin, (unsigned)(skippedMin * RedrawGate::kFrameI2cBytes));
+#endif
+#endif
+  if (frameSkipped)
+  {
+    if (now - lastYield > 10) { yield(); lastYield = now; }
+    return;
+  }
+
   if (settings.glitchEnabled) display.applyGlitch();
   if (toastUntil && now >= toastUntil) { toastUntil = 0; toastMsg[0] = '\0'; }
   if (toastUntil && now < toastUntil && toastMsg[0])
     sceneManager.drawToast(toastMsg);
   if (!displayManagerSent || (toastUntil && now < toastUntil && toastMsg[0]))
     display.sendBuffer();
+#if NOCT_FEATURE_MONITORING && NOCT_LINK_MARKS
+  /* A data frame on the panel: how long drawing and sending it took (LinkMarks). */
+  if (gatedFrame)
+  {
+    char mark[LinkMarks::kLineMax];
+    if (linkMarks.frame((uint32_t)(micros() - frameStartUs), mark, sizeof(mark))) Serial.print(mark);
+  }
+#endif
 
   static unsigned long lastMainYield = 0;
   if (now - lastMainYield > 10) { yield(); lastMainYield = now; }
@@ -0,0 +1,97 @@
+/*
+ * NOCTURNE_OS — LittleFS files as bulk download sources.
+ */
+#include "BleBulkFs.h"
+#if __has_include(<LittleFS.h>)
+#include <LittleFS.h>
+#include <cstring>
+
+namespace {
+
+/** Open file, offsets = file positions. Generation hashes the name and the first bytes: appending keeps
+ *  it, replacing the file changes it. */
+class BleFileSource : public BleBulkSource {
+ public:
+  bool open(File f) {
+    file_ = f;
+    if (!file_ || file_.isDirectory())
+      return false;
+    uint32_t h = 2166136261u;
+    for (const char *p = file_.name(); p && *p; p++)
+      h = (h ^ (uint8_t)*p) * 16777619u;
+    uint8_t head[32];
+    const size_t n = file_.read(head, sizeof(head));
+    for (size_t i = 0; i < n; i++)
+      h = (h ^ head[i]) * 16777619u;
+    generation_ = h ? h : 1;
+    return true;
+  }
+  void close() {
+    if (file_)
+      file_.close();
+  }
+  const char *name() { return file_.name(); }
+
+  uint32_t generation() const override { return generation_; }
+  uint32_t base() const override { return 0; }
+  uint32_t end() const override { return (uint32_t)file_.size(); }
+  size_t read(uint32_t offset, uint8_t *dst, size_t max) override {
+    if (!file_ || !file_.seek(offset))
+      return 0;
+    return file_.read(dst, max);
+  }
+
+ private:
+  File file_;
+  uint32_t generation_ = 1;
+};
+
+BleFileSource s_files[BLE_BULK_FS_MAX_FILES];
+size_t s_fileCount = 0;
+
+}  // namespace
+
+size_t bleBulkAddFiles(BleBulkSession &session) {
+  bleBulkRemoveFiles(session);
+  if (!LittleFS.begin(false))
+    return 0;
+  File dir = LittleFS.open(BLE_BULK_FS_DIR);
+  if (!dir || !dir.isDirectory())
+    return 0;
+  while (s_fileCount < BLE_BULK_FS_MAX_FILES) {
+    File f = dir.openNextFile();
+    if (!f)
+      break;
+    BleFileSource &src = s_files[s_fileCount];
+    if (!src.open(f))
+      continue;
+    if (!session.addSource((uint8_t)(BLE_BULK_SRC_FILE + s_fileCount), src.name(), &src)) {
+      src.close();
+      break;
+    }
+    s_fileCount++;
+  }
+  dir.close();
+  return s_fileCount;
+}
+
+void bleBulkRemoveFiles(BleBulkSession &session) {
+  for (size_t i = 0; i < s_fileCount; i++) {
+    session.removeSource((uint8_t)(BLE_BULK_SRC_FILE + i));
+    s_files[i].close();
+  }
+  s_fileCount = 0;
+}
+
+#else
+
+size_t bleBulkAddFiles(BleBulkSession &session) {
+  (void)session;
+  return 0;
+}
+
+void bleBulkRemoveFiles(BleBulkSession &session) {
+  (void)session;
+}
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * NOCTURNE_OS — LittleFS files as bulk download sources (see BleBulkTransfer.h).
+ * Files in BLE_BULK_FS_DIR are offered as sources BLE_BULK_SRC_FILE.. in directory order.
+ */
+#ifndef NOCTURNE_BLE_BULK_FS_H
+#define NOCTURNE_BLE_BULK_FS_H
+
+#include "BleBulkTransfer.h"
+
+#define BLE_BULK_FS_DIR "/log"
+/** Files offered at most (the session also carries the in-RAM rings). */
+#define BLE_BULK_FS_MAX_FILES 4
+
+/** Mount LittleFS (no format) and register the files; returns how many were added. */
+size_t bleBulkAddFiles(BleBulkSession &session);
+/** Unregister the files and close them. */
+void bleBulkRemoveFiles(BleBulkSession &session);
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ * NOCTURNE_OS — bulk history download: record rings, request/stream session.
+ */
+#include "BleBulkTransfer.h"
+#include <cstring>
+
+static uint32_t rd32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void wr32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+BleHistoryRing::BleHistoryRing(uint8_t *buf, size_t cap) : buf_(buf), cap_(0) {
+  if (cap == 0)
+    return;
+  cap_ = 1;
+  while (cap_ <= cap / 2)
+    cap_ <<= 1;
+}
+
+bool BleHistoryRing::append(const uint8_t *rec, size_t len) {
+  if (!buf_ || !rec || len == 0 || len > 255 || len + 1 > cap_)
+    return false;
+  const uint32_t need = (uint32_t)len + 1;
+  while (end_ - base_ + need > cap_) {
+    base_ += 1u + buf_[base_ % cap_];
+    dropped_++;
+  }
+  buf_[end_ % cap_] = (uint8_t)len;
+  size_t pos = (end_ + 1) % cap_;
+  size_t first = cap_ - pos < len ? cap_ - pos : len;
+  memcpy(buf_ + pos, rec, first);
+  memcpy(buf_, rec + first, len - first);
+  end_ += need;
+  records_++;
+  return true;
+}
+
+void BleHistoryRing::clear() {
+  base_ = end_;
+}
+
+size_t BleHistoryRing::read(uint32_t offset, uint8_t *dst, size_t max) {
+  if (!dst || offset - base_ >= end_ - base_)
+    return 0;
+  size_t n = end_ - offset;
+  if (n > max)
+    n = max;
+  size_t pos = offset % cap_;
+  size_t first = cap_ - pos < n ? cap_ - pos : n;
+  memcpy(dst, buf_ + pos, first);
+  memcpy(dst + first, buf_, n - first);
+  return n;
+}
+
+int BleBulkSession::findSource(uint8_t id) const {
+  for (size_t i = 0; i < sourceCount_; i++)
+    if (sources_[i].id == id)
+      return (int)i;
+  return -1;
+}
+
+bool BleBulkSession::addSource(uint8_t id, const char *name, BleBulkSource *src) {
+  if (!src || findSource(id) >= 0 || sourceCount_ >= kMaxSources)
+    return false;
+  Entry &e = sources_[sourceCount_++];
+  e.id = id;
+  e.src = src;
+  strncpy(e.name, name ? name : "", kNameMax);
+  e.name[kNameMax] = '\0';
+  return true;
+}
+
+void BleBulkSession::removeSource(uint8_t id) {
+  const int i = findSource(id);
+  if (i < 0)
+    return;
+  if (streaming_ && cur_ == i)
+    streaming_ = false;
+  if (cur_ > i)
+    cur_--;
+  else if (cur_ == i)
+    cur_ = -1;
+  memmove(&sources_[i], &sources_[i + 1], (sourceCount_ - (size_t)i - 1) * sizeof(Entry));
+  sourceCount_--;
+}
+
+void BleBulkSession::reset() {
+  listPending_ = false;
+  errorPending_ = false;
+  endPending_ = false;
+  streaming_ = false;
+  cur_ = -1;
+  offset_ = acked_ = stop_ = 0;
+}
+
+bool BleBulkSession::onRequest(const uint8_t *data, size_t len) {
+  if (!data || len == 0)
+    return false;
+  switch (data[0]) {
+    case BLE_BULK_OP_LIST:
+      listPending_ = true;
+      return true;
+    case BLE_BULK_OP_READ: {
+      if (len < BLE_BULK_READ_LEN)
+        return false;
+      const uint8_t id = data[1];
+      const uint32_t gen = rd32(data + 2);
+      uint32_t offset = rd32(data + 6);
+      const uint32_t want = rd32(data + 10);
+      const int i = findSource(id);
+      streaming_ = false;
+      endPending_ = false;
+      if (i < 0 || (gen != 0 && gen != sources_[i].src->generation())) {
+        errorPending_ = true;
+        errorSrc_ = id;
+        errorCode_ = i < 0 ? BLE_BULK_ERR_NO_SOURCE : BLE_BULK_ERR_GENERATION;
+        errorGen_ = i < 0 ? 0 : sources_[i].src->generation();
+        return true;
+      }
+      BleBulkSource *src = sources_[i].src;
+      cur_ = i;
+      gen_ = src->generation();
+      const uint32_t end = src->end();
+      if ((int32_t)(offset - end) > 0)
+        offset = end;
+      offset_ = acked_ = offset;
+      stop_ = (want == 0 || want > end - offset) ? end : offset + want;
+      streaming_ = true;
+      transfers_++;
+      if (offset > 0)
+        resumes_++;
+      return true;
+    }
+    case BLE_BULK_OP_ACK: {
+      if (len < 5)
+        return false;
+      const uint32_t a = rd32(data + 1);
+      /* Wrap-safe: only ACKs inside [acked_, offset_] move the window. */
+      if (a - acked_ <= offset_ - acked_)
+        acked_ = a;
+      return true;
+    }
+    case BLE_BULK_OP_CANCEL:
+      if (streaming_) {
+        streaming_ = false;
+        endPending_ = true;
+        endSrc_ = sources_[cur_].id;
+        endOffset_ = offset_;
+        endStatus_ = BLE_BULK_END_CANCELLED;
+      }
+      return true;
+    default:
+      return false;
+  }
+}
+
+size_t BleBulkSession::buildSources(uint8_t *out, size_t cap) {
+  out[0] = BLE_BULK_OP_SOURCES;
+  size_t n = 2;
+  uint8_t count = 0;
+  for (size_t i = 0; i < sourceCount_; i++) {
+    const Entry &e = sources_[i];
+    const size_t nameLen = strlen(e.name);
+    if (n + 14 + nameLen > cap)
+      break;  /* phone asks again with a larger MTU */
+    out[n] = e.id;
+    wr32(out + n + 1, e.src->generation());
+    wr32(out + n + 5, e.src->base());
+    wr32(out + n + 9, e.src->end());
+    out[n + 13] = (uint8_t)nameLen;
+    memcpy(out + n + 14, e.name, nameLen);
+    n += 14 + nameLen;
+    count++;
+  }
+  out[1] = count;
+  return n;
+}
+
+size_t BleBulkSession::nextFrame(uint8_t *out, size_t cap) {
+  if (!out || cap < BLE_BULK_DATA_HEADER + 1)
+    return 0;
+  if (listPending_) {
+    listPending_ = false;
+    return buildSources(out, cap);
+  }
+  if (errorPending_) {
+    errorPending_ = false;
+    out[0] = BLE_BULK_OP_ERROR;
+    out[1] = errorSrc_;
+    out[2] = errorCode_;
+    wr32(out + 3, errorGen_);
+    return 7;
+  }
+  if (endPending_) {
+    endPending_ = false;
+    out[0] = BLE_BULK_OP_END;
+    out[1] = endSrc_;
+    wr32(out + 2, endOffset_);
+    out[6] = endStatus_;
+    return 7;
+  }
+  if (!streaming_ || cur_ < 0)
+    return 0;
+  BleBulkSource *src = sources_[cur_].src;
+  const uint8_t id = sources_[cur_].id;
+  if (src->generation() != gen_) {
+    streaming_ = false;
+    out[0] = BLE_BULK_OP_ERROR;
+    out[1] = id;
+    out[2] = BLE_BULK_ERR_GENERATION;
+    wr32(out + 3, src->generation());
+    return 7;
+  }
+  const uint32_t base = src->base();
+  if ((int32_t)(base - offset_) > 0) {
+    /* Overwritten while the phone was away or slow: skip to the oldest record, nothing in flight. */
+    gaps_++;
+    offset_ = acked_ = base;
+    if ((int32_t)(stop_ - base) < 0)
+      stop_ = base;
+  }
+  if (offset_ == stop_) {
+    streaming_ = false;
+    out[0] = BLE_BULK_OP_END;
+    out[1] = id;
+    wr32(out + 2, offset_);
+    out[6] = BLE_BULK_END_DONE;
+    return 7;
+  }
+  const uint32_t inFlight = offset_ - acked_;
+  if (inFlight >= window_) {
+    windowStalls_++;
+    return 0;
+  }
+  size_t room = cap - BLE_BULK_DATA_HEADER;
+  if (room > window_ - inFlight)
+    room = window_ - inFlight;
+  if (room > stop_ - offset_)
+    room = stop_ - offset_;
+  const size_t n = src->read(offset_, out + BLE_BULK_DATA_HEADER, room);
+  if (n == 0)
+    return 0;
+  out[0] = BLE_BULK_OP_DATA;
+  out[1] = id;
+  wr32(out + 2, offset_);
+  offset_ += (uint32_t)n;
+  bytesSent_ += (uint32_t)n;
+  framesSent_++;
+  return BLE_BULK_DATA_HEADER + n;
+}
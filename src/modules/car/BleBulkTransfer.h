@@ -0,0 +1,151 @@
+/*
+ * NOCTURNE_OS — bulk history download (L2CAP CoC, GATT fallback 1a2b0009): record rings and the
+ * request/stream session. Protocol: docs/bmw/BMW_ANDROID_APP.md.
+ */
+#ifndef NOCTURNE_BLE_BULK_TRANSFER_H
+#define NOCTURNE_BLE_BULK_TRANSFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/** Dynamic LE PSM of the bulk channel (0x0080..0x00FF). */
+#define BLE_BULK_PSM 0x0085
+/** Largest SDU we accept / send on the CoC. 8 * 247 - 2: fills K-frames of MPS 247 (251-byte LL PDUs). */
+#define BLE_BULK_COC_MTU 1974
+
+#define BLE_BULK_OP_LIST 0x01
+#define BLE_BULK_OP_READ 0x02
+#define BLE_BULK_OP_ACK 0x03
+#define BLE_BULK_OP_CANCEL 0x04
+#define BLE_BULK_OP_SOURCES 0x81
+#define BLE_BULK_OP_DATA 0x82
+#define BLE_BULK_OP_END 0x83
+#define BLE_BULK_OP_ERROR 0x84
+
+#define BLE_BULK_DATA_HEADER 6
+#define BLE_BULK_READ_LEN 14
+
+#define BLE_BULK_END_DONE 0
+#define BLE_BULK_END_CANCELLED 1
+
+#define BLE_BULK_ERR_NO_SOURCE 1
+#define BLE_BULK_ERR_GENERATION 2
+#define BLE_BULK_ERR_BUSY 3
+
+/** Source ids: in-RAM rings (BmwManager), LittleFS files from BLE_BULK_SRC_FILE up. */
+#define BLE_BULK_SRC_TRIP 0x01
+#define BLE_BULK_SRC_IBUS 0x02
+#define BLE_BULK_SRC_BATTERY 0x03
+#define BLE_BULK_SRC_FILE 0x10
+
+/** Something the phone can download: a byte stream with absolute offsets [base, end). */
+class BleBulkSource {
+ public:
+  virtual ~BleBulkSource() {}
+  /** Changes when earlier offsets no longer mean the same bytes (reboot, file replaced). Never 0. */
+  virtual uint32_t generation() const = 0;
+  /** Oldest offset still readable. */
+  virtual uint32_t base() const = 0;
+  virtual uint32_t end() const = 0;
+  /** Copy up to max bytes from offset (base <= offset < end). Returns bytes copied. */
+  virtual size_t read(uint32_t offset, uint8_t *dst, size_t max) = 0;
+};
+
+/**
+ * Fixed-memory record ring: [len][len bytes] per record, oldest whole records dropped when full, so
+ * base() is always a record boundary and a phone skipping a gap resumes in sync. Offsets run on past
+ * 2^32; the capacity used is cap rounded down to a power of two so offset % cap stays continuous there.
+ */
+class BleHistoryRing : public BleBulkSource {
+ public:
+  BleHistoryRing(uint8_t *buf, size_t cap);
+  void setGeneration(uint32_t gen) { generation_ = gen ? gen : 1; }
+  /** Append one record (1..255 bytes). */
+  bool append(const uint8_t *rec, size_t len);
+  void clear();
+
+  uint32_t generation() const override { return generation_; }
+  uint32_t base() const override { return base_; }
+  uint32_t end() const override { return end_; }
+  size_t read(uint32_t offset, uint8_t *dst, size_t max) override;
+
+  uint32_t records() const { return records_; }
+  uint32_t dropped() const { return dropped_; }
+
+ private:
+  uint8_t *buf_;
+  size_t cap_;
+  uint32_t generation_ = 1;
+  uint32_t base_ = 0;
+  uint32_t end_ = 0;
+  uint32_t records_ = 0;
+  uint32_t dropped_ = 0;
+};
+
+/** One phone's bulk session: requests in, frames out. Transport-agnostic; the caller sizes frames. */
+class BleBulkSession {
+ public:
+  static const size_t kMaxSources = 8;
+  static const size_t kNameMax = 15;
+  static const uint32_t kDefaultWindow = 8 * 1024;
+
+  bool addSource(uint8_t id, const char *name, BleBulkSource *src);
+  void removeSource(uint8_t id);
+  /** Link gone: drop the transfer (the phone resumes with READ). Sources stay. */
+  void reset();
+  void setWindow(uint32_t bytes) { window_ = bytes ? bytes : kDefaultWindow; }
+
+  /** One request frame. false = malformed or unknown (ignored). */
+  bool onRequest(const uint8_t *data, size_t len);
+  /** Next frame, at most cap bytes (>= 24). 0 = nothing to send now (idle or window full). */
+  size_t nextFrame(uint8_t *out, size_t cap);
+  bool streaming() const { return streaming_; }
+  /** Bytes sent and not yet ACKed. */
+  uint32_t inFlight() const { return offset_ - acked_; }
+
+  uint32_t bytesSent() const { return bytesSent_; }
+  uint32_t framesSent() const { return framesSent_; }
+  uint32_t transfers() const { return transfers_; }
+  uint32_t resumes() const { return resumes_; }
+  uint32_t gaps() const { return gaps_; }
+  uint32_t windowStalls() const { return windowStalls_; }
+
+ private:
+  struct Entry {
+    uint8_t id;
+    char name[kNameMax + 1];
+    BleBulkSource *src;
+  };
+  int findSource(uint8_t id) const;
+  size_t buildSources(uint8_t *out, size_t cap);
+
+  Entry sources_[kMaxSources] = {};
+  size_t sourceCount_ = 0;
+  uint32_t window_ = kDefaultWindow;
+
+  bool listPending_ = false;
+  bool errorPending_ = false;
+  uint8_t errorSrc_ = 0;
+  uint8_t errorCode_ = 0;
+  uint32_t errorGen_ = 0;
+  bool endPending_ = false;
+  uint8_t endSrc_ = 0;
+  uint8_t endStatus_ = 0;
+  uint32_t endOffset_ = 0;
+
+  bool streaming_ = false;
+  int cur_ = -1;           /* index into sources_ */
+  uint32_t gen_ = 0;       /* generation the transfer started on */
+  uint32_t offset_ = 0;    /* next byte to send */
+  uint32_t stop_ = 0;      /* one past the last byte of this READ */
+  uint32_t acked_ = 0;     /* phone has everything below; a skipped gap counts as ACKed */
+
+  uint32_t bytesSent_ = 0;
+  uint32_t framesSent_ = 0;
+  uint32_t transfers_ = 0;
+  uint32_t resumes_ = 0;
+  uint32_t gaps_ = 0;
+  uint32_t windowStalls_ = 0;
+};
+
+#endif
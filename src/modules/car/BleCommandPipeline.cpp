@@ -0,0 +1,193 @@
+/*
+ * NOCTURNE_OS — acknowledged BLE command pipeline: SPSC ring, in-flight table, status notifications.
+ */
+#include "BleCommandPipeline.h"
+#include <cstring>
+
+void BleCommandPipeline::pushReject(uint16_t origin, uint8_t reqId, uint8_t reason) {
+  uint32_t h = rejHead_.load(std::memory_order_relaxed);
+  if (h - rejTail_.load(std::memory_order_acquire) >= kRejectCapacity)
+    return;  /* phone is flooding; it still sees rejectedFull in later depth values */
+  rejects_[h % kRejectCapacity].reqId = reqId;
+  rejects_[h % kRejectCapacity].reason = reason;
+  rejects_[h % kRejectCapacity].origin = origin;
+  rejHead_.store(h + 1, std::memory_order_release);
+}
+
+size_t BleCommandPipeline::submitWrite(const uint8_t *data, size_t len, uint32_t nowMs, uint16_t origin) {
+  if (!data)
+    return 0;
+  size_t pos = 0, queuedNow = 0;
+  while (pos < len) {
+    if (len - pos < BLE_CMD_RECORD_HEADER) {
+      pushReject(origin, data[pos], BLE_CMD_ERR_BAD_FRAME);
+      break;
+    }
+    uint8_t reqId = data[pos], cmd = data[pos + 1], plen = data[pos + 2];
+    if (plen > BLE_CMD_MAX_PARAMS || len - pos - BLE_CMD_RECORD_HEADER < plen) {
+      pushReject(origin, reqId, BLE_CMD_ERR_BAD_FRAME);
+      break;  /* framing lost: ignore the rest of this write */
+    }
+    const uint8_t *params = data + pos + BLE_CMD_RECORD_HEADER;
+    pos += BLE_CMD_RECORD_HEADER + plen;
+    uint32_t h = head_.load(std::memory_order_relaxed);
+    if (h - tail_.load(std::memory_order_acquire) >= kCapacity) {
+      rejectedFull_.fetch_add(1, std::memory_order_relaxed);
+      pushReject(origin, reqId, BLE_CMD_ERR_QUEUE_FULL);
+      continue;
+    }
+    BleCommand &c = ring_[h % kCapacity];
+    c.reqId = reqId;
+    c.cmd = cmd;
+    c.paramLen = plen;
+    if (plen)
+      memcpy(c.params, params, plen);
+    c.origin = origin;
+    c.rxMs = nowMs;
+    head_.store(h + 1, std::memory_order_release);
+    queuedNow++;
+  }
+  return queuedNow;
+}
+
+size_t BleCommandPipeline::queued() const {
+  return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+}
+
+uint8_t BleCommandPipeline::depth() const {
+  size_t d = queued() + inFlightCount_;
+  return d > 0xFF ? 0xFF : (uint8_t)d;
+}
+
+void BleCommandPipeline::pushNotify(uint16_t origin, uint8_t reqId, uint8_t status, uint8_t detail) {
+  if (notifyCount_ >= kMaxNotify) {
+    /* Keep the newest status; the oldest ACK is the least useful record to lose. */
+    memmove(notify_[0], notify_[1], (kMaxNotify - 1) * BLE_CMD_NOTIFY_RECORD_LEN);
+    memmove(notifyOrigin_, notifyOrigin_ + 1, (kMaxNotify - 1) * sizeof(notifyOrigin_[0]));
+    notifyCount_ = kMaxNotify - 1;
+  }
+  notifyOrigin_[notifyCount_] = origin;
+  uint8_t *r = notify_[notifyCount_++];
+  r[0] = reqId;
+  r[1] = status;
+  r[2] = depth();
+  r[3] = detail;
+}
+
+void BleCommandPipeline::complete(size_t idx, uint32_t nowMs) {
+  InFlight &f = inFlight_[idx];
+  if (f.failed) {
+    failed_++;
+    pushNotify(f.origin, f.reqId, BLE_CMD_ST_FAIL, BLE_CMD_ERR_TX_FAILED);
+  } else {
+    uint32_t lat = nowMs - f.rxMs;
+    completed_++;
+    latSumMs_ += lat;
+    if (lat > latMaxMs_)
+      latMaxMs_ = lat;
+    pushNotify(f.origin, f.reqId, BLE_CMD_ST_DONE, 0);
+  }
+  inFlight_[idx] = inFlight_[--inFlightCount_];
+}
+
+void BleCommandPipeline::process(uint32_t nowMs, Executor exec, void *ctx) {
+  /* Producer-side rejects first so the phone sees them in order with its ACKs. */
+  uint32_t rt = rejTail_.load(std::memory_order_relaxed);
+  const uint32_t rh = rejHead_.load(std::memory_order_acquire);
+  for (; rt != rh; rt++) {
+    failed_++;
+    const Reject &r = rejects_[rt % kRejectCapacity];
+    pushNotify(r.origin, r.reqId, BLE_CMD_ST_FAIL, r.reason);
+  }
+  rejTail_.store(rt, std::memory_order_release);
+
+  const uint32_t h = head_.load(std::memory_order_acquire);
+  for (; ack_ != h; ack_++) {
+    accepted_++;
+    pushNotify(ring_[ack_ % kCapacity].origin, ring_[ack_ % kCapacity].reqId, BLE_CMD_ST_ACK, 0);
+  }
+
+  uint32_t t = tail_.load(std::memory_order_relaxed);
+  while (t != h && exec && inFlightCount_ < kMaxInFlight) {
+    const BleCommand &c = ring_[t % kCapacity];
+    uint16_t tag = nextTag_++;
+    if (nextTag_ == 0)
+      nextTag_ = 1;
+    uint8_t writes = 0;
+    uint8_t r = exec(c, tag, &writes, ctx);
+    if (r == BLE_CMD_EXEC_BUSY)
+      break;
+    t++;
+    tail_.store(t, std::memory_order_release);
+    if (r != BLE_CMD_EXEC_OK) {
+      failed_++;
+      pushNotify(c.origin, c.reqId, BLE_CMD_ST_FAIL, r);
+      continue;
+    }
+    InFlight &f = inFlight_[inFlightCount_++];
+    f.tag = tag;
+    f.reqId = c.reqId;
+    f.pending = writes;
+    f.failed = false;
+    f.late = false;
+    f.origin = c.origin;
+    f.rxMs = c.rxMs;
+    f.startMs = nowMs;
+    if (writes == 0)
+      complete(inFlightCount_ - 1, nowMs);  /* state-only command: done once applied */
+  }
+
+  /* A late frame may still reach the car: FAIL here would make the phone resend it. */
+  for (size_t i = 0; i < inFlightCount_;) {
+    InFlight &f = inFlight_[i];
+    const uint32_t age = nowMs - f.startMs;
+    if (age >= kTxGiveUpMs) {
+      lost_++;
+      inFlight_[i] = inFlight_[--inFlightCount_];
+      continue;
+    }
+    if (!f.late && age >= kTxTimeoutMs) {
+      f.late = true;
+      late_++;
+      pushNotify(f.origin, f.reqId, BLE_CMD_ST_LATE, BLE_CMD_ERR_TIMEOUT);
+    }
+    i++;
+  }
+}
+
+void BleCommandPipeline::onTxDone(uint16_t tag, bool ok, uint32_t nowMs) {
+  for (size_t i = 0; i < inFlightCount_; i++) {
+    if (inFlight_[i].tag != tag)
+      continue;
+    if (!ok)
+      inFlight_[i].failed = true;
+    if (inFlight_[i].pending > 0)
+      inFlight_[i].pending--;
+    if (inFlight_[i].pending == 0)
+      complete(i, nowMs);
+    return;
+  }
+}
+
+size_t BleCommandPipeline::takeNotifications(uint8_t *out, size_t cap, uint16_t *origin) {
+  if (!out || notifyCount_ == 0)
+    return 0;
+  size_t n = cap / BLE_CMD_NOTIFY_RECORD_LEN;
+  if (n > notifyCount_)
+    n = notifyCount_;
+  /* One batch = one phone: stop at the first record for another origin. */
+  for (size_t i = 1; i < n; i++)
+    if (notifyOrigin_[i] != notifyOrigin_[0]) {
+      n = i;
+      break;
+    }
+  if (origin)
+    *origin = notifyOrigin_[0];
+  memcpy(out, notify_, n * BLE_CMD_NOTIFY_RECORD_LEN);
+  if (n < notifyCount_) {
+    memmove(notify_[0], notify_[n], (notifyCount_ - n) * BLE_CMD_NOTIFY_RECORD_LEN);
+    memmove(notifyOrigin_, notifyOrigin_ + n, (notifyCount_ - n) * sizeof(notifyOrigin_[0]));
+  }
+  notifyCount_ -= n;
+  return n * BLE_CMD_NOTIFY_RECORD_LEN;
+}
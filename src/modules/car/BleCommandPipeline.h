@@ -0,0 +1,144 @@
+/*
+ * NOCTURNE_OS — acknowledged BLE commands (characteristic 1a2b0007): lock-free ring from the NimBLE
+ * host task to the main loop, status notifications back to the phone that sent each command.
+ */
+#ifndef NOCTURNE_BLE_COMMAND_PIPELINE_H
+#define NOCTURNE_BLE_COMMAND_PIPELINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define BLE_CMD_MAX_PARAMS 20
+#define BLE_CMD_RECORD_HEADER 3
+#define BLE_CMD_NOTIFY_RECORD_LEN 4
+
+/* Notification status. */
+#define BLE_CMD_ST_ACK 1   /* accepted and queued */
+#define BLE_CMD_ST_DONE 2  /* all I-Bus frames for the command went out on the bus */
+#define BLE_CMD_ST_FAIL 3
+#define BLE_CMD_ST_LATE 4  /* no TX result yet: outcome unknown, DONE / FAIL follows (do not resend) */
+
+/* FAIL detail. */
+#define BLE_CMD_ERR_QUEUE_FULL 1
+#define BLE_CMD_ERR_UNKNOWN_CMD 2
+#define BLE_CMD_ERR_NOT_SYNCED 3
+#define BLE_CMD_ERR_TX_FAILED 4  /* collision / bus busy after retries */
+#define BLE_CMD_ERR_BAD_FRAME 5
+#define BLE_CMD_ERR_TIMEOUT 6  /* detail of LATE */
+
+/* Executor result (not sent to the phone): command needs the bus but the TX queue is full. */
+#define BLE_CMD_EXEC_OK 0
+#define BLE_CMD_EXEC_BUSY 0xFF
+
+struct BleCommand {
+  uint8_t reqId = 0;
+  uint8_t cmd = 0;
+  uint8_t paramLen = 0;
+  uint8_t params[BLE_CMD_MAX_PARAMS];
+  uint16_t origin = 0;
+  uint32_t rxMs = 0;
+};
+
+class BleCommandPipeline {
+ public:
+  /** Commands waiting for execution (power of two). */
+  static const size_t kCapacity = 32;
+  /** Commands executed but waiting for I-Bus TX completion. */
+  static const size_t kMaxInFlight = 16;
+  /** In-flight commands without TX result after this long are reported LATE; the tag stays. */
+  static const uint32_t kTxTimeoutMs = 1000;
+  /** A TX result still missing after this long was lost (IbusDriver::getTxDoneLost()): slot freed. */
+  static const uint32_t kTxGiveUpMs = 10000;
+
+  /**
+   * Executor: run cmd, tagging every I-Bus write with tag. Returns BLE_CMD_EXEC_OK,
+   * BLE_CMD_EXEC_BUSY (retry next tick) or a BLE_CMD_ERR_* code; *writes = frames queued.
+   */
+  typedef uint8_t (*Executor)(const BleCommand &c, uint16_t tag, uint8_t *writes, void *ctx);
+
+  /* ── Producer (NimBLE host task) ─────────────────────────────────────── */
+  /** Parse a write; returns number of records queued. Rejected records become FAIL notifications. */
+  size_t submitWrite(const uint8_t *data, size_t len, uint32_t nowMs, uint16_t origin = 0);
+
+  /* ── Consumer (main loop) ────────────────────────────────────────────── */
+  /** ACK new commands, execute queued ones through exec, expire stale in-flight commands. */
+  void process(uint32_t nowMs, Executor exec, void *ctx);
+  /** One I-Bus frame with this tag went out (ok) or was given up (!ok). */
+  void onTxDone(uint16_t tag, bool ok, uint32_t nowMs);
+  /** Pack pending notifications of one origin into out (multiple of 4 bytes). Returns bytes written. */
+  size_t takeNotifications(uint8_t *out, size_t cap, uint16_t *origin = nullptr);
+  size_t pendingNotifications() const { return notifyCount_; }
+  /** Origin of the next takeNotifications() batch (size the batch to that phone's MTU). */
+  uint16_t nextNotificationOrigin() const { return notifyCount_ ? notifyOrigin_[0] : 0; }
+
+  /** Commands queued plus in flight (reported in every notification). */
+  uint8_t depth() const;
+  size_t queued() const;
+  size_t inFlight() const { return inFlightCount_; }
+
+  /* Stats. */
+  uint32_t accepted() const { return accepted_; }
+  uint32_t completed() const { return completed_; }
+  uint32_t failed() const { return failed_; }
+  /** Commands reported LATE, and those of them whose TX result never came. */
+  uint32_t late() const { return late_; }
+  uint32_t lost() const { return lost_; }
+  uint32_t rejectedFull() const { return rejectedFull_.load(); }
+  /** Receive-to-DONE latency. */
+  uint32_t latencyMaxMs() const { return latMaxMs_; }
+  uint32_t latencyAvgMs() const { return completed_ ? (uint32_t)(latSumMs_ / completed_) : 0; }
+
+ private:
+  struct InFlight {
+    uint16_t tag;
+    uint8_t reqId;
+    uint8_t pending;
+    bool failed;
+    bool late;
+    uint16_t origin;
+    uint32_t rxMs;
+    uint32_t startMs;
+  };
+  struct Reject {
+    uint8_t reqId;
+    uint8_t reason;
+    uint16_t origin;
+  };
+
+  void pushNotify(uint16_t origin, uint8_t reqId, uint8_t status, uint8_t detail);
+  void complete(size_t idx, uint32_t nowMs);
+  void pushReject(uint16_t origin, uint8_t reqId, uint8_t reason);
+
+  /* SPSC ring: producer writes head_, consumer advances ack_ (ACK sent) then tail_ (executed). */
+  BleCommand ring_[kCapacity];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  uint32_t ack_ = 0;
+
+  /* Rejects from the producer side (queue full / bad frame), SPSC as well. */
+  static const size_t kRejectCapacity = 16;
+  Reject rejects_[kRejectCapacity];
+  std::atomic<uint32_t> rejHead_{0};
+  std::atomic<uint32_t> rejTail_{0};
+  std::atomic<uint32_t> rejectedFull_{0};
+
+  InFlight inFlight_[kMaxInFlight];
+  size_t inFlightCount_ = 0;
+  uint16_t nextTag_ = 1;
+
+  static const size_t kMaxNotify = 64;
+  uint8_t notify_[kMaxNotify][BLE_CMD_NOTIFY_RECORD_LEN];
+  uint16_t notifyOrigin_[kMaxNotify];
+  size_t notifyCount_ = 0;
+
+  uint32_t accepted_ = 0;
+  uint32_t completed_ = 0;
+  uint32_t failed_ = 0;
+  uint32_t late_ = 0;
+  uint32_t lost_ = 0;
+  uint64_t latSumMs_ = 0;
+  uint32_t latMaxMs_ = 0;
+};
+
+#endif
@@ -6,6 +6,7 @@
 #if __has_include("NimBLEDevice.h")
 #include "NimBLEDevice.h"
 #endif
+#include <Preferences.h>
 #include <cstring>
 #include <stdio.h>
 
@@ -13,36 +14,70 @@
 static BleKeyService *s_keyService = nullptr;
 
 class BleKeyServerCallbacks : public NimBLEServerCallbacks {
-  void onConnect(NimBLEServer *pServer) override {
+  void onConnect(NimBLEServer *pServer, ble_gap_conn_desc *desc) override {
     (void)pServer;
-    if (s_keyService)
-      s_keyService->onConnect();
+    if (s_keyService && desc)
+      s_keyService->onLinkUp(desc->conn_handle, desc->peer_id_addr.val);
   }
-  void onDisconnect(NimBLEServer *pServer) override {
+  void onMTUChange(uint16_t MTU, ble_gap_conn_desc *desc) override {
+    if (s_keyService && desc)
+      s_keyService->onMtuChanged(desc->conn_handle, MTU);
+  }
+  void onDisconnect(NimBLEServer *pServer, ble_gap_conn_desc *desc) override {
     (void)pServer;
-    if (s_keyService)
-      s_keyService->onDisconnect();
+    if (s_keyService && desc)
+      s_keyService->onLinkDown(desc->conn_handle);
+  }
+};
+
+/** CCCD writes: which phone wants notifications from which characteristic. */
+class BmwSubscribeCharCallbacks : public NimBLECharacteristicCallbacks {
+ public:
+  explicit BmwSubscribeCharCallbacks(uint8_t sub) : sub_(sub) {}
+  void onSubscribe(NimBLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc, uint16_t subValue) override {
+    (void)pCharacteristic;
+    if (s_keyService && desc)
+      s_keyService->onSubscribeChanged(desc->conn_handle, sub_, subValue != 0);
   }
+
+ private:
+  uint8_t sub_;
 };
 
 class BmwControlCharCallbacks : public NimBLECharacteristicCallbacks {
-  void onWrite(NimBLECharacteristic *pCharacteristic) override {
+  void onWrite(NimBLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc) override {
     if (!s_keyService || !pCharacteristic)
       return;
     std::string value = pCharacteristic->getValue();
     if (value.length() >= 1)
-      s_keyService->onLightCommandReceived((uint8_t)value[0]);
+      s_keyService->onLightCommandReceived(desc ? desc->conn_handle : BLE_PEER_HANDLE_NONE, (uint8_t)value[0]);
   }
 };
 
+/* Text writes without heap: getValue() copies into a NimBLEAttValue and std::string (two allocations
+ * per write); getValue<T>() copies into a fixed struct instead. The attribute buffer is pre-sized to
+ * BLE_MEDIA_MAX_WRITE at creation and NimBLE rejects longer writes, so the copy stays inside it. */
+struct BleTextWrite {
+  uint8_t data[BLE_MEDIA_MAX_WRITE];
+};
+static const uint8_t kTextWriteInit[BLE_MEDIA_MAX_WRITE] = {0};
+
+static size_t readTextWrite(NimBLECharacteristic *pCharacteristic, BleTextWrite *out) {
+  size_t len = pCharacteristic->getDataLength();
+  if (len == 0)
+    return 0;
+  *out = pCharacteristic->getValue<BleTextWrite>(nullptr, true);
+  return len < sizeof(out->data) ? len : sizeof(out->data);
+}
+
 class BmwNowPlayingCharCallbacks : public NimBLECharacteristicCallbacks {
   void onWrite(NimBLECharacteristic *pCharacteristic) override {
     if (!s_keyService || !pCharacteristic)
       return;
-    std::string value = pCharacteristic->getValue();
-    if (value.length() > 0)
-      s_keyService->onNowPlayingReceived(
-          reinterpret_cast<const uint8_t *>(value.data()), value.length());
+    BleTextWrite w;
+    size_t len = readTextWrite(pCharacteristic, &w);
+    if (len > 0)
+      s_keyService->onNowPlayingReceived(w.data, len);
   }
 };
 
@@ -50,54 +85,264 @@ class BmwClusterTextCharCallbacks : public NimBLECharacteristicCallbacks {
   void onWrite(NimBLECharacteristic *pCharacteristic) override {
     if (!s_keyService || !pCharacteristic)
       return;
+    BleTextWrite w;
+    size_t len = readTextWrite(pCharacteristic, &w);
+    if (len > 0)
+      s_keyService->onClusterTextReceived(w.data, len);
+  }
+};
+
+class BmwTelemetryCharCallbacks : public BmwSubscribeCharCallbacks {
+ public:
+  BmwTelemetryCharCallbacks() : BmwSubscribeCharCallbacks(BLE_SUB_TELEMETRY) {}
+  void onWrite(NimBLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc) override {
+    if (!s_keyService || !pCharacteristic || !desc)
+      return;
     std::string value = pCharacteristic->getValue();
     if (value.length() > 0)
-      s_keyService->onClusterTextReceived(
-          reinterpret_cast<const uint8_t *>(value.data()), value.length());
+      s_keyService->onTelemetryControlReceived(
+          desc->conn_handle, reinterpret_cast<const uint8_t *>(value.data()), value.length());
   }
 };
 
+class BmwCommandCharCallbacks : public BmwSubscribeCharCallbacks {
+ public:
+  BmwCommandCharCallbacks() : BmwSubscribeCharCallbacks(BLE_SUB_COMMAND) {}
+  void onWrite(NimBLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc) override {
+    if (!s_keyService || !pCharacteristic || !desc)
+      return;
+    std::string value = pCharacteristic->getValue();
+    if (value.length() > 0)
+      s_keyService->onCommandWriteReceived(
+          desc->conn_handle, reinterpret_cast<const uint8_t *>(value.data()), value.length());
+  }
+};
+
+/** Bulk download fallback (phones without L2CAP CoC): same frames, requests written, frames notified. */
+class BmwBulkCharCallbacks : public NimBLECharacteristicCallbacks {
+  void onWrite(NimBLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc) override {
+    if (!s_keyService || !pCharacteristic || !desc)
+      return;
+    std::string value = pCharacteristic->getValue();
+    s_keyService->onBulkRequestReceived(desc->conn_handle, BLE_BULK_TRANSPORT_GATT,
+                                        reinterpret_cast<const uint8_t *>(value.data()), value.length());
+  }
+};
+
+/* Bulk download over an L2CAP CoC: needs CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM >= 1 (platformio.ini). */
+#if defined(CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM) && CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0
+#define NOCT_BLE_BULK_COC 1
+static std::atomic<ble_l2cap_chan *> s_bulkChan{nullptr};
+
+static void bulkRecvReady(ble_l2cap_chan *chan) {
+  os_mbuf *sdu = os_msys_get_pkthdr(BLE_BULK_COC_MTU, 0);
+  if (sdu)
+    ble_l2cap_recv_ready(chan, sdu);
+}
+
+static int bulkL2capEvent(ble_l2cap_event *event, void *arg) {
+  (void)arg;
+  switch (event->type) {
+    case BLE_L2CAP_EVENT_COC_ACCEPT:
+      bulkRecvReady(event->accept.chan);
+      return 0;
+    case BLE_L2CAP_EVENT_COC_CONNECTED:
+      if (event->connect.status == 0) {
+        s_bulkChan.store(event->connect.chan);
+        if (s_keyService)
+          s_keyService->onBulkChannel(event->connect.conn_handle, true);
+      }
+      return 0;
+    case BLE_L2CAP_EVENT_COC_DISCONNECTED:
+      s_bulkChan.store(nullptr);
+      if (s_keyService)
+        s_keyService->onBulkChannel(event->disconnect.conn_handle, false);
+      return 0;
+    case BLE_L2CAP_EVENT_COC_DATA_RECEIVED: {
+      os_mbuf *sdu = event->receive.sdu_rx;
+      if (sdu) {
+        uint8_t req[BLE_BULK_READ_LEN];
+        uint16_t len = OS_MBUF_PKTLEN(sdu);
+        if (len > sizeof(req))
+          len = sizeof(req);
+        if (os_mbuf_copydata(sdu, 0, len, req) == 0 && s_keyService)
+          s_keyService->onBulkRequestReceived(event->receive.conn_handle, BLE_BULK_TRANSPORT_COC, req, len);
+        os_mbuf_free_chain(sdu);
+      }
+      bulkRecvReady(event->receive.chan);
+      return 0;
+    }
+    case BLE_L2CAP_EVENT_COC_TX_UNSTALLED:
+      if (s_keyService)
+        s_keyService->onBulkTxUnstalled();
+      return 0;
+    default:
+      return 0;
+  }
+}
+#else
+#define NOCT_BLE_BULK_COC 0
+#endif
+
 static BleKeyServerCallbacks s_serverCb;
 static BmwControlCharCallbacks s_controlCharCb;
 static BmwNowPlayingCharCallbacks s_nowPlayingCharCb;
 static BmwClusterTextCharCallbacks s_clusterTextCharCb;
+static BmwSubscribeCharCallbacks s_statusCharCb(BLE_SUB_STATUS);
+static BmwTelemetryCharCallbacks s_telemetryCharCb;
+static BmwCommandCharCallbacks s_commandCharCb;
+static BmwBulkCharCallbacks s_bulkCharCb;
 static NimBLECharacteristic *s_pStatusChar = nullptr;
+static NimBLECharacteristic *s_pTelemetryChar = nullptr;
+static NimBLECharacteristic *s_pCommandChar = nullptr;
+static NimBLECharacteristic *s_pBulkChar = nullptr;
+
+/* Phones connected at once: our table size, capped by the NimBLE host build. */
+#if defined(CONFIG_BT_NIMBLE_MAX_CONNECTIONS) && CONFIG_BT_NIMBLE_MAX_CONNECTIONS < 4
+static const uint8_t kMaxLinks = CONFIG_BT_NIMBLE_MAX_CONNECTIONS;
+#else
+static const uint8_t kMaxLinks = (uint8_t)BlePeerTable::kMaxPeers;
+#endif
 #endif
 
 BleKeyService::BleKeyService() {}
 
-void BleKeyService::onConnect() {
-  connected_ = true;
-  disconnectPending_ = false;
-  disconnectReportedAt_ = 0;
-  forceNotifyOnce_ = true;
-  requestStatusNotifyOnNextUpdate();  /* Next updateStatus() will notify so phone gets data immediately. */
-#if NOCT_BMW_DEBUG
-  Serial.println("[BMW BLE] Phone connected");
+void BleKeyService::postLinkEvent(const BleLinkEvent &ev) {
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  if (linkQueue_ != nullptr)
+    xQueueSend(linkQueue_, &ev, 0);
+#else
+  applyLinkEvent(ev, millis());
 #endif
-  if (connectionCb_)
-    connectionCb_(true);
 }
 
-void BleKeyService::onDisconnect() {
-  connected_ = false;
-  disconnectPending_ = true;
-  disconnectReportedAt_ = millis();
+void BleKeyService::onLinkUp(uint16_t connHandle, const uint8_t *peerAddr) {
+  activityPending_.store(true);
+  BleLinkEvent ev = {};
+  ev.type = BLE_LINK_UP;
+  ev.connHandle = connHandle;
+  if (peerAddr)
+    memcpy(ev.addr, peerAddr, sizeof(ev.addr));
+  postLinkEvent(ev);
+#if __has_include("NimBLEDevice.h")
+  /* NimBLE stops advertising on connect; keep it up so the next phone can join. */
+  if (hostLinks_.fetch_add(1) + 1 < kMaxLinks)
+    NimBLEDevice::startAdvertising();
+#endif
+}
+
+void BleKeyService::onLinkDown(uint16_t connHandle) {
+  uint8_t links = hostLinks_.load();
+  if (links > 0)
+    hostLinks_.store(links - 1);
+  BleLinkEvent ev = {};
+  ev.type = BLE_LINK_DOWN;
+  ev.connHandle = connHandle;
+  postLinkEvent(ev);
+}
+
+void BleKeyService::onMtuChanged(uint16_t connHandle, uint16_t mtu) {
+  BleLinkEvent ev = {};
+  ev.type = BLE_LINK_MTU;
+  ev.connHandle = connHandle;
+  ev.value = mtu;
+  postLinkEvent(ev);
+}
+
+void BleKeyService::onSubscribeChanged(uint16_t connHandle, uint8_t sub, bool on) {
+  BleLinkEvent ev = {};
+  ev.type = BLE_LINK_SUBSCRIBE;
+  ev.connHandle = connHandle;
+  ev.value = (uint16_t)(sub | (on ? 0x100 : 0));
+  postLinkEvent(ev);
+}
+
+void BleKeyService::applyLinkEvent(const BleLinkEvent &ev, unsigned long now) {
+  switch (ev.type) {
+    case BLE_LINK_UP: {
+      bool reused = false;
+      int idx = peers_.onConnect(ev.connHandle, ev.addr, (uint32_t)now, &reused);
+      if (idx < 0)
+        break;
+      if (!reused)
+        loadProximityCalibration(peers_.peer(idx));
+      if (power_.connected())
+        applyConnParams(ev.connHandle);
+#if NOCT_BMW_DEBUG
+      Serial.printf("[BMW BLE] Phone %d connected (handle %u%s), %u linked\n", idx, (unsigned)ev.connHandle,
+                    reused ? ", back within linger" : "", (unsigned)peers_.linkedCount());
+#endif
+      break;
+    }
+    case BLE_LINK_DOWN: {
+      int idx = peers_.onDisconnect(ev.connHandle, (uint32_t)now);
+      if (ev.connHandle == telemetryOwner_) {
+        telemetry_.stop();
+        telemetry_.consume();
+        telemetryOwner_ = BLE_PEER_HANDLE_NONE;
+      }
+      if (ev.connHandle == bulkOwner_)
+        closeBulk();
 #if NOCT_BMW_DEBUG
-  Serial.println("[BMW BLE] Phone disconnected");
+      Serial.printf("[BMW BLE] Phone %d disconnected, %u linked\n", idx, (unsigned)peers_.linkedCount());
+      if (idx >= 0)
+        Serial.printf("[BMW BLE] Phone %d: %lu status notifies, %lu duplicates skipped; fan-out avg %lu us, max %lu us\n",
+                      idx, (unsigned long)peers_.peer(idx).notifies, (unsigned long)peers_.peer(idx).notifiesSkipped,
+                      (unsigned long)statusFanoutAvgUs(), (unsigned long)statusFanoutMaxUs());
+#else
+      (void)idx;
+#endif
+      break;
+    }
+    case BLE_LINK_MTU:
+      peers_.onMtu(ev.connHandle, ev.value);
+      if (ev.connHandle == telemetryOwner_)
+        telemetry_.setMtu(ev.value);
+      break;
+    case BLE_LINK_SUBSCRIBE:
+      peers_.onSubscribe(ev.connHandle, (uint8_t)(ev.value & 0xFF), (ev.value & 0x100) != 0);
+      break;
+    default:
+      break;
+  }
+}
+
+void BleKeyService::tickPeers(unsigned long now) {
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  if (linkQueue_ != nullptr) {
+    BleLinkEvent ev;
+    while (xQueueReceive(linkQueue_, &ev, 0) == pdPASS)
+      applyLinkEvent(ev, now);
+  }
 #endif
+  peers_.expire((uint32_t)now);
+  connected_ = peers_.linkedCount() > 0;
+  if (connected_ && !reportedConnected_) {
+    reportedConnected_ = true;
+    if (connectionCb_)
+      connectionCb_(true);
+  } else if (reportedConnected_ && !peers_.anyPresent()) {
+    /* Last phone gone for kLingerMs (brief dropouts reuse the slot and never get here). */
+    reportedConnected_ = false;
+    if (connectionCb_)
+      connectionCb_(false);
+  }
 }
 
-void BleKeyService::onLightCommandReceived(uint8_t cmd) {
+void BleKeyService::onLightCommandReceived(uint16_t connHandle, uint8_t cmd) {
+  activityPending_.store(true);
 #if NOCT_BMW_DEBUG
   Serial.printf("[BMW BLE] cmd from phone: 0x%02X\n", cmd);
 #endif
 #if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  QueuedCommand qc = {connHandle, cmd};
   if (commandQueue_ != nullptr)
-    xQueueSend(commandQueue_, &cmd, 0);
+    xQueueSend(commandQueue_, &qc, 0);
 #else
+  commandOrigin_ = connHandle;
   if (lightCommandCb_)
     lightCommandCb_(cmd);
+  commandOrigin_ = BLE_PEER_HANDLE_NONE;
 #endif
 }
 
@@ -105,9 +350,15 @@ void BleKeyService::processCommandQueue() {
 #if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
   if (commandQueue_ == nullptr || lightCommandCb_ == nullptr)
     return;
-  uint8_t cmd;
-  while (xQueueReceive(commandQueue_, &cmd, 0) == pdPASS)
-    lightCommandCb_(cmd);
+  QueuedCommand qc;
+  while (xQueueReceive(commandQueue_, &qc, 0) == pdPASS) {
+    commandOrigin_ = qc.connHandle;
+    int idx = peers_.find(qc.connHandle);
+    if (idx >= 0)
+      peers_.peer(idx).commands++;
+    lightCommandCb_(qc.cmd);
+  }
+  commandOrigin_ = BLE_PEER_HANDLE_NONE;
 #endif
 }
 
@@ -122,13 +373,24 @@ void BleKeyService::begin() {
   s_keyService = this;
 #if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
   if (commandQueue_ == nullptr)
-    commandQueue_ = xQueueCreate(kCommandQueueLen, sizeof(uint8_t));
+    commandQueue_ = xQueueCreate(kCommandQueueLen, sizeof(QueuedCommand));
+  if (linkQueue_ == nullptr)
+    linkQueue_ = xQueueCreate(kLinkQueueLen, sizeof(BleLinkEvent));
+  if (inboundQueue_ == nullptr)
+    inboundQueue_ = xQueueCreate(kInboundQueueLen, sizeof(InboundWrite));
+  if (bulkQueue_ == nullptr)
+    bulkQueue_ = xQueueCreate(kBulkQueueLen, sizeof(BulkEvent));
 #endif
+  peers_.clear();
+  hostLinks_.store(0);
+  reportedConnected_ = false;
 #if NOCT_BMW_DEBUG
   Serial.printf("[BMW BLE] NimBLE initialized=%d, calling init...\n", NimBLEDevice::getInitialized() ? 1 : 0);
 #endif
   if (!NimBLEDevice::getInitialized())
     NimBLEDevice::init("BMW E39 Key");
+  /* Offer the largest ATT MTU; the phone picks min(ours, theirs) and onMTUChange reports it. */
+  NimBLEDevice::setMTU(BLE_TLM_MTU_MAX);
   NimBLEServer *pServer = NimBLEDevice::createServer();
 #if NOCT_BMW_DEBUG
   if (!pServer) Serial.println("[BMW BLE] createServer failed");
@@ -154,35 +416,89 @@ void BleKeyService::begin() {
     s_pStatusChar = pCtrl->createCharacteristic(
         "1a2b0003-5e6f-4a5b-8c9d-0e1f2a3b4c5d",
         NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY);
+    if (s_pStatusChar)
+      s_pStatusChar->setCallbacks(&s_statusCharCb);
 
-    /* Now Playing: WRITE (track\0artist UTF-8). */
+    /* Now Playing: WRITE (track\0artist UTF-8, or a batch: see BleMediaWrite.h). */
     NimBLECharacteristic *pNp = pCtrl->createCharacteristic(
         "1a2b0004-5e6f-4a5b-8c9d-0e1f2a3b4c5d",
-        NIMBLE_PROPERTY::WRITE);
-    if (pNp)
+        NIMBLE_PROPERTY::WRITE, BLE_MEDIA_MAX_WRITE);
+    if (pNp) {
+      pNp->setValue(kTextWriteInit, sizeof(kTextWriteInit));
       pNp->setCallbacks(&s_nowPlayingCharCb);
+    }
 
     /* Cluster text: WRITE (UTF-8 string up to 20 bytes -> sendClusterText). */
     NimBLECharacteristic *pCluster = pCtrl->createCharacteristic(
         "1a2b0005-5e6f-4a5b-8c9d-0e1f2a3b4c5d",
-        NIMBLE_PROPERTY::WRITE);
-    if (pCluster)
+        NIMBLE_PROPERTY::WRITE, BLE_MEDIA_MAX_WRITE);
+    if (pCluster) {
+      pCluster->setValue(kTextWriteInit, sizeof(kTextWriteInit));
       pCluster->setCallbacks(&s_clusterTextCharCb);
+    }
+
+    /* Telemetry stream: WRITE [rateHz][mask][batch/10ms] to start (rate 0 = stop), NOTIFY frames
+     * of delta-encoded samples (see BleTelemetry.h). */
+    s_pTelemetryChar = pCtrl->createCharacteristic(
+        "1a2b0006-5e6f-4a5b-8c9d-0e1f2a3b4c5d",
+        NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR | NIMBLE_PROPERTY::NOTIFY);
+    if (s_pTelemetryChar)
+      s_pTelemetryChar->setCallbacks(&s_telemetryCharCb);
+
+    /* Acknowledged commands: WRITE [reqId][cmd][paramLen][params] records, NOTIFY
+     * [reqId][status][depth][detail] (see BleCommandPipeline.h). */
+    s_pCommandChar = pCtrl->createCharacteristic(
+        "1a2b0007-5e6f-4a5b-8c9d-0e1f2a3b4c5d",
+        NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR | NIMBLE_PROPERTY::NOTIFY);
+    if (s_pCommandChar)
+      s_pCommandChar->setCallbacks(&s_commandCharCb);
+
+    /* Bulk download fallback: WRITE requests, NOTIFY frames (see BleBulkTransfer.h); CoC preferred. */
+    s_pBulkChar = pCtrl->createCharacteristic(
+        "1a2b0009-5e6f-4a5b-8c9d-0e1f2a3b4c5d",
+        NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR | NIMBLE_PROPERTY::NOTIFY);
+    if (s_pBulkChar)
+      s_pBulkChar->setCallbacks(&s_bulkCharCb);
+
+#if NOCT_BLE_BEACON_ENABLED
+    /* Beacon key: READ over an encrypted link only (Just Works pairing on first read). */
+    loadBeaconKey();
+    NimBLECharacteristic *pKey = pCtrl->createCharacteristic(
+        "1a2b0008-5e6f-4a5b-8c9d-0e1f2a3b4c5d",
+        NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::READ_ENC);
+    if (pKey)
+      pKey->setValue(beaconKey_, sizeof(beaconKey_));
+#endif
 
     pCtrl->start();
   }
+#if NOCT_BLE_BULK_COC
+  int coc = ble_l2cap_create_server(BLE_BULK_PSM, BLE_BULK_COC_MTU, bulkL2capEvent, nullptr);
+#if NOCT_BMW_DEBUG
+  if (coc != 0)
+    Serial.printf("[BMW BLE] L2CAP CoC server (PSM 0x%04X) failed: %d\n", BLE_BULK_PSM, coc);
+#else
+  (void)coc;
+#endif
+#endif
   NimBLEAdvertising *pAdvertising = NimBLEDevice::getAdvertising();
   if (pAdvertising) {
+#if NOCT_BLE_BEACON_ENABLED
+    beacon_.update(BleBeaconStatus(), millis());
+    saveBeaconNonce();
+    pushAdvertisingData();
+#else
     pAdvertising->addServiceUUID("1800");
     pAdvertising->addServiceUUID("1a2b0001-5e6f-4a5b-8c9d-0e1f2a3b4c5d");
+#endif
     pAdvertising->setScanResponse(true);
     pAdvertising->start();
   }
   active_ = true;
   connected_ = false;
-  disconnectPending_ = false;
 #if NOCT_BMW_DEBUG
-  Serial.println("[BMW BLE] begin OK, advertising started (name: BMW E39 Key)");
+  Serial.printf("[BMW BLE] begin OK, advertising started (name: BMW E39 Key, up to %u phones)\n",
+                (unsigned)kMaxLinks);
 #endif
 #endif
 }
@@ -196,8 +512,35 @@ void BleKeyService::end() {
     vQueueDelete(commandQueue_);
     commandQueue_ = nullptr;
   }
+  if (linkQueue_ != nullptr) {
+    vQueueDelete(linkQueue_);
+    linkQueue_ = nullptr;
+  }
+  if (inboundQueue_ != nullptr) {
+    vQueueDelete(inboundQueue_);
+    inboundQueue_ = nullptr;
+  }
+  if (bulkQueue_ != nullptr) {
+    vQueueDelete(bulkQueue_);
+    bulkQueue_ = nullptr;
+  }
+#endif
+#if NOCT_BLE_BULK_COC
+  s_bulkChan.store(nullptr);
 #endif
+  closeBulk();
+  s_pBulkChar = nullptr;
   s_pStatusChar = nullptr;
+  s_pTelemetryChar = nullptr;
+  s_pCommandChar = nullptr;
+  telemetry_.stop();
+  telemetry_.consume();
+  telemetry_.setMtu(BLE_TLM_MTU_DEFAULT);
+  pendingTelemetryCfg_.store(0);
+  telemetryOwner_ = BLE_PEER_HANDLE_NONE;
+  peers_.clear();
+  hostLinks_.store(0);
+  power_ = BlePowerPolicy();
   NimBLEAdvertising *pAdvertising = NimBLEDevice::getAdvertising();
   if (pAdvertising)
     pAdvertising->stop();
@@ -208,9 +551,8 @@ void BleKeyService::end() {
   s_keyService = nullptr;
   active_ = false;
   connected_ = false;
-  disconnectPending_ = false;
-  lastStatusPacketValid_ = false;
-  forceNotifyOnce_ = false;
+  reportedConnected_ = false;
+  lastStatusValueHash_ = 0;
   lastDemoNotifyMs_ = 0;
 #endif
 }
@@ -250,84 +592,628 @@ void BleKeyService::updateStatus(bool ibusSynced, bool phoneConnected, bool pdcV
     buf[14] = 0xFF, buf[15] = 0xFF;
 
   const unsigned long now = millis();
-  const bool forceOnce = forceNotifyOnce_;
+#if NOCT_BLE_BEACON_ENABLED
+  BleBeaconStatus bs;
+  bs.ibusSynced = ibusSynced;
+  bs.phoneConnected = phoneConnected;
+  bs.obdConnected = obdConnected;
+  bs.lockState = lockState;
+  bs.ignition = ignition;
+  bs.doorByte1 = doorByte1;
+  bs.doorByte2 = doorByte2;
+  bs.coolantC = coolantC;
+  bs.oilC = oilC;
+  bs.odometerKm = odometerKm;
+  if (beacon_.update(bs, (uint32_t)now)) {
+    saveBeaconNonce();
+    pushAdvertisingData();
+  }
+#endif
   const bool demoPeriodic = demoMode_ && connected_ &&
       (now - lastDemoNotifyMs_ >= kDemoNotifyIntervalMs);
-  if (forceOnce)
-    forceNotifyOnce_ = false;
   if (demoPeriodic)
     lastDemoNotifyMs_ = now;
 
-  bool changed = !lastStatusPacketValid_;
-  if (!changed) {
-    for (size_t i = 0; i < kStatusPacketLen; i++)
-      if (lastStatusPacket_[i] != buf[i]) {
-        changed = true;
-        break;
-      }
+  /* One packet, one hash; each subscribed phone gets it once (new subscribers right away). */
+  const uint32_t hash = blePeerHash(buf, kStatusPacketLen);
+  if (hash != lastStatusValueHash_) {
+    s_pStatusChar->setValue(buf, kStatusPacketLen);  /* READ sees the latest even without subscribers */
+    lastStatusValueHash_ = hash;
   }
-  if (changed || forceOnce || demoPeriodic) {
-    for (size_t i = 0; i < kStatusPacketLen; i++)
-      lastStatusPacket_[i] = buf[i];
-    lastStatusPacketValid_ = true;
-    s_pStatusChar->setValue(buf, kStatusPacketLen);
-    s_pStatusChar->notify();
+  const uint32_t t0 = micros();
+  const uint8_t targets = peers_.statusTargets(hash, demoPeriodic);
+  if (!targets)
+    return;
+  for (size_t i = 0; i < BlePeerTable::kMaxPeers; i++)
+    if (targets & (1u << i))
+      s_pStatusChar->notify(buf, kStatusPacketLen, true, peers_.peer(i).connHandle);
+  const uint32_t us = micros() - t0;
+  fanoutUsSum_ += us;
+  fanoutCount_++;
+  if (us > fanoutUsMax_)
+    fanoutUsMax_ = us;
+#endif
+}
+
+void BleKeyService::loadBeaconKey() {
+  Preferences prefs;
+  prefs.begin("nocturne", false);
+  if (prefs.getBytes("ble_bcn", beaconKey_, sizeof(beaconKey_)) != sizeof(beaconKey_)) {
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+    for (size_t i = 0; i < sizeof(beaconKey_); i += 4) {
+      uint32_t r = esp_random();
+      memcpy(beaconKey_ + i, &r, 4);
+    }
+#endif
+    prefs.putBytes("ble_bcn", beaconKey_, sizeof(beaconKey_));
   }
+  const uint16_t lastNonce = prefs.getUShort("ble_bcn_n", 0);
+  prefs.end();
+  beacon_.setKey(beaconKey_);
+  beacon_.setNonce(lastNonce);
+}
+
+void BleKeyService::saveBeaconNonce() {
+  uint16_t mark;
+  if (!beacon_.takeNonceReserve(&mark))
+    return;
+  Preferences prefs;
+  prefs.begin("nocturne", false);
+  prefs.putUShort("ble_bcn_n", mark);
+  prefs.end();
+}
+
+void BleKeyService::pushAdvertisingData() {
+#if __has_include("NimBLEDevice.h")
+  NimBLEAdvertising *pAdvertising = NimBLEDevice::getAdvertising();
+  if (!pAdvertising)
+    return;
+  /* 31 bytes each: flags (3) + service UUID (18) + beacon (10); name (13) + beacon (15).
+   * Custom data goes to the controller right away, no advertising restart. */
+  NimBLEAdvertisementData adv;
+  adv.setFlags(BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP);
+  adv.setCompleteServices(NimBLEUUID("1a2b0001-5e6f-4a5b-8c9d-0e1f2a3b4c5d"));
+  adv.setManufacturerData(std::string(reinterpret_cast<const char *>(beacon_.advData()), BLE_BEACON_ADV_LEN));
+  NimBLEAdvertisementData scan;
+  scan.setName("BMW E39 Key");
+  scan.setManufacturerData(std::string(reinterpret_cast<const char *>(beacon_.scanData()), BLE_BEACON_SCAN_LEN));
+  pAdvertising->setAdvertisementData(adv);
+  pAdvertising->setScanResponseData(scan);
 #endif
 }
 
-void BleKeyService::onClusterTextReceived(const uint8_t *data, size_t len) {
-  if (!clusterTextCb_ || !data || len == 0)
+void BleKeyService::onTelemetryControlReceived(uint16_t connHandle, const uint8_t *data, size_t len) {
+  if (!data || len == 0)
+    return;
+  activityPending_.store(true);
+  uint32_t cfg = (1u << 24) | data[0];
+  cfg |= (uint32_t)(len >= 2 ? data[1] : BLE_TLM_SIG_ALL) << 8;
+  if (len >= 3)
+    cfg |= (uint32_t)data[2] << 16;
+  pendingTelemetryOwner_.store(connHandle);
+  pendingTelemetryCfg_.store(cfg);
+#if NOCT_BMW_DEBUG
+  Serial.printf("[BMW BLE] Telemetry ctrl: rate=%u Hz mask=0x%02X\n", data[0],
+                len >= 2 ? data[1] : BLE_TLM_SIG_ALL);
+#endif
+}
+
+void BleKeyService::applyPendingTelemetryConfig() {
+  uint32_t cfg = pendingTelemetryCfg_.exchange(0);
+  if (!(cfg & (1u << 24)))
     return;
-  static char textBuf[21];
-  size_t n = len < 20 ? len : 20;
-  memcpy(textBuf, data, n);
-  textBuf[n] = '\0';
+  /* The stream belongs to the phone that wrote last; a phone already gone is ignored. */
+  const uint16_t owner = pendingTelemetryOwner_.load();
+  const int idx = peers_.find(owner);
+  if (idx < 0)
+    return;
+  if (owner != telemetryOwner_ && telemetry_.isRunning()) {
+    telemetry_.stop();
+    telemetry_.consume();
+    applyConnParams(telemetryOwner_);  /* previous owner back to the profile's interval */
+  }
+  telemetryOwner_ = owner;
+  telemetry_.setMtu(peers_.peer(idx).mtu);
+  const bool wasRunning = telemetry_.isRunning();
+  const uint8_t ctrl[3] = {(uint8_t)(cfg & 0xFF), (uint8_t)((cfg >> 8) & 0xFF),
+                           (uint8_t)((cfg >> 16) & 0xFF)};
+  telemetry_.configureFromWrite(ctrl, 3);
+  if (!wasRunning && telemetry_.isRunning())
+    requestLowLatencyLink(owner);
+  else if (wasRunning && !telemetry_.isRunning())
+    applyConnParams(owner);  /* back to the profile's connection interval */
+}
+
+void BleKeyService::requestLowLatencyLink(uint16_t connHandle) {
+#if __has_include("NimBLEDevice.h")
+  NimBLEServer *pServer = NimBLEDevice::getServer();
+  if (!pServer || connHandle == BLE_PEER_HANDLE_NONE)
+    return;
+  pServer->updateConnParams(connHandle, kStreamConnIntervalMin, kStreamConnIntervalMax, 0,
+                            kStreamSupervisionTimeout);
+#if defined(CONFIG_IDF_TARGET_ESP32S3) || defined(CONFIG_IDF_TARGET_ESP32C3)
+  /* BLE 5 controller: prefer 2M PHY; phones without it keep 1M. */
+  ble_gap_set_prefered_le_phy(connHandle, BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_2M_MASK,
+                              BLE_GAP_LE_PHY_CODED_ANY);
+#endif
+#else
+  (void)connHandle;
+#endif
+}
+
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+/** Nearest supported TX level at or below dbm (levels common to ESP32 and ESP32-S3). */
+static esp_power_level_t txPowerLevel(int8_t dbm) {
+  if (dbm >= 9) return ESP_PWR_LVL_P9;
+  if (dbm >= 6) return ESP_PWR_LVL_P6;
+  if (dbm >= 3) return ESP_PWR_LVL_P3;
+  if (dbm >= 0) return ESP_PWR_LVL_N0;
+  if (dbm >= -3) return ESP_PWR_LVL_N3;
+  if (dbm >= -6) return ESP_PWR_LVL_N6;
+  if (dbm >= -9) return ESP_PWR_LVL_N9;
+  return ESP_PWR_LVL_N12;
+}
+#endif
+
+void BleKeyService::tickPowerProfile(unsigned long now) {
+  const bool wasConnected = power_.connected();
+  if (activityPending_.exchange(false))
+    power_.noteActivity(now);
+  power_.setIgnition(powerIgnition_, now);
+  power_.setBattery(powerBatteryPct_, powerExternal_);
+  power_.setConnected(connected_, now);
+  bool changed = power_.update(now);
 #if NOCT_BMW_DEBUG
-  Serial.printf("[BMW BLE] Cluster text from phone: \"%s\"\n", textBuf);
+  if (!wasConnected && connected_) {
+    const BleReconnectStats &rs = power_.reconnectStats(power_.profile());
+    if (rs.count)
+      Serial.printf("[BMW BLE] Reconnect in %s: %lu ms (avg %lu, n=%lu)\n", bleProfileName(power_.profile()),
+                    (unsigned long)rs.lastMs, (unsigned long)rs.avgMs(), (unsigned long)rs.count);
+  }
 #endif
-  clusterTextCb_(textBuf);
+  /* New link: push the profile's connection parameters (phone picks its own defaults). */
+  if (changed || (!wasConnected && connected_))
+    applyPowerProfile();
+}
+
+/* NVS record per phone: addr[6], rssiAt1m, pathLossX10. */
+struct ProximityCalRecord {
+  uint8_t addr[6];
+  int8_t rssiAt1m;
+  uint8_t pathLossX10;
+};
+
+void BleKeyService::loadProximityCalibration(BlePeer &peer) {
+  BleProximityCalibration cal;
+  ProximityCalRecord recs[kProximityPhones];
+  Preferences prefs;
+  prefs.begin("nocturne", true);
+  size_t n = prefs.getBytes("ble_prox", recs, sizeof(recs));
+  prefs.end();
+  for (size_t i = 0; i < n / sizeof(ProximityCalRecord); i++) {
+    if (memcmp(recs[i].addr, peer.addr, sizeof(peer.addr)) == 0) {
+      cal.rssiAt1m = recs[i].rssiAt1m;
+      cal.pathLossX10 = recs[i].pathLossX10;
+      break;
+    }
+  }
+  peer.proximity.setCalibration(cal);
+  peer.calibrationLoaded = true;
+}
+
+bool BleKeyService::calibrateProximity(float distanceM) {
+  /* The phone that sent the command; with a single phone connected, that one. */
+  int idx = peers_.find(commandOrigin_);
+  if (idx < 0 && peers_.linkedCount() == 1) {
+    for (size_t i = 0; i < BlePeerTable::kMaxPeers; i++)
+      if (peers_.peer(i).linked)
+        idx = (int)i;
+  }
+  if (idx < 0)
+    return false;
+  BlePeer &peer = peers_.peer(idx);
+  if (!peer.proximity.calibrateAt(distanceM))
+    return false;
+  ProximityCalRecord recs[kProximityPhones];
+  Preferences prefs;
+  prefs.begin("nocturne", false);
+  size_t count = prefs.getBytes("ble_prox", recs, sizeof(recs)) / sizeof(ProximityCalRecord);
+  /* Replace this phone's record, else append, else drop the oldest (slot 0). */
+  size_t slot = count;
+  for (size_t i = 0; i < count; i++)
+    if (memcmp(recs[i].addr, peer.addr, sizeof(peer.addr)) == 0)
+      slot = i;
+  if (slot == (size_t)kProximityPhones) {
+    memmove(&recs[0], &recs[1], sizeof(ProximityCalRecord) * (kProximityPhones - 1));
+    slot = kProximityPhones - 1;
+  }
+  memcpy(recs[slot].addr, peer.addr, sizeof(peer.addr));
+  recs[slot].rssiAt1m = peer.proximity.calibration().rssiAt1m;
+  recs[slot].pathLossX10 = peer.proximity.calibration().pathLossX10;
+  if (slot == count)
+    count++;
+  prefs.putBytes("ble_prox", recs, count * sizeof(ProximityCalRecord));
+  prefs.end();
+#if NOCT_BMW_DEBUG
+  Serial.printf("[BMW BLE] Proximity calibrated (phone %d): %d dBm @ 1 m\n", idx,
+                peer.proximity.calibration().rssiAt1m);
+#endif
+  return true;
+}
+
+void BleKeyService::tickProximity(unsigned long now) {
+#if __has_include("NimBLEDevice.h")
+  const int idx = peers_.nextRssiPeer((uint32_t)now, kRssiSampleIntervalMs);
+  if (idx < 0)
+    return;
+  BlePeer &peer = peers_.peer(idx);
+  int8_t rssi = 0;
+  if (ble_gap_conn_rssi(peer.connHandle, &rssi) != 0)
+    return;
+  BleProximityEvent evt = peer.proximity.addSample(rssi, (uint32_t)now);
+  if (evt == PROX_EVT_NONE)
+    return;
+  activityPending_.store(true);
+  const BleProximityEvent carEvt = peers_.carEvent((size_t)idx, evt);
+#if NOCT_BMW_DEBUG
+  static const char *const kEvtNames[] = {"-", "APPROACH", "NEAR", "LEAVING"};
+  Serial.printf("[BMW BLE] Proximity %s (phone %d): %.1f dBm (~%.1f m), car: %s\n", kEvtNames[evt], idx,
+                (double)peer.proximity.filteredRssi(), (double)peer.proximity.estimatedDistanceM(),
+                kEvtNames[carEvt]);
+#endif
+  if (carEvt != PROX_EVT_NONE && proximityCb_)
+    proximityCb_(carEvt);
+#else
+  (void)now;
+#endif
+}
+
+void BleKeyService::applyConnParams(uint16_t connHandle) {
+#if __has_include("NimBLEDevice.h")
+  const BleProfileParams &p = power_.params();
+  NimBLEServer *pServer = NimBLEDevice::getServer();
+  /* Telemetry stream keeps its own 7.5-15 ms interval until it stops. */
+  if (!pServer || peers_.find(connHandle) < 0 || (telemetry_.isRunning() && connHandle == telemetryOwner_))
+    return;
+  pServer->updateConnParams(connHandle, p.connIntervalMin, p.connIntervalMax, p.slaveLatency,
+                            p.supervisionTimeout);
+#else
+  (void)connHandle;
+#endif
+}
+
+void BleKeyService::applyPowerProfile() {
+#if __has_include("NimBLEDevice.h")
+  const BleProfileParams &p = power_.params();
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  NimBLEDevice::setPower(txPowerLevel(p.txPowerDbm), ESP_BLE_PWR_TYPE_ADV);
+  NimBLEDevice::setPower(txPowerLevel(p.txPowerDbm), ESP_BLE_PWR_TYPE_DEFAULT);
+#endif
+  NimBLEAdvertising *pAdvertising = NimBLEDevice::getAdvertising();
+  if (pAdvertising) {
+    pAdvertising->setMinInterval(p.advIntervalMin);
+    pAdvertising->setMaxInterval(p.advIntervalMax);
+    if (pAdvertising->isAdvertising()) {
+      pAdvertising->stop();
+      pAdvertising->start();
+    }
+  }
+  for (size_t i = 0; i < BlePeerTable::kMaxPeers; i++)
+    if (peers_.peer(i).linked)
+      applyConnParams(peers_.peer(i).connHandle);
+#if NOCT_BMW_DEBUG
+  Serial.printf("[BMW BLE] Power profile %s: adv %u ms, conn %u ms lat %u, duty ~%.2f%%\n",
+                bleProfileName(power_.profile()), (unsigned)(p.advIntervalMin * 5 / 8),
+                (unsigned)(p.connIntervalMin * 5 / 4), (unsigned)p.slaveLatency,
+                (double)(bleProfileRadioDutyCycle(p, connected_) * 100.0f));
+#endif
+#endif
+}
+
+void BleKeyService::updateTelemetry(const BleTelemetrySample &current) {
+#if __has_include("NimBLEDevice.h")
+  if (!active_)
+    return;
+  applyPendingTelemetryConfig();
+  bool ready = telemetry_.frameLen() > 0;  /* batch closed by a config/MTU change */
+  if (connected_ && s_pTelemetryChar)
+    ready = telemetry_.offer(current, millis()) || ready;
+  if (!ready || telemetry_.frameLen() == 0)
+    return;
+  if (connected_ && s_pTelemetryChar && peers_.find(telemetryOwner_) >= 0)
+    s_pTelemetryChar->notify(telemetry_.frame(), telemetry_.frameLen(), true, telemetryOwner_);
+  telemetry_.consume();
+#else
+  (void)current;
+#endif
+}
+
+void BleKeyService::onClusterTextReceived(const uint8_t *data, size_t len) {
+  activityPending_.store(true);
+  postInboundWrite(1, data, len);
 }
 
 void BleKeyService::onNowPlayingReceived(const uint8_t *data, size_t len) {
-  if (!nowPlayingCb_ || !data || len == 0)
+  activityPending_.store(true);
+  postInboundWrite(0, data, len);
+}
+
+void BleKeyService::postInboundWrite(uint8_t kind, const uint8_t *data, size_t len) {
+  if (!data || len == 0)
+    return;
+  InboundWrite w;
+  w.kind = kind;
+  w.len = (uint8_t)(len < sizeof(w.data) ? len : sizeof(w.data));
+  memcpy(w.data, data, w.len);
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  if (inboundQueue_ == nullptr || xQueueSend(inboundQueue_, &w, 0) != pdTRUE)
+    inboundDropped_.fetch_add(1);
+#else
+  applyInboundWrite(w, millis());
+#endif
+}
+
+void BleKeyService::applyInboundWrite(const InboundWrite &w, unsigned long now) {
+  if (w.kind == 1) {
+    clusterText_.offer(w.data, w.len, (uint32_t)now);
     return;
-  const char *p = reinterpret_cast<const char *>(data);
-  size_t trackLen = 0;
-  while (trackLen < len && p[trackLen] != '\0')
-    trackLen++;
-  const char *artist = (trackLen < len - 1) ? (p + trackLen + 1) : "";
-  size_t artistLen = 0;
-  while (artistLen < len - (trackLen + 1) && artist[artistLen] != '\0')
-    artistLen++;
-  static char trackBuf[96];
-  static char artistBuf[96];
-  size_t tMax = sizeof(trackBuf) - 1;
-  size_t aMax = sizeof(artistBuf) - 1;
-  if (trackLen > tMax)
-    trackLen = tMax;
-  if (artistLen > aMax)
-    artistLen = aMax;
-  memcpy(trackBuf, p, trackLen);
-  trackBuf[trackLen] = '\0';
-  memcpy(artistBuf, artist, artistLen);
-  artistBuf[artistLen] = '\0';
+  }
+  BleMediaInfo info;
+  if (bleParseNowPlaying(w.data, w.len, &info))
+    media_.offer(info, (uint32_t)now);
 #if NOCT_BMW_DEBUG
-  Serial.printf("[BMW BLE] Now Playing from phone: \"%s\" - \"%s\"\n", trackBuf, artistBuf);
+  else
+    Serial.printf("[BMW BLE] Now Playing: malformed batch (%u bytes)\n", (unsigned)w.len);
 #endif
-  nowPlayingCb_(trackBuf, artistBuf);
+}
+
+void BleKeyService::tickInboundText(unsigned long now) {
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  InboundWrite w;
+  while (inboundQueue_ != nullptr && xQueueReceive(inboundQueue_, &w, 0) == pdTRUE)
+    applyInboundWrite(w, now);
+#endif
+  char text[BLE_CLUSTER_TEXT_MAX + 1];
+  if (clusterText_.poll((uint32_t)now, text, sizeof(text))) {
+#if NOCT_BMW_DEBUG
+    Serial.printf("[BMW BLE] Cluster text from phone: \"%s\" (%lu writes)\n", text,
+                  (unsigned long)clusterText_.writes());
+#endif
+    if (clusterTextCb_)
+      clusterTextCb_(text);
+  }
+  BleMediaInfo info;
+  if (media_.poll((uint32_t)now, &info)) {
+#if NOCT_BMW_DEBUG
+    Serial.printf("[BMW BLE] Now Playing from phone: \"%s\" - \"%s\" [%s] (%lu writes, %lu updates, %lu dropped)\n",
+                  info.track, info.artist, info.album, (unsigned long)media_.writes(),
+                  (unsigned long)media_.emitted(), (unsigned long)inboundDropped_.load());
+#endif
+    if (nowPlayingCb_)
+      nowPlayingCb_(info);
+  }
+}
+
+void BleKeyService::onCommandWriteReceived(uint16_t connHandle, const uint8_t *data, size_t len) {
+  activityPending_.store(true);
+  size_t n = commandPipeline_.submitWrite(data, len, millis(), connHandle);
+#if NOCT_BMW_DEBUG
+  Serial.printf("[BMW BLE] Command write (handle %u): %u bytes, %u queued\n", (unsigned)connHandle,
+                (unsigned)len, (unsigned)n);
+#else
+  (void)n;
+#endif
+}
+
+uint8_t BleKeyService::executeAttributed(const BleCommand &c, uint16_t tag, uint8_t *writes, void *ctx) {
+  BleKeyService *self = (BleKeyService *)ctx;
+  self->commandOrigin_ = c.origin;
+  int idx = self->peers_.find(c.origin);
+  if (idx >= 0)
+    self->peers_.peer(idx).commands++;
+  uint8_t r = self->commandExec_(c, tag, writes, self->commandExecCtx_);
+  self->commandOrigin_ = BLE_PEER_HANDLE_NONE;
+  return r;
+}
+
+void BleKeyService::tickCommandPipeline(unsigned long now) {
+#if __has_include("NimBLEDevice.h")
+  commandPipeline_.process((uint32_t)now, commandExec_ ? executeAttributed : nullptr, this);
+  /* Statuses go to the phone that sent the command (reqIds are per phone), sized to its MTU. */
+  uint8_t buf[32 * BLE_CMD_NOTIFY_RECORD_LEN];
+  while (commandPipeline_.pendingNotifications() > 0) {
+    uint16_t origin = commandPipeline_.nextNotificationOrigin();
+    const int idx = peers_.find(origin);
+    size_t cap = (size_t)(idx >= 0 ? peers_.peer(idx).mtu : BLE_TLM_MTU_DEFAULT) - BLE_TLM_NOTIFY_OVERHEAD;
+    if (cap > sizeof(buf))
+      cap = sizeof(buf);
+    const size_t n = commandPipeline_.takeNotifications(buf, cap, &origin);
+    if (n == 0)
+      break;
+    if (idx >= 0 && s_pCommandChar)
+      s_pCommandChar->notify(buf, n, true, origin);
+  }
+#else
+  (void)now;
+#endif
+}
+
+void BleKeyService::onBulkChannel(uint16_t connHandle, bool up) {
+  activityPending_.store(true);
+  BulkEvent ev = {};
+  ev.kind = up ? BLE_BULK_EV_UP : BLE_BULK_EV_DOWN;
+  ev.transport = BLE_BULK_TRANSPORT_COC;
+  ev.connHandle = connHandle;
+  postBulkEvent(ev);
+}
+
+void BleKeyService::onBulkRequestReceived(uint16_t connHandle, uint8_t transport, const uint8_t *data,
+                                          size_t len) {
+  if (!data || len == 0)
+    return;
+  activityPending_.store(true);
+  BulkEvent ev = {};
+  ev.kind = BLE_BULK_EV_REQUEST;
+  ev.transport = transport;
+  ev.connHandle = connHandle;
+  ev.len = (uint8_t)(len < sizeof(ev.data) ? len : sizeof(ev.data));
+  memcpy(ev.data, data, ev.len);
+  postBulkEvent(ev);
+}
+
+void BleKeyService::postBulkEvent(const BulkEvent &ev) {
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  if (bulkQueue_ != nullptr)
+    xQueueSend(bulkQueue_, &ev, 0);
+#else
+  applyBulkEvent(ev);
+#endif
+}
+
+void BleKeyService::closeBulk() {
+  bulk_.reset();
+  bulkTransport_ = 0;
+  bulkOwner_ = BLE_PEER_HANDLE_NONE;
+  bulkFrameLen_ = 0;
+  bulkWasStreaming_ = false;
+  bulkStalled_.store(false);
+}
+
+void BleKeyService::applyBulkEvent(const BulkEvent &ev) {
+  switch (ev.kind) {
+    case BLE_BULK_EV_UP:
+      /* The channel replaces a GATT fallback session (the phone resumes from its last offset). */
+      closeBulk();
+      bulkTransport_ = BLE_BULK_TRANSPORT_COC;
+      bulkOwner_ = ev.connHandle;
+#if NOCT_BMW_DEBUG
+      Serial.printf("[BMW BLE] Bulk channel open (handle %u, PSM 0x%04X)\n", (unsigned)ev.connHandle,
+                    BLE_BULK_PSM);
+#endif
+      break;
+    case BLE_BULK_EV_DOWN:
+      if (bulkTransport_ == BLE_BULK_TRANSPORT_COC && ev.connHandle == bulkOwner_)
+        closeBulk();
+      break;
+    case BLE_BULK_EV_REQUEST:
+      /* GATT fallback: the first phone to ask owns the session until it goes idle. */
+      if (bulkTransport_ == 0 && ev.transport == BLE_BULK_TRANSPORT_GATT) {
+        bulkTransport_ = BLE_BULK_TRANSPORT_GATT;
+        bulkOwner_ = ev.connHandle;
+      }
+      if (ev.transport != bulkTransport_ || ev.connHandle != bulkOwner_) {
+        bulkBusyRejects_++;
+        break;
+      }
+      bulk_.onRequest(ev.data, ev.len);
+      break;
+    default:
+      break;
+  }
+}
+
+bool BleKeyService::sendBulkFrame(size_t len) {
+#if __has_include("NimBLEDevice.h")
+  if (bulkTransport_ == BLE_BULK_TRANSPORT_GATT) {
+    if (!s_pBulkChar || peers_.find(bulkOwner_) < 0)
+      return false;
+    s_pBulkChar->notify(bulkFrame_, len, true, bulkOwner_);
+    return true;
+  }
+#if NOCT_BLE_BULK_COC
+  ble_l2cap_chan *chan = s_bulkChan.load();
+  if (!chan || bulkStalled_.load())
+    return false;
+  os_mbuf *sdu = os_msys_get_pkthdr((uint16_t)len, 0);
+  if (!sdu)
+    return false;
+  if (os_mbuf_append(sdu, bulkFrame_, (uint16_t)len) != 0) {
+    os_mbuf_free_chain(sdu);
+    return false;
+  }
+  /* Stalled before sending: TX_UNSTALLED may arrive on the host task before ble_l2cap_send() returns. */
+  bulkStalled_.store(true);
+  const int rc = ble_l2cap_send(chan, sdu);
+  if (rc == BLE_HS_ESTALLED)
+    return true;  /* queued; out of credits until TX_UNSTALLED */
+  bulkStalled_.store(false);
+  if (rc == 0)
+    return true;
+  os_mbuf_free_chain(sdu);  /* not taken (previous SDU still going out): same frame next tick */
+  return false;
+#endif
+#endif
+  (void)len;
+  return false;
+}
+
+void BleKeyService::tickBulk(unsigned long now) {
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  BulkEvent ev;
+  while (bulkQueue_ != nullptr && xQueueReceive(bulkQueue_, &ev, 0) == pdTRUE)
+    applyBulkEvent(ev);
+#endif
+  if (bulkTransport_ == 0)
+    return;
+  if (bulk_.streaming() && !bulkWasStreaming_) {
+    bulkWasStreaming_ = true;
+    bulkStartMs_ = now;
+    bulkStartBytes_ = bulk_.bytesSent();
+  }
+  size_t cap = sizeof(bulkFrame_);
+  int budget = kBulkCocFramesPerTick;
+  if (bulkTransport_ == BLE_BULK_TRANSPORT_GATT) {
+    const int idx = peers_.find(bulkOwner_);
+    cap = (size_t)(idx >= 0 ? peers_.peer(idx).mtu : BLE_TLM_MTU_DEFAULT) - BLE_TLM_NOTIFY_OVERHEAD;
+    budget = kBulkGattFramesPerTick;
+  }
+#if NOCT_BLE_BULK_COC
+  else {
+    ble_l2cap_chan_info info;
+    ble_l2cap_chan *chan = s_bulkChan.load();
+    if (chan && ble_l2cap_get_chan_info(chan, &info) == 0 && info.peer_coc_mtu < cap)
+      cap = info.peer_coc_mtu;
+  }
+#endif
+  for (int i = 0; i < budget; i++) {
+    if (bulkFrameLen_ == 0)
+      bulkFrameLen_ = bulk_.nextFrame(bulkFrame_, cap);
+    if (bulkFrameLen_ == 0 || !sendBulkFrame(bulkFrameLen_))
+      break;
+    bulkFrameLen_ = 0;
+  }
+  if (bulkWasStreaming_ && !bulk_.streaming()) {
+    /* Rate over the whole READ: time from the request to the last frame handed to the stack. */
+    bulkWasStreaming_ = false;
+    const uint32_t bytes = bulk_.bytesSent() - bulkStartBytes_;
+    const unsigned long ms = now - bulkStartMs_;
+    if (bytes > 0 && ms > 0) {
+      bulkLastRateBps_ = (uint32_t)((uint64_t)bytes * 1000u / ms);
+      bulkLastTransport_ = bulkTransport_;
+#if NOCT_BMW_DEBUG
+      Serial.printf("[BMW BLE] Bulk %s: %lu bytes in %lu ms = %lu B/s (%lu window stalls, %lu gaps)\n",
+                    bulkTransport_ == BLE_BULK_TRANSPORT_COC ? "CoC" : "GATT", (unsigned long)bytes,
+                    (unsigned long)ms, (unsigned long)bulkLastRateBps_, (unsigned long)bulk_.windowStalls(),
+                    (unsigned long)bulk_.gaps());
+#endif
+    }
+  }
+  if (bulkTransport_ == BLE_BULK_TRANSPORT_GATT && !bulk_.streaming() && bulkFrameLen_ == 0)
+    bulkTransport_ = 0, bulkOwner_ = BLE_PEER_HANDLE_NONE;  /* idle: another phone may ask */
 }
 
 void BleKeyService::tick() {
 #if __has_include("NimBLEDevice.h")
+  unsigned long now = millis();
+  if (active_)
+    tickPeers(now);
   processCommandQueue();
-  if (!active_ || !disconnectPending_)
+  if (!active_)
     return;
-  unsigned long now = millis();
-  if (now - disconnectReportedAt_ >= kDisconnectDebounceMs) {
-    disconnectPending_ = false;
-    if (connectionCb_)
-      connectionCb_(false);
-  }
+  tickCommandPipeline(now);
+  tickInboundText(now);
+  tickBulk(now);
+  tickPowerProfile(now);
+  tickProximity(now);
 #endif
 }
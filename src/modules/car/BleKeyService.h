@@ -1,17 +1,45 @@
 /*
  * NOCTURNE_OS — BLE key: peripheral for proximity unlock/lock.
- * Phone connects = unlock, disconnects (after debounce) = lock.
+ * Up to BlePeerTable::kMaxPeers phones stay connected at once; each has its own proximity filter,
+ * subscriptions and command statuses. First phone connects = unlock, last one gone (after linger) = lock.
  */
 #ifndef NOCTURNE_BLE_KEY_SERVICE_H
 #define NOCTURNE_BLE_KEY_SERVICE_H
 
 #include <Arduino.h>
+#include <atomic>
 #include <cstdint>
+#include "BleBulkTransfer.h"
+#include "BleCommandPipeline.h"
+#include "BleMediaWrite.h"
+#include "BlePeerTable.h"
+#include "BlePowerProfile.h"
+#include "BleProximity.h"
+#include "BleStatusBeacon.h"
+#include "BleTelemetry.h"
 #if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #endif
 
+/** Link event from the NimBLE host task, applied to the peer table in tick(). */
+struct BleLinkEvent {
+  uint8_t type;  /* BLE_LINK_* */
+  uint8_t addr[6];
+  uint16_t connHandle;
+  uint16_t value;  /* MTU, or subscription bits | 0x100 when subscribing */
+};
+#define BLE_LINK_UP 1
+#define BLE_LINK_DOWN 2
+#define BLE_LINK_MTU 3
+#define BLE_LINK_SUBSCRIBE 4
+
+#define BLE_BULK_TRANSPORT_COC 1
+#define BLE_BULK_TRANSPORT_GATT 2
+#define BLE_BULK_EV_UP 1
+#define BLE_BULK_EV_DOWN 2
+#define BLE_BULK_EV_REQUEST 3
+
 class BleKeyService {
  public:
   BleKeyService();
@@ -19,44 +47,109 @@ class BleKeyService {
   void end();
   void tick();
 
+  /** At least one phone connected. */
   bool isConnected() const { return connected_; }
+  size_t connectedPhones() const { return peers_.linkedCount(); }
   bool isActive() const { return active_; }
 
+  /** true when the first phone connects, false when the last one is gone for BlePeerTable::kLingerMs. */
   void setConnectionCallback(void (*cb)(bool connected)) { connectionCb_ = cb; }
 
   /** Optional: when phone writes to BMW control characteristic, this is called with cmd 0..11 (Goodbye..DoorLock). */
   void setLightCommandCallback(void (*cb)(uint8_t cmd)) { lightCommandCb_ = cb; }
 
-  /** Optional: when phone writes to Now Playing characteristic (track\\0artist), this is called. */
-  void setNowPlayingCallback(void (*cb)(const char *track, const char *artist)) { nowPlayingCb_ = cb; }
+  /** Optional: Now Playing text changed (legacy track\\0artist or batch write, see BleMediaWrite.h).
+   * Called from tick() once per debounced burst. */
+  void setNowPlayingCallback(void (*cb)(const BleMediaInfo &info)) { nowPlayingCb_ = cb; }
+  /** Latest merged Now Playing, including duration / position. */
+  const BleMediaInfo &nowPlaying() const { return media_.current(); }
+  const BleMediaDebouncer &mediaDebouncer() const { return media_; }
 
   /** Update status characteristic (READ/NOTIFY). Call from BmwManager::tick().
    * lastMflAction: 0=none, 1=next, 2=prev, 3=play_pause, 4=vol_up, 5=vol_down.
    * doorByte1, doorByte2: GM 0x7a; lockState: 0=unlocked, 1=locked, 2=double, 0xFF=unknown;
-   * ignition: 0=off, 1=pos1, 2=pos2, -1=unknown; odometerKm: -1 = unknown. */
+   * ignition: 0=off, 1=pos1, 2=pos2, -1=unknown; odometerKm: -1 = unknown.
+   * Each subscribed phone is notified once per distinct packet. */
   void updateStatus(bool ibusSynced, bool phoneConnected, bool pdcValid, bool obdConnected,
                    int coolantC, int oilC, int rpm, const int *pdcDists, uint8_t lastMflAction,
                    uint8_t doorByte1 = 0xFF, uint8_t doorByte2 = 0xFF, uint8_t lockState = 0xFF,
                    int ignition = -1, int odometerKm = -1);
 
-  /** Optional: when phone writes to cluster-text characteristic, this is called with UTF-8 string (max 20 bytes). */
+  /** Optional: cluster-text characteristic written; UTF-8 string (max 20 bytes), debounced, from tick(). */
   void setClusterTextCallback(void (*cb)(const char *text)) { clusterTextCb_ = cb; }
-  /** Called from NimBLE when cluster text characteristic is written (internal). */
+  /** Called from NimBLE when cluster text characteristic is written (internal, no heap). */
   void onClusterTextReceived(const uint8_t *data, size_t len);
 
   /** Called from NimBLE when control characteristic is written (internal). */
-  void onLightCommandReceived(uint8_t cmd);
+  void onLightCommandReceived(uint16_t connHandle, uint8_t cmd);
   /** Drain command queue and invoke lightCommandCb_ (call from main loop/tick, not from BLE callback). */
   void processCommandQueue();
-  /** Called from NimBLE when Now Playing characteristic is written (internal). */
+  /** Called from NimBLE when Now Playing characteristic is written (internal, no heap). */
   void onNowPlayingReceived(const uint8_t *data, size_t len);
 
-  /** Called from NimBLE server callbacks (internal). */
-  void onConnect();
-  void onDisconnect();
+  /** Called from NimBLE server / characteristic callbacks (internal). peerAddr: 6-byte identity address. */
+  void onLinkUp(uint16_t connHandle, const uint8_t *peerAddr);
+  void onLinkDown(uint16_t connHandle);
+  void onMtuChanged(uint16_t connHandle, uint16_t mtu);
+  void onSubscribeChanged(uint16_t connHandle, uint8_t sub, bool on);
+
+  /** Next updateStatus() notifies every subscribed phone even if the packet did not change. */
+  void requestStatusNotifyOnNextUpdate() { peers_.invalidateStatus(); }
+
+  /** Telemetry stream (1a2b0006): call every tick with current values; samples at the client-requested
+   * rate and notifies MTU-sized delta-encoded batches to the phone that started it. */
+  void updateTelemetry(const BleTelemetrySample &current);
+  bool isTelemetryStreaming() const { return telemetry_.isRunning(); }
+  const BleTelemetryStream &telemetryStream() const { return telemetry_; }
+  /** Called from NimBLE when telemetry control is written: [rateHz][mask][batch/10ms] (internal). */
+  void onTelemetryControlReceived(uint16_t connHandle, const uint8_t *data, size_t len);
+
+  /** Power profile inputs (call from BmwManager::tick()); tick() switches PARKED/APPROACH/DRIVING.
+   * ignition: 0=off, 1=pos1, 2=pos2, -1=unknown; externalPower: USB/car supply, battery ignored. */
+  void setPowerInputs(int ignition, int batteryPct, bool externalPower) {
+    powerIgnition_ = ignition;
+    powerBatteryPct_ = batteryPct;
+    powerExternal_ = externalPower;
+  }
+  /** Door unlock / key fob etc.: keep fast advertising so the approaching phone reconnects quickly. */
+  void noteProximityActivity() { activityPending_.store(true); }
+  const BlePowerPolicy &powerPolicy() const { return power_; }
+
+  /** RSSI proximity: car-level events APPROACH / NEAR / LEAVING from tick() (see BlePeerTable::carEvent). */
+  void setProximityCallback(void (*cb)(BleProximityEvent evt)) { proximityCb_ = cb; }
+  bool proximityWarm() const { return peers_.anyProximityWarm(); }
+  const BlePeerTable &peers() const { return peers_; }
+  /** The phone that sent the current command is distanceM from the board: store its calibration (NVS). */
+  bool calibrateProximity(float distanceM);
+
+  /** Acknowledged commands (1a2b0007): tick() ACKs, runs exec for each queued command and notifies
+   * ACK / DONE / FAIL to the phone that sent it. exec tags its I-Bus writes; report their TX results
+   * through onCommandTxDone(). */
+  void setCommandExecutor(BleCommandPipeline::Executor exec, void *ctx) {
+    commandExec_ = exec;
+    commandExecCtx_ = ctx;
+  }
+  void onCommandTxDone(uint16_t tag, bool ok) { commandPipeline_.onTxDone(tag, ok, millis()); }
+  const BleCommandPipeline &commandPipeline() const { return commandPipeline_; }
+  /** Called from NimBLE when the command characteristic is written (internal). */
+  void onCommandWriteReceived(uint16_t connHandle, const uint8_t *data, size_t len);
+
+  /** Status beacon: advertising manufacturer data refreshed by updateStatus() (see BleStatusBeacon.h). */
+  const BleStatusBeacon &statusBeacon() const { return beacon_; }
 
-  /** Call from onConnect so next updateStatus() will notify (phone gets current status immediately). */
-  void requestStatusNotifyOnNextUpdate() { lastStatusPacketValid_ = false; }
+  /** Status fan-out cost (updateStatus() with at least one notify). */
+  uint32_t statusFanoutAvgUs() const { return fanoutCount_ ? (uint32_t)(fanoutUsSum_ / fanoutCount_) : 0; }
+  uint32_t statusFanoutMaxUs() const { return fanoutUsMax_; }
+
+  /** Bulk history download (BleBulkTransfer.h): register sources here; one phone at a time. */
+  BleBulkSession &bulk() { return bulk_; }
+  /** Sustained DATA rate of the last completed transfer, bytes/s (0 = none yet); transport 1 = CoC, 2 = GATT. */
+  uint32_t bulkLastRateBps() const { return bulkLastRateBps_; }
+  uint8_t bulkLastTransport() const { return bulkLastTransport_; }
+  /** From the NimBLE host task: L2CAP channel up/down, request frames (CoC SDU or 1a2b0009 write). */
+  void onBulkChannel(uint16_t connHandle, bool up);
+  void onBulkRequestReceived(uint16_t connHandle, uint8_t transport, const uint8_t *data, size_t len);
+  void onBulkTxUnstalled() { bulkStalled_.store(false); }
 
   /** Enable periodic status notify when connected (e.g. every 1s in DEMO) so app gets data even if first notify was lost. */
   void setDemoMode(bool enable) { demoMode_ = enable; }
@@ -64,27 +157,133 @@ class BleKeyService {
  private:
   bool active_ = false;
   bool connected_ = false;
-  bool forceNotifyOnce_ = false;
+  bool reportedConnected_ = false;
   bool demoMode_ = false;
   unsigned long lastDemoNotifyMs_ = 0;
   static const unsigned long kDemoNotifyIntervalMs = 1000;
   void (*connectionCb_)(bool) = nullptr;
   void (*lightCommandCb_)(uint8_t) = nullptr;
-  void (*nowPlayingCb_)(const char *track, const char *artist) = nullptr;
+  void (*nowPlayingCb_)(const BleMediaInfo &info) = nullptr;
   void (*clusterTextCb_)(const char *text) = nullptr;
 
   static const size_t kStatusPacketLen = 16;
-  uint8_t lastStatusPacket_[kStatusPacketLen];
-  bool lastStatusPacketValid_ = false;
+  uint32_t lastStatusValueHash_ = 0;
+  uint64_t fanoutUsSum_ = 0;
+  uint32_t fanoutCount_ = 0;
+  uint32_t fanoutUsMax_ = 0;
+
+  /** Phones: link events queued by the NimBLE host task, applied in tick(). */
+  void postLinkEvent(const BleLinkEvent &ev);
+  void applyLinkEvent(const BleLinkEvent &ev, unsigned long now);
+  void tickPeers(unsigned long now);
+  BlePeerTable peers_;
+  /** Links as seen by the host task (restart advertising while below the limit). */
+  std::atomic<uint8_t> hostLinks_{0};
+  /** Phone whose command is being executed (calibration and stats are attributed to it). */
+  uint16_t commandOrigin_ = BLE_PEER_HANDLE_NONE;
+
+  /** Telemetry: config arrives on the NimBLE host task and is applied in updateTelemetry(). */
+  void applyPendingTelemetryConfig();
+  void requestLowLatencyLink(uint16_t connHandle);
+  BleTelemetryStream telemetry_;
+  std::atomic<uint32_t> pendingTelemetryCfg_{0};  /* bit24 = valid, [23:16] batch/10, [15:8] mask, [7:0] rate */
+  std::atomic<uint16_t> pendingTelemetryOwner_{BLE_PEER_HANDLE_NONE};
+  uint16_t telemetryOwner_ = BLE_PEER_HANDLE_NONE;
+  /** Power profile: activity flag set from the NimBLE host task, consumed in tick(). */
+  void tickPowerProfile(unsigned long now);
+  void applyPowerProfile();
+  void applyConnParams(uint16_t connHandle);
+  BlePowerPolicy power_;
+  std::atomic<bool> activityPending_{false};
+  int powerIgnition_ = -1;
+  int powerBatteryPct_ = -1;
+  bool powerExternal_ = true;
+
+  /** Proximity: each phone's RSSI sampled every kRssiSampleIntervalMs, one phone per tick. */
+  void tickProximity(unsigned long now);
+  void loadProximityCalibration(BlePeer &peer);
+  void (*proximityCb_)(BleProximityEvent evt) = nullptr;
+  static const unsigned long kRssiSampleIntervalMs = 200;
+  /** Calibrations kept for this many phones (NVS blob "ble_prox"). */
+  static const int kProximityPhones = 4;
+
+  /** Beacon: key in NVS ("ble_bcn"), frames pushed as custom advertising / scan response data. */
+  void loadBeaconKey();
+  /** Persists the nonce reservation mark ("ble_bcn_n") when the beacon moved past it. */
+  void saveBeaconNonce();
+  void pushAdvertisingData();
+  BleStatusBeacon beacon_;
+  uint8_t beaconKey_[BLE_BEACON_KEY_LEN] = {0};
+
+  /** Now Playing / cluster text: raw writes queued by the NimBLE host task, parsed and debounced in tick(). */
+  struct InboundWrite {
+    uint8_t kind;  /* 0 = Now Playing, 1 = cluster text */
+    uint8_t len;
+    uint8_t data[BLE_MEDIA_MAX_WRITE];
+  };
+  void postInboundWrite(uint8_t kind, const uint8_t *data, size_t len);
+  void applyInboundWrite(const InboundWrite &w, unsigned long now);
+  void tickInboundText(unsigned long now);
+  BleMediaDebouncer media_;
+  BleTextDebouncer clusterText_;
+  std::atomic<uint32_t> inboundDropped_{0};
+
+  /** Command pipeline: submitWrite() on the NimBLE host task, everything else in tick(). */
+  void tickCommandPipeline(unsigned long now);
+  static uint8_t executeAttributed(const BleCommand &c, uint16_t tag, uint8_t *writes, void *ctx);
+  BleCommandPipeline commandPipeline_;
+  BleCommandPipeline::Executor commandExec_ = nullptr;
+  void *commandExecCtx_ = nullptr;
+
+  /** Bulk download: requests / channel events queued by the NimBLE host task, frames sent in tick(). */
+  struct BulkEvent {
+    uint8_t kind;  /* BLE_BULK_EV_* */
+    uint8_t transport;
+    uint16_t connHandle;
+    uint8_t len;
+    uint8_t data[BLE_BULK_READ_LEN];
+  };
+  void postBulkEvent(const BulkEvent &ev);
+  void applyBulkEvent(const BulkEvent &ev);
+  void tickBulk(unsigned long now);
+  bool sendBulkFrame(size_t len);
+  void closeBulk();
+  BleBulkSession bulk_;
+  uint8_t bulkTransport_ = 0;  /* BLE_BULK_TRANSPORT_* of the current owner, 0 = none */
+  uint16_t bulkOwner_ = BLE_PEER_HANDLE_NONE;
+  std::atomic<bool> bulkStalled_{false};
+  uint8_t bulkFrame_[BLE_BULK_COC_MTU];
+  size_t bulkFrameLen_ = 0;  /* built but not yet accepted by the stack */
+  uint32_t bulkBusyRejects_ = 0;
+  bool bulkWasStreaming_ = false;
+  unsigned long bulkStartMs_ = 0;
+  uint32_t bulkStartBytes_ = 0;
+  uint32_t bulkLastRateBps_ = 0;
+  uint8_t bulkLastTransport_ = 0;
+  /** CoC: SDUs handed to the stack per tick (each is up to 8 LL packets; the stack queues them). */
+  static const int kBulkCocFramesPerTick = 4;
+  /** GATT fallback: notify() has no back-pressure, so a fixed budget per tick keeps mbufs free. */
+  static const int kBulkGattFramesPerTick = 4;
 
-  /** Debounce: delay before reporting disconnect (avoid brief dropouts). */
-  static const unsigned long kDisconnectDebounceMs = 2500;
-  unsigned long disconnectReportedAt_ = 0;
-  bool disconnectPending_ = false;
+  /** Short connection interval while streaming: 7.5..15 ms, no slave latency, 2 s supervision. */
+  static const uint16_t kStreamConnIntervalMin = 6;
+  static const uint16_t kStreamConnIntervalMax = 12;
+  static const uint16_t kStreamSupervisionTimeout = 200;
 
 #if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  /** Legacy 1-byte command with the connection it came from. */
+  struct QueuedCommand {
+    uint16_t connHandle;
+    uint8_t cmd;
+  };
   static const size_t kCommandQueueLen = 16;
   QueueHandle_t commandQueue_ = nullptr;
+  static const size_t kLinkQueueLen = 16;
+  QueueHandle_t linkQueue_ = nullptr;
+  static const size_t kInboundQueueLen = 4;
+  QueueHandle_t inboundQueue_ = nullptr;
+  static const size_t kBulkQueueLen = 8;
+  QueueHandle_t bulkQueue_ = nullptr;
 #endif
 };
 
@@ -0,0 +1,167 @@
+/*
+ * NOCTURNE_OS — inbound media writes: Now Playing parser (legacy / batch), debouncers.
+ */
+#include "BleMediaWrite.h"
+#include <cstring>
+
+void bleMediaClear(BleMediaInfo *m) {
+  if (!m)
+    return;
+  m->track[0] = '\0';
+  m->artist[0] = '\0';
+  m->album[0] = '\0';
+  m->durationMs = 0;
+  m->positionMs = 0;
+  m->fields = 0;
+}
+
+size_t bleCopyUtf8(char *dst, size_t cap, const uint8_t *src, size_t len) {
+  if (!dst || cap == 0)
+    return 0;
+  size_t n = 0;
+  while (n < len && src[n] != '\0')
+    n++;
+  if (n > cap - 1) {
+    n = cap - 1;
+    /* Back off to the start of a sequence: continuation bytes are 10xxxxxx. */
+    size_t lead = n;
+    while (lead > 0 && (src[lead] & 0xC0) == 0x80)
+      lead--;
+    n = lead;
+  }
+  memcpy(dst, src, n);
+  dst[n] = '\0';
+  return n;
+}
+
+static uint32_t rdU32(const uint8_t *p, size_t len) {
+  uint32_t v = 0;
+  for (size_t i = 0; i < len && i < 4; i++)
+    v |= (uint32_t)p[i] << (8 * i);
+  return v;
+}
+
+bool bleParseNowPlaying(const uint8_t *data, size_t len, BleMediaInfo *out) {
+  if (!out)
+    return false;
+  bleMediaClear(out);
+  if (!data || len == 0)
+    return false;
+  if (data[0] != BLE_MEDIA_BATCH_MARKER) {
+    /* Legacy: track\0artist. */
+    size_t trackLen = 0;
+    while (trackLen < len && data[trackLen] != '\0')
+      trackLen++;
+    bleCopyUtf8(out->track, sizeof(out->track), data, trackLen);
+    out->fields = BLE_MEDIA_F_TRACK | BLE_MEDIA_F_ARTIST;
+    if (trackLen + 1 < len)
+      bleCopyUtf8(out->artist, sizeof(out->artist), data + trackLen + 1, len - trackLen - 1);
+    return true;
+  }
+  size_t i = 1;
+  while (i < len) {
+    if (i + 2 > len)
+      return false;
+    const uint8_t type = data[i];
+    const size_t vlen = data[i + 1];
+    const uint8_t *v = data + i + 2;
+    if (i + 2 + vlen > len)
+      return false;
+    switch (type) {
+      case BLE_MEDIA_T_TRACK:
+        bleCopyUtf8(out->track, sizeof(out->track), v, vlen);
+        out->fields |= BLE_MEDIA_F_TRACK;
+        break;
+      case BLE_MEDIA_T_ARTIST:
+        bleCopyUtf8(out->artist, sizeof(out->artist), v, vlen);
+        out->fields |= BLE_MEDIA_F_ARTIST;
+        break;
+      case BLE_MEDIA_T_ALBUM:
+        bleCopyUtf8(out->album, sizeof(out->album), v, vlen);
+        out->fields |= BLE_MEDIA_F_ALBUM;
+        break;
+      case BLE_MEDIA_T_DURATION:
+        if (vlen != 4)
+          return false;
+        out->durationMs = rdU32(v, vlen);
+        out->fields |= BLE_MEDIA_F_DURATION;
+        break;
+      case BLE_MEDIA_T_POSITION:
+        if (vlen != 4)
+          return false;
+        out->positionMs = rdU32(v, vlen);
+        out->fields |= BLE_MEDIA_F_POSITION;
+        break;
+      default:
+        break;  /* newer app, newer field */
+    }
+    i += 2 + vlen;
+  }
+  return out->fields != 0;
+}
+
+void bleMediaMerge(BleMediaInfo *dst, const BleMediaInfo &src) {
+  if (!dst)
+    return;
+  if (src.fields & BLE_MEDIA_F_TRACK)
+    memcpy(dst->track, src.track, sizeof(dst->track));
+  if (src.fields & BLE_MEDIA_F_ARTIST)
+    memcpy(dst->artist, src.artist, sizeof(dst->artist));
+  if (src.fields & BLE_MEDIA_F_ALBUM)
+    memcpy(dst->album, src.album, sizeof(dst->album));
+  if (src.fields & BLE_MEDIA_F_DURATION)
+    dst->durationMs = src.durationMs;
+  if (src.fields & BLE_MEDIA_F_POSITION)
+    dst->positionMs = src.positionMs;
+  dst->fields |= src.fields;
+}
+
+void BleMediaDebouncer::offer(const BleMediaInfo &m, uint32_t nowMs) {
+  writes_++;
+  bleMediaMerge(&current_, m);
+  if (!(m.fields & BLE_MEDIA_F_TEXT))
+    return;  /* progress only: nothing for the bus */
+  if (!pending_)
+    firstMs_ = nowMs;
+  pending_ = true;
+  lastMs_ = nowMs;
+}
+
+bool BleMediaDebouncer::poll(uint32_t nowMs, BleMediaInfo *out) {
+  if (!pending_)
+    return false;
+  if (nowMs - lastMs_ < kQuietMs && nowMs - firstMs_ < kMaxHoldMs)
+    return false;
+  pending_ = false;
+  if (strcmp(current_.track, sentTrack_) == 0 && strcmp(current_.artist, sentArtist_) == 0 &&
+      strcmp(current_.album, sentAlbum_) == 0) {
+    unchanged_++;
+    return false;
+  }
+  memcpy(sentTrack_, current_.track, sizeof(sentTrack_));
+  memcpy(sentArtist_, current_.artist, sizeof(sentArtist_));
+  memcpy(sentAlbum_, current_.album, sizeof(sentAlbum_));
+  emitted_++;
+  if (out)
+    *out = current_;
+  return true;
+}
+
+void BleTextDebouncer::offer(const uint8_t *data, size_t len, uint32_t nowMs) {
+  writes_++;
+  bleCopyUtf8(text_, sizeof(text_), data, len);
+  pending_ = true;
+  lastMs_ = nowMs;
+}
+
+bool BleTextDebouncer::poll(uint32_t nowMs, char *out, size_t cap) {
+  if (!pending_ || nowMs - lastMs_ < kQuietMs)
+    return false;
+  pending_ = false;
+  emitted_++;
+  if (out && cap > 0) {
+    strncpy(out, text_, cap - 1);
+    out[cap - 1] = '\0';
+  }
+  return true;
+}
@@ -0,0 +1,101 @@
+/*
+ * NOCTURNE_OS — inbound media writes (Now Playing 1a2b0004, cluster text 1a2b0005): in-place parsers
+ * and a debouncer so a song change reaches the I-Bus text path once.
+ */
+#ifndef NOCTURNE_BLE_MEDIA_WRITE_H
+#define NOCTURNE_BLE_MEDIA_WRITE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define BLE_MEDIA_BATCH_MARKER 0x01
+#define BLE_MEDIA_T_TRACK 0x01
+#define BLE_MEDIA_T_ARTIST 0x02
+#define BLE_MEDIA_T_ALBUM 0x03
+#define BLE_MEDIA_T_DURATION 0x04
+#define BLE_MEDIA_T_POSITION 0x05
+
+/** BleMediaInfo::fields: what a write carried. */
+#define BLE_MEDIA_F_TRACK 0x01
+#define BLE_MEDIA_F_ARTIST 0x02
+#define BLE_MEDIA_F_ALBUM 0x04
+#define BLE_MEDIA_F_DURATION 0x08
+#define BLE_MEDIA_F_POSITION 0x10
+#define BLE_MEDIA_F_TEXT (BLE_MEDIA_F_TRACK | BLE_MEDIA_F_ARTIST | BLE_MEDIA_F_ALBUM)
+
+/** Largest write accepted on 1a2b0004 (one ATT write at MTU 247); longer writes are rejected by the stack. */
+#define BLE_MEDIA_MAX_WRITE 244
+/** Cluster text: IKE shows 20 characters. */
+#define BLE_CLUSTER_TEXT_MAX 20
+
+struct BleMediaInfo {
+  static const size_t kTextLen = 64;  /* bytes incl. terminator */
+  char track[kTextLen];
+  char artist[kTextLen];
+  char album[kTextLen];
+  uint32_t durationMs;
+  uint32_t positionMs;
+  uint8_t fields;
+};
+
+void bleMediaClear(BleMediaInfo *m);
+/** Parse a Now Playing write (legacy or batch) into out (cleared first). Returns false if malformed. */
+bool bleParseNowPlaying(const uint8_t *data, size_t len, BleMediaInfo *out);
+/** Fields present in src overwrite dst. */
+void bleMediaMerge(BleMediaInfo *dst, const BleMediaInfo &src);
+/** Copy at most cap-1 bytes of UTF-8 without splitting a sequence; stops at NUL. Returns bytes copied. */
+size_t bleCopyUtf8(char *dst, size_t cap, const uint8_t *src, size_t len);
+
+/**
+ * Debounce for the I-Bus text path: writes are merged; an update is emitted once the phone has been
+ * quiet for kQuietMs (or kMaxHoldMs after the first pending write), and only if track / artist / album
+ * differ from what was last emitted. Position / duration are merged into current() without an emit.
+ */
+class BleMediaDebouncer {
+ public:
+  static const uint32_t kQuietMs = 250;
+  static const uint32_t kMaxHoldMs = 1000;
+
+  void offer(const BleMediaInfo &m, uint32_t nowMs);
+  /** true = out holds the merged info and the text changed; send it to the cluster / MID. */
+  bool poll(uint32_t nowMs, BleMediaInfo *out);
+  const BleMediaInfo &current() const { return current_; }
+
+  uint32_t writes() const { return writes_; }
+  uint32_t emitted() const { return emitted_; }
+  /** Pending updates that went out without a text change (nothing sent to the bus). */
+  uint32_t unchanged() const { return unchanged_; }
+
+ private:
+  BleMediaInfo current_ = {};
+  char sentTrack_[BleMediaInfo::kTextLen] = {0};
+  char sentArtist_[BleMediaInfo::kTextLen] = {0};
+  char sentAlbum_[BleMediaInfo::kTextLen] = {0};
+  bool pending_ = false;
+  uint32_t firstMs_ = 0;
+  uint32_t lastMs_ = 0;
+  uint32_t writes_ = 0;
+  uint32_t emitted_ = 0;
+  uint32_t unchanged_ = 0;
+};
+
+/** Cluster text: latest write wins, emitted after kQuietMs (repeats are sent: the phone may refresh the IKE). */
+class BleTextDebouncer {
+ public:
+  static const uint32_t kQuietMs = BleMediaDebouncer::kQuietMs;
+
+  void offer(const uint8_t *data, size_t len, uint32_t nowMs);
+  bool poll(uint32_t nowMs, char *out, size_t cap);
+
+  uint32_t writes() const { return writes_; }
+  uint32_t emitted() const { return emitted_; }
+
+ private:
+  char text_[BLE_CLUSTER_TEXT_MAX + 1] = {0};
+  bool pending_ = false;
+  uint32_t lastMs_ = 0;
+  uint32_t writes_ = 0;
+  uint32_t emitted_ = 0;
+};
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * NOCTURNE_OS — BLE peer table: slots, linger, status fan-out, RSSI round robin.
+ */
+#include "BlePeerTable.h"
+#include <cstring>
+
+uint32_t blePeerHash(const uint8_t *data, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; data && i < len; i++) {
+    h ^= data[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+int BlePeerTable::onConnect(uint16_t handle, const uint8_t *addr, uint32_t nowMs, bool *reused) {
+  bool same = false;
+  int slot = -1;
+  /* Same phone back within the linger time: keep its proximity filter and stats. */
+  for (size_t i = 0; addr && i < kMaxPeers; i++) {
+    if (peers_[i].connHandle != BLE_PEER_HANDLE_NONE && !peers_[i].linked &&
+        memcmp(peers_[i].addr, addr, sizeof(peers_[i].addr)) == 0) {
+      slot = (int)i;
+      same = true;
+      break;
+    }
+  }
+  if (slot < 0) {
+    for (size_t i = 0; i < kMaxPeers; i++)
+      if (peers_[i].connHandle == BLE_PEER_HANDLE_NONE) {
+        slot = (int)i;
+        break;
+      }
+  }
+  if (slot < 0) {
+    /* Full: take the oldest lingering slot, never a linked one. */
+    for (size_t i = 0; i < kMaxPeers; i++)
+      if (!peers_[i].linked && (slot < 0 || peers_[i].disconnectedMs < peers_[slot].disconnectedMs))
+        slot = (int)i;
+    if (slot < 0)
+      return -1;
+  }
+  if (reused)
+    *reused = same;
+  BlePeer &p = peers_[slot];
+  if (!same) {
+    p = BlePeer();
+    if (addr)
+      memcpy(p.addr, addr, sizeof(p.addr));
+  }
+  p.connHandle = handle;
+  p.linked = true;
+  p.connectedMs = nowMs;
+  p.mtu = 23;
+  p.subs = 0;
+  p.statusSent = false;
+  return slot;
+}
+
+int BlePeerTable::onDisconnect(uint16_t handle, uint32_t nowMs) {
+  int i = find(handle);
+  if (i < 0)
+    return -1;
+  peers_[i].linked = false;
+  peers_[i].disconnectedMs = nowMs;
+  peers_[i].subs = 0;
+  return i;
+}
+
+void BlePeerTable::onMtu(uint16_t handle, uint16_t mtu) {
+  int i = find(handle);
+  if (i >= 0)
+    peers_[i].mtu = mtu;
+}
+
+void BlePeerTable::onSubscribe(uint16_t handle, uint8_t sub, bool on) {
+  int i = find(handle);
+  if (i < 0)
+    return;
+  if (on) {
+    peers_[i].subs |= sub;
+    if (sub & BLE_SUB_STATUS)
+      peers_[i].statusSent = false;  /* new subscriber gets the current status right away */
+  } else {
+    peers_[i].subs &= (uint8_t)~sub;
+  }
+}
+
+size_t BlePeerTable::expire(uint32_t nowMs) {
+  size_t n = 0;
+  for (size_t i = 0; i < kMaxPeers; i++) {
+    BlePeer &p = peers_[i];
+    if (p.connHandle != BLE_PEER_HANDLE_NONE && !p.linked && nowMs - p.disconnectedMs >= kLingerMs) {
+      p = BlePeer();
+      n++;
+    }
+  }
+  return n;
+}
+
+void BlePeerTable::clear() {
+  for (size_t i = 0; i < kMaxPeers; i++)
+    peers_[i] = BlePeer();
+}
+
+int BlePeerTable::find(uint16_t handle) const {
+  if (handle == BLE_PEER_HANDLE_NONE)
+    return -1;
+  for (size_t i = 0; i < kMaxPeers; i++)
+    if (peers_[i].linked && peers_[i].connHandle == handle)
+      return (int)i;
+  return -1;
+}
+
+size_t BlePeerTable::linkedCount() const {
+  size_t n = 0;
+  for (size_t i = 0; i < kMaxPeers; i++)
+    if (peers_[i].linked)
+      n++;
+  return n;
+}
+
+bool BlePeerTable::anyPresent() const {
+  for (size_t i = 0; i < kMaxPeers; i++)
+    if (peers_[i].connHandle != BLE_PEER_HANDLE_NONE)
+      return true;
+  return false;
+}
+
+uint8_t BlePeerTable::statusTargets(uint32_t hash, bool force) {
+  uint8_t mask = 0;
+  for (size_t i = 0; i < kMaxPeers; i++) {
+    BlePeer &p = peers_[i];
+    if (!p.linked || !(p.subs & BLE_SUB_STATUS))
+      continue;
+    if (!force && p.statusSent && p.statusHash == hash) {
+      p.notifiesSkipped++;
+      continue;
+    }
+    p.statusHash = hash;
+    p.statusSent = true;
+    p.notifies++;
+    mask |= (uint8_t)(1u << i);
+  }
+  return mask;
+}
+
+void BlePeerTable::invalidateStatus() {
+  for (size_t i = 0; i < kMaxPeers; i++)
+    peers_[i].statusSent = false;
+}
+
+int BlePeerTable::nextRssiPeer(uint32_t nowMs, uint32_t intervalMs) {
+  int best = -1;
+  for (size_t i = 0; i < kMaxPeers; i++) {
+    const BlePeer &p = peers_[i];
+    if (!p.linked || nowMs - p.lastRssiMs < intervalMs)
+      continue;
+    if (best < 0 || (int32_t)(p.lastRssiMs - peers_[best].lastRssiMs) < 0)
+      best = (int)i;
+  }
+  if (best >= 0)
+    peers_[best].lastRssiMs = nowMs;
+  return best;
+}
+
+bool BlePeerTable::anyProximityWarm() const {
+  for (size_t i = 0; i < kMaxPeers; i++)
+    if (peers_[i].linked && peers_[i].proximity.warm())
+      return true;
+  return false;
+}
+
+BleProximityEvent BlePeerTable::carEvent(size_t idx, BleProximityEvent evt) const {
+  if (evt != PROX_EVT_NEAR && evt != PROX_EVT_LEAVING)
+    return evt;
+  for (size_t i = 0; i < kMaxPeers; i++) {
+    if (i == idx || !peers_[i].linked)
+      continue;
+    BleProximityState s = peers_[i].proximity.state();
+    if (s == PROX_NEAR)
+      return PROX_EVT_NONE;
+    if (evt == PROX_EVT_LEAVING && s == PROX_APPROACHING)
+      return PROX_EVT_NONE;
+  }
+  return evt;
+}
@@ -0,0 +1,88 @@
+/*
+ * NOCTURNE_OS — BLE peer table: per-phone state (MTU, subscriptions, RSSI turn) for several
+ * connected centrals, fed from BleKeyService's link event queue.
+ */
+#ifndef NOCTURNE_BLE_PEER_TABLE_H
+#define NOCTURNE_BLE_PEER_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "BleProximity.h"
+
+#define BLE_PEER_HANDLE_NONE 0xFFFF
+
+/** Notify subscriptions (CCCD) tracked per phone. */
+#define BLE_SUB_STATUS 0x01
+#define BLE_SUB_TELEMETRY 0x02
+#define BLE_SUB_COMMAND 0x04
+
+struct BlePeer {
+  uint16_t connHandle = BLE_PEER_HANDLE_NONE;  /* NONE = free slot */
+  uint8_t addr[6] = {0};
+  bool linked = false;          /* false while lingering after a disconnect */
+  uint32_t connectedMs = 0;
+  uint32_t disconnectedMs = 0;
+  uint16_t mtu = 23;
+  uint8_t subs = 0;
+  /* Status fan-out: hash of the last packet notified to this phone. */
+  uint32_t statusHash = 0;
+  bool statusSent = false;
+  BleProximityTracker proximity;
+  bool calibrationLoaded = false;
+  uint32_t lastRssiMs = 0;
+  /* Stats. */
+  uint32_t commands = 0;
+  uint32_t notifies = 0;
+  uint32_t notifiesSkipped = 0;
+};
+
+/** FNV-1a over a notify payload (status packets are compared by hash, not kept per phone). */
+uint32_t blePeerHash(const uint8_t *data, size_t len);
+
+class BlePeerTable {
+ public:
+  /** Slots; BleKeyService keeps NimBLE's connection limit in line with this. */
+  static const size_t kMaxPeers = 4;
+  /** A dropped phone keeps its slot (and proximity state) this long; same address = same slot. */
+  static const uint32_t kLingerMs = 2500;
+
+  /** Link up. Returns slot index, or -1 if the table is full. *reused: slot was lingering for this addr. */
+  int onConnect(uint16_t handle, const uint8_t *addr, uint32_t nowMs, bool *reused = nullptr);
+  /** Link down: slot lingers. Returns slot index or -1. */
+  int onDisconnect(uint16_t handle, uint32_t nowMs);
+  void onMtu(uint16_t handle, uint16_t mtu);
+  void onSubscribe(uint16_t handle, uint8_t sub, bool on);
+  /** Free lingering slots older than kLingerMs. Returns how many were freed. */
+  size_t expire(uint32_t nowMs);
+  void clear();
+
+  int find(uint16_t handle) const;
+  BlePeer &peer(size_t idx) { return peers_[idx]; }
+  const BlePeer &peer(size_t idx) const { return peers_[idx]; }
+  size_t linkedCount() const;
+  /** Linked or still lingering (connection callback reports "gone" only when this is false). */
+  bool anyPresent() const;
+
+  /**
+   * Status fan-out: bit i set = notify peer i (linked, subscribed, last packet differs or force).
+   * Marks those peers as sent; counts skipped duplicates.
+   */
+  uint8_t statusTargets(uint32_t hash, bool force);
+  /** Next status notify goes to every subscribed phone (new subscriber, demo refresh). */
+  void invalidateStatus();
+
+  /** Linked phone whose RSSI is due (oldest sample first), or -1. One phone per call spreads the load. */
+  int nextRssiPeer(uint32_t nowMs, uint32_t intervalMs);
+  /** Any linked phone has a warmed-up proximity filter. */
+  bool anyProximityWarm() const;
+  /**
+   * Phone idx produced evt: what it means for the car. NEAR only when no other linked phone is already
+   * NEAR (doors are open); LEAVING only when no other linked phone is NEAR or APPROACHING.
+   */
+  BleProximityEvent carEvent(size_t idx, BleProximityEvent evt) const;
+
+ private:
+  BlePeer peers_[kMaxPeers];
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * NOCTURNE_OS — BLE power profiles: parameter table, radio duty-cycle model, profile state machine.
+ */
+#include "BlePowerProfile.h"
+
+/* Advertising units 0.625 ms, connection units 1.25 ms, supervision timeout 10 ms. */
+static const BleProfileParams kProfiles[BLE_PROFILE_COUNT] = {
+    /* PARKED: adv 1000-1200 ms, conn 100-150 ms, latency 4 (~0.75 s between radio wake-ups), 6 s timeout. */
+    {1600, 1920, 80, 120, 4, 600, -6},
+    /* APPROACH: adv 30-50 ms so a scanning phone sees us within one scan window. */
+    {48, 80, 24, 40, 0, 400, 9},
+    /* DRIVING: conn 15-30 ms for now-playing / commands; adv 100-150 ms to recover a dropped link. */
+    {160, 240, 12, 24, 0, 400, 3},
+};
+
+static const char *const kProfileNames[BLE_PROFILE_COUNT] = {"PARKED", "APPROACH", "DRIVING"};
+
+/* Airtime model (1M PHY): ADV_IND with 31-byte payload = 376 us, + 150 us IFS + scan-request
+ * listen window, + ~140 us synthesizer ramp per channel; 3 channels per advertising event.
+ * Empty connection event: ramp + TX/RX empty PDUs (80 us each) + IFS + window widening. */
+static const float kAdvEventUs = 3.0f * (140.0f + 376.0f + 150.0f + 100.0f);
+static const float kConnEventUs = 140.0f + 80.0f + 150.0f + 80.0f + 100.0f;
+/* advDelay: random 0..10 ms added to every advertising interval by the link layer. */
+static const float kAdvDelayMeanMs = 5.0f;
+
+const BleProfileParams &bleProfileParams(BlePowerProfile p) {
+  return kProfiles[p < BLE_PROFILE_COUNT ? p : BLE_PROFILE_PARKED];
+}
+
+const char *bleProfileName(BlePowerProfile p) {
+  return p < BLE_PROFILE_COUNT ? kProfileNames[p] : "?";
+}
+
+static float advMeanMs(const BleProfileParams &p) {
+  return (p.advIntervalMin + p.advIntervalMax) * 0.5f * 0.625f + kAdvDelayMeanMs;
+}
+
+static float connMeanMs(const BleProfileParams &p) {
+  return (p.connIntervalMin + p.connIntervalMax) * 0.5f * 1.25f;
+}
+
+float bleProfileRadioDutyCycle(const BleProfileParams &p, bool connected) {
+  if (connected) {
+    /* Peripheral may skip slaveLatency events when it has nothing to send. */
+    float periodMs = connMeanMs(p) * (1.0f + p.slaveLatency);
+    return (kConnEventUs / 1000.0f) / periodMs;
+  }
+  return (kAdvEventUs / 1000.0f) / advMeanMs(p);
+}
+
+uint32_t bleProfileExpectedDiscoveryMs(const BleProfileParams &p) {
+  /* Phone scanning continuously: on average half an advertising interval, then one connection interval. */
+  return (uint32_t)(advMeanMs(p) * 0.5f + connMeanMs(p) + 0.5f);
+}
+
+void BlePowerPolicy::setIgnition(int ignition, uint32_t nowMs) {
+  if (ignition == ignition_)
+    return;
+  ignition_ = ignition;
+  noteActivity(nowMs);
+}
+
+void BlePowerPolicy::noteActivity(uint32_t nowMs) {
+  lastActivityMs_ = nowMs;
+  activitySeen_ = true;
+}
+
+void BlePowerPolicy::setConnected(bool connected, uint32_t nowMs) {
+  if (connected == connected_)
+    return;
+  if (started_)
+    accumulate(nowMs);
+  connected_ = connected;
+  if (!connected) {
+    /* Phone walked away or link dropped: advertise fast for a while in case it comes back. */
+    noteActivity(nowMs);
+    awaitingReconnect_ = true;
+    return;
+  }
+  if (!awaitingReconnect_)
+    return;
+  awaitingReconnect_ = false;
+  /* Measured from the latest trigger (disconnect, door unlock, ignition change) to the new link. */
+  uint32_t dt = nowMs - lastActivityMs_;
+  BleReconnectStats &s = reconnect_[profile_];
+  if (s.count == 0 || dt < s.minMs)
+    s.minMs = dt;
+  if (dt > s.maxMs)
+    s.maxMs = dt;
+  s.lastMs = dt;
+  s.totalMs += dt;
+  s.count++;
+}
+
+void BlePowerPolicy::setBattery(int batteryPct, bool externalPower) {
+  lowBattery_ = !externalPower && batteryPct >= 0 && batteryPct < kLowBatteryPct;
+}
+
+BlePowerProfile BlePowerPolicy::desired(uint32_t nowMs) const {
+  if (ignition_ >= 1)
+    return BLE_PROFILE_DRIVING;
+  if (lowBattery_)
+    return BLE_PROFILE_PARKED;
+  if (activitySeen_ && nowMs - lastActivityMs_ < kApproachHoldMs)
+    return BLE_PROFILE_APPROACH;
+  return BLE_PROFILE_PARKED;
+}
+
+void BlePowerPolicy::accumulate(uint32_t nowMs) {
+  uint32_t dt = nowMs - lastAccumMs_;
+  timeMs_[profile_] += dt;
+  dutyWeightedMs_ += (float)dt * bleProfileRadioDutyCycle(params(), connected_);
+  lastAccumMs_ = nowMs;
+}
+
+bool BlePowerPolicy::update(uint32_t nowMs) {
+  if (!started_) {
+    /* Service just started (mode entered / boot): the phone is likely nearby. */
+    started_ = true;
+    noteActivity(nowMs);
+    profile_ = desired(nowMs);
+    enteredMs_ = nowMs;
+    lastAccumMs_ = nowMs;
+    return true;
+  }
+  BlePowerProfile next = desired(nowMs);
+  if (next == profile_ || nowMs - enteredMs_ < kMinDwellMs)
+    return false;
+  accumulate(nowMs);
+  profile_ = next;
+  enteredMs_ = nowMs;
+  switches_++;
+  return true;
+}
+
+uint32_t BlePowerPolicy::timeInProfileMs(BlePowerProfile p, uint32_t nowMs) const {
+  if (p >= BLE_PROFILE_COUNT)
+    return 0;
+  uint32_t t = timeMs_[p];
+  if (started_ && p == profile_)
+    t += nowMs - lastAccumMs_;
+  return t;
+}
+
+float BlePowerPolicy::averageDutyCycle(uint32_t nowMs) const {
+  if (!started_)
+    return 0.0f;
+  uint32_t pending = nowMs - lastAccumMs_;
+  uint32_t total = pending;
+  for (int i = 0; i < BLE_PROFILE_COUNT; i++)
+    total += timeMs_[i];
+  if (total == 0)
+    return bleProfileRadioDutyCycle(params(), connected_);
+  float weighted = dutyWeightedMs_ + (float)pending * bleProfileRadioDutyCycle(params(), connected_);
+  return weighted / (float)total;
+}
@@ -0,0 +1,101 @@
+/*
+ * NOCTURNE_OS — BLE power profiles (PARKED / APPROACH / DRIVING): advertising and connection
+ * parameters from ignition, BLE activity and battery. BleKeyService applies params().
+ */
+#ifndef NOCTURNE_BLE_POWER_PROFILE_H
+#define NOCTURNE_BLE_POWER_PROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum BlePowerProfile : uint8_t {
+  BLE_PROFILE_PARKED = 0,
+  BLE_PROFILE_APPROACH,
+  BLE_PROFILE_DRIVING,
+  BLE_PROFILE_COUNT
+};
+
+/** Radio parameters in Bluetooth units: advertising 0.625 ms, connection 1.25 ms, timeout 10 ms. */
+struct BleProfileParams {
+  uint16_t advIntervalMin;
+  uint16_t advIntervalMax;
+  uint16_t connIntervalMin;
+  uint16_t connIntervalMax;
+  uint16_t slaveLatency;
+  uint16_t supervisionTimeout;
+  int8_t txPowerDbm;
+};
+
+const BleProfileParams &bleProfileParams(BlePowerProfile p);
+const char *bleProfileName(BlePowerProfile p);
+
+/** Estimated fraction of time the radio is on (TX/RX + ramp-up) for this profile. */
+float bleProfileRadioDutyCycle(const BleProfileParams &p, bool connected);
+/** Expected time from the phone starting to scan to the first advertisement it can hear (ms). */
+uint32_t bleProfileExpectedDiscoveryMs(const BleProfileParams &p);
+
+struct BleReconnectStats {
+  uint32_t count = 0;
+  uint32_t lastMs = 0;
+  uint32_t minMs = 0;
+  uint32_t maxMs = 0;
+  uint32_t totalMs = 0;
+  uint32_t avgMs() const { return count ? totalMs / count : 0; }
+};
+
+/**
+ * Profile state machine. Feed inputs as they change, call update(now) every tick; it returns
+ * true when the profile changed (caller re-applies params()). Times are millis().
+ */
+class BlePowerPolicy {
+ public:
+  /** Stay in APPROACH this long after the last activity before dropping to PARKED. */
+  static const uint32_t kApproachHoldMs = 120000;
+  /** Minimum time in a profile before leaving it (ignition bounce / fast activity bursts). */
+  static const uint32_t kMinDwellMs = 2000;
+  /** Below this battery percentage (and not on external power) stay PARKED while ignition is off. */
+  static const int kLowBatteryPct = 15;
+
+  /** IKE ignition: -1 unknown, 0 off, 1 pos1, 2 run. A change counts as activity. */
+  void setIgnition(int ignition, uint32_t nowMs);
+  /** Phone write, command, door lock change: keeps APPROACH alive. */
+  void noteActivity(uint32_t nowMs);
+  /** Connection edges; a connect after a disconnect records reconnect time for the current profile. */
+  void setConnected(bool connected, uint32_t nowMs);
+  /** batteryPct 0..100; externalPower = USB/car supply (battery level ignored). */
+  void setBattery(int batteryPct, bool externalPower);
+
+  bool update(uint32_t nowMs);
+  BlePowerProfile profile() const { return profile_; }
+  const BleProfileParams &params() const { return bleProfileParams(profile_); }
+  bool connected() const { return connected_; }
+
+  const BleReconnectStats &reconnectStats(BlePowerProfile p) const { return reconnect_[p]; }
+  /** Time spent in profile p (ms), including the current stay up to nowMs. */
+  uint32_t timeInProfileMs(BlePowerProfile p, uint32_t nowMs) const;
+  /** Time-weighted estimated radio duty cycle since start (connected and advertising time). */
+  float averageDutyCycle(uint32_t nowMs) const;
+  uint32_t profileSwitches() const { return switches_; }
+
+ private:
+  BlePowerProfile desired(uint32_t nowMs) const;
+  void accumulate(uint32_t nowMs);
+
+  BlePowerProfile profile_ = BLE_PROFILE_APPROACH;
+  bool started_ = false;
+  int ignition_ = -1;
+  bool connected_ = false;
+  bool lowBattery_ = false;
+  uint32_t lastActivityMs_ = 0;
+  bool activitySeen_ = false;
+  uint32_t enteredMs_ = 0;
+  uint32_t disconnectedAtMs_ = 0;
+  bool awaitingReconnect_ = false;
+  uint32_t lastAccumMs_ = 0;
+  uint32_t timeMs_[BLE_PROFILE_COUNT] = {0, 0, 0};
+  float dutyWeightedMs_ = 0.0f;
+  uint32_t switches_ = 0;
+  BleReconnectStats reconnect_[BLE_PROFILE_COUNT];
+};
+
+#endif
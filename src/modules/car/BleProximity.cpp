@@ -0,0 +1,157 @@
+/*
+ * NOCTURNE_OS — BLE proximity: Kalman RSSI filter and approach/near/leaving state machine.
+ */
+#include "BleProximity.h"
+#include <cmath>
+
+void BleRssiKalman::reset() {
+  x0_ = x1_ = 0.0f;
+  p00_ = p01_ = p10_ = p11_ = 0.0f;
+  lastMs_ = 0;
+  n_ = 0;
+}
+
+float BleRssiKalman::update(float z, uint32_t nowMs) {
+  if (n_ == 0) {
+    x0_ = z;
+    x1_ = 0.0f;
+    p00_ = kMeasurementNoise;
+    p01_ = p10_ = 0.0f;
+    p11_ = 4.0f;  /* unknown walking rate: +-2 dB/s */
+    lastMs_ = nowMs;
+    n_ = 1;
+    return x0_;
+  }
+  float dt = (float)(nowMs - lastMs_) * 0.001f;
+  if (dt > 5.0f)
+    dt = 5.0f;
+  lastMs_ = nowMs;
+  /* Predict: x = F x, P = F P F' + Q (white-noise acceleration). */
+  x0_ += dt * x1_;
+  const float q = kProcessNoise;
+  const float dt2 = dt * dt;
+  float p00 = p00_ + dt * (p01_ + p10_) + dt2 * p11_ + q * dt2 * dt / 3.0f;
+  float p01 = p01_ + dt * p11_ + q * dt2 * 0.5f;
+  float p10 = p10_ + dt * p11_ + q * dt2 * 0.5f;
+  float p11 = p11_ + q * dt;
+  /* Update with innovation clamped to 3 sigma: a hand over the phone drops RSSI 10-20 dB for a moment. */
+  float s = p00 + kMeasurementNoise;
+  float y = z - x0_;
+  float lim = 3.0f * sqrtf(s);
+  if (y > lim)
+    y = lim;
+  else if (y < -lim)
+    y = -lim;
+  float k0 = p00 / s;
+  float k1 = p10 / s;
+  x0_ += k0 * y;
+  x1_ += k1 * y;
+  p00_ = p00 - k0 * p00;
+  p01_ = p01 - k0 * p01;
+  p10_ = p10 - k1 * p00;
+  p11_ = p11 - k1 * p01;
+  if (n_ < 0xFFFF)
+    n_++;
+  return x0_;
+}
+
+float BleProximityTracker::rssiAtDistance(const BleProximityCalibration &cal, float distanceM) {
+  return (float)cal.rssiAt1m - (float)cal.pathLossX10 * log10f(distanceM);
+}
+
+void BleProximityTracker::setCalibration(const BleProximityCalibration &cal) {
+  cal_ = cal;
+  if (cal_.pathLossX10 < 10)
+    cal_.pathLossX10 = 10;
+  nearDbm_ = rssiAtDistance(cal_, kNearM);
+  leaveDbm_ = rssiAtDistance(cal_, kLeaveM) - kHysteresisDb;
+  approachDbm_ = rssiAtDistance(cal_, kApproachM);
+  thresholdsValid_ = true;
+}
+
+void BleProximityTracker::reset() {
+  kf_.reset();
+  state_ = PROX_AWAY;
+  nearCandidate_ = false;
+  leaveCandidate_ = false;
+}
+
+float BleProximityTracker::estimatedDistanceM() const {
+  return powf(10.0f, ((float)cal_.rssiAt1m - kf_.level()) / (float)cal_.pathLossX10);
+}
+
+bool BleProximityTracker::calibrateAt(float distanceM) {
+  if (!warm() || distanceM <= 0.1f)
+    return false;
+  float at1m = kf_.level() + (float)cal_.pathLossX10 * log10f(distanceM);
+  if (at1m < -100.0f || at1m > -20.0f)
+    return false;
+  BleProximityCalibration c = cal_;
+  c.rssiAt1m = (int8_t)lroundf(at1m);
+  setCalibration(c);
+  return true;
+}
+
+BleProximityEvent BleProximityTracker::enter(BleProximityState s, BleProximityEvent evt) {
+  state_ = s;
+  nearCandidate_ = false;
+  leaveCandidate_ = false;
+  return evt;
+}
+
+BleProximityEvent BleProximityTracker::addSample(int rssiDbm, uint32_t nowMs) {
+  if (!thresholdsValid_)
+    setCalibration(cal_);
+  /* 0 / +127 = controller could not read RSSI. */
+  if (rssiDbm >= 0 || rssiDbm < -127)
+    return PROX_EVT_NONE;
+  kf_.update((float)rssiDbm, nowMs);
+  if (!warm())
+    return PROX_EVT_NONE;
+  const float lvl = kf_.level();
+  const float rate = kf_.rateDbPerS();
+
+  /* NEAR needs the level above threshold for kNearDwellMs (from any state but NEAR). */
+  if (state_ != PROX_NEAR) {
+    if (lvl >= nearDbm_) {
+      if (!nearCandidate_) {
+        nearCandidate_ = true;
+        nearSinceMs_ = nowMs;
+      }
+      if (nowMs - nearSinceMs_ >= kNearDwellMs)
+        return enter(PROX_NEAR, PROX_EVT_NEAR);
+    } else {
+      nearCandidate_ = false;
+    }
+  }
+
+  switch (state_) {
+    case PROX_AWAY:
+      if (lvl >= approachDbm_ || rate >= kApproachRateDbS)
+        return enter(PROX_APPROACHING, PROX_EVT_APPROACH);
+      break;
+    case PROX_APPROACHING:
+      /* Gave up / walked past: quietly back to AWAY (no lock: never reached the car). */
+      if (lvl < approachDbm_ - kHysteresisDb && rate < 0.0f)
+        return enter(PROX_AWAY, PROX_EVT_NONE);
+      break;
+    case PROX_NEAR:
+      if (lvl < leaveDbm_) {
+        if (!leaveCandidate_) {
+          leaveCandidate_ = true;
+          leaveSinceMs_ = nowMs;
+        }
+        if (nowMs - leaveSinceMs_ >= kLeaveDwellMs)
+          return enter(PROX_LEAVING, PROX_EVT_LEAVING);
+      } else {
+        leaveCandidate_ = false;
+      }
+      break;
+    case PROX_LEAVING:
+      /* Far enough that coming back counts as a new approach. */
+      if (lvl < approachDbm_ - kHysteresisDb)
+        return enter(PROX_AWAY, PROX_EVT_NONE);
+      break;
+  }
+  return PROX_EVT_NONE;
+}
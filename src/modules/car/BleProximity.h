@@ -0,0 +1,107 @@
+/*
+ * NOCTURNE_OS — BLE proximity: Kalman-filtered RSSI of the connected phone -> NEAR / LEAVING events,
+ * thresholds from a per-phone log-distance calibration.
+ */
+#ifndef NOCTURNE_BLE_PROXIMITY_H
+#define NOCTURNE_BLE_PROXIMITY_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum BleProximityState : uint8_t {
+  PROX_AWAY = 0,     /* no link, or far and not closing in */
+  PROX_APPROACHING,  /* link up and closing in / inside approach radius */
+  PROX_NEAR,         /* at the car */
+  PROX_LEAVING       /* was near, now walking away (link still up) */
+};
+
+enum BleProximityEvent : uint8_t {
+  PROX_EVT_NONE = 0,
+  PROX_EVT_APPROACH,
+  PROX_EVT_NEAR,
+  PROX_EVT_LEAVING
+};
+
+/** Per-phone path-loss model; rssiAt1m differs by 10-15 dB between phones and pockets. */
+struct BleProximityCalibration {
+  int8_t rssiAt1m = -62;
+  uint8_t pathLossX10 = 22;  /* path-loss exponent n * 10 */
+};
+
+/** Constant-velocity Kalman filter on RSSI samples. */
+class BleRssiKalman {
+ public:
+  void reset();
+  /** Add a sample taken at nowMs. Returns filtered level (dBm). */
+  float update(float rssiDbm, uint32_t nowMs);
+  float level() const { return x0_; }
+  float rateDbPerS() const { return x1_; }
+  uint16_t samples() const { return n_; }
+
+  /** Process noise (dB^2/s^3) and measurement noise (dB^2). */
+  static constexpr float kProcessNoise = 6.0f;
+  static constexpr float kMeasurementNoise = 20.0f;
+
+ private:
+  float x0_ = 0.0f;
+  float x1_ = 0.0f;
+  float p00_ = 0.0f, p01_ = 0.0f, p10_ = 0.0f, p11_ = 0.0f;
+  uint32_t lastMs_ = 0;
+  uint16_t n_ = 0;
+};
+
+class BleProximityTracker {
+ public:
+  /** Distances (m) that define the zones; converted to dBm through the calibration. */
+  static constexpr float kApproachM = 10.0f;
+  static constexpr float kNearM = 1.5f;
+  static constexpr float kLeaveM = 4.0f;
+  /** Margin below the kLeaveM level before LEAVING can start, and below kApproachM before AWAY. */
+  static constexpr float kHysteresisDb = 2.0f;
+  /** Rising faster than this counts as walking towards the car. */
+  static constexpr float kApproachRateDbS = 1.0f;
+  static const uint32_t kNearDwellMs = 400;
+  static const uint32_t kLeaveDwellMs = 1200;
+  /** Samples before the filter is trusted (first samples after connect are noisy). */
+  static const uint16_t kWarmupSamples = 3;
+
+  void setCalibration(const BleProximityCalibration &cal);
+  const BleProximityCalibration &calibration() const { return cal_; }
+  /** Link lost / new phone: back to AWAY, filter cleared. */
+  void reset();
+
+  /** Feed one RSSI sample (dBm). Returns the event produced by this sample, if any. */
+  BleProximityEvent addSample(int rssiDbm, uint32_t nowMs);
+
+  BleProximityState state() const { return state_; }
+  bool warm() const { return kf_.samples() >= kWarmupSamples; }
+  float filteredRssi() const { return kf_.level(); }
+  float rateDbPerS() const { return kf_.rateDbPerS(); }
+  float estimatedDistanceM() const;
+
+  /** The phone is distanceM from the antenna right now: fit rssiAt1m to the filtered level. */
+  bool calibrateAt(float distanceM);
+
+  float nearThresholdDbm() const { return nearDbm_; }
+  float leaveThresholdDbm() const { return leaveDbm_; }
+  float approachThresholdDbm() const { return approachDbm_; }
+
+  static float rssiAtDistance(const BleProximityCalibration &cal, float distanceM);
+
+ private:
+  BleProximityEvent enter(BleProximityState s, BleProximityEvent evt);
+
+  BleProximityCalibration cal_;
+  BleRssiKalman kf_;
+  BleProximityState state_ = PROX_AWAY;
+  float nearDbm_ = 0.0f;
+  float leaveDbm_ = 0.0f;
+  float approachDbm_ = 0.0f;
+  bool nearCandidate_ = false;
+  uint32_t nearSinceMs_ = 0;
+  bool leaveCandidate_ = false;
+  uint32_t leaveSinceMs_ = 0;
+  bool thresholdsValid_ = false;
+};
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * NOCTURNE_OS — BLE status beacon: encoder, XTEA-CTR / CBC-MAC, reference decoder.
+ */
+#include "BleStatusBeacon.h"
+#include <cstring>
+
+static void xteaEncrypt(const uint32_t *k, uint32_t *v) {
+  uint32_t v0 = v[0], v1 = v[1], sum = 0;
+  const uint32_t delta = 0x9E3779B9u;
+  for (int i = 0; i < 32; i++) {
+    v0 += (((v1 << 4) ^ (v1 >> 5)) + v1) ^ (sum + k[sum & 3]);
+    sum += delta;
+    v1 += (((v0 << 4) ^ (v0 >> 5)) + v0) ^ (sum + k[(sum >> 11) & 3]);
+  }
+  v[0] = v0;
+  v[1] = v1;
+}
+
+static uint32_t rd32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void wr32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static void loadKey(const uint8_t *key, uint32_t *k) {
+  for (int i = 0; i < 4; i++)
+    k[i] = key ? rd32(key + 4 * i) : 0;
+}
+
+/* 8 keystream bytes for one nonce: E(key, [nonce | "NB"][1]). */
+static void keystream(const uint32_t *k, uint16_t nonce, uint8_t *ks) {
+  uint32_t v[2] = {(uint32_t)nonce | 0x424E0000u, 1u};
+  xteaEncrypt(k, v);
+  wr32(ks, v[0]);
+  wr32(ks + 4, v[1]);
+}
+
+/* Fixed-length CBC-MAC over [version][nonce x2][core ct x4][ext ct x4], zero-padded to 16 bytes. */
+static uint32_t macTag(const uint32_t *k, uint16_t nonce, const uint8_t *coreCt, const uint8_t *extCt) {
+  uint32_t mk[4];
+  for (int i = 0; i < 4; i++)
+    mk[i] = k[i] ^ 0x5C5C5C5Cu;
+  uint8_t m[16] = {0};
+  m[0] = BLE_BEACON_VERSION;
+  m[1] = (uint8_t)nonce;
+  m[2] = (uint8_t)(nonce >> 8);
+  memcpy(m + 3, coreCt, 4);
+  memcpy(m + 7, extCt, 4);
+  uint32_t v[2] = {rd32(m), rd32(m + 4)};
+  xteaEncrypt(mk, v);
+  v[0] ^= rd32(m + 8);
+  v[1] ^= rd32(m + 12);
+  xteaEncrypt(mk, v);
+  return v[0];
+}
+
+static void packCore(const BleBeaconStatus &s, uint8_t *core) {
+  uint8_t flags = (s.ibusSynced ? BLE_BEACON_F_IBUS : 0) | (s.phoneConnected ? BLE_BEACON_F_PHONE : 0) |
+                  (s.obdConnected ? BLE_BEACON_F_OBD : 0);
+  uint8_t lock = s.lockState <= 2 ? s.lockState : 3;
+  uint8_t ign = (s.ignition >= 0 && s.ignition <= 2) ? (uint8_t)s.ignition : 3;
+  core[1] = (uint8_t)(flags | (lock << 3) | (ign << 5));
+  core[2] = s.doorByte1;
+  core[3] = s.doorByte2;
+}
+
+static void packExt(const BleBeaconStatus &s, uint8_t *ext) {
+  ext[0] = (s.coolantC >= -40 && s.coolantC <= 127) ? (uint8_t)s.coolantC : 0xFF;
+  ext[1] = (s.oilC >= -40 && s.oilC <= 127) ? (uint8_t)s.oilC : 0xFF;
+  uint16_t odo = (s.odometerKm >= 0 && s.odometerKm < 0xFFFF) ? (uint16_t)s.odometerKm : 0xFFFF;
+  ext[2] = (uint8_t)odo;
+  ext[3] = (uint8_t)(odo >> 8);
+}
+
+void BleStatusBeacon::setKey(const uint8_t *key) {
+  loadKey(key, key_);
+  started_ = false;  /* re-encode under the new key on the next update() */
+}
+
+bool BleStatusBeacon::update(const BleBeaconStatus &s, uint32_t nowMs) {
+  uint8_t core[4];
+  packCore(s, core);
+  packExt(s, pendingExt_);
+  const bool coreChanged = !started_ || memcmp(core + 1, core_ + 1, 3) != 0;
+  const bool extChanged = memcmp(pendingExt_, ext_, 4) != 0 && nowMs - lastExtMs_ >= kExtMinIntervalMs;
+  const bool rotate = started_ && nowMs - lastEncodeMs_ >= kRotateMs;
+  if (!coreChanged && !extChanged && !rotate)
+    return false;
+  if (coreChanged || extChanged) {
+    if (started_)
+      stateSeq_++;
+    memcpy(core_ + 1, core + 1, 3);
+    memcpy(ext_, pendingExt_, 4);
+    lastExtMs_ = nowMs;
+  } else {
+    rotations_++;
+  }
+  core_[0] = stateSeq_;
+  started_ = true;
+  encode(nowMs);
+  return true;
+}
+
+bool BleStatusBeacon::takeNonceReserve(uint16_t *mark) {
+  if (!reservePending_)
+    return false;
+  reservePending_ = false;
+  if (mark)
+    *mark = reservedTo_;
+  return true;
+}
+
+void BleStatusBeacon::encode(uint32_t nowMs) {
+  if (nonce_ == reservedTo_) {
+    reservedTo_ = (uint16_t)(reservedTo_ + kNonceReserve);
+    reservePending_ = true;
+  }
+  nonce_++;
+  uint8_t ks[8];
+  keystream(key_, nonce_, ks);
+  uint8_t coreCt[4], extCt[4];
+  for (int i = 0; i < 4; i++) {
+    coreCt[i] = core_[i] ^ ks[i];
+    extCt[i] = ext_[i] ^ ks[4 + i];
+  }
+  adv_[0] = (uint8_t)(BLE_BEACON_COMPANY_ID & 0xFF);
+  adv_[1] = (uint8_t)(BLE_BEACON_COMPANY_ID >> 8);
+  adv_[2] = (uint8_t)nonce_;
+  adv_[3] = (uint8_t)(nonce_ >> 8);
+  memcpy(adv_ + 4, coreCt, 4);
+  scan_[0] = adv_[0];
+  scan_[1] = adv_[1];
+  scan_[2] = BLE_BEACON_VERSION;
+  scan_[3] = adv_[2];
+  scan_[4] = adv_[3];
+  memcpy(scan_ + 5, extCt, 4);
+  wr32(scan_ + 9, macTag(key_, nonce_, coreCt, extCt));
+  lastEncodeMs_ = nowMs;
+  updates_++;
+}
+
+bool bleBeaconDecode(const uint8_t *key, const uint8_t *adv, size_t advLen, const uint8_t *scan,
+                     size_t scanLen, BleBeaconStatus *out, uint8_t *stateSeq) {
+  if (!adv || advLen != BLE_BEACON_ADV_LEN || adv[0] != (BLE_BEACON_COMPANY_ID & 0xFF) ||
+      adv[1] != (BLE_BEACON_COMPANY_ID >> 8))
+    return false;
+  uint32_t k[4];
+  loadKey(key, k);
+  const uint16_t nonce = (uint16_t)(adv[2] | (adv[3] << 8));
+  uint8_t ks[8];
+  keystream(k, nonce, ks);
+  BleBeaconStatus s;
+  if (scan) {
+    if (scanLen != BLE_BEACON_SCAN_LEN || scan[0] != adv[0] || scan[1] != adv[1] ||
+        scan[2] != BLE_BEACON_VERSION || scan[3] != adv[2] || scan[4] != adv[3])
+      return false;
+    if (macTag(k, nonce, adv + 4, scan + 5) != rd32(scan + 9))
+      return false;
+    uint8_t ext[4];
+    for (int i = 0; i < 4; i++)
+      ext[i] = scan[5 + i] ^ ks[4 + i];
+    s.coolantC = ext[0] == 0xFF ? 0xFF : (int)(int8_t)ext[0];
+    s.oilC = ext[1] == 0xFF ? 0xFF : (int)(int8_t)ext[1];
+    const uint16_t odo = (uint16_t)(ext[2] | (ext[3] << 8));
+    s.odometerKm = odo == 0xFFFF ? -1 : (int)odo;
+  }
+  uint8_t core[4];
+  for (int i = 0; i < 4; i++)
+    core[i] = adv[4 + i] ^ ks[i];
+  s.ibusSynced = (core[1] & BLE_BEACON_F_IBUS) != 0;
+  s.phoneConnected = (core[1] & BLE_BEACON_F_PHONE) != 0;
+  s.obdConnected = (core[1] & BLE_BEACON_F_OBD) != 0;
+  const uint8_t lock = (core[1] >> 3) & 3, ign = (core[1] >> 5) & 3;
+  s.lockState = lock == 3 ? 0xFF : lock;
+  s.ignition = ign == 3 ? -1 : ign;
+  s.doorByte1 = core[2];
+  s.doorByte2 = core[3];
+  if (out)
+    *out = s;
+  if (stateSeq)
+    *stateSeq = core[0];
+  return true;
+}
@@ -0,0 +1,102 @@
+/*
+ * NOCTURNE_OS — BLE status beacon: vehicle status in encrypted advertising / scan response data
+ * (XTEA-CTR, CBC-MAC tag, rotating nonce). Obfuscation for a glance widget, not a security boundary.
+ */
+#ifndef NOCTURNE_BLE_STATUS_BEACON_H
+#define NOCTURNE_BLE_STATUS_BEACON_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define BLE_BEACON_COMPANY_ID 0xFFFF
+#define BLE_BEACON_VERSION 1
+#define BLE_BEACON_KEY_LEN 16
+/** Manufacturer data lengths including the 2-byte company ID. */
+#define BLE_BEACON_ADV_LEN 8
+#define BLE_BEACON_SCAN_LEN 13
+
+#define BLE_BEACON_F_IBUS 0x01
+#define BLE_BEACON_F_PHONE 0x02
+#define BLE_BEACON_F_OBD 0x04
+
+struct BleBeaconStatus {
+  bool ibusSynced = false;
+  bool phoneConnected = false;
+  bool obdConnected = false;
+  uint8_t lockState = 0xFF;  /* 0=unlocked, 1=locked, 2=double, 0xFF=unknown */
+  int ignition = -1;         /* 0=off, 1=pos1, 2=pos2, -1=unknown */
+  uint8_t doorByte1 = 0xFF;
+  uint8_t doorByte2 = 0xFF;
+  int coolantC = 0xFF;  /* -40..127, anything else = n/a */
+  int oilC = 0xFF;
+  int odometerKm = -1;
+};
+
+class BleStatusBeacon {
+ public:
+  /** Payload re-encrypted under a new nonce at least this often even if nothing changed. */
+  static const uint32_t kRotateMs = 60000;
+  /** Coolant / oil / odometer alone refresh the payload at most this often. */
+  static const uint32_t kExtMinIntervalMs = 5000;
+
+  void setKey(const uint8_t *key);
+  /** Nonces are reserved in NVS this many at a time, so the counter survives restarts. */
+  static const uint16_t kNonceReserve = 256;
+
+  /**
+   * Last nonce that may have been used (the persisted reservation mark). Counting continues from it
+   * across restarts: the key never changes, so a nonce must not repeat.
+   */
+  void setNonce(uint16_t lastUsed) {
+    nonce_ = lastUsed;
+    reservedTo_ = lastUsed;
+    reservePending_ = false;
+  }
+  /**
+   * True once after update() crossed the reserved range: *mark must be persisted before the new
+   * frames go on air.
+   */
+  bool takeNonceReserve(uint16_t *mark);
+
+  /**
+   * Feed the current status. Returns true when the frames were re-encoded and the advertising data
+   * should be pushed: core state changed, ext changed (rate-limited), rotation due, or first call.
+   */
+  bool update(const BleBeaconStatus &s, uint32_t nowMs);
+
+  const uint8_t *advData() const { return adv_; }
+  const uint8_t *scanData() const { return scan_; }
+  uint16_t nonce() const { return nonce_; }
+  uint8_t stateSeq() const { return stateSeq_; }
+  uint32_t updates() const { return updates_; }
+  uint32_t rotations() const { return rotations_; }
+
+ private:
+  void encode(uint32_t nowMs);
+
+  uint32_t key_[4] = {0, 0, 0, 0};
+  uint16_t nonce_ = 0;
+  uint16_t reservedTo_ = 0;
+  bool reservePending_ = false;
+  uint8_t stateSeq_ = 0;
+  bool started_ = false;
+  uint8_t core_[4] = {0};
+  uint8_t ext_[4] = {0};
+  uint8_t pendingExt_[4] = {0};
+  uint32_t lastEncodeMs_ = 0;
+  uint32_t lastExtMs_ = 0;
+  uint8_t adv_[BLE_BEACON_ADV_LEN] = {0};
+  uint8_t scan_[BLE_BEACON_SCAN_LEN] = {0};
+  uint32_t updates_ = 0;
+  uint32_t rotations_ = 0;
+};
+
+/**
+ * Phone-side decoder (reference for the app, used by the tests). adv / scan are manufacturer data
+ * including the company ID; scan may be null (passive scan: core only, not authenticated).
+ * Returns false on wrong company / version / length or tag mismatch.
+ */
+bool bleBeaconDecode(const uint8_t *key, const uint8_t *adv, size_t advLen, const uint8_t *scan,
+                     size_t scanLen, BleBeaconStatus *out, uint8_t *stateSeq);
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * NOCTURNE_OS — BLE telemetry stream packer (zigzag varint deltas, MTU-sized frames).
+ */
+#include "BleTelemetry.h"
+#include <cstring>
+
+static inline uint32_t zigzag32(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag32(uint32_t u) {
+  return (int32_t)((u >> 1) ^ (~(u & 1u) + 1u));
+}
+
+static size_t putVarint(uint8_t *p, uint64_t v) {
+  size_t n = 0;
+  while (v >= 0x80u) {
+    p[n++] = (uint8_t)(v | 0x80u);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t)v;
+  return n;
+}
+
+static bool getVarint(const uint8_t *buf, size_t len, size_t *pos, uint64_t *out) {
+  uint64_t v = 0;
+  for (int shift = 0; shift <= 28; shift += 7) {
+    if (*pos >= len)
+      return false;
+    uint8_t b = buf[(*pos)++];
+    v |= (uint64_t)(b & 0x7Fu) << shift;
+    if (!(b & 0x80u)) {
+      *out = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline int maskBits(uint8_t mask) {
+  int n = 0;
+  for (int i = 0; i < BLE_TELEMETRY_SIGNAL_COUNT; i++)
+    if (mask & (1u << i))
+      n++;
+  return n;
+}
+
+size_t BleTelemetryPacker::maxSampleLen(uint8_t mask) {
+  return 5u + 5u * (size_t)maskBits(mask);
+}
+
+void BleTelemetryPacker::begin(uint8_t *buf, size_t capacity, uint16_t seq, uint8_t mask) {
+  buf_ = buf;
+  cap_ = capacity;
+  mask_ = mask & BLE_TLM_SIG_ALL;
+  count_ = 0;
+  len_ = 0;
+  if (!buf_ || cap_ < BLE_TELEMETRY_HEADER_LEN)
+    return;
+  buf_[0] = BLE_TELEMETRY_FRAME_VERSION;
+  buf_[1] = (uint8_t)(seq & 0xFF);
+  buf_[2] = (uint8_t)(seq >> 8);
+  buf_[3] = mask_;
+  buf_[4] = 0;
+  memset(buf_ + 5, 0, 4);
+  len_ = BLE_TELEMETRY_HEADER_LEN;
+}
+
+bool BleTelemetryPacker::add(const BleTelemetrySample &s) {
+  if (!buf_ || len_ < BLE_TELEMETRY_HEADER_LEN || count_ == 0xFF)
+    return false;
+  uint8_t tmp[5 + 5 * BLE_TELEMETRY_SIGNAL_COUNT];
+  size_t n = 0;
+  if (count_ > 0)
+    n += putVarint(tmp + n, s.tMs - prev_.tMs);
+  for (int i = 0; i < BLE_TELEMETRY_SIGNAL_COUNT; i++) {
+    if (!(mask_ & (1u << i)))
+      continue;
+    if (s.v[i] == kTelemetryNoData) {
+      tmp[n++] = 0;
+      continue;
+    }
+    /* Wrapping subtraction keeps deltas exact for the full int32 range; +1 frees 0 for "no data". */
+    const bool delta = count_ > 0 && prev_.v[i] != kTelemetryNoData;
+    int32_t d = delta ? (int32_t)((uint32_t)s.v[i] - (uint32_t)prev_.v[i]) : s.v[i];
+    n += putVarint(tmp + n, (uint64_t)zigzag32(d) + 1u);
+  }
+  if (len_ + n > cap_)
+    return false;
+  if (count_ == 0) {
+    buf_[5] = (uint8_t)(s.tMs & 0xFF);
+    buf_[6] = (uint8_t)((s.tMs >> 8) & 0xFF);
+    buf_[7] = (uint8_t)((s.tMs >> 16) & 0xFF);
+    buf_[8] = (uint8_t)(s.tMs >> 24);
+  }
+  memcpy(buf_ + len_, tmp, n);
+  len_ += n;
+  prev_ = s;
+  count_++;
+  return true;
+}
+
+size_t BleTelemetryPacker::finish() {
+  if (!buf_ || count_ == 0)
+    return 0;
+  buf_[4] = count_;
+  return len_;
+}
+
+bool bleTelemetryDecode(const uint8_t *buf, size_t len, BleTelemetryFrameHeader *hdr,
+                        BleTelemetrySample *out, size_t maxSamples, size_t *outCount) {
+  if (!buf || len < BLE_TELEMETRY_HEADER_LEN || buf[0] != BLE_TELEMETRY_FRAME_VERSION)
+    return false;
+  BleTelemetryFrameHeader h;
+  h.version = buf[0];
+  h.seq = (uint16_t)(buf[1] | (buf[2] << 8));
+  h.mask = buf[3] & BLE_TLM_SIG_ALL;
+  h.count = buf[4];
+  h.firstMs = (uint32_t)buf[5] | ((uint32_t)buf[6] << 8) | ((uint32_t)buf[7] << 16) |
+              ((uint32_t)buf[8] << 24);
+  if (hdr)
+    *hdr = h;
+  size_t pos = BLE_TELEMETRY_HEADER_LEN;
+  BleTelemetrySample prev;
+  size_t n = 0;
+  for (uint8_t k = 0; k < h.count; k++) {
+    BleTelemetrySample s;
+    if (k == 0) {
+      s.tMs = h.firstMs;
+    } else {
+      uint64_t dt = 0;
+      if (!getVarint(buf, len, &pos, &dt))
+        return false;
+      s.tMs = prev.tMs + (uint32_t)dt;
+    }
+    for (int i = 0; i < BLE_TELEMETRY_SIGNAL_COUNT; i++) {
+      if (!(h.mask & (1u << i)))
+        continue;
+      uint64_t u = 0;
+      if (!getVarint(buf, len, &pos, &u) || u > 0x100000000ull)
+        return false;
+      if (u == 0)
+        continue;
+      int32_t d = unzigzag32((uint32_t)(u - 1u));
+      const bool delta = k > 0 && prev.v[i] != kTelemetryNoData;
+      s.v[i] = delta ? (int32_t)((uint32_t)prev.v[i] + (uint32_t)d) : d;
+    }
+    if (out && n < maxSamples)
+      out[n] = s;
+    n++;
+    prev = s;
+  }
+  if (outCount)
+    *outCount = n < maxSamples ? n : maxSamples;
+  return pos == len;
+}
+
+void BleTelemetryStream::configure(uint8_t rateHz, uint8_t mask, uint16_t batchMs) {
+  if (rateHz != 0 && rateHz < kMinRateHz)
+    rateHz = kMinRateHz;
+  if (rateHz > kMaxRateHz)
+    rateHz = kMaxRateHz;
+  mask &= BLE_TLM_SIG_ALL;
+  if (mask == 0)
+    mask = BLE_TLM_SIG_ALL;
+  if (batchOpen_ && (mask != mask_ || rateHz == 0))
+    closeBatch();
+  rateHz_ = rateHz;
+  mask_ = mask;
+  batchMs_ = batchMs ? batchMs : kDefaultBatchMs;
+  periodMs_ = rateHz_ ? 1000u / rateHz_ : 0;
+  sampleClockValid_ = false;
+}
+
+bool BleTelemetryStream::configureFromWrite(const uint8_t *data, size_t len) {
+  if (!data || len < 1)
+    return false;
+  uint8_t mask = len >= 2 ? data[1] : BLE_TLM_SIG_ALL;
+  uint16_t batchMs = len >= 3 ? (uint16_t)(data[2] * 10u) : 0;
+  configure(data[0], mask, batchMs);
+  return true;
+}
+
+void BleTelemetryStream::setMtu(uint16_t mtu) {
+  if (mtu < BLE_TLM_MTU_DEFAULT)
+    mtu = BLE_TLM_MTU_DEFAULT;
+  if (mtu > BLE_TLM_MTU_MAX)
+    mtu = BLE_TLM_MTU_MAX;
+  /* A shrinking MTU would make the open batch unsendable; close it with the old size. */
+  if (mtu < mtu_ && batchOpen_)
+    closeBatch();
+  mtu_ = mtu;
+}
+
+size_t BleTelemetryStream::payloadCapacity() const {
+  return (size_t)mtu_ - BLE_TLM_NOTIFY_OVERHEAD;
+}
+
+void BleTelemetryStream::startBatch() {
+  packer_.begin(work_, payloadCapacity(), seq_, mask_);
+  batchOpen_ = true;
+}
+
+void BleTelemetryStream::closeBatch() {
+  batchOpen_ = false;
+  size_t n = packer_.finish();
+  if (n == 0)
+    return;
+  memcpy(ready_, work_, n);
+  readyLen_ = n;
+  frames_++;
+  samples_ += packer_.count();
+  bytes_ += (uint32_t)n;
+  seq_++;
+}
+
+bool BleTelemetryStream::offer(const BleTelemetrySample &current, uint32_t nowMs) {
+  if (!rateHz_)
+    return false;
+  bool ready = false;
+  if (batchOpen_ && packer_.count() > 0 && (uint32_t)(nowMs - batchStartMs_) >= batchMs_) {
+    closeBatch();
+    ready = true;
+  }
+  if (!sampleClockValid_) {
+    nextSampleMs_ = nowMs;
+    sampleClockValid_ = true;
+  }
+  if ((int32_t)(nowMs - nextSampleMs_) < 0)
+    return ready;
+  /* Fixed-period schedule; if the loop stalled for more than one period, resync instead of bursting. */
+  nextSampleMs_ += periodMs_;
+  if ((int32_t)(nowMs - nextSampleMs_) >= 0)
+    nextSampleMs_ = nowMs + periodMs_;
+
+  BleTelemetrySample s = current;
+  s.tMs = nowMs;
+  if (!batchOpen_) {
+    startBatch();
+    batchStartMs_ = nowMs;
+  }
+  if (!packer_.add(s)) {
+    if (packer_.count() > 0) {
+      closeBatch();
+      ready = true;
+      startBatch();
+      batchStartMs_ = nowMs;
+    }
+    if (!packer_.add(s))
+      dropped_++;
+  }
+  return ready && readyLen_ > 0;
+}
+
+bool BleTelemetryStream::flush() {
+  if (!batchOpen_ || packer_.count() == 0)
+    return false;
+  closeBatch();
+  return true;
+}
@@ -0,0 +1,138 @@
+/*
+ * NOCTURNE_OS — BLE telemetry stream: timestamped samples packed into MTU-sized notifications
+ * (characteristic 1a2b0006). Frame layout: docs/bmw/BMW_ANDROID_APP.md, reference decoder below.
+ */
+#ifndef NOCTURNE_BLE_TELEMETRY_H
+#define NOCTURNE_BLE_TELEMETRY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define BLE_TELEMETRY_FRAME_VERSION 0x02
+#define BLE_TELEMETRY_HEADER_LEN 9
+#define BLE_TELEMETRY_SIGNAL_COUNT 5
+/** ATT notification header (opcode + handle) taken from the MTU. */
+#define BLE_TLM_NOTIFY_OVERHEAD 3
+#define BLE_TLM_MTU_DEFAULT 23
+/** MTU offered to NimBLEDevice::setMTU(); frame buffers are sized from it. */
+#define BLE_TLM_MTU_MAX 517
+
+/* Signal mask bits (control write byte 1). */
+#define BLE_TLM_SIG_RPM 0x01
+#define BLE_TLM_SIG_SPEED 0x02      /* km/h */
+#define BLE_TLM_SIG_COOLANT 0x04    /* °C */
+#define BLE_TLM_SIG_OIL 0x08        /* °C */
+#define BLE_TLM_SIG_ODOMETER 0x10   /* km, full 24-bit IKE value */
+#define BLE_TLM_SIG_ALL 0x1F
+
+/** Value used for a signal with no data (a single 0 byte in the frame). */
+static const int32_t kTelemetryNoData = INT32_MIN;
+
+struct BleTelemetrySample {
+  uint32_t tMs = 0;
+  int32_t v[BLE_TELEMETRY_SIGNAL_COUNT] = {kTelemetryNoData, kTelemetryNoData, kTelemetryNoData,
+                                           kTelemetryNoData, kTelemetryNoData};
+};
+
+struct BleTelemetryFrameHeader {
+  uint8_t version = 0;
+  uint16_t seq = 0;
+  uint8_t mask = 0;
+  uint8_t count = 0;
+  uint32_t firstMs = 0;
+};
+
+/** Packs delta-encoded samples into one notification-sized buffer. */
+class BleTelemetryPacker {
+ public:
+  /** Start a frame in buf (capacity = usable notification payload). */
+  void begin(uint8_t *buf, size_t capacity, uint16_t seq, uint8_t mask);
+  /** Append one sample. Returns false (frame unchanged) if it does not fit or count is 255. */
+  bool add(const BleTelemetrySample &s);
+  /** Patch the sample count; returns frame length (0 if no samples). */
+  size_t finish();
+  uint8_t count() const { return count_; }
+  size_t length() const { return len_; }
+
+  /** Worst-case encoded size of one sample with this mask (dt + 5-byte varints). */
+  static size_t maxSampleLen(uint8_t mask);
+
+ private:
+  uint8_t *buf_ = nullptr;
+  size_t cap_ = 0;
+  size_t len_ = 0;
+  uint8_t mask_ = 0;
+  uint8_t count_ = 0;
+  BleTelemetrySample prev_;
+};
+
+/** Decode a frame produced by BleTelemetryPacker (reference for the phone app and tests).
+ * Values of masked-out signals are left as kTelemetryNoData. Returns false on malformed input. */
+bool bleTelemetryDecode(const uint8_t *buf, size_t len, BleTelemetryFrameHeader *hdr,
+                        BleTelemetrySample *out, size_t maxSamples, size_t *outCount);
+
+/**
+ * Rate-limited sampler + batcher. offer() is called every loop tick with the current values;
+ * it takes a sample every 1000/rateHz ms and closes a frame when the next sample would not
+ * fit the MTU or the oldest sample in the batch is batchMs old.
+ */
+class BleTelemetryStream {
+ public:
+  static const uint8_t kMinRateHz = 1;
+  static const uint8_t kMaxRateHz = 50;
+  static const uint16_t kDefaultBatchMs = 100;
+
+  /** rateHz 0 = stop. mask 0 = all signals. batchMs 0 = default. */
+  void configure(uint8_t rateHz, uint8_t mask, uint16_t batchMs = 0);
+  /** Parse a control write: [rateHz][mask][batch/10 ms (optional)]. Returns false if too short. */
+  bool configureFromWrite(const uint8_t *data, size_t len);
+  void setMtu(uint16_t mtu);
+  void stop() { configure(0, mask_); }
+
+  bool isRunning() const { return rateHz_ > 0; }
+  uint8_t rateHz() const { return rateHz_; }
+  uint8_t mask() const { return mask_; }
+  uint16_t mtu() const { return mtu_; }
+  /** Bytes available for one frame at the current MTU. */
+  size_t payloadCapacity() const;
+
+  /** Offer current values at nowMs. Returns true when a non-empty frame is ready (see frame()).
+   *  A sample too large for an empty frame at this MTU is counted in samplesDropped(). */
+  bool offer(const BleTelemetrySample &current, uint32_t nowMs);
+  /** Close a partially filled batch now (e.g. on stop). Returns true if a frame is ready. */
+  bool flush();
+  const uint8_t *frame() const { return ready_; }
+  size_t frameLen() const { return readyLen_; }
+  /** Mark the ready frame as sent. */
+  void consume() { readyLen_ = 0; }
+
+  uint32_t framesSent() const { return frames_; }
+  uint32_t samplesSent() const { return samples_; }
+  uint32_t bytesSent() const { return bytes_; }
+  uint32_t samplesDropped() const { return dropped_; }
+
+ private:
+  void startBatch();
+  void closeBatch();
+
+  uint8_t rateHz_ = 0;
+  uint8_t mask_ = BLE_TLM_SIG_ALL;
+  uint16_t batchMs_ = kDefaultBatchMs;
+  uint16_t mtu_ = BLE_TLM_MTU_DEFAULT;
+  uint16_t seq_ = 0;
+  uint32_t periodMs_ = 0;
+  uint32_t nextSampleMs_ = 0;
+  bool sampleClockValid_ = false;
+  uint32_t batchStartMs_ = 0;
+  BleTelemetryPacker packer_;
+  bool batchOpen_ = false;
+  uint8_t work_[BLE_TLM_MTU_MAX - BLE_TLM_NOTIFY_OVERHEAD];
+  uint8_t ready_[BLE_TLM_MTU_MAX - BLE_TLM_NOTIFY_OVERHEAD];
+  size_t readyLen_ = 0;
+  uint32_t frames_ = 0;
+  uint32_t samples_ = 0;
+  uint32_t bytes_ = 0;
+  uint32_t dropped_ = 0;
+};
+
+#endif
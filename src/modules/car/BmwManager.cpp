@@ -2,7 +2,9 @@
  * NOCTURNE_OS — BmwManager: BMW E39 Assistant (I-Bus + BLE key).
  */
 #include "BmwManager.h"
+#include "BleBulkFs.h"
 #include "DemoManager.h"
+#include "ObdSession.h"
 #include "ibus/IbusDriver.h"
 #include "ibus/IbusCodes.h"
 #include "ibus/IbusDefines.h"
@@ -22,6 +24,35 @@ static void ibusPacketForward(uint8_t *packet) {
     s_bmwForIbus->onIbusPacket(packet);
 }
 
+/* Acknowledged BLE command (1a2b0007): run it with every I-Bus write tagged so DONE waits for the bus. */
+static uint8_t bleCommandExecutor(const BleCommand &c, uint16_t tag, uint8_t *writes, void *ctx) {
+  BmwManager *m = (BmwManager *)ctx;
+  *writes = 0;
+  const bool needIbus = BmwManager::commandNeedsIbus(c.cmd);
+  if (needIbus && !m->isIbusSynced())
+    return BLE_CMD_ERR_NOT_SYNCED;
+  if (needIbus && !m->isDemoMode() && m->ibus()->txQueueFree() < BmwManager::kCommandMaxFrames)
+    return BLE_CMD_EXEC_BUSY;
+  m->ibus()->beginTag(tag);
+  const bool known = m->executeCommand(c.cmd, c.params, c.paramLen);
+  *writes = m->ibus()->endTag();
+  return known ? BLE_CMD_EXEC_OK : BLE_CMD_ERR_UNKNOWN_CMD;
+}
+
+static void ibusTxDoneForward(uint16_t tag, bool ok) {
+  if (s_bmwForIbus)
+    s_bmwForIbus->onIbusTxDone(tag, ok);
+}
+
+/* Sequence runner task -> bus / state. */
+static bool seqSendForward(const uint8_t *frame, uint8_t len, void *ctx) {
+  return ((BmwManager *)ctx)->sequenceWrite(frame, len);
+}
+
+static uint8_t seqQueryForward(uint8_t var, void *ctx) {
+  return ((BmwManager *)ctx)->sequenceState(var);
+}
+
 BmwManager::BmwManager() {
   nowPlayingTrack_[0] = '\0';
   nowPlayingArtist_[0] = '\0';
@@ -30,6 +61,15 @@ BmwManager::BmwManager() {
   startupGreeting_[0] = '\0';
   for (int i = 0; i < kPdcSensors; i++)
     pdcDists_[i] = -1;
+  static const uint16_t kGearRpm[] = NOCT_SHIFT_RPM_GEARS;
+  static const uint16_t kGearRatios[] = NOCT_SHIFT_GEAR_RATIOS;
+  shift_.setThreshold(0, NOCT_SHIFT_RPM);
+  for (uint8_t g = 0; g < sizeof(kGearRpm) / sizeof(kGearRpm[0]) && g < ShiftPredictor::kMaxGears; g++)
+    shift_.setThreshold(g + 1, kGearRpm[g]);
+  for (uint8_t g = 0; g < sizeof(kGearRatios) / sizeof(kGearRatios[0]) && g < ShiftPredictor::kMaxGears; g++)
+    shift_.setGearRatio(g + 1, kGearRatios[g]);
+  shift_.setHysteresis(NOCT_SHIFT_HYSTERESIS_RPM);
+  shift_.setOutputLatency(NOCT_SHIFT_LEAD_MS);
 }
 
 void BmwManager::parseMflButton(uint8_t *packet) {
@@ -192,6 +232,25 @@ void BmwManager::setObdData(bool connected, int rpm, int coolantC, int oilC) {
   obdRpm_ = rpm >= 0 ? rpm : 0;
   obdCoolantTempC_ = coolantC;
   obdOilTempC_ = oilC;
+  if (!connected) {
+    shift_.reset();
+    telemetry_.drop(TELEM_SRC_OBD);
+  }
+}
+
+void BmwManager::addObdRpmSample(int rpm, int speedKmh, uint32_t sampleMs) {
+  shift_.setSpeed(speedKmh);
+  shift_.addSample(rpm, sampleMs);
+}
+
+void BmwManager::addObdSample(uint8_t pid, int32_t value, uint32_t sampleMs) {
+  switch (pid) {
+    case OBD_PID_RPM: telemetry_.publish(TELEM_SRC_OBD, TELEM_SIG_RPM, value, sampleMs); break;
+    case OBD_PID_SPEED: telemetry_.publish(TELEM_SRC_OBD, TELEM_SIG_SPEED, value, sampleMs); break;
+    case OBD_PID_COOLANT: telemetry_.publish(TELEM_SRC_OBD, TELEM_SIG_COOLANT, value, sampleMs); break;
+    case OBD_PID_OIL: telemetry_.publish(TELEM_SRC_OBD, TELEM_SIG_OIL, value, sampleMs); break;
+    default: break;
+  }
 }
 
 void BmwManager::onIbusPacket(uint8_t *packet) {
@@ -206,16 +265,22 @@ void BmwManager::onIbusPacket(uint8_t *packet) {
     Serial.println();
   }
 #endif
+  recordIbusHistory(packet);
   if (packet[0] == IBUS_MFL)
     parseMflButton(packet);
   else if (packet[0] == IBUS_PDC)
     parsePdcPacket(packet);
   else if (packet[0] == IBUS_IKE && packet[1] >= 5 && packet[3] == IBUS_TEMP) {
-    /* IKE 0x19 temperature: byte0 = ambient °C, byte1 = coolant °C. Wilhelm ike/19.md. */
-    lastIkeCoolantC_ = (int)packet[5];
+    /* IKE 0x19 temperature: byte0 = ambient °C, byte1 = coolant °C, both signed. Wilhelm ike/19.md. */
+    const int coolantC = (int8_t)packet[5];
+    lastIkeCoolantC_ = coolantC;
+    telemetry_.publish(TELEM_SRC_IKE, TELEM_SIG_COOLANT, coolantC, (uint32_t)millis());
   }
   else if (packet[0] == IBUS_GM && packet[1] >= 5 && packet[2] == 0xBF && packet[3] == IBUS_GM_STAT_RPLY) {
     /* GM door/lid status 0x7a: byte1 = doors/lock/lamp, byte2 = windows/sunroof/trunk. Wilhelm gm/7a.md. */
+    /* Lock bits changed (key fob / door handle): driver is probably approaching or leaving. */
+    if (lastDoorLidByte1_ != 0xFF && ((lastDoorLidByte1_ ^ packet[4]) & 0x30))
+      bleKey_.noteProximityActivity();
     lastDoorLidByte1_ = packet[4];
     lastDoorLidByte2_ = packet[5];
   }
@@ -229,6 +294,12 @@ void BmwManager::onIbusPacket(uint8_t *packet) {
     }
     lastIgnitionForGreeting_ = lastIgnition_;
   }
+  else if (packet[0] == IBUS_IKE && packet[1] >= 5 && packet[3] == IBUS_SPEED_RPM_REQ) {
+    /* IKE speed/RPM broadcast 0x18: byte1 = speed / 2 km/h, byte2 = RPM / 100. Wilhelm ike/18.md. */
+    const uint32_t at = (uint32_t)millis();
+    telemetry_.publish(TELEM_SRC_IKE, TELEM_SIG_SPEED, (int32_t)packet[4] * 2, at);
+    telemetry_.publish(TELEM_SRC_IKE, TELEM_SIG_RPM, (int32_t)packet[5] * 100, at);
+  }
   else if (packet[0] == IBUS_IKE && packet[1] >= 6 && packet[3] == IBUS_ODMTR_STAT_RPLY) {
     /* IKE odometer 0x17: 3 bytes km = b1 + b2*256 + b3*65536. Wilhelm ike/17.md. */
     lastOdometerKm_ = (int)packet[4] | ((int)packet[5] << 8) | ((int)packet[6] << 16);
@@ -249,10 +320,41 @@ void BmwManager::onPhoneConnectionChanged(bool connected) {
   phoneConnected_ = connected;
   if (demoMode_ || !ibus_.isSynced())
     return;
-  if (connected)
+  if (connected) {
+#if NOCT_BLE_PROXIMITY_ENABLED
+    /* Link comes up 20-30 m out; unlock when RSSI says the phone is at the car (onProximityEvent). */
+    proximityUnlockPending_ = true;
+    phoneConnectedAtMs_ = millis();
+#else
     ibus_.write(REMOTE_UNLOCK, sizeof(REMOTE_UNLOCK));
-  else
+#endif
+  } else {
+    proximityUnlockPending_ = false;
+    if (!proximityLocked_)
+      ibus_.write(REMOTE_LOCK, sizeof(REMOTE_LOCK));
+    proximityLocked_ = false;
+  }
+}
+
+bool BmwManager::calibrateProximity() {
+  bool ok = bleKey_.calibrateProximity(1.0f);
+  setLastActionFeedback(ok ? "Prox cal OK" : "Prox cal fail");
+  return ok;
+}
+
+void BmwManager::onProximityEvent(BleProximityEvent evt) {
+  /* Ignition on: phone is inside the car, RSSI says nothing about the driver walking up. */
+  if (demoMode_ || !ibus_.isSynced() || lastIgnition_ >= 1)
+    return;
+  if (evt == PROX_EVT_NEAR && (proximityUnlockPending_ || proximityLocked_)) {
+    ibus_.write(REMOTE_UNLOCK, sizeof(REMOTE_UNLOCK));
+    ibus_.write(ParkLights_And_Signals, sizeof(ParkLights_And_Signals));  /* welcome flash */
+    proximityUnlockPending_ = false;
+    proximityLocked_ = false;
+  } else if (evt == PROX_EVT_LEAVING && !proximityUnlockPending_ && !proximityLocked_) {
     ibus_.write(REMOTE_LOCK, sizeof(REMOTE_LOCK));
+    proximityLocked_ = true;
+  }
 }
 
 void BmwManager::sendGoodbyeLights() {
@@ -343,24 +445,6 @@ void BmwManager::storeStartupGreeting(const char *text) {
   startupGreeting_[i] = '\0';
 }
 
-void BmwManager::tickWigWag(unsigned long now) {
-  if (!wigWagActive_ || !ibusSynced_)
-    return;
-  if (now - lastWigWagMs_ < kWigWagIntervalMs)
-    return;
-  lastWigWagMs_ = now;
-  wigWagStep_ = (wigWagStep_ % 3) + 1;
-  if (wigWagStep_ == 1) {
-    uint8_t pl[] = {0x0C, 0x01, 0x00, 0x00};
-    sendLCMDiagnostic(pl, sizeof(pl));
-  } else if (wigWagStep_ == 2) {
-    uint8_t pl[] = {0x0C, 0x02, 0x00, 0x00};
-    sendLCMDiagnostic(pl, sizeof(pl));
-  } else {
-    sendLightsOff();
-  }
-}
-
 void BmwManager::tickGreetingOnIgnition(unsigned long now) {
   if (greetingPendingSend_ && now >= greetingSendAtMs_ && startupGreeting_[0] != '\0' && ibusSynced_) {
     sendIkeRadioText(startupGreeting_);
@@ -412,23 +496,59 @@ void BmwManager::sendClownFlash() {
 }
 
 void BmwManager::startLightShow() {
-  lightShowActive_ = true;
-  lightShowStep_ = 0;
-  lastLightShowMs_ = millis();
+  startSequence(IBUS_SEQ_LIGHT_SHOW);
 }
 
 void BmwManager::stopLightShow() {
-  lightShowActive_ = false;
-  ibus_.write(TurnOffLights, sizeof(TurnOffLights));
+  /* The script's ON_STOP turns the lights off; without a show running, 0x81 still does. */
+  if (isLightShowActive())
+    seq_.stop();
+  else
+    sendLightsOff();
+}
+
+void BmwManager::setWigWagActive(bool v) {
+  if (v)
+    startSequence(IBUS_SEQ_WIG_WAG);
+  else if (isWigWagActive())
+    seq_.stop();
+}
+
+uint8_t BmwManager::startSequence(uint8_t id) {
+  const uint8_t err = seq_.start(id);
+#if NOCT_BMW_DEBUG
+  if (err != IBUS_SEQ_OK)
+    Serial.printf("[BMW] Sequence %u not started: error %u\n", (unsigned)id, (unsigned)err);
+#endif
+  return err;
+}
+
+bool BmwManager::sequenceWrite(const uint8_t *frame, uint8_t len) {
+  if (!seqOutputEnabled_.load())
+    return false;
+  return ibus_.writeUntagged(frame, len);
+}
+
+void BmwManager::publishSequenceState() {
+  seqOutputEnabled_.store(ibusSynced_ && !demoMode_);
+  uint8_t lockState = 0xFF;
+  if (lastDoorLidByte1_ != 0xFF) {
+    const uint8_t cl = lastDoorLidByte1_ & 0x30;
+    lockState = cl == 0x10 ? 0 : cl == 0x20 ? 1 : cl == 0x30 ? 2 : 0xFF;
+  }
+  seqState_[IBUS_SEQ_VAR_IGNITION].store(lastIgnition_ >= 0 && lastIgnition_ <= 2 ? (uint8_t)lastIgnition_ : 0xFF);
+  seqState_[IBUS_SEQ_VAR_LOCK].store(lockState);
+  seqState_[IBUS_SEQ_VAR_DOORS].store(lastDoorLidByte1_);
+  seqState_[IBUS_SEQ_VAR_WINDOWS].store(lastDoorLidByte2_);
+  const TelemetryReading speed = telemetry_.peek(TELEM_SIG_SPEED, (uint32_t)millis());
+  seqState_[IBUS_SEQ_VAR_SPEED].store(!speed.valid ? 0xFF : speed.value > 254 ? 254 : (uint8_t)speed.value);
+  seqState_[IBUS_SEQ_VAR_PHONE].store(phoneConnected_ ? 1 : 0);
 }
 
 const char *BmwManager::getLightShowStepName() const {
-  if (!lightShowActive_)
+  if (!isLightShowActive())
     return "";
-  static const uint8_t kLightShowSequence[] = { 0, 1, 2, 3, 4 };
-  const size_t kSteps = sizeof(kLightShowSequence) / sizeof(kLightShowSequence[0]);
-  size_t idx = (size_t)(lightShowStep_ % (int)kSteps);
-  switch (kLightShowSequence[idx]) {
+  switch (seq_.mark()) {
     case 0: return "Hazard";
     case 1: return "Park";
     case 2: return "Goodbye";
@@ -438,6 +558,81 @@ const char *BmwManager::getLightShowStepName() const {
   }
 }
 
+bool BmwManager::commandNeedsIbus(uint8_t cmd) {
+  return cmd <= 31 || cmd == 0x80 || cmd == 0x81 || cmd == 0xA0;
+}
+
+bool BmwManager::executeCommand(uint8_t cmd, const uint8_t *params, uint8_t plen) {
+  switch (cmd) {
+    case 0: sendGoodbyeLights(); break;
+    case 1: sendFollowMeHome(); break;
+    case 2: sendParkLights(); break;
+    case 3: sendHazardLights(); break;
+    case 4: sendLowBeams(); break;
+    case 5: sendLightsOff(); break;
+    case 6: sendUnlock(); break;
+    case 7: sendLock(); break;
+    case 8: sendTrunkOpen(); break;
+    case 9: {
+      /* Acknowledged path may carry the text as params; legacy 1-byte write keeps "NOCT". */
+      char text[BLE_CMD_MAX_PARAMS + 1];
+      size_t n = 0;
+      for (; params && n < plen && n < BLE_CMD_MAX_PARAMS && params[n]; n++)
+        text[n] = (char)params[n];
+      text[n] = '\0';
+      sendClusterText(n ? text : "NOCT");
+      break;
+    }
+    case 10: sendDoorsUnlockInterior(); break;
+    case 11: sendDoorsLockKey(); break;
+    case 12: sendWindowFrontDriverOpen(); break;
+    case 13: sendWindowFrontDriverClose(); break;
+    case 14: sendWindowFrontPassengerOpen(); break;
+    case 15: sendWindowFrontPassengerClose(); break;
+    case 16: sendWindowRearDriverOpen(); break;
+    case 17: sendWindowRearDriverClose(); break;
+    case 18: sendWindowRearPassengerOpen(); break;
+    case 19: sendWindowRearPassengerClose(); break;
+    case 20: sendWipersFront(); break;
+    case 21: sendWasherFront(); break;
+    case 22: sendInteriorOff(); break;
+    case 23: sendInteriorOn3s(); break;
+    case 24: sendClownFlash(); break;
+    case 25: sendDoorsHardLock(); break;
+    case 26: sendAllExceptDriverLock(); break;
+    case 27: sendDriverDoorLock(); break;
+    case 28: sendDoorsFuelTrunk(); break;
+    case 29: sendDoorsUnlockGM(); break;
+    case 30: sendMflNext(); break;
+    case 31: sendMflPrev(); break;
+    case 0x80: startLightShow(); break;
+    case 0x81: stopLightShow(); break;
+    case 0x90: setWigWagActive(!isWigWagActive()); break;
+    case 0x91: setSensoryDark(true); sendSensoryDarkLcm(); break;
+    case 0x92: setSensoryDark(false); break;
+    case 0x93: setComfortBlink(true); break;
+    case 0x94: setComfortBlink(false); break;
+    case 0x95: triggerPanic(); break;
+    case 0x96: setMirrorFoldOnLock(true); break;
+    case 0x97: setMirrorFoldOnLock(false); break;
+    case 0x98: setNextClusterTextIsGreeting(true); break;
+    case 0x99: calibrateProximity(); break;
+    case 0xA0:
+      /* Sequence id is a parameter: acknowledged path only. */
+      if (plen < 1 || startSequence(params[0]) != IBUS_SEQ_OK)
+        return false;
+      break;
+    case 0xA1: stopSequence(); break;
+    default: return false;
+  }
+  if (demoMode_) {
+    char buf[12];
+    snprintf(buf, sizeof(buf), "Cmd %u", (unsigned)cmd);
+    sendClusterText(buf);
+  }
+  return true;
+}
+
 void BmwManager::begin() {
   active_ = true;
   ibusSynced_ = false;
@@ -457,66 +652,22 @@ void BmwManager::begin() {
     if (s_bmwForIbus)
       s_bmwForIbus->onPhoneConnectionChanged(connected);
   });
+  bleKey_.setProximityCallback([](BleProximityEvent evt) {
+    if (s_bmwForIbus)
+      s_bmwForIbus->onProximityEvent(evt);
+  });
   bleKey_.setLightCommandCallback([](uint8_t cmd) {
     if (!s_bmwForIbus)
       return;
-    bool needIbus = (cmd <= 31 || cmd == 0x80 || cmd == 0x81);
-    if (needIbus && !s_bmwForIbus->isIbusSynced())
+    if (BmwManager::commandNeedsIbus(cmd) && !s_bmwForIbus->isIbusSynced())
       return;
-    switch (cmd) {
-      case 0: s_bmwForIbus->sendGoodbyeLights(); break;
-      case 1: s_bmwForIbus->sendFollowMeHome(); break;
-      case 2: s_bmwForIbus->sendParkLights(); break;
-      case 3: s_bmwForIbus->sendHazardLights(); break;
-      case 4: s_bmwForIbus->sendLowBeams(); break;
-      case 5: s_bmwForIbus->sendLightsOff(); break;
-      case 6: s_bmwForIbus->sendUnlock(); break;
-      case 7: s_bmwForIbus->sendLock(); break;
-      case 8: s_bmwForIbus->sendTrunkOpen(); break;
-      case 9: s_bmwForIbus->sendClusterText("NOCT"); break;
-      case 10: s_bmwForIbus->sendDoorsUnlockInterior(); break;
-      case 11: s_bmwForIbus->sendDoorsLockKey(); break;
-      case 12: s_bmwForIbus->sendWindowFrontDriverOpen(); break;
-      case 13: s_bmwForIbus->sendWindowFrontDriverClose(); break;
-      case 14: s_bmwForIbus->sendWindowFrontPassengerOpen(); break;
-      case 15: s_bmwForIbus->sendWindowFrontPassengerClose(); break;
-      case 16: s_bmwForIbus->sendWindowRearDriverOpen(); break;
-      case 17: s_bmwForIbus->sendWindowRearDriverClose(); break;
-      case 18: s_bmwForIbus->sendWindowRearPassengerOpen(); break;
-      case 19: s_bmwForIbus->sendWindowRearPassengerClose(); break;
-      case 20: s_bmwForIbus->sendWipersFront(); break;
-      case 21: s_bmwForIbus->sendWasherFront(); break;
-      case 22: s_bmwForIbus->sendInteriorOff(); break;
-      case 23: s_bmwForIbus->sendInteriorOn3s(); break;
-      case 24: s_bmwForIbus->sendClownFlash(); break;
-      case 25: s_bmwForIbus->sendDoorsHardLock(); break;
-      case 26: s_bmwForIbus->sendAllExceptDriverLock(); break;
-      case 27: s_bmwForIbus->sendDriverDoorLock(); break;
-      case 28: s_bmwForIbus->sendDoorsFuelTrunk(); break;
-      case 29: s_bmwForIbus->sendDoorsUnlockGM(); break;
-      case 30: s_bmwForIbus->sendMflNext(); break;
-      case 31: s_bmwForIbus->sendMflPrev(); break;
-      case 0x80: s_bmwForIbus->startLightShow(); break;
-      case 0x81: s_bmwForIbus->stopLightShow(); break;
-      case 0x90: s_bmwForIbus->setWigWagActive(!s_bmwForIbus->isWigWagActive()); break;
-      case 0x91: s_bmwForIbus->setSensoryDark(true); s_bmwForIbus->sendSensoryDarkLcm(); break;
-      case 0x92: s_bmwForIbus->setSensoryDark(false); break;
-      case 0x93: s_bmwForIbus->setComfortBlink(true); break;
-      case 0x94: s_bmwForIbus->setComfortBlink(false); break;
-      case 0x95: s_bmwForIbus->triggerPanic(); break;
-      case 0x96: s_bmwForIbus->setMirrorFoldOnLock(true); break;
-      case 0x97: s_bmwForIbus->setMirrorFoldOnLock(false); break;
-      case 0x98: s_bmwForIbus->setNextClusterTextIsGreeting(true); break;
-      default: break;
-    }
-    if (s_bmwForIbus && s_bmwForIbus->isDemoMode()) {
-      char buf[12];
-      snprintf(buf, sizeof(buf), "Cmd %u", (unsigned)cmd);
-      s_bmwForIbus->sendClusterText(buf);
-    }
+    s_bmwForIbus->executeCommand(cmd, nullptr, 0);
   });
-  bleKey_.setNowPlayingCallback([](const char *track, const char *artist) {
+  bleKey_.setCommandExecutor(bleCommandExecutor, this);
+  bleKey_.setNowPlayingCallback([](const BleMediaInfo &info) {
     if (s_bmwForIbus) {
+      const char *track = info.track;
+      const char *artist = info.artist;
       s_bmwForIbus->setNowPlaying(track, artist);
       s_bmwForIbus->sendUpdateMid();
       /* Also send Now Playing to cluster (IKE) up to 20 chars — for AUX, track name is visible on cluster. */
@@ -556,17 +707,24 @@ void BmwManager::begin() {
   demoManagerEnsureTaskCreated();
 
   bleKey_.begin();
+  registerHistorySources();
   /* Allow BLE stack to start advertising before launching I-Bus tasks. */
   vTaskDelay(pdMS_TO_TICKS(250));
 #if NOCT_IBUS_ENABLED
   ibus_.setPacketHandler(ibusPacketForward);
+  ibus_.setTxDoneCallback(ibusTxDoneForward);
   ibus_.begin(NOCT_IBUS_TX_PIN, NOCT_IBUS_RX_PIN);
 #endif
+  for (int i = 0; i < IBUS_SEQ_VAR_COUNT; i++)
+    seqState_[i].store(0xFF);
+  seq_.begin(seqSendForward, seqQueryForward, this);
 }
 
 void BmwManager::end() {
   demoManagerSetActive(false);
   bleKey_.end();
+  bleBulkRemoveFiles(bleKey_.bulk());
+  seq_.end();
   ibus_.end();
   s_bmwForIbus = nullptr;
   active_ = false;
@@ -577,6 +735,7 @@ void BmwManager::tick() {
   if (!active_)
     return;
   ibus_.tick();
+  bleKey_.setPowerInputs(lastIgnition_, batteryPct_, externalPower_);
   bleKey_.tick();
   if (demoMode_)
     ibusSynced_ = true;
@@ -592,7 +751,14 @@ void BmwManager::tick() {
     phoneConnected_ = true;
     TelemetryData data;
     while (demoManagerDrain(&data)) {
+      const uint32_t at = (uint32_t)millis();
+      telemetry_.publish(TELEM_SRC_DEMO, TELEM_SIG_RPM, data.rpm, at);
+      telemetry_.publish(TELEM_SRC_DEMO, TELEM_SIG_SPEED, data.speedKmh, at);
+      telemetry_.publish(TELEM_SRC_DEMO, TELEM_SIG_COOLANT, data.coolantTempC, at);
+      telemetry_.publish(TELEM_SRC_DEMO, TELEM_SIG_OIL, data.coolantTempC + 10, at);
       obdRpm_ = data.rpm;
+      shift_.setSpeed(data.speedKmh);
+      shift_.addSample(data.rpm, (uint32_t)millis());
       obdCoolantTempC_ = data.coolantTempC;
       obdOilTempC_ = data.coolantTempC + 10;
       lastIkeCoolantC_ = data.coolantTempC;
@@ -600,6 +766,10 @@ void BmwManager::tick() {
       demoHadPacket = true;
     }
     if (!demoHadPacket) {
+      const uint32_t at = (uint32_t)millis();
+      telemetry_.publish(TELEM_SRC_DEMO, TELEM_SIG_RPM, 800, at);
+      telemetry_.publish(TELEM_SRC_DEMO, TELEM_SIG_COOLANT, 88, at);
+      telemetry_.publish(TELEM_SRC_DEMO, TELEM_SIG_OIL, 90, at);
       obdRpm_ = 800;
       obdCoolantTempC_ = 88;
       obdOilTempC_ = 90;
@@ -621,7 +791,8 @@ void BmwManager::tick() {
   }
 
   unsigned long now = millis();
-  tickWigWag(now);
+  publishSequenceState();
+  seq_.tick();
   tickGreetingOnIgnition(now);
 #if NOCT_BMW_DEBUG
   static bool lastLoggedConnected = false;
@@ -630,6 +801,13 @@ void BmwManager::tick() {
     Serial.printf("[BMW] BLE phoneConnected=%d ibusSynced=%d\n", phoneConnected_ ? 1 : 0, ibusSynced_ ? 1 : 0);
   }
 #endif
+  /* Proximity: no RSSI from this phone/controller -> unlock on connect as without proximity. */
+  if (proximityUnlockPending_ && now - phoneConnectedAtMs_ >= kProximityFallbackMs &&
+      !bleKey_.proximityWarm()) {
+    proximityUnlockPending_ = false;
+    if (ibusSynced_ && !demoMode_)
+      ibus_.write(REMOTE_UNLOCK, sizeof(REMOTE_UNLOCK));
+  }
   /* Welcome message on cluster when BLE connects (once per connection). */
   if (!wasConnected && phoneConnected_ && ibusSynced_ && !welcomeSentOnConnect_) {
     sendClusterText("BMW Nocturne");
@@ -649,38 +827,33 @@ void BmwManager::tick() {
     pollAlternate_++;
     lastPollMs_ = now;
   }
-  /* Light show: configurable sequence (Hazard -> Park -> Goodbye -> LowBeam -> Off). */
-  static const uint8_t kLightShowSequence[] = { 0, 1, 2, 3, 4 };
-  static const unsigned int kLightShowDelayMs = 800;
-  const size_t kLightShowSteps = sizeof(kLightShowSequence) / sizeof(kLightShowSequence[0]);
-  if (lightShowActive_ && ibusSynced_ && now - lastLightShowMs_ >= kLightShowDelayMs) {
-    lastLightShowMs_ = now;
-    size_t idx = (size_t)(lightShowStep_ % (int)kLightShowSteps);
-    if (!demoMode_) {
-      switch (kLightShowSequence[idx]) {
-        case 0: ibus_.write(HazardLights, sizeof(HazardLights)); break;
-        case 1: ibus_.write(ParkLights_And_Signals, sizeof(ParkLights_And_Signals)); break;
-        case 2: ibus_.write(GoodbyeLights, sizeof(GoodbyeLights)); break;
-        case 3: ibus_.write(Low_Beams, sizeof(Low_Beams)); break;
-        case 4: ibus_.write(TurnOffLights, sizeof(TurnOffLights)); break;
-        default: break;
-      }
-    }
-    lightShowStep_++;
-  }
-  /* Shift indicator on cluster: when OBD connected and RPM >= threshold, send "SHIFT!" to IKE periodically. */
-  if (obdConnected_ && obdRpm_ >= kShiftRpmThreshold && ibusSynced_ && now - lastShiftClusterMs_ >= kShiftClusterIntervalMs) {
+  /* Shift indicator on cluster: "SHIFT!" to IKE as soon as the cue fires, then periodically while it lasts. */
+  shift_.update((uint32_t)now);
+  const bool shiftRising = shift_.takeRising();
+  if (shiftCueActive() && ibusSynced_ && (shiftRising || now - lastShiftClusterMs_ >= kShiftClusterIntervalMs)) {
     sendClusterText("SHIFT!");
     lastShiftClusterMs_ = now;
+#if NOCT_BMW_DEBUG
+    if (shiftRising)
+      Serial.printf("[BMW] shift cue gear %u rpm %d slope %d/s lead %lu ms\n", (unsigned)shift_.gear(),
+                    shift_.predictedRpm(), shift_.slope(), (unsigned long)shift_.horizonMs());
+#endif
   }
+  /* Telemetry for every consumer below: the freshest valid value per signal (TelemetryArbiter.h). */
+  const TelemetryReading rpmR = telemetry_.read(TELEM_SIG_RPM, (uint32_t)now);
+  const TelemetryReading speedR = telemetry_.read(TELEM_SIG_SPEED, (uint32_t)now);
+  const TelemetryReading coolantR = telemetry_.read(TELEM_SIG_COOLANT, (uint32_t)now);
+  const TelemetryReading oilR = telemetry_.read(TELEM_SIG_OIL, (uint32_t)now);
+  logTelemetry(now);
   /* BLE status characteristic: flags, coolant, oil, rpm, PDC. */
-  int coolantC = obdConnected_ ? obdCoolantTempC_ : lastIkeCoolantC_;
+  int coolantC = coolantR.valid ? (int)coolantR.value : -1;
   if (coolantC < -40 || coolantC > 127)
     coolantC = -1;
-  int oilC = obdOilTempC_;
+  int oilC = oilR.valid ? (int)oilR.value : -1;
   if (oilC < -40 || oilC > 127)
     oilC = -1;
-  int rpm = (obdRpm_ >= 0 && obdRpm_ <= 65535) ? obdRpm_ : -1;
+  const int rpm = rpmR.valid ? (int)rpmR.value : -1;
+  const int speedKmh = speedR.valid ? (int)speedR.value : -1;
   /* Lock state from 0x7a byte1: 0x10=unlocked, 0x20=locked, 0x30=double. */
   uint8_t lockState = 0xFF;
   if (lastDoorLidByte1_ != 0xFF) {
@@ -696,6 +869,107 @@ void BmwManager::tick() {
                       coolantC, oilC, rpm, pdcDists_, (uint8_t)lastMflAction_,
                       lastDoorLidByte1_, lastDoorLidByte2_, lockState,
                       lastIgnition_ >= 0 ? lastIgnition_ : -1, odom);
+  /* BLE telemetry stream: full-range values, sampled at the rate the phone asked for. */
+  BleTelemetrySample sample;
+  if (rpm >= 0)
+    sample.v[0] = rpm;
+  if (speedKmh >= 0)
+    sample.v[1] = speedKmh;
+  if (coolantC != -1)
+    sample.v[2] = coolantC;
+  if (oilC != -1)
+    sample.v[3] = oilC;
+  if (lastOdometerKm_ >= 0)
+    sample.v[4] = lastOdometerKm_;
+  bleKey_.updateTelemetry(sample);
+  recordHistory(millis(), rpm, speedKmh, coolantC, oilC);
+}
+
+/* Once per kTelemetryLogMs: source in use per signal and the data age consumers got since the last line. */
+void BmwManager::logTelemetry(unsigned long now) {
+  if (now - telemetryLogMs_ < kTelemetryLogMs)
+    return;
+  telemetryLogMs_ = now;
+#if NOCT_BMW_DEBUG
+  for (uint8_t sig = 0; sig < TELEM_SIG_COUNT; sig++) {
+    const TelemetryArbiter::SignalStats &st = telemetry_.stats(sig);
+    const TelemetryReading r = telemetry_.peek(sig, (uint32_t)now);
+    Serial.printf("[BMW] telem %s %s%s: age avg %u p99 %u max %u ms, switches %u, stale %u/%u\n",
+                  TelemetryArbiter::signalName(sig), TelemetryArbiter::sourceName(r.source), r.valid ? "" : " (stale)",
+                  (unsigned)telemetry_.ageAvgMs(sig), (unsigned)telemetry_.agePercentileMs(sig, 99),
+                  (unsigned)st.ageMaxMs, (unsigned)st.switches, (unsigned)st.staleReads, (unsigned)st.reads);
+  }
+#endif
+  telemetry_.resetStats();
+}
+
+void BmwManager::registerHistorySources() {
+  if (historyGeneration_ == 0) {
+    historyGeneration_ = esp_random() | 1u;
+    tripHistory_.setGeneration(historyGeneration_);
+    ibusHistory_.setGeneration(historyGeneration_);
+    batteryHistory_.setGeneration(historyGeneration_);
+  }
+  BleBulkSession &bulk = bleKey_.bulk();
+  bulk.addSource(BLE_BULK_SRC_TRIP, "trip", &tripHistory_);
+  bulk.addSource(BLE_BULK_SRC_IBUS, "ibus", &ibusHistory_);
+  bulk.addSource(BLE_BULK_SRC_BATTERY, "battery", &batteryHistory_);
+  size_t files = bleBulkAddFiles(bulk);
+#if NOCT_BMW_DEBUG
+  Serial.printf("[BMW] History: 3 rings (%u KB), %u LittleFS files\n",
+                (unsigned)((kTripHistoryBytes + kIbusHistoryBytes + kBatteryHistoryBytes) / 1024), (unsigned)files);
+#else
+  (void)files;
+#endif
+}
+
+static void putU32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+void BmwManager::recordHistory(unsigned long now, int rpm, int speedKmh, int coolantC, int oilC) {
+  /* Trip: [t s u32][rpm u16][speed][coolant][oil][ignition][battery %][flags][odometer km u24][pad]. */
+  if (now - lastTripSampleMs_ >= kTripSampleMs) {
+    lastTripSampleMs_ = now;
+    uint8_t rec[16] = {0};
+    putU32(rec, (uint32_t)(now / 1000));
+    const uint16_t r = (rpm >= 0 && rpm < 0xFFFF) ? (uint16_t)rpm : 0xFFFF;
+    rec[4] = (uint8_t)r;
+    rec[5] = (uint8_t)(r >> 8);
+    rec[6] = (speedKmh >= 0 && speedKmh < 0xFF) ? (uint8_t)speedKmh : 0xFF;
+    rec[7] = coolantC != -1 ? (uint8_t)(int8_t)coolantC : 0x80;
+    rec[8] = oilC != -1 ? (uint8_t)(int8_t)oilC : 0x80;
+    rec[9] = lastIgnition_ >= 0 ? (uint8_t)lastIgnition_ : 0xFF;
+    rec[10] = (batteryPct_ >= 0 && batteryPct_ <= 100) ? (uint8_t)batteryPct_ : 0xFF;
+    rec[11] = (ibusSynced_ ? 0x01 : 0) | (obdConnected_ ? 0x02 : 0) | (phoneConnected_ ? 0x04 : 0) |
+              (demoMode_ ? 0x08 : 0);
+    const uint32_t odo = lastOdometerKm_ >= 0 ? (uint32_t)lastOdometerKm_ : 0xFFFFFFu;
+    rec[12] = (uint8_t)odo;
+    rec[13] = (uint8_t)(odo >> 8);
+    rec[14] = (uint8_t)(odo >> 16);
+    tripHistory_.append(rec, sizeof(rec));
+  }
+  /* Battery: [t s u32][pct][external power][pad]. */
+  if (lastBatterySampleMs_ == 0 || now - lastBatterySampleMs_ >= kBatterySampleMs) {
+    lastBatterySampleMs_ = now ? now : 1;
+    uint8_t rec[7] = {0};
+    putU32(rec, (uint32_t)(now / 1000));
+    rec[4] = (batteryPct_ >= 0 && batteryPct_ <= 100) ? (uint8_t)batteryPct_ : 0xFF;
+    rec[5] = externalPower_ ? 1 : 0;
+    batteryHistory_.append(rec, sizeof(rec));
+  }
+}
+
+void BmwManager::recordIbusHistory(const uint8_t *packet) {
+  /* I-Bus: [t ms u32][source][length][destination][data...][checksum] as received. */
+  uint8_t rec[4 + 2 + 0x24];
+  const size_t total = 2u + (size_t)packet[1];
+  putU32(rec, (uint32_t)millis());
+  memcpy(rec + 4, packet, total);
+  ibusHistory_.append(rec, 4 + total);
 }
 
 void BmwManager::getStatusLine(char *buf, size_t len) const {
@@ -705,11 +979,12 @@ void BmwManager::getStatusLine(char *buf, size_t len) const {
     snprintf(buf, len, "BMW OFF");
     return;
   }
-  if (obdConnected_ && len >= 32) {
+  const TelemetryReading rpm = telemetry_.peek(TELEM_SIG_RPM, (uint32_t)millis());
+  if (rpm.valid && len >= 32) {
     snprintf(buf, len, "IBUS %s | BLE %s | RPM %d",
             ibusSynced_ ? "OK" : "--",
             phoneConnected_ ? "ON" : "OFF",
-            obdRpm_);
+            (int)rpm.value);
     return;
   }
   snprintf(buf, len, "IBUS %s | BLE %s",
@@ -10,6 +10,9 @@
 #include "ibus/IbusDriver.h"
 #include "BleKeyService.h"
 #include "DemoManager.h"
+#include "IbusSeqRunner.h"
+#include "ShiftPredictor.h"
+#include "TelemetryArbiter.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 
@@ -78,10 +81,19 @@ class BmwManager {
   /** Cyclic light show (e.g. for shows/video): cycles Hazard/Park/Goodbye/LowBeam/LightsOff. */
   void startLightShow();
   void stopLightShow();
-  bool isLightShowActive() const { return lightShowActive_; }
+  bool isLightShowActive() const { return seq_.runningId() == IBUS_SEQ_LIGHT_SHOW; }
   /** For demo/OLED: current light show step name ("Hazard","Park",...) or "" if inactive. */
   const char *getLightShowStepName() const;
 
+  /** Timed I-Bus sequence (IbusSequence.h): built-in IBUS_SEQ_* or a LittleFS script; replaces the running
+   *  one. IBUS_SEQ_OK or IBUS_SEQ_ERR_*. BLE cmd 0xA0 [id], 0xA1 stops. */
+  uint8_t startSequence(uint8_t id);
+  void stopSequence() { seq_.stop(); }
+  uint8_t getSequenceId() const { return seq_.runningId(); }
+  /** Sequence runner task side: frame to the bus (dropped while not synced / demo) and JUMP_IF state. */
+  bool sequenceWrite(const uint8_t *frame, uint8_t len);
+  uint8_t sequenceState(uint8_t var) const { return var < IBUS_SEQ_VAR_COUNT ? seqState_[var].load() : 0xFF; }
+
   /** Demo only: last cluster text sent (for OLED display when no real cluster). Empty if none. */
   const char *getDemoClusterText() const { return lastClusterTextDemo_; }
   enum MflAction { MFL_NONE = 0, MFL_NEXT, MFL_PREV, MFL_PLAY_PAUSE, MFL_VOL_UP, MFL_VOL_DOWN };
@@ -113,6 +125,20 @@ class BmwManager {
   int getObdCoolantTempC() const { return obdCoolantTempC_; }
   int getObdOilTempC() const { return obdOilTempC_; }
   void setObdData(bool connected, int rpm, int coolantC, int oilC);
+  /** One OBD RPM value with the time the ECU sampled it (ObdClient sample callback). */
+  void addObdRpmSample(int rpm, int speedKmh, uint32_t sampleMs);
+  /** Any polled OBD PID value with its sampling time, for the telemetry arbiter. */
+  void addObdSample(uint8_t pid, int32_t value, uint32_t sampleMs);
+  /** Sample from a source outside the car (Forza Data Out). */
+  void publishTelemetry(uint8_t source, uint8_t signal, int32_t value, uint32_t sampleMs) {
+    telemetry_.publish(source, signal, value, sampleMs);
+  }
+  /** Best current value of a TELEM_SIG_* across OBD, IKE, Forza and demo, with age and source. */
+  TelemetryReading telemetry(uint8_t signal) const { return telemetry_.peek(signal, (uint32_t)millis()); }
+  const TelemetryArbiter &telemetryArbiter() const { return telemetry_; }
+  /** Shift light: predicted RPM has reached the threshold for the current gear (LED + IKE "SHIFT!"). */
+  bool shiftCueActive() const { return obdConnected_ && shift_.active(); }
+  const ShiftPredictor &shiftPredictor() const { return shift_; }
   /** Last coolant from I-Bus IKE (0x19), -128 = no data. Use when OBD not connected. */
   int getIkeCoolantC() const { return lastIkeCoolantC_; }
 
@@ -123,9 +149,25 @@ class BmwManager {
   int getIgnitionState() const { return lastIgnition_; }
   /** Odometer from IKE 0x17 (km), -1 = no data. */
   int getOdometerKm() const { return lastOdometerKm_; }
+  /** Board battery for BLE power profile (low battery keeps BLE in PARKED while ignition is off). */
+  void setBatteryState(int batteryPct, bool externalPower) {
+    batteryPct_ = batteryPct;
+    externalPower_ = externalPower;
+  }
 
   void onIbusPacket(uint8_t *packet);
+  /** Run a BLE control command (0..31 I-Bus actions, 0x80.. light show / flex). False if unknown. */
+  bool executeCommand(uint8_t cmd, const uint8_t *params, uint8_t plen);
+  static bool commandNeedsIbus(uint8_t cmd);
+  /** Most I-Bus frames one command queues; the executor waits for this much TX queue space. */
+  static const uint8_t kCommandMaxFrames = 4;
+  /** TX result of a tagged I-Bus write (from IbusDriver::tick()). */
+  void onIbusTxDone(uint16_t tag, bool ok) { bleKey_.onCommandTxDone(tag, ok); }
   void onPhoneConnectionChanged(bool connected);
+  /** BLE cmd 0x99: phone is held 1 m from the board; store its RSSI calibration. */
+  bool calibrateProximity();
+  /** RSSI proximity event from BleKeyService (NEAR = unlock + welcome flash, LEAVING = lock). */
+  void onProximityEvent(BleProximityEvent evt);
 
   /** Last action feedback for dashboard (e.g. "Lock sent"). Cleared after timeout. */
   void setLastActionFeedback(const char *msg);
@@ -136,18 +178,22 @@ class BmwManager {
   bool isNextClusterTextGreeting() const { return nextClusterTextIsGreeting_; }
   void storeStartupGreeting(const char *text);
 
-  void setWigWagActive(bool v) { wigWagActive_ = v; if (!v) wigWagStep_ = 0; }
-  bool isWigWagActive() const { return wigWagActive_; }
+  void setWigWagActive(bool v);
+  bool isWigWagActive() const {
+    const uint8_t id = seq_.runningId();
+    return id == IBUS_SEQ_WIG_WAG || id == IBUS_SEQ_PANIC;
+  }
   void setSensoryDark(bool v) { sensoryDark_ = v; }
   void setComfortBlink(bool v) { comfortBlinkEnabled_ = v; }
-  void triggerPanic() { panicActive_ = true; wigWagActive_ = true; }
+  void triggerPanic() { startSequence(IBUS_SEQ_PANIC); }
   void setMirrorFoldOnLock(bool v) { mirrorFoldOnLock_ = v; }
   void setNextClusterTextIsGreeting(bool v) { nextClusterTextIsGreeting_ = v; }
 
  private:
   void parseMflButton(uint8_t *packet);
   void parsePdcPacket(uint8_t *packet);
-  void tickWigWag(unsigned long now);
+  /** Publish the state JUMP_IF reads (runner task) from this loop pass. */
+  void publishSequenceState();
   void tickGreetingOnIgnition(unsigned long now);
   /** Send LCM diagnostic for panel dim 0% (sensory dark). Placeholder payload until LCM dim bytes confirmed. */
   void sendSensoryDarkLcm();
@@ -174,35 +220,64 @@ class BmwManager {
   uint8_t lastDoorLidByte2_ = 0xFF;
   int lastIgnition_ = -1;
   int lastOdometerKm_ = -1;
+  /* Proximity: unlock waits for NEAR after connect; lock on LEAVING makes the disconnect lock redundant. */
+  bool proximityUnlockPending_ = false;
+  bool proximityLocked_ = false;
+  unsigned long phoneConnectedAtMs_ = 0;
+  /** No RSSI readings this long after connect (controller/phone without RSSI): unlock as before. */
+  static const unsigned long kProximityFallbackMs = 4000;
+  int batteryPct_ = -1;
+  bool externalPower_ = true;
   unsigned long lastPollMs_ = 0;
   uint8_t pollAlternate_ = 0;
   bool welcomeSentOnConnect_ = false;
-  bool lightShowActive_ = false;
-  uint8_t lightShowStep_ = 0;
-  unsigned long lastLightShowMs_ = 0;
-  static const unsigned long kLightShowIntervalMs = 800;
   /** Demo: last cluster text sent (shown on OLED when in demo mode). */
   static const int kDemoClusterTextLen = 21;
   char lastClusterTextDemo_[kDemoClusterTextLen];
+  /** RPM slope extrapolated over the OBD/loop/output latency; see ShiftPredictor.h. */
+  ShiftPredictor shift_;
+  /** RPM, speed and temperatures from every source; consumers read the freshest valid one. */
+  TelemetryArbiter telemetry_;
+  unsigned long telemetryLogMs_ = 0;
+  static const unsigned long kTelemetryLogMs = 10000;
   unsigned long lastShiftClusterMs_ = 0;
   static const unsigned long kShiftClusterIntervalMs = 1000;
-  static const int kShiftRpmThreshold = 5500;
   IbusDriver ibus_;
   BleKeyService bleKey_;
+  /** Light show, wig-wag, panic and other timed I-Bus patterns run as scripts on their own task. */
+  IbusSeqRunner seq_;
+  std::atomic<uint8_t> seqState_[IBUS_SEQ_VAR_COUNT] = {};
+  std::atomic<bool> seqOutputEnabled_{false};
+
+  /** History for bulk download to the phone (BleBulkTransfer.h): trip samples at 1 Hz, raw I-Bus packets,
+   *  battery once a minute. RAM only; generation = boot id, so after a reboot the phone starts over. */
+  void registerHistorySources();
+  void recordHistory(unsigned long now, int rpm, int speedKmh, int coolantC, int oilC);
+  void logTelemetry(unsigned long now);
+  void recordIbusHistory(const uint8_t *packet);
+  static const size_t kTripHistoryBytes = 16 * 1024;     /* 16-byte records: ~17 min */
+  static const size_t kIbusHistoryBytes = 16 * 1024;
+  static const size_t kBatteryHistoryBytes = 2 * 1024;   /* 7-byte records: ~4.8 h */
+  static const unsigned long kTripSampleMs = 1000;
+  static const unsigned long kBatterySampleMs = 60000;
+  uint8_t tripHistoryBuf_[kTripHistoryBytes];
+  uint8_t ibusHistoryBuf_[kIbusHistoryBytes];
+  uint8_t batteryHistoryBuf_[kBatteryHistoryBytes];
+  BleHistoryRing tripHistory_{tripHistoryBuf_, kTripHistoryBytes};
+  BleHistoryRing ibusHistory_{ibusHistoryBuf_, kIbusHistoryBytes};
+  BleHistoryRing batteryHistory_{batteryHistoryBuf_, kBatteryHistoryBytes};
+  uint32_t historyGeneration_ = 0;
+  unsigned long lastTripSampleMs_ = 0;
+  unsigned long lastBatterySampleMs_ = 0;
   static const int kLastActionFeedbackLen = 32;
   static const unsigned long kLastActionFeedbackTimeoutMs = 3000;
   char lastActionFeedback_[kLastActionFeedbackLen];
   unsigned long lastActionFeedbackTime_ = 0;
 
   /* Flex / Instincts: BLE command state (non-blocking) */
-  bool wigWagActive_ = false;
-  uint8_t wigWagStep_ = 0;
-  unsigned long lastWigWagMs_ = 0;
-  static const unsigned long kWigWagIntervalMs = 300;
   bool sensoryDark_ = false;
   bool comfortBlinkEnabled_ = false;
   bool mirrorFoldOnLock_ = false;
-  bool panicActive_ = false;
   bool nextClusterTextIsGreeting_ = false;
   static const int kStartupGreetingLen = 21;
   char startupGreeting_[kStartupGreetingLen];
@@ -0,0 +1,172 @@
+/*
+ * NOCTURNE_OS — IbusSeqRunner: sequence task, script lookup (flash / LittleFS).
+ */
+#include "IbusSeqRunner.h"
+#include "nocturne/config.h"
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#if __has_include(<LittleFS.h>)
+#include <LittleFS.h>
+#define NOCT_SEQ_HAS_FS 1
+#endif
+
+size_t IbusSeqRunner::loadFile(uint8_t id, uint8_t *buf, size_t cap) {
+#ifdef NOCT_SEQ_HAS_FS
+  if (!LittleFS.begin(false))
+    return 0;
+  char path[24];
+  snprintf(path, sizeof(path), IBUS_SEQ_FS_DIR "/%02x.bin", (unsigned)id);
+  if (!LittleFS.exists(path))
+    return 0;
+  File f = LittleFS.open(path, "r");
+  if (!f)
+    return 0;
+  size_t n = 0;
+  if (f.size() <= cap)
+    n = f.read(buf, cap);
+  f.close();
+  return n;
+#else
+  (void)id;
+  (void)buf;
+  (void)cap;
+  return 0;
+#endif
+}
+
+void IbusSeqRunner::apply(const Request &r, uint32_t nowMs) {
+  engine_.stop(send_, ctx_);
+  if (r.len == 0)
+    return;
+  engine_.resetStats();
+  engine_.start(r.id, r.code, r.len, nowMs);
+}
+
+void IbusSeqRunner::publish() {
+  runningId_.store(engine_.id());
+  mark_.store(engine_.mark());
+}
+
+uint8_t IbusSeqRunner::start(uint8_t id) {
+  size_t len = 0;
+  if (id < IBUS_SEQ_FILE_FIRST) {
+    const uint8_t *p = ibusSeqBuiltin(id, &len);
+    if (p)
+      memcpy(req_.code, p, len);
+  } else {
+    len = loadFile(id, req_.code, sizeof(req_.code));
+  }
+  if (len == 0)
+    return IBUS_SEQ_ERR_NOT_FOUND;
+  /* Validate here too: the phone gets the reason, the task never sees a bad script. */
+  const uint8_t err = ibusSeqValidate(req_.code, len);
+  if (err != IBUS_SEQ_OK)
+    return err;
+  req_.id = id;
+  req_.len = (uint8_t)len;
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  if (queue_ == nullptr || xQueueSend(queue_, &req_, 0) != pdTRUE)
+    return IBUS_SEQ_ERR_BUSY;
+  runningId_.store(id);
+#else
+  apply(req_, millis());
+  publish();
+#endif
+#if NOCT_BMW_DEBUG
+  Serial.printf("[BMW] Sequence %u started (%u bytes)\n", (unsigned)id, (unsigned)len);
+#endif
+  return IBUS_SEQ_OK;
+}
+
+void IbusSeqRunner::stop() {
+  req_.id = 0;
+  req_.len = 0;
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  if (queue_ != nullptr && xQueueSend(queue_, &req_, 0) == pdTRUE)
+    runningId_.store(0);
+#else
+  apply(req_, millis());
+  publish();
+#endif
+}
+
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+
+void IbusSeqRunner::taskEntry(void *pv) {
+  static_cast<IbusSeqRunner *>(pv)->taskLoop();
+  vTaskDelete(nullptr);
+}
+
+void IbusSeqRunner::taskLoop() {
+  /* Task-owned copy: the main loop reuses req_ for the next request. */
+  static Request r;
+  for (;;) {
+    TickType_t wait = pdMS_TO_TICKS(kIdleWaitMs);
+    if (engine_.running()) {
+      const int32_t d = (int32_t)(engine_.dueMs() - millis());
+      wait = d > 0 ? pdMS_TO_TICKS((uint32_t)d) : 0;
+      if (d > 0 && wait == 0)
+        wait = 1;  /* tick slower than 1 ms: never spin on a not-yet-due step */
+    }
+    if (xQueueReceive(queue_, &r, wait) == pdTRUE)
+      apply(r, millis());
+    const bool wasRunning = engine_.running();
+    engine_.step(millis(), send_, query_, ctx_);
+    publish();
+#if NOCT_BMW_DEBUG
+    if (wasRunning && !engine_.running())
+      Serial.printf("[BMW] Sequence done: %u frames (%u dropped), %u steps, late max %u ms, reanchors %u\n",
+                    (unsigned)engine_.framesSent(), (unsigned)engine_.framesDropped(),
+                    (unsigned)engine_.steps(), (unsigned)engine_.lateMaxMs(), (unsigned)engine_.reanchors());
+#else
+    (void)wasRunning;
+#endif
+  }
+}
+
+void IbusSeqRunner::begin(IbusSeqSendFn send, IbusSeqQueryFn query, void *ctx) {
+  send_ = send;
+  query_ = query;
+  ctx_ = ctx;
+  if (queue_ == nullptr)
+    queue_ = xQueueCreate(kQueueLen, sizeof(Request));
+  /* Above loop() (1) and the I-Bus tasks (2): a step is a few queue posts, then it sleeps again. */
+  if (queue_ != nullptr && task_ == nullptr)
+    xTaskCreate(taskEntry, "ibus_seq", 3072, this, 3, &task_);
+}
+
+void IbusSeqRunner::end() {
+  if (task_ != nullptr) {
+    vTaskDelete(task_);
+    task_ = nullptr;
+  }
+  if (queue_ != nullptr) {
+    vQueueDelete(queue_);
+    queue_ = nullptr;
+  }
+  engine_.stop(send_, ctx_);
+  publish();
+}
+
+void IbusSeqRunner::tick() {}
+
+#else
+
+void IbusSeqRunner::begin(IbusSeqSendFn send, IbusSeqQueryFn query, void *ctx) {
+  send_ = send;
+  query_ = query;
+  ctx_ = ctx;
+}
+
+void IbusSeqRunner::end() {
+  engine_.stop(send_, ctx_);
+  publish();
+}
+
+void IbusSeqRunner::tick() {
+  engine_.step(millis(), send_, query_, ctx_);
+  publish();
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * NOCTURNE_OS — IbusSeqRunner: runs IbusSequence scripts on their own FreeRTOS task.
+ * The task sleeps until the engine's next deadline, so step timing does not depend on loop() load.
+ * Scripts: built-in (flash) or LittleFS IBUS_SEQ_FS_DIR/<id as 2 hex digits>.bin for ids >= IBUS_SEQ_FILE_FIRST.
+ * Without FreeRTOS (host builds) tick() steps the engine from the loop.
+ */
+#ifndef NOCTURNE_IBUS_SEQ_RUNNER_H
+#define NOCTURNE_IBUS_SEQ_RUNNER_H
+
+#include <atomic>
+#include "IbusSequence.h"
+
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#endif
+
+#define IBUS_SEQ_FS_DIR "/seq"
+
+class IbusSeqRunner {
+ public:
+  /** send/query are called from the runner task: send must be task-safe (IbusDriver::writeUntagged),
+   *  query should read atomics. */
+  void begin(IbusSeqSendFn send, IbusSeqQueryFn query, void *ctx);
+  /** Stops the task; a running sequence gets its ON_STOP frames. */
+  void end();
+  /** Call every loop: steps the engine when there is no runner task. */
+  void tick();
+
+  /** Look the script up and hand it to the task; the previous sequence is stopped (ON_STOP) first.
+   *  IBUS_SEQ_OK, IBUS_SEQ_ERR_NOT_FOUND, IBUS_SEQ_ERR_BUSY or a validation error. */
+  uint8_t start(uint8_t id);
+  void stop();
+
+  /** Sequence running (0 = none) and its last MARK; updated by the task after every step. */
+  uint8_t runningId() const { return runningId_.load(); }
+  uint8_t mark() const { return mark_.load(); }
+
+ private:
+  struct Request {
+    uint8_t id;
+    uint8_t len;  /* 0 = stop */
+    uint8_t code[IBUS_SEQ_MAX_SCRIPT];
+  };
+  static size_t loadFile(uint8_t id, uint8_t *buf, size_t cap);
+  void apply(const Request &r, uint32_t nowMs);
+  void publish();
+
+  IbusSeqEngine engine_;
+  IbusSeqSendFn send_ = nullptr;
+  IbusSeqQueryFn query_ = nullptr;
+  void *ctx_ = nullptr;
+  std::atomic<uint8_t> runningId_{0};
+  std::atomic<uint8_t> mark_{0};
+  Request req_ = {};
+
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+  static void taskEntry(void *pv);
+  void taskLoop();
+  QueueHandle_t queue_ = nullptr;
+  TaskHandle_t task_ = nullptr;
+  static const uint8_t kQueueLen = 2;
+  /** Longest sleep without a sequence (keeps the task visible to the watchdog). */
+  static const uint32_t kIdleWaitMs = 1000;
+#endif
+};
+
+#endif
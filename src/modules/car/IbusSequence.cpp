@@ -0,0 +1,393 @@
+/*
+ * NOCTURNE_OS — timed I-Bus action sequences: built-in scripts, validator, engine.
+ */
+#include "IbusSequence.h"
+#include "ibus/IbusCodes.h"
+#include "ibus/IbusDefines.h"
+#include <cstring>
+
+#define SEQ_WAIT(ms) IBUS_SEQ_OP_WAIT, (uint8_t)((ms) & 0xFF), (uint8_t)((ms) >> 8)
+#define SEQ_CODE(c) IBUS_SEQ_OP_SEND_CODE, IBUS_SEQ_CODE_##c
+#define SEQ_LCM4(a, b, c, d) IBUS_SEQ_OP_LCM, 4, a, b, c, d
+
+namespace {
+
+struct CodeFrame {
+  const uint8_t *data;
+  uint8_t len;
+};
+
+/* Same bytes and lengths as the single-frame BmwManager::send*() calls. */
+const CodeFrame kCodes[IBUS_SEQ_CODE_COUNT] = {
+    {HazardLights, sizeof(HazardLights)},
+    {ParkLights_And_Signals, sizeof(ParkLights_And_Signals)},
+    {GoodbyeLights, sizeof(GoodbyeLights)},
+    {Low_Beams, sizeof(Low_Beams)},
+    {TurnOffLights, sizeof(TurnOffLights)},
+    {FollowMeHome, sizeof(FollowMeHome)},
+    {REMOTE_LOCK, sizeof(REMOTE_LOCK)},
+    {REMOTE_UNLOCK, sizeof(REMOTE_UNLOCK)},
+    {Window_FrontDriver_Close, sizeof(Window_FrontDriver_Close)},
+    {Window_FrontPassenger_Close, sizeof(Window_FrontPassenger_Close)},
+    {Window_RearDriver_Close, sizeof(Window_RearDriver_Close)},
+    {Window_RearPassenger_Close, sizeof(Window_RearPassenger_Close)},
+    {Window_FrontDriver_Open, sizeof(Window_FrontDriver_Open)},
+    {Window_FrontPassenger_Open, sizeof(Window_FrontPassenger_Open)},
+    {Window_RearDriver_Open, sizeof(Window_RearDriver_Open)},
+    {Window_RearPassenger_Open, sizeof(Window_RearPassenger_Open)},
+    {Interior_On3s, sizeof(Interior_On3s)},
+    {Interior_Off, sizeof(Interior_Off)},
+    {Clown_Flash, sizeof(Clown_Flash)},
+};
+
+/* Hazard -> Park -> Goodbye -> LowBeam -> Off, 800 ms each, forever; lights off when stopped. */
+const uint8_t kLightShow[] = {
+    IBUS_SEQ_OP_ON_STOP, 39,
+    IBUS_SEQ_OP_MARK, 0, SEQ_CODE(HAZARD), SEQ_WAIT(800),      /* 2 */
+    IBUS_SEQ_OP_MARK, 1, SEQ_CODE(PARK), SEQ_WAIT(800),        /* 9 */
+    IBUS_SEQ_OP_MARK, 2, SEQ_CODE(GOODBYE), SEQ_WAIT(800),     /* 16 */
+    IBUS_SEQ_OP_MARK, 3, SEQ_CODE(LOW_BEAM), SEQ_WAIT(800),    /* 23 */
+    IBUS_SEQ_OP_MARK, 4, SEQ_CODE(LIGHTS_OFF), SEQ_WAIT(800),  /* 30 */
+    IBUS_SEQ_OP_JUMP, 2,                                       /* 37 */
+    SEQ_CODE(LIGHTS_OFF), IBUS_SEQ_OP_END,                     /* 39 */
+};
+
+/* LCM diagnostic left / right, then off, 300 ms each, forever. */
+const uint8_t kWigWag[] = {
+    IBUS_SEQ_OP_ON_STOP, 27,
+    SEQ_LCM4(0x0C, 0x01, 0x00, 0x00), SEQ_WAIT(300),  /* 2 */
+    SEQ_LCM4(0x0C, 0x02, 0x00, 0x00), SEQ_WAIT(300),  /* 11 */
+    SEQ_CODE(LIGHTS_OFF), SEQ_WAIT(300),              /* 20 */
+    IBUS_SEQ_OP_JUMP, 2,                              /* 25 */
+    SEQ_CODE(LIGHTS_OFF), IBUS_SEQ_OP_END,            /* 27 */
+};
+
+/* Wig-wag for 30 cycles (27 s); ends early once the car is unlocked (owner is back). */
+const uint8_t kPanic[] = {
+    IBUS_SEQ_OP_ON_STOP, 33,
+    IBUS_SEQ_OP_REPEAT, 30,                                                   /* 2 */
+    IBUS_SEQ_OP_JUMP_IF, IBUS_SEQ_VAR_LOCK, IBUS_SEQ_CMP_EQ, 0, 33,           /* 4 */
+    SEQ_LCM4(0x0C, 0x01, 0x00, 0x00), SEQ_WAIT(300),                          /* 9 */
+    SEQ_LCM4(0x0C, 0x02, 0x00, 0x00), SEQ_WAIT(300),                          /* 18 */
+    SEQ_CODE(LIGHTS_OFF), SEQ_WAIT(300),                                      /* 27 */
+    IBUS_SEQ_OP_LOOP,                                                         /* 32 */
+    SEQ_CODE(LIGHTS_OFF), IBUS_SEQ_OP_END,                                    /* 33 */
+};
+
+/* Goodbye lights for 30 s, then off; nothing while the engine runs. */
+const uint8_t kGoodbye[] = {
+    IBUS_SEQ_OP_ON_STOP, 12,
+    IBUS_SEQ_OP_JUMP_IF, IBUS_SEQ_VAR_IGNITION, IBUS_SEQ_CMP_EQ, 2, 14,  /* 2 */
+    SEQ_CODE(GOODBYE), SEQ_WAIT(30000),                                 /* 7 */
+    SEQ_CODE(LIGHTS_OFF),                                               /* 12 */
+    IBUS_SEQ_OP_END,                                                    /* 14 */
+};
+
+/* Close the windows one after another (400 ms apart, one motor at a time); not while moving. */
+const uint8_t kComfortClose[] = {
+    IBUS_SEQ_OP_JUMP_IF, IBUS_SEQ_VAR_SPEED, IBUS_SEQ_CMP_EQ, 0xFF, 10,  /* 0: no speed data */
+    IBUS_SEQ_OP_JUMP_IF, IBUS_SEQ_VAR_SPEED, IBUS_SEQ_CMP_GE, 5, 27,     /* 5 */
+    SEQ_CODE(WIN_FD_CLOSE), SEQ_WAIT(400),                              /* 10 */
+    SEQ_CODE(WIN_FP_CLOSE), SEQ_WAIT(400),                              /* 15 */
+    SEQ_CODE(WIN_RD_CLOSE), SEQ_WAIT(400),                              /* 20 */
+    SEQ_CODE(WIN_RP_CLOSE),                                             /* 25 */
+    IBUS_SEQ_OP_END,                                                    /* 27 */
+};
+
+uint16_t rd16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/** Bytes taken by the instruction at pc (0 = unknown opcode), ignoring whether they fit. */
+size_t opSize(const uint8_t *code, size_t len, size_t pc) {
+  switch (code[pc]) {
+    case IBUS_SEQ_OP_END:
+    case IBUS_SEQ_OP_LOOP:
+      return 1;
+    case IBUS_SEQ_OP_SEND_CODE:
+    case IBUS_SEQ_OP_REPEAT:
+    case IBUS_SEQ_OP_JUMP:
+    case IBUS_SEQ_OP_MARK:
+    case IBUS_SEQ_OP_ON_STOP:
+      return 2;
+    case IBUS_SEQ_OP_SEND:
+    case IBUS_SEQ_OP_LCM:
+      return pc + 1 < len ? 2u + code[pc + 1] : 2;
+    case IBUS_SEQ_OP_WAIT:
+      return 3;
+    case IBUS_SEQ_OP_JUMP_IF:
+      return 5;
+    default:
+      return 0;
+  }
+}
+
+}  // namespace
+
+const uint8_t *ibusSeqBuiltin(uint8_t id, size_t *len) {
+  const uint8_t *p = nullptr;
+  size_t n = 0;
+  switch (id) {
+    case IBUS_SEQ_LIGHT_SHOW: p = kLightShow; n = sizeof(kLightShow); break;
+    case IBUS_SEQ_WIG_WAG: p = kWigWag; n = sizeof(kWigWag); break;
+    case IBUS_SEQ_PANIC: p = kPanic; n = sizeof(kPanic); break;
+    case IBUS_SEQ_GOODBYE: p = kGoodbye; n = sizeof(kGoodbye); break;
+    case IBUS_SEQ_COMFORT_CLOSE: p = kComfortClose; n = sizeof(kComfortClose); break;
+    default: break;
+  }
+  if (len)
+    *len = n;
+  return p;
+}
+
+const uint8_t *ibusSeqCodeFrame(uint8_t code, uint8_t *len) {
+  if (code >= IBUS_SEQ_CODE_COUNT)
+    return nullptr;
+  if (len)
+    *len = kCodes[code].len;
+  return kCodes[code].data;
+}
+
+uint8_t ibusSeqValidate(const uint8_t *code, size_t len) {
+  if (!code || len == 0 || len > IBUS_SEQ_MAX_SCRIPT)
+    return IBUS_SEQ_ERR_LENGTH;
+  bool start[IBUS_SEQ_MAX_SCRIPT] = {};
+  bool wait[IBUS_SEQ_MAX_SCRIPT] = {};
+  /* Pass 1: instruction boundaries and operands. */
+  for (size_t pc = 0; pc < len;) {
+    const size_t n = opSize(code, len, pc);
+    if (n == 0)
+      return IBUS_SEQ_ERR_OPCODE;
+    if (pc + n > len)
+      return IBUS_SEQ_ERR_LENGTH;
+    start[pc] = true;
+    const uint8_t *a = code + pc + 1;
+    switch (code[pc]) {
+      case IBUS_SEQ_OP_SEND_CODE:
+        if (a[0] >= IBUS_SEQ_CODE_COUNT)
+          return IBUS_SEQ_ERR_OPERAND;
+        break;
+      case IBUS_SEQ_OP_SEND:
+        if (a[0] == 0 || a[0] > IBUS_SEQ_FRAME_MAX)
+          return IBUS_SEQ_ERR_OPERAND;
+        break;
+      case IBUS_SEQ_OP_LCM:
+        if (a[0] == 0 || a[0] + 3 > IBUS_SEQ_FRAME_MAX)
+          return IBUS_SEQ_ERR_OPERAND;
+        break;
+      case IBUS_SEQ_OP_WAIT:
+        if (rd16(a) == 0)
+          return IBUS_SEQ_ERR_OPERAND;
+        wait[pc] = true;
+        break;
+      case IBUS_SEQ_OP_JUMP_IF:
+        if (a[0] >= IBUS_SEQ_VAR_COUNT || a[1] > IBUS_SEQ_CMP_ANY)
+          return IBUS_SEQ_ERR_OPERAND;
+        break;
+      default:
+        break;
+    }
+    pc += n;
+  }
+  /* Pass 2: targets, loop structure, and no path back without a WAIT. */
+  size_t loopStart[IbusSeqEngine::kMaxDepth];
+  uint8_t loopCount[IbusSeqEngine::kMaxDepth];
+  uint8_t depth = 0;
+  for (size_t pc = 0; pc < len; pc += opSize(code, len, pc)) {
+    const uint8_t op = code[pc];
+    if (op == IBUS_SEQ_OP_JUMP || op == IBUS_SEQ_OP_JUMP_IF || op == IBUS_SEQ_OP_ON_STOP) {
+      const uint8_t target = code[pc + (op == IBUS_SEQ_OP_JUMP_IF ? 4 : 1)];
+      if (target >= len || !start[target])
+        return IBUS_SEQ_ERR_TARGET;
+      if (op != IBUS_SEQ_OP_ON_STOP && target <= pc) {
+        bool waits = false;
+        for (size_t i = target; i < pc && !waits; i++)
+          waits = wait[i];
+        if (!waits)
+          return IBUS_SEQ_ERR_NO_WAIT;
+      }
+    } else if (op == IBUS_SEQ_OP_REPEAT) {
+      if (depth >= IbusSeqEngine::kMaxDepth)
+        return IBUS_SEQ_ERR_NESTING;
+      loopStart[depth] = pc;
+      loopCount[depth] = code[pc + 1];
+      depth++;
+    } else if (op == IBUS_SEQ_OP_LOOP) {
+      if (depth == 0)
+        return IBUS_SEQ_ERR_NESTING;
+      depth--;
+      if (loopCount[depth] == 0) {
+        bool waits = false;
+        for (size_t i = loopStart[depth]; i < pc && !waits; i++)
+          waits = wait[i];
+        if (!waits)
+          return IBUS_SEQ_ERR_NO_WAIT;
+      }
+    }
+  }
+  return depth == 0 ? IBUS_SEQ_OK : IBUS_SEQ_ERR_NESTING;
+}
+
+uint8_t IbusSeqEngine::start(uint8_t id, const uint8_t *code, size_t len, uint32_t nowMs) {
+  const uint8_t err = ibusSeqValidate(code, len);
+  if (err != IBUS_SEQ_OK)
+    return err;
+  memcpy(code_, code, len);
+  len_ = len;
+  pc_ = 0;
+  id_ = id;
+  mark_ = 0;
+  onStop_ = -1;
+  depth_ = 0;
+  due_ = nowMs;
+  waited_ = false;
+  running_ = true;
+  return IBUS_SEQ_OK;
+}
+
+bool IbusSeqEngine::emit(const uint8_t *frame, uint8_t len, IbusSeqSendFn send, void *ctx) {
+  if (send && send(frame, len, ctx)) {
+    framesSent_++;
+    return true;
+  }
+  framesDropped_++;
+  return false;
+}
+
+/** SEND_CODE / SEND / LCM at pc. */
+bool IbusSeqEngine::sendAt(size_t pc, IbusSeqSendFn send, void *ctx) {
+  const uint8_t *a = code_ + pc + 1;
+  switch (code_[pc]) {
+    case IBUS_SEQ_OP_SEND_CODE: {
+      uint8_t n = 0;
+      const uint8_t *f = ibusSeqCodeFrame(a[0], &n);
+      return f && emit(f, n, send, ctx);
+    }
+    case IBUS_SEQ_OP_SEND:
+      return emit(a + 1, a[0], send, ctx);
+    case IBUS_SEQ_OP_LCM: {
+      uint8_t buf[IBUS_SEQ_FRAME_MAX];
+      buf[0] = IBUS_LCM;
+      buf[1] = (uint8_t)(a[0] + 1);
+      buf[2] = 0x00;
+      memcpy(buf + 3, a + 1, a[0]);
+      return emit(buf, (uint8_t)(a[0] + 3), send, ctx);
+    }
+    default:
+      return false;
+  }
+}
+
+void IbusSeqEngine::stop(IbusSeqSendFn send, void *ctx) {
+  if (!running_)
+    return;
+  running_ = false;
+  if (onStop_ < 0)
+    return;
+  /* Cleanup block: frames and marks only, up to the first END/WAIT/jump. */
+  for (size_t pc = (size_t)onStop_; pc < len_; pc += opSize(code_, len_, pc)) {
+    const uint8_t op = code_[pc];
+    if (op == IBUS_SEQ_OP_SEND_CODE || op == IBUS_SEQ_OP_SEND || op == IBUS_SEQ_OP_LCM)
+      sendAt(pc, send, ctx);
+    else if (op != IBUS_SEQ_OP_MARK)
+      break;
+  }
+}
+
+bool IbusSeqEngine::step(uint32_t nowMs, IbusSeqSendFn send, IbusSeqQueryFn query, void *ctx) {
+  uint16_t ops = 0;
+  while (running_) {
+    if ((int32_t)(nowMs - due_) < 0)
+      return true;
+    if (waited_) {
+      waited_ = false;
+      const uint32_t late = nowMs - due_;
+      steps_++;
+      lateTotalMs_ += late;
+      if (late > lateMaxMs_)
+        lateMaxMs_ = late;
+      if (late > kMaxLateMs) {
+        /* Too late to catch up without a burst: the rest of the sequence shifts once. */
+        due_ = nowMs;
+        reanchors_++;
+      }
+    }
+    if (ops++ >= kMaxOpsPerStep)
+      return true;
+    if (pc_ >= len_) {
+      running_ = false;
+      break;
+    }
+    const uint8_t *a = code_ + pc_ + 1;
+    switch (code_[pc_]) {
+      case IBUS_SEQ_OP_END:
+        running_ = false;
+        break;
+      case IBUS_SEQ_OP_SEND_CODE:
+      case IBUS_SEQ_OP_SEND:
+      case IBUS_SEQ_OP_LCM:
+        sendAt(pc_, send, ctx);
+        break;
+      case IBUS_SEQ_OP_WAIT:
+        due_ += rd16(a);
+        waited_ = true;
+        break;
+      case IBUS_SEQ_OP_REPEAT:
+        if (depth_ >= kMaxDepth) {
+          running_ = false;  /* jumped back over a REPEAT without its LOOP */
+          break;
+        }
+        loops_[depth_].start = (uint16_t)(pc_ + 2);
+        loops_[depth_].left = a[0];
+        depth_++;
+        break;
+      case IBUS_SEQ_OP_LOOP:
+        if (depth_ > 0) {
+          Loop &l = loops_[depth_ - 1];
+          if (l.left == 0 || --l.left > 0) {
+            pc_ = l.start;
+            continue;
+          }
+          depth_--;
+        }
+        break;
+      case IBUS_SEQ_OP_JUMP:
+        pc_ = a[0];
+        continue;
+      case IBUS_SEQ_OP_JUMP_IF: {
+        const uint8_t v = query ? query(a[0], ctx) : 0xFF;
+        bool hit = false;
+        switch (a[1]) {
+          case IBUS_SEQ_CMP_EQ: hit = v == a[2]; break;
+          case IBUS_SEQ_CMP_NE: hit = v != a[2]; break;
+          case IBUS_SEQ_CMP_LT: hit = v < a[2]; break;
+          case IBUS_SEQ_CMP_GE: hit = v >= a[2]; break;
+          case IBUS_SEQ_CMP_ANY: hit = (v & a[2]) != 0; break;
+          default: break;
+        }
+        if (hit) {
+          pc_ = a[3];
+          continue;
+        }
+        break;
+      }
+      case IBUS_SEQ_OP_MARK:
+        mark_ = a[0];
+        break;
+      case IBUS_SEQ_OP_ON_STOP:
+        onStop_ = a[0];
+        break;
+      default:
+        running_ = false;
+        break;
+    }
+    if (running_)
+      pc_ += opSize(code_, len_, pc_);
+  }
+  return false;
+}
+
+void IbusSeqEngine::resetStats() {
+  framesSent_ = framesDropped_ = 0;
+  steps_ = lateMaxMs_ = lateTotalMs_ = reanchors_ = 0;
+}
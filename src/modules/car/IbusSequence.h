@@ -0,0 +1,153 @@
+/*
+ * NOCTURNE_OS — timed I-Bus action sequences: bytecode scripts, validator, engine. Every WAIT runs from
+ * the previous deadline, so a late step does not shift the rest. Script format: docs/bmw/BMW_ANDROID_APP.md.
+ */
+#ifndef NOCTURNE_IBUS_SEQUENCE_H
+#define NOCTURNE_IBUS_SEQUENCE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define IBUS_SEQ_MAX_SCRIPT 255
+/** Longest frame a script may send (before checksum). */
+#define IBUS_SEQ_FRAME_MAX 36
+
+#define IBUS_SEQ_OP_END 0x00        /* stop; the ON_STOP block is not run */
+#define IBUS_SEQ_OP_SEND_CODE 0x01  /* [code] IBUS_SEQ_CODE_* */
+#define IBUS_SEQ_OP_SEND 0x02       /* [len][bytes...], checksum added by the driver */
+#define IBUS_SEQ_OP_LCM 0x03        /* [len][payload...] -> D0 [len+1] 00 [payload] */
+#define IBUS_SEQ_OP_WAIT 0x04       /* [ms u16 LE] after the previous deadline */
+#define IBUS_SEQ_OP_REPEAT 0x05     /* [count] body up to the matching LOOP, 0 = forever */
+#define IBUS_SEQ_OP_LOOP 0x06
+#define IBUS_SEQ_OP_JUMP 0x07       /* [target] absolute offset of an instruction */
+#define IBUS_SEQ_OP_JUMP_IF 0x08    /* [var][cmp][value][target] */
+#define IBUS_SEQ_OP_MARK 0x09       /* [n] step label for the UI */
+#define IBUS_SEQ_OP_ON_STOP 0x0A    /* [target] frames sent when stopped from outside */
+
+/** Frames for SEND_CODE (IbusCodes.h). */
+#define IBUS_SEQ_CODE_HAZARD 0
+#define IBUS_SEQ_CODE_PARK 1
+#define IBUS_SEQ_CODE_GOODBYE 2
+#define IBUS_SEQ_CODE_LOW_BEAM 3
+#define IBUS_SEQ_CODE_LIGHTS_OFF 4
+#define IBUS_SEQ_CODE_FOLLOW_ME 5
+#define IBUS_SEQ_CODE_LOCK 6
+#define IBUS_SEQ_CODE_UNLOCK 7
+#define IBUS_SEQ_CODE_WIN_FD_CLOSE 8
+#define IBUS_SEQ_CODE_WIN_FP_CLOSE 9
+#define IBUS_SEQ_CODE_WIN_RD_CLOSE 10
+#define IBUS_SEQ_CODE_WIN_RP_CLOSE 11
+#define IBUS_SEQ_CODE_WIN_FD_OPEN 12
+#define IBUS_SEQ_CODE_WIN_FP_OPEN 13
+#define IBUS_SEQ_CODE_WIN_RD_OPEN 14
+#define IBUS_SEQ_CODE_WIN_RP_OPEN 15
+#define IBUS_SEQ_CODE_INTERIOR_ON3S 16
+#define IBUS_SEQ_CODE_INTERIOR_OFF 17
+#define IBUS_SEQ_CODE_CLOWN_FLASH 18
+#define IBUS_SEQ_CODE_COUNT 19
+
+/** State a JUMP_IF can test (published by BmwManager). 0xFF = no data. */
+#define IBUS_SEQ_VAR_IGNITION 0   /* 0 off, 1 pos1, 2 run */
+#define IBUS_SEQ_VAR_LOCK 1       /* 0 unlocked, 1 locked, 2 double */
+#define IBUS_SEQ_VAR_DOORS 2      /* GM 0x7a byte1 */
+#define IBUS_SEQ_VAR_WINDOWS 3    /* GM 0x7a byte2 */
+#define IBUS_SEQ_VAR_SPEED 4      /* km/h, capped at 254 */
+#define IBUS_SEQ_VAR_PHONE 5      /* 1 = a phone is connected */
+#define IBUS_SEQ_VAR_COUNT 6
+
+#define IBUS_SEQ_CMP_EQ 0
+#define IBUS_SEQ_CMP_NE 1
+#define IBUS_SEQ_CMP_LT 2
+#define IBUS_SEQ_CMP_GE 3
+#define IBUS_SEQ_CMP_ANY 4        /* state & value != 0 */
+
+/** Built-in sequences (flash); ids from IBUS_SEQ_FILE_FIRST are scripts on LittleFS (IbusSeqRunner.h). */
+#define IBUS_SEQ_LIGHT_SHOW 1
+#define IBUS_SEQ_WIG_WAG 2
+#define IBUS_SEQ_PANIC 3
+#define IBUS_SEQ_GOODBYE 4
+#define IBUS_SEQ_COMFORT_CLOSE 5
+#define IBUS_SEQ_FILE_FIRST 0x10
+
+#define IBUS_SEQ_OK 0
+#define IBUS_SEQ_ERR_LENGTH 1     /* empty, too long or an operand runs past the end */
+#define IBUS_SEQ_ERR_OPCODE 2
+#define IBUS_SEQ_ERR_OPERAND 3    /* bad code, var, cmp, frame length or WAIT 0 */
+#define IBUS_SEQ_ERR_TARGET 4     /* jump into the middle of an instruction or past the end */
+#define IBUS_SEQ_ERR_NESTING 5    /* REPEAT/LOOP unbalanced or deeper than kMaxDepth */
+#define IBUS_SEQ_ERR_NO_WAIT 6    /* a backward jump or forever-loop without a WAIT in it would spin */
+#define IBUS_SEQ_ERR_NOT_FOUND 7  /* no built-in or file with that id (IbusSeqRunner) */
+#define IBUS_SEQ_ERR_BUSY 8       /* runner queue full */
+
+/** Frame out. false = not queued (counted as dropped, the sequence goes on). */
+typedef bool (*IbusSeqSendFn)(const uint8_t *frame, uint8_t len, void *ctx);
+/** Current value of IBUS_SEQ_VAR_*. */
+typedef uint8_t (*IbusSeqQueryFn)(uint8_t var, void *ctx);
+
+/** Check a script before it runs; IBUS_SEQ_OK or IBUS_SEQ_ERR_*. */
+uint8_t ibusSeqValidate(const uint8_t *code, size_t len);
+/** Built-in script for an id below IBUS_SEQ_FILE_FIRST; nullptr if none. */
+const uint8_t *ibusSeqBuiltin(uint8_t id, size_t *len);
+/** Frame for SEND_CODE; nullptr if out of range. */
+const uint8_t *ibusSeqCodeFrame(uint8_t code, uint8_t *len);
+
+class IbusSeqEngine {
+ public:
+  static const uint8_t kMaxDepth = 4;
+  /** Later than this (loop stalled, bus busy) the schedule is re-anchored, missed steps are not burst. */
+  static const uint32_t kMaxLateMs = 100;
+  /** Instructions per step() before it yields (the rest runs on the next call). */
+  static const uint16_t kMaxOpsPerStep = 128;
+
+  /** Validate and copy the script; the first step is due at nowMs. Replaces a running sequence
+   *  without its ON_STOP block (stop() first for that). */
+  uint8_t start(uint8_t id, const uint8_t *code, size_t len, uint32_t nowMs);
+  /** Stop from outside: sends the ON_STOP block if the script set one. */
+  void stop(IbusSeqSendFn send, void *ctx);
+  /** Run every instruction due at nowMs. false once the sequence is over (or none runs). */
+  bool step(uint32_t nowMs, IbusSeqSendFn send, IbusSeqQueryFn query, void *ctx);
+
+  bool running() const { return running_; }
+  uint8_t id() const { return running_ ? id_ : 0; }
+  uint8_t mark() const { return mark_; }
+  /** When step() has something to do next (valid while running). */
+  uint32_t dueMs() const { return due_; }
+
+  uint32_t framesSent() const { return framesSent_; }
+  uint32_t framesDropped() const { return framesDropped_; }
+  /** Steps that ran after a WAIT, and how late they were against the schedule. */
+  uint32_t steps() const { return steps_; }
+  uint32_t lateMaxMs() const { return lateMaxMs_; }
+  uint32_t lateTotalMs() const { return lateTotalMs_; }
+  uint32_t reanchors() const { return reanchors_; }
+  void resetStats();
+
+ private:
+  bool emit(const uint8_t *frame, uint8_t len, IbusSeqSendFn send, void *ctx);
+  bool sendAt(size_t pc, IbusSeqSendFn send, void *ctx);
+
+  uint8_t code_[IBUS_SEQ_MAX_SCRIPT] = {};
+  size_t len_ = 0;
+  size_t pc_ = 0;
+  bool running_ = false;
+  uint8_t id_ = 0;
+  uint8_t mark_ = 0;
+  int onStop_ = -1;
+  uint32_t due_ = 0;
+  bool waited_ = false;  /* pc_ is right after a WAIT: the next step() is a timed step */
+  struct Loop {
+    uint16_t start;
+    uint8_t left;      /* 0 = forever */
+  };
+  Loop loops_[kMaxDepth] = {};
+  uint8_t depth_ = 0;
+
+  uint32_t framesSent_ = 0;
+  uint32_t framesDropped_ = 0;
+  uint32_t steps_ = 0;
+  uint32_t lateMaxMs_ = 0;
+  uint32_t lateTotalMs_ = 0;
+  uint32_t reanchors_ = 0;
+};
+
+#endif
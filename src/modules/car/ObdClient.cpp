@@ -1,5 +1,5 @@
 /*
- * NOCTURNE_OS — OBD-II / ELM327 client (stub implementation).
+ * NOCTURNE_OS — OBD-II / ELM327 client: transport side of ObdSession.
  */
 #include "ObdClient.h"
 #include "nocturne/config.h"
@@ -9,191 +9,124 @@
 
 #if NOCT_OBD_ENABLED
 
-static HardwareSerial *s_obdSerial = nullptr;
-
-static HardwareSerial &getObdSerial() {
-  if (!s_obdSerial)
-    s_obdSerial = &Serial2;
-  return *s_obdSerial;
-}
+static ObdSerialTransport s_serial(Serial2);
+static const uint8_t kPolledPids[ObdClient::kPolledPidCount] = {OBD_PID_RPM, OBD_PID_SPEED, OBD_PID_COOLANT,
+                                                                 OBD_PID_OIL};
 
 void ObdClient::begin(int txPin, int rxPin, uint32_t baud) {
-  if (begun_)
-    return;
-  txPin_ = txPin;
-  rxPin_ = rxPin;
-  if (txPin_ < 0 || rxPin_ < 0)
+  if (begun_ || txPin < 0 || rxPin < 0)
     return;
-  HardwareSerial &ser = getObdSerial();
-  ser.begin(baud, SERIAL_8N1, rxPin, txPin);
-  begun_ = true;
-  enabled_ = true;
-  state_ = OBD_INIT;
-  stateStartMs_ = millis();
+  s_serial.begin(txPin, rxPin, baud);
+  start(s_serial);
 }
 
-void ObdClient::sendCommand(const char *cmd) {
-  if (!begun_ || !cmd)
+void ObdClient::beginTcp(const char *ip, uint16_t port) {
+  if (begun_ || !tcp_.setServer(ip, port))
     return;
-  getObdSerial().println(cmd);
-}
-
-bool ObdClient::readLine(char *buf, size_t maxLen, unsigned long timeoutMs) {
-  if (!buf || maxLen == 0)
-    return false;
-  buf[0] = '\0';
-  unsigned long start = millis();
-  size_t i = 0;
-  HardwareSerial &ser = getObdSerial();
-  while (millis() - start < timeoutMs && i < maxLen - 1) {
-    if (ser.available()) {
-      int c = ser.read();
-      if (c == '\r' || c == '\n') {
-        if (i > 0)
-          break;
-        continue;
-      }
-      if (c >= ' ' && c <= '~')
-        buf[i++] = (char)c;
-    }
-  }
-  buf[i] = '\0';
-  return i > 0;
+  start(tcp_);
 }
 
-/* OBD-II: 41 0C A B -> RPM = ((A*256)+B)/4. ELM327 response e.g. "41 0C 12 34". */
-int ObdClient::parseRpm(const char *line) {
-  const char *p = strstr(line, "41 0C");
-  if (p)
-    p += 6;  /* skip "41 0C " */
-  else {
-    p = strstr(line, "410C");
-    if (p)
-      p += 4;  /* skip "410C" (no space) */
-    else
-      return -1;
-  }
-  unsigned int a = 0, b = 0;
-  if (sscanf(p, "%x %x", &a, &b) >= 2)
-    return (int)((a * 256u + b) / 4);
-  return -1;
-}
-
-/* 41 05 xx -> coolant = xx - 40. Response e.g. "41 05 A3". */
-int ObdClient::parseCoolantTemp(const char *line) {
-  const char *p = strstr(line, "41 05");
-  if (p)
-    p += 6;
-  else {
-    p = strstr(line, "4105");
-    if (p)
-      p += 4;
-    else
-      return -1;
-  }
-  unsigned int x = 0;
-  if (sscanf(p, "%x", &x) >= 1)
-    return (int)x - 40;
-  return -1;
-}
-
-/* 41 5C xx -> oil = xx - 40. Response e.g. "41 5C 8F". */
-int ObdClient::parseOilTemp(const char *line) {
-  const char *p = strstr(line, "41 5C");
-  if (p)
-    p += 6;
-  else {
-    p = strstr(line, "415C");
-    if (p)
-      p += 4;
-    else
-      return -1;
-  }
-  unsigned int x = 0;
-  if (sscanf(p, "%x", &x) >= 1)
-    return (int)x - 40;
-  return -1;
+void ObdClient::start(ObdTransport &transport) {
+  transport_ = &transport;
+  session_.addPid(OBD_PID_RPM, 0);
+  session_.addPid(OBD_PID_SPEED, 200);
+  session_.addPid(OBD_PID_COOLANT, 2000);
+  session_.addPid(OBD_PID_OIL, 2000);
+  begun_ = true;
+  enabled_ = true;
+  lastTickMs_ = statsMs_ = millis();
+  session_.reset(lastTickMs_);
 }
 
 void ObdClient::tick() {
   if (!enabled_ || !begun_)
     return;
-  unsigned long now = millis();
+  const uint32_t t0 = micros();
+  const unsigned long now = millis();
+  const uint32_t gap = (uint32_t)(now - lastTickMs_);
+  if (gap > gapMaxMs_)
+    gapMaxMs_ = gap;
+  lastTickMs_ = now;
 
-  switch (state_) {
-    case OBD_IDLE:
-      if (now - stateStartMs_ >= kPollIntervalMs) {
-        state_ = OBD_REQ_RPM;
-        stateStartMs_ = now;
-      }
-      break;
-    case OBD_INIT:
-      if (now - stateStartMs_ >= 500) {
-        sendCommand("ATZ");
-        state_ = OBD_REQ_RPM;
-        stateStartMs_ = now;
-      }
-      break;
-    case OBD_REQ_RPM:
-      sendCommand("01 0C");
-      state_ = OBD_WAIT_RPM;
-      stateStartMs_ = now;
-      break;
-    case OBD_WAIT_RPM: {
-      char line[64];
-      if (readLine(line, sizeof(line), 200)) {
-        int r = parseRpm(line);
-        if (r >= 0)
-          lastRpm_ = r;
-      }
-      if (now - stateStartMs_ >= kCmdTimeoutMs) {
-        state_ = OBD_REQ_COOLANT;
-        stateStartMs_ = now;
-      } else if (lastRpm_ >= 0 || now - stateStartMs_ > 300) {
-        state_ = OBD_REQ_COOLANT;
-        stateStartMs_ = now;
-      }
-      break;
+  /* A new link may be a new (or power-cycled) adapter; a lost one leaves nothing to talk to. Either
+   * way the session starts over from ATZ, and connected() reads false until the ECU answers. */
+  transport_->poll((uint32_t)now);
+  if (transport_->takeConnected()) {
+    session_.reset(now);
+    linkUp_ = true;
+  } else if (linkUp_ && !transport_->ready()) {
+    session_.reset(now);
+    linkUp_ = false;
+    linkDrops_++;
+  }
+
+  if (linkUp_) {
+    char buf[64];
+    size_t budget = kReadChunk;
+    while (budget > 0) {
+      const size_t n = transport_->read(buf, budget < sizeof(buf) ? budget : sizeof(buf));
+      if (n == 0)
+        break;
+      session_.feed(buf, n, now);
+      budget -= n;
     }
-    case OBD_REQ_COOLANT:
-      sendCommand("01 05");
-      state_ = OBD_WAIT_COOLANT;
-      stateStartMs_ = now;
-      break;
-    case OBD_WAIT_COOLANT: {
-      char line[64];
-      if (readLine(line, sizeof(line), 200)) {
-        int c = parseCoolantTemp(line);
-        if (c >= -40 && c <= 215)
-          lastCoolantC_ = c;
-      }
-      if (now - stateStartMs_ >= kCmdTimeoutMs || now - stateStartMs_ > 300) {
-        state_ = OBD_REQ_OIL;
-        stateStartMs_ = now;
-      }
-      break;
+    /* Read, then the next command in the same tick: it leaves right after the prompt that allowed it. */
+    char cmd[24];
+    const size_t len = session_.poll(now, cmd, sizeof(cmd));
+    if (len > 0)
+      transport_->write(cmd, len);
+  }
+
+  const bool connected = session_.connected();
+  if (session_.takeUpdate() || connected != wasConnected_) {
+    int32_t v;
+    uint32_t rpmAt = 0;
+    if (session_.value(OBD_PID_RPM, &v, &rpmAt))
+      lastRpm_ = (int)v;
+    if (session_.value(OBD_PID_COOLANT, &v))
+      lastCoolantC_ = (int)v;
+    if (session_.value(OBD_PID_OIL, &v))
+      lastOilC_ = (int)v;
+    if (session_.value(OBD_PID_SPEED, &v))
+      lastSpeed_ = (int)v;
+    if (rpmAt != 0 && rpmAt != lastRpmAtMs_) {
+      lastRpmAtMs_ = rpmAt;
+      if (rpmCb_)
+        rpmCb_(lastRpm_, lastSpeed_, rpmAt - session_.rttLastMs() / 2);
     }
-    case OBD_REQ_OIL:
-      sendCommand("01 5C");
-      state_ = OBD_WAIT_OIL;
-      stateStartMs_ = now;
-      break;
-    case OBD_WAIT_OIL: {
-      char line[64];
-      if (readLine(line, sizeof(line), 200)) {
-        int o = parseOilTemp(line);
-        if (o >= -40 && o <= 210)
-          lastOilC_ = o;
-      }
-      if (now - stateStartMs_ >= kCmdTimeoutMs || now - stateStartMs_ > 300) {
-        if (dataCb_)
-          dataCb_(true, lastRpm_, lastCoolantC_, lastOilC_);
-        state_ = OBD_IDLE;
-        stateStartMs_ = now;
+    for (size_t i = 0; sampleCb_ && i < kPolledPidCount; i++) {
+      uint32_t at = 0;
+      if (session_.value(kPolledPids[i], &v, &at) && at != lastAtMs_[i]) {
+        lastAtMs_[i] = at;
+        sampleCb_(kPolledPids[i], v, at - session_.rttLastMs() / 2);
       }
-      break;
     }
+    wasConnected_ = connected;
+    if (dataCb_)
+      dataCb_(connected, lastRpm_, lastCoolantC_, lastOilC_);
   }
+
+  logStats(now);
+  const uint32_t us = micros() - t0;
+  if (us > tickMaxUs_)
+    tickMaxUs_ = us;
+}
+
+void ObdClient::logStats(unsigned long now) {
+  if (now - statsMs_ < kStatsIntervalMs)
+    return;
+  statsMs_ = now;
+#if NOCT_BMW_DEBUG
+  Serial.printf("[OBD] %s %s %s (link drops %u): rpm %.1f/s speed %.1f/s coolant %.2f/s oil %.2f/s, rtt %u/%u ms, "
+                "req %u, timeouts %u, resets %u, tick max %u us, loop gap max %u ms\n",
+                transport_->name(), session_.connected() ? "up" : "down", session_.canBus() ? "CAN" : "K-line",
+                (unsigned)linkDrops_,
+                (double)session_.rate(OBD_PID_RPM), (double)session_.rate(OBD_PID_SPEED),
+                (double)session_.rate(OBD_PID_COOLANT), (double)session_.rate(OBD_PID_OIL),
+                (unsigned)session_.rttAvgMs(), (unsigned)session_.rttMaxMs(), (unsigned)session_.requests(),
+                (unsigned)session_.timeouts(), (unsigned)session_.resets(), (unsigned)tickMaxUs_,
+                (unsigned)gapMaxMs_);
+#endif
 }
 
 #else  /* !NOCT_OBD_ENABLED */
@@ -204,6 +137,15 @@ void ObdClient::begin(int txPin, int rxPin, uint32_t baud) {
   (void)baud;
 }
 
+void ObdClient::beginTcp(const char *ip, uint16_t port) {
+  (void)ip;
+  (void)port;
+}
+
+void ObdClient::start(ObdTransport &transport) { (void)transport; }
+
 void ObdClient::tick() {}
 
+void ObdClient::logStats(unsigned long now) { (void)now; }
+
 #endif
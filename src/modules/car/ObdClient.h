@@ -1,13 +1,20 @@
 /*
- * NOCTURNE_OS — OBD-II / ELM327 client stub.
- * When NOCT_OBD_ENABLED, periodically requests RPM (01 0C), coolant (01 05), oil (01 5C)
- * and invokes callback with (connected, rpm, coolantC, oilC) for BmwManager::setObdData.
+ * NOCTURNE_OS — OBD-II / ELM327 client.
+ * When NOCT_OBD_ENABLED, drives an ObdSession over an ObdTransport — Serial2 (begin) or a Wi-Fi adapter
+ * over TCP (beginTcp): tick() moves whatever bytes the link has and sends the next request, it never
+ * waits for the adapter or for a connect. RPM is polled as fast as the bus answers,
+ * speed every 200 ms, coolant and oil every 2 s (several PIDs per request on CAN). The callback gets
+ * (connected, rpm, coolantC, oilC) for BmwManager::setObdData after every reply that decoded something;
+ * each new RPM value also goes to the sample callback with the time the ECU measured it, for the shift light.
  */
 #ifndef NOCTURNE_OBD_CLIENT_H
 #define NOCTURNE_OBD_CLIENT_H
 
 #include <Arduino.h>
 #include <cstdint>
+#include "ObdSerialTransport.h"
+#include "ObdSession.h"
+#include "ObdTcpTransport.h"
 
 class ObdClient {
  public:
@@ -15,46 +22,69 @@ class ObdClient {
 
   /** Start UART to ELM327 (e.g. Serial2 on txPin/rxPin). No-op if begin already called. */
   void begin(int txPin, int rxPin, uint32_t baud = 38400);
+  /** Wi-Fi ELM327 instead of the UART (IPv4 address, port 35000 on most adapters). Connects in tick(),
+   *  retrying with backoff while the adapter is not reachable. No-op if begin already called. */
+  void beginTcp(const char *ip, uint16_t port);
+  /** Wi-Fi station state for the TCP link (no connect attempts while down). */
+  void setNetworkUp(bool up) { tcp_.setNetworkUp(up); }
 
   void tick();
 
-  /** Callback: (connected, rpm, coolantC, oilC). Invoked when data received or on timeout (connected=false). */
+  /** Callback: (connected, rpm, coolantC, oilC). Invoked when data received or when the ECU goes silent
+   *  (connected=false). Values not received yet are -1 (rpm 0). */
   void setDataCallback(void (*cb)(bool connected, int rpm, int coolantC, int oilC)) { dataCb_ = cb; }
 
+  /** Callback: (rpm, speedKmh, sampleMs) for every new RPM value. sampleMs = reply time minus half the
+   *  last round trip, i.e. about when the ECU sampled it. speedKmh -1 if not received. */
+  void setRpmSampleCallback(void (*cb)(int rpm, int speedKmh, uint32_t sampleMs)) { rpmCb_ = cb; }
+  /** Callback: (pid, value, sampleMs) for every new value of a polled PID, same sampleMs estimate. */
+  void setSampleCallback(void (*cb)(uint8_t pid, int32_t value, uint32_t sampleMs)) { sampleCb_ = cb; }
+
+  static const size_t kPolledPidCount = 4;
+
   bool isEnabled() const { return enabled_; }
+  /** km/h, -1 if not received. */
+  int speedKmh() const { return lastSpeed_; }
+  const ObdSession &session() const { return session_; }
+  const ObdTransport *transport() const { return transport_; }
+  const ObdTcpTransport &tcp() const { return tcp_; }
+  /** Times the link (TCP connection) was lost after it was up. */
+  uint32_t linkDrops() const { return linkDrops_; }
+  /** Longest single tick() and longest gap between two ticks (loop stall seen by OBD), since begin. */
+  uint32_t tickMaxUs() const { return tickMaxUs_; }
+  uint32_t gapMaxMs() const { return gapMaxMs_; }
 
  private:
-  void sendCommand(const char *cmd);
-  bool readLine(char *buf, size_t maxLen, unsigned long timeoutMs);
-  int parseRpm(const char *line);
-  int parseCoolantTemp(const char *line);
-  int parseOilTemp(const char *line);
+  /** Link bytes handled per tick: ~70 ms of 38400 baud, more than one reply. */
+  static const size_t kReadChunk = 256;
+  static const unsigned long kStatsIntervalMs = 10000;
+
+  void start(ObdTransport &transport);
+  void logStats(unsigned long now);
 
+  ObdSession session_;
+  ObdTcpTransport tcp_;
+  ObdTransport *transport_ = nullptr;
   bool enabled_ = false;
   bool begun_ = false;
-  int txPin_ = -1;
-  int rxPin_ = -1;
+  bool linkUp_ = false;
+  bool wasConnected_ = false;
+  uint32_t linkDrops_ = 0;
   void (*dataCb_)(bool, int, int, int) = nullptr;
-
-  enum State {
-    OBD_IDLE,
-    OBD_INIT,
-    OBD_REQ_RPM,
-    OBD_WAIT_RPM,
-    OBD_REQ_COOLANT,
-    OBD_WAIT_COOLANT,
-    OBD_REQ_OIL,
-    OBD_WAIT_OIL,
-  };
-  State state_ = OBD_IDLE;
-  unsigned long stateStartMs_ = 0;
-  static const unsigned long kCmdTimeoutMs = 1500;
-  static const unsigned long kPollIntervalMs = 500;
+  void (*rpmCb_)(int, int, uint32_t) = nullptr;
+  void (*sampleCb_)(uint8_t, int32_t, uint32_t) = nullptr;
 
   int lastRpm_ = 0;
   int lastCoolantC_ = -1;
   int lastOilC_ = -1;
-  uint8_t uartNum_ = 2;  // Serial2
+  int lastSpeed_ = -1;
+  uint32_t lastRpmAtMs_ = 0;
+  uint32_t lastAtMs_[kPolledPidCount] = {};
+
+  unsigned long lastTickMs_ = 0;
+  uint32_t tickMaxUs_ = 0;
+  uint32_t gapMaxMs_ = 0;
+  unsigned long statsMs_ = 0;
 };
 
 #endif
@@ -0,0 +1,208 @@
+/*
+ * NOCTURNE_OS — OBD-II mode 01: value scaling, hex tokenizer, ISO-TP reassembly, reply decoder.
+ */
+#include "ObdPid.h"
+#include <cstring>
+
+int32_t obdPidValue(const ObdPidDef &def, const uint8_t *d) {
+  if (def.bytes == 4)
+    return (int32_t)((uint32_t)d[0] << 24 | (uint32_t)d[1] << 16 | (uint32_t)d[2] << 8 | d[3]);
+  const int32_t raw = def.bytes == 2 ? (int32_t)(d[0] << 8 | d[1]) : (int32_t)d[0];
+  return raw * def.mul / def.div + def.add;
+}
+
+const char *obdUnitName(uint8_t unit) {
+  switch (unit) {
+    case OBD_UNIT_BITMAP: return "bitmap";
+    case OBD_UNIT_RPM: return "rpm";
+    case OBD_UNIT_KMH: return "km/h";
+    case OBD_UNIT_DEGC: return "C";
+    case OBD_UNIT_PCT: return "%";
+    case OBD_UNIT_KPA: return "kPa";
+    case OBD_UNIT_GS100: return "0.01 g/s";
+    case OBD_UNIT_MV: return "mV";
+    case OBD_UNIT_S: return "s";
+    case OBD_UNIT_DEG2: return "0.5 deg";
+    case OBD_UNIT_KM: return "km";
+    default: return "";
+  }
+}
+
+int obdParseHex(const char *s, size_t len, uint8_t *out, size_t cap) {
+  size_t n = 0;
+  int hi = -1;
+  for (size_t i = 0; i < len; i++) {
+    if (s[i] == ' ')
+      continue;
+    const int d = obdHexDigit(s[i]);
+    if (d < 0)
+      return -1;
+    if (hi < 0) {
+      hi = d;
+    } else {
+      if (n >= cap)
+        return -1;
+      out[n++] = (uint8_t)(hi << 4 | d);
+      hi = -1;
+    }
+  }
+  return hi < 0 ? (int)n : -1;
+}
+
+size_t obdDecode01(const uint8_t *msg, size_t len, ObdValue *out, size_t cap) {
+  if (len < 2 || msg[0] != 0x41)
+    return 0;
+  size_t n = 0;
+  for (size_t i = 1; i < len && n < cap;) {
+    const ObdPidDef *def = obdPidFind(msg[i]);
+    if (!def || i + 1 + def->bytes > len)
+      break;
+    out[n].pid = def->pid;
+    out[n].unit = def->unit;
+    out[n].value = obdPidValue(*def, msg + i + 1);
+    n++;
+    i += 1u + def->bytes;
+  }
+  return n;
+}
+
+/* ── ISO-TP ─────────────────────────────────────────────────────────────── */
+
+void ObdIsoTp::reset() {
+  size_ = 0;
+  expect_ = 0;
+  nextSeq_ = 0;
+  ecu_ = 0;
+}
+
+uint8_t ObdIsoTp::fail() {
+  errors_++;
+  size_ = 0;
+  expect_ = 0;
+  return OBD_ISOTP_ERROR;
+}
+
+uint8_t ObdIsoTp::line(const char *s, size_t len) {
+  uint8_t b[kMax];
+  if (headers_) {
+    /* 11-bit id: three digits before the frame bytes. */
+    size_t p = 0;
+    uint16_t id = 0;
+    int digits = 0;
+    for (; p < len && digits < 3; p++) {
+      if (s[p] == ' ')
+        continue;
+      const int d = obdHexDigit(s[p]);
+      if (d < 0)
+        return OBD_ISOTP_NONE;
+      id = (uint16_t)(id << 4 | d);
+      digits++;
+    }
+    const int n = obdParseHex(s + p, len - p, b, sizeof(b));
+    if (digits < 3 || n < 1)
+      return OBD_ISOTP_NONE;
+    if (expect_ > 0 && id != ecu_)
+      return OBD_ISOTP_NONE;
+    ecu_ = id;
+    return frameCan(b, n);
+  }
+  int index = -1;
+  size_t p = 0;
+  while (p < len && s[p] == ' ')
+    p++;
+  if (p + 1 < len && s[p + 1] == ':' && obdHexDigit(s[p]) >= 0) {
+    index = obdHexDigit(s[p]);
+    p += 2;
+  } else {
+    /* "00A": three digits, the byte count of the multi-frame message that follows. */
+    size_t digits = 0;
+    uint16_t v = 0;
+    for (size_t i = p; i < len && obdHexDigit(s[i]) >= 0; i++, digits++)
+      v = (uint16_t)(v << 4 | obdHexDigit(s[i]));
+    if (digits == 3 && p + 3 == len) {
+      if (expect_ > 0)
+        errors_++;  /* previous message never completed */
+      if (v == 0 || v > kMax)
+        return fail();
+      size_ = 0;
+      expect_ = v;
+      nextSeq_ = 0;
+      return OBD_ISOTP_MORE;
+    }
+  }
+  const int n = obdParseHex(s + p, len - p, b, sizeof(b));
+  if (n < 1)
+    return OBD_ISOTP_NONE;
+  return frameHeadersOff(b, n, index);
+}
+
+uint8_t ObdIsoTp::frameHeadersOff(const uint8_t *b, int n, int index) {
+  if (index < 0) {
+    if (expect_ > 0)
+      errors_++;
+    expect_ = 0;
+    memcpy(buf_, b, (size_t)n);
+    size_ = (size_t)n;
+    return OBD_ISOTP_DONE;
+  }
+  if (expect_ == 0)
+    return OBD_ISOTP_NONE;
+  if (index != nextSeq_)
+    return fail();
+  nextSeq_ = (uint8_t)((nextSeq_ + 1) & 0x0F);
+  size_t k = (size_t)n;
+  if (k > expect_ - size_)
+    k = expect_ - size_;  /* padding in the last frame */
+  memcpy(buf_ + size_, b, k);
+  size_ += k;
+  if (size_ < expect_)
+    return OBD_ISOTP_MORE;
+  expect_ = 0;
+  return OBD_ISOTP_DONE;
+}
+
+uint8_t ObdIsoTp::frameCan(const uint8_t *b, int n) {
+  const uint8_t pci = b[0] >> 4;
+  if (pci == 0) {
+    const size_t l = b[0] & 0x0F;
+    if (l == 0 || l + 1 > (size_t)n)
+      return fail();
+    if (expect_ > 0)
+      errors_++;
+    expect_ = 0;
+    memcpy(buf_, b + 1, l);
+    size_ = l;
+    return OBD_ISOTP_DONE;
+  }
+  if (pci == 1) {
+    if (n < 2)
+      return fail();
+    const size_t l = (size_t)(b[0] & 0x0F) << 8 | b[1];
+    if (l < 8 || l > kMax || (size_t)n - 2 >= l)
+      return fail();
+    if (expect_ > 0)
+      errors_++;
+    size_ = (size_t)n - 2;
+    memcpy(buf_, b + 2, size_);
+    expect_ = l;
+    nextSeq_ = 1;
+    return OBD_ISOTP_MORE;
+  }
+  if (pci == 2) {
+    if (expect_ == 0)
+      return OBD_ISOTP_NONE;
+    if ((b[0] & 0x0F) != nextSeq_)
+      return fail();
+    nextSeq_ = (uint8_t)((nextSeq_ + 1) & 0x0F);
+    size_t k = (size_t)n - 1;
+    if (k > expect_ - size_)
+      k = expect_ - size_;
+    memcpy(buf_ + size_, b + 1, k);
+    size_ += k;
+    if (size_ < expect_)
+      return OBD_ISOTP_MORE;
+    expect_ = 0;
+    return OBD_ISOTP_DONE;
+  }
+  return OBD_ISOTP_NONE;  /* flow control */
+}
@@ -0,0 +1,152 @@
+/*
+ * NOCTURNE_OS — OBD-II mode 01: constexpr PID table, hex tokenizer, ISO-TP reassembly, one-pass reply
+ * decoder. Integer values, no allocation.
+ */
+#ifndef NOCTURNE_OBD_PID_H
+#define NOCTURNE_OBD_PID_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define OBD_UNIT_NONE 0
+#define OBD_UNIT_BITMAP 1   /* supported-PID bitmap */
+#define OBD_UNIT_RPM 2
+#define OBD_UNIT_KMH 3
+#define OBD_UNIT_DEGC 4
+#define OBD_UNIT_PCT 5
+#define OBD_UNIT_KPA 6
+#define OBD_UNIT_GS100 7    /* 0.01 g/s */
+#define OBD_UNIT_MV 8
+#define OBD_UNIT_S 9
+#define OBD_UNIT_DEG2 10    /* 0.5 degree */
+#define OBD_UNIT_KM 11
+
+/** value = raw * mul / div + add; raw is A, A*256+B or the 32-bit bitmap (PIDs 00/20/40). */
+struct ObdPidDef {
+  uint8_t pid;
+  uint8_t bytes;
+  int16_t mul;
+  int16_t div;
+  int16_t add;
+  uint8_t unit;
+  const char *name;
+};
+
+/* Sorted by PID (checked below). */
+static constexpr ObdPidDef kObdPids[] = {
+    {0x00, 4, 1, 1, 0, OBD_UNIT_BITMAP, "pids_01_20"},
+    {0x04, 1, 100, 255, 0, OBD_UNIT_PCT, "load"},
+    {0x05, 1, 1, 1, -40, OBD_UNIT_DEGC, "coolant"},
+    {0x06, 1, 100, 128, -100, OBD_UNIT_PCT, "stft1"},
+    {0x07, 1, 100, 128, -100, OBD_UNIT_PCT, "ltft1"},
+    {0x0B, 1, 1, 1, 0, OBD_UNIT_KPA, "map"},
+    {0x0C, 2, 1, 4, 0, OBD_UNIT_RPM, "rpm"},
+    {0x0D, 1, 1, 1, 0, OBD_UNIT_KMH, "speed"},
+    {0x0E, 1, 1, 1, -128, OBD_UNIT_DEG2, "timing"},
+    {0x0F, 1, 1, 1, -40, OBD_UNIT_DEGC, "intake"},
+    {0x10, 2, 1, 1, 0, OBD_UNIT_GS100, "maf"},
+    {0x11, 1, 100, 255, 0, OBD_UNIT_PCT, "throttle"},
+    {0x1F, 2, 1, 1, 0, OBD_UNIT_S, "runtime"},
+    {0x20, 4, 1, 1, 0, OBD_UNIT_BITMAP, "pids_21_40"},
+    {0x21, 2, 1, 1, 0, OBD_UNIT_KM, "mil_distance"},
+    {0x2F, 1, 100, 255, 0, OBD_UNIT_PCT, "fuel"},
+    {0x33, 1, 1, 1, 0, OBD_UNIT_KPA, "baro"},
+    {0x40, 4, 1, 1, 0, OBD_UNIT_BITMAP, "pids_41_60"},
+    {0x42, 2, 1, 1, 0, OBD_UNIT_MV, "voltage"},
+    {0x45, 1, 100, 255, 0, OBD_UNIT_PCT, "rel_throttle"},
+    {0x46, 1, 1, 1, -40, OBD_UNIT_DEGC, "ambient"},
+    {0x5C, 1, 1, 1, -40, OBD_UNIT_DEGC, "oil"},
+};
+static constexpr size_t kObdPidCount = sizeof(kObdPids) / sizeof(kObdPids[0]);
+
+/* C++11 constexpr (the ESP32 toolchain builds gnu++11): single-return recursion. */
+constexpr bool obdPidSorted(size_t i = 1) {
+  return i >= kObdPidCount || (kObdPids[i - 1].pid < kObdPids[i].pid && obdPidSorted(i + 1));
+}
+static_assert(obdPidSorted(), "kObdPids must be sorted by PID");
+
+constexpr const ObdPidDef *obdPidSearch(uint8_t pid, size_t lo, size_t hi) {
+  return lo >= hi ? nullptr
+                  : kObdPids[(lo + hi) / 2].pid == pid ? &kObdPids[(lo + hi) / 2]
+                  : kObdPids[(lo + hi) / 2].pid < pid ? obdPidSearch(pid, (lo + hi) / 2 + 1, hi)
+                                                      : obdPidSearch(pid, lo, (lo + hi) / 2);
+}
+/** Table row for a PID, nullptr if not decoded here. */
+constexpr const ObdPidDef *obdPidFind(uint8_t pid) { return obdPidSearch(pid, 0, kObdPidCount); }
+static_assert(obdPidFind(0x0C) != nullptr && obdPidFind(0x0C)->bytes == 2, "RPM row");
+static_assert(obdPidFind(0x03) == nullptr, "PID 03 is not in the table");
+
+/** Scaled value of one PID from its data bytes (def->bytes of them). */
+int32_t obdPidValue(const ObdPidDef &def, const uint8_t *d);
+/** Unit suffix for logs ("rpm", "km/h", "C", ...). */
+const char *obdUnitName(uint8_t unit);
+
+/** Hex digit value, -1 if not one. */
+constexpr int obdHexDigit(char c) {
+  return c >= '0' && c <= '9' ? c - '0' : c >= 'A' && c <= 'F' ? c - 'A' + 10 : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+/** Bytes of a hex line ("41 0C 1A F8" or "410C1AF8"); spaces skipped. Returns the byte count, or -1 if the
+ *  line holds anything else, an odd number of digits, or more than cap bytes. */
+int obdParseHex(const char *s, size_t len, uint8_t *out, size_t cap);
+
+struct ObdValue {
+  uint8_t pid;
+  uint8_t unit;
+  int32_t value;
+};
+
+/** Mode 01 reply (41 pid data [pid data ...]) into values, one pass. Stops at a PID not in the table
+ *  or a truncated one; returns the number of values written. */
+size_t obdDecode01(const uint8_t *msg, size_t len, ObdValue *out, size_t cap);
+
+#define OBD_ISOTP_NONE 0    /* line was not data (or ignored) */
+#define OBD_ISOTP_MORE 1    /* part of a multi-frame message */
+#define OBD_ISOTP_DONE 2    /* data()/size() hold a complete message */
+#define OBD_ISOTP_ERROR 3   /* bad length, frame out of sequence or overflow: message dropped */
+
+/**
+ * Reassembles one reply message from ELM327 lines.
+ * Headers off (ATH0): "410C1AF8" is a whole message; "00A" announces a multi-frame message of 0x00A
+ * bytes that follows as "0:410C1AF80D3F", "1:057B5C89000000" (6 then 7 bytes per frame).
+ * Headers on, 11-bit CAN (ATH1): "7E8 06 41 0C 1A F8 ..." — single frame (PCI 0N), first frame (1L LL)
+ * and consecutive frames (2N) with sequence check. While a multi-frame message is being collected,
+ * frames from other ECUs are ignored.
+ */
+class ObdIsoTp {
+ public:
+  static const size_t kMax = 64;
+
+  void setHeaders(bool on) {
+    headers_ = on;
+    reset();
+  }
+  void reset();
+  /** Drop a message still in progress and count it as an error. */
+  void abort() {
+    errors_++;
+    reset();
+  }
+  /** One reply line (no CR/LF). OBD_ISOTP_*. */
+  uint8_t line(const char *s, size_t len);
+  /** Message in progress (OBD_ISOTP_MORE seen, not yet complete). */
+  bool pending() const { return expect_ > 0; }
+  const uint8_t *data() const { return buf_; }
+  size_t size() const { return size_; }
+  uint32_t errors() const { return errors_; }
+
+ private:
+  uint8_t fail();
+  uint8_t frameHeadersOff(const uint8_t *b, int n, int index);
+  uint8_t frameCan(const uint8_t *b, int n);
+
+  bool headers_ = false;
+  uint8_t buf_[kMax] = {};
+  size_t size_ = 0;
+  size_t expect_ = 0;      /* multi-frame length still being collected, 0 = none */
+  uint8_t nextSeq_ = 0;
+  uint16_t ecu_ = 0;       /* CAN id of the responding ECU (headers on) */
+  uint32_t errors_ = 0;
+};
+
+#endif
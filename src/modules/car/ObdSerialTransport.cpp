@@ -0,0 +1,27 @@
+/*
+ * NOCTURNE_OS — ELM327 over a UART.
+ */
+#include "ObdSerialTransport.h"
+
+void ObdSerialTransport::begin(int txPin, int rxPin, uint32_t baud) {
+  if (begun_ || txPin < 0 || rxPin < 0)
+    return;
+  ser_.begin(baud, SERIAL_8N1, rxPin, txPin);
+  begun_ = true;
+  justBegun_ = true;
+}
+
+size_t ObdSerialTransport::read(char *buf, size_t cap) {
+  if (!begun_)
+    return 0;
+  const int avail = ser_.available();
+  if (avail <= 0)
+    return 0;
+  return ser_.readBytes(buf, (size_t)avail < cap ? (size_t)avail : cap);
+}
+
+bool ObdSerialTransport::write(const char *data, size_t len) {
+  if (!begun_)
+    return false;
+  return ser_.write((const uint8_t *)data, len) == len;
+}
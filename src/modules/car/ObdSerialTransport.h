@@ -0,0 +1,36 @@
+/*
+ * NOCTURNE_OS — ELM327 over a UART (USB-serial / Bluetooth-serial adapter wired to Serial2).
+ * The link is up as soon as the port is open; a dead adapter is ObdSession's business (timeouts, ATZ).
+ */
+#ifndef NOCTURNE_OBD_SERIAL_TRANSPORT_H
+#define NOCTURNE_OBD_SERIAL_TRANSPORT_H
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include "ObdTransport.h"
+
+class ObdSerialTransport : public ObdTransport {
+ public:
+  explicit ObdSerialTransport(HardwareSerial &ser) : ser_(ser) {}
+
+  void begin(int txPin, int rxPin, uint32_t baud);
+
+  void poll(uint32_t nowMs) override { (void)nowMs; }
+  bool ready() const override { return begun_; }
+  size_t read(char *buf, size_t cap) override;
+  /** Commands are a few bytes; the TX FIFO always takes them, write() never waits here. */
+  bool write(const char *data, size_t len) override;
+  bool takeConnected() override {
+    const bool c = justBegun_;
+    justBegun_ = false;
+    return c;
+  }
+  const char *name() const override { return "uart"; }
+
+ private:
+  HardwareSerial &ser_;
+  bool begun_ = false;
+  bool justBegun_ = false;
+};
+
+#endif
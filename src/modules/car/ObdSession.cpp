@@ -0,0 +1,391 @@
+/*
+ * NOCTURNE_OS — ELM327 session: init, line assembly, PID scheduling and decoding.
+ */
+#include "ObdSession.h"
+#include <cstring>
+
+namespace {
+
+enum CmdKind { CMD_NONE, CMD_INIT, CMD_PIDS, CMD_SYNC };
+
+const char *const kInitCmds[] = {"ATZ", "ATE0", "ATL0", "ATS0", "ATH0", "ATAT2", "ATSP0", "0100", "ATDPN",
+                                 "0120", "0140"};
+const uint8_t kInitSearch = 7;
+const uint8_t kInitProtocol = 8;
+const uint8_t kInit0120 = 9;
+const uint8_t kInit0140 = 10;
+const uint8_t kInitCount = sizeof(kInitCmds) / sizeof(kInitCmds[0]);
+
+char hexChar(uint8_t v) {
+  return "0123456789ABCDEF"[v & 0x0F];
+}
+
+}  // namespace
+
+int ObdSession::findPid(uint8_t pid) const {
+  for (size_t i = 0; i < pidCount_; i++)
+    if (pids_[i].pid == pid)
+      return (int)i;
+  return -1;
+}
+
+bool ObdSession::addPid(uint8_t pid, uint16_t periodMs) {
+  const ObdPidDef *def = obdPidFind(pid);
+  if (pidCount_ >= kMaxPids || findPid(pid) >= 0 || !def || def->unit == OBD_UNIT_BITMAP)
+    return false;
+  Pid &p = pids_[pidCount_++];
+  memset(&p, 0, sizeof(p));
+  p.pid = pid;
+  p.periodMs = periodMs;
+  p.active = true;
+  return true;
+}
+
+void ObdSession::reset(uint32_t nowMs) {
+  phase_ = PHASE_INIT;
+  initStep_ = 0;
+  waiting_ = false;
+  nextReady_ = true;
+  notBeforeMs_ = nowMs;
+  consecutiveTimeouts_ = 0;
+  kind_ = CMD_NONE;
+  can_ = false;
+  maxPerRequest_ = 1;
+  memset(supported_, 0, sizeof(supported_));
+  memset(haveSupported_, 0, sizeof(haveSupported_));
+  lineLen_ = 0;
+  isotp_.setHeaders(false);  /* ATH0 */
+  flags_ = 0;
+  anyData_ = false;
+  text_[0] = '\0';
+  ecuAlive_ = false;
+  windowStartMs_ = nowMs;
+  for (size_t i = 0; i < pidCount_; i++) {
+    pids_[i].active = true;
+    pids_[i].misses = 0;
+    pids_[i].dueMs = nowMs;
+  }
+}
+
+bool ObdSession::supported(uint8_t pid) const {
+  if (pid == 0)
+    return true;
+  const uint8_t idx = (uint8_t)((pid - 1) / 32);
+  if (idx >= 3 || !haveSupported_[idx])
+    return true;  /* no bitmap: try it */
+  return (supported_[idx] >> (31 - (pid - 1) % 32)) & 1u;
+}
+
+bool ObdSession::pidActive(uint8_t pid) const {
+  const int i = findPid(pid);
+  return i >= 0 && pids_[i].active;
+}
+
+bool ObdSession::value(uint8_t pid, int32_t *v, uint32_t *atMs) const {
+  const int i = findPid(pid);
+  if (i < 0 || !pids_[i].has)
+    return false;
+  if (v)
+    *v = pids_[i].value;
+  if (atMs)
+    *atMs = pids_[i].atMs;
+  return true;
+}
+
+float ObdSession::rate(uint8_t pid) const {
+  const int i = findPid(pid);
+  return i < 0 ? 0.0f : pids_[i].rate;
+}
+
+uint32_t ObdSession::samples(uint8_t pid) const {
+  const int i = findPid(pid);
+  return i < 0 ? 0 : pids_[i].samples;
+}
+
+void ObdSession::feed(const char *data, size_t len, uint32_t nowMs) {
+  for (size_t i = 0; data && i < len; i++) {
+    const char c = data[i];
+    if (c == '>') {
+      finishLine(nowMs);
+      onPrompt(nowMs);
+    } else if (c == '\r' || c == '\n') {
+      finishLine(nowMs);
+    } else if (c != '\0' && lineLen_ < kLineMax - 1) {
+      line_[lineLen_++] = c;
+    }
+  }
+}
+
+/** One reply line: status text, multi-frame length, or hex data ("410C1AF8", "0:410C1AF8050", "1:5C..."). */
+void ObdSession::finishLine(uint32_t nowMs) {
+  if (lineLen_ == 0)
+    return;
+  line_[lineLen_] = '\0';
+  const size_t len = lineLen_;
+  lineLen_ = 0;
+  if (text_[0] == '\0') {
+    strncpy(text_, line_, sizeof(text_) - 1);
+    text_[sizeof(text_) - 1] = '\0';
+  }
+  if (strstr(line_, "SEARCHING") || strstr(line_, "BUS INIT"))
+    return;
+  if (strstr(line_, "NO DATA")) {
+    flags_ |= 1u << OBD_RESP_NO_DATA;
+    return;
+  }
+  if (strstr(line_, "STOPPED")) {
+    flags_ |= 1u << OBD_RESP_STOPPED;
+    return;
+  }
+  if (line_[0] == '?') {
+    flags_ |= 1u << OBD_RESP_UNKNOWN;
+    return;
+  }
+  if (strstr(line_, "ERROR") || strstr(line_, "UNABLE") || strstr(line_, "BUS BUSY") ||
+      strstr(line_, "BUFFER FULL") || strncmp(line_, "ERR", 3) == 0) {
+    flags_ |= 1u << OBD_RESP_BUS_ERROR;
+    return;
+  }
+  /* Hex data (single line or ISO-TP frames); banner, echo and OK lines are not hex and fall through. */
+  if (isotp_.line(line_, len) == OBD_ISOTP_DONE)
+    decodeMessage(isotp_.data(), isotp_.size(), nowMs);
+}
+
+void ObdSession::decodeMessage(const uint8_t *msg, size_t len, uint32_t nowMs) {
+  ObdValue vals[kMaxPidsPerRequest + 2];
+  const size_t n = obdDecode01(msg, len, vals, sizeof(vals) / sizeof(vals[0]));
+  for (size_t i = 0; i < n; i++) {
+    const uint8_t pid = vals[i].pid;
+    /* Values only as the answer to a PID request (or its repeat after a bare CR): during init they are
+     * leftovers of an earlier session (an adapter that kept talking while the link was down) and their
+     * arrival time means nothing. */
+    if (vals[i].unit != OBD_UNIT_BITMAP && kind_ != CMD_PIDS && kind_ != CMD_SYNC)
+      continue;
+    if (vals[i].unit == OBD_UNIT_BITMAP) {
+      const uint8_t idx = pid / 32;
+      supported_[idx] = (uint32_t)vals[i].value;
+      haveSupported_[idx] = true;
+    } else {
+      const int k = findPid(pid);
+      if (k >= 0) {
+        Pid &p = pids_[k];
+        p.value = vals[i].value;
+        p.atMs = nowMs;
+        p.has = true;
+        p.misses = 0;
+        p.samples++;
+        p.windowSamples++;
+        updated_ = true;
+      }
+      for (uint8_t r = 0; r < reqCount_; r++)
+        if (reqPids_[r] == pid)
+          reqAnswered_[r] = true;
+    }
+    anyData_ = true;
+    lastDataMs_ = nowMs;
+    ecuAlive_ = true;
+  }
+}
+
+void ObdSession::nextInitStep(uint32_t nowMs) {
+  if (initStep_ == kInitSearch && !anyData_) {
+    /* Ignition off or no bus yet: search again later. */
+    notBeforeMs_ = nowMs + kIdleRetryMs;
+    return;
+  }
+  if (initStep_ == kInitProtocol) {
+    /* "6" or "A6" (auto): 6..9 ISO 15765 CAN, A..C user CAN. */
+    const size_t n = strlen(text_);
+    const char c = n ? text_[n - 1] : '0';
+    can_ = (c >= '6' && c <= '9') || (c >= 'A' && c <= 'C');
+    maxPerRequest_ = can_ ? kMaxPidsPerRequest : 1;
+  }
+  initStep_++;
+  bool need20 = false, need40 = false;
+  for (size_t i = 0; i < pidCount_; i++) {
+    need20 |= pids_[i].pid > 0x20;
+    need40 |= pids_[i].pid > 0x40;
+  }
+  if (initStep_ == kInit0120 && !(need20 && supported(0x20)))
+    initStep_++;
+  if (initStep_ == kInit0140 && !(need40 && supported(0x40)))
+    initStep_++;
+  if (initStep_ >= kInitCount) {
+    phase_ = PHASE_RUN;
+    for (size_t i = 0; i < pidCount_; i++) {
+      pids_[i].active = supported(pids_[i].pid);
+      pids_[i].dueMs = nowMs;
+    }
+  }
+}
+
+void ObdSession::onPrompt(uint32_t nowMs) {
+  if (isotp_.pending())
+    isotp_.abort();  /* frames missing: the partial message is dropped */
+  const uint8_t kind = kind_;
+  if (anyData_)
+    lastStatus_ = OBD_RESP_OK;
+  else if (flags_ & (1u << OBD_RESP_BUS_ERROR))
+    lastStatus_ = OBD_RESP_BUS_ERROR;
+  else if (flags_ & (1u << OBD_RESP_NO_DATA))
+    lastStatus_ = OBD_RESP_NO_DATA;
+  else if (flags_ & (1u << OBD_RESP_UNKNOWN))
+    lastStatus_ = OBD_RESP_UNKNOWN;
+  else if (flags_ & (1u << OBD_RESP_STOPPED))
+    lastStatus_ = OBD_RESP_STOPPED;
+  else
+    lastStatus_ = OBD_RESP_OK;
+
+  if (waiting_) {
+    waiting_ = false;
+    consecutiveTimeouts_ = 0;
+    if (kind == CMD_INIT) {
+      nextInitStep(nowMs);
+    } else if (kind == CMD_PIDS) {
+      rttLastMs_ = nowMs - sentMs_;
+      if (rttLastMs_ > rttMaxMs_)
+        rttMaxMs_ = rttLastMs_;
+      rttSumMs_ += rttLastMs_;
+      rttCount_++;
+      if (anyData_) {
+        for (uint8_t r = 0; r < reqCount_; r++) {
+          if (reqAnswered_[r])
+            continue;
+          const int k = findPid(reqPids_[r]);
+          if (k >= 0 && ++pids_[k].misses >= kMaxMisses)
+            pids_[k].active = false;
+        }
+      } else if (lastStatus_ == OBD_RESP_UNKNOWN && reqCount_ > 1) {
+        /* Some clones reject multi-PID requests: one PID per request from now on. */
+        maxPerRequest_ = 1;
+      } else if (nowMs - lastDataMs_ >= kEcuLostMs) {
+        ecuAlive_ = false;
+        notBeforeMs_ = nowMs + kIdleRetryMs;
+      }
+    }
+  }
+  reqCount_ = 0;
+  kind_ = CMD_NONE;
+  flags_ = 0;
+  anyData_ = false;
+  text_[0] = '\0';
+  nextReady_ = true;
+}
+
+size_t ObdSession::emit(const char *cmd, uint32_t nowMs, uint32_t timeoutMs, char *out, size_t cap) {
+  const size_t n = strlen(cmd);
+  if (n + 2 > cap)
+    return 0;
+  memcpy(out, cmd, n);
+  out[n] = '\r';
+  out[n + 1] = '\0';
+  waiting_ = true;
+  nextReady_ = false;
+  sentMs_ = nowMs;
+  timeoutMs_ = timeoutMs;
+  return n + 1;
+}
+
+size_t ObdSession::buildRequest(uint32_t nowMs, char *out, size_t cap) {
+  /* Most overdue first; once something is due, PIDs that would fall due before the next request could
+   * go out (one round trip, at most a quarter period) ride along for free. */
+  uint8_t chosen[kMaxPidsPerRequest];
+  uint8_t count = 0;
+  bool taken[kMaxPids] = {};
+  for (uint8_t round = 0; round < 2; round++) {
+    while (count < maxPerRequest_) {
+      int best = -1;
+      int32_t bestLate = 0;
+      for (size_t i = 0; i < pidCount_; i++) {
+        const Pid &p = pids_[i];
+        if (!p.active || taken[i])
+          continue;
+        const int32_t late = (int32_t)(nowMs - p.dueMs);
+        const uint32_t ahead = p.periodMs / 4 < rttLastMs_ ? p.periodMs / 4 : rttLastMs_;
+        const int32_t slack = round == 0 ? 0 : -(int32_t)ahead;
+        if (late < slack)
+          continue;
+        if (best < 0 || late > bestLate) {
+          best = (int)i;
+          bestLate = late;
+        }
+      }
+      if (best < 0)
+        break;
+      taken[best] = true;
+      chosen[count++] = (uint8_t)best;
+    }
+    if (count == 0)
+      return 0;
+  }
+  char cmd[4 + 2 * kMaxPidsPerRequest + 2];
+  size_t n = 0;
+  cmd[n++] = '0';
+  cmd[n++] = '1';
+  size_t replyBytes = 1;
+  reqCount_ = count;
+  for (uint8_t i = 0; i < count; i++) {
+    Pid &p = pids_[chosen[i]];
+    cmd[n++] = hexChar(p.pid >> 4);
+    cmd[n++] = hexChar(p.pid);
+    replyBytes += 1u + obdPidFind(p.pid)->bytes;
+    reqPids_[i] = p.pid;
+    reqAnswered_[i] = false;
+    /* Keep the grid (a PID sent a round trip late or early does not drift); re-anchor if far behind. */
+    if (p.periodMs > 0 && (int32_t)(nowMs - p.dueMs) < (int32_t)p.periodMs)
+      p.dueMs += p.periodMs;
+    else
+      p.dueMs = nowMs + p.periodMs;
+  }
+  if (can_ && replyBytes <= 7)
+    cmd[n++] = '1';  /* one single-frame reply expected: no waiting for other ECUs */
+  cmd[n] = '\0';
+  kind_ = CMD_PIDS;
+  requests_++;
+  return emit(cmd, nowMs, kCmdTimeoutMs, out, cap);
+}
+
+void ObdSession::rollRates(uint32_t nowMs) {
+  const uint32_t elapsed = nowMs - windowStartMs_;
+  if (elapsed < kRateWindowMs)
+    return;
+  for (size_t i = 0; i < pidCount_; i++) {
+    pids_[i].rate = pids_[i].windowSamples * 1000.0f / (float)elapsed;
+    pids_[i].windowSamples = 0;
+  }
+  windowStartMs_ = nowMs;
+}
+
+size_t ObdSession::poll(uint32_t nowMs, char *out, size_t cap) {
+  if (!out || cap < 4)
+    return 0;
+  rollRates(nowMs);
+  if (ecuAlive_ && nowMs - lastDataMs_ >= kEcuLostMs)
+    ecuAlive_ = false;
+  if (waiting_) {
+    if (nowMs - sentMs_ < timeoutMs_)
+      return 0;
+    /* Lost command or hung adapter: a bare CR interrupts whatever it is doing and brings the prompt. */
+    timeouts_++;
+    lastStatus_ = OBD_RESP_TIMEOUT;
+    waiting_ = false;
+    reqCount_ = 0;
+    lineLen_ = 0;
+    isotp_.reset();
+    if (++consecutiveTimeouts_ >= kMaxTimeouts) {
+      resets_++;
+      reset(nowMs);
+    } else {
+      kind_ = CMD_SYNC;
+      return emit("", nowMs, kCmdTimeoutMs, out, cap);
+    }
+  }
+  if (!nextReady_ || (int32_t)(nowMs - notBeforeMs_) < 0)
+    return 0;
+  if (phase_ == PHASE_INIT) {
+    kind_ = CMD_INIT;
+    const uint32_t t = initStep_ == 0 ? kResetTimeoutMs : initStep_ == kInitSearch ? kSearchTimeoutMs : kCmdTimeoutMs;
+    return emit(kInitCmds[initStep_], nowMs, t, out, cap);
+  }
+  return buildRequest(nowMs, out, cap);
+}
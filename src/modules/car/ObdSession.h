@@ -0,0 +1,151 @@
+/*
+ * NOCTURNE_OS — ELM327 session: init, line assembly, PID scheduling and decoding. Never blocks: one command
+ * outstanding, the next on the '>' prompt; due PIDs share one mode 01 request on CAN.
+ */
+#ifndef NOCTURNE_OBD_SESSION_H
+#define NOCTURNE_OBD_SESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include "ObdPid.h"
+
+#define OBD_PID_COOLANT 0x05
+#define OBD_PID_RPM 0x0C
+#define OBD_PID_SPEED 0x0D
+#define OBD_PID_OIL 0x5C
+
+/** Result of the last response (lastStatus()). */
+#define OBD_RESP_OK 0
+#define OBD_RESP_NO_DATA 1       /* NO DATA: ECU silent (ignition off) or PID not answered */
+#define OBD_RESP_STOPPED 2       /* STOPPED: interrupted by our own input */
+#define OBD_RESP_BUS_ERROR 3     /* UNABLE TO CONNECT, CAN ERROR, BUS ERROR, ... */
+#define OBD_RESP_UNKNOWN 4       /* ? : command not understood */
+#define OBD_RESP_TIMEOUT 5       /* no prompt in time */
+
+class ObdSession {
+ public:
+  static const size_t kLineMax = 96;
+  static const size_t kMaxPids = 8;
+  static const uint8_t kMaxPidsPerRequest = 6;
+  /** No prompt this long after a command: assume it was lost, move on. 0100 may search protocols first. */
+  static const uint32_t kCmdTimeoutMs = 1500;
+  static const uint32_t kResetTimeoutMs = 3000;
+  static const uint32_t kSearchTimeoutMs = 12000;
+  /** Consecutive timeouts before the adapter is reset (ATZ). */
+  static const uint8_t kMaxTimeouts = 3;
+  /** ECU silent (NO DATA / bus errors) this long: disconnected, requests slow down to kIdleRetryMs. */
+  static const uint32_t kEcuLostMs = 3000;
+  static const uint32_t kIdleRetryMs = 2000;
+  /** A PID the ECU never answers while others in the same reply do is dropped after this many tries. */
+  static const uint8_t kMaxMisses = 5;
+  static const uint32_t kRateWindowMs = 5000;
+
+  /** Add a PID polled every periodMs (0 = as often as possible); it must be in kObdPids. Call before reset(). */
+  bool addPid(uint8_t pid, uint16_t periodMs);
+  /** Start (again) from ATZ. */
+  void reset(uint32_t nowMs);
+  /** Bytes from the adapter, in any chunking. */
+  void feed(const char *data, size_t len, uint32_t nowMs);
+  /** Next command including the trailing '\r', or 0 if nothing is due / a command is outstanding. */
+  size_t poll(uint32_t nowMs, char *out, size_t cap);
+
+  /** ECU answered recently. */
+  bool connected() const { return ecuAlive_; }
+  bool initialized() const { return phase_ == PHASE_RUN; }
+  bool canBus() const { return can_; }
+  /** Latest decoded value (rpm, km/h, degC) and when it arrived; false if none yet. */
+  bool value(uint8_t pid, int32_t *v, uint32_t *atMs = nullptr) const;
+  /** Latest reply decoded something: cleared by the call. */
+  bool takeUpdate() {
+    const bool u = updated_;
+    updated_ = false;
+    return u;
+  }
+  /** PID still polled (false = unsupported per bitmap or never answered). */
+  bool pidActive(uint8_t pid) const;
+  uint8_t lastStatus() const { return lastStatus_; }
+
+  /** Samples per second per PID over the last full kRateWindowMs. */
+  float rate(uint8_t pid) const;
+  uint32_t samples(uint8_t pid) const;
+  uint32_t requests() const { return requests_; }
+  uint32_t timeouts() const { return timeouts_; }
+  uint32_t resets() const { return resets_; }
+  /** Multi-frame replies dropped (frame out of sequence, bad length, incomplete at the prompt). */
+  uint32_t frameErrors() const { return isotp_.errors(); }
+  /** Request -> prompt round trip of PID requests. */
+  uint32_t rttLastMs() const { return rttLastMs_; }
+  uint32_t rttMaxMs() const { return rttMaxMs_; }
+  uint32_t rttAvgMs() const { return rttCount_ ? (uint32_t)(rttSumMs_ / rttCount_) : 0; }
+
+ private:
+  enum Phase { PHASE_INIT, PHASE_RUN };
+  struct Pid {
+    uint8_t pid;
+    uint16_t periodMs;
+    bool active;
+    bool has;
+    uint8_t misses;
+    int32_t value;
+    uint32_t atMs;
+    uint32_t dueMs;
+    uint32_t samples;
+    uint32_t windowSamples;
+    float rate;
+  };
+
+  int findPid(uint8_t pid) const;
+  void finishLine(uint32_t nowMs);
+  void onPrompt(uint32_t nowMs);
+  void decodeMessage(const uint8_t *msg, size_t len, uint32_t nowMs);
+  void nextInitStep(uint32_t nowMs);
+  size_t buildRequest(uint32_t nowMs, char *out, size_t cap);
+  size_t emit(const char *cmd, uint32_t nowMs, uint32_t timeoutMs, char *out, size_t cap);
+  bool supported(uint8_t pid) const;
+  void rollRates(uint32_t nowMs);
+
+  Pid pids_[kMaxPids] = {};
+  size_t pidCount_ = 0;
+
+  Phase phase_ = PHASE_INIT;
+  uint8_t initStep_ = 0;
+  uint8_t kind_ = 0;           /* what the outstanding command is (CmdKind) */
+  bool waiting_ = false;       /* command sent, prompt not yet seen */
+  bool nextReady_ = false;     /* prompt seen: poll() may send */
+  uint32_t sentMs_ = 0;
+  uint32_t timeoutMs_ = kCmdTimeoutMs;
+  uint32_t notBeforeMs_ = 0;
+  uint8_t consecutiveTimeouts_ = 0;
+  bool can_ = false;
+  uint8_t maxPerRequest_ = 1;
+  uint32_t supported_[3] = {};  /* bitmaps from 0100 / 0120 / 0140 */
+  bool haveSupported_[3] = {};
+
+  /* Outstanding PID request. */
+  uint8_t reqPids_[kMaxPidsPerRequest] = {};
+  uint8_t reqCount_ = 0;
+  bool reqAnswered_[kMaxPidsPerRequest] = {};
+
+  char line_[kLineMax] = {};
+  size_t lineLen_ = 0;
+  ObdIsoTp isotp_;
+  char text_[16] = {};          /* first text line of the reply (ATDPN, banner) */
+  uint8_t flags_ = 0;           /* OBD_RESP_* seen in this reply, as bits */
+  bool anyData_ = false;
+
+  bool ecuAlive_ = false;
+  uint32_t lastDataMs_ = 0;
+  bool updated_ = false;
+  uint8_t lastStatus_ = OBD_RESP_OK;
+
+  uint32_t requests_ = 0;
+  uint32_t timeouts_ = 0;
+  uint32_t resets_ = 0;
+  uint32_t rttLastMs_ = 0;
+  uint32_t rttMaxMs_ = 0;
+  uint64_t rttSumMs_ = 0;
+  uint32_t rttCount_ = 0;
+  uint32_t windowStartMs_ = 0;
+};
+
+#endif
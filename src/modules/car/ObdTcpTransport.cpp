@@ -0,0 +1,87 @@
+/*
+ * NOCTURNE_OS — ELM327 over TCP: backoff and silent-peer policy.
+ */
+#include "ObdTcpTransport.h"
+
+bool ObdTcpTransport::setServer(const char *ip, uint16_t port) {
+  if (!sock_.setServer(ip, port))
+    return false;
+  awaitingRx_ = false;
+  retryMs_ = kRetryMinMs;
+  nextTryMs_ = nowMs_;
+  return true;
+}
+
+void ObdTcpTransport::setNetworkUp(bool up) {
+  if (up == networkUp_)
+    return;
+  networkUp_ = up;
+  if (!up)
+    close();
+  retryMs_ = kRetryMinMs;
+  nextTryMs_ = nowMs_;  /* network back: try at once */
+}
+
+void ObdTcpTransport::close() {
+  sock_.close();
+  awaitingRx_ = false;
+}
+
+void ObdTcpTransport::onEvent(TcpStream::Event ev) {
+  switch (ev) {
+    case TcpStream::TCP_EV_UP:
+      retryMs_ = kRetryMinMs;
+      awaitingRx_ = false;
+      break;
+    case TcpStream::TCP_EV_FAILED:
+      nextTryMs_ = nowMs_ + retryMs_;
+      retryMs_ = retryMs_ * 2 > kRetryMaxMs ? kRetryMaxMs : retryMs_ * 2;
+      break;
+    case TcpStream::TCP_EV_DROPPED:
+      awaitingRx_ = false;
+      nextTryMs_ = nowMs_ + retryMs_;
+      break;
+    case TcpStream::TCP_EV_NONE:
+      break;
+  }
+}
+
+void ObdTcpTransport::poll(uint32_t nowMs) {
+  nowMs_ = nowMs;
+  if (sock_.idle()) {
+    if (networkUp_ && sock_.hasServer() && (int32_t)(nowMs - nextTryMs_) >= 0)
+      onEvent(sock_.connect(nowMs, noDelay_));
+    return;
+  }
+  onEvent(sock_.poll(nowMs, kConnectTimeoutMs));
+  if (sock_.connected() && awaitingRx_ && nowMs - txSinceMs_ >= kSilentDropMs) {
+    sock_.drop();
+    onEvent(TcpStream::TCP_EV_DROPPED);
+  }
+}
+
+size_t ObdTcpTransport::read(char *buf, size_t cap) {
+  if (!sock_.connected())
+    return 0;
+  const size_t n = sock_.read(buf, cap);
+  if (n > 0)
+    awaitingRx_ = false;
+  else if (!sock_.connected())
+    onEvent(TcpStream::TCP_EV_DROPPED);  /* peer closed or reset */
+  return n;
+}
+
+bool ObdTcpTransport::write(const char *data, size_t len) {
+  if (!sock_.connected())
+    return false;
+  if (sock_.write(data, len)) {
+    if (!awaitingRx_) {
+      awaitingRx_ = true;
+      txSinceMs_ = nowMs_;
+    }
+    return true;
+  }
+  if (!sock_.connected())
+    onEvent(TcpStream::TCP_EV_DROPPED);
+  return false;
+}
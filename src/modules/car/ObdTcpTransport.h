@@ -0,0 +1,65 @@
+/*
+ * NOCTURNE_OS — ELM327 over TCP (Wi-Fi OBD adapters, usually 192.168.0.10:35000) on TcpStream: connect
+ * backoff, TCP_NODELAY, reconnect after kSilentDropMs without a reply.
+ */
+#ifndef NOCTURNE_OBD_TCP_TRANSPORT_H
+#define NOCTURNE_OBD_TCP_TRANSPORT_H
+
+#include "ObdTransport.h"
+#include "TcpStream.h"
+
+class ObdTcpTransport : public ObdTransport {
+ public:
+  static const uint32_t kConnectTimeoutMs = 3000;
+  static const uint32_t kRetryMinMs = 500;
+  static const uint32_t kRetryMaxMs = 8000;
+  /** Longer than ObdSession's slowest command (protocol search after ATZ). */
+  static const uint32_t kSilentDropMs = 15000;
+  static const size_t kTxMax = 64;
+
+  ObdTcpTransport() = default;
+  ObdTcpTransport(const ObdTcpTransport &) = delete;
+  ObdTcpTransport &operator=(const ObdTcpTransport &) = delete;
+
+  /** IPv4 address and port; false if the address does not parse. Closes an open connection. */
+  bool setServer(const char *ip, uint16_t port);
+  /** Wi-Fi station up. While false nothing is attempted and an open connection is closed. Default true. */
+  void setNetworkUp(bool up);
+  /** Nagle off (default). Only the benchmark turns it back on, for comparison. */
+  void setNoDelay(bool on) { noDelay_ = on; }
+
+  void poll(uint32_t nowMs) override;
+  bool ready() const override { return sock_.connected(); }
+  size_t read(char *buf, size_t cap) override;
+  bool write(const char *data, size_t len) override;
+  bool takeConnected() override { return sock_.takeConnected(); }
+  const char *name() const override { return "tcp"; }
+
+  /** Close now; the next attempt follows the retry delay. */
+  void close();
+
+  bool connecting() const { return sock_.connecting(); }
+  uint32_t connects() const { return sock_.connects(); }
+  uint32_t failures() const { return sock_.failures(); }
+  /** Established connections that were lost (peer closed, error, silent). */
+  uint32_t drops() const { return sock_.drops(); }
+  uint32_t connectMs() const { return sock_.connectMs(); }
+  uint32_t retryMs() const { return retryMs_; }
+
+ private:
+  /** React to what the socket just did: backoff after a failed connect, retry delay after a drop. */
+  void onEvent(TcpStream::Event ev);
+
+  char tx_[kTxMax];
+  TcpStream sock_{tx_, kTxMax};
+  bool networkUp_ = true;
+  bool noDelay_ = true;
+
+  uint32_t nowMs_ = 0;
+  uint32_t nextTryMs_ = 0;
+  uint32_t retryMs_ = kRetryMinMs;
+  bool awaitingRx_ = false;   /* sent something, nothing received since */
+  uint32_t txSinceMs_ = 0;
+};
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * NOCTURNE_OS — byte link between ObdClient and the ELM327: UART (ObdSerialTransport) or a Wi-Fi adapter
+ * over TCP (ObdTcpTransport). No call waits: a backend that has to (re)connect does it step by step in
+ * poll(), and read() returns only what is already there.
+ */
+#ifndef NOCTURNE_OBD_TRANSPORT_H
+#define NOCTURNE_OBD_TRANSPORT_H
+
+#include <cstddef>
+#include <cstdint>
+
+class ObdTransport {
+ public:
+  virtual ~ObdTransport() {}
+
+  /** Advance the connection (connect, retry, detect a dead link). Called once per ObdClient::tick(). */
+  virtual void poll(uint32_t nowMs) = 0;
+  /** Bytes can be read and written. */
+  virtual bool ready() const = 0;
+  /** Up to cap bytes already received; 0 if none or the link is down. */
+  virtual size_t read(char *buf, size_t cap) = 0;
+  /** Send one command; false if the link is down or cannot take it now. */
+  virtual bool write(const char *data, size_t len) = 0;
+  /** The link came up since the last call: the adapter may be a fresh one, start the session over. */
+  virtual bool takeConnected() { return false; }
+  /** Short name for logs ("uart", "tcp"). */
+  virtual const char *name() const = 0;
+};
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * NOCTURNE_OS — predictive shift light.
+ */
+#include "ShiftPredictor.h"
+#include <cmath>
+
+ShiftPredictor::ShiftPredictor() {
+  for (uint8_t g = 0; g <= kMaxGears; g++) {
+    thresholds_[g] = 5500;
+    ratios_[g] = 0;
+  }
+}
+
+void ShiftPredictor::setThreshold(uint8_t gear, uint16_t rpm) {
+  if (gear <= kMaxGears)
+    thresholds_[gear] = rpm;
+}
+
+void ShiftPredictor::setGearRatio(uint8_t gear, uint16_t kmhPer1000x10) {
+  if (gear >= 1 && gear <= kMaxGears)
+    ratios_[gear] = kmhPer1000x10;
+}
+
+void ShiftPredictor::reset() {
+  count_ = 0;
+  head_ = 0;
+  slope_ = 0;
+  predicted_ = 0;
+  peak_ = 0;
+  gear_ = 0;
+  horizonMs_ = 0;
+  active_ = false;
+  rising_ = false;
+}
+
+void ShiftPredictor::addSample(int rpm, uint32_t sampleMs) {
+  if (rpm < 0)
+    return;
+  if (count_ > 0) {
+    const Sample &last = hist_[(head_ + kHistory - 1) % kHistory];
+    if ((int32_t)(sampleMs - last.ms) <= 0)
+      return;  /* duplicate or out of order */
+  }
+  hist_[head_] = {rpm, sampleMs};
+  head_ = (uint8_t)((head_ + 1) % kHistory);
+  if (count_ < kHistory)
+    count_++;
+  fit();
+}
+
+/* Least squares over the samples in the fit window; times relative to the newest sample. */
+void ShiftPredictor::fit() {
+  const Sample &last = hist_[(head_ + kHistory - 1) % kHistory];
+  float sx = 0, sy = 0, sxx = 0, sxy = 0;
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < count_; i++) {
+    const Sample &s = hist_[(head_ + kHistory - 1 - i) % kHistory];
+    const uint32_t age = last.ms - s.ms;
+    if (age > kFitWindowMs)
+      break;
+    const float x = -(float)age / 1000.0f;
+    const float y = (float)(s.rpm - last.rpm);
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+    n++;
+  }
+  const float den = n * sxx - sx * sx;
+  slope_ = (n >= 2 && den > 1e-9f) ? (int)lroundf((n * sxy - sx * sy) / den) : 0;
+}
+
+uint8_t ShiftPredictor::estimateGear(int rpm) const {
+  if (speedKmh_ <= 0 || rpm < 1000)
+    return 0;
+  const uint32_t ratio = (uint32_t)speedKmh_ * 10000u / (uint32_t)rpm;  /* km/h per 1000 rpm * 10 */
+  uint8_t best = 0;
+  uint32_t bestErr = 0;
+  for (uint8_t g = 1; g <= kMaxGears; g++) {
+    if (ratios_[g] == 0)
+      continue;
+    const uint32_t err = ratio > ratios_[g] ? ratio - ratios_[g] : ratios_[g] - ratio;
+    if (err * 100u <= (uint32_t)ratios_[g] * kGearTolerancePct && (best == 0 || err < bestErr)) {
+      best = g;
+      bestErr = err;
+    }
+  }
+  return best;
+}
+
+bool ShiftPredictor::update(uint32_t nowMs) {
+  rising_ = false;
+  if (count_ == 0)
+    return active_;
+  const Sample &last = hist_[(head_ + kHistory - 1) % kHistory];
+  const uint32_t age = nowMs - last.ms;
+  if ((int32_t)age < 0 || age > kStaleMs) {
+    active_ = false;
+    predicted_ = last.rpm;
+    return false;
+  }
+  horizonMs_ = age + outputLatencyMs_;
+  const uint32_t h = horizonMs_ > kMaxHorizonMs ? kMaxHorizonMs : horizonMs_;
+  /* Only rising RPM is extrapolated: a falling one cannot make the cue come early. */
+  predicted_ = last.rpm + (slope_ > 0 ? (int)((int64_t)slope_ * h / 1000) : 0);
+  const uint8_t g = estimateGear(last.rpm);
+  if (g != 0 || !active_)
+    gear_ = g;  /* keep the gear of an active cue through the clutch-in of the shift */
+  const int thr = threshold(gear_);
+  if (!active_) {
+    if (predicted_ >= thr) {
+      active_ = true;
+      rising_ = true;
+      peak_ = last.rpm;
+      cues_++;
+    }
+  } else {
+    if (last.rpm > peak_)
+      peak_ = last.rpm;
+    const bool below = predicted_ < thr - hysteresis_ && last.rpm < thr - hysteresis_;
+    const bool shifted = last.rpm < peak_ - (int)hysteresis_ && slope_ < 0;
+    if (below || shifted)
+      active_ = false;
+  }
+  return active_;
+}
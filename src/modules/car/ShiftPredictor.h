@@ -0,0 +1,86 @@
+/*
+ * NOCTURNE_OS — predictive shift light: least-squares RPM slope extrapolated over the OBD-to-cue latency,
+ * per-gear thresholds with hysteresis. BmwManager drives the LED and IKE "SHIFT!" from active().
+ */
+#ifndef NOCTURNE_SHIFT_PREDICTOR_H
+#define NOCTURNE_SHIFT_PREDICTOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+class ShiftPredictor {
+ public:
+  static const uint8_t kMaxGears = 6;
+  static const uint8_t kHistory = 8;
+  /** Samples older than this (relative to the newest) are not part of the slope fit. */
+  static const uint32_t kFitWindowMs = 400;
+  /** Never extrapolate further than this (stalled OBD, huge loop gap). */
+  static const uint32_t kMaxHorizonMs = 300;
+  /** No sample for this long: cue off, no prediction. */
+  static const uint32_t kStaleMs = 600;
+  /** Gear ratio match tolerance, percent. */
+  static const uint8_t kGearTolerancePct = 10;
+
+  ShiftPredictor();
+
+  /** Threshold for a gear (1..kMaxGears); gear 0 = unknown gear / default. */
+  void setThreshold(uint8_t gear, uint16_t rpm);
+  uint16_t threshold(uint8_t gear) const { return gear <= kMaxGears ? thresholds_[gear] : thresholds_[0]; }
+  /** km/h per 1000 rpm * 10 for a gear; 0 = unused gear. */
+  void setGearRatio(uint8_t gear, uint16_t kmhPer1000x10);
+  void setHysteresis(uint16_t rpm) { hysteresis_ = rpm; }
+  /** Time from update() to the cue being visible (LED ~0, IKE text ~40 ms). */
+  void setOutputLatency(uint16_t ms) { outputLatencyMs_ = ms; }
+  void reset();
+
+  /** RPM measured at sampleMs (the ECU's sampling time, not the arrival time). */
+  void addSample(int rpm, uint32_t sampleMs);
+  /** Latest speed for the gear estimate; negative = unknown. */
+  void setSpeed(int kmh) { speedKmh_ = kmh; }
+  /** Re-evaluate at nowMs. Returns active(). */
+  bool update(uint32_t nowMs);
+
+  bool active() const { return active_; }
+  /** Cue turned on (rising edge) at the last update(); cleared by the call. */
+  bool takeRising() {
+    const bool r = rising_;
+    rising_ = false;
+    return r;
+  }
+  int predictedRpm() const { return predicted_; }
+  /** rpm/s of the last fit. */
+  int slope() const { return slope_; }
+  uint8_t gear() const { return gear_; }
+  /** Last extrapolation distance: sample age + output latency (the measured pipeline latency). */
+  uint32_t horizonMs() const { return horizonMs_; }
+  uint32_t cues() const { return cues_; }
+
+ private:
+  struct Sample {
+    int32_t rpm;
+    uint32_t ms;
+  };
+  void fit();
+  uint8_t estimateGear(int rpm) const;
+
+  uint16_t thresholds_[kMaxGears + 1];
+  uint16_t ratios_[kMaxGears + 1];
+  uint16_t hysteresis_ = 300;
+  uint16_t outputLatencyMs_ = 40;
+
+  Sample hist_[kHistory] = {};
+  uint8_t count_ = 0;
+  uint8_t head_ = 0;   /* next write */
+  int speedKmh_ = -1;
+
+  int slope_ = 0;
+  int predicted_ = 0;
+  int peak_ = 0;       /* highest sample while active: a drop from it means the shift happened */
+  uint8_t gear_ = 0;
+  uint32_t horizonMs_ = 0;
+  bool active_ = false;
+  bool rising_ = false;
+  uint32_t cues_ = 0;
+};
+
+#endif
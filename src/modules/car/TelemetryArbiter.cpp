@@ -0,0 +1,195 @@
+/*
+ * NOCTURNE_OS — telemetry arbitration across sources, with staleness and age metrics.
+ */
+#include "TelemetryArbiter.h"
+#include <cstring>
+
+/* Max age per source/signal: ~3 normal intervals. OBD: RPM/speed polled 10-35/s, temperatures every 2 s
+ * (ObdClient.h). IKE: 0x18 about every 2 s while driving, 0x19 on change / every ~10 s. Forza: 60 Hz.
+ * Demo task: every 500 ms. 0 = not provided. */
+static const uint32_t kDefaultMaxAgeMs[TELEM_SRC_COUNT][TELEM_SIG_COUNT] = {
+    {1000, 1000, 6000, 6000},  /* OBD */
+    {6000, 6000, 30000, 0},    /* IKE */
+    {500, 500, 0, 0},          /* FORZA */
+    {2000, 2000, 2000, 2000},  /* DEMO */
+};
+/* Base confidence by resolution: IKE sends RPM / 100 and speed / 2. */
+static const uint8_t kDefaultConfidence[TELEM_SRC_COUNT][TELEM_SIG_COUNT] = {
+    {100, 100, 100, 100},
+    {60, 80, 80, 0},
+    {90, 90, 0, 0},
+    {30, 30, 30, 30},
+};
+static const int32_t kMin[TELEM_SIG_COUNT] = {0, 0, -40, -40};
+static const int32_t kMax[TELEM_SIG_COUNT] = {12000, 400, 215, 215};
+
+TelemetryArbiter::TelemetryArbiter() {
+  memset(slots_, 0, sizeof(slots_));
+  memcpy(maxAgeMs_, kDefaultMaxAgeMs, sizeof(maxAgeMs_));
+  memcpy(base_, kDefaultConfidence, sizeof(base_));
+  memset(current_, TELEM_SRC_NONE, sizeof(current_));
+  resetStats();
+}
+
+void TelemetryArbiter::setMaxAge(uint8_t source, uint8_t signal, uint32_t ms) {
+  if (source < TELEM_SRC_COUNT && signal < TELEM_SIG_COUNT)
+    maxAgeMs_[source][signal] = ms;
+}
+
+uint32_t TelemetryArbiter::maxAge(uint8_t source, uint8_t signal) const {
+  return source < TELEM_SRC_COUNT && signal < TELEM_SIG_COUNT ? maxAgeMs_[source][signal] : 0;
+}
+
+void TelemetryArbiter::setConfidence(uint8_t source, uint8_t signal, uint8_t base) {
+  if (source < TELEM_SRC_COUNT && signal < TELEM_SIG_COUNT)
+    base_[source][signal] = base > 100 ? 100 : base;
+}
+
+bool TelemetryArbiter::publish(uint8_t source, uint8_t signal, int32_t value, uint32_t sampleMs) {
+  if (source >= TELEM_SRC_COUNT || signal >= TELEM_SIG_COUNT)
+    return false;
+  Slot &s = slots_[source][signal];
+  if (maxAgeMs_[source][signal] == 0 || value < kMin[signal] || value > kMax[signal] ||
+      (s.has && (int32_t)(sampleMs - s.atMs) < 0)) {
+    rejected_[source]++;
+    return false;
+  }
+  s.value = value;
+  s.atMs = sampleMs;
+  s.has = true;
+  published_[source]++;
+  return true;
+}
+
+void TelemetryArbiter::drop(uint8_t source) {
+  if (source < TELEM_SRC_COUNT)
+    memset(slots_[source], 0, sizeof(slots_[source]));
+}
+
+TelemetryReading TelemetryArbiter::pick(uint8_t signal, uint32_t nowMs, uint8_t current) const {
+  TelemetryReading r;
+  if (signal >= TELEM_SIG_COUNT)
+    return r;
+  int best = -1, bestScore = -1, curScore = -1;
+  uint32_t bestAge = 0;
+  int newest = -1;
+  uint32_t newestAge = 0;
+  for (uint8_t src = 0; src < TELEM_SRC_COUNT; src++) {
+    const Slot &s = slots_[src][signal];
+    const uint32_t maxAge = maxAgeMs_[src][signal];
+    if (!s.has || maxAge == 0)
+      continue;
+    /* sampleMs may be a little ahead of now (estimated ECU sampling time): age 0. */
+    const uint32_t age = (int32_t)(nowMs - s.atMs) < 0 ? 0 : nowMs - s.atMs;
+    if (newest < 0 || age < newestAge) {
+      newest = src;
+      newestAge = age;
+    }
+    if (age > maxAge)
+      continue;
+    const int score = (int)((uint64_t)base_[src][signal] * (2 * (uint64_t)maxAge - age) / (2 * (uint64_t)maxAge));
+    if (src == current)
+      curScore = score;
+    if (score > bestScore || (score == bestScore && age < bestAge)) {
+      best = src;
+      bestScore = score;
+      bestAge = age;
+    }
+  }
+  if (best >= 0 && best != current && curScore >= 0 && bestScore < curScore + kSwitchMargin) {
+    best = current;
+    bestScore = curScore;
+  }
+  if (best >= 0) {
+    const Slot &s = slots_[best][signal];
+    r.value = s.value;
+    r.ageMs = (int32_t)(nowMs - s.atMs) < 0 ? 0 : nowMs - s.atMs;
+    r.source = (uint8_t)best;
+    r.confidence = (uint8_t)bestScore;
+    r.valid = true;
+  } else if (newest >= 0) {
+    r.value = slots_[newest][signal].value;
+    r.ageMs = newestAge;
+    r.source = (uint8_t)newest;
+  }
+  return r;
+}
+
+TelemetryReading TelemetryArbiter::peek(uint8_t signal, uint32_t nowMs) const {
+  return pick(signal, nowMs, signal < TELEM_SIG_COUNT ? current_[signal] : TELEM_SRC_NONE);
+}
+
+TelemetryReading TelemetryArbiter::read(uint8_t signal, uint32_t nowMs) {
+  const TelemetryReading r = peek(signal, nowMs);
+  if (signal >= TELEM_SIG_COUNT)
+    return r;
+  SignalStats &st = stats_[signal];
+  st.reads++;
+  if (!r.valid) {
+    st.staleReads++;
+    return r;
+  }
+  if (current_[signal] != TELEM_SRC_NONE && current_[signal] != r.source)
+    st.switches++;
+  current_[signal] = r.source;
+  if (r.ageMs > st.ageMaxMs)
+    st.ageMaxMs = r.ageMs;
+  st.ageSumMs += r.ageMs;
+  uint8_t b = 0;
+  while (b < kAgeBuckets - 1 && (1u << b) < r.ageMs)
+    b++;
+  st.ageHist[b]++;
+  return r;
+}
+
+uint32_t TelemetryArbiter::agePercentileMs(uint8_t signal, uint8_t q) const {
+  if (signal >= TELEM_SIG_COUNT)
+    return 0;
+  const SignalStats &st = stats_[signal];
+  const uint32_t n = st.reads - st.staleReads;
+  if (n == 0)
+    return 0;
+  const uint32_t target = (uint32_t)(((uint64_t)n * (q > 100 ? 100 : q) + 99) / 100);
+  uint32_t acc = 0;
+  for (uint8_t b = 0; b < kAgeBuckets; b++) {
+    acc += st.ageHist[b];
+    if (acc >= target && acc > 0) {
+      const uint32_t upper = b == kAgeBuckets - 1 ? st.ageMaxMs : (1u << b);
+      return upper < st.ageMaxMs ? upper : st.ageMaxMs;
+    }
+  }
+  return st.ageMaxMs;
+}
+
+uint32_t TelemetryArbiter::ageAvgMs(uint8_t signal) const {
+  if (signal >= TELEM_SIG_COUNT)
+    return 0;
+  const uint32_t n = stats_[signal].reads - stats_[signal].staleReads;
+  return n ? (uint32_t)(stats_[signal].ageSumMs / n) : 0;
+}
+
+void TelemetryArbiter::resetStats() {
+  memset(stats_, 0, sizeof(stats_));
+  memset(published_, 0, sizeof(published_));
+  memset(rejected_, 0, sizeof(rejected_));
+}
+
+const char *TelemetryArbiter::sourceName(uint8_t source) {
+  switch (source) {
+    case TELEM_SRC_OBD: return "OBD";
+    case TELEM_SRC_IKE: return "IKE";
+    case TELEM_SRC_FORZA: return "FRZ";
+    case TELEM_SRC_DEMO: return "DEMO";
+    default: return "--";
+  }
+}
+
+const char *TelemetryArbiter::signalName(uint8_t signal) {
+  switch (signal) {
+    case TELEM_SIG_RPM: return "rpm";
+    case TELEM_SIG_SPEED: return "speed";
+    case TELEM_SIG_COOLANT: return "coolant";
+    case TELEM_SIG_OIL: return "oil";
+    default: return "?";
+  }
+}
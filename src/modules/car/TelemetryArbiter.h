@@ -0,0 +1,94 @@
+/*
+ * NOCTURNE_OS — telemetry arbitration: one value per signal from OBD, I-Bus IKE, Forza and demo samples,
+ * by confidence that decays with age. read() records the age each consumer got; peek() does not.
+ */
+#ifndef NOCTURNE_TELEMETRY_ARBITER_H
+#define NOCTURNE_TELEMETRY_ARBITER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define TELEM_SIG_RPM 0
+#define TELEM_SIG_SPEED 1     /* km/h */
+#define TELEM_SIG_COOLANT 2   /* degC */
+#define TELEM_SIG_OIL 3       /* degC */
+#define TELEM_SIG_COUNT 4
+
+#define TELEM_SRC_OBD 0
+#define TELEM_SRC_IKE 1
+#define TELEM_SRC_FORZA 2
+#define TELEM_SRC_DEMO 3
+#define TELEM_SRC_COUNT 4
+#define TELEM_SRC_NONE 0xFF
+
+struct TelemetryReading {
+  int32_t value = 0;
+  uint32_t ageMs = 0;               /* now minus the sample time of value */
+  uint8_t source = TELEM_SRC_NONE;  /* TELEM_SRC_*; NONE = never published */
+  uint8_t confidence = 0;           /* 0..100, 0 when not valid */
+  bool valid = false;               /* from a fresh sample */
+};
+
+class TelemetryArbiter {
+ public:
+  /** Confidence another source needs over the one in use to take the signal (no flapping). */
+  static const uint8_t kSwitchMargin = 10;
+  /** Age histogram buckets: [0,1], (1,2], (2,4] ... (2^(n-2), inf) ms. */
+  static const uint8_t kAgeBuckets = 16;
+
+  struct SignalStats {
+    uint32_t reads;
+    uint32_t staleReads;      /* nothing fresh */
+    uint32_t switches;        /* source changed between two valid reads */
+    uint32_t ageMaxMs;
+    uint64_t ageSumMs;
+    uint32_t ageHist[kAgeBuckets];
+  };
+
+  TelemetryArbiter();
+
+  /** Maximum age of a source/signal pair; 0 = the source does not provide that signal. Confidence falls
+   *  linearly to half the base at this age; older samples are stale and take no part. */
+  void setMaxAge(uint8_t source, uint8_t signal, uint32_t ms);
+  uint32_t maxAge(uint8_t source, uint8_t signal) const;
+  void setConfidence(uint8_t source, uint8_t signal, uint8_t base);
+
+  /** Value measured at sampleMs. Rejected (false) if implausible, older than the stored sample or the
+   *  pair is not provided. */
+  bool publish(uint8_t source, uint8_t signal, int32_t value, uint32_t sampleMs);
+  /** Forget a source at once (OBD link lost, demo off) instead of waiting for its samples to go stale. */
+  void drop(uint8_t source);
+
+  TelemetryReading read(uint8_t signal, uint32_t nowMs);
+  TelemetryReading peek(uint8_t signal, uint32_t nowMs) const;
+
+  const SignalStats &stats(uint8_t signal) const { return stats_[signal < TELEM_SIG_COUNT ? signal : 0]; }
+  /** Upper bound of the bucket holding the q-th percentile (q 0..100) of read() ages. */
+  uint32_t agePercentileMs(uint8_t signal, uint8_t q) const;
+  uint32_t ageAvgMs(uint8_t signal) const;
+  uint32_t published(uint8_t source) const { return source < TELEM_SRC_COUNT ? published_[source] : 0; }
+  uint32_t rejected(uint8_t source) const { return source < TELEM_SRC_COUNT ? rejected_[source] : 0; }
+  void resetStats();
+
+  static const char *sourceName(uint8_t source);
+  static const char *signalName(uint8_t signal);
+
+ private:
+  struct Slot {
+    int32_t value;
+    uint32_t atMs;
+    bool has;
+  };
+
+  TelemetryReading pick(uint8_t signal, uint32_t nowMs, uint8_t current) const;
+
+  Slot slots_[TELEM_SRC_COUNT][TELEM_SIG_COUNT];
+  uint32_t maxAgeMs_[TELEM_SRC_COUNT][TELEM_SIG_COUNT];
+  uint8_t base_[TELEM_SRC_COUNT][TELEM_SIG_COUNT];
+  uint8_t current_[TELEM_SIG_COUNT];
+  SignalStats stats_[TELEM_SIG_COUNT];
+  uint32_t published_[TELEM_SRC_COUNT];
+  uint32_t rejected_[TELEM_SRC_COUNT];
+};
+
+#endif
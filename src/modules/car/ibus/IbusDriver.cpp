@@ -11,10 +11,14 @@ IbusDriver::IbusDriver()
     : serial_(nullptr),
       begun_(false),
       synced_(false),
-      userHandler_(nullptr) {
+      userHandler_(nullptr),
+      txDoneCb_(nullptr),
+      txTag_(0),
+      txTagWrites_(0) {
 #if NOCT_IBUS_ENABLED
   rxQueue_ = nullptr;
   txQueue_ = nullptr;
+  doneQueue_ = nullptr;
   mutex_ = nullptr;
   taskReadHandle_ = nullptr;
   taskWriteHandle_ = nullptr;
@@ -67,16 +71,51 @@ void IbusDriver::taskReadLoop() {
   }
 }
 
+/* One packet: wait (mutex released) while the bus is busy, re-queue after a collision. */
+bool IbusDriver::sendWithRetry(const IbusTxItem &item) {
+  for (uint8_t attempt = 0; attempt < kTxAttempts; attempt++) {
+    if (mutex_ == nullptr || xSemaphoreTake(mutex_, pdMS_TO_TICKS(20)) != pdTRUE)
+      continue;
+    ibus_.write(item.data, item.len);
+    IbusTxResult r = ibus_.runSendNext();
+    xSemaphoreGive(mutex_);
+    const uint32_t startMs = millis();
+    while (r == IBUS_TX_DEFERRED && millis() - startMs < kTxDeferMaxMs) {
+      vTaskDelay(pdMS_TO_TICKS(2));
+      if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(20)) != pdTRUE)
+        continue;
+      r = ibus_.runSendNext();
+      xSemaphoreGive(mutex_);
+    }
+    if (r == IBUS_TX_SENT)
+      return true;
+    if (r == IBUS_TX_DEFERRED) {
+      /* Bus never went quiet: drop the packet so it is not sent late with the next one. */
+      if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(20)) == pdTRUE) {
+        ibus_.abortPending();
+        xSemaphoreGive(mutex_);
+      }
+      return false;
+    }
+    /* Collision: let the other node finish its frame (~10 ms at 9600) before re-queueing. */
+    vTaskDelay(pdMS_TO_TICKS(10 * (attempt + 1)));
+  }
+  return false;
+}
+
 void IbusDriver::taskWriteLoop() {
   IbusTxItem item;
   for (;;) {
     /* Wait for next TX packet (blocking OK here); mutex take is bounded. */
     if (txQueue_ != nullptr && xQueueReceive(txQueue_, &item, portMAX_DELAY) == pdTRUE) {
-      if (item.len > 0 && item.len <= IBUS_PACKET_MAX && mutex_ != nullptr &&
-          xSemaphoreTake(mutex_, pdMS_TO_TICKS(20)) == pdTRUE) {
-        ibus_.write(item.data, item.len);
-        ibus_.runSendNext();
-        xSemaphoreGive(mutex_);
+      if (item.len == 0 || item.len > IBUS_PACKET_MAX)
+        continue;
+      bool ok = sendWithRetry(item);
+      if (item.tag != 0 && doneQueue_ != nullptr) {
+        IbusTxDone d = {item.tag, ok};
+        /* A lost DONE would time out and the caller could resend a command the car already got. */
+        if (xQueueSend(doneQueue_, &d, pdMS_TO_TICKS(kTxDoneWaitMs)) != pdTRUE)
+          txDoneLost_++;
       }
     }
   }
@@ -103,8 +142,10 @@ void IbusDriver::begin(int txPin, int rxPin) {
 #if NOCT_IBUS_ENABLED
   rxQueue_ = xQueueCreate(IBUS_RX_QUEUE_LEN, sizeof(IbusRxItem));
   txQueue_ = xQueueCreate(IBUS_TX_QUEUE_LEN, sizeof(IbusTxItem));
+  /* Every queued message plus the one the write task holds can report before tick() drains. */
+  doneQueue_ = xQueueCreate(IBUS_TX_QUEUE_LEN + 1, sizeof(IbusTxDone));
   mutex_ = xSemaphoreCreateMutex();
-  if (rxQueue_ && txQueue_ && mutex_) {
+  if (rxQueue_ && txQueue_ && doneQueue_ && mutex_) {
     ibus_.setPacketHandler(onPacketToRxQueue);
     xTaskCreate(taskReadEntry, "ibus_rx", 2048, this, 2, &taskReadHandle_);
     xTaskCreate(taskWriteEntry, "ibus_tx", 2048, this, 2, &taskWriteHandle_);
@@ -139,6 +180,10 @@ void IbusDriver::end() {
     vQueueDelete(txQueue_);
     txQueue_ = nullptr;
   }
+  if (doneQueue_ != nullptr) {
+    vQueueDelete(doneQueue_);
+    doneQueue_ = nullptr;
+  }
   if (mutex_ != nullptr) {
     vSemaphoreDelete(mutex_);
     mutex_ = nullptr;
@@ -162,24 +207,77 @@ void IbusDriver::tick() {
         userHandler_(item.data);
     }
   }
+  if (doneQueue_) {
+    IbusTxDone d;
+    while (xQueueReceive(doneQueue_, &d, 0) == pdTRUE) {
+      if (txDoneCb_)
+        txDoneCb_(d.tag, d.ok);
+    }
+  }
 #else
   ibus_.run();
 #endif
 }
 
-void IbusDriver::write(const uint8_t *data, uint8_t len) {
+bool IbusDriver::post(const uint8_t *data, uint8_t len, uint16_t tag) {
   if (!begun_ || !data || len == 0)
-    return;
+    return false;
 #if NOCT_IBUS_ENABLED
-  if (txQueue_ != nullptr && len <= IBUS_PACKET_MAX) {
-    IbusTxItem item;
-    item.len = len;
-    memcpy(item.data, data, len);
-    xQueueSend(txQueue_, &item, 0);
-  }
+  if (txQueue_ == nullptr || len > IBUS_PACKET_MAX)
+    return false;
+  IbusTxItem item;
+  item.tag = tag;
+  item.len = len;
+  memcpy(item.data, data, len);
+  if (xQueueSend(txQueue_, &item, 0) != pdTRUE)
+    return false;
 #else
+  /* No write task reports TX results: tagged writes are not counted, the command completes when queued. */
+  (void)tag;
   ibus_.write(data, len);
 #endif
+  return true;
+}
+
+bool IbusDriver::write(const uint8_t *data, uint8_t len) {
+  const uint16_t tag = txTag_;
+  if (!post(data, len, tag))
+    return false;
+#if NOCT_IBUS_ENABLED
+  if (tag != 0)
+    txTagWrites_++;
+#endif
+  return true;
+}
+
+bool IbusDriver::writeUntagged(const uint8_t *data, uint8_t len) {
+  return post(data, len, 0);
+}
+
+void IbusDriver::beginTag(uint16_t tag) {
+  txTag_ = tag;
+  txTagWrites_ = 0;
+}
+
+uint8_t IbusDriver::endTag() {
+  uint8_t n = txTagWrites_;
+  txTag_ = 0;
+  txTagWrites_ = 0;
+  return n;
+}
+
+uint8_t IbusDriver::txQueueFree() const {
+#if NOCT_IBUS_ENABLED
+  if (txQueue_ != nullptr)
+    return (uint8_t)uxQueueSpacesAvailable(txQueue_);
+  return 0;
+#else
+  return IBUS_TX_QUEUE_LEN;
+#endif
+}
+
+void IbusDriver::setTxDoneCallback(void (*cb)(uint16_t tag, bool ok)) {
+  txDoneCb_ = cb;
 }
 
 void IbusDriver::setPacketHandler(void (*handler)(uint8_t *packet)) {
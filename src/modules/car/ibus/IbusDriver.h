@@ -6,6 +6,7 @@
 #define NOCTURNE_IBUS_DRIVER_H
 
 #include <Arduino.h>
+#include <atomic>
 #include "nocturne/config.h"
 #include "IbusSerial.h"
 #include "IbusDefines.h"
@@ -26,11 +27,17 @@ struct IbusRxItem {
   uint8_t len;
   uint8_t data[IBUS_PACKET_MAX];
 };
-/** One message to send (for tx_queue); checksum added by sender task. */
+/** One message to send (for tx_queue); checksum added by sender task. tag != 0: report completion. */
 struct IbusTxItem {
+  uint16_t tag;
   uint8_t len;
   uint8_t data[IBUS_PACKET_MAX];
 };
+/** TX outcome of a tagged message (for done_queue). */
+struct IbusTxDone {
+  uint16_t tag;
+  bool ok;
+};
 
 class IbusDriver {
  public:
@@ -40,8 +47,18 @@ class IbusDriver {
   void end();
   /** Call every loop. When using FreeRTOS: drains rx_queue and calls packet handler for each; otherwise runs ibus_.run(). */
   void tick();
-  /** Send raw message (checksum added by IbusSerial). When FreeRTOS: posts to tx_queue. */
-  void write(const uint8_t *data, uint8_t len);
+  /** Send raw message (checksum added by IbusSerial). When FreeRTOS: posts to tx_queue. False if dropped (queue full). */
+  bool write(const uint8_t *data, uint8_t len);
+  /** write() that is never tagged: for other tasks (sequence runner) while the main loop may be tagging. */
+  bool writeUntagged(const uint8_t *data, uint8_t len);
+  /** Tag every write() until endTag() so its TX result reaches the tx-done callback. Main loop only. */
+  void beginTag(uint16_t tag);
+  /** Stop tagging; returns how many tagged messages were queued. */
+  uint8_t endTag();
+  /** Free tx_queue slots (callers that need N frames queued atomically check this first). */
+  uint8_t txQueueFree() const;
+  /** Called from tick() for each tagged message: ok = sent on the bus, !ok = given up after retries. */
+  void setTxDoneCallback(void (*cb)(uint16_t tag, bool ok));
   /** Set callback for each received packet: packet[0]=src, [1]=len, [2]=dest, ... */
   void setPacketHandler(void (*handler)(uint8_t *packet));
   bool isSynced() const { return synced_; }
@@ -51,6 +68,8 @@ class IbusDriver {
   uint32_t getTxCount() const { return ibus_.getTxCount(); }
   uint32_t getErrorCount() const { return ibus_.getErrorCount(); }
   uint32_t getCollisionCount() const { return ibus_.getCollisionCount(); }
+  /** Tagged TX results that could not be queued for tick() (the callback never saw them). */
+  uint32_t getTxDoneLost() const { return txDoneLost_.load(); }
 
 #if NOCT_IBUS_ENABLED
   /** Called from packet handler to enqueue received packet (used by tasks). */
@@ -58,7 +77,7 @@ class IbusDriver {
   /** For FreeRTOS Read task: run parser only. */
   void runRead() { ibus_.runRead(); }
   /** For FreeRTOS Write task: try send one packet from internal TX buffer. */
-  void runSendNext() { ibus_.runSendNext(); }
+  IbusTxResult runSendNext() { return ibus_.runSendNext(); }
 #endif
 
  private:
@@ -69,18 +88,31 @@ class IbusDriver {
   static void taskWriteEntry(void *pv);
   void taskReadLoop();
   void taskWriteLoop();
+  bool sendWithRetry(const IbusTxItem &item);
 #endif
+  bool post(const uint8_t *data, uint8_t len, uint16_t tag);
 
   HardwareSerial *serial_;
   IbusSerial ibus_;
   bool begun_;
   bool synced_;
   void (*userHandler_)(uint8_t *packet);
+  void (*txDoneCb_)(uint16_t tag, bool ok);
+  uint16_t txTag_;
+  uint8_t txTagWrites_;
+  std::atomic<uint32_t> txDoneLost_{0};
   static IbusDriver *instance_;
 
+  /** Write task: collision retries, and how long a packet may wait for a silent bus. */
+  static const uint8_t kTxAttempts = 3;
+  static const uint32_t kTxDeferMaxMs = 100;
+  /** How long the write task waits for tick() to make room for a TX result before dropping it. */
+  static const uint32_t kTxDoneWaitMs = 200;
+
 #if NOCT_IBUS_ENABLED
   QueueHandle_t rxQueue_;
   QueueHandle_t txQueue_;
+  QueueHandle_t doneQueue_;
   SemaphoreHandle_t mutex_;
   TaskHandle_t taskReadHandle_;
   TaskHandle_t taskWriteHandle_;
@@ -125,28 +125,28 @@ void IbusSerial::write(const uint8_t *message, uint8_t size) {
   txBuffer_->write(checksum);
 }
 
-void IbusSerial::sendNextPacket() {
+IbusTxResult IbusSerial::sendNextPacket() {
   if (!ibusSerial_ || !txBuffer_ || txBuffer_->available() < 2)
-    return;
+    return IBUS_TX_IDLE;
   const unsigned long now = millis();
   /* Strict RTOS: only TX when bus silent >= 5 ms. */
   if ((now - lastRxMs_) < kPacketGapMs)
-    return;
+    return IBUS_TX_DEFERRED;
   /* Abort TX queue immediately if any RX data (bus not silent). */
   if (ibusSerial_->available() > 0) {
     collisionCount_++;
     clearTxQueue();
-    return;
+    return IBUS_TX_COLLISION;
   }
 
   const int lenByte = txBuffer_->read();
   if (lenByte <= 0 || lenByte > 40)
-    return;
+    return IBUS_TX_IDLE;
   uint8_t buf[40];
   for (int i = 0; i < lenByte; i++) {
     const int b = txBuffer_->read();
     if (b < 0)
-      return;
+      return IBUS_TX_IDLE;
     buf[i] = (uint8_t)b;
   }
 #if (NOCT_IBUS_MONITOR_VERBOSE || NOCT_BMW_DEBUG)
@@ -159,6 +159,7 @@ void IbusSerial::sendNextPacket() {
   ibusSerial_->write(buf, (size_t)lenByte);
   txCount_++;
   lastTxMs_ = now;
+  return IBUS_TX_SENT;
 }
 
 uint8_t IbusSerial::calculateChecksum(const uint8_t *data, uint8_t length) {
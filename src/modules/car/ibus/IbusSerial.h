@@ -9,6 +9,14 @@
 #include "Arduino.h"
 #include "RingBuffer.h"
 
+/** Outcome of one send attempt. */
+enum IbusTxResult : uint8_t {
+  IBUS_TX_IDLE = 0,   /* nothing buffered */
+  IBUS_TX_SENT,       /* one packet written to the UART */
+  IBUS_TX_DEFERRED,   /* bus not silent long enough; packet stays buffered */
+  IBUS_TX_COLLISION   /* RX activity right before send; TX buffer cleared */
+};
+
 class IbusSerial {
  public:
   IbusSerial();
@@ -17,7 +25,9 @@ class IbusSerial {
   /** Called from Task_IBus_Read when using FreeRTOS. */
   void runRead() { readIbus(); }
   /** Called from Task_IBus_Write when using FreeRTOS (one packet send attempt). */
-  void runSendNext() { sendNextPacket(); }
+  IbusTxResult runSendNext() { return sendNextPacket(); }
+  /** Drop everything still buffered for TX (caller gave up on the packet). */
+  void abortPending() { clearTxQueue(); }
   void write(const uint8_t *message, uint8_t size);
   void setPacketHandler(void (*handler)(uint8_t *packet));
   uint8_t calculateChecksum(const uint8_t *data, uint8_t length);
@@ -38,7 +48,7 @@ class IbusSerial {
   };
 
   void readIbus();
-  void sendNextPacket();
+  IbusTxResult sendNextPacket();
   /** Abort TX queue when bus is not silent (collision avoidance). */
   void clearTxQueue();
 
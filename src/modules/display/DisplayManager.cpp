@@ -77,32 +77,28 @@ void DisplayManager::drawFrame(unsigned long nowMs) {
   line2[0] = '\0';
 
   const char *feedback = bmw_.getLastActionFeedback();
+  const TelemetryReading rpm = bmw_.telemetry(TELEM_SIG_RPM);
+  TelemetryReading temp = bmw_.telemetry(TELEM_SIG_COOLANT);
+  if (!temp.valid)
+    temp = bmw_.telemetry(TELEM_SIG_OIL);
   if (feedback && feedback[0]) {
     strncpy(line1, feedback, DATA_MAX_CHARS);
     line1[DATA_MAX_CHARS] = '\0';
-    /* Optional second line: OBD/IKE data when available */
-    if (bmw_.isObdConnected()) {
-      int rpm = bmw_.getObdRpm();
-      int cool = bmw_.getObdCoolantTempC();
-      int oil = bmw_.getObdOilTempC();
-      if (rpm > 0 || cool >= 0 || oil >= 0)
-        snprintf(line2, sizeof(line2), "RPM:%d T:%d", rpm, cool >= 0 ? cool : oil);
-    } else if (bmw_.getIkeCoolantC() > -128) {
-      snprintf(line2, sizeof(line2), "TEMP:%dC", bmw_.getIkeCoolantC());
-    }
+    /* Optional second line: engine data from whichever source is fresh (OBD, IKE, demo) */
+    if (rpm.valid)
+      snprintf(line2, sizeof(line2), "RPM:%d T:%d", (int)rpm.value, temp.valid ? (int)temp.value : 0);
+    else if (temp.valid)
+      snprintf(line2, sizeof(line2), "TEMP:%dC", (int)temp.value);
   } else {
     if (!bmw_.isIbusSynced()) {
       strncpy(line1, "I-Bus: connect", sizeof(line1) - 1);
       line1[sizeof(line1) - 1] = '\0';
-    } else if (bmw_.isObdConnected()) {
-      int rpm = bmw_.getObdRpm();
-      int cool = bmw_.getObdCoolantTempC();
-      int oil = bmw_.getObdOilTempC();
-      snprintf(line1, sizeof(line1), "RPM:%d", rpm);
-      if (cool >= 0 || oil >= 0)
-        snprintf(line2, sizeof(line2), "TEMP:%dC", cool >= 0 ? cool : oil);
-    } else if (bmw_.getIkeCoolantC() > -128) {
-      snprintf(line1, sizeof(line1), "TEMP:%dC", bmw_.getIkeCoolantC());
+    } else if (rpm.valid) {
+      snprintf(line1, sizeof(line1), "RPM:%d", (int)rpm.value);
+      if (temp.valid)
+        snprintf(line2, sizeof(line2), "TEMP:%dC", (int)temp.value);
+    } else if (temp.valid) {
+      snprintf(line1, sizeof(line1), "TEMP:%dC", (int)temp.value);
     } else if (bmw_.getIgnitionState() >= 0) {
       snprintf(line1, sizeof(line1), "IGN:%d", bmw_.getIgnitionState());
     } else if (bmw_.hasPdcData()) {
@@ -0,0 +1,78 @@
+/*
+ * NOCTURNE_OS — RedrawGate: scene → field map and the draw decision.
+ */
+#include "RedrawGate.h"
+#include "nocturne/config.h"
+#include <initializer_list>
+
+namespace {
+
+FieldMask bits(std::initializer_list<StateField> fields)
+{
+  FieldMask m = 0;
+  for (StateField f : fields)
+    m |= fieldBit(f);
+  return m;
+}
+
+} // namespace
+
+FieldMask RedrawGate::sceneFields(int scene)
+{
+  /* Header (battery) and alert blink/target on every scene. Keep in step with SceneManager::draw*. */
+  static const FieldMask kCommon = bits({SF_BATTERY, SF_ALERT});
+  static const FieldMask kScenes[NOCT_TOTAL_SCENES] = {
+      /* MAIN */ bits({SF_CT, SF_GT, SF_CL, SF_GL, SF_RU, SF_RA}),
+      /* CPU */ bits({SF_CT, SF_CC, SF_CL, SF_PW}),
+      /* GPU */ bits({SF_GH, SF_GCLOCK, SF_GL, SF_VU}),
+      /* RAM */ bits({SF_TOP_RAM, SF_RU, SF_RA}),
+      /* DISKS */ bits({SF_HDD}),
+      /* MEDIA */ bits({SF_ARTIST, SF_TRACK, SF_MEDIA_STATE}),
+      /* FANS */ bits({SF_CF, SF_S1, SF_GF, SF_S2, SF_FAN_CONTROLS}),
+      /* MOTHERBOARD */ bits({SF_MB_SYS, SF_MB_VSOC, SF_MB_VRM, SF_MB_CHIPSET}),
+      /* WEATHER */ bits({SF_WEATHER}),
+  };
+  /* The selected host's part of the overview; other hosts' changes invalidate (MonitorHosts::takeChanged). */
+  if (scene == NOCT_SCENE_HOSTS)
+    return kCommon | bits({SF_CT, SF_GT, SF_CL, SF_GL});
+  /* Unknown index: SceneManager falls back to MAIN. */
+  const FieldMask sceneBits = (scene >= 0 && scene < NOCT_TOTAL_SCENES) ? kScenes[scene] : kScenes[0];
+  return kCommon | sceneBits;
+}
+
+bool RedrawGate::shouldDraw(int scene, uint32_t animPhase)
+{
+  const bool draw = force_ || scene != scene_ || animPhase != phase_ || (pending_ & sceneFields(scene));
+  /* Bits of other scenes are dropped too: switching scenes draws anyway. */
+  pending_ = 0;
+  force_ = false;
+  scene_ = scene;
+  phase_ = animPhase;
+  if (draw)
+  {
+    drawn_++;
+    windowDrawn_++;
+  }
+  else
+  {
+    skipped_++;
+    windowSkipped_++;
+  }
+  return draw;
+}
+
+bool RedrawGate::report(uint32_t nowMs, uint32_t *drawn, uint32_t *skipped)
+{
+  if (windowStartMs_ == 0)
+    windowStartMs_ = nowMs;
+  if (nowMs - windowStartMs_ < kReportMs)
+    return false;
+  if (drawn)
+    *drawn = windowDrawn_;
+  if (skipped)
+    *skipped = windowSkipped_;
+  windowStartMs_ = nowMs;
+  windowDrawn_ = 0;
+  windowSkipped_ = 0;
+  return true;
+}
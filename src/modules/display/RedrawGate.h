@@ -0,0 +1,48 @@
+/*
+ * NOCTURNE_OS — RedrawGate: per GUI tick, whether a PC monitoring scene must be drawn again (a visible
+ * StateField changed, an animation is due, the scene changed or the caller invalidated).
+ */
+#ifndef NOCTURNE_REDRAW_GATE_H
+#define NOCTURNE_REDRAW_GATE_H
+
+#include <stdint.h>
+#include "nocturne/StateFields.h"
+
+class RedrawGate
+{
+public:
+  /** One full SSD1306 128x64 frame as U8g2's HW I2C driver sends it: 8 pages, each a command
+   * transfer (address + control + 3 commands) and 128 data bytes in 32-byte transfers
+   * (address + control + 32). */
+  static const uint32_t kFrameI2cBytes = 8 * (5 + 4 * (2 + 32));
+  static const uint32_t kReportMs = 60000;
+
+  /** StateField bits scene (NOCT_SCENE_*) displays, header included. */
+  static FieldMask sceneFields(int scene);
+
+  void markChanged(FieldMask fields) { pending_ |= fields; }
+  /** The next frame draws: something outside AppState changed or another screen was shown. */
+  void invalidate() { force_ = true; }
+  /** GUI tick on a data scene. animPhase: any value that changes whenever an animation on screen
+   * must advance. True = draw this frame. */
+  bool shouldDraw(int scene, uint32_t animPhase);
+
+  uint32_t drawn() const { return drawn_; }
+  uint32_t skipped() const { return skipped_; }
+  uint64_t i2cBytesSaved() const { return (uint64_t)skipped_ * kFrameI2cBytes; }
+  /** Once per kReportMs: frames drawn and skipped in the window that just closed. */
+  bool report(uint32_t nowMs, uint32_t *drawn, uint32_t *skipped);
+
+private:
+  FieldMask pending_ = 0;
+  bool force_ = true;
+  int scene_ = -1;
+  uint32_t phase_ = 0;
+  uint32_t drawn_ = 0;
+  uint32_t skipped_ = 0;
+  uint32_t windowStartMs_ = 0;
+  uint32_t windowDrawn_ = 0;
+  uint32_t windowSkipped_ = 0;
+};
+
+#endif
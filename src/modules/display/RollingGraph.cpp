@@ -3,7 +3,7 @@
  */
 #include "RollingGraph.h"
 
-RollingGraph::RollingGraph() : head(0), count(0), maxVal(100) {
+RollingGraph::RollingGraph() : count(0), maxVal(100), head(0) {
   for (int i = 0; i < NOCT_GRAPH_SAMPLES; i++)
     values[i] = 0.0f;
 }
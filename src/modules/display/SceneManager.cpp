@@ -1,5 +1,5 @@
 /*
- * NOCTURNE_OS — SceneManager: 9 screens. 128x64,
+ * NOCTURNE_OS — SceneManager: 9 screens (+ HOSTS with several PCs). 128x64,
  * MAIN/CPU/GPU/RAM/DISKS/MEDIA/FANS/MB/NET. Unified: LABEL_FONT only for
  * content; Y from NOCT_CONTENT_TOP, NOCT_ROW_DY.
  */
@@ -7,6 +7,7 @@
 #include "nocturne/config.h"
 #include "MenuHandler.h"
 #include "BmwManager.h"
+#include "MonitorHosts.h"
 #include <Arduino.h>
 #include <WiFi.h>
 #include <math.h>
@@ -186,8 +187,15 @@ const char *SceneManager::sceneNames_[] = {
 SceneManager::SceneManager(DisplayEngine &disp, AppState &state)
     : disp_(disp), state_(state) {}
 
+int SceneManager::totalScenes() const
+{
+  return hosts_ && hosts_->count() > 1 ? NOCT_TOTAL_SCENES + 1 : NOCT_TOTAL_SCENES;
+}
+
 const char *SceneManager::getSceneName(int sceneIndex) const
 {
+  if (sceneIndex == NOCT_SCENE_HOSTS)
+    return "HOSTS";
   if (sceneIndex < 0 || sceneIndex >= NOCT_TOTAL_SCENES)
     return "MAIN";
   return sceneNames_[sceneIndex];
@@ -234,6 +242,9 @@ void SceneManager::drawWithOffset(int sceneIndex, int xOffset,
   case NOCT_SCENE_WEATHER:
     drawWeather(xOffset);
     break;
+  case NOCT_SCENE_HOSTS:
+    drawHosts(millis(), xOffset);
+    break;
   default:
     drawMain(blinkState, xOffset);
     break;
@@ -490,10 +501,9 @@ void SceneManager::drawRam(bool blinkState, int xOff)
     disp_.drawTechBracket(bx, by, RAM_ROW_W, RAM_ROW_H, RAM_BRACKET_LEN);
 
     int baselineY = rowY + 11; /* Text baseline within bracket (6x12) */
-    String name = proc.ramNames[i];
+    FixedString<RAM_MAX_NAMELEN> name;
+    name.assign(proc.ramNames[i]);
     int mb = proc.ramMb[i];
-    if (name.length() > (unsigned)RAM_MAX_NAMELEN)
-      name = name.substring(0, RAM_MAX_NAMELEN);
     name.toUpperCase();
 
     u8g2.setFont(VALUE_FONT);
@@ -773,6 +783,82 @@ void SceneManager::drawWeather(int xOff)
   disp_.drawGreebles();
 }
 
+// ---------------------------------------------------------------------------
+// SCENE 10: HOSTS (several PCs) — hottest CPU/GPU and busiest CPU/GPU across
+// the hosts with data, each with its host; below, one row per host (loads,
+// CPU/GPU temps), paged every NOCT_HOSTS_PAGE_MS. '>' marks the selected host.
+// ---------------------------------------------------------------------------
+#define HOSTS_ROW_DY LINE_HEIGHT_TINY
+#define HOSTS_SUM_Y (NOCT_CONTENT_TOP + BASELINE_OFFSET_TINY)
+#define HOSTS_SEP_Y (HOSTS_SUM_Y + HOSTS_ROW_DY + 3)
+#define HOSTS_LIST_Y (HOSTS_SEP_Y + BASELINE_OFFSET_TINY + 2)
+#define HOSTS_ROWS 3
+#define HOSTS_COL2_X 66
+#define HOSTS_NAME_X 6
+#define HOSTS_CL_X 46
+#define HOSTS_GL_X 70
+#define HOSTS_TEMP_X 94
+
+void SceneManager::drawHosts(unsigned long now, int xOff)
+{
+  U8G2_SSD1306_128X64_NONAME_F_HW_I2C &u8g2 = disp_.u8g2();
+  u8g2.setDrawColor(1);
+  u8g2.setFontMode(1);
+  u8g2.setBitmapMode(0);
+  u8g2.setFont(LABEL_FONT);
+
+  if (!hosts_ || hosts_->count() == 0)
+  {
+    drawNoDataCross(X(NOCT_CARD_LEFT, xOff), NOCT_CONTENT_TOP,
+                    NOCT_DISP_W - 2 * NOCT_CARD_LEFT, NOCT_DISP_H - NOCT_CONTENT_TOP - 2);
+    disp_.drawGreebles();
+    return;
+  }
+
+  const HostOverview o = hosts_->overview((uint32_t)now);
+  static char buf[24];
+  if (o.live == 0)
+  {
+    u8g2.drawUTF8(X(NOCT_CARD_LEFT, xOff), HOSTS_SUM_Y, "NO HOST ONLINE");
+  }
+  else
+  {
+    snprintf(buf, sizeof(buf), "CPU %d\xC2\xB0 %.4s", o.cpuTemp, hosts_->host(o.cpuTempHost).name);
+    u8g2.drawUTF8(X(NOCT_CARD_LEFT, xOff), HOSTS_SUM_Y, buf);
+    snprintf(buf, sizeof(buf), "GPU %d\xC2\xB0 %.4s", o.gpuTemp, hosts_->host(o.gpuTempHost).name);
+    u8g2.drawUTF8(X(HOSTS_COL2_X, xOff), HOSTS_SUM_Y, buf);
+    snprintf(buf, sizeof(buf), "CL %d%% %.4s", o.cpuLoad, hosts_->host(o.cpuLoadHost).name);
+    u8g2.drawUTF8(X(NOCT_CARD_LEFT, xOff), HOSTS_SUM_Y + HOSTS_ROW_DY, buf);
+    snprintf(buf, sizeof(buf), "GL %d%% %.4s", o.gpuLoad, hosts_->host(o.gpuLoadHost).name);
+    u8g2.drawUTF8(X(HOSTS_COL2_X, xOff), HOSTS_SUM_Y + HOSTS_ROW_DY, buf);
+  }
+  disp_.drawDottedHLine(X(0, xOff), X(NOCT_DISP_W - 1, xOff), HOSTS_SEP_Y);
+
+  const int pages = (hosts_->count() + HOSTS_ROWS - 1) / HOSTS_ROWS;
+  const int first = (int)((now / NOCT_HOSTS_PAGE_MS) % (unsigned long)pages) * HOSTS_ROWS;
+  for (int r = 0; r < HOSTS_ROWS && first + r < hosts_->count(); r++)
+  {
+    const int i = first + r;
+    const HostSlot &h = hosts_->host(i);
+    const int y = HOSTS_LIST_Y + r * HOSTS_ROW_DY;
+    if (i == hosts_->selected())
+      u8g2.drawUTF8(X(0, xOff), y, ">");
+    u8g2.drawUTF8(X(HOSTS_NAME_X, xOff), y, h.name);
+    if (!h.firstData || !h.linkUp() || h.signalLost((uint32_t)now))
+    {
+      u8g2.drawUTF8(X(HOSTS_CL_X, xOff), y, h.linkUp() ? "LOST" : "DOWN");
+      continue;
+    }
+    snprintf(buf, sizeof(buf), "%d%%", h.cl);
+    u8g2.drawUTF8(X(HOSTS_CL_X, xOff), y, buf);
+    snprintf(buf, sizeof(buf), "%d%%", h.gl);
+    u8g2.drawUTF8(X(HOSTS_GL_X, xOff), y, buf);
+    snprintf(buf, sizeof(buf), "%d/%d", h.ct, h.gt);
+    u8g2.drawUTF8(X(HOSTS_TEMP_X, xOff), y, buf);
+  }
+  disp_.drawGreebles();
+}
+
 // ---------------------------------------------------------------------------
 // SCENE 6: MEDIA (Protocol Alpha Wolf) — Clip Y=NOCT_CONTENT_TOP(16) to
 // NOCT_DISP_H(64). Artist Y=32, Track Y=52.
@@ -780,6 +866,30 @@ void SceneManager::drawWeather(int xOff)
 #define PLAYER_ARTIST_Y 32
 #define PLAYER_TRACK_Y 52
 
+uint32_t SceneManager::animationPhase(int sceneIndex, unsigned long now)
+{
+  /* Periods as drawn: heartbeat 1000 ms (drawActiveIndicator), bolt 300 ms
+   * (drawPowerStatus), scroll 90 ms (drawPlayer, only for a line wider than
+   * the box). A sum of counters changes when any of them does. */
+  uint32_t phase = (uint32_t)(now / 1000);
+  if (state_.isCharging)
+    phase += (uint32_t)(now / 300);
+  if (sceneIndex == NOCT_SCENE_MEDIA)
+  {
+    U8G2_SSD1306_128X64_NONAME_F_HW_I2C &u8g2 = disp_.u8g2();
+    const int maxW = NOCT_DISP_W - 2 * NOCT_CARD_LEFT - 8;
+    u8g2.setFont(VALUE_FONT);
+    if (u8g2.getUTF8Width(state_.media.artist.c_str()) > maxW ||
+        u8g2.getUTF8Width(state_.media.track.c_str()) > maxW)
+      phase += (uint32_t)(now / 90);
+  }
+  /* Host rows page (drawHosts); a host's signal is lost without any data
+   * arriving, the heartbeat above redraws for that. */
+  if (sceneIndex == NOCT_SCENE_HOSTS && hosts_ && hosts_->count() > HOSTS_ROWS)
+    phase += (uint32_t)(now / NOCT_HOSTS_PAGE_MS);
+  return phase;
+}
+
 void SceneManager::drawPlayer(int xOff)
 {
   MediaData &media = state_.media;
@@ -801,24 +911,18 @@ void SceneManager::drawPlayer(int xOff)
   u8g2.drawUTF8(boxX + boxW - sw - 4, boxY + 7, status);
 
   u8g2.setFont(VALUE_FONT);
-  static char artistBuf[64];
-  static char trackBuf[64];
-  strncpy(artistBuf, media.artist.length() ? media.artist.c_str() : "-",
-          sizeof(artistBuf) - 1);
-  artistBuf[sizeof(artistBuf) - 1] = '\0';
-  strncpy(trackBuf, media.track.length() ? media.track.c_str() : "-",
-          sizeof(trackBuf) - 1);
-  trackBuf[sizeof(trackBuf) - 1] = '\0';
+  const char *artistStr = media.artist.empty() ? "-" : media.artist.c_str();
+  const char *trackStr = media.track.empty() ? "-" : media.track.c_str();
 
   int maxW = boxW - 8;
-  int aw = u8g2.getUTF8Width(artistBuf);
-  int tw = u8g2.getUTF8Width(trackBuf);
+  int aw = u8g2.getUTF8Width(artistStr);
+  int tw = u8g2.getUTF8Width(trackStr);
   unsigned long t = (unsigned long)millis() / 90;
   int scrollA = (aw > maxW) ? (int)(t % (unsigned long)(aw + 48)) : 0;
   int scrollT = (tw > maxW) ? (int)((t + 60) % (unsigned long)(tw + 48)) : 0;
   u8g2.setClipWindow(boxX + 4, NOCT_CONTENT_TOP, boxX + boxW - 4, NOCT_DISP_H);
-  u8g2.drawUTF8(boxX + 4 - scrollA, PLAYER_ARTIST_Y, artistBuf);
-  u8g2.drawUTF8(boxX + 4 - scrollT, PLAYER_TRACK_Y, trackBuf);
+  u8g2.drawUTF8(boxX + 4 - scrollA, PLAYER_ARTIST_Y, artistStr);
+  u8g2.drawUTF8(boxX + 4 - scrollT, PLAYER_TRACK_Y, trackStr);
   u8g2.setMaxClipWindow();
   disp_.drawGreebles();
 }
@@ -1714,16 +1818,17 @@ void SceneManager::drawBmwAssistant(BmwManager &bmw, int selectedActionIndex)
     buf[sizeof(buf) - 1] = '\0';
   } else {
     buf[0] = '\0';
+    const TelemetryReading rpm = bmw.telemetry(TELEM_SIG_RPM);
+    const TelemetryReading cool = bmw.telemetry(TELEM_SIG_COOLANT);
+    const TelemetryReading oil = bmw.telemetry(TELEM_SIG_OIL);
     if (!bmw.isIbusSynced()) {
       strncpy(buf, "I-Bus: connect", sizeof(buf) - 1);
       buf[sizeof(buf) - 1] = '\0';
-    } else if (bmw.isObdConnected()) {
-      int oil = bmw.getObdOilTempC();
-      int cool = bmw.getObdCoolantTempC();
-      if (oil >= 0 || cool >= 0)
-        snprintf(buf, sizeof(buf), "OBD OIL %d COOL %d", oil >= 0 ? oil : 0, cool >= 0 ? cool : 0);
-      else
-        snprintf(buf, sizeof(buf), "OBD RPM %d", bmw.getObdRpm());
+    } else if (oil.valid || cool.valid) {
+      snprintf(buf, sizeof(buf), "%s OIL %d COOL %d", TelemetryArbiter::sourceName(cool.valid ? cool.source : oil.source),
+               oil.valid ? (int)oil.value : 0, cool.valid ? (int)cool.value : 0);
+    } else if (rpm.valid) {
+      snprintf(buf, sizeof(buf), "%s RPM %d", TelemetryArbiter::sourceName(rpm.source), (int)rpm.value);
     } else if (bmw.getIgnitionState() >= 0) {
       snprintf(buf, sizeof(buf), "IGN %d", bmw.getIgnitionState());
     } else if (bmw.hasPdcData()) {
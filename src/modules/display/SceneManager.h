@@ -1,6 +1,7 @@
 /*
  * NOCTURNE_OS — SceneManager: conditional screens based on build profile.
- * Core: 9 PC monitoring screens, menu, charge-only, BMW assistant.
+ * Core: 9 PC monitoring screens (plus the hosts overview with several PCs),
+ * menu, charge-only, BMW assistant.
  * Optional: WiFi scanner, BLE spammer, Trap, Forza dash, WiFi sniff.
  */
 #ifndef NOCTURNE_SCENE_MANAGER_H
@@ -10,6 +11,8 @@
 #include "nocturne/config.h"
 #include "DisplayEngine.h"
 
+class MonitorHosts;
+
 class SceneManager
 {
 public:
@@ -19,7 +22,13 @@ public:
                       bool blinkState, int fanFrame);
 
   const char *getSceneName(int sceneIndex) const;
-  int totalScenes() const { return NOCT_TOTAL_SCENES; }
+  /** Changes whenever an animation on this scene must advance (header heartbeat, charging bolt,
+   * media scroll); RedrawGate redraws on a change. */
+  uint32_t animationPhase(int sceneIndex, unsigned long now);
+  /** Per-host scenes, then NOCT_SCENE_HOSTS when more than one host is set. */
+  int totalScenes() const;
+  /** Hosts the overview scene shows (NetManager::hosts()). */
+  void setHosts(const MonitorHosts *hosts) { hosts_ = hosts; }
 
   // --- 9 PC monitoring screens ---
   void drawMain(bool blinkState, int xOff = 0);
@@ -31,6 +40,7 @@ public:
   void drawFans(int fanFrame, int xOff = 0);
   void drawMotherboard(int xOff = 0);
   void drawWeather(int xOff = 0);
+  void drawHosts(unsigned long now, int xOff = 0);
 
   // --- Always available ---
   void drawSearchMode(int scanPhase);
@@ -80,6 +90,7 @@ private:
 
   DisplayEngine &disp_;
   AppState &state_;
+  const MonitorHosts *hosts_ = nullptr;
 };
 
 #endif
@@ -0,0 +1,159 @@
+/*
+ * NOCTURNE_OS — newline framing for the monitor TCP stream.
+ */
+#include "LineFramer.h"
+#include <cstring>
+
+static const char kBinaryAck[] = "BIN 1";
+static const uint8_t kFrameMagic = 0xB1; /* MonitorBinary::kMagic */
+static const size_t kFrameHeader = 3;
+
+bool LineFramer::pump(ReadFn read, void *ctx, ClockFn nowUs, uint32_t budgetUs) {
+  const uint32_t t0 = nowUs();
+  compact();
+  for (;;) {
+    if (len_ == kCap) {
+      compact();
+      if (len_ == kCap && hasLine_ && (binary_ || everyLine_ || tail_ == len_))
+        break; /* frames and partial lines are never dropped; exactly one maximum-size line: hand it out */
+      if (len_ == kCap && hasLine_) {
+        /* A newer line is already arriving behind the pending one: make room for it. */
+        superseded_++;
+        hasLine_ = false;
+        compact();
+      }
+      if (len_ == kCap) {
+        /* One unterminated line fills the buffer: drop it and skip to its newline. (A frame always
+         * fits: frameBinary() refuses longer ones.) */
+        oversized_++;
+        len_ = tail_ = lineStart_ = 0;
+        skipping_ = !binary_;
+      }
+    }
+    const size_t n = read(ctx, buf_ + len_, kCap - len_);
+    if (n == 0)
+      break;
+    bytes_ += n;
+    len_ += n;
+    frame(len_ - n);
+    if ((uint32_t)(nowUs() - t0) >= budgetUs) {
+      budgetStops_++;
+      break;
+    }
+  }
+  return hasLine_;
+}
+
+bool LineFramer::takeLine(char **line, size_t *len) {
+  if (!hasLine_)
+    return false;
+  lines_++;
+  if (binary_) {
+    const size_t n = (uint8_t)buf_[lineStart_ + 1] | (size_t)(uint8_t)buf_[lineStart_ + 2] << 8;
+    *line = buf_ + lineStart_ + kFrameHeader;
+    *len = n;
+    lineStart_ += kFrameHeader + n;
+    hasLine_ = lineStart_ < tail_;
+    return true;
+  }
+  hasLine_ = false;
+  buf_[lineStart_ + lineLen_] = '\0';
+  *line = buf_ + lineStart_;
+  *len = lineLen_;
+  if (everyLine_) {
+    /* The next non-empty complete line behind this one, if any, is pending now. */
+    size_t from = lineStart_ + lineLen_ + 1;
+    const char *nl;
+    while (from < tail_ && (nl = (const char *)memchr(buf_ + from, '\n', tail_ - from)) != nullptr) {
+      const size_t pos = (size_t)(nl - buf_);
+      if (pos > from) {
+        hasLine_ = true;
+        lineStart_ = from;
+        lineLen_ = pos - from;
+        break;
+      }
+      from = pos + 1;
+    }
+  }
+  return true;
+}
+
+void LineFramer::reset() {
+  len_ = tail_ = lineStart_ = lineLen_ = 0;
+  hasLine_ = false;
+  skipping_ = false;
+  binary_ = false;
+}
+
+void LineFramer::frame(size_t from) {
+  if (binary_) {
+    frameBinary();
+    return;
+  }
+  const char *p = buf_ + from;
+  const char *end = buf_ + len_;
+  const char *nl;
+  while ((nl = (const char *)memchr(p, '\n', (size_t)(end - p))) != nullptr) {
+    const size_t pos = (size_t)(nl - buf_);
+    if (skipping_) {
+      skipping_ = false;
+    } else if (pos - tail_ == sizeof(kBinaryAck) - 1 && memcmp(buf_ + tail_, kBinaryAck, pos - tail_) == 0) {
+      /* Server switched to frames: a JSON line still pending is older than its first keyframe. */
+      if (hasLine_)
+        superseded_++;
+      binary_ = true;
+      tail_ = lineStart_ = pos + 1;
+      hasLine_ = false;
+      frameBinary();
+      return;
+    } else if (pos > tail_ && everyLine_) {
+      /* Queued behind the pending line; takeLine() reaches it. */
+      if (!hasLine_) {
+        hasLine_ = true;
+        lineStart_ = tail_;
+        lineLen_ = pos - tail_;
+      }
+    } else if (pos > tail_) {
+      if (hasLine_)
+        superseded_++;
+      hasLine_ = true;
+      lineStart_ = tail_;
+      lineLen_ = pos - tail_;
+    }
+    tail_ = pos + 1;
+    p = nl + 1;
+  }
+}
+
+void LineFramer::frameBinary() {
+  while (len_ - tail_ >= kFrameHeader) {
+    const size_t n = (uint8_t)buf_[tail_ + 1] | (size_t)(uint8_t)buf_[tail_ + 2] << 8;
+    if ((uint8_t)buf_[tail_] != kFrameMagic || n > kCap - kFrameHeader) {
+      /* Not a frame start: cut the bytes out up to the next magic byte. */
+      const char *q = (const char *)memchr(buf_ + tail_ + 1, kFrameMagic, len_ - tail_ - 1);
+      const size_t skip = q ? (size_t)(q - buf_) - tail_ : len_ - tail_;
+      memmove(buf_ + tail_, buf_ + tail_ + skip, len_ - tail_ - skip);
+      len_ -= skip;
+      resyncBytes_ += (uint32_t)skip;
+      continue;
+    }
+    if (len_ - tail_ < kFrameHeader + n)
+      break;
+    tail_ += kFrameHeader + n;
+    hasLine_ = true;
+  }
+}
+
+/* Keep the pending line (if any) and the unterminated rest, moved to the front. */
+void LineFramer::compact() {
+  if (skipping_)
+    len_ = tail_;
+  const size_t keep = hasLine_ ? lineStart_ : tail_;
+  if (keep == 0)
+    return;
+  memmove(buf_, buf_ + keep, len_ - keep);
+  len_ -= keep;
+  tail_ -= keep;
+  if (hasLine_ || binary_)
+    lineStart_ -= keep;
+}
@@ -0,0 +1,68 @@
+/*
+ * NOCTURNE_OS — newline framing for the monitor TCP stream, in place in the receive buffer: the newest
+ * complete line, or every line with setEveryLine(); MonitorBinary frames after the line "BIN 1".
+ */
+#ifndef NOCTURNE_LINE_FRAMER_H
+#define NOCTURNE_LINE_FRAMER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "nocturne/config.h"
+
+class LineFramer {
+ public:
+  /** Longest accepted line is kCap - 1 bytes plus its newline (as the old per-byte buffer). */
+  static const size_t kCap = NOCT_TCP_LINE_MAX;
+
+  /** Read up to cap bytes into dst without blocking; 0 when nothing is pending. */
+  typedef size_t (*ReadFn)(void *ctx, char *dst, size_t cap);
+  typedef uint32_t (*ClockFn)();
+
+  /** Read until the source is empty or budgetUs has passed since the call. True if a line is ready. */
+  bool pump(ReadFn read, void *ctx, ClockFn nowUs, uint32_t budgetUs);
+  /** Newest complete line (NUL-terminated, without the newline), valid until the next pump(); with
+   *  setEveryLine() the oldest one not yet taken. In binary mode the oldest frame not yet taken (payload
+   *  only, not terminated). */
+  bool takeLine(char **line, size_t *len);
+  bool binary() const { return binary_; }
+  /** Hand out every line in order instead of only the newest (partial lines). Kept across reset(). */
+  void setEveryLine(bool on) { everyLine_ = on; }
+  bool everyLine() const { return everyLine_; }
+  /** Drop everything buffered (new connection). Counters are kept. */
+  void reset();
+
+  uint32_t lines() const { return lines_; }
+  /** Complete lines never handed out because a newer one arrived before takeLine(). */
+  uint32_t superseded() const { return superseded_; }
+  /** Lines longer than kCap, dropped up to their newline; framing resumes right after it. */
+  uint32_t oversized() const { return oversized_; }
+  /** Binary mode: bytes cut out because they did not start a frame. */
+  uint32_t resyncBytes() const { return resyncBytes_; }
+  /** pump() calls that ended on the time budget with data possibly still pending. */
+  uint32_t budgetStops() const { return budgetStops_; }
+  uint64_t bytes() const { return bytes_; }
+
+ private:
+  void frame(size_t from);
+  void frameBinary();
+  void compact();
+
+  char buf_[kCap];
+  size_t len_ = 0;
+  size_t tail_ = 0;       /* start of the unterminated rest */
+  size_t lineStart_ = 0;  /* newest complete line, if hasLine_; every line / binary: next to hand out */
+  size_t lineLen_ = 0;
+  bool hasLine_ = false;
+  bool skipping_ = false; /* inside an oversized line, until its newline */
+  bool binary_ = false;
+  bool everyLine_ = false;
+
+  uint32_t lines_ = 0;
+  uint32_t superseded_ = 0;
+  uint32_t oversized_ = 0;
+  uint32_t budgetStops_ = 0;
+  uint32_t resyncBytes_ = 0;
+  uint64_t bytes_ = 0;
+};
+
+#endif
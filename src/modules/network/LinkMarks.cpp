@@ -0,0 +1,69 @@
+/*
+ * NOCTURNE_OS — link markers on Serial.
+ */
+#include "LinkMarks.h"
+#include <cstdio>
+#include <cstring>
+
+size_t LinkMarks::ack(const MonitorSnapshot &s, char *out, size_t cap) {
+  if (baseline_) {
+    parsed_ = s.parsed;
+    rejected_ = s.rejected;
+    parseUs_ = s.parseUs;
+    acked_ = drawn_ = s.mark;
+    baseline_ = false;
+    return 0;
+  }
+  if (!out || s.mark < 0 || s.mark == acked_)
+    return 0;
+  const int n = snprintf(out, cap, "@ack %d %u %u %u\n", (int)s.mark, (unsigned)(s.parsed - parsed_),
+                         (unsigned)(s.rejected - rejected_), (unsigned)(s.parseUs - parseUs_));
+  if (n <= 0 || (size_t)n >= cap)
+    return 0;
+  parsed_ = s.parsed;
+  rejected_ = s.rejected;
+  parseUs_ = s.parseUs;
+  acked_ = s.mark;
+  return (size_t)n;
+}
+
+size_t LinkMarks::frame(uint32_t frameUs, char *out, size_t cap) {
+  if (!out || acked_ < 0 || acked_ == drawn_)
+    return 0;
+  const int n = snprintf(out, cap, "@frm %d %u\n", (int)acked_, (unsigned)frameUs);
+  if (n <= 0 || (size_t)n >= cap)
+    return 0;
+  drawn_ = acked_;
+  return (size_t)n;
+}
+
+void LinkMarks::reset() { baseline_ = true; }
+
+bool LinkMarks::parse(const char *line, size_t len, LinkMark *out) {
+  char buf[kLineMax];
+  if (!line || !out || len >= sizeof(buf) || len < 5 || line[0] != '@')
+    return false;
+  memcpy(buf, line, len);
+  while (len > 0 && (buf[len - 1] == '\r' || buf[len - 1] == ' '))
+    len--;
+  buf[len] = '\0';
+  int ln = -1, used = 0;
+  unsigned a = 0, b = 0, c = 0;
+  LinkMark m;
+  if (sscanf(buf, "@ack %d %u %u %u%n", &ln, &a, &b, &c, &used) == 4 && used == (int)len) {
+    m.kind = LinkMark::ACK;
+    m.lines = a;
+    m.rejected = b;
+    m.parseUs = c;
+  } else if (sscanf(buf, "@frm %d %u%n", &ln, &a, &used) == 2 && used == (int)len) {
+    m.kind = LinkMark::FRAME;
+    m.frameUs = a;
+  } else {
+    return false;
+  }
+  if (ln < 0)
+    return false;
+  m.ln = ln;
+  *out = m;
+  return true;
+}
@@ -0,0 +1,47 @@
+/*
+ * NOCTURNE_OS — link markers on Serial (NOCT_LINK_MARKS): "@ack <ln> <lines> <rejected> <parse_us>" and
+ * "@frm <ln> <frame_us>", matched by tools/monitor_server --serial against the "ln" numbers it stamped.
+ */
+#ifndef NOCTURNE_LINK_MARKS_H
+#define NOCTURNE_LINK_MARKS_H
+
+#include <cstddef>
+#include <cstdint>
+#include "MonitorLink.h"
+
+struct LinkMark {
+  enum Kind : uint8_t { ACK, FRAME };
+  Kind kind = ACK;
+  int32_t ln = -1;
+  uint32_t lines = 0;
+  uint32_t rejected = 0;
+  uint32_t parseUs = 0;
+  uint32_t frameUs = 0;
+};
+
+class LinkMarks {
+ public:
+  static const size_t kLineMax = 64;
+
+  /** After a snapshot was taken: "@ack ...\n" into out if it applied a line number not acknowledged
+   *  yet; 0 otherwise (or if cap is too small). */
+  size_t ack(const MonitorSnapshot &s, char *out, size_t cap);
+  /** After a data frame went to the panel: "@frm ...\n" for the newest acknowledged line if no frame
+   *  showed it yet; 0 otherwise. */
+  size_t frame(uint32_t frameUs, char *out, size_t cap);
+  /** Another link's counters from the next snapshot on: that one only sets the baseline. */
+  void reset();
+
+  /** One Serial line (without the newline; a trailing '\r' is fine). False if it is not a marker. */
+  static bool parse(const char *line, size_t len, LinkMark *out);
+
+ private:
+  uint32_t parsed_ = 0;
+  uint32_t rejected_ = 0;
+  uint32_t parseUs_ = 0;
+  int32_t acked_ = -1;
+  int32_t drawn_ = -1;
+  bool baseline_ = false;
+};
+
+#endif
@@ -0,0 +1,402 @@
+/*
+ * NOCTURNE_OS — compact binary monitor protocol (version 1).
+ */
+#include "MonitorBinary.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+/* Varint fields. Floats travel in tenths. */
+enum : uint8_t {
+  W_CT, W_GT, W_CL, W_GL, W_CC, W_PW, W_GH, W_GV, W_GCLOCK, W_VCLOCK, W_GTDP,
+  W_RU, W_RA, W_ND, W_NU, W_PG, W_CF, W_S1, W_S2, W_GF,
+  W_VU, W_VT, W_CH, W_MB_SYS, W_MB_VSOC, W_MB_VRM, W_MB_CHIPSET, W_DR, W_DW,
+  W_FAN0 = 29,
+  W_FANCTL0 = W_FAN0 + NOCT_FAN_COUNT,
+  W_HDD0 = W_FANCTL0 + NOCT_FAN_COUNT, /* per drive: letter, used, total, temp */
+  W_WT = W_HDD0 + 4 * NOCT_HDD_COUNT,
+  W_WI,
+  W_TPC0,
+  W_TRR0 = W_TPC0 + 3,
+  W_MP = W_TRR0 + 2,
+  W_IDLE,
+  W_PLAYING,
+  W_ALERT,
+  W_ALERT_SCENE,
+  W_ALERT_METRIC,
+  W_INT_END
+};
+
+/* String fields. */
+enum : uint8_t { W_WD = 0x80, W_TPN0 = 0x81, W_TRN0 = 0x84, W_ART = 0x86, W_TRK = 0x87, W_STR_END = 0x88 };
+
+static_assert(W_INT_END == MonitorBinary::kIntFields, "binary monitor: varint field count");
+static_assert(W_DW + 1 == W_FAN0, "binary monitor: scalar fields precede the arrays");
+static_assert(W_STR_END - W_WD == MonitorBinary::kStrFields, "binary monitor: string field count");
+static_assert(MonitorBinary::kStrMax >= NOCT_TEXT_MAX, "binary monitor: strings must carry whole AppState fields");
+
+struct IntRef {
+  int *i;
+  float *f;
+  bool *b;
+  char *c;
+};
+
+IntRef intRef(AppState &s, uint8_t id) {
+  HardwareData &hw = s.hw;
+  IntRef r = {nullptr, nullptr, nullptr, nullptr};
+  if (id >= W_FAN0 && id < W_FANCTL0) {
+    r.i = &hw.fans[id - W_FAN0];
+  } else if (id >= W_FANCTL0 && id < W_HDD0) {
+    r.i = &hw.fan_controls[id - W_FANCTL0];
+  } else if (id >= W_HDD0 && id < W_WT) {
+    HddEntry &d = hw.hdd[(id - W_HDD0) / 4];
+    switch ((id - W_HDD0) % 4) {
+      case 0: r.c = &d.name[0]; break;
+      case 1: r.f = &d.used_gb; break;
+      case 2: r.f = &d.total_gb; break;
+      default: r.i = &d.temp; break;
+    }
+  } else if (id >= W_TPC0 && id < W_TRR0) {
+    r.i = &s.process.cpuPercent[id - W_TPC0];
+  } else if (id >= W_TRR0 && id < W_MP) {
+    r.i = &s.process.ramMb[id - W_TRR0];
+  } else {
+    switch (id) {
+      case W_CT: r.i = &hw.ct; break;
+      case W_GT: r.i = &hw.gt; break;
+      case W_CL: r.i = &hw.cl; break;
+      case W_GL: r.i = &hw.gl; break;
+      case W_CC: r.i = &hw.cc; break;
+      case W_PW: r.i = &hw.pw; break;
+      case W_GH: r.i = &hw.gh; break;
+      case W_GV: r.i = &hw.gv; break;
+      case W_GCLOCK: r.i = &hw.gclock; break;
+      case W_VCLOCK: r.i = &hw.vclock; break;
+      case W_GTDP: r.i = &hw.gtdp; break;
+      case W_RU: r.f = &hw.ru; break;
+      case W_RA: r.f = &hw.ra; break;
+      case W_ND: r.i = &hw.nd; break;
+      case W_NU: r.i = &hw.nu; break;
+      case W_PG: r.i = &hw.pg; break;
+      case W_CF: r.i = &hw.cf; break;
+      case W_S1: r.i = &hw.s1; break;
+      case W_S2: r.i = &hw.s2; break;
+      case W_GF: r.i = &hw.gf; break;
+      case W_VU: r.f = &hw.vu; break;
+      case W_VT: r.f = &hw.vt; break;
+      case W_CH: r.i = &hw.ch; break;
+      case W_MB_SYS: r.i = &hw.mb_sys; break;
+      case W_MB_VSOC: r.i = &hw.mb_vsoc; break;
+      case W_MB_VRM: r.i = &hw.mb_vrm; break;
+      case W_MB_CHIPSET: r.i = &hw.mb_chipset; break;
+      case W_DR: r.i = &hw.dr; break;
+      case W_DW: r.i = &hw.dw; break;
+      case W_WT: r.i = &s.weather.temp; break;
+      case W_WI: r.i = &s.weather.wmoCode; break;
+      case W_MP: r.b = &s.media.isPlaying; break;
+      case W_IDLE: r.b = &s.media.isIdle; break;
+      case W_ALERT: r.b = &s.alertActive; break;
+      case W_ALERT_SCENE: r.i = &s.alertTargetScene; break;
+      case W_ALERT_METRIC: r.i = &s.alertMetric; break;
+      default: break; /* W_PLAYING: mediaStatus, handled by the callers */
+    }
+  }
+  return r;
+}
+
+int32_t getInt(const AppState &s, uint8_t id) {
+  if (id == W_PLAYING)
+    return s.media.mediaStatus == "PLAYING" ? 1 : 0;
+  const IntRef r = intRef(const_cast<AppState &>(s), id);
+  if (r.i)
+    return *r.i;
+  if (r.f) {
+    const float t = *r.f * 10.0f;
+    return t >= 2e9f ? 2000000000 : t <= -2e9f ? -2000000000 : (int32_t)lroundf(t);
+  }
+  if (r.b)
+    return *r.b ? 1 : 0;
+  return r.c ? (uint8_t)*r.c : 0;
+}
+
+/** True if the field changed. */
+bool setInt(AppState &s, uint8_t id, int32_t v) {
+  if (id == W_PLAYING)
+    return s.media.mediaStatus.assign(v ? "PLAYING" : "PAUSED");
+  const IntRef r = intRef(s, id);
+  if (r.i) {
+    if (*r.i == v)
+      return false;
+    *r.i = v;
+  } else if (r.f) {
+    if (*r.f == v / 10.0f)
+      return false;
+    *r.f = v / 10.0f;
+  } else if (r.b) {
+    if (*r.b == (v != 0))
+      return false;
+    *r.b = v != 0;
+  } else if (r.c) {
+    if (*r.c == (char)v)
+      return false;
+    *r.c = (char)v;
+  }
+  return true;
+}
+
+/* StateField of each varint field. */
+StateField intField(uint8_t id) {
+  static const uint8_t kScalar[W_FAN0] = {
+      SF_CT, SF_GT, SF_CL, SF_GL, SF_CC, SF_PW, SF_GH, SF_GV, SF_GCLOCK, SF_VCLOCK, SF_GTDP,
+      SF_RU, SF_RA, SF_ND, SF_NU, SF_PG, SF_CF, SF_S1, SF_S2, SF_GF,
+      SF_VU, SF_VT, SF_CH, SF_MB_SYS, SF_MB_VSOC, SF_MB_VRM, SF_MB_CHIPSET, SF_DR, SF_DW};
+  if (id < W_FAN0)
+    return (StateField)kScalar[id];
+  if (id < W_FANCTL0)
+    return SF_FANS;
+  if (id < W_HDD0)
+    return SF_FAN_CONTROLS;
+  if (id < W_WT)
+    return SF_HDD;
+  if (id < W_TPC0)
+    return SF_WEATHER;
+  if (id < W_TRR0)
+    return SF_TOP_CPU;
+  if (id < W_MP)
+    return SF_TOP_RAM;
+  if (id < W_ALERT)
+    return SF_MEDIA_STATE;
+  return SF_ALERT;
+}
+
+StateField strField(uint8_t id) {
+  if (id >= W_TPN0 && id < W_TRN0)
+    return SF_TOP_CPU;
+  if (id >= W_TRN0 && id < W_ART)
+    return SF_TOP_RAM;
+  return id == W_WD ? SF_WEATHER : id == W_ART ? SF_ARTIST : SF_TRACK;
+}
+
+FixedStringBase *strRef(AppState &s, uint8_t id) {
+  if (id >= W_TPN0 && id < W_TRN0)
+    return &s.process.cpuNames[id - W_TPN0];
+  if (id >= W_TRN0 && id < W_ART)
+    return &s.process.ramNames[id - W_TRN0];
+  switch (id) {
+    case W_WD: return &s.weather.desc;
+    case W_ART: return &s.media.artist;
+    case W_TRK: return &s.media.track;
+    default: return nullptr;
+  }
+}
+
+uint8_t *putVarint(uint8_t *p, int32_t v) {
+  uint32_t z = ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+  while (z >= 0x80) {
+    *p++ = (uint8_t)(z | 0x80);
+    z >>= 7;
+  }
+  *p++ = (uint8_t)z;
+  return p;
+}
+
+bool getVarint(const uint8_t *p, size_t len, size_t *i, int32_t *v) {
+  uint32_t z = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (*i >= len)
+      return false;
+    const uint8_t b = p[(*i)++];
+    z |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *v = (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+/* ── Encoder ── */
+
+void MonitorBinaryEncoder::reset() {
+  memset(prev_, 0, sizeof(prev_));
+  memset(prevStr_, 0, sizeof(prevStr_));
+  memset(dictUsed_, 0, sizeof(dictUsed_));
+  frames_ = 0;
+  seq_ = 0;
+  sinceKey_ = 0;
+}
+
+int MonitorBinaryEncoder::findSlot(const char *s, size_t len) const {
+  for (uint8_t k = 0; k < MonitorBinary::kDictSlots; k++)
+    if (dictUsed_[k] && dictLen_[k] == len && memcmp(dict_[k], s, len) == 0)
+      return k;
+  return -1;
+}
+
+/* Free slot, else the one unused for longest (never one used in this frame: at most kStrFields are). */
+int MonitorBinaryEncoder::defineSlot(const char *s, size_t len) {
+  uint8_t best = 0;
+  for (uint8_t k = 0; k < MonitorBinary::kDictSlots; k++) {
+    if (!dictUsed_[k]) {
+      best = k;
+      break;
+    }
+    if (dictUsed_[k] < dictUsed_[best])
+      best = k;
+  }
+  memcpy(dict_[best], s, len);
+  dict_[best][len] = '\0';
+  dictLen_[best] = (uint8_t)len;
+  return best;
+}
+
+size_t MonitorBinaryEncoder::encode(const AppState &state, uint8_t *out, size_t cap) {
+  if (!out || cap < MonitorBinary::kFrameMax)
+    return 0;
+  const bool key = keyOnly_ || frames_ == 0 || sinceKey_ >= MonitorBinary::kKeyframeEvery;
+  if (key) {
+    memset(dictUsed_, 0, sizeof(dictUsed_));
+    sinceKey_ = 0;
+  }
+  frames_++;
+  sinceKey_++;
+
+  uint8_t *p = out + MonitorBinary::kHeader;
+  *p++ = key ? MonitorBinary::kFlagKey : 0;
+  *p++ = seq_++;
+  for (uint8_t id = 0; id < MonitorBinary::kIntFields; id++) {
+    const int32_t v = getInt(state, id);
+    if (!key && v == prev_[id])
+      continue;
+    *p++ = id;
+    p = putVarint(p, v);
+    prev_[id] = v;
+  }
+  for (uint8_t k = 0; k < MonitorBinary::kStrFields; k++) {
+    const uint8_t id = (uint8_t)(W_WD + k);
+    const FixedStringBase *f = strRef(const_cast<AppState &>(state), id);
+    const char *s = f->c_str();
+    const size_t len = FixedStringBase::utf8Fit(s, f->length(), MonitorBinary::kStrMax);
+    if (!key && strlen(prevStr_[k]) == len && memcmp(prevStr_[k], s, len) == 0)
+      continue;
+    memcpy(prevStr_[k], s, len);
+    prevStr_[k][len] = '\0';
+    *p++ = id;
+    if (len == 0) {
+      *p++ = 0;
+      continue;
+    }
+    int slot = findSlot(s, len);
+    if (slot >= 0) {
+      *p++ = (uint8_t)(1 + slot);
+    } else {
+      slot = defineSlot(s, len);
+      *p++ = (uint8_t)(0x40 | slot);
+      *p++ = (uint8_t)len;
+      memcpy(p, s, len);
+      p += len;
+    }
+    dictUsed_[slot] = frames_;
+  }
+
+  const size_t payload = (size_t)(p - out) - MonitorBinary::kHeader;
+  out[0] = MonitorBinary::kMagic;
+  out[1] = (uint8_t)(payload & 0xFF);
+  out[2] = (uint8_t)(payload >> 8);
+  return (size_t)(p - out);
+}
+
+/* ── Decoder ── */
+
+void MonitorBinaryDecoder::reset() {
+  defined_ = 0;
+  started_ = false;
+  nextSeq_ = 0;
+}
+
+bool MonitorBinaryDecoder::decode(const uint8_t *payload, size_t len, AppState *state) {
+  if (!payload || !state)
+    return false;
+  frames_++;
+  /* Check the whole frame first, so a bad one changes nothing. */
+  if (!walk(payload, len, nullptr)) {
+    errors_++;
+    return false;
+  }
+  changed_ = 0;
+  walk(payload, len, state);
+  if (started_ && payload[1] != nextSeq_)
+    gaps_++;
+  started_ = true;
+  nextSeq_ = (uint8_t)(payload[1] + 1);
+  if (!state->weatherReceived &&
+      (state->weather.desc.length() > 0 || state->weather.temp != 0 || state->weather.wmoCode != 0)) {
+    state->weatherReceived = true;
+    changed_ |= fieldBit(SF_WEATHER);
+  }
+  return true;
+}
+
+bool MonitorBinaryDecoder::walk(const uint8_t *p, size_t len, AppState *apply) {
+  if (len < 2)
+    return false;
+  uint16_t defined = (p[0] & MonitorBinary::kFlagKey) ? 0 : defined_;
+  size_t i = 2;
+  while (i < len) {
+    const uint8_t id = p[i++];
+    if (id < 0x80) {
+      int32_t v;
+      if (!getVarint(p, len, &i, &v))
+        return false;
+      if (!apply)
+        continue;
+      if (id < MonitorBinary::kIntFields) {
+        if (setInt(*apply, id, v))
+          changed_ |= fieldBit(intField(id));
+      }
+      else
+        unknownFields_++;
+      continue;
+    }
+
+    if (i >= len)
+      return false;
+    const uint8_t b = p[i++];
+    const char *text = "";
+    if (b >= 1 && b <= MonitorBinary::kDictSlots) {
+      if (!(defined & (1u << (b - 1))))
+        return false;
+      text = dict_[b - 1];
+    } else if ((b & 0xC0) == 0x40 && (b & 0x3F) < MonitorBinary::kDictSlots) {
+      const uint8_t slot = b & 0x3F;
+      if (i >= len)
+        return false;
+      const size_t n = p[i++];
+      if (n > MonitorBinary::kStrMax || n > len - i)
+        return false;
+      if (apply) {
+        memcpy(dict_[slot], p + i, n);
+        dict_[slot][n] = '\0';
+        text = dict_[slot];
+      }
+      defined |= (uint16_t)(1u << slot);
+      i += n;
+    } else if (b != 0) {
+      return false;
+    }
+    if (!apply)
+      continue;
+    FixedStringBase *dst = id < W_STR_END ? strRef(*apply, id) : nullptr;
+    if (!dst)
+      unknownFields_++;
+    else if (dst->assign(text))
+      changed_ |= fieldBit(strField(id));
+  }
+  if (apply)
+    defined_ = defined;
+  return true;
+}
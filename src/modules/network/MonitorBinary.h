@@ -0,0 +1,87 @@
+/*
+ * NOCTURNE_OS — compact binary monitor protocol, negotiated by "HELO bin=1" / "BIN 1": changed fields only,
+ * strings through a per-connection dictionary. The encoder is the PC reference; the firmware only decodes.
+ */
+#ifndef NOCTURNE_MONITOR_BINARY_H
+#define NOCTURNE_MONITOR_BINARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include "nocturne/StateFields.h"
+#include "nocturne/Types.h"
+
+/** Frame: kMagic, payload length u16 LE, payload = flags (kFlagKey), seq u8, then id + value per field.
+ *  Ids < 0x80: zigzag varint (floats in tenths). Ids >= 0x80: string, first byte 0 = empty,
+ *  1..kDictSlots = slot, 0x40 | slot = define it (length byte, text) and use it. */
+class MonitorBinary {
+ public:
+  static const uint8_t kVersion = 1;
+  static const uint8_t kMagic = 0xB1;
+  static const size_t kHeader = 3;
+  static const uint8_t kFlagKey = 0x01;
+  static const uint8_t kDictSlots = 16;
+  static const size_t kStrMax = 63; /* bytes, cut on a UTF-8 boundary */
+  static const uint8_t kKeyframeEvery = 64;
+  /** Largest frame the encoder produces: every field, every string defined. */
+  static const size_t kFrameMax = 1024;
+  static const uint8_t kIntFields = 66;
+  static const uint8_t kStrFields = 8;
+};
+
+/** PC side: one encoder per connection. */
+class MonitorBinaryEncoder {
+ public:
+  MonitorBinaryEncoder() { reset(); }
+  /** Frame for this state (header included) into out; 0 if cap is too small. */
+  size_t encode(const AppState &state, uint8_t *out, size_t cap);
+  /** New connection: the next frame is a keyframe. */
+  void reset();
+  /** Every frame a keyframe: for datagrams (MonitorUdp), where any one may be lost. */
+  void setKeyframesOnly(bool on) { keyOnly_ = on; }
+
+ private:
+  int findSlot(const char *s, size_t len) const;
+  int defineSlot(const char *s, size_t len);
+
+  int32_t prev_[MonitorBinary::kIntFields];
+  char prevStr_[MonitorBinary::kStrFields][MonitorBinary::kStrMax + 1];
+  char dict_[MonitorBinary::kDictSlots][MonitorBinary::kStrMax + 1];
+  uint8_t dictLen_[MonitorBinary::kDictSlots];
+  uint32_t dictUsed_[MonitorBinary::kDictSlots]; /* frame number of last use, 0 = free */
+  uint32_t frames_ = 0;
+  uint8_t seq_ = 0;
+  uint8_t sinceKey_ = 0;
+  bool keyOnly_ = false;
+};
+
+/** Device side: one decoder per connection. */
+class MonitorBinaryDecoder {
+ public:
+  MonitorBinaryDecoder() { reset(); }
+  /** One frame payload (without the 3-byte header). False if malformed; then state is untouched. */
+  bool decode(const uint8_t *payload, size_t len, AppState *state);
+  void reset();
+  /** StateField bits the last successful decode changed in AppState. */
+  FieldMask changed() const { return changed_; }
+
+  uint32_t frames() const { return frames_; }
+  uint32_t errors() const { return errors_; }
+  /** Frames whose sequence number did not follow the previous one. */
+  uint32_t gaps() const { return gaps_; }
+  uint32_t unknownFields() const { return unknownFields_; }
+
+ private:
+  bool walk(const uint8_t *p, size_t len, AppState *apply);
+
+  char dict_[MonitorBinary::kDictSlots][MonitorBinary::kStrMax + 1];
+  uint16_t defined_ = 0;
+  FieldMask changed_ = 0;
+  bool started_ = false;
+  uint8_t nextSeq_ = 0;
+  uint32_t frames_ = 0;
+  uint32_t errors_ = 0;
+  uint32_t gaps_ = 0;
+  uint32_t unknownFields_ = 0;
+};
+
+#endif
@@ -0,0 +1,774 @@
+/*
+ * NOCTURNE_OS — monitor payload decoder, single pass, no heap.
+ */
+#include "MonitorDecoder.h"
+#include <cstring>
+#include "nocturne/config.h"
+
+namespace {
+
+enum Field : uint8_t {
+  F_CT, F_GT, F_CL, F_GL, F_CC, F_PW, F_GH, F_GV, F_GCLOCK, F_VCLOCK, F_GTDP, F_RU, F_RA, F_ND, F_NU,
+  F_PG, F_CF, F_S1, F_S2, F_GF, F_FANS, F_FAN_CONTROLS, F_HDD, F_VU, F_VT, F_CH, F_MB_SYS, F_MB_VSOC,
+  F_MB_VRM, F_MB_CHIPSET, F_DR, F_DW, F_WT, F_WD, F_WI, F_TP, F_TR, F_ART, F_TRK, F_MP, F_IDLE,
+  F_MEDIA_STATUS, F_ALERT, F_TARGET_SCREEN, F_ALERT_METRIC, F_SB, F_LN, F_COUNT
+};
+
+/* Indexed by Field. */
+constexpr const char *kKeys[F_COUNT] = {
+    "ct", "gt", "cl", "gl", "cc", "pw", "gh", "gv", "gclock", "vclock", "gtdp", "ru", "ra", "nd", "nu",
+    "pg", "cf", "s1", "s2", "gf", "fans", "fan_controls", "hdd", "vu", "vt", "ch", "mb_sys", "mb_vsoc",
+    "mb_vrm", "mb_chipset", "dr", "dw", "wt", "wd", "wi", "tp", "tr", "art", "trk", "mp", "idle",
+    "media_status", "alert", "target_screen", "alert_metric", "sb", "ln"};
+
+constexpr size_t keyLen(const char *k) { return *k ? 1 + keyLen(k + 1) : 0; }
+
+/** Keys are at least two characters long; shorter ones are unknown without hashing. */
+constexpr uint8_t keyHash(const char *k, size_t n) {
+  return (uint8_t)(((uint8_t)k[0] * 2u + (uint8_t)k[1] * 16u + (uint8_t)k[n - 1] * 3u + n * 3u) & 127u);
+}
+
+constexpr uint8_t kNone = 0xFF;
+/* keyHash -> Field. */
+constexpr uint8_t kSlotField[128] = {
+    kNone, kNone, kNone, kNone, F_CH, kNone, kNone, kNone,
+    F_LN, kNone, kNone, F_PG, F_GH, kNone, F_VT, F_S1,
+    F_WT, F_NU, kNone, kNone, kNone, kNone, F_GV, kNone,
+    kNone, F_RU, kNone, kNone, kNone, F_RA, kNone, kNone,
+    kNone, F_VU, F_S2, F_DW, kNone, F_CC, kNone, F_MEDIA_STATUS,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    F_MP, kNone, F_SB, kNone, kNone, kNone, kNone, kNone,
+    F_MB_VSOC, kNone, kNone, F_PW, kNone, kNone, F_TP, F_WI,
+    kNone, F_FANS, kNone, kNone, F_DR, F_HDD, kNone, F_ART,
+    kNone, kNone, kNone, kNone, kNone, F_IDLE, F_ND, F_ALERT_METRIC,
+    F_CL, F_GCLOCK, F_TRK, F_MB_VRM, kNone, kNone, kNone, kNone,
+    F_GL, F_FAN_CONTROLS, kNone, kNone, kNone, kNone, F_CF, kNone,
+    F_WD, kNone, kNone, kNone, F_TR, F_MB_SYS, F_GF, kNone,
+    F_CT, F_TARGET_SCREEN, F_GTDP, kNone, kNone, F_ALERT, kNone, F_VCLOCK,
+    F_GT, kNone, kNone, kNone, F_MB_CHIPSET, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone};
+
+/* Every key lands in its own slot: a new key that collides fails the build, not the parse. */
+constexpr bool slotsMatch(size_t f) {
+  return f == F_COUNT || (kSlotField[keyHash(kKeys[f], keyLen(kKeys[f]))] == f && slotsMatch(f + 1));
+}
+static_assert(slotsMatch(0), "monitor key hash: collision or stale kSlotField");
+
+uint8_t lookup(const char *key, size_t n) {
+  if (!key || n < 2)
+    return kNone;
+  const uint8_t f = kSlotField[keyHash(key, n)];
+  return f != kNone && memcmp(kKeys[f], key, n) == 0 && kKeys[f][n] == '\0' ? f : kNone;
+}
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+int hexDigit(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+const float kPow10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+int sceneFromName(const char *t) {
+  static const char *const kNames[] = {"MAIN", "CPU", "GPU", "RAM", "DISKS", "MEDIA", "FANS", "MOTHERBOARD"};
+  static const int kScenes[] = {NOCT_SCENE_MAIN, NOCT_SCENE_CPU, NOCT_SCENE_GPU, NOCT_SCENE_RAM,
+                                NOCT_SCENE_DISKS, NOCT_SCENE_MEDIA, NOCT_SCENE_FANS, NOCT_SCENE_MOTHERBOARD};
+  for (size_t i = 0; i < sizeof(kScenes) / sizeof(kScenes[0]); i++)
+    if (strcmp(t, kNames[i]) == 0)
+      return kScenes[i];
+  return NOCT_SCENE_MAIN;
+}
+
+int metricFromName(const char *m) {
+  static const char *const kNames[] = {"ct", "gt", "cl", "gl", "gv", "ram"};
+  static const int kMetrics[] = {NOCT_ALERT_CT, NOCT_ALERT_GT, NOCT_ALERT_CL, NOCT_ALERT_GL, NOCT_ALERT_GV,
+                                 NOCT_ALERT_RAM};
+  for (size_t i = 0; i < sizeof(kMetrics) / sizeof(kMetrics[0]); i++)
+    if (strcmp(m, kNames[i]) == 0)
+      return kMetrics[i];
+  return -1;
+}
+
+}  // namespace
+
+bool MonitorDecoder::decode(const char *line, size_t len, AppState *state) {
+  if (!line || !state)
+    return false;
+  lines_++;
+  p_ = line;
+  end_ = line + len;
+  ws();
+  bool ok = expect('{');
+  if (ok) {
+    ws();
+    /* A subscription line (MonitorSubscription) leads with "sb": what it leaves out stays as it is. */
+    if (end_ - p_ >= 5 && memcmp(p_, "\"sb\":", 5) == 0)
+      seed(*state);
+    else
+      reset();
+    if (peek('}'))
+      p_++;
+    else
+      while ((ok = parseMember())) {
+        ws();
+        if (!peek(','))
+          break;
+        p_++;
+        ws();
+      }
+    ok = ok && expect('}');
+  }
+  ws();
+  if (!ok || p_ != end_) {
+    errors_++;
+    return false;
+  }
+  apply(state);
+  sub_ = s_.sub;
+  mark_ = s_.mark;
+  return true;
+}
+
+void MonitorDecoder::reset() {
+  s_.hw = HardwareData();
+  for (int i = 0; i < NOCT_HDD_COUNT; i++)
+    s_.hw.hdd[i].name[0] = (char)('C' + i);
+  s_.weather = false;
+  s_.weatherTemp = 0;
+  s_.weatherCode = 0;
+  s_.weatherDesc[0] = '\0';
+  for (int i = 0; i < 3; i++) {
+    s_.cpuNames[i][0] = '\0';
+    s_.cpuPercent[i] = 0;
+  }
+  for (int i = 0; i < 2; i++) {
+    s_.ramNames[i][0] = '\0';
+    s_.ramMb[i] = 0;
+  }
+  s_.artist[0] = '\0';
+  s_.track[0] = '\0';
+  s_.playing = false;
+  s_.idle = false;
+  s_.statusPlaying = false;
+  s_.alertCritical = false;
+  s_.alertScene = -1;
+  s_.alertMetric = -2;
+  s_.sub = -1;
+  s_.mark = -1;
+}
+
+void MonitorDecoder::seed(const AppState &state) {
+  s_.hw = state.hw;
+  s_.weather = false; /* applied only if the line carries "wt" */
+  s_.weatherTemp = state.weather.temp;
+  s_.weatherCode = state.weather.wmoCode;
+  memcpy(s_.weatherDesc, state.weather.desc.c_str(), state.weather.desc.length() + 1);
+  for (int i = 0; i < 3; i++) {
+    memcpy(s_.cpuNames[i], state.process.cpuNames[i].c_str(), state.process.cpuNames[i].length() + 1);
+    s_.cpuPercent[i] = state.process.cpuPercent[i];
+  }
+  for (int i = 0; i < 2; i++) {
+    memcpy(s_.ramNames[i], state.process.ramNames[i].c_str(), state.process.ramNames[i].length() + 1);
+    s_.ramMb[i] = state.process.ramMb[i];
+  }
+  memcpy(s_.artist, state.media.artist.c_str(), state.media.artist.length() + 1);
+  memcpy(s_.track, state.media.track.c_str(), state.media.track.length() + 1);
+  s_.playing = state.media.isPlaying;
+  s_.idle = state.media.isIdle;
+  s_.statusPlaying = state.media.mediaStatus == "PLAYING";
+  s_.alertCritical = state.alertActive;
+  s_.alertScene = state.alertTargetScene;
+  s_.alertMetric = state.alertMetric;
+  s_.sub = -1;
+  s_.mark = -1;
+}
+
+bool MonitorDecoder::parseMember() {
+  const char *key;
+  size_t n;
+  if (!readKey(&key, &n))
+    return false;
+  ws();
+  if (!expect(':'))
+    return false;
+  ws();
+  const uint8_t f = lookup(key, n);
+  if (f == kNone) {
+    unknownKeys_++;
+    return skipValue(0);
+  }
+  return parseField(f);
+}
+
+bool MonitorDecoder::parseField(uint8_t field) {
+  HardwareData &hw = s_.hw;
+  char tag[16];
+  switch (field) {
+    case F_CT: return readInt(&hw.ct);
+    case F_GT: return readInt(&hw.gt);
+    case F_CL: return readInt(&hw.cl);
+    case F_GL: return readInt(&hw.gl);
+    case F_CC: return readInt(&hw.cc);
+    case F_PW: return readInt(&hw.pw);
+    case F_GH: return readInt(&hw.gh);
+    case F_GV: return readInt(&hw.gv);
+    case F_GCLOCK: return readInt(&hw.gclock);
+    case F_VCLOCK: return readInt(&hw.vclock);
+    case F_GTDP: return readInt(&hw.gtdp);
+    case F_RU: return readFloat(&hw.ru);
+    case F_RA: return readFloat(&hw.ra);
+    case F_ND: return readInt(&hw.nd);
+    case F_NU: return readInt(&hw.nu);
+    case F_PG: return readInt(&hw.pg);
+    case F_CF: return readInt(&hw.cf);
+    case F_S1: return readInt(&hw.s1);
+    case F_S2: return readInt(&hw.s2);
+    case F_GF: return readInt(&hw.gf);
+    case F_FANS: return readIntArray(hw.fans, NOCT_FAN_COUNT);
+    case F_FAN_CONTROLS: return readIntArray(hw.fan_controls, NOCT_FAN_COUNT);
+    case F_VU: return readFloat(&hw.vu);
+    case F_VT: return readFloat(&hw.vt);
+    case F_CH: return readInt(&hw.ch);
+    case F_MB_SYS: return readInt(&hw.mb_sys);
+    case F_MB_VSOC: return readInt(&hw.mb_vsoc);
+    case F_MB_VRM: return readInt(&hw.mb_vrm);
+    case F_MB_CHIPSET: return readInt(&hw.mb_chipset);
+    case F_DR: return readInt(&hw.dr);
+    case F_DW: return readInt(&hw.dw);
+    case F_WT:
+      /* "wt": null is no weather, like a missing key. */
+      if (peek('n'))
+        return skipValue(0);
+      s_.weather = true;
+      return readInt(&s_.weatherTemp);
+    case F_WD: return peek('"') ? readString(s_.weatherDesc, kTextMax) : skipValue(0);
+    case F_WI: return readInt(&s_.weatherCode);
+    case F_ART: return peek('"') ? readString(s_.artist, kTextMax) : skipValue(0);
+    case F_TRK: return peek('"') ? readString(s_.track, kTextMax) : skipValue(0);
+    case F_MP: return readBool(&s_.playing);
+    case F_IDLE: return readBool(&s_.idle);
+    case F_MEDIA_STATUS:
+      if (!peek('"'))
+        return skipValue(0);
+      if (!readString(tag, sizeof(tag)))
+        return false;
+      s_.statusPlaying = strcmp(tag, "PLAYING") == 0;
+      return true;
+    case F_ALERT:
+      if (!peek('"'))
+        return skipValue(0);
+      if (!readString(tag, sizeof(tag)))
+        return false;
+      s_.alertCritical = strcmp(tag, "CRITICAL") == 0;
+      return true;
+    case F_TARGET_SCREEN:
+      if (!peek('"'))
+        return skipValue(0);
+      if (!readString(tag, sizeof(tag)))
+        return false;
+      s_.alertScene = sceneFromName(tag);
+      return true;
+    case F_ALERT_METRIC:
+      if (!peek('"'))
+        return skipValue(0);
+      if (!readString(tag, sizeof(tag)))
+        return false;
+      s_.alertMetric = metricFromName(tag);
+      return true;
+    case F_SB:
+      return readInt(&s_.sub);
+    case F_LN:
+      return readInt(&s_.mark);
+    case F_HDD:
+    case F_TP:
+    case F_TR:
+      break;
+    default:
+      return skipValue(0);
+  }
+
+  /* Arrays of objects: hdd [{n,u,tot,t}], tp [{n,c}], tr [{n,r}]. */
+  if (!peek('['))
+    return skipValue(0);
+  p_++;
+  ws();
+  if (peek(']')) {
+    p_++;
+    return true;
+  }
+  for (int i = 0;; i++) {
+    ws();
+    bool ok;
+    if (!peek('{'))
+      ok = skipValue(0);
+    else if (field == F_HDD)
+      ok = i < NOCT_HDD_COUNT ? parseHdd(i) : skipValue(0);
+    else if (field == F_TP)
+      ok = i < 3 ? parseProcess(s_.cpuNames[i], &s_.cpuPercent[i], 'c') : skipValue(0);
+    else
+      ok = i < 2 ? parseProcess(s_.ramNames[i], &s_.ramMb[i], 'r') : skipValue(0);
+    if (!ok)
+      return false;
+    ws();
+    if (!peek(','))
+      return expect(']');
+    p_++;
+  }
+}
+
+bool MonitorDecoder::parseHdd(int i) {
+  HddEntry &d = s_.hw.hdd[i];
+  p_++;
+  ws();
+  if (peek('}')) {
+    p_++;
+    return true;
+  }
+  for (;;) {
+    const char *k;
+    size_t n;
+    if (!readKey(&k, &n))
+      return false;
+    ws();
+    if (!expect(':'))
+      return false;
+    ws();
+    bool ok;
+    if (k && n == 1 && k[0] == 'n' && peek('"')) {
+      char name[8];
+      ok = readString(name, sizeof(name));
+      if (name[0])
+        d.name[0] = name[0];
+    } else if (k && n == 1 && k[0] == 'u') {
+      ok = readFloat(&d.used_gb);
+    } else if (k && n == 3 && memcmp(k, "tot", 3) == 0) {
+      ok = readFloat(&d.total_gb);
+    } else if (k && n == 1 && k[0] == 't') {
+      ok = readInt(&d.temp);
+    } else {
+      ok = skipValue(1);
+    }
+    if (!ok)
+      return false;
+    ws();
+    if (!peek(','))
+      return expect('}');
+    p_++;
+    ws();
+  }
+}
+
+bool MonitorDecoder::parseProcess(char *name, int *value, char valueKey) {
+  p_++;
+  ws();
+  if (peek('}')) {
+    p_++;
+    return true;
+  }
+  for (;;) {
+    const char *k;
+    size_t n;
+    if (!readKey(&k, &n))
+      return false;
+    ws();
+    if (!expect(':'))
+      return false;
+    ws();
+    bool ok;
+    if (k && n == 1 && k[0] == 'n' && peek('"'))
+      ok = readString(name, kNameMax);
+    else if (k && n == 1 && k[0] == valueKey)
+      ok = readInt(value);
+    else
+      ok = skipValue(1);
+    if (!ok)
+      return false;
+    ws();
+    if (!peek(','))
+      return expect('}');
+    p_++;
+    ws();
+  }
+}
+
+void MonitorDecoder::apply(AppState *state) {
+  FieldMask m = diffHardware(state->hw, s_.hw);
+  state->hw = s_.hw;
+  if (s_.weather) {
+    bool w = state->weather.desc.assign(s_.weatherDesc);
+    w |= state->weather.temp != s_.weatherTemp || state->weather.wmoCode != s_.weatherCode;
+    state->weather.temp = s_.weatherTemp;
+    state->weather.wmoCode = s_.weatherCode;
+    if ((s_.weatherDesc[0] || s_.weatherTemp != 0 || s_.weatherCode != 0) && !state->weatherReceived) {
+      state->weatherReceived = true;
+      w = true;
+    }
+    if (w)
+      m |= fieldBit(SF_WEATHER);
+  }
+  for (int i = 0; i < 3; i++) {
+    if (state->process.cpuNames[i].assign(s_.cpuNames[i]) || state->process.cpuPercent[i] != s_.cpuPercent[i])
+      m |= fieldBit(SF_TOP_CPU);
+    state->process.cpuPercent[i] = s_.cpuPercent[i];
+  }
+  for (int i = 0; i < 2; i++) {
+    if (state->process.ramNames[i].assign(s_.ramNames[i]) || state->process.ramMb[i] != s_.ramMb[i])
+      m |= fieldBit(SF_TOP_RAM);
+    state->process.ramMb[i] = s_.ramMb[i];
+  }
+  if (state->media.artist.assign(s_.artist))
+    m |= fieldBit(SF_ARTIST);
+  if (state->media.track.assign(s_.track))
+    m |= fieldBit(SF_TRACK);
+  if (state->media.mediaStatus.assign(s_.statusPlaying ? "PLAYING" : "PAUSED") ||
+      state->media.isPlaying != s_.playing || state->media.isIdle != s_.idle)
+    m |= fieldBit(SF_MEDIA_STATE);
+  state->media.isPlaying = s_.playing;
+  state->media.isIdle = s_.idle;
+
+  const bool alert = state->alertActive;
+  const int scene = state->alertTargetScene, metric = state->alertMetric;
+  state->alertActive = s_.alertCritical;
+  if (!state->alertActive) {
+    state->alertTargetScene = NOCT_SCENE_MAIN;
+    state->alertMetric = -1;
+  } else {
+    if (s_.alertScene >= 0)
+      state->alertTargetScene = s_.alertScene;
+    if (s_.alertMetric != -2)
+      state->alertMetric = s_.alertMetric;
+  }
+  if (alert != state->alertActive || scene != state->alertTargetScene || metric != state->alertMetric)
+    m |= fieldBit(SF_ALERT);
+  changed_ = m;
+}
+
+void MonitorDecoder::ws() {
+  while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' || *p_ == '\n'))
+    p_++;
+}
+
+bool MonitorDecoder::peek(char c) { return p_ < end_ && *p_ == c; }
+
+bool MonitorDecoder::expect(char c) {
+  if (!peek(c))
+    return false;
+  p_++;
+  return true;
+}
+
+/* Plain keys point into the line. A key with escapes is no key we know: *key = nullptr. */
+bool MonitorDecoder::readKey(const char **key, size_t *len) {
+  if (!peek('"'))
+    return false;
+  const char *start = p_ + 1;
+  const char *q = start;
+  while (q < end_ && *q != '"' && *q != '\\')
+    q++;
+  if (q >= end_)
+    return false;
+  if (*q == '"') {
+    *key = start;
+    *len = (size_t)(q - start);
+    p_ = q + 1;
+    return true;
+  }
+  *key = nullptr;
+  *len = 0;
+  return skipString();
+}
+
+/* Into out (NUL-terminated, cut at cap - 1 bytes on a UTF-8 boundary). */
+bool MonitorDecoder::readString(char *out, size_t cap) {
+  if (!expect('"'))
+    return false;
+  size_t w = 0;
+  bool cut = false;
+  const auto put = [&](const char *src, size_t n) {
+    if (cut)
+      return;
+    if (w + n > cap - 1) {
+      n = cap - 1 - w;
+      cut = true;
+    }
+    memcpy(out + w, src, n);
+    w += n;
+  };
+  for (;;) {
+    const char *q = p_;
+    while (q < end_ && *q != '"' && *q != '\\')
+      q++;
+    put(p_, (size_t)(q - p_));
+    if (q >= end_)
+      return false;
+    p_ = q + 1;
+    if (*q == '"')
+      break;
+    if (p_ >= end_)
+      return false;
+    const char e = *p_++;
+    char c;
+    switch (e) {
+      case '"': case '\\': case '/': c = e; break;
+      case 'b': c = '\b'; break;
+      case 'f': c = '\f'; break;
+      case 'n': c = '\n'; break;
+      case 'r': c = '\r'; break;
+      case 't': c = '\t'; break;
+      case 'u': {
+        uint32_t cp = 0;
+        for (int i = 0; i < 4; i++) {
+          const int h = p_ < end_ ? hexDigit(*p_++) : -1;
+          if (h < 0)
+            return false;
+          cp = cp << 4 | (uint32_t)h;
+        }
+        /* Surrogate pair: 😀. A lone half becomes U+FFFD. */
+        if (cp >= 0xD800 && cp <= 0xDBFF && end_ - p_ >= 6 && p_[0] == '\\' && p_[1] == 'u') {
+          uint32_t lo = 0;
+          int i = 0;
+          for (; i < 4; i++) {
+            const int h = hexDigit(p_[2 + i]);
+            if (h < 0)
+              break;
+            lo = lo << 4 | (uint32_t)h;
+          }
+          if (i == 4 && lo >= 0xDC00 && lo <= 0xDFFF) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            p_ += 6;
+          }
+        }
+        if (cp >= 0xD800 && cp <= 0xDFFF)
+          cp = 0xFFFD;
+        char u[4];
+        size_t n;
+        if (cp < 0x80) {
+          u[0] = (char)cp;
+          n = 1;
+        } else if (cp < 0x800) {
+          u[0] = (char)(0xC0 | cp >> 6);
+          u[1] = (char)(0x80 | (cp & 0x3F));
+          n = 2;
+        } else if (cp < 0x10000) {
+          u[0] = (char)(0xE0 | cp >> 12);
+          u[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+          u[2] = (char)(0x80 | (cp & 0x3F));
+          n = 3;
+        } else {
+          u[0] = (char)(0xF0 | cp >> 18);
+          u[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+          u[2] = (char)(0x80 | (cp >> 6 & 0x3F));
+          u[3] = (char)(0x80 | (cp & 0x3F));
+          n = 4;
+        }
+        put(u, n);
+        continue;
+      }
+      default:
+        return false;
+    }
+    put(&c, 1);
+  }
+  /* Cut: drop a trailing partial UTF-8 sequence rather than show a broken glyph. */
+  if (cut && w > 0) {
+    size_t lead = w;
+    while (lead > 0 && ((uint8_t)out[lead - 1] & 0xC0) == 0x80)
+      lead--;
+    if (lead > 0 && ((uint8_t)out[lead - 1] & 0xC0) == 0xC0) {
+      const uint8_t b = (uint8_t)out[lead - 1];
+      const size_t need = b >= 0xF0 ? 4 : b >= 0xE0 ? 3 : 2;
+      if (w - (lead - 1) < need)
+        w = lead - 1;
+    }
+  }
+  out[w] = '\0';
+  return true;
+}
+
+bool MonitorDecoder::skipString() {
+  if (!expect('"'))
+    return false;
+  for (const char *q = p_; q < end_; q++) {
+    if (*q == '\\') {
+      q++;
+    } else if (*q == '"') {
+      p_ = q + 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* JSON number without strtod (no NUL needed, no locale). Integers stay exact; int fields given a
+ * fraction are truncated. */
+bool MonitorDecoder::readNumber(int *iv, float *fv) {
+  const char *p = p_;
+  const bool neg = p < end_ && *p == '-';
+  if (neg)
+    p++;
+  if (p >= end_ || !isDigit(*p))
+    return false;
+  uint64_t mant = 0;
+  int exp10 = 0;
+  bool integral = true;
+  for (; p < end_ && isDigit(*p); p++) {
+    if (mant < 100000000000000000ull)
+      mant = mant * 10 + (uint64_t)(*p - '0');
+    else
+      exp10++;
+  }
+  if (p < end_ && *p == '.') {
+    integral = false;
+    p++;
+    if (p >= end_ || !isDigit(*p))
+      return false;
+    for (; p < end_ && isDigit(*p); p++) {
+      if (mant < 100000000000000000ull) {
+        mant = mant * 10 + (uint64_t)(*p - '0');
+        exp10--;
+      }
+    }
+  }
+  if (p < end_ && (*p == 'e' || *p == 'E')) {
+    integral = false;
+    p++;
+    const bool eneg = p < end_ && *p == '-';
+    if (p < end_ && (*p == '-' || *p == '+'))
+      p++;
+    if (p >= end_ || !isDigit(*p))
+      return false;
+    int e = 0;
+    for (; p < end_ && isDigit(*p); p++)
+      if (e < 1000)
+        e = e * 10 + (*p - '0');
+    exp10 += eneg ? -e : e;
+  }
+  p_ = p;
+
+  float f = (float)mant;
+  if (exp10 > 38)
+    f = mant ? 3.4e38f : 0.0f;
+  else if (exp10 < -45)
+    f = 0.0f;
+  else
+    for (; exp10 != 0;) {
+      const int step = exp10 > 10 ? 10 : exp10 < -10 ? -10 : exp10;
+      f = step > 0 ? f * kPow10[step] : f / kPow10[-step];
+      exp10 -= step;
+    }
+  if (neg)
+    f = -f;
+  if (fv)
+    *fv = f;
+  if (iv) {
+    if (integral)
+      *iv = mant > 2147483647ull ? (neg ? -2147483647 - 1 : 2147483647) : (neg ? -(int)mant : (int)mant);
+    else
+      *iv = f >= 2147483647.0f ? 2147483647 : f <= -2147483648.0f ? -2147483647 - 1 : (int)f;
+  }
+  return true;
+}
+
+/* A value of another type (null, string) leaves the field at its default and is skipped. */
+bool MonitorDecoder::readInt(int *v) {
+  return (peek('-') || (p_ < end_ && isDigit(*p_))) ? readNumber(v, nullptr) : skipValue(0);
+}
+
+bool MonitorDecoder::readFloat(float *v) {
+  return (peek('-') || (p_ < end_ && isDigit(*p_))) ? readNumber(nullptr, v) : skipValue(0);
+}
+
+bool MonitorDecoder::readBool(bool *v) {
+  if (peek('t') || peek('f')) {
+    *v = peek('t');
+    return skipValue(0);
+  }
+  int i = 0;
+  if (peek('-') || (p_ < end_ && isDigit(*p_))) {
+    if (!readNumber(&i, nullptr))
+      return false;
+    *v = i != 0;
+    return true;
+  }
+  return skipValue(0);
+}
+
+bool MonitorDecoder::readIntArray(int *out, int n) {
+  if (!peek('['))
+    return skipValue(0);
+  p_++;
+  ws();
+  if (peek(']')) {
+    p_++;
+    return true;
+  }
+  for (int i = 0;; i++) {
+    ws();
+    if (!(i < n ? readInt(&out[i]) : skipValue(1)))
+      return false;
+    ws();
+    if (!peek(','))
+      return expect(']');
+    p_++;
+  }
+}
+
+bool MonitorDecoder::skipValue(uint8_t depth) {
+  if (p_ >= end_)
+    return false;
+  switch (*p_) {
+    case '"':
+      return skipString();
+    case 't':
+      if (end_ - p_ < 4 || memcmp(p_, "true", 4) != 0)
+        return false;
+      p_ += 4;
+      return true;
+    case 'f':
+      if (end_ - p_ < 5 || memcmp(p_, "false", 5) != 0)
+        return false;
+      p_ += 5;
+      return true;
+    case 'n':
+      if (end_ - p_ < 4 || memcmp(p_, "null", 4) != 0)
+        return false;
+      p_ += 4;
+      return true;
+    case '{':
+    case '[': {
+      const bool object = *p_ == '{';
+      const char close = object ? '}' : ']';
+      if (depth >= kMaxDepth)
+        return false;
+      p_++;
+      ws();
+      if (expect(close))
+        return true;
+      for (;;) {
+        ws();
+        if (object) {
+          if (!skipString())
+            return false;
+          ws();
+          if (!expect(':'))
+            return false;
+          ws();
+        }
+        if (!skipValue(depth + 1))
+          return false;
+        ws();
+        if (!peek(','))
+          return expect(close);
+        p_++;
+      }
+    }
+    default:
+      return readNumber(nullptr, nullptr);
+  }
+}
@@ -0,0 +1,95 @@
+/*
+ * NOCTURNE_OS — monitor payload decoder: one JSON line from the PC server into AppState in a single pass,
+ * no heap. A line is applied only once complete; one starting with "sb" (MonitorSubscription) is partial.
+ */
+#ifndef NOCTURNE_MONITOR_DECODER_H
+#define NOCTURNE_MONITOR_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "nocturne/StateFields.h"
+#include "nocturne/Types.h"
+
+class MonitorDecoder {
+ public:
+  static const size_t kNameMax = NOCT_PROC_NAME_MAX + 1; /* process names, bytes incl. NUL */
+  static const size_t kTextMax = NOCT_TEXT_MAX + 1;      /* artist, track, weather description */
+  /** Nesting accepted inside skipped values (ArduinoJson's default limit). */
+  static const uint8_t kMaxDepth = 10;
+
+  /** Decode one line (without the newline). False if it is not one well-formed JSON object; then
+   *  state is untouched. */
+  bool decode(const char *line, size_t len, AppState *state);
+
+  /** StateField bits the last successful decode changed in AppState. */
+  FieldMask changed() const { return changed_; }
+  /** Subscription generation ("sb") of the last successful line; -1 if it was a full line. */
+  int subscription() const { return sub_; }
+  /** Line number ("ln", tools/monitor_server) of the last successful line; -1 if it carried none. It
+   *  changes nothing in AppState: the device echoes it on Serial with NOCT_LINK_MARKS (LinkMarks). */
+  int mark() const { return mark_; }
+
+  uint32_t lines() const { return lines_; }
+  uint32_t errors() const { return errors_; }
+  uint32_t unknownKeys() const { return unknownKeys_; }
+
+ private:
+  struct Staged {
+    HardwareData hw;
+    bool weather;
+    int weatherTemp;
+    int weatherCode;
+    char weatherDesc[kTextMax];
+    char cpuNames[3][kNameMax];
+    int cpuPercent[3];
+    char ramNames[2][kNameMax];
+    int ramMb[2];
+    char artist[kTextMax];
+    char track[kTextMax];
+    bool playing;
+    bool idle;
+    bool statusPlaying;
+    bool alertCritical;
+    int alertScene;    /* -1 = no target_screen */
+    int alertMetric;   /* -2 = no alert_metric, -1 = unknown metric */
+    int sub;           /* "sb": subscription generation, -1 = full line */
+    int mark;          /* "ln": line number from a load generator, -1 = none */
+  };
+
+  void reset();
+  /** Staging from the current state, for partial (subscription) lines. */
+  void seed(const AppState &state);
+  bool parseMember();
+  bool parseField(uint8_t field);
+  bool parseHdd(int i);
+  bool parseProcess(char *name, int *value, char valueKey);
+  void apply(AppState *state);
+
+  /* Scanner over [p_, end_). Each returns false on malformed input. */
+  void ws();
+  bool expect(char c);
+  bool peek(char c);
+  bool readKey(const char **key, size_t *len);
+  bool readString(char *out, size_t cap);
+  bool readNumber(int *i, float *f);
+  bool readInt(int *v);
+  bool readFloat(float *v);
+  bool readBool(bool *v);
+  bool skipValue(uint8_t depth);
+  bool skipString();
+  /** Array of up to n ints; missing elements stay as they are, extra ones are skipped. */
+  bool readIntArray(int *out, int n);
+
+  const char *p_ = nullptr;
+  const char *end_ = nullptr;
+  Staged s_;
+
+  FieldMask changed_ = 0;
+  int sub_ = -1;
+  int mark_ = -1;
+  uint32_t lines_ = 0;
+  uint32_t errors_ = 0;
+  uint32_t unknownKeys_ = 0;
+};
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * NOCTURNE_OS — several monitor servers: host list, per-host loop state, overview.
+ */
+#include "MonitorHosts.h"
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+int clampInt(int v, int lo, int hi) { return v < lo ? lo : v > hi ? hi : v; }
+
+bool isSpace(char c) { return c == ' ' || c == '\t'; }
+
+/* [s, e) trimmed into out (cap with NUL); false if it does not fit. */
+bool copyTrimmed(const char *s, const char *e, char *out, size_t cap, bool truncate) {
+  while (s < e && isSpace(*s))
+    s++;
+  while (e > s && isSpace(e[-1]))
+    e--;
+  size_t n = (size_t)(e - s);
+  if (n >= cap) {
+    if (!truncate)
+      return false;
+    n = cap - 1;
+  }
+  memcpy(out, s, n);
+  out[n] = '\0';
+  return true;
+}
+
+/* Dotted quad; MonitorTcp::setServer checks it again with inet_pton. */
+bool validIp(const char *ip) {
+  int dots = 0, digits = 0;
+  for (const char *p = ip; *p; p++) {
+    if (*p == '.') {
+      if (digits == 0)
+        return false;
+      dots++;
+      digits = 0;
+    } else if (*p >= '0' && *p <= '9') {
+      if (++digits > 3)
+        return false;
+    } else {
+      return false;
+    }
+  }
+  return dots == 3 && digits > 0;
+}
+
+bool parseEntry(const char *s, const char *e, int index, HostAddr *out) {
+  const char *eq = (const char *)memchr(s, '=', (size_t)(e - s));
+  if (eq) {
+    if (!copyTrimmed(s, eq, out->name, sizeof(out->name), true))
+      return false;
+    s = eq + 1;
+  } else {
+    out->name[0] = '\0';
+  }
+  if (!out->name[0])
+    snprintf(out->name, sizeof(out->name), "PC%u", (unsigned)(uint8_t)(index + 1));
+  const char *colon = (const char *)memchr(s, ':', (size_t)(e - s));
+  if (!colon || !copyTrimmed(s, colon, out->ip, sizeof(out->ip), false) || !validIp(out->ip))
+    return false;
+  char port[8];
+  if (!copyTrimmed(colon + 1, e, port, sizeof(port), false) || !port[0])
+    return false;
+  uint32_t v = 0;
+  for (const char *p = port; *p; p++) {
+    if (*p < '0' || *p > '9')
+      return false;
+    v = v * 10 + (uint32_t)(*p - '0');
+  }
+  if (v == 0 || v > 65535)
+    return false;
+  out->port = (uint16_t)v;
+  return true;
+}
+
+}  // namespace
+
+bool HostSlot::signalLost(uint32_t nowMs) const {
+  /* Snapshot times come from the network task and may be a little ahead of the loop's now: signed. */
+  if (tcp && tcpConnectMs > 0 && (int32_t)(nowMs - tcpConnectMs) < NOCT_SIGNAL_GRACE_MS)
+    return false;
+  if (!firstData && tcp)
+    return (int32_t)(nowMs - tcpConnectMs) > NOCT_SIGNAL_GRACE_MS;
+  return (int32_t)(nowMs - lastDataMs) > NOCT_SIGNAL_TIMEOUT_MS;
+}
+
+int MonitorHosts::parse(const char *spec, HostAddr *out, int max) {
+  if (!spec || !out)
+    return -1;
+  int n = 0;
+  const char *s = spec;
+  const char *end = spec + strlen(spec);
+  while (isSpace(*s))
+    s++;
+  if (s == end)
+    return 0;
+  while (s <= end) {
+    const char *e = (const char *)memchr(s, ',', (size_t)(end - s));
+    if (!e)
+      e = end;
+    if (n < max) {
+      if (!parseEntry(s, e, n, &out[n]))
+        return -1;
+      n++;
+    }
+    s = e + 1;
+  }
+  return n;
+}
+
+MonitorHosts::MonitorHosts() { memset(slots_, 0, sizeof(slots_)); }
+
+bool MonitorHosts::add(const char *name) {
+  if (count_ >= kMax)
+    return false;
+  HostSlot &h = slots_[count_];
+  memset(&h, 0, sizeof(h));
+  if (name && name[0])
+    snprintf(h.name, sizeof(h.name), "%s", name);
+  else
+    snprintf(h.name, sizeof(h.name), "PC%u", (unsigned)(uint8_t)(count_ + 1));
+  count_++;
+  changed_ = true;
+  return true;
+}
+
+bool MonitorHosts::select(int i) {
+  if (i < 0 || i >= count_ || i == selected_)
+    return false;
+  selected_ = i;
+  changed_ = true;
+  return true;
+}
+
+bool MonitorHosts::update(int i, const MonitorSnapshot &s) {
+  if (i < 0 || i >= count_)
+    return false;
+  HostSlot &h = slots_[i];
+  if (h.wifi != s.wifi || h.tcp != s.tcp || h.udp != s.udp || h.search != s.search || h.firstData != s.firstData)
+    changed_ = true;
+  h.tcpConnectMs = s.tcpConnectMs;
+  h.lastDataMs = s.lastDataMs;
+  h.rssi = s.rssi;
+  h.wifi = s.wifi;
+  h.tcp = s.tcp;
+  h.udp = s.udp;
+  h.search = s.search;
+  h.firstData = s.firstData;
+  if (s.updates == h.updatesSeen)
+    return false;
+  h.updatesSeen = s.updates;
+
+  const HardwareData &hw = s.state.hw;
+  const int16_t ct = (int16_t)clampInt(hw.ct, -99, 999);
+  const int16_t gt = (int16_t)clampInt(hw.gt, -99, 999);
+  const uint8_t cl = (uint8_t)clampInt(hw.cl, 0, 100);
+  const uint8_t gl = (uint8_t)clampInt(hw.gl, 0, 100);
+  if (ct != h.ct || gt != h.gt || cl != h.cl || gl != h.gl || s.state.alertActive != h.alert)
+    changed_ = true;
+  h.ct = ct;
+  h.gt = gt;
+  h.cl = cl;
+  h.gl = gl;
+  h.alert = s.state.alertActive;
+
+  h.cpu[h.head] = cl;
+  h.gpu[h.head] = gl;
+  h.netDown[h.head] = (uint16_t)clampInt(hw.nd, 0, 65535);
+  h.netUp[h.head] = (uint16_t)clampInt(hw.nu, 0, 65535);
+  h.head = (uint8_t)((h.head + 1) % HostSlot::kHistory);
+  if (h.count < HostSlot::kHistory)
+    h.count++;
+  return true;
+}
+
+HostOverview MonitorHosts::overview(uint32_t nowMs) const {
+  HostOverview o;
+  o.hosts = count_;
+  for (int i = 0; i < count_; i++) {
+    const HostSlot &h = slots_[i];
+    if (!h.firstData || !h.linkUp() || h.signalLost(nowMs))
+      continue;
+    o.live++;
+    if (o.cpuTempHost < 0 || h.ct > o.cpuTemp) {
+      o.cpuTemp = h.ct;
+      o.cpuTempHost = i;
+    }
+    if (o.gpuTempHost < 0 || h.gt > o.gpuTemp) {
+      o.gpuTemp = h.gt;
+      o.gpuTempHost = i;
+    }
+    if (o.cpuLoadHost < 0 || h.cl > o.cpuLoad) {
+      o.cpuLoad = h.cl;
+      o.cpuLoadHost = i;
+    }
+    if (o.gpuLoadHost < 0 || h.gl > o.gpuLoad) {
+      o.gpuLoad = h.gl;
+      o.gpuLoadHost = i;
+    }
+  }
+  return o;
+}
+
+int MonitorHosts::alerting() const {
+  for (int i = 0; i < count_; i++)
+    if (i != selected_ && slots_[i].alert && slots_[i].linkUp())
+      return i;
+  return -1;
+}
@@ -0,0 +1,110 @@
+/*
+ * NOCTURNE_OS — several monitor servers at once: host list (PC_HOSTS in secrets.h), per-host render state
+ * and the overview across hosts. NOCT_MAX_HOSTS fixed slots, no AppState copies.
+ */
+#ifndef NOCTURNE_MONITOR_HOSTS_H
+#define NOCTURNE_MONITOR_HOSTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include "MonitorLink.h"
+#include "nocturne/config.h"
+
+/* Seven characters: what a row of the overview scene has room for. */
+static const size_t kHostNameMax = 8;
+
+/** One entry of the host list. */
+struct HostAddr {
+  char name[kHostNameMax];
+  char ip[16];
+  uint16_t port;
+};
+
+/** Render loop state of one host. */
+struct HostSlot {
+  static const int kHistory = NOCT_GRAPH_SAMPLES;
+
+  char name[kHostNameMax];
+  /* The host's last snapshot, as NetManager had them for the single server. */
+  uint32_t tcpConnectMs;
+  uint32_t lastDataMs;
+  uint32_t updatesSeen;
+  int rssi;
+  bool wifi, tcp, udp, search, firstData;
+  /* Overview values, clamped to what the scene prints. */
+  int16_t ct, gt;
+  uint8_t cl, gl;
+  bool alert;
+  /* One sample per update, as the display graphs are pushed; newest at head - 1. */
+  uint8_t cpu[kHistory], gpu[kHistory];
+  uint16_t netDown[kHistory], netUp[kHistory];
+  uint8_t head, count;
+
+  bool linkUp() const { return tcp || udp; }
+  /** No data for NOCT_SIGNAL_TIMEOUT_MS (none at all NOCT_SIGNAL_GRACE_MS after connecting). */
+  bool signalLost(uint32_t nowMs) const;
+  /** History sample age updates back (0 = newest, < count). */
+  int cpuAt(int age) const { return cpu[slot(age)]; }
+  int gpuAt(int age) const { return gpu[slot(age)]; }
+  int netDownAt(int age) const { return netDown[slot(age)]; }
+  int netUpAt(int age) const { return netUp[slot(age)]; }
+
+ private:
+  int slot(int age) const { return (head + kHistory - 1 - age) % kHistory; }
+};
+
+/** Worst values across the hosts with live data; host -1 when none has any. */
+struct HostOverview {
+  int hosts = 0; /* configured */
+  int live = 0;  /* data flowing, signal not lost */
+  int cpuTemp = 0, cpuTempHost = -1;
+  int gpuTemp = 0, gpuTempHost = -1;
+  int cpuLoad = 0, cpuLoadHost = -1;
+  int gpuLoad = 0, gpuLoadHost = -1;
+};
+
+class MonitorHosts {
+ public:
+  static const int kMax = NOCT_MAX_HOSTS;
+
+  /** "name=ip:port,ip:port,...": entries split by commas, name optional (then "PC<n>", truncated to
+   *  kHostNameMax - 1 otherwise), spaces around entries ignored. Entries past max are dropped. Number of
+   *  entries, or -1 if one is malformed (nothing usable is assumed from a typo). */
+  static int parse(const char *spec, HostAddr *out, int max);
+
+  MonitorHosts();
+
+  /** Append a host (before the network task starts). False when kMax are configured. */
+  bool add(const char *name);
+  int count() const { return count_; }
+  /** Slot i; slot 0 (empty) while none is configured. */
+  const HostSlot &host(int i) const { return slots_[i >= 0 && i < count_ ? i : 0]; }
+
+  int selected() const { return selected_; }
+  /** Show host i on the per-host scenes. True if that is a change. */
+  bool select(int i);
+  /** The host after the selected one, wrapping. */
+  int next() const { return count_ > 0 ? (selected_ + 1) % count_ : 0; }
+
+  /** Fold in host i's newest snapshot: status, overview values and, when it carries new data, one history
+   *  sample. True if it did. */
+  bool update(int i, const MonitorSnapshot &s);
+  /** A value or status the overview shows changed on any host since the last call. */
+  bool takeChanged() {
+    const bool c = changed_;
+    changed_ = false;
+    return c;
+  }
+
+  HostOverview overview(uint32_t nowMs) const;
+  /** A host other than the selected one with an alert up, or -1. */
+  int alerting() const;
+
+ private:
+  HostSlot slots_[kMax];
+  int count_ = 0;
+  int selected_ = 0;
+  bool changed_ = false;
+};
+
+#endif
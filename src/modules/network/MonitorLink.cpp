@@ -0,0 +1,243 @@
+/*
+ * NOCTURNE_OS — the monitor link's network side.
+ */
+#include "MonitorLink.h"
+#include <cstdio>
+#include <cstring>
+#include "nocturne/config.h"
+
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+static uint32_t clockUs() { return (uint32_t)esp_timer_get_time(); }
+#else
+#include <chrono>
+#include <sys/select.h>
+static uint32_t clockUs() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+#endif
+
+static size_t readTcp(void *ctx, char *dst, size_t cap) { return ((MonitorTcp *)ctx)->read(dst, cap); }
+
+bool MonitorLink::setServer(const char *ip, uint16_t port) {
+  if (!tcp_.setServer(ip, port))
+    return false;
+#if NOCT_MONITOR_UDP
+  udp_.setServer(ip, port);
+#endif
+  return true;
+}
+
+void MonitorLink::setScreen(int scene, int nextScene) {
+  screen_.store((uint32_t)(scene & 0xFFFF) << 16 | (uint32_t)(nextScene & 0xFFFF), std::memory_order_relaxed);
+}
+
+void MonitorLink::closeTcp() {
+  tcp_.close();
+  framer_.reset();
+  sentScreen_ = kNoScreen;
+  if (tcpUp_ || tcpConnectMs_ != 0)
+    dirty_ = true;
+  tcpUp_ = false;
+  tcpConnectMs_ = 0;
+}
+
+void MonitorLink::close() {
+  closeTcp();
+  udp_.close();
+  if (udpAlive_)
+    dirty_ = true;
+  udpAlive_ = false;
+  if (dirty_)
+    publish();
+}
+
+bool MonitorLink::service(uint32_t nowMs, bool wifiUp, int rssi) {
+  const uint32_t updatesBefore = updates_;
+  if (disconnect_.exchange(false, std::memory_order_relaxed)) {
+    closeTcp();
+    udp_.close();
+    udpAlive_ = false;
+  }
+  if (wifiUp != wifi_ || rssi != rssi_)
+    dirty_ = true;
+  wifi_ = wifiUp;
+  rssi_ = rssi;
+
+  if (!wifiUp || !active()) {
+    if (tcp_.fd() >= 0 || udp_.isOpen()) {
+      closeTcp();
+      udp_.close();
+      udpAlive_ = false;
+    }
+    if (!wifiUp && !search_) {
+      search_ = true;
+      dirty_ = true;
+    }
+  } else {
+#if NOCT_MONITOR_UDP
+    if (!udp_.isOpen())
+      udp_.begin();
+#endif
+    if (udpAlive_) {
+      // Datagrams arrive: UDP carries the session, the stream is not needed.
+      if (tcp_.fd() >= 0)
+        closeTcp();
+    } else {
+      tcp_.poll(nowMs);
+      if (tcp_.takeConnected()) {
+        framer_.reset();
+        framer_.setEveryLine(false);
+        binary_.reset();
+        sentScreen_ = kNoScreen;
+        tcpUp_ = true;
+        tcpConnectMs_ = nowMs ? nowMs : 1;
+        lastDataMs_ = nowMs;
+        dirty_ = true;
+        tcp_.write(NOCT_MONITOR_BINARY ? "HELO bin=1\n" : "HELO\n", NOCT_MONITOR_BINARY ? 11 : 5);
+      }
+    }
+    receive(nowMs);
+    if (tcpUp_ && !tcp_.connected()) {
+      // Peer closed or reset: search until the next connect or datagram.
+      closeTcp();
+      search_ = true;
+    }
+    const bool search = !tcpUp_ && !udpAlive_ ? search_ : false;
+    if (search != search_)
+      dirty_ = true;
+    search_ = search;
+    sendScreen();
+  }
+  if (!dirty_ && updates_ == updatesBefore)
+    return false;
+  publish();
+  return true;
+}
+
+void MonitorLink::receive(uint32_t nowMs) {
+  bool data = false;
+  if (udp_.isOpen()) {
+    if (udp_.poll(nowMs, &work_)) {
+      changed_ |= udp_.changed();
+      data = true;
+    }
+    const bool alive = udp_.alive(nowMs);
+    if (alive != udpAlive_) {
+      // Either transport may have seen the last screen:N; resend on the new one.
+      sentScreen_ = kNoScreen;
+      search_ = !alive; // UDP went silent: fall back to TCP
+      udpAlive_ = alive;
+      dirty_ = true;
+    }
+  }
+  char *line;
+  size_t len;
+  if (tcpUp_ && framer_.pump(readTcp, &tcp_, clockUs, NOCT_TCP_RX_BUDGET_US)) {
+    if (framer_.binary()) {
+      while (framer_.takeLine(&line, &len)) {
+        if (binary_.decode((const uint8_t *)line, len, &work_)) {
+          changed_ |= binary_.changed();
+          data = true;
+        }
+      }
+    } else {
+      while (framer_.takeLine(&line, &len)) {
+        const uint32_t t0 = clockUs();
+        if (parsePayload(line, len, &work_)) {
+          changed_ |= decoder_.changed();
+          if (decoder_.mark() >= 0)
+            mark_ = decoder_.mark();
+          data = true;
+        }
+        parseUs_ += clockUs() - t0;
+      }
+    }
+  }
+  if (data) {
+    updates_++;
+    lastDataMs_ = nowMs;
+    firstData_ = true;
+  }
+}
+
+void MonitorLink::sendScreen() {
+  const uint32_t want = screen_.load(std::memory_order_relaxed);
+  if (want == kNoScreen || want == sentScreen_ || !(tcpUp_ || udpAlive_))
+    return;
+  const int scene = (int16_t)(want >> 16);
+  char msg[16 + MonitorSubscription::kLineMax];
+  size_t n = (size_t)snprintf(msg, sizeof(msg), "screen:%d\n", scene);
+#if NOCT_MONITOR_SUBSCRIBE
+  sub_.forScene(scene, (int16_t)(want & 0xFFFF));
+  n += sub_.format(++subGen_, msg + n, sizeof(msg) - n);
+  // Partial lines from here on: each carries changes the next one may not repeat.
+  framer_.setEveryLine(true);
+#endif
+  msg[n] = '\0';
+  if (udpAlive_ ? udp_.send(msg) : tcp_.write(msg, n))
+    sentScreen_ = want;
+}
+
+void MonitorLink::publish() {
+  MonitorSnapshot &s = out_.back();
+  s.state = work_;
+  /* A snapshot the loop has not taken yet is about to be replaced: its changes ride along. */
+  s.changed = changed_ | (out_.pending() ? lastChanged_ : 0);
+  lastChanged_ = s.changed;
+  changed_ = 0;
+  s.updates = updates_;
+  s.lastDataMs = lastDataMs_;
+  s.tcpConnectMs = tcpConnectMs_;
+  s.rssi = rssi_;
+  s.wifi = wifi_;
+  s.tcp = tcpUp_;
+  s.udp = udpAlive_;
+  s.search = search_;
+  s.firstData = firstData_;
+  s.parsed = decoder_.lines();
+  s.rejected = decoder_.errors();
+  s.parseUs = parseUs_;
+  s.mark = mark_;
+  out_.publish();
+  published_++;
+  dirty_ = false;
+}
+
+bool MonitorLink::wait(uint32_t ms) { return waitAny(this, 1, ms); }
+
+bool MonitorLink::waitAny(MonitorLink *links, int n, uint32_t ms) {
+  fd_set rd, wr;
+  FD_ZERO(&rd);
+  FD_ZERO(&wr);
+  int maxFd = -1;
+  for (int i = 0; i < n; i++) {
+    const MonitorLink &l = links[i];
+    if (l.tcp_.fd() >= 0) {
+      FD_SET(l.tcp_.fd(), &rd);
+      if (l.tcp_.wantsWrite())
+        FD_SET(l.tcp_.fd(), &wr);
+      if (l.tcp_.fd() > maxFd)
+        maxFd = l.tcp_.fd();
+    }
+    if (l.udp_.fd() >= 0) {
+      FD_SET(l.udp_.fd(), &rd);
+      if (l.udp_.fd() > maxFd)
+        maxFd = l.udp_.fd();
+    }
+  }
+  if (maxFd < 0)
+    return false;
+  timeval tv = {(long)(ms / 1000), (long)(ms % 1000) * 1000};
+  select(maxFd + 1, &rd, &wr, nullptr, &tv);
+  return true;
+}
+
+bool MonitorLink::parsePayload(const char *line, size_t lineLen, AppState *state) {
+  if (!state || !line || lineLen == 0)
+    return false;
+  return decoder_.decode(line, lineLen, state);
+}
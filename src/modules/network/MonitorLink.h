@@ -0,0 +1,134 @@
+/*
+ * NOCTURNE_OS — the monitor link's network side (TCP, UDP, decoders, screen / subscription commands), run
+ * in NetManager's network task. Snapshots reach the render loop through a TripleBuffer; requests come back
+ * through atomics only.
+ */
+#ifndef NOCTURNE_MONITOR_LINK_H
+#define NOCTURNE_MONITOR_LINK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "LineFramer.h"
+#include "MonitorBinary.h"
+#include "MonitorDecoder.h"
+#include "MonitorSubscription.h"
+#include "MonitorTcp.h"
+#include "MonitorUdp.h"
+#include "TripleBuffer.h"
+#include "nocturne/StateFields.h"
+#include "nocturne/Types.h"
+
+/** One hand-off to the render loop: the monitor part of AppState and the link status. */
+struct MonitorSnapshot {
+  AppState state; /* hw, weather, media, process, alert (battery and settings are the loop's) */
+  /** Fields changed since the snapshot the reader took before this one. */
+  FieldMask changed = 0;
+  /** Lines, frames and datagrams applied so far; advances with every one. */
+  uint32_t updates = 0;
+  uint32_t lastDataMs = 0;
+  uint32_t tcpConnectMs = 0; /* when the stream came up; 0 while down */
+  int rssi = 0;
+  bool wifi = false;
+  bool tcp = false;
+  bool udp = false;
+  bool search = false;
+  bool firstData = false;
+  /* JSON lines parsed since the link was created, rejected ones among them, and the time spent in
+   * parsePayload() on them; the "ln" of the newest line applied (-1: none carried one). LinkMarks. */
+  uint32_t parsed = 0;
+  uint32_t rejected = 0;
+  uint32_t parseUs = 0;
+  int32_t mark = -1;
+};
+
+class MonitorLink {
+ public:
+  MonitorLink() = default;
+  MonitorLink(const MonitorLink &) = delete;
+  MonitorLink &operator=(const MonitorLink &) = delete;
+
+  /** Server for TCP and UDP; false if the address does not parse. Network side, before it runs. */
+  bool setServer(const char *ip, uint16_t port);
+
+  /* ── Render loop side (any thread) ── */
+
+  /** Monitoring wanted (MODE_NORMAL, no menu). While false the sockets are closed. */
+  void setActive(bool on) { active_.store(on, std::memory_order_relaxed); }
+  bool active() const { return active_.load(std::memory_order_relaxed); }
+  /** Scene on screen and the one prefetched; sent (with its subscription) once per change and again after
+   *  every reconnect. */
+  void setScreen(int scene, int nextScene);
+  /** Close TCP and UDP on the next step (signal lost); both are reopened after it. */
+  void requestDisconnect() { disconnect_.store(true, std::memory_order_relaxed); }
+  /** Switch snapshot() to the newest one published. False if nothing new. */
+  bool take() { return out_.take(); }
+  const MonitorSnapshot &snapshot() const { return out_.front(); }
+
+  /* ── Network side (one thread) ── */
+
+  /** One step: connection, receive and decode, screen command, hand-off. Never waits. True if a snapshot
+   *  was published. */
+  bool service(uint32_t nowMs, bool wifiUp, int rssi);
+  /** Sleep until a socket is readable (or a pending connect / send is writable), at most ms. False at
+   *  once if no socket is open: the caller sleeps instead. */
+  bool wait(uint32_t ms);
+  /** wait() over the sockets of n links (NetManager, one per host). */
+  static bool waitAny(MonitorLink *links, int n, uint32_t ms);
+  /** Close both sockets now (suspend). */
+  void close();
+
+  /** Parse one JSON line into AppState. True on success; on false (malformed or truncated line) AppState
+   *  is untouched. */
+  bool parsePayload(const char *line, size_t lineLen, AppState *state);
+
+  const MonitorTcp &tcp() const { return tcp_; }
+  const LineFramer &framer() const { return framer_; }
+  const MonitorBinaryDecoder &binaryDecoder() const { return binary_; }
+  const MonitorUdp &udp() const { return udp_; }
+  /** Snapshots published over one the loop never took. */
+  uint32_t replaced() const { return out_.replaced(); }
+  uint32_t published() const { return published_; }
+
+ private:
+  static const uint32_t kNoScreen = 0xFFFFFFFF;
+
+  void closeTcp();
+  void receive(uint32_t nowMs);
+  void sendScreen();
+  void publish();
+
+  std::atomic<bool> active_{false};
+  std::atomic<uint32_t> screen_{kNoScreen}; /* scene << 16 | next */
+  std::atomic<bool> disconnect_{false};
+
+  MonitorTcp tcp_;
+  LineFramer framer_;
+  MonitorDecoder decoder_;
+  MonitorBinaryDecoder binary_;
+  MonitorUdp udp_;
+  MonitorSubscription sub_;
+  uint16_t subGen_ = 0;
+  uint32_t sentScreen_ = kNoScreen;
+
+  AppState work_;
+  FieldMask changed_ = 0;
+  FieldMask lastChanged_ = 0; /* in the last snapshot published */
+  uint32_t updates_ = 0;
+  uint32_t parseUs_ = 0;
+  int32_t mark_ = -1;
+  uint32_t lastDataMs_ = 0;
+  uint32_t tcpConnectMs_ = 0;
+  int rssi_ = 0;
+  bool wifi_ = false;
+  bool tcpUp_ = false;
+  bool udpAlive_ = false;
+  bool search_ = false;
+  bool firstData_ = false;
+  bool dirty_ = true; /* status changed since the last snapshot */
+
+  TripleBuffer<MonitorSnapshot> out_;
+  uint32_t published_ = 0;
+};
+
+#endif
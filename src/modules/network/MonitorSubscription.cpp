@@ -0,0 +1,157 @@
+/*
+ * NOCTURNE_OS — scene-scoped field subscriptions.
+ */
+#include "MonitorSubscription.h"
+#include <cstdio>
+#include <cstring>
+#include "nocturne/config.h"
+
+namespace {
+
+/* Indexed by StateField. */
+const char *const kKeys[SF_COUNT] = {
+    "ct", "gt", "cl", "gl", "cc", "pw", "gh", "gv", "gclock", "vclock", "gtdp", "ru", "ra", "nd", "nu",
+    "pg", "cf", "s1", "s2", "gf", "fans", "fan_controls", "hdd", "vu", "vt", "ch", "mb_sys", "mb_vsoc",
+    "mb_vrm", "mb_chipset", "dr", "dw", "wt", "tp", "tr", "art", "trk", "mp", "alert", nullptr};
+
+struct Rate {
+  StateField field;
+  uint32_t periodMs;
+};
+
+/* What each scene draws (RedrawGate::sceneFields, minus the local battery) and how often it is worth
+ * redrawing. Loads move fastest; temperatures, clocks and fan speeds lag them by seconds. */
+const Rate kMain[] = {{SF_CT, 1000}, {SF_GT, 1000}, {SF_CL, 250}, {SF_GL, 250}, {SF_RU, 1000}, {SF_RA, 10000}};
+const Rate kCpu[] = {{SF_CT, 500}, {SF_CC, 250}, {SF_CL, 100}, {SF_PW, 250}};
+const Rate kGpu[] = {{SF_GH, 500}, {SF_GCLOCK, 250}, {SF_GL, 100}, {SF_VU, 1000}};
+const Rate kRam[] = {{SF_TOP_RAM, 2000}, {SF_RU, 500}, {SF_RA, 10000}};
+const Rate kDisks[] = {{SF_HDD, 5000}};
+const Rate kMedia[] = {{SF_ARTIST, 500}, {SF_TRACK, 500}, {SF_MEDIA_STATE, 250}};
+const Rate kFans[] = {{SF_CF, 1000}, {SF_S1, 1000}, {SF_GF, 1000}, {SF_S2, 1000}, {SF_FAN_CONTROLS, 1000}};
+const Rate kBoard[] = {{SF_MB_SYS, 2000}, {SF_MB_VSOC, 2000}, {SF_MB_VRM, 2000}, {SF_MB_CHIPSET, 2000}};
+const Rate kWeather[] = {{SF_WEATHER, 60000}};
+/* Overview across hosts; also all a host that is not selected is asked for. Net rates keep its graph history. */
+const Rate kHosts[] = {{SF_CT, 1000}, {SF_GT, 1000}, {SF_CL, 500}, {SF_GL, 500}, {SF_ND, 1000}, {SF_NU, 1000}};
+
+struct SceneRates {
+  const Rate *rates;
+  size_t n;
+};
+
+#define NOCT_RATES(a) {a, sizeof(a) / sizeof(a[0])}
+const SceneRates kScenes[NOCT_TOTAL_SCENES] = {
+    NOCT_RATES(kMain), NOCT_RATES(kCpu),   NOCT_RATES(kGpu),   NOCT_RATES(kRam),     NOCT_RATES(kDisks),
+    NOCT_RATES(kMedia), NOCT_RATES(kFans), NOCT_RATES(kBoard), NOCT_RATES(kWeather),
+};
+const SceneRates kHostsRates = NOCT_RATES(kHosts);
+#undef NOCT_RATES
+
+const SceneRates &sceneRates(int scene) {
+  if (scene == NOCT_SCENE_HOSTS)
+    return kHostsRates;
+  /* Unknown index: SceneManager falls back to MAIN. */
+  return kScenes[scene >= 0 && scene < NOCT_TOTAL_SCENES ? scene : 0];
+}
+
+bool readUint(const char **p, const char *end, uint32_t max, uint32_t *out) {
+  const char *s = *p;
+  uint32_t v = 0;
+  while (*p < end && **p >= '0' && **p <= '9') {
+    v = v * 10 + (uint32_t)(**p - '0');
+    if (v > max)
+      return false;
+    (*p)++;
+  }
+  *out = v;
+  return *p != s;
+}
+
+}  // namespace
+
+const char *MonitorSubscription::keyName(StateField f) { return f < SF_COUNT ? kKeys[f] : nullptr; }
+
+void MonitorSubscription::clear() {
+  for (int i = 0; i < SF_COUNT; i++)
+    period_[i] = kOff;
+  mask_ = 0;
+  gen_ = 0;
+}
+
+void MonitorSubscription::set(StateField f, uint32_t periodMs) {
+  if (f >= SF_COUNT || !kKeys[f])
+    return;
+  period_[f] = periodMs;
+  if (periodMs == kOff)
+    mask_ &= ~fieldBit(f);
+  else
+    mask_ |= fieldBit(f);
+}
+
+void MonitorSubscription::forScene(int scene, int nextScene) {
+  clear();
+  const SceneRates &next = sceneRates(nextScene);
+  for (size_t i = 0; i < next.n; i++)
+    set(next.rates[i].field, next.rates[i].periodMs < kPrefetchMs ? kPrefetchMs : next.rates[i].periodMs);
+  /* The visible scene's rate wins where both draw a field. */
+  const SceneRates &cur = sceneRates(scene);
+  for (size_t i = 0; i < cur.n; i++)
+    set(cur.rates[i].field, cur.rates[i].periodMs);
+  set(SF_ALERT, kOnChange);
+}
+
+size_t MonitorSubscription::format(uint16_t gen, char *out, size_t cap) const {
+  if (!out || cap == 0)
+    return 0;
+  int n = snprintf(out, cap, "sub:%u ", (unsigned)gen);
+  if (n < 0 || (size_t)n >= cap)
+    return 0;
+  size_t len = (size_t)n;
+  bool first = true;
+  for (int i = 0; i < SF_COUNT; i++) {
+    if (period_[i] == kOff)
+      continue;
+    n = snprintf(out + len, cap - len, "%s%s@%lu", first ? "" : ",", kKeys[i], (unsigned long)period_[i]);
+    if (n < 0 || (size_t)n >= cap - len)
+      return 0;
+    len += (size_t)n;
+    first = false;
+  }
+  if (len + 2 > cap)
+    return 0;
+  out[len++] = '\n';
+  out[len] = '\0';
+  return len;
+}
+
+bool MonitorSubscription::parse(const char *line, size_t len) {
+  if (!line || len < 4 || memcmp(line, "sub:", 4) != 0)
+    return false;
+  const char *p = line + 4, *end = line + len;
+  while (end > p && (end[-1] == '\r' || end[-1] == ' '))
+    end--;
+  uint32_t gen;
+  if (!readUint(&p, end, 0xFFFF, &gen))
+    return false;
+  MonitorSubscription next;
+  next.gen_ = (uint16_t)gen;
+  if (p < end && *p++ != ' ')
+    return false;
+  while (p < end) {
+    const char *key = p;
+    while (p < end && *p != '@' && *p != ',')
+      p++;
+    const size_t keyLen = (size_t)(p - key);
+    uint32_t period;
+    if (keyLen == 0 || p == end || *p++ != '@' || !readUint(&p, end, kPeriodMax, &period))
+      return false;
+    if (p < end && *p++ != ',')
+      return false;
+    for (int i = 0; i < SF_COUNT; i++)
+      if (kKeys[i] && strlen(kKeys[i]) == keyLen && memcmp(kKeys[i], key, keyLen) == 0) {
+        next.set((StateField)i, period);
+        break;
+      }
+  }
+  *this = next;
+  return true;
+}
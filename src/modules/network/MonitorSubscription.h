@@ -0,0 +1,51 @@
+/*
+ * NOCTURNE_OS — scene-scoped field subscriptions: "sub:<gen> <key>@<ms>,..." asks the PC server for only
+ * the fields the visible (and next) scene draws, each at its own rate. Protocol: tools/monitor_server/README.md.
+ */
+#ifndef NOCTURNE_MONITOR_SUBSCRIPTION_H
+#define NOCTURNE_MONITOR_SUBSCRIPTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include "nocturne/StateFields.h"
+
+class MonitorSubscription {
+ public:
+  static const uint32_t kOff = 0xFFFFFFFFu;
+  static const uint32_t kOnChange = 0;
+  /** Floor for the next scene's fields: fresh enough on arrival, cheap while another scene shows. */
+  static const uint32_t kPrefetchMs = 2000;
+  static const uint32_t kKeepaliveMs = 1000;
+  static const uint32_t kPeriodMax = 600000;
+  static const size_t kLineMax = 256;
+
+  MonitorSubscription() { clear(); }
+
+  /** Device: the set for scene, plus nextScene's fields at no more than one update per kPrefetchMs. */
+  void forScene(int scene, int nextScene);
+  /** "sub:<gen> ...\n" into out; 0 if cap is too small. */
+  size_t format(uint16_t gen, char *out, size_t cap) const;
+
+  /** Server: one command line (without the newline). False if malformed; then the set is unchanged.
+   *  Unknown keys are skipped, so a newer device can subscribe to fields an older server lacks. */
+  bool parse(const char *line, size_t len);
+
+  void clear();
+  void set(StateField f, uint32_t periodMs);
+  uint32_t period(StateField f) const { return period_[f]; }
+  bool has(StateField f) const { return period_[f] != kOff; }
+  /** Subscribed StateField bits. */
+  FieldMask fields() const { return mask_; }
+  uint16_t generation() const { return gen_; }
+
+  /** JSON key that names the field group on the wire ("wt" also covers wd/wi, "mp" idle/media_status,
+   *  "alert" target_screen/alert_metric); nullptr for fields that do not come from the server (battery). */
+  static const char *keyName(StateField f);
+
+ private:
+  uint32_t period_[SF_COUNT];
+  FieldMask mask_;
+  uint16_t gen_;
+};
+
+#endif
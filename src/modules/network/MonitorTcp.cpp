@@ -0,0 +1,23 @@
+/*
+ * NOCTURNE_OS — TCP stream to the monitor server: reconnect policy.
+ */
+#include "MonitorTcp.h"
+
+bool MonitorTcp::setServer(const char *ip, uint16_t port) {
+  if (!sock_.setServer(ip, port))
+    return false;
+  tried_ = false;
+  return true;
+}
+
+void MonitorTcp::poll(uint32_t nowMs) {
+  if (sock_.idle()) {
+    if (sock_.hasServer() && (!tried_ || nowMs - lastTryMs_ >= kRetryMs)) {
+      tried_ = true;
+      lastTryMs_ = nowMs;
+      sock_.connect(nowMs, true);
+    }
+    return;
+  }
+  sock_.poll(nowMs, kConnectTimeoutMs);
+}
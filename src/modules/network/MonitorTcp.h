@@ -0,0 +1,55 @@
+/*
+ * NOCTURNE_OS — TCP stream to the monitor server over TcpStream: a fresh attempt every kRetryMs while
+ * down, each given kConnectTimeoutMs.
+ */
+#ifndef NOCTURNE_MONITOR_TCP_H
+#define NOCTURNE_MONITOR_TCP_H
+
+#include <cstddef>
+#include <cstdint>
+#include "MonitorSubscription.h"
+#include "TcpStream.h"
+#include "nocturne/config.h"
+
+class MonitorTcp {
+ public:
+  static const uint32_t kConnectTimeoutMs = NOCT_TCP_CONNECT_TIMEOUT_MS;
+  static const uint32_t kRetryMs = NOCT_TCP_RECONNECT_INTERVAL_MS;
+  /** HELO, or screen:N with its subscription line. */
+  static const size_t kTxMax = 32 + MonitorSubscription::kLineMax;
+
+  MonitorTcp() = default;
+  MonitorTcp(const MonitorTcp &) = delete;
+  MonitorTcp &operator=(const MonitorTcp &) = delete;
+
+  /** IPv4 address and port; false if the address does not parse. Closes an open connection. */
+  bool setServer(const char *ip, uint16_t port);
+  /** Advance the connection: start an attempt every kRetryMs while down, finish or time out a pending
+   *  one, flush. Never waits. */
+  void poll(uint32_t nowMs);
+  bool connected() const { return sock_.connected(); }
+  bool connecting() const { return sock_.connecting(); }
+  /** The connection came up since the last call (send HELO, start framing afresh). */
+  bool takeConnected() { return sock_.takeConnected(); }
+  /** Up to cap bytes already received; 0 if none. A closed or reset peer closes the connection. */
+  size_t read(char *buf, size_t cap) { return sock_.read(buf, cap); }
+  /** Queue and send what the socket takes now; false if down or the text does not fit. */
+  bool write(const char *data, size_t len) { return sock_.write(data, len); }
+  /** Close now; the next attempt follows the retry interval. */
+  void close() { sock_.close(); }
+  int fd() const { return sock_.fd(); }
+  bool wantsWrite() const { return sock_.wantsWrite(); }
+
+  uint32_t connects() const { return sock_.connects(); }
+  uint32_t failures() const { return sock_.failures(); }
+  uint32_t drops() const { return sock_.drops(); }
+  uint32_t connectMs() const { return sock_.connectMs(); }
+
+ private:
+  char tx_[kTxMax];
+  TcpStream sock_{tx_, kTxMax};
+  bool tried_ = false;
+  uint32_t lastTryMs_ = 0;
+};
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * NOCTURNE_OS — monitor telemetry over UDP.
+ */
+#include "MonitorUdp.h"
+#include <cerrno>
+#include <cstring>
+
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+#include <fcntl.h>
+#include <lwip/sockets.h>
+#include <unistd.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+static const char kHelo[] = "HELO udp=1\n";
+static const int kMaxDatagramsPerPoll = 32;
+
+/* ── UdpSequence ── */
+
+bool UdpSequence::accept(uint16_t seq) {
+  if (!started_) {
+    started_ = true;
+    last_ = seq;
+    window_ = 0;
+    accepted_++;
+    return true;
+  }
+  const int16_t d = (int16_t)(uint16_t)(seq - last_);
+  if (d > 0) {
+    lost_ += (uint32_t)(d - 1);
+    window_ = d >= 32 ? 0 : (window_ << d) | (1u << (d - 1));
+    last_ = seq;
+    accepted_++;
+    return true;
+  }
+  if (d == 0) {
+    duplicates_++;
+    return false;
+  }
+  const int back = -d - 1; /* bit index: seq == last_ - 1 - back */
+  if (back < 32 && !(window_ & (1u << back))) {
+    window_ |= 1u << back;
+    reordered_++;
+    if (lost_ > 0)
+      lost_--;
+  } else if (back < 32) {
+    duplicates_++;
+  } else {
+    reordered_++; /* too old to tell; was counted lost */
+  }
+  return false;
+}
+
+void UdpSequence::reset() {
+  started_ = false;
+  last_ = 0;
+  window_ = 0;
+}
+
+/* ── MonitorUdp ── */
+
+bool MonitorUdp::begin(uint16_t localPort) {
+  close();
+  fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd_ < 0)
+    return false;
+  sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_ANY);
+  a.sin_port = htons(localPort);
+  socklen_t alen = sizeof(a);
+  if (bind(fd_, (sockaddr *)&a, sizeof(a)) != 0 || fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK) != 0 ||
+      getsockname(fd_, (sockaddr *)&a, &alen) != 0) {
+    close();
+    return false;
+  }
+  localPort_ = ntohs(a.sin_port);
+  return true;
+}
+
+bool MonitorUdp::setServer(const char *ip, uint16_t port) {
+  in_addr a;
+  if (!ip || inet_pton(AF_INET, ip, &a) != 1 || port == 0)
+    return false;
+  addr_ = a.s_addr;
+  port_ = port;
+  heloSent_ = false;
+  return true;
+}
+
+void MonitorUdp::close() {
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+  localPort_ = 0;
+  heloSent_ = false;
+  received_ = false;
+  seq_.reset();
+}
+
+bool MonitorUdp::send(const char *text) {
+  if (fd_ < 0 || addr_ == 0 || !text)
+    return false;
+  sockaddr_in to;
+  memset(&to, 0, sizeof(to));
+  to.sin_family = AF_INET;
+  to.sin_addr.s_addr = addr_;
+  to.sin_port = htons(port_);
+  const size_t n = strlen(text);
+  return sendto(fd_, text, n, 0, (const sockaddr *)&to, sizeof(to)) == (ssize_t)n;
+}
+
+bool MonitorUdp::poll(uint32_t nowMs, AppState *state) {
+  if (fd_ < 0 || addr_ == 0)
+    return false;
+  if (!heloSent_ || nowMs - lastHeloMs_ >= kHeartbeatMs) {
+    send(kHelo);
+    heloSent_ = true;
+    lastHeloMs_ = nowMs;
+  }
+
+  /* Drain; keep only the newest in-sequence datagram. */
+  int cur = 0, best = -1;
+  size_t bestLen = 0;
+  for (int i = 0; i < kMaxDatagramsPerPoll; i++) {
+    sockaddr_in from;
+    socklen_t flen = sizeof(from);
+    const ssize_t n = recvfrom(fd_, rx_[cur], kDatagramMax, MSG_DONTWAIT, (sockaddr *)&from, &flen);
+    if (n < 0)
+      break;
+    if (from.sin_addr.s_addr != addr_)
+      continue;
+    const uint8_t *d = rx_[cur];
+    if ((size_t)n < kHeader || d[0] != kMagic || (d[1] != kTypeBinary && d[1] != kTypeJson)) {
+      malformed_++;
+      continue;
+    }
+    if (!seq_.accept((uint16_t)(d[2] | d[3] << 8)))
+      continue;
+    best = cur;
+    bestLen = (size_t)n;
+    cur ^= 1;
+  }
+  if (best < 0 || !apply(rx_[best], bestLen, state))
+    return false;
+  received_ = true;
+  lastRxMs_ = nowMs;
+  return true;
+}
+
+bool MonitorUdp::apply(const uint8_t *d, size_t len, AppState *state) {
+  const uint8_t *payload = d + kHeader;
+  const size_t plen = len - kHeader;
+  const bool ok = d[1] == kTypeBinary ? binary_.decode(payload, plen, state)
+                                      : json_.decode((const char *)payload, plen, state);
+  if (!ok) {
+    malformed_++;
+    return false;
+  }
+  changed_ = d[1] == kTypeBinary ? binary_.changed() : json_.changed();
+  lastSentMs_ = (uint32_t)d[4] | (uint32_t)d[5] << 8 | (uint32_t)d[6] << 16 | (uint32_t)d[7] << 24;
+  return true;
+}
+
+size_t MonitorUdp::pack(uint8_t type, uint16_t seq, uint32_t sentMs, const uint8_t *payload, size_t len,
+                        uint8_t *out, size_t cap) {
+  if (!out || kHeader + len > cap || kHeader + len > kDatagramMax)
+    return 0;
+  out[0] = kMagic;
+  out[1] = type;
+  out[2] = (uint8_t)(seq & 0xFF);
+  out[3] = (uint8_t)(seq >> 8);
+  for (int i = 0; i < 4; i++)
+    out[4 + i] = (uint8_t)(sentMs >> (8 * i));
+  if (len)
+    memcpy(out + kHeader, payload, len);
+  return kHeader + len;
+}
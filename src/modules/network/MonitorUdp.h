@@ -0,0 +1,101 @@
+/*
+ * NOCTURNE_OS — monitor telemetry over UDP (BSD sockets, lwIP and Linux): every datagram a whole snapshot,
+ * the newest wins. "HELO udp=1" every kHeartbeatMs; MonitorLink falls back to TCP after kSilentMs.
+ */
+#ifndef NOCTURNE_MONITOR_UDP_H
+#define NOCTURNE_MONITOR_UDP_H
+
+#include <cstddef>
+#include <cstdint>
+#include "MonitorBinary.h"
+#include "MonitorDecoder.h"
+#include "nocturne/Types.h"
+
+/** Drop-old acceptance over a 16-bit sequence, with loss / reorder / duplicate accounting. */
+class UdpSequence {
+ public:
+  /** True if seq is newer than everything accepted so far. */
+  bool accept(uint16_t seq);
+  void reset();
+
+  uint32_t accepted() const { return accepted_; }
+  /** Sequence numbers skipped and not (yet) seen late. */
+  uint32_t lost() const { return lost_; }
+  /** Arrived after a newer one (dropped; no longer counted as lost). */
+  uint32_t reordered() const { return reordered_; }
+  uint32_t duplicates() const { return duplicates_; }
+
+ private:
+  bool started_ = false;
+  uint16_t last_ = 0;
+  uint32_t window_ = 0; /* bit n: last_ - 1 - n was received */
+  uint32_t accepted_ = 0;
+  uint32_t lost_ = 0;
+  uint32_t reordered_ = 0;
+  uint32_t duplicates_ = 0;
+};
+
+class MonitorUdp {
+ public:
+  static const uint32_t kHeartbeatMs = 1000;
+  static const uint32_t kSilentMs = 2500;
+  static const size_t kDatagramMax = 1472; /* one Ethernet-sized IPv4 datagram */
+  /** Datagram: kMagic, type (kTypeBinary keyframe / kTypeJson line), seq u16 LE, server ms u32 LE, payload. */
+  static const size_t kHeader = 8;
+  static const uint8_t kMagic = 'N';
+  static const uint8_t kTypeBinary = 'B';
+  static const uint8_t kTypeJson = 'J';
+
+  MonitorUdp() = default;
+  ~MonitorUdp() { close(); }
+  MonitorUdp(const MonitorUdp &) = delete;
+  MonitorUdp &operator=(const MonitorUdp &) = delete;
+
+  /** Non-blocking socket on localPort (0 = any). */
+  bool begin(uint16_t localPort = 0);
+  bool setServer(const char *ip, uint16_t port);
+  void close();
+  bool isOpen() const { return fd_ >= 0; }
+  /** Socket to wait on (select), -1 if closed. */
+  int fd() const { return fd_; }
+  uint16_t localPort() const { return localPort_; }
+
+  /** Heartbeat when due, then drain the socket and apply the newest datagram. True if state changed. */
+  bool poll(uint32_t nowMs, AppState *state);
+  /** A datagram was applied within kSilentMs. */
+  bool alive(uint32_t nowMs) const { return received_ && nowMs - lastRxMs_ < kSilentMs; }
+  /** Command to the server ("screen:3"). */
+  bool send(const char *text);
+
+  /** PC side / tests: header + payload into out. 0 if it does not fit. */
+  static size_t pack(uint8_t type, uint16_t seq, uint32_t sentMs, const uint8_t *payload, size_t len,
+                     uint8_t *out, size_t cap);
+
+  const UdpSequence &sequence() const { return seq_; }
+  uint32_t malformed() const { return malformed_; }
+  /** Server clock of the applied datagram (data age = server now - this). */
+  uint32_t lastSentMs() const { return lastSentMs_; }
+  /** StateField bits the last applied datagram changed. */
+  FieldMask changed() const { return changed_; }
+
+ private:
+  bool apply(const uint8_t *d, size_t len, AppState *state);
+
+  int fd_ = -1;
+  uint16_t localPort_ = 0;
+  uint32_t addr_ = 0; /* network byte order */
+  uint16_t port_ = 0;
+  bool heloSent_ = false;
+  uint32_t lastHeloMs_ = 0;
+  bool received_ = false;
+  uint32_t lastRxMs_ = 0;
+  uint32_t lastSentMs_ = 0;
+  FieldMask changed_ = 0;
+  UdpSequence seq_;
+  uint32_t malformed_ = 0;
+  uint8_t rx_[2][kDatagramMax];
+  MonitorBinaryDecoder binary_;
+  MonitorDecoder json_;
+};
+
+#endif
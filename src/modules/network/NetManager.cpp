@@ -2,15 +2,16 @@
 #if NOCT_FEATURE_MONITORING
 
 /*
- * NOCTURNE_OS тАФ NetManager: WiFi, TCP, JSON parse. WiFi.setSleep(false) after
+ * NOCTURNE_OS тАФ NetManager: WiFi and the network task (MonitorLink). WiFi.setSleep(false) after
  * connect.
  */
 #include "NetManager.h"
 #include "nocturne/Types.h"
 #include "nocturne/config.h"
-#include <ArduinoJson.h>
 #include <esp_wifi.h>
 #include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 // --- WIFI DIAGNOSTICS INTERCEPTOR ---
 void WiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
@@ -60,12 +61,17 @@ void WiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
   }
 }
 
+#if NOCT_NET_TASK
+// Core 0 with the Wi-Fi / lwIP tasks; loop() (UI, I-Bus, buttons) keeps core 1.
+static void Task_Net(void *arg) {
+  NetManager *net = (NetManager *)arg;
+  for (;;)
+    net->service(millis());
+}
+#endif
+
 NetManager::NetManager()
-    : serverIp_(nullptr), serverPort_(0), lastTcpAttempt_(0),
-      tcpConnectTime_(0), lastUpdate_(0), lastWifiRetry_(0),
-      wifiConnected_(false), tcpConnected_(false), firstDataReceived_(false),
-      searchMode_(false), rssi_(0), lastSentScreen_(-1), lineBufferLen_(0) {
-  lineBuffer_[0] = '\0';
+    : wifiConnected_(false), rssi_(0) {
   storedSSID_[0] = '\0';
   storedPass_[0] = '\0';
 }
@@ -100,280 +106,178 @@ void NetManager::begin(const char *ssid, const char *pass) {
   esp_wifi_set_ps(WIFI_PS_NONE);
 }
 
-void NetManager::setServer(const char *ip, uint16_t port) {
-  serverIp_ = ip;
-  serverPort_ = port;
-}
-
-void NetManager::setSuspend(bool suspend) {
-  suspended_ = suspend;
-  if (suspend) {
-    disconnectTcp();
-    Serial.println("[NET] Logic Suspended.");
-  } else {
-    lastWifiRetry_ = 0;
-    Serial.println("[NET] Logic Resumed.");
+bool NetManager::addHost(const char *name, const char *ip, uint16_t port) {
+  const int i = hosts_.count();
+  if (i >= MonitorHosts::kMax) {
+    Serial.printf("[NET] More than %d hosts, %s ignored\n", MonitorHosts::kMax, ip);
+    return false;
+  }
+  if (!links_[i].setServer(ip, port)) {
+    Serial.printf("[NET] Bad server address %s\n", ip ? ip : "(null)");
+    return false;
   }
+  hosts_.add(name);
+  return true;
 }
 
-void NetManager::tick(unsigned long now) {
-  if (suspended_)
+void NetManager::setServer(const char *ip, uint16_t port) {
+  if (taskStarted_)
     return;
-  if (WiFi.status() == WL_CONNECTED) {
-    if (!wifiConnected_) {
-      wifiConnected_ = true;
-      WiFi.setSleep(false); // MANDATORY: keep ping < 10ms for real-time graphs
-      esp_wifi_set_ps(WIFI_PS_NONE); // V4: disable aggressive S3 power saving
-    }
-    if (now % 5000 < 100)
-      rssi_ = WiFi.RSSI();
-
-    if (!client_.connected()) {
-      if (tcpConnected_) {
-        disconnectTcp();
-        searchMode_ = true;
-      }
-      tryTcpConnect(now);
-    } else {
-      tcpConnected_ = true;
-      searchMode_ = false;
-    }
-  } else {
-    wifiConnected_ = false;
-    if (tcpConnected_)
-      disconnectTcp();
-    searchMode_ = true;
-    if (now - lastWifiRetry_ > NOCT_WIFI_RETRY_INTERVAL_MS) {
-      WiFi.disconnect();
-      WiFi.begin(storedSSID_, storedPass_);
-      lastWifiRetry_ = now;
-    }
-  }
+  addHost("PC", ip, port);
+  startTask();
 }
 
-void NetManager::disconnectTcp() {
-  if (client_.connected())
-    client_.stop();
-  lineBuffer_[0] = '\0';
-  lineBufferLen_ = 0;
-  lastSentScreen_ = -1;
-  tcpConnected_ = false;
-  tcpConnectTime_ = 0;
+void NetManager::setServers(const char *hosts) {
+  if (taskStarted_)
+    return;
+  HostAddr list[MonitorHosts::kMax];
+  const int n = MonitorHosts::parse(hosts, list, MonitorHosts::kMax);
+  if (n < 0)
+    Serial.printf("[NET] Bad host list \"%s\"\n", hosts ? hosts : "");
+  for (int i = 0; i < n; i++)
+    addHost(list[i].name, list[i].ip, list[i].port);
+  Serial.printf("[NET] %d host(s), %u bytes each\n", hosts_.count(),
+                (unsigned)(sizeof(MonitorLink) + sizeof(HostSlot)));
+  startTask();
 }
 
-void NetManager::markDataReceived(unsigned long now) {
-  lastUpdate_ = now;
-  firstDataReceived_ = true;
+void NetManager::startTask() {
+#if NOCT_NET_TASK
+  if (taskStarted_ || hosts_.count() == 0)
+    return;
+  taskStarted_ = xTaskCreatePinnedToCore(Task_Net, "NetTask",
+                                         NOCT_NET_TASK_STACK, this,
+                                         NOCT_NET_TASK_PRIO, nullptr,
+                                         NOCT_NET_TASK_CORE) == pdPASS;
+  if (!taskStarted_)
+    Serial.println("[NET] Network task not created.");
+#endif
 }
 
-bool NetManager::tryTcpConnect(unsigned long now) {
-  if (!serverIp_ || serverPort_ == 0)
-    return false;
-  if (now - lastTcpAttempt_ < NOCT_TCP_RECONNECT_INTERVAL_MS)
-    return false;
-  if (client_.connected())
-    return true;
-
-  lastTcpAttempt_ = now;
-  client_.setTimeout(NOCT_TCP_CONNECT_TIMEOUT_MS / 1000);
+void NetManager::setActive(bool on) {
+  for (int i = 0; i < hosts_.count(); i++)
+    links_[i].setActive(on);
+  wifiRetry_.setWanted(NOCT_WIFI_USER_MONITOR, on && hosts_.count() > 0);
+}
 
-  if (client_.connect(serverIp_, serverPort_)) {
-    lineBuffer_[0] = '\0';
-    lineBufferLen_ = 0;
-    lastSentScreen_ = -1;
-    tcpConnected_ = true;
-    tcpConnectTime_ = now;
-    lastUpdate_ = now;
-    client_.print("HELO\n");
-    return true;
+void NetManager::setScreen(int scene, int nextScene) {
+  for (int i = 0; i < hosts_.count(); i++) {
+    if (i == hosts_.selected())
+      links_[i].setScreen(scene, nextScene);
+    else
+      links_[i].setScreen(NOCT_SCENE_HOSTS, NOCT_SCENE_HOSTS);
   }
-  return false;
 }
 
-bool NetManager::isSignalLost(unsigned long now) const {
-  if (tcpConnected_ && tcpConnectTime_ > 0) {
-    unsigned long since = now - tcpConnectTime_;
-    if (since < NOCT_SIGNAL_GRACE_MS)
-      return false;
-  }
-  if (!firstDataReceived_ && tcpConnected_)
-    return (now - tcpConnectTime_ > NOCT_SIGNAL_GRACE_MS);
-  return (now - lastUpdate_ > NOCT_SIGNAL_TIMEOUT_MS);
+bool NetManager::selectHost(int i) {
+  if (!hosts_.select(i))
+    return false;
+  reload_ = true;
+  return true;
 }
 
-void NetManager::appendLineBuffer(char c) {
-  if (lineBufferLen_ < NOCT_TCP_LINE_MAX - 1) {
-    lineBuffer_[lineBufferLen_] = c;
-    lineBufferLen_++;
-    lineBuffer_[lineBufferLen_] = '\0';
+void NetManager::setSuspend(bool suspend) {
+  suspended_.store(suspend);
+  if (suspend) {
+    // The caller turns Wi-Fi off next: wait for the network task to let go of
+    // it (one step plus its wait, NOCT_NET_WAIT_MS).
+    for (int i = 0; taskStarted_ && i < 50 && !parked_.load(); i++)
+      vTaskDelay(pdMS_TO_TICKS(NOCT_NET_WAIT_MS));
+    if (!taskStarted_)
+      for (int i = 0; i < hosts_.count(); i++)
+        links_[i].close();
+    Serial.println("[NET] Logic Suspended.");
   } else {
-    // Buffer overflow - clear it
-    clearLineBuffer();
+    Serial.println("[NET] Logic Resumed.");
   }
 }
 
-void NetManager::clearLineBuffer() {
-  lineBuffer_[0] = '\0';
-  lineBufferLen_ = 0;
-}
-
-bool NetManager::parsePayload(const char *line, size_t lineLen,
-                              AppState *state) {
-  if (!state || !line || lineLen == 0)
-    return false;
-  JsonDocument doc;
-  DeserializationError err = deserializeJson(doc, line, lineLen);
-  if (err)
-    return false;
-
-  HardwareData &hw = state->hw;
-  hw.ct = doc["ct"] | 0;
-  hw.gt = doc["gt"] | 0;
-  hw.cl = doc["cl"] | 0;
-  hw.gl = doc["gl"] | 0;
-  hw.cc = doc["cc"] | 0;
-  hw.pw = doc["pw"] | 0;
-  hw.gh = doc["gh"] | 0;
-  hw.gv = doc["gv"] | 0;
-  hw.gclock = doc["gclock"] | 0;
-  hw.vclock = doc["vclock"] | 0;
-  hw.gtdp = doc["gtdp"] | 0;
-  hw.ru = doc["ru"] | 0.0f;
-  hw.ra = doc["ra"] | 0.0f;
-  hw.nd = doc["nd"] | 0;
-  hw.nu = doc["nu"] | 0;
-  hw.pg = doc["pg"] | 0;
-  hw.cf = doc["cf"] | 0;
-  hw.s1 = doc["s1"] | 0;
-  hw.s2 = doc["s2"] | 0;
-  hw.gf = doc["gf"] | 0;
-  JsonArray fansArr = doc["fans"];
-  for (int i = 0; i < NOCT_FAN_COUNT && i < (int)fansArr.size(); i++)
-    hw.fans[i] = fansArr[i] | 0;
-  JsonArray fanControlsArr = doc["fan_controls"];
-  for (int i = 0; i < NOCT_FAN_COUNT && i < (int)fanControlsArr.size(); i++)
-    hw.fan_controls[i] = fanControlsArr[i] | 0;
-  JsonArray hddArr = doc["hdd"];
-  for (int i = 0; i < NOCT_HDD_COUNT && i < (int)hddArr.size(); i++) {
-    const char *n = hddArr[i]["n"];
-    if (n && n[0]) {
-      hw.hdd[i].name[0] = n[0];
-      hw.hdd[i].name[1] = '\0';
-    } else {
-      hw.hdd[i].name[0] = (char)('C' + i);
-      hw.hdd[i].name[1] = '\0';
-    }
-    hw.hdd[i].used_gb = hddArr[i]["u"] | 0.0f;
-    hw.hdd[i].total_gb = hddArr[i]["tot"] | 0.0f;
-    hw.hdd[i].temp = hddArr[i]["t"] | 0;
-  }
-  for (int i = (int)hddArr.size(); i < NOCT_HDD_COUNT; i++) {
-    hw.hdd[i].name[0] = (char)('C' + i);
-    hw.hdd[i].name[1] = '\0';
-    hw.hdd[i].used_gb = 0.0f;
-    hw.hdd[i].total_gb = 0.0f;
-    hw.hdd[i].temp = 0;
-  }
-  hw.vu = doc["vu"] | 0.0f;
-  hw.vt = doc["vt"] | 0.0f;
-  hw.ch = doc["ch"] | 0;
-  hw.mb_sys = doc["mb_sys"] | 0;
-  hw.mb_vsoc = doc["mb_vsoc"] | 0;
-  hw.mb_vrm = doc["mb_vrm"] | 0;
-  hw.mb_chipset = doc["mb_chipset"] | 0;
-  hw.dr = doc["dr"] | 0;
-  hw.dw = doc["dw"] | 0;
-
-  if (!doc["wt"].isNull()) {
-    state->weather.temp = doc["wt"] | 0;
-    const char *wd = doc["wd"];
-    state->weather.desc = String(wd ? wd : "");
-    state->weather.wmoCode = doc["wi"] | 0;
-    if (state->weather.desc.length() > 0 || state->weather.temp != 0 ||
-        state->weather.wmoCode != 0)
-      state->weatherReceived = true;
+void NetManager::service(unsigned long now) {
+  const int n = hosts_.count();
+  if (suspended_.load()) {
+    for (int i = 0; i < n; i++)
+      links_[i].close();
+    parked_.store(true);
+#if NOCT_NET_TASK
+    vTaskDelay(pdMS_TO_TICKS(NOCT_NET_WAIT_MS));
+#endif
+    return;
   }
-
-  JsonArray tp = doc["tp"];
-  for (int i = 0; i < 3; i++) {
-    if (i < (int)tp.size()) {
-      const char *n = tp[i]["n"];
-      state->process.cpuNames[i] = String(n ? n : "");
-      state->process.cpuPercent[i] = tp[i]["c"] | 0;
-    } else {
-      state->process.cpuNames[i] = "";
-      state->process.cpuPercent[i] = 0;
+  if (parked_.exchange(false))
+    wifiRetry_.retryNow(); // resumed: retry Wi-Fi at once
+  bool wifiUp = wifiUp_;
+  if (wifiRetry_.wanted()) {
+    wifiUp = WiFi.status() == WL_CONNECTED;
+    if (wifiUp) {
+      if (!wifiUp_) {
+        WiFi.setSleep(false); // MANDATORY: keep ping < 10ms for real-time graphs
+        esp_wifi_set_ps(WIFI_PS_NONE); // V4: disable aggressive S3 power saving
+        lastRssiMs_ = now - 5000;
+      }
+      if (now - lastRssiMs_ >= 5000) {
+        wifiRssi_ = WiFi.RSSI();
+        lastRssiMs_ = now;
+      }
     }
-  }
-
-  JsonArray tr = doc["tr"];
-  for (int i = 0; i < 2; i++) {
-    if (i < (int)tr.size()) {
-      const char *n = tr[i]["n"];
-      state->process.ramNames[i] = String(n ? n : "");
-      state->process.ramMb[i] = tr[i]["r"] | 0;
-    } else {
-      state->process.ramNames[i] = "";
-      state->process.ramMb[i] = 0;
+    if (wifiRetry_.step((uint32_t)now, wifiUp)) {
+      WiFi.disconnect();
+      WiFi.begin(storedSSID_, storedPass_);
     }
+    wifiUp_ = wifiUp;
   }
+  for (int i = 0; i < n; i++)
+    links_[i].service((uint32_t)now, wifiUp, wifiRssi_);
+#if NOCT_NET_TASK
+  // Sleep until a server sends something (or a connect finishes); with no
+  // socket open, just sleep.
+  if (!MonitorLink::waitAny(links_, n, NOCT_NET_WAIT_MS))
+    vTaskDelay(pdMS_TO_TICKS(NOCT_NET_WAIT_MS));
+#endif
+}
 
-  const char *art = doc["art"];
-  const char *trk = doc["trk"];
-  state->media.artist = String(art ? art : "");
-  state->media.track = String(trk ? trk : "");
-  state->media.isPlaying = doc["mp"] | false;
-  state->media.isIdle = doc["idle"] | false;
-  const char *ms = doc["media_status"];
-  state->media.mediaStatus =
-      String(ms && strcmp(ms, "PLAYING") == 0 ? "PLAYING" : "PAUSED");
-
-  const char *alert = doc["alert"];
-  const char *target = doc["target_screen"];
-  const char *metric = doc["alert_metric"];
-  state->alertActive = (alert && strcmp(alert, "CRITICAL") == 0);
-  if (state->alertActive && target) {
-    if (strcmp(target, "MAIN") == 0)
-      state->alertTargetScene = NOCT_SCENE_MAIN;
-    else if (strcmp(target, "CPU") == 0)
-      state->alertTargetScene = NOCT_SCENE_CPU;
-    else if (strcmp(target, "GPU") == 0)
-      state->alertTargetScene = NOCT_SCENE_GPU;
-    else if (strcmp(target, "RAM") == 0)
-      state->alertTargetScene = NOCT_SCENE_RAM;
-    else if (strcmp(target, "DISKS") == 0)
-      state->alertTargetScene = NOCT_SCENE_DISKS;
-    else if (strcmp(target, "MEDIA") == 0)
-      state->alertTargetScene = NOCT_SCENE_MEDIA;
-    else if (strcmp(target, "FANS") == 0)
-      state->alertTargetScene = NOCT_SCENE_FANS;
-    else if (strcmp(target, "MOTHERBOARD") == 0)
-      state->alertTargetScene = NOCT_SCENE_MOTHERBOARD;
-    else
-      state->alertTargetScene = NOCT_SCENE_MAIN;
+bool NetManager::receive(unsigned long now, AppState *state) {
+#if !NOCT_NET_TASK
+  service(now);
+#endif
+  const int sel = hosts_.selected();
+  bool fresh = false;
+  for (int i = 0; i < hosts_.count(); i++) {
+    if (!links_[i].take())
+      continue;
+    const MonitorSnapshot &s = links_[i].snapshot();
+    const bool data = hosts_.update(i, s);
+    if (i != sel)
+      continue;
+    wifiConnected_ = s.wifi;
+    rssi_ = s.rssi;
+    changed_ |= s.changed;
+    fresh = data;
   }
-  if (state->alertActive && metric) {
-    if (strcmp(metric, "ct") == 0)
-      state->alertMetric = NOCT_ALERT_CT;
-    else if (strcmp(metric, "gt") == 0)
-      state->alertMetric = NOCT_ALERT_GT;
-    else if (strcmp(metric, "cl") == 0)
-      state->alertMetric = NOCT_ALERT_CL;
-    else if (strcmp(metric, "gl") == 0)
-      state->alertMetric = NOCT_ALERT_GL;
-    else if (strcmp(metric, "gv") == 0)
-      state->alertMetric = NOCT_ALERT_GV;
-    else if (strcmp(metric, "ram") == 0)
-      state->alertMetric = NOCT_ALERT_RAM;
-    else
-      state->alertMetric = -1;
+  if (reload_) {
+    // Host switched: what AppState holds is another machine's.
+    reload_ = false;
+    fresh = true;
+    changed_ = ~(FieldMask)0;
   }
-  if (!state->alertActive) {
-    state->alertTargetScene = NOCT_SCENE_MAIN;
-    state->alertMetric = -1;
+  // The loop drops the selected host when its signal is lost; the others
+  // are not on screen, so here.
+  for (int i = 0; i < hosts_.count(); i++) {
+    const HostSlot &h = hosts_.host(i);
+    if (i != sel && h.linkUp() && h.firstData && h.signalLost((uint32_t)now))
+      links_[i].requestDisconnect();
   }
-
-  return true;
+  if (fresh && state) {
+    const AppState &src = links_[sel].snapshot().state;
+    state->hw = src.hw;
+    state->weather = src.weather;
+    state->media = src.media;
+    state->process = src.process;
+    state->weatherReceived = src.weatherReceived;
+    state->alertActive = src.alertActive;
+    state->alertTargetScene = src.alertTargetScene;
+    state->alertMetric = src.alertMetric;
+  }
+  return fresh;
 }
 
 #endif // NOCT_FEATURE_MONITORING
@@ -1,7 +1,8 @@
 /*
- * NOCTURNE_OS тАФ NetManager: WiFi (reconnect), TCP stream, JSON parsing
- * (ArduinoJson) MANDATORY: WiFi.setSleep(false) after connection for ping <
- * 10ms.
+ * NOCTURNE_OS тАФ NetManager: WiFi (reconnect) and the network task running
+ * one MonitorLink (TCP / UDP, decoding) per host; the render loop takes
+ * AppState snapshots of the selected host and MonitorHosts keeps the rest.
+ * MANDATORY: WiFi.setSleep(false) after connection for ping < 10ms.
  */
 #ifndef NOCTURNE_NET_MANAGER_H
 #define NOCTURNE_NET_MANAGER_H
@@ -9,7 +10,10 @@
 #include "nocturne/config.h"
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WiFiClient.h>
+#include <atomic>
+#include "MonitorHosts.h"
+#include "MonitorLink.h"
+#include "WifiRetry.h"
 
 
 struct AppState;
@@ -18,56 +22,97 @@ class NetManager {
 public:
   NetManager();
   void begin(const char *ssid, const char *pass);
+  /** One server (PC_IP / TCP_PORT) and start the network task. */
   void setServer(const char *ip, uint16_t port);
-  void tick(unsigned long now);
+  /** Several servers, "name=ip:port,..." (PC_HOSTS, MonitorHosts::parse),
+   * at most NOCT_MAX_HOSTS; then the network task. */
+  void setServers(const char *hosts);
 
+  /* Status of the selected host as of the last snapshot receive() took. */
   bool isWifiConnected() const { return wifiConnected_; }
-  bool isTcpConnected() const { return tcpConnected_; }
-  bool hasReceivedData() const { return firstDataReceived_; }
+  bool isTcpConnected() const { return selected().tcp; }
+  /** Datagrams from the server arrive (MonitorUdp); the TCP stream is closed meanwhile. */
+  bool isUdpAlive() const { return selected().udp; }
+  /** Monitoring data flows over either transport. */
+  bool isLinkUp() const { return selected().linkUp(); }
+  bool hasReceivedData() const { return selected().firstData; }
   int rssi() const { return rssi_; }
-  bool isSearchMode() const { return searchMode_; }
-  bool isSignalLost(unsigned long now) const;
+  bool isSearchMode() const { return selected().search; }
+  bool isSignalLost(unsigned long now) const { return selected().signalLost((uint32_t)now); }
 
-  int available() { return client_.available(); }
-  int read() { return client_.read(); }
-  size_t print(const String &s) { return client_.print(s); }
-  size_t print(const char *s) { return client_.print(s); }
+  /* Hosts: the per-host scenes draw the selected one; the others send only
+   * what the overview scene (NOCT_SCENE_HOSTS) shows. */
+  const MonitorHosts &hosts() const { return hosts_; }
+  int hostCount() const { return hosts_.count(); }
+  int selectedHost() const { return hosts_.selected(); }
+  const char *hostName(int i) const { return hosts_.host(i).name; }
+  /** Show host i: the next receive() copies all of its data into AppState
+   * and reports every field changed. True if that is a change. */
+  bool selectHost(int i);
+  /** Overview values or host status changed since the last call. */
+  bool takeHostsChanged() { return hosts_.takeChanged(); }
 
+  /** Stop all networking (Wi-Fi off, scanning, other modes); returns once the
+   * network task has closed its sockets and stays off Wi-Fi. */
   void setSuspend(bool suspend);
-  void disconnectTcp();
-  void markDataReceived(unsigned long now);
-  void appendLineBuffer(char c);
-  void clearLineBuffer();
-  char *getLineBuffer() { return lineBuffer_; }
-  size_t getLineBufferLen() const { return lineBufferLen_; }
-  int getLastSentScreen() const { return lastSentScreen_; }
-  void setLastSentScreen(int s) { lastSentScreen_ = s; }
+  /** Monitoring wanted: while false the link is closed and Wi-Fi is not
+   * retried (unless setWantWifi()). */
+  void setActive(bool on);
+  /** Another user of the station (OBD over TCP in BMW mode): Wi-Fi is
+   * re-joined while set, even with monitoring off. */
+  void setWantWifi(bool on) { wifiRetry_.setWanted(NOCT_WIFI_USER_OBD, on); }
+  /** Close the selected host's TCP and UDP; both are reopened by the network
+   * task. (Other hosts are dropped by receive() when their signal is lost.) */
+  void disconnect() { links_[hosts_.selected()].requestDisconnect(); }
+  /** Scene on screen and the next carousel scene: "screen:<scene>" and, with
+   * NOCT_MONITOR_SUBSCRIBE, the scene's field subscription (prefetching
+   * nextScene) go out to the selected host once per change and after every
+   * reconnect; the other hosts are on the overview's. */
+  void setScreen(int scene, int nextScene);
 
-  /** Parse one newline-terminated JSON line into AppState. Returns true on
-   * success. */
-  bool parsePayload(const char *line, size_t lineLen, AppState *state);
+  /** Take the newest snapshots from the network task (with NOCT_NET_TASK=0,
+   * run one network step first): status and history of every host, and the
+   * selected host's monitor fields of AppState (not battery or settings)
+   * copied into *state. Never waits. True if new data arrived for it. */
+  bool receive(unsigned long now, AppState *state);
+  /** The selected host's snapshot as of the last receive() (link counters
+   * for LinkMarks). */
+  const MonitorSnapshot &snapshot() const {
+    return links_[hosts_.selected()].snapshot();
+  }
+  /** StateField bits changed by receive() since the last call; clears them. */
+  FieldMask takeChanges() {
+    FieldMask m = changed_;
+    changed_ = 0;
+    return m;
+  }
+
+  /** One network step: Wi-Fi reconnect, then MonitorLink::service() of
+   * every host. The network task runs it in a loop. */
+  void service(unsigned long now);
 
 private:
-  bool tryTcpConnect(unsigned long now);
+  const HostSlot &selected() const { return hosts_.host(hosts_.selected()); }
+  bool addHost(const char *name, const char *ip, uint16_t port);
+  void startTask();
 
   char storedSSID_[33]; // Max SSID length is 32 + null terminator
   char storedPass_[65]; // Max password length is 64 + null terminator
-  WiFiClient client_;
-  char lineBuffer_[NOCT_TCP_LINE_MAX];
-  size_t lineBufferLen_;
-  const char *serverIp_;
-  uint16_t serverPort_;
-  unsigned long lastTcpAttempt_;
-  unsigned long tcpConnectTime_;
-  unsigned long lastUpdate_;
-  unsigned long lastWifiRetry_;
+  MonitorLink links_[NOCT_MAX_HOSTS];
+  MonitorHosts hosts_;
+  bool taskStarted_ = false;
+  std::atomic<bool> suspended_{false};
+  std::atomic<bool> parked_{false}; // network task saw suspended_, sockets closed
+  FieldMask changed_ = 0;
+  bool reload_ = false; // host switched: copy all of its state
+  // Network side
+  WifiRetry wifiRetry_{NOCT_WIFI_RETRY_INTERVAL_MS};
+  unsigned long lastRssiMs_ = 0;
+  bool wifiUp_ = false;
+  int wifiRssi_ = 0;
+  // Loop side: Wi-Fi as of the last snapshot (the rest is in hosts_)
   bool wifiConnected_;
-  bool tcpConnected_;
-  bool firstDataReceived_;
-  bool searchMode_;
-  bool suspended_ = false;
   int rssi_;
-  int lastSentScreen_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,144 @@
+/*
+ * NOCTURNE_OS — non-blocking TCP client socket.
+ */
+#include "TcpStream.h"
+#include <cerrno>
+#include <cstring>
+
+#if defined(ESP32) || defined(ARDUINO_ARCH_ESP32)
+#include <fcntl.h>
+#include <lwip/sockets.h>
+#include <unistd.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static bool wouldBlock(int e) { return e == EAGAIN || e == EWOULDBLOCK || e == EINTR; }
+
+bool TcpStream::setServer(const char *ip, uint16_t port) {
+  in_addr a;
+  if (!ip || inet_pton(AF_INET, ip, &a) != 1 || port == 0)
+    return false;
+  close();
+  addr_ = a.s_addr;
+  port_ = port;
+  return true;
+}
+
+void TcpStream::close() {
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+  state_ = TCP_IDLE;
+  txLen_ = 0;
+  justConnected_ = false;
+}
+
+void TcpStream::drop() {
+  if (state_ == TCP_UP)
+    drops_++;
+  close();
+}
+
+TcpStream::Event TcpStream::connect(uint32_t nowMs, bool noDelay) {
+  if (state_ != TCP_IDLE || addr_ == 0)
+    return TCP_EV_NONE;
+  startMs_ = nowMs;
+  fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd_ < 0)
+    return fail();
+  fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+  int one = noDelay ? 1 : 0;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port_);
+  sa.sin_addr.s_addr = addr_;
+  state_ = TCP_CONNECTING;
+  if (::connect(fd_, (const sockaddr *)&sa, sizeof(sa)) == 0)
+    return finishConnect(nowMs, UINT32_MAX);
+  if (errno != EINPROGRESS && errno != EWOULDBLOCK)
+    return fail();
+  return TCP_EV_NONE;
+}
+
+TcpStream::Event TcpStream::poll(uint32_t nowMs, uint32_t connectTimeoutMs) {
+  if (state_ == TCP_CONNECTING)
+    return finishConnect(nowMs, connectTimeoutMs);
+  if (state_ == TCP_UP && txLen_ > 0 && !flush()) {
+    drop();
+    return TCP_EV_DROPPED;
+  }
+  return TCP_EV_NONE;
+}
+
+/* Writable = connect finished, SO_ERROR says how. Zero timeout: never waits. */
+TcpStream::Event TcpStream::finishConnect(uint32_t nowMs, uint32_t connectTimeoutMs) {
+  fd_set wr;
+  FD_ZERO(&wr);
+  FD_SET(fd_, &wr);
+  timeval tv = {0, 0};
+  const int r = select(fd_ + 1, nullptr, &wr, nullptr, &tv);
+  if (r == 0)
+    return nowMs - startMs_ >= connectTimeoutMs ? fail() : TCP_EV_NONE;
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (r < 0 || getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0)
+    return fail();
+  state_ = TCP_UP;
+  justConnected_ = true;
+  connects_++;
+  connectMs_ = nowMs - startMs_;
+  return TCP_EV_UP;
+}
+
+TcpStream::Event TcpStream::fail() {
+  failures_++;
+  close();
+  return TCP_EV_FAILED;
+}
+
+size_t TcpStream::read(char *buf, size_t cap) {
+  if (state_ != TCP_UP || cap == 0)
+    return 0;
+  const ssize_t n = recv(fd_, buf, cap, MSG_DONTWAIT);
+  if (n > 0)
+    return (size_t)n;
+  if (n == 0 || !wouldBlock(errno))
+    drop(); /* peer closed or reset */
+  return 0;
+}
+
+bool TcpStream::flush() {
+  while (txLen_ > 0) {
+    const ssize_t n = send(fd_, tx_, txLen_, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0)
+      return wouldBlock(errno);
+    memmove(tx_, tx_ + n, txLen_ - (size_t)n);
+    txLen_ -= (size_t)n;
+  }
+  return true;
+}
+
+bool TcpStream::write(const char *data, size_t len) {
+  if (state_ != TCP_UP || len > txCap_ - txLen_)
+    return false;
+  memcpy(tx_ + txLen_, data, len);
+  txLen_ += len;
+  if (!flush()) {
+    drop();
+    return false;
+  }
+  return true;
+}
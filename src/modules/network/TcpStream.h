@@ -0,0 +1,87 @@
+/*
+ * NOCTURNE_OS — non-blocking TCP client socket (BSD sockets, lwIP and Linux) under MonitorTcp and
+ * ObdTcpTransport: connect, short-write flush, peer close. When to reconnect is the owner's policy.
+ */
+#ifndef NOCTURNE_TCP_STREAM_H
+#define NOCTURNE_TCP_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+class TcpStream {
+ public:
+  /** What connect() / poll() just did to the connection. */
+  enum Event : uint8_t { TCP_EV_NONE, TCP_EV_UP, TCP_EV_FAILED, TCP_EV_DROPPED };
+
+  /** txBuf: owner's queue for what send() did not take, txCap bytes. */
+  TcpStream(char *txBuf, size_t txCap) : tx_(txBuf), txCap_(txCap) {}
+  ~TcpStream() { close(); }
+  TcpStream(const TcpStream &) = delete;
+  TcpStream &operator=(const TcpStream &) = delete;
+
+  /** IPv4 address and port; false if the address does not parse. Closes an open connection. */
+  bool setServer(const char *ip, uint16_t port);
+  bool hasServer() const { return addr_ != 0; }
+
+  /** Start an attempt (only when idle): TCP_EV_UP if it connected at once, TCP_EV_FAILED, else NONE. */
+  Event connect(uint32_t nowMs, bool noDelay);
+  /** Finish or time out a pending connect, flush queued bytes. Never waits. */
+  Event poll(uint32_t nowMs, uint32_t connectTimeoutMs);
+  /** Up to cap bytes already received; 0 if none. A closed or reset peer closes the connection. */
+  size_t read(char *buf, size_t cap);
+  /** Queue and send what the socket takes now; false if down, the data does not fit, or the send
+   *  failed (connection closed). */
+  bool write(const char *data, size_t len);
+  /** Close now; counted as a drop when the connection was up. */
+  void drop();
+  /** Close now, not counted. */
+  void close();
+
+  bool idle() const { return state_ == TCP_IDLE; }
+  bool connected() const { return state_ == TCP_UP; }
+  bool connecting() const { return state_ == TCP_CONNECTING; }
+  /** The connection came up since the last call. */
+  bool takeConnected() {
+    const bool c = justConnected_;
+    justConnected_ = false;
+    return c;
+  }
+  /** Socket to wait on (select), -1 if none. */
+  int fd() const { return fd_; }
+  /** Waiting for the connect to finish or for queued bytes to leave: wait for writable too. */
+  bool wantsWrite() const { return state_ == TCP_CONNECTING || txLen_ > 0; }
+
+  uint32_t connects() const { return connects_; }
+  /** Connect attempts that failed (refused, unreachable, timed out). */
+  uint32_t failures() const { return failures_; }
+  /** Established connections that were lost (peer closed, reset, owner's drop()). */
+  uint32_t drops() const { return drops_; }
+  /** Duration of the last successful connect. */
+  uint32_t connectMs() const { return connectMs_; }
+
+ private:
+  enum State : uint8_t { TCP_IDLE, TCP_CONNECTING, TCP_UP };
+
+  Event finishConnect(uint32_t nowMs, uint32_t connectTimeoutMs);
+  Event fail();
+  bool flush();
+
+  uint32_t addr_ = 0; /* network byte order, 0 = not set */
+  uint16_t port_ = 0;
+
+  int fd_ = -1;
+  State state_ = TCP_IDLE;
+  bool justConnected_ = false;
+  uint32_t startMs_ = 0;
+
+  char *const tx_;
+  const size_t txCap_;
+  size_t txLen_ = 0;
+
+  uint32_t connects_ = 0;
+  uint32_t failures_ = 0;
+  uint32_t drops_ = 0;
+  uint32_t connectMs_ = 0;
+};
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * NOCTURNE_OS — lock-free single-writer / single-reader hand-off of whole values (triple buffering,
+ * header-only). Neither side waits; the reader gets the newest published value.
+ */
+#ifndef NOCTURNE_TRIPLE_BUFFER_H
+#define NOCTURNE_TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() : back_(0), front_(1), middle_(2) {}
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  /** Writer: the slot to fill. Holds whatever was there (not the last published value). */
+  T &back() { return slot_[back_]; }
+  /** Writer: make back() the newest value. True if it replaced one the reader never took. */
+  bool publish() {
+    const uint8_t old = middle_.exchange((uint8_t)(back_ | kFresh), std::memory_order_acq_rel);
+    back_ = old & kIndex;
+    if (old & kFresh)
+      replaced_++;
+    return (old & kFresh) != 0;
+  }
+  /** Writer: the last published value has not been taken yet. (May turn false right after; never true
+   *  after the reader has taken it.) */
+  bool pending() const { return (middle_.load(std::memory_order_acquire) & kFresh) != 0; }
+  /** Writer: values published over one the reader never took. */
+  uint32_t replaced() const { return replaced_; }
+
+  /** Reader: switch front() to the newest published value. False (front() unchanged) if none is new. */
+  bool take() {
+    if (!(middle_.load(std::memory_order_acquire) & kFresh))
+      return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+    return true;
+  }
+  /** Reader: the value taken last (default-constructed before the first take()). */
+  const T &front() const { return slot_[front_]; }
+
+ private:
+  static const uint8_t kIndex = 0x03;
+  static const uint8_t kFresh = 0x04;
+
+  T slot_[3];
+  uint8_t back_;  /* writer only */
+  uint8_t front_; /* reader only */
+  std::atomic<uint8_t> middle_;
+  uint32_t replaced_ = 0; /* writer only */
+};
+
+#endif
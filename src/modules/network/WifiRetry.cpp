@@ -0,0 +1,22 @@
+/*
+ * NOCTURNE_OS — WifiRetry: Wi-Fi users and the re-join interval.
+ */
+#include "WifiRetry.h"
+
+void WifiRetry::setWanted(uint8_t user, bool on) {
+  if (on)
+    users_.fetch_or(user);
+  else
+    users_.fetch_and((uint8_t)~user);
+}
+
+bool WifiRetry::step(uint32_t nowMs, bool connected) {
+  if (!wanted() || connected)
+    return false;
+  if (!now_ && nowMs - lastMs_ <= intervalMs_)
+    return false;
+  now_ = false;
+  lastMs_ = nowMs;
+  attempts_++;
+  return true;
+}
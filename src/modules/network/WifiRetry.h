@@ -0,0 +1,38 @@
+/*
+ * NOCTURNE_OS — WifiRetry: when the network task calls WiFi.begin() again. The station is kept while
+ * any user wants it: the monitor links, or OBD over TCP in BMW mode (monitoring off there).
+ */
+#ifndef NOCTURNE_WIFI_RETRY_H
+#define NOCTURNE_WIFI_RETRY_H
+
+#include <atomic>
+#include <cstdint>
+
+#define NOCT_WIFI_USER_MONITOR 0x01
+#define NOCT_WIFI_USER_OBD 0x02
+
+class WifiRetry {
+ public:
+  explicit WifiRetry(uint32_t intervalMs) : intervalMs_(intervalMs) {}
+
+  /** user: NOCT_WIFI_USER_*. Any task; the network task reads it every step. */
+  void setWanted(uint8_t user, bool on);
+  bool wanted() const { return users_.load() != 0; }
+  /** Retry at the next step instead of waiting out the interval (resume from suspend). */
+  void retryNow() { now_ = true; }
+
+  /** One network step with the station state. True = call WiFi.begin() now: wanted, not
+   * connected, and the interval since the last attempt has passed. */
+  bool step(uint32_t nowMs, bool connected);
+
+  uint32_t attempts() const { return attempts_; }
+
+ private:
+  std::atomic<uint8_t> users_{0};
+  const uint32_t intervalMs_;
+  uint32_t lastMs_ = 0;
+  bool now_ = false;
+  uint32_t attempts_ = 0;
+};
+
+#endif
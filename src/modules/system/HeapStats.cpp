@@ -0,0 +1,60 @@
+#include "nocturne/config.h"
+#if NOCT_HEAP_STATS
+
+/*
+ * NOCTURNE_OS — HeapStats: heap_caps_get_info sample + link-time malloc counter.
+ */
+#include "HeapStats.h"
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <stddef.h>
+
+static volatile uint32_t s_allocs = 0;
+
+extern "C" {
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t m);
+void *__real_realloc(void *p, size_t n);
+
+void *__wrap_malloc(size_t n)
+{
+  s_allocs++;
+  return __real_malloc(n);
+}
+
+void *__wrap_calloc(size_t n, size_t m)
+{
+  s_allocs++;
+  return __real_calloc(n, m);
+}
+
+void *__wrap_realloc(void *p, size_t n)
+{
+  s_allocs++;
+  return __real_realloc(p, n);
+}
+}
+
+uint32_t HeapStats::allocations() { return s_allocs; }
+
+void HeapStats::tick(unsigned long now)
+{
+  if (lastMs_ != 0 && now - lastMs_ < NOCT_HEAP_STATS_INTERVAL_MS)
+    return;
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+  const uint32_t allocs = s_allocs;
+  const unsigned long dt = now - lastMs_;
+  const float rate = (lastMs_ != 0 && dt > 0) ? (allocs - lastAllocs_) * 1000.0f / dt : 0.0f;
+  /* 0% = all free memory in one block; grows as it splinters. */
+  const unsigned frag = info.total_free_bytes
+      ? 100u - (unsigned)((uint64_t)info.largest_free_block * 100u / info.total_free_bytes)
+      : 0u;
+  Serial.printf("[HEAP] free=%u largest=%u frag=%u%% min=%u blocks=%u allocs=%u (%.1f/s)\n",
+                (unsigned)info.total_free_bytes, (unsigned)info.largest_free_block, frag,
+                (unsigned)info.minimum_free_bytes, (unsigned)info.allocated_blocks, (unsigned)allocs, rate);
+  lastMs_ = now;
+  lastAllocs_ = allocs;
+}
+
+#endif // NOCT_HEAP_STATS
@@ -0,0 +1,24 @@
+/*
+ * NOCTURNE_OS — HeapStats: periodic heap report on Serial (free, largest block, fragmentation, allocs/s
+ * via -Wl,--wrap=malloc/calloc/realloc). Built only with NOCT_HEAP_STATS=1 (env pc_companion_heapstats).
+ */
+#ifndef NOCTURNE_HEAP_STATS_H
+#define NOCTURNE_HEAP_STATS_H
+
+#include <stdint.h>
+
+class HeapStats
+{
+public:
+  /** Log one line every NOCT_HEAP_STATS_INTERVAL_MS. */
+  void tick(unsigned long now);
+
+  /** malloc + calloc + realloc calls since boot. */
+  static uint32_t allocations();
+
+private:
+  unsigned long lastMs_ = 0;
+  uint32_t lastAllocs_ = 0;
+};
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Host test helpers shared by the TCP suites (test_monitor_link, test_obd_tcp): a loopback listener and
+ * a poll() timer that shows no poll waits.
+ */
+#ifndef NOCTURNE_TCP_TEST_UTIL_H
+#define NOCTURNE_TCP_TEST_UTIL_H
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/** Loopback listener on an ephemeral port, non-blocking. Blackhole: backlog 0 plus one connection never
+ *  accepted, so the queue is full and further SYNs are dropped; a connect stays pending (a host that is
+ *  off). */
+struct Listener {
+  int fd = -1;
+  int filler = -1;
+  uint16_t port = 0;
+  explicit Listener(bool blackhole = false) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, (sockaddr *)&sa, sizeof(sa));
+    listen(fd, blackhole ? 0 : 4);
+    socklen_t len = sizeof(sa);
+    getsockname(fd, (sockaddr *)&sa, &len);
+    port = ntohs(sa.sin_port);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    if (blackhole) {
+      filler = socket(AF_INET, SOCK_STREAM, 0);
+      connect(filler, (sockaddr *)&sa, sizeof(sa));
+    }
+  }
+  ~Listener() {
+    if (filler >= 0)
+      close(filler);
+    close(fd);
+  }
+  int accept() {
+    const int c = ::accept(fd, nullptr, nullptr);
+    if (c >= 0)
+      fcntl(c, F_SETFL, fcntl(c, F_GETFL, 0) | O_NONBLOCK);
+    return c;
+  }
+};
+
+/** Slowest timedPoll() so far; tests reset it. */
+static double s_pollMaxUs = 0;
+
+template <typename T>
+static void timedPoll(T &t, uint32_t now) {
+  const auto t0 = std::chrono::steady_clock::now();
+  t.poll(now);
+  const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  if (us > s_pollMaxUs)
+    s_pollMaxUs = us;
+}
+
+#endif
@@ -0,0 +1,562 @@
+/*
+ * Host tests: bulk history download — record rings, framing, flow control, resume (BleBulkTransfer.cpp).
+ * Throughput: the real session driven over a modelled link, L2CAP CoC vs GATT notifications.
+ * Run: pio test -e native -f native/test_ble_bulk_transfer
+ */
+#include <unity.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include "BleBulkTransfer.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static uint32_t rd32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void wr32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static size_t readReq(uint8_t *out, uint8_t src, uint32_t gen, uint32_t offset, uint32_t len) {
+  out[0] = BLE_BULK_OP_READ;
+  out[1] = src;
+  wr32(out + 2, gen);
+  wr32(out + 6, offset);
+  wr32(out + 10, len);
+  return BLE_BULK_READ_LEN;
+}
+
+static size_t ackReq(uint8_t *out, uint32_t offset) {
+  out[0] = BLE_BULK_OP_ACK;
+  wr32(out + 1, offset);
+  return 5;
+}
+
+/* Record i: length 1 + i % 40, bytes derived from i. */
+static size_t makeRecord(uint32_t i, uint8_t *rec) {
+  const size_t len = 1 + i % 40;
+  for (size_t k = 0; k < len; k++)
+    rec[k] = (uint8_t)(i * 7 + k);
+  return len;
+}
+
+/* Walk [len][bytes] records in a downloaded stream; returns record count or -1 if out of sync. */
+static int checkRecords(const std::vector<uint8_t> &s, uint32_t firstIndex) {
+  size_t pos = 0;
+  uint32_t i = firstIndex;
+  int n = 0;
+  uint8_t rec[64];
+  while (pos < s.size()) {
+    const size_t len = makeRecord(i, rec);
+    if (s[pos] != len || pos + 1 + len > s.size() || memcmp(&s[pos + 1], rec, len) != 0)
+      return -1;
+    pos += 1 + len;
+    i++;
+    n++;
+  }
+  return n;
+}
+
+/* Pull frames until idle; DATA payloads appended to out, last END / ERROR frame copied to tail. */
+static int drain(BleBulkSession &s, size_t cap, std::vector<uint8_t> *out, uint8_t *tail, bool ack) {
+  uint8_t f[2048];
+  int frames = 0;
+  for (;;) {
+    size_t n = s.nextFrame(f, cap);
+    if (n == 0)
+      return frames;
+    frames++;
+    TEST_ASSERT_TRUE(n <= cap);
+    if (f[0] == BLE_BULK_OP_DATA) {
+      if (out)
+        out->insert(out->end(), f + BLE_BULK_DATA_HEADER, f + n);
+      if (ack) {
+        uint8_t a[5];
+        s.onRequest(a, ackReq(a, rd32(f + 2) + (uint32_t)(n - BLE_BULK_DATA_HEADER)));
+      }
+    } else if (tail) {
+      memcpy(tail, f, n);
+    }
+  }
+}
+
+static void test_ring_drops_whole_records_and_wraps(void) {
+  static uint8_t buf[100];
+  BleHistoryRing r(buf, sizeof(buf));
+  uint8_t rec[64];
+  uint32_t i = 0;
+  while (r.dropped() == 0)
+    r.append(rec, makeRecord(i++, rec));
+  for (int k = 0; k < 30; k++)
+    r.append(rec, makeRecord(i++, rec));
+  TEST_ASSERT_TRUE(r.end() - r.base() <= sizeof(buf));
+  TEST_ASSERT_EQUAL(i, r.records());
+  /* What is left reads back as whole records, the oldest kept one first, across the wrap. */
+  std::vector<uint8_t> all(r.end() - r.base());
+  TEST_ASSERT_EQUAL(all.size(), r.read(r.base(), all.data(), all.size()));
+  TEST_ASSERT_EQUAL((int)(i - r.dropped()), checkRecords(all, r.dropped()));
+  TEST_ASSERT_EQUAL(0, (int)r.read(r.base() - 1, all.data(), 1));
+  TEST_ASSERT_EQUAL(0, (int)r.read(r.end(), all.data(), 1));
+  TEST_ASSERT_FALSE(r.append(rec, 0));
+  TEST_ASSERT_FALSE(r.append(rec, sizeof(buf)));
+}
+
+/* 2^32 bytes through a ring of 600 (used as 512): offsets wrap, records stay where reads expect them. */
+static void test_ring_offsets_wrap_past_2pow32(void) {
+  static uint8_t buf[600];
+  BleHistoryRing r(buf, sizeof(buf));
+  uint8_t rec[255];
+  const uint32_t total = 0x01000000u + 4; /* 256-byte records: end() wraps after 2^24 of them */
+  for (uint32_t i = 0; i < total; i++) {
+    memset(rec, (int)(i & 0xFF), sizeof(rec));
+    TEST_ASSERT_TRUE(r.append(rec, sizeof(rec)));
+  }
+  TEST_ASSERT_EQUAL_UINT32(4u * 256u, r.end());
+  TEST_ASSERT_EQUAL_UINT32(2u * 256u, r.end() - r.base()); /* two records fit in 512 */
+  TEST_ASSERT_TRUE(r.base() < r.end());
+  uint8_t out[512];
+  TEST_ASSERT_EQUAL(512, (int)r.read(r.base(), out, sizeof(out)));
+  TEST_ASSERT_EQUAL_UINT8(255, out[0]);
+  TEST_ASSERT_EQUAL_UINT8((total - 2) & 0xFF, out[1]);
+  TEST_ASSERT_EQUAL_UINT8((total - 1) & 0xFF, out[257]);
+
+  /* Straddling the wrap: base just below 2^32, end just above. */
+  static uint8_t buf2[512];
+  BleHistoryRing w(buf2, sizeof(buf2));
+  for (uint32_t i = 0; i < 0x01000000u - 1; i++)
+    w.append(rec, sizeof(rec));
+  memset(rec, 0xA5, sizeof(rec));
+  TEST_ASSERT_TRUE(w.append(rec, sizeof(rec)));
+  memset(rec, 0x5A, sizeof(rec));
+  TEST_ASSERT_TRUE(w.append(rec, sizeof(rec)));
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFF00u, w.base());
+  TEST_ASSERT_EQUAL_UINT32(0x100u, w.end());
+  TEST_ASSERT_EQUAL(512, (int)w.read(w.base(), out, sizeof(out)));
+  TEST_ASSERT_EQUAL_UINT8(0xA5, out[1]);
+  TEST_ASSERT_EQUAL_UINT8(0x5A, out[257]);
+  TEST_ASSERT_EQUAL(256, (int)w.read(0, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_UINT8(0x5A, out[1]);
+  TEST_ASSERT_EQUAL(0, (int)w.read(w.base() - 1, out, 1));
+  TEST_ASSERT_EQUAL(0, (int)w.read(w.end(), out, 1));
+}
+
+static void test_list_sources(void) {
+  static uint8_t b1[64], b2[64];
+  BleHistoryRing trip(b1, sizeof(b1)), ibus(b2, sizeof(b2));
+  trip.setGeneration(0xA1B2C3D4);
+  uint8_t rec[8] = {1, 2, 3};
+  ibus.append(rec, 3);
+  BleBulkSession s;
+  TEST_ASSERT_TRUE(s.addSource(BLE_BULK_SRC_TRIP, "trip", &trip));
+  TEST_ASSERT_TRUE(s.addSource(BLE_BULK_SRC_IBUS, "ibus", &ibus));
+  TEST_ASSERT_FALSE(s.addSource(BLE_BULK_SRC_IBUS, "again", &ibus));
+  const uint8_t list = BLE_BULK_OP_LIST;
+  TEST_ASSERT_TRUE(s.onRequest(&list, 1));
+  uint8_t f[64];
+  size_t n = s.nextFrame(f, sizeof(f));
+  TEST_ASSERT_EQUAL(2 + 2 * (14 + 4), (int)n);
+  TEST_ASSERT_EQUAL_HEX8(BLE_BULK_OP_SOURCES, f[0]);
+  TEST_ASSERT_EQUAL(2, f[1]);
+  TEST_ASSERT_EQUAL(BLE_BULK_SRC_TRIP, f[2]);
+  TEST_ASSERT_EQUAL_HEX32(0xA1B2C3D4, rd32(f + 3));
+  TEST_ASSERT_EQUAL(4, f[15]);
+  TEST_ASSERT_EQUAL_MEMORY("trip", f + 16, 4);
+  TEST_ASSERT_EQUAL(BLE_BULK_SRC_IBUS, f[20]);
+  TEST_ASSERT_EQUAL(4, (int)rd32(f + 29));  /* end: one 3-byte record */
+  /* Small frame: as many sources as fit. */
+  s.onRequest(&list, 1);
+  TEST_ASSERT_EQUAL(2 + 18, (int)s.nextFrame(f, 30));
+  TEST_ASSERT_EQUAL(1, f[1]);
+  TEST_ASSERT_EQUAL(0, (int)s.nextFrame(f, sizeof(f)));
+}
+
+static void test_read_streams_exact_bytes_then_end(void) {
+  static uint8_t buf[4096];
+  BleHistoryRing r(buf, sizeof(buf));
+  r.setGeneration(7);
+  uint8_t rec[64];
+  for (uint32_t i = 0; i < 100; i++)
+    r.append(rec, makeRecord(i, rec));
+  BleBulkSession s;
+  s.addSource(BLE_BULK_SRC_TRIP, "trip", &r);
+  uint8_t req[BLE_BULK_READ_LEN];
+  TEST_ASSERT_TRUE(s.onRequest(req, readReq(req, BLE_BULK_SRC_TRIP, 7, 0, 0)));
+  std::vector<uint8_t> got;
+  uint8_t tail[16] = {0};
+  const int frames = drain(s, 244, &got, tail, true);
+  TEST_ASSERT_EQUAL(r.end(), got.size());
+  TEST_ASSERT_EQUAL(100, checkRecords(got, 0));
+  TEST_ASSERT_EQUAL((int)((got.size() + 237) / 238) + 1, frames);  /* 238 payload bytes per 244-byte frame */
+  TEST_ASSERT_EQUAL_HEX8(BLE_BULK_OP_END, tail[0]);
+  TEST_ASSERT_EQUAL(r.end(), rd32(tail + 2));
+  TEST_ASSERT_EQUAL(BLE_BULK_END_DONE, tail[6]);
+  TEST_ASSERT_FALSE(s.streaming());
+  /* Bounded read: [10, 60). Records appended meanwhile are not part of it. */
+  s.onRequest(req, readReq(req, BLE_BULK_SRC_TRIP, 0, 10, 50));
+  r.append(rec, makeRecord(100, rec));
+  got.clear();
+  drain(s, 244, &got, tail, true);
+  TEST_ASSERT_EQUAL(50, (int)got.size());
+  TEST_ASSERT_EQUAL(60, (int)rd32(tail + 2));
+  TEST_ASSERT_EQUAL(1, (int)s.resumes());
+}
+
+static void test_window_stalls_until_ack(void) {
+  static uint8_t buf[8192];
+  BleHistoryRing r(buf, sizeof(buf));
+  uint8_t rec[200];
+  memset(rec, 0x5A, sizeof(rec));
+  for (int i = 0; i < 30; i++)
+    r.append(rec, sizeof(rec));
+  BleBulkSession s;
+  s.setWindow(1000);
+  s.addSource(BLE_BULK_SRC_IBUS, "ibus", &r);
+  uint8_t req[BLE_BULK_READ_LEN];
+  s.onRequest(req, readReq(req, BLE_BULK_SRC_IBUS, 0, 0, 0));
+  std::vector<uint8_t> got;
+  drain(s, 244, &got, nullptr, false);
+  TEST_ASSERT_EQUAL(1000, (int)got.size());
+  TEST_ASSERT_EQUAL(1000, (int)s.inFlight());
+  TEST_ASSERT_TRUE(s.windowStalls() > 0);
+  /* Stale and future ACKs do not move the window. */
+  uint8_t a[5];
+  s.onRequest(a, ackReq(a, 5000));
+  TEST_ASSERT_EQUAL(1000, (int)s.inFlight());
+  s.onRequest(a, ackReq(a, 600));
+  TEST_ASSERT_EQUAL(400, (int)s.inFlight());
+  s.onRequest(a, ackReq(a, 100));
+  TEST_ASSERT_EQUAL(400, (int)s.inFlight());
+  drain(s, 244, &got, nullptr, false);
+  TEST_ASSERT_EQUAL(1600, (int)got.size());
+  s.onRequest(a, ackReq(a, 1600));
+  drain(s, 244, &got, nullptr, true);
+  TEST_ASSERT_EQUAL(r.end(), got.size());
+}
+
+static void test_resume_after_disconnect(void) {
+  static uint8_t buf[16384];
+  BleHistoryRing r(buf, sizeof(buf));
+  r.setGeneration(0x1234);
+  uint8_t rec[64];
+  for (uint32_t i = 0; i < 400; i++)
+    r.append(rec, makeRecord(i, rec));
+  BleBulkSession s;
+  s.addSource(BLE_BULK_SRC_TRIP, "trip", &r);
+  uint8_t req[BLE_BULK_READ_LEN];
+  s.onRequest(req, readReq(req, BLE_BULK_SRC_TRIP, 0x1234, 0, 0));
+  /* Phone gets 7 frames, the link drops with one more frame lost in the air. */
+  std::vector<uint8_t> got;
+  uint8_t f[256];
+  for (int k = 0; k < 7; k++) {
+    size_t n = s.nextFrame(f, 200);
+    got.insert(got.end(), f + BLE_BULK_DATA_HEADER, f + n);
+  }
+  s.nextFrame(f, 200);
+  s.reset();
+  TEST_ASSERT_FALSE(s.streaming());
+  TEST_ASSERT_EQUAL(0, (int)s.nextFrame(f, 200));
+  /* Reconnect, resume from what the phone has. */
+  s.onRequest(req, readReq(req, BLE_BULK_SRC_TRIP, 0x1234, (uint32_t)got.size(), 0));
+  TEST_ASSERT_EQUAL((int)got.size(), (int)rd32((s.nextFrame(f, 200), f + 2)));
+  got.insert(got.end(), f + BLE_BULK_DATA_HEADER, f + 200);
+  drain(s, 200, &got, nullptr, true);
+  TEST_ASSERT_EQUAL(r.end(), got.size());
+  TEST_ASSERT_EQUAL(400, checkRecords(got, 0));
+  TEST_ASSERT_EQUAL(1, (int)s.resumes());
+  TEST_ASSERT_EQUAL(0, (int)s.gaps());
+}
+
+static void test_resume_skips_overwritten_records(void) {
+  static uint8_t buf[512];
+  BleHistoryRing r(buf, sizeof(buf));
+  uint8_t rec[64];
+  uint32_t i = 0;
+  for (; i < 20; i++)
+    r.append(rec, makeRecord(i, rec));
+  BleBulkSession s;
+  s.addSource(BLE_BULK_SRC_IBUS, "ibus", &r);
+  uint8_t req[BLE_BULK_READ_LEN];
+  s.onRequest(req, readReq(req, BLE_BULK_SRC_IBUS, 0, 0, 0));
+  uint8_t f[256];
+  size_t n = s.nextFrame(f, 100);
+  const uint32_t have = (uint32_t)(n - BLE_BULK_DATA_HEADER);
+  s.reset();
+  /* Away long enough for the ring to go round more than once. */
+  for (; i < 120; i++)
+    r.append(rec, makeRecord(i, rec));
+  TEST_ASSERT_TRUE(r.base() > have);
+  s.onRequest(req, readReq(req, BLE_BULK_SRC_IBUS, r.generation(), have, 0));
+  std::vector<uint8_t> got;
+  uint8_t tail[16];
+  n = s.nextFrame(f, 256);
+  TEST_ASSERT_EQUAL(r.base(), rd32(f + 2));  /* offset jumped: gap */
+  got.insert(got.end(), f + BLE_BULK_DATA_HEADER, f + n);
+  drain(s, 256, &got, tail, true);
+  TEST_ASSERT_EQUAL(1, (int)s.gaps());
+  /* Base is a record boundary: the phone is back in sync at the oldest kept record. */
+  TEST_ASSERT_EQUAL((int)(120 - r.dropped()), checkRecords(got, r.dropped()));
+  TEST_ASSERT_EQUAL(r.end(), rd32(tail + 2));
+}
+
+static void test_generation_and_unknown_source_errors(void) {
+  static uint8_t buf[256];
+  BleHistoryRing r(buf, sizeof(buf));
+  r.setGeneration(42);
+  uint8_t rec[16] = {0};
+  r.append(rec, 10);
+  BleBulkSession s;
+  s.addSource(BLE_BULK_SRC_BATTERY, "battery", &r);
+  uint8_t req[BLE_BULK_READ_LEN], f[64];
+  /* Phone resumes with a generation from before a reboot. */
+  s.onRequest(req, readReq(req, BLE_BULK_SRC_BATTERY, 41, 300, 0));
+  TEST_ASSERT_EQUAL(7, (int)s.nextFrame(f, sizeof(f)));
+  TEST_ASSERT_EQUAL_HEX8(BLE_BULK_OP_ERROR, f[0]);
+  TEST_ASSERT_EQUAL(BLE_BULK_ERR_GENERATION, f[2]);
+  TEST_ASSERT_EQUAL(42, (int)rd32(f + 3));
+  TEST_ASSERT_FALSE(s.streaming());
+  s.onRequest(req, readReq(req, 0x77, 0, 0, 0));
+  s.nextFrame(f, sizeof(f));
+  TEST_ASSERT_EQUAL(BLE_BULK_ERR_NO_SOURCE, f[2]);
+  /* Generation changes mid-transfer: ERROR instead of mixing old and new bytes. */
+  s.onRequest(req, readReq(req, BLE_BULK_SRC_BATTERY, 42, 0, 0));
+  r.setGeneration(43);
+  s.nextFrame(f, sizeof(f));
+  TEST_ASSERT_EQUAL_HEX8(BLE_BULK_OP_ERROR, f[0]);
+  TEST_ASSERT_EQUAL(43, (int)rd32(f + 3));
+  /* Offset past the end: clamped, END right away. */
+  s.onRequest(req, readReq(req, BLE_BULK_SRC_BATTERY, 43, 1000, 0));
+  s.nextFrame(f, sizeof(f));
+  TEST_ASSERT_EQUAL_HEX8(BLE_BULK_OP_END, f[0]);
+  TEST_ASSERT_EQUAL(r.end(), rd32(f + 2));
+  /* Malformed requests are ignored. */
+  TEST_ASSERT_FALSE(s.onRequest(req, 5));
+  const uint8_t junk = 0x55;
+  TEST_ASSERT_FALSE(s.onRequest(&junk, 1));
+}
+
+static void test_cancel(void) {
+  static uint8_t buf[4096];
+  BleHistoryRing r(buf, sizeof(buf));
+  uint8_t rec[100] = {0};
+  for (int i = 0; i < 30; i++)
+    r.append(rec, sizeof(rec));
+  BleBulkSession s;
+  s.addSource(BLE_BULK_SRC_TRIP, "trip", &r);
+  uint8_t req[BLE_BULK_READ_LEN], f[256];
+  s.onRequest(req, readReq(req, BLE_BULK_SRC_TRIP, 0, 0, 0));
+  s.nextFrame(f, 244);
+  const uint8_t cancel = BLE_BULK_OP_CANCEL;
+  s.onRequest(&cancel, 1);
+  TEST_ASSERT_EQUAL(7, (int)s.nextFrame(f, sizeof(f)));
+  TEST_ASSERT_EQUAL_HEX8(BLE_BULK_OP_END, f[0]);
+  TEST_ASSERT_EQUAL(238, (int)rd32(f + 2));
+  TEST_ASSERT_EQUAL(BLE_BULK_END_CANCELLED, f[6]);
+  TEST_ASSERT_EQUAL(0, (int)s.nextFrame(f, sizeof(f)));
+}
+
+/*
+ * Link model (ESP32-S3 NimBLE, 2M PHY, data length 251, 15 ms connection interval):
+ *  - one 251-byte LL packet every kPduUs (air time + IFS + empty reply), as many as fit in the interval;
+ *  - the host holds at most kQueuePdus packets for the controller (mbuf budget);
+ *  - the board hands frames to the stack on its main-loop tick (BleKeyService::tickBulk, kLoopUs);
+ *  - CoC: one SDU = ceil((len + 2) / 247) K-frames; refused while it does not fit (stall), kept and retried;
+ *  - GATT: one notification = one packet; notify() has no back-pressure, a notify into a full queue is lost;
+ *  - the phone ACKs every half window and re-READs from its offset on a hole or after kPhoneTimeoutUs.
+ */
+static const uint32_t kCiUs = 15000;
+static const uint32_t kPduUs = 1400;
+static const uint32_t kLoopUs = 10000;
+static const size_t kQueuePdus = 12;
+static const uint32_t kPhoneTimeoutUs = 200000;
+
+struct LinkModel {
+  const char *name;
+  bool coc;
+  size_t frameCap;
+  int framesPerTick;
+};
+
+struct SimResult {
+  double kBps;
+  double seconds;
+  uint32_t sendCalls;
+  uint32_t lost;
+  uint32_t resumes;
+  bool intact;
+};
+
+static SimResult simulate(const LinkModel &m, BleHistoryRing &src, uint32_t window) {
+  BleBulkSession s;
+  s.setWindow(window);
+  s.addSource(BLE_BULK_SRC_TRIP, "trip", &src);
+  struct Frame {
+    std::vector<uint8_t> bytes;
+    size_t pdusLeft;
+  };
+  std::deque<Frame> air;
+  size_t queued = 0;
+  std::vector<std::vector<uint8_t>> uplink;  /* phone -> board, applied at the next tick */
+  std::vector<uint8_t> got;
+  uint32_t lastAck = 0, lastRxUs = 0;
+  bool done = false;
+  SimResult res = {};
+  uint8_t req[BLE_BULK_READ_LEN];
+  uplink.push_back(std::vector<uint8_t>(req, req + readReq(req, BLE_BULK_SRC_TRIP, src.generation(), 0, 0)));
+  std::vector<uint8_t> pending;
+  uint32_t t = 0;
+  for (; !done && t < 60u * 1000000u; t += 100) {
+    if (t % kLoopUs == 0) {
+      for (auto &r : uplink)
+        s.onRequest(r.data(), r.size());
+      uplink.clear();
+      uint8_t f[2048];
+      for (int k = 0; k < m.framesPerTick; k++) {
+        if (pending.empty()) {
+          size_t n = s.nextFrame(f, m.frameCap);
+          if (n == 0)
+            break;
+          pending.assign(f, f + n);
+        }
+        const size_t pdus = m.coc ? (pending.size() + 2 + 246) / 247 : 1;
+        res.sendCalls++;
+        if (queued + pdus > kQueuePdus) {
+          if (m.coc)
+            break;  /* stalled: the same SDU next tick */
+          res.lost++;  /* notify into a full queue: gone */
+          pending.clear();
+          continue;
+        }
+        air.push_back({pending, pdus});
+        queued += pdus;
+        pending.clear();
+      }
+    }
+    if (t % kCiUs == 0) {
+      std::vector<uint8_t> ack;
+      for (uint32_t used = 0; used + kPduUs <= kCiUs && !air.empty(); used += kPduUs) {
+        Frame &fr = air.front();
+        queued--;
+        if (--fr.pdusLeft > 0)
+          continue;
+        const std::vector<uint8_t> b = fr.bytes;
+        air.pop_front();
+        lastRxUs = t;
+        if (b[0] == BLE_BULK_OP_DATA) {
+          if (rd32(&b[2]) != got.size())
+            continue;  /* after a hole: ignored until the re-READ stream arrives */
+          got.insert(got.end(), b.begin() + BLE_BULK_DATA_HEADER, b.end());
+          if (got.size() - lastAck >= window / 2) {
+            lastAck = (uint32_t)got.size();
+            uplink.push_back(std::vector<uint8_t>(req, req + ackReq(req, lastAck)));
+          }
+        } else if (b[0] == BLE_BULK_OP_END) {
+          if (rd32(&b[2]) == got.size() && got.size() == src.end()) {
+            done = true;
+            break;
+          }
+        }
+      }
+      /* Hole (lost notification) or silence: ask again from what we have. */
+      const bool hole = !air.empty() && air.front().pdusLeft == 1 && air.front().bytes[0] == BLE_BULK_OP_DATA &&
+                        rd32(&air.front().bytes[2]) > got.size() && uplink.empty();
+      if (!done && (hole || t - lastRxUs > kPhoneTimeoutUs)) {
+        uplink.push_back(std::vector<uint8_t>(
+            req, req + readReq(req, BLE_BULK_SRC_TRIP, src.generation(), (uint32_t)got.size(), 0)));
+        lastAck = (uint32_t)got.size();
+        lastRxUs = t;
+        res.resumes++;
+      }
+    }
+  }
+  res.seconds = t / 1e6;
+  res.kBps = got.size() / 1024.0 / res.seconds;
+  std::vector<uint8_t> all(src.end());
+  src.read(0, all.data(), all.size());
+  res.intact = done && got == all;
+  return res;
+}
+
+static void test_throughput_coc_vs_gatt(void) {
+  static uint8_t buf[128 * 1024];
+  BleHistoryRing r(buf, sizeof(buf));
+  r.setGeneration(9);
+  uint8_t rec[64];
+  for (uint32_t i = 0; r.end() + 41 < 96 * 1024; i++) /* 96 KB of history, nothing dropped */
+    r.append(rec, makeRecord(i, rec));
+  const LinkModel models[] = {
+      {"L2CAP CoC, SDU 1974", true, BLE_BULK_COC_MTU, 4},
+      {"GATT notify, 4/tick (fw)", false, 244, 4},
+      {"GATT notify, 12/tick", false, 244, 12},
+      {"GATT notify, 16/tick", false, 244, 16},
+  };
+  printf("\n[bulk] %lu bytes of history, window %lu, CI 15 ms, loop 10 ms\n", (unsigned long)r.end(),
+         (unsigned long)BleBulkSession::kDefaultWindow);
+  printf("[bulk] %-26s %9s %7s %11s %5s %7s\n", "transport", "KB/s", "s", "send calls", "lost", "resumes");
+  SimResult res[4];
+  for (int i = 0; i < 4; i++) {
+    res[i] = simulate(models[i], r, BleBulkSession::kDefaultWindow);
+    printf("[bulk] %-26s %9.1f %7.2f %11lu %5lu %7lu\n", models[i].name, res[i].kBps, res[i].seconds,
+           (unsigned long)res[i].sendCalls, (unsigned long)res[i].lost, (unsigned long)res[i].resumes);
+    TEST_ASSERT_TRUE(res[i].intact);
+  }
+  /* CoC fills the link without loss; paced GATT is slower, unpaced GATT loses frames and pays for resumes. */
+  TEST_ASSERT_EQUAL(0, (int)res[0].lost);
+  TEST_ASSERT_EQUAL(0, (int)res[1].lost);
+  TEST_ASSERT_TRUE(res[0].kBps > 1.4 * res[1].kBps);
+  TEST_ASSERT_TRUE(res[0].kBps >= res[2].kBps);
+  TEST_ASSERT_TRUE(res[3].lost > 0);
+  TEST_ASSERT_TRUE(res[0].kBps > res[3].kBps);
+  TEST_ASSERT_TRUE(res[0].sendCalls * 3 < res[1].sendCalls);
+}
+
+static void test_frame_build_cost(void) {
+  static uint8_t buf[64 * 1024];
+  BleHistoryRing r(buf, sizeof(buf));
+  uint8_t rec[255];
+  memset(rec, 0x33, sizeof(rec));
+  while (r.append(rec, sizeof(rec)) && r.dropped() == 0) {
+  }
+  BleBulkSession s;
+  s.setWindow(0xFFFFFFFFu);
+  s.addSource(BLE_BULK_SRC_TRIP, "trip", &r);
+  uint8_t req[BLE_BULK_READ_LEN], f[2048];
+  const int kRounds = 50;
+  uint64_t bytes = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int k = 0; k < kRounds; k++) {
+    s.onRequest(req, readReq(req, BLE_BULK_SRC_TRIP, 0, r.base(), 0));
+    size_t n;
+    while ((n = s.nextFrame(f, BLE_BULK_COC_MTU)) > 7)
+      bytes += n;
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  printf("[bulk] frame build: %.1f ns/KB on host (%llu KB)\n", ns / (bytes / 1024.0),
+         (unsigned long long)(bytes / 1024));
+  TEST_ASSERT_TRUE(bytes > 0);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_drops_whole_records_and_wraps);
+  RUN_TEST(test_ring_offsets_wrap_past_2pow32);
+  RUN_TEST(test_list_sources);
+  RUN_TEST(test_read_streams_exact_bytes_then_end);
+  RUN_TEST(test_window_stalls_until_ack);
+  RUN_TEST(test_resume_after_disconnect);
+  RUN_TEST(test_resume_skips_overwritten_records);
+  RUN_TEST(test_generation_and_unknown_source_errors);
+  RUN_TEST(test_cancel);
+  RUN_TEST(test_throughput_coc_vs_gatt);
+  RUN_TEST(test_frame_build_cost);
+  return UNITY_END();
+}
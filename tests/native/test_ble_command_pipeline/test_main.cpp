@@ -0,0 +1,371 @@
+/*
+ * Host tests: acknowledged BLE command pipeline (BleCommandPipeline.cpp).
+ * The I-Bus side is simulated: 9600 baud 8E1 (11 bits/byte), >= 10 ms bus gap before TX, 16-frame TX queue.
+ * Run: pio test -e native -f native/test_ble_command_pipeline
+ */
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include "BleCommandPipeline.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* ── Simulated I-Bus TX task ────────────────────────────────────────────── */
+struct SimBus {
+  static const int kQueueLen = 16;
+  struct Frame {
+    uint16_t tag;
+    uint8_t len;
+  };
+  Frame q[kQueueLen];
+  int count = 0;
+  uint32_t busyUntilMs = 0;
+  uint32_t rng = 12345;
+  int collisionPct = 0;
+  int framesSent = 0;
+
+  bool push(uint16_t tag, uint8_t len) {
+    if (count >= kQueueLen)
+      return false;
+    q[count].tag = tag;
+    q[count].len = len;
+    count++;
+    return true;
+  }
+  int freeSlots() const { return kQueueLen - count; }
+  uint32_t nextRand() {
+    rng = rng * 1103515245u + 12345u;
+    return (rng >> 16) & 0x7FFF;
+  }
+  /* Advance to nowMs; report finished frames to the pipeline. */
+  void run(uint32_t nowMs, BleCommandPipeline &p) {
+    while (count > 0 && nowMs >= busyUntilMs) {
+      Frame f = q[0];
+      memmove(q, q + 1, sizeof(Frame) * (count - 1));
+      count--;
+      /* frame bytes + checksum at 11 bits/byte, then the 10 ms silence other nodes need. */
+      uint32_t txMs = (uint32_t)((f.len + 1) * 11 * 1000 / 9600) + 1;
+      busyUntilMs = nowMs + txMs + 10;
+      bool ok = (int)(nextRand() % 100) >= collisionPct;
+      framesSent++;
+      if (f.tag)
+        p.onTxDone(f.tag, ok, nowMs + txMs);
+    }
+  }
+};
+
+struct ExecCtx {
+  SimBus *bus;
+  bool synced;
+};
+
+/* Command map for the test: 0..31 send one frame, 0x80 sends two (light show step), 0x93 state only. */
+static uint8_t simExec(const BleCommand &c, uint16_t tag, uint8_t *writes, void *ctx) {
+  ExecCtx *e = (ExecCtx *)ctx;
+  *writes = 0;
+  int frames;
+  if (c.cmd <= 31)
+    frames = 1;
+  else if (c.cmd == 0x80)
+    frames = 2;
+  else if (c.cmd == 0x93)
+    frames = 0;
+  else
+    return BLE_CMD_ERR_UNKNOWN_CMD;
+  if (frames && !e->synced)
+    return BLE_CMD_ERR_NOT_SYNCED;
+  if (e->bus->freeSlots() < frames)
+    return BLE_CMD_EXEC_BUSY;
+  for (int i = 0; i < frames; i++)
+    e->bus->push(tag, 6);
+  *writes = (uint8_t)frames;
+  return BLE_CMD_EXEC_OK;
+}
+
+struct Tally {
+  int ack[256];
+  int done[256];
+  int fail[256];
+  int late[256];
+  uint8_t lastDetail[256];
+  uint8_t maxDepth;
+  void clear() { memset(this, 0, sizeof(*this)); }
+  void drain(BleCommandPipeline &p) {
+    uint8_t buf[512];
+    size_t n;
+    while ((n = p.takeNotifications(buf, sizeof(buf))) > 0) {
+      for (size_t i = 0; i < n; i += BLE_CMD_NOTIFY_RECORD_LEN) {
+        uint8_t id = buf[i], st = buf[i + 1];
+        if (buf[i + 2] > maxDepth)
+          maxDepth = buf[i + 2];
+        if (st == BLE_CMD_ST_ACK)
+          ack[id]++;
+        else if (st == BLE_CMD_ST_DONE)
+          done[id]++;
+        else if (st == BLE_CMD_ST_FAIL) {
+          fail[id]++;
+          lastDetail[id] = buf[i + 3];
+        } else if (st == BLE_CMD_ST_LATE) {
+          late[id]++;
+          lastDetail[id] = buf[i + 3];
+        }
+      }
+    }
+  }
+};
+
+static Tally g_tally;
+
+static void test_parse_multiple_records_and_params(void) {
+  BleCommandPipeline p;
+  SimBus bus;
+  ExecCtx ctx = {&bus, true};
+  const uint8_t w[] = {1, 0x06, 0, 2, 0x09, 4, 'N', 'O', 'C', 'T', 3, 0x93, 0};
+  TEST_ASSERT_EQUAL(3, (int)p.submitWrite(w, sizeof(w), 0));
+  TEST_ASSERT_EQUAL(3, (int)p.queued());
+  g_tally.clear();
+  p.process(0, simExec, &ctx);
+  g_tally.drain(p);
+  TEST_ASSERT_EQUAL(1, g_tally.ack[1]);
+  TEST_ASSERT_EQUAL(1, g_tally.ack[2]);
+  TEST_ASSERT_EQUAL(1, g_tally.done[3]);  /* state-only: done immediately */
+  TEST_ASSERT_EQUAL(0, g_tally.done[1]);
+  for (uint32_t t = 0; t < 100; t++)
+    bus.run(t, p);
+  p.process(100, simExec, &ctx);
+  g_tally.drain(p);
+  TEST_ASSERT_EQUAL(1, g_tally.done[1]);
+  TEST_ASSERT_EQUAL(1, g_tally.done[2]);
+  TEST_ASSERT_EQUAL(0, (int)p.depth());
+}
+
+static void test_bad_frame_and_unknown_and_not_synced(void) {
+  BleCommandPipeline p;
+  SimBus bus;
+  ExecCtx ctx = {&bus, false};
+  const uint8_t bad[] = {9, 0x01, 30};  /* paramLen beyond the write */
+  TEST_ASSERT_EQUAL(0, (int)p.submitWrite(bad, sizeof(bad), 0));
+  const uint8_t w[] = {10, 0x7E, 0, 11, 0x06, 0};
+  p.submitWrite(w, sizeof(w), 0);
+  g_tally.clear();
+  p.process(0, simExec, &ctx);
+  g_tally.drain(p);
+  TEST_ASSERT_EQUAL(BLE_CMD_ERR_BAD_FRAME, g_tally.lastDetail[9]);
+  TEST_ASSERT_EQUAL(BLE_CMD_ERR_UNKNOWN_CMD, g_tally.lastDetail[10]);
+  TEST_ASSERT_EQUAL(BLE_CMD_ERR_NOT_SYNCED, g_tally.lastDetail[11]);
+  TEST_ASSERT_EQUAL(1, g_tally.ack[11]);
+}
+
+static void test_queue_full_is_reported_not_silent(void) {
+  BleCommandPipeline p;
+  uint8_t w[3 * 40];
+  for (int i = 0; i < 40; i++) {
+    w[i * 3] = (uint8_t)i;
+    w[i * 3 + 1] = 0x01;
+    w[i * 3 + 2] = 0;
+  }
+  TEST_ASSERT_EQUAL((int)BleCommandPipeline::kCapacity, (int)p.submitWrite(w, sizeof(w), 0));
+  g_tally.clear();
+  p.process(0, nullptr, nullptr);  /* no executor: only ACK / reject bookkeeping */
+  g_tally.drain(p);
+  int full = 0;
+  for (int i = 0; i < 40; i++)
+    if (g_tally.fail[i] && g_tally.lastDetail[i] == BLE_CMD_ERR_QUEUE_FULL)
+      full++;
+  TEST_ASSERT_EQUAL(40 - (int)BleCommandPipeline::kCapacity, full);
+  TEST_ASSERT_EQUAL((int)BleCommandPipeline::kCapacity, g_tally.maxDepth);
+}
+
+static void test_tx_failure_and_timeout(void) {
+  BleCommandPipeline p;
+  SimBus bus;
+  ExecCtx ctx = {&bus, true};
+  const uint8_t w[] = {1, 0x80, 0, 2, 0x01, 0, 3, 0x02, 0};
+  p.submitWrite(w, sizeof(w), 0);
+  p.process(0, simExec, &ctx);
+  /* First frame of cmd 1 collides, second goes out: FAIL(tx). cmds 2 and 3 not reported yet: LATE. */
+  const uint16_t tag2 = bus.q[2].tag, tag3 = bus.q[3].tag;
+  p.onTxDone(bus.q[0].tag, false, 10);
+  p.onTxDone(bus.q[1].tag, true, 20);
+  g_tally.clear();
+  p.process(BleCommandPipeline::kTxTimeoutMs + 1, simExec, &ctx);
+  g_tally.drain(p);
+  TEST_ASSERT_EQUAL(1, g_tally.fail[1]);
+  TEST_ASSERT_EQUAL(BLE_CMD_ERR_TX_FAILED, g_tally.lastDetail[1]);
+  TEST_ASSERT_EQUAL(1, g_tally.late[2]);
+  TEST_ASSERT_EQUAL(0, g_tally.fail[2]);
+  TEST_ASSERT_EQUAL(BLE_CMD_ERR_TIMEOUT, g_tally.lastDetail[2]);
+  TEST_ASSERT_EQUAL(2, (int)p.inFlight());
+
+  /* The frame goes out after the timeout: the phone gets DONE, not a failure it would retry on. */
+  p.process(BleCommandPipeline::kTxTimeoutMs + 500, simExec, &ctx);
+  p.onTxDone(tag2, true, BleCommandPipeline::kTxTimeoutMs + 600);
+  g_tally.drain(p);
+  TEST_ASSERT_EQUAL(1, g_tally.late[2]);
+  TEST_ASSERT_EQUAL(1, g_tally.done[2]);
+  TEST_ASSERT_EQUAL(0, g_tally.fail[2]);
+  TEST_ASSERT_EQUAL(1, (int)p.inFlight());
+
+  /* A result that never comes frees the slot without a second status. */
+  p.process(BleCommandPipeline::kTxGiveUpMs, simExec, &ctx);
+  g_tally.drain(p);
+  TEST_ASSERT_EQUAL(0, (int)p.inFlight());
+  TEST_ASSERT_EQUAL(1, g_tally.late[3]);
+  TEST_ASSERT_EQUAL(0, g_tally.fail[3] + g_tally.done[3]);
+  TEST_ASSERT_EQUAL_UINT32(2, p.late());
+  TEST_ASSERT_EQUAL_UINT32(1, p.lost());
+  p.onTxDone(tag3, true, BleCommandPipeline::kTxGiveUpMs + 1); /* too late: ignored */
+  TEST_ASSERT_EQUAL(0, (int)p.pendingNotifications());
+}
+
+/* Bursty phone: every 400 ms a burst of 1..24 commands in one WRITE_NR; main loop ticks every 5 ms. */
+static void test_round_trip_latency_and_throughput_bursty(void) {
+  BleCommandPipeline p;
+  SimBus bus;
+  bus.collisionPct = 2;
+  ExecCtx ctx = {&bus, true};
+  g_tally.clear();
+  uint8_t reqId = 0;
+  uint32_t sent = 0, ackLatMax = 0;
+  uint32_t sentAt[256] = {0};
+  const uint32_t kDurationMs = 60000;
+  uint32_t burstRng = 777;
+  for (uint32_t now = 0; now < kDurationMs + 3000; now++) {
+    if (now < kDurationMs && now % 400 == 0) {
+      burstRng = burstRng * 1664525u + 1013904223u;
+      int n = 1 + (int)((burstRng >> 24) % 24);
+      uint8_t w[24 * 3];
+      for (int i = 0; i < n; i++) {
+        w[i * 3] = reqId;
+        w[i * 3 + 1] = (uint8_t)(i % 5 == 4 ? 0x80 : (i % 12));
+        w[i * 3 + 2] = 0;
+        sentAt[reqId] = now;
+        reqId++;
+      }
+      p.submitWrite(w, (size_t)n * 3, now);
+      sent += (uint32_t)n;
+    }
+    bus.run(now, p);
+    if (now % 5 == 0) {
+      int acksBefore = 0;
+      for (int i = 0; i < 256; i++)
+        acksBefore += g_tally.ack[i];
+      p.process(now, simExec, &ctx);
+      uint8_t buf[256];
+      size_t n;
+      while ((n = p.takeNotifications(buf, sizeof(buf))) > 0) {
+        for (size_t i = 0; i < n; i += 4) {
+          if (buf[i + 1] == BLE_CMD_ST_ACK) {
+            uint32_t lat = now - sentAt[buf[i]];
+            if (lat > ackLatMax)
+              ackLatMax = lat;
+          }
+          if (buf[i + 2] > g_tally.maxDepth)
+            g_tally.maxDepth = buf[i + 2];
+        }
+      }
+      (void)acksBefore;
+    }
+  }
+  uint32_t done = p.completed(), failed = p.failed();
+  printf("\n  bursty 60 s: sent %u, done %u, failed %u (tx %d%% collisions, no retry in sim)\n",
+         (unsigned)sent, (unsigned)done, (unsigned)failed, bus.collisionPct);
+  printf("  ACK latency max %u ms; rx->DONE avg %u ms, max %u ms; max depth %u\n", (unsigned)ackLatMax,
+         (unsigned)p.latencyAvgMs(), (unsigned)p.latencyMaxMs(), (unsigned)g_tally.maxDepth);
+  printf("  throughput %.1f commands/s, bus %d frames (%.1f frames/s)\n", done * 1000.0 / kDurationMs,
+         bus.framesSent, bus.framesSent * 1000.0 / kDurationMs);
+  TEST_ASSERT_EQUAL_UINT32(sent, done + failed);
+  TEST_ASSERT_TRUE(ackLatMax <= 5);
+  TEST_ASSERT_EQUAL_UINT32(0, p.rejectedFull());
+  TEST_ASSERT_TRUE(failed < sent / 20);
+}
+
+/* Two phones: each gets only its own statuses; batches never mix origins. */
+static void test_notifications_go_to_sender_only(void) {
+  BleCommandPipeline p;
+  SimBus bus;
+  ExecCtx ctx = {&bus, true};
+  const uint8_t a[] = {1, 0x93, 0, 2, 0x93, 0};
+  const uint8_t b[] = {7, 0x93, 0};
+  TEST_ASSERT_EQUAL(2, (int)p.submitWrite(a, sizeof(a), 0, 10));
+  TEST_ASSERT_EQUAL(1, (int)p.submitWrite(b, sizeof(b), 0, 20));
+  p.process(0, simExec, &ctx);
+  int recA = 0, recB = 0;
+  uint8_t buf[256];
+  size_t n;
+  uint16_t origin = 0;
+  while ((n = p.takeNotifications(buf, sizeof(buf), &origin)) > 0) {
+    for (size_t i = 0; i < n; i += BLE_CMD_NOTIFY_RECORD_LEN) {
+      if (origin == 10) {
+        TEST_ASSERT_TRUE(buf[i] == 1 || buf[i] == 2);
+        recA++;
+      } else {
+        TEST_ASSERT_EQUAL(20, origin);
+        TEST_ASSERT_EQUAL(7, buf[i]);
+        recB++;
+      }
+    }
+  }
+  /* ACK + DONE per command. */
+  TEST_ASSERT_EQUAL(4, recA);
+  TEST_ASSERT_EQUAL(2, recB);
+}
+
+/* Real threads: producer = "NimBLE task", consumer = "main loop". Every reqId gets exactly one final status. */
+static void test_spsc_threads(void) {
+  BleCommandPipeline p;
+  const int kTotal = 200000;
+  std::atomic<bool> producerDone{false};
+  std::thread prod([&]() {
+    uint8_t w[3];
+    for (int i = 0; i < kTotal; i++) {
+      w[0] = (uint8_t)i;
+      w[1] = 0x93;
+      w[2] = 0;
+      p.submitWrite(w, 3, 0);
+      if ((i & 63) == 0)
+        std::this_thread::yield();
+    }
+    producerDone.store(true);
+  });
+  SimBus bus;
+  ExecCtx ctx = {&bus, true};
+  uint32_t finals = 0;
+  uint8_t buf[256];
+  while (!producerDone.load() || p.queued() > 0 || p.pendingNotifications() > 0) {
+    p.process(0, simExec, &ctx);
+    size_t n;
+    while ((n = p.takeNotifications(buf, sizeof(buf))) > 0)
+      for (size_t i = 0; i < n; i += 4)
+        if (buf[i + 1] != BLE_CMD_ST_ACK)
+          finals++;
+  }
+  prod.join();
+  p.process(0, simExec, &ctx);
+  size_t n;
+  while ((n = p.takeNotifications(buf, sizeof(buf))) > 0)
+    for (size_t i = 0; i < n; i += 4)
+      if (buf[i + 1] != BLE_CMD_ST_ACK)
+        finals++;
+  printf("\n  threads: %d submitted, %u final statuses, %u queue-full\n", kTotal, (unsigned)finals,
+         (unsigned)p.rejectedFull());
+  /* Producer-side reject ring can overflow under a flood; those are counted in rejectedFull. */
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)kTotal, p.completed() + p.rejectedFull());
+  TEST_ASSERT_TRUE(finals <= (uint32_t)kTotal);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_multiple_records_and_params);
+  RUN_TEST(test_bad_frame_and_unknown_and_not_synced);
+  RUN_TEST(test_queue_full_is_reported_not_silent);
+  RUN_TEST(test_tx_failure_and_timeout);
+  RUN_TEST(test_round_trip_latency_and_throughput_bursty);
+  RUN_TEST(test_notifications_go_to_sender_only);
+  RUN_TEST(test_spsc_threads);
+  return UNITY_END();
+}
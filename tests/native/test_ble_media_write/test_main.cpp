@@ -0,0 +1,291 @@
+/*
+ * Host tests: Now Playing / cluster text writes (BleMediaWrite.cpp).
+ * Heap allocations per write are counted through global operator new: old path (value copied into a
+ * std::string, as getValue() did) vs the in-place parser.
+ * Run: pio test -e native -f native/test_ble_media_write
+ */
+#include <unity.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include "BleMediaWrite.h"
+
+static size_t g_allocs = 0;
+
+void *operator new(size_t n) {
+  g_allocs++;
+  void *p = malloc(n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* Build a batch write. */
+struct Batch {
+  uint8_t b[BLE_MEDIA_MAX_WRITE];
+  size_t n = 1;
+  Batch() { b[0] = BLE_MEDIA_BATCH_MARKER; }
+  Batch &text(uint8_t type, const char *s) {
+    size_t l = strlen(s);
+    b[n++] = type;
+    b[n++] = (uint8_t)l;
+    memcpy(b + n, s, l);
+    n += l;
+    return *this;
+  }
+  Batch &u32(uint8_t type, uint32_t v) {
+    b[n++] = type;
+    b[n++] = 4;
+    for (int i = 0; i < 4; i++)
+      b[n++] = (uint8_t)(v >> (8 * i));
+    return *this;
+  }
+};
+
+static void test_legacy_track_artist(void) {
+  BleMediaInfo m;
+  const char w[] = "Numb\0Linkin Park";
+  TEST_ASSERT_TRUE(bleParseNowPlaying((const uint8_t *)w, sizeof(w) - 1, &m));
+  TEST_ASSERT_EQUAL_STRING("Numb", m.track);
+  TEST_ASSERT_EQUAL_STRING("Linkin Park", m.artist);
+  TEST_ASSERT_EQUAL(BLE_MEDIA_F_TRACK | BLE_MEDIA_F_ARTIST, m.fields);
+  TEST_ASSERT_TRUE(bleParseNowPlaying((const uint8_t *)"Intro", 5, &m));
+  TEST_ASSERT_EQUAL_STRING("Intro", m.track);
+  TEST_ASSERT_EQUAL_STRING("", m.artist);
+}
+
+static void test_batch_all_fields_and_unknown_type(void) {
+  Batch b;
+  b.text(BLE_MEDIA_T_TRACK, "Teardrop").text(BLE_MEDIA_T_ARTIST, "Massive Attack");
+  b.b[b.n++] = 0x7E;  /* future field */
+  b.b[b.n++] = 2;
+  b.b[b.n++] = 0xAA;
+  b.b[b.n++] = 0xBB;
+  b.text(BLE_MEDIA_T_ALBUM, "Mezzanine").u32(BLE_MEDIA_T_DURATION, 330000).u32(BLE_MEDIA_T_POSITION, 12500);
+  BleMediaInfo m;
+  TEST_ASSERT_TRUE(bleParseNowPlaying(b.b, b.n, &m));
+  TEST_ASSERT_EQUAL_STRING("Teardrop", m.track);
+  TEST_ASSERT_EQUAL_STRING("Massive Attack", m.artist);
+  TEST_ASSERT_EQUAL_STRING("Mezzanine", m.album);
+  TEST_ASSERT_EQUAL_UINT32(330000, m.durationMs);
+  TEST_ASSERT_EQUAL_UINT32(12500, m.positionMs);
+  TEST_ASSERT_EQUAL(BLE_MEDIA_F_TEXT | BLE_MEDIA_F_DURATION | BLE_MEDIA_F_POSITION, m.fields);
+}
+
+static void test_batch_malformed(void) {
+  BleMediaInfo m;
+  Batch b;
+  b.text(BLE_MEDIA_T_TRACK, "Track");
+  TEST_ASSERT_FALSE(bleParseNowPlaying(b.b, b.n - 1, &m));  /* value runs past the end */
+  Batch c;
+  c.b[c.n++] = BLE_MEDIA_T_DURATION;
+  c.b[c.n++] = 2;
+  c.b[c.n++] = 1;
+  c.b[c.n++] = 2;
+  TEST_ASSERT_FALSE(bleParseNowPlaying(c.b, c.n, &m));  /* duration must be 4 bytes */
+  const uint8_t lone[] = {BLE_MEDIA_BATCH_MARKER, BLE_MEDIA_T_TRACK};
+  TEST_ASSERT_FALSE(bleParseNowPlaying(lone, sizeof(lone), &m));
+  const uint8_t empty[] = {BLE_MEDIA_BATCH_MARKER};
+  TEST_ASSERT_FALSE(bleParseNowPlaying(empty, sizeof(empty), &m));
+}
+
+static void test_utf8_truncation(void) {
+  /* 40 x "я" (2 bytes each) = 80 bytes: 63 bytes fit, the cut must not split a character. */
+  char s[81];
+  for (int i = 0; i < 40; i++) {
+    s[2 * i] = (char)0xD1;
+    s[2 * i + 1] = (char)0x8F;
+  }
+  s[80] = '\0';
+  Batch b;
+  b.text(BLE_MEDIA_T_TRACK, s);
+  BleMediaInfo m;
+  TEST_ASSERT_TRUE(bleParseNowPlaying(b.b, b.n, &m));
+  TEST_ASSERT_EQUAL(62, (int)strlen(m.track));
+  char out[BLE_CLUSTER_TEXT_MAX + 1];
+  /* 3-byte "€" at bytes 18..20: does not fit in 20, dropped whole. */
+  const char euro[] = "Price 12345678901 \xE2\x82\xAC";
+  TEST_ASSERT_EQUAL(18, (int)bleCopyUtf8(out, sizeof(out), (const uint8_t *)euro, sizeof(euro) - 1));
+  TEST_ASSERT_EQUAL_STRING("Price 12345678901 ", out);
+}
+
+static void test_song_change_burst_is_one_update(void) {
+  BleMediaDebouncer d;
+  BleMediaInfo m, out;
+  /* Typical phone: title first, then title + artist, then the full batch, then progress. */
+  bleParseNowPlaying((const uint8_t *)"Numb", 4, &m);
+  d.offer(m, 1000);
+  const char w2[] = "Numb\0Linkin Park";
+  bleParseNowPlaying((const uint8_t *)w2, sizeof(w2) - 1, &m);
+  d.offer(m, 1060);
+  Batch b;
+  b.text(BLE_MEDIA_T_TRACK, "Numb").text(BLE_MEDIA_T_ARTIST, "Linkin Park").text(BLE_MEDIA_T_ALBUM, "Meteora");
+  bleParseNowPlaying(b.b, b.n, &m);
+  d.offer(m, 1120);
+  TEST_ASSERT_FALSE(d.poll(1120 + BleMediaDebouncer::kQuietMs - 1, &out));
+  TEST_ASSERT_TRUE(d.poll(1120 + BleMediaDebouncer::kQuietMs, &out));
+  TEST_ASSERT_EQUAL_STRING("Meteora", out.album);
+  TEST_ASSERT_EQUAL_STRING("Linkin Park", out.artist);
+  /* Progress only: merged, nothing for the bus. */
+  Batch p;
+  p.u32(BLE_MEDIA_T_POSITION, 5000);
+  bleParseNowPlaying(p.b, p.n, &m);
+  d.offer(m, 2000);
+  TEST_ASSERT_FALSE(d.poll(3000, &out));
+  TEST_ASSERT_EQUAL_UINT32(5000, d.current().positionMs);
+  /* Same song re-sent (app resumed): no update. */
+  bleParseNowPlaying(b.b, b.n, &m);
+  d.offer(m, 4000);
+  TEST_ASSERT_FALSE(d.poll(5000, &out));
+  TEST_ASSERT_EQUAL(1, (int)d.emitted());
+  TEST_ASSERT_EQUAL(1, (int)d.unchanged());
+}
+
+static void test_continuous_writes_flush_after_max_hold(void) {
+  BleMediaDebouncer d;
+  BleMediaInfo m, out;
+  char name[16];
+  int emits = 0;
+  /* Someone skipping tracks every 100 ms: still updates once per kMaxHoldMs. */
+  for (uint32_t t = 0; t < 5000; t += 100) {
+    snprintf(name, sizeof(name), "T%u", (unsigned)t);
+    bleParseNowPlaying((const uint8_t *)name, strlen(name), &m);
+    d.offer(m, t);
+    if (d.poll(t, &out))
+      emits++;
+  }
+  TEST_ASSERT_INT_WITHIN(1, 5000 / (int)BleMediaDebouncer::kMaxHoldMs, emits);
+}
+
+static void test_cluster_text_latest_wins(void) {
+  BleTextDebouncer d;
+  char out[BLE_CLUSTER_TEXT_MAX + 1];
+  d.offer((const uint8_t *)"HELLO", 5, 0);
+  d.offer((const uint8_t *)"HELLO WORLD, THIS IS TOO LONG", 29, 50);
+  TEST_ASSERT_FALSE(d.poll(100, out, sizeof(out)));
+  TEST_ASSERT_TRUE(d.poll(50 + BleTextDebouncer::kQuietMs, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_STRING("HELLO WORLD, THIS IS", out);
+  TEST_ASSERT_FALSE(d.poll(1000, out, sizeof(out)));
+  /* Repeat is sent (refresh). */
+  d.offer((const uint8_t *)"HELLO", 5, 2000);
+  TEST_ASSERT_TRUE(d.poll(2000 + BleTextDebouncer::kQuietMs, out, sizeof(out)));
+}
+
+/* Old callback: value -> std::string (what getValue() produced), then split into static buffers. */
+static void oldNowPlaying(const uint8_t *data, size_t len, char *track, char *artist) {
+  std::string value(reinterpret_cast<const char *>(data), len);
+  const char *p = value.data();
+  size_t t = 0;
+  while (t < value.length() && p[t])
+    t++;
+  size_t tl = t < 95 ? t : 95;
+  memcpy(track, p, tl);
+  track[tl] = '\0';
+  const char *a = t + 1 < value.length() ? p + t + 1 : "";
+  strncpy(artist, a, 95);
+  artist[95] = '\0';
+}
+
+static void test_heap_allocations_per_write(void) {
+  static const char *kTracks[] = {"Numb", "Teardrop", "Wish You Were Here (2011 Remaster)",
+                                  "Bohemian Rhapsody - Remastered 2011", "Around the World"};
+  static const char *kArtists[] = {"Linkin Park", "Massive Attack", "Pink Floyd", "Queen", "Daft Punk"};
+  const int kWrites = 1000;
+  uint8_t legacy[BLE_MEDIA_MAX_WRITE];
+  Batch batches[5];
+  size_t legacyLen[5];
+  for (int i = 0; i < 5; i++) {
+    size_t tl = strlen(kTracks[i]), al = strlen(kArtists[i]);
+    legacyLen[i] = tl + 1 + al;
+    batches[i].text(BLE_MEDIA_T_TRACK, kTracks[i]).text(BLE_MEDIA_T_ARTIST, kArtists[i])
+        .text(BLE_MEDIA_T_ALBUM, "Album").u32(BLE_MEDIA_T_DURATION, 240000).u32(BLE_MEDIA_T_POSITION, 1000);
+  }
+  static char track[96], artist[96];
+  size_t before = g_allocs;
+  for (int w = 0; w < kWrites; w++) {
+    int i = w % 5;
+    memcpy(legacy, kTracks[i], strlen(kTracks[i]) + 1);
+    memcpy(legacy + strlen(kTracks[i]) + 1, kArtists[i], strlen(kArtists[i]));
+    oldNowPlaying(legacy, legacyLen[i], track, artist);
+  }
+  const double oldPerWrite = (double)(g_allocs - before) / kWrites;
+
+  BleMediaDebouncer d;
+  BleMediaInfo m, out;
+  before = g_allocs;
+  for (int w = 0; w < kWrites; w++) {
+    int i = w % 5;
+    bleParseNowPlaying(batches[i].b, batches[i].n, &m);
+    d.offer(m, (uint32_t)w * 10);
+    d.poll((uint32_t)w * 10, &out);
+  }
+  const size_t newAllocs = g_allocs - before;
+  printf("\n  heap allocations per Now Playing write: before %.2f (std::string copy; +1 NimBLEAttValue copy on device), after %.2f\n",
+         oldPerWrite, (double)newAllocs / kWrites);
+  TEST_ASSERT_TRUE(oldPerWrite > 0.5);
+  TEST_ASSERT_EQUAL(0, (int)newAllocs);
+}
+
+static void test_bus_updates_per_song_change(void) {
+  /* 50 song changes, each: title, title + artist, batch with album, 3 progress writes (phone media
+   * session updates). Old path: every text write = cluster + MID update. */
+  BleMediaDebouncer d;
+  BleMediaInfo m, out;
+  int oldUpdates = 0, newUpdates = 0;
+  uint32_t t = 0;
+  char title[16];
+  for (int song = 0; song < 50; song++) {
+    snprintf(title, sizeof(title), "Song %d", song);
+    Batch b;
+    b.text(BLE_MEDIA_T_TRACK, title).text(BLE_MEDIA_T_ARTIST, "Artist").text(BLE_MEDIA_T_ALBUM, "Album");
+    Batch ta;
+    ta.text(BLE_MEDIA_T_TRACK, title).text(BLE_MEDIA_T_ARTIST, "Artist");
+    const Batch *writes[3] = {nullptr, &ta, &b};
+    for (int k = 0; k < 3; k++, t += 40) {
+      if (k == 0)
+        bleParseNowPlaying((const uint8_t *)title, strlen(title), &m);
+      else
+        bleParseNowPlaying(writes[k]->b, writes[k]->n, &m);
+      d.offer(m, t);
+      oldUpdates++;
+      if (d.poll(t, &out))
+        newUpdates++;
+    }
+    for (int k = 0; k < 3; k++, t += 1000) {
+      Batch p;
+      p.u32(BLE_MEDIA_T_POSITION, (uint32_t)k * 1000);
+      bleParseNowPlaying(p.b, p.n, &m);
+      d.offer(m, t);
+      if (d.poll(t, &out))
+        newUpdates++;
+    }
+    t += 180000;
+    if (d.poll(t, &out))
+      newUpdates++;
+  }
+  printf("  I-Bus text updates for 50 song changes: before %d, after %d\n", oldUpdates, newUpdates);
+  TEST_ASSERT_EQUAL(50, newUpdates);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_legacy_track_artist);
+  RUN_TEST(test_batch_all_fields_and_unknown_type);
+  RUN_TEST(test_batch_malformed);
+  RUN_TEST(test_utf8_truncation);
+  RUN_TEST(test_song_change_burst_is_one_update);
+  RUN_TEST(test_continuous_writes_flush_after_max_hold);
+  RUN_TEST(test_cluster_text_latest_wins);
+  RUN_TEST(test_heap_allocations_per_write);
+  RUN_TEST(test_bus_updates_per_song_change);
+  return UNITY_END();
+}
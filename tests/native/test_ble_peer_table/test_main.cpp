@@ -0,0 +1,231 @@
+/*
+ * Host tests: BLE peer table for several connected phones (BlePeerTable.cpp).
+ * Scaling test: status fan-out CPU cost and modelled notification latency for 1..4 connections.
+ * Run: pio test -e native -f native/test_ble_peer_table
+ */
+#include <unity.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "BlePeerTable.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static const uint8_t kAddrA[6] = {1, 2, 3, 4, 5, 6};
+static const uint8_t kAddrB[6] = {9, 8, 7, 6, 5, 4};
+
+static void addrFor(int n, uint8_t *out) {
+  for (int i = 0; i < 6; i++)
+    out[i] = (uint8_t)(0x10 * n + i);
+}
+
+static void test_connect_linger_and_reuse(void) {
+  BlePeerTable t;
+  bool reused = true;
+  int a = t.onConnect(1, kAddrA, 0, &reused);
+  TEST_ASSERT_EQUAL(0, a);
+  TEST_ASSERT_FALSE(reused);
+  int b = t.onConnect(2, kAddrB, 10, &reused);
+  TEST_ASSERT_EQUAL(1, b);
+  TEST_ASSERT_EQUAL(2, (int)t.linkedCount());
+  t.peer(a).commands = 7;
+  TEST_ASSERT_EQUAL(a, t.onDisconnect(1, 1000));
+  TEST_ASSERT_EQUAL(1, (int)t.linkedCount());
+  TEST_ASSERT_TRUE(t.anyPresent());
+  TEST_ASSERT_EQUAL(-1, t.find(1));
+  /* Same phone back within the linger time, new handle: same slot, state kept. */
+  TEST_ASSERT_EQUAL(a, t.onConnect(5, kAddrA, 2000, &reused));
+  TEST_ASSERT_TRUE(reused);
+  TEST_ASSERT_EQUAL(7, (int)t.peer(a).commands);
+  TEST_ASSERT_EQUAL(a, t.find(5));
+  /* Gone for longer than the linger time: slot freed. */
+  t.onDisconnect(5, 3000);
+  t.onDisconnect(2, 3000);
+  TEST_ASSERT_EQUAL(0, (int)t.expire(3000 + BlePeerTable::kLingerMs - 1));
+  TEST_ASSERT_TRUE(t.anyPresent());
+  TEST_ASSERT_EQUAL(2, (int)t.expire(3000 + BlePeerTable::kLingerMs));
+  TEST_ASSERT_FALSE(t.anyPresent());
+}
+
+static void test_full_table_takes_oldest_lingering_slot(void) {
+  BlePeerTable t;
+  uint8_t addr[6];
+  for (int i = 0; i < (int)BlePeerTable::kMaxPeers; i++) {
+    addrFor(i, addr);
+    TEST_ASSERT_EQUAL(i, t.onConnect((uint16_t)(10 + i), addr, 0));
+  }
+  addrFor(9, addr);
+  TEST_ASSERT_EQUAL(-1, t.onConnect(99, addr, 0));
+  t.onDisconnect(12, 100);
+  t.onDisconnect(11, 200);
+  TEST_ASSERT_EQUAL(2, t.onConnect(99, addr, 300));  /* oldest lingering */
+  TEST_ASSERT_EQUAL(2, t.find(99));
+}
+
+static void test_status_fanout_once_per_packet_per_phone(void) {
+  BlePeerTable t;
+  t.onConnect(1, kAddrA, 0);
+  t.onConnect(2, kAddrB, 0);
+  const uint8_t pkt1[16] = {1, 90, 100};
+  const uint8_t pkt2[16] = {1, 91, 100};
+  const uint32_t h1 = blePeerHash(pkt1, 16), h2 = blePeerHash(pkt2, 16);
+  TEST_ASSERT_NOT_EQUAL(h1, h2);
+  /* Nobody subscribed yet. */
+  TEST_ASSERT_EQUAL(0, t.statusTargets(h1, false));
+  t.onSubscribe(1, BLE_SUB_STATUS, true);
+  TEST_ASSERT_EQUAL(0x01, t.statusTargets(h1, false));
+  TEST_ASSERT_EQUAL(0x00, t.statusTargets(h1, false));
+  /* Phone B subscribes later: it gets the unchanged packet, A does not get it again. */
+  t.onSubscribe(2, BLE_SUB_STATUS, true);
+  TEST_ASSERT_EQUAL(0x02, t.statusTargets(h1, false));
+  TEST_ASSERT_EQUAL(0x03, t.statusTargets(h2, false));
+  TEST_ASSERT_EQUAL(0x03, t.statusTargets(h2, true));
+  t.onSubscribe(1, BLE_SUB_STATUS, false);
+  TEST_ASSERT_EQUAL(0x02, t.statusTargets(h1, false));
+  TEST_ASSERT_EQUAL(3, (int)t.peer(0).notifies);
+  TEST_ASSERT_EQUAL(2, (int)t.peer(0).notifiesSkipped);
+}
+
+static void warmNear(BlePeer &p, uint32_t &now) {
+  for (int i = 0; i < 10; i++, now += 200)
+    p.proximity.addSample(-55, now);
+}
+
+static void test_car_event_aggregation(void) {
+  BlePeerTable t;
+  t.onConnect(1, kAddrA, 0);
+  t.onConnect(2, kAddrB, 0);
+  t.peer(0).proximity.setCalibration(BleProximityCalibration());
+  t.peer(1).proximity.setCalibration(BleProximityCalibration());
+  uint32_t now = 0;
+  warmNear(t.peer(0), now);
+  TEST_ASSERT_EQUAL(PROX_NEAR, t.peer(0).proximity.state());
+  TEST_ASSERT_EQUAL(PROX_EVT_NEAR, t.carEvent(0, PROX_EVT_NEAR));
+  /* Second driver arrives while the first is at the car: no second unlock. */
+  warmNear(t.peer(1), now);
+  TEST_ASSERT_EQUAL(PROX_EVT_NONE, t.carEvent(1, PROX_EVT_NEAR));
+  /* One walks away while the other is still near: do not lock. */
+  TEST_ASSERT_EQUAL(PROX_EVT_NONE, t.carEvent(0, PROX_EVT_LEAVING));
+  /* The remaining phone's link drops: the leaving one may lock. */
+  t.onDisconnect(2, now);
+  TEST_ASSERT_EQUAL(PROX_EVT_LEAVING, t.carEvent(0, PROX_EVT_LEAVING));
+  TEST_ASSERT_EQUAL(PROX_EVT_APPROACH, t.carEvent(0, PROX_EVT_APPROACH));
+}
+
+static void test_rssi_round_robin(void) {
+  BlePeerTable t;
+  uint8_t addr[6];
+  for (int i = 0; i < 4; i++) {
+    addrFor(i, addr);
+    t.onConnect((uint16_t)(i + 1), addr, 0);
+  }
+  int samples[4] = {0};
+  /* Main loop at 10 ms: each phone sampled every 200 ms, one per tick. */
+  for (uint32_t now = 200; now < 10200; now += 10) {
+    int idx = t.nextRssiPeer(now, 200);
+    if (idx >= 0)
+      samples[idx]++;
+  }
+  for (int i = 0; i < 4; i++)
+    TEST_ASSERT_INT_WITHIN(1, 50, samples[i]);
+}
+
+/* ── Scaling 1..4 phones ───────────────────────────────────────────────── */
+
+/* BLE link-layer model: each link has its own connection event every ciMs with a staggered anchor; a
+ * notify queued at t leaves at that link's next anchor. updateStatus() calls notify() for the links one
+ * after another, so link i is queued i * notifyCpuMs later. Status changes at random times. */
+struct LatencyStats {
+  double avgMs;
+  double maxMs;
+};
+
+static LatencyStats modelLatency(int links, double ciMs, double notifyCpuMs, uint32_t seed) {
+  uint32_t s = seed;
+  double sum = 0, mx = 0;
+  int n = 0;
+  const double airMs = 0.41;  /* 16-byte notify + ATT/L2CAP/LL headers at 1M, plus T_IFS and empty ACK */
+  for (int k = 0; k < 20000; k++) {
+    s = s * 1664525u + 1013904223u;
+    double t = (double)(s >> 8) / (double)(1u << 24) * 1000.0;
+    for (int i = 0; i < links; i++) {
+      double anchor = ciMs * i / links;  /* controller staggers anchors across the interval */
+      double queued = t + notifyCpuMs * (i + 1);
+      double wait = ciMs - fmod(queued - anchor + 10 * ciMs, ciMs);
+      if (wait >= ciMs)
+        wait -= ciMs;
+      double lat = (queued - t) + wait + airMs;
+      sum += lat;
+      if (lat > mx)
+        mx = lat;
+      n++;
+    }
+  }
+  LatencyStats r = {sum / n, mx};
+  return r;
+}
+
+static volatile uint32_t g_sink;
+
+static void test_scaling_one_to_four_connections(void) {
+  const double kCiMs = 30.0;  /* DRIVING profile max interval (24 x 1.25 ms) */
+  const double kNotifyCpuMs = 0.06;  /* one NimBLE notify() on the S3: mbuf alloc + GATT/L2CAP enqueue */
+  /* Status trace: 20 Hz updateStatus, packet changes about twice a second (rpm/coolant). */
+  const int kUpdates = 200000;
+  uint8_t pkt[16] = {0};
+  printf("\n  phones | notifies/s dedup (naive) | fan-out ns/update (host) | latency avg/max ms (CI %.0f ms)\n",
+         kCiMs);
+  double nsPerUpdate[5] = {0};
+  for (int links = 1; links <= 4; links++) {
+    BlePeerTable t;
+    uint8_t addr[6];
+    for (int i = 0; i < links; i++) {
+      addrFor(i, addr);
+      t.onConnect((uint16_t)(i + 1), addr, 0);
+      t.onSubscribe((uint16_t)(i + 1), BLE_SUB_STATUS, true);
+    }
+    uint32_t s = 99;
+    uint32_t sent = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int u = 0; u < kUpdates; u++) {
+      s = s * 1103515245u + 12345u;
+      if (((s >> 16) % 10) == 0)
+        pkt[4] = (uint8_t)(s >> 24);
+      uint32_t h = blePeerHash(pkt, sizeof(pkt));
+      uint8_t mask = t.statusTargets(h, false);
+      for (int i = 0; i < links; i++)
+        if (mask & (1u << i))
+          sent++;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    g_sink = sent;
+    nsPerUpdate[links] = std::chrono::duration<double, std::nano>(t1 - t0).count() / kUpdates;
+    const double seconds = kUpdates / 20.0;
+    LatencyStats lat = modelLatency(links, kCiMs, kNotifyCpuMs, 7);
+    printf("  %6d | %9.1f (%5.1f)            | %24.1f | %.1f / %.1f\n", links, sent / seconds,
+           links * 20.0, nsPerUpdate[links], lat.avgMs, lat.maxMs);
+    /* Each phone gets each distinct packet exactly once. */
+    uint32_t perPhone = t.peer(0).notifies;
+    for (int i = 1; i < links; i++)
+      TEST_ASSERT_EQUAL_UINT32(perPhone, t.peer(i).notifies);
+    TEST_ASSERT_TRUE(sent < (uint32_t)(links * kUpdates / 5));
+    TEST_ASSERT_TRUE(lat.maxMs <= kCiMs + 1.0);
+  }
+  /* Cost grows with phones, but stays far below a main-loop tick. */
+  TEST_ASSERT_TRUE(nsPerUpdate[4] < 20000.0);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_linger_and_reuse);
+  RUN_TEST(test_full_table_takes_oldest_lingering_slot);
+  RUN_TEST(test_status_fanout_once_per_packet_per_phone);
+  RUN_TEST(test_car_event_aggregation);
+  RUN_TEST(test_rssi_round_robin);
+  RUN_TEST(test_scaling_one_to_four_connections);
+  return UNITY_END();
+}
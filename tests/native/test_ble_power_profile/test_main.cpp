@@ -0,0 +1,171 @@
+/*
+ * Host tests: BLE power profile state machine (BlePowerProfile.cpp).
+ * Run: pio test -e native -f native/test_ble_power_profile
+ */
+#include <unity.h>
+#include <cstdio>
+#include "BlePowerProfile.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_boot_is_approach_then_parked_after_hold(void) {
+  BlePowerPolicy p;
+  p.setIgnition(0, 1000);
+  TEST_ASSERT_TRUE(p.update(1000));
+  TEST_ASSERT_EQUAL(BLE_PROFILE_APPROACH, p.profile());
+  TEST_ASSERT_FALSE(p.update(1000 + BlePowerPolicy::kApproachHoldMs - 1));
+  TEST_ASSERT_TRUE(p.update(1000 + BlePowerPolicy::kApproachHoldMs));
+  TEST_ASSERT_EQUAL(BLE_PROFILE_PARKED, p.profile());
+}
+
+static void test_ignition_on_is_driving_off_is_approach(void) {
+  BlePowerPolicy p;
+  p.setIgnition(0, 0);
+  p.update(0);
+  p.update(200000);
+  TEST_ASSERT_EQUAL(BLE_PROFILE_PARKED, p.profile());
+  p.setIgnition(2, 300000);
+  TEST_ASSERT_TRUE(p.update(300000));
+  TEST_ASSERT_EQUAL(BLE_PROFILE_DRIVING, p.profile());
+  p.setIgnition(0, 900000);
+  TEST_ASSERT_TRUE(p.update(900000));
+  TEST_ASSERT_EQUAL(BLE_PROFILE_APPROACH, p.profile());
+}
+
+static void test_activity_reenters_approach(void) {
+  BlePowerPolicy p;
+  p.setIgnition(0, 0);
+  p.update(0);
+  p.update(500000);
+  TEST_ASSERT_EQUAL(BLE_PROFILE_PARKED, p.profile());
+  p.noteActivity(600000);  /* door unlocked with the key fob */
+  TEST_ASSERT_TRUE(p.update(600000));
+  TEST_ASSERT_EQUAL(BLE_PROFILE_APPROACH, p.profile());
+}
+
+static void test_low_battery_forces_parked_unless_driving(void) {
+  BlePowerPolicy p;
+  p.setBattery(10, false);
+  p.setIgnition(0, 0);
+  p.update(0);
+  TEST_ASSERT_EQUAL(BLE_PROFILE_PARKED, p.profile());
+  p.noteActivity(10000);
+  TEST_ASSERT_FALSE(p.update(10000));
+  p.setIgnition(2, 20000);
+  p.update(20000);
+  TEST_ASSERT_EQUAL(BLE_PROFILE_DRIVING, p.profile());
+  /* External power: battery level ignored. */
+  p.setBattery(10, true);
+  p.setIgnition(0, 30000);
+  p.update(30000);
+  TEST_ASSERT_EQUAL(BLE_PROFILE_APPROACH, p.profile());
+}
+
+static void test_dwell_suppresses_ignition_bounce(void) {
+  BlePowerPolicy p;
+  p.setIgnition(2, 0);
+  p.update(0);
+  TEST_ASSERT_EQUAL(BLE_PROFILE_DRIVING, p.profile());
+  p.setIgnition(0, 500);
+  TEST_ASSERT_FALSE(p.update(500));
+  p.setIgnition(2, 800);
+  TEST_ASSERT_FALSE(p.update(2500));
+  TEST_ASSERT_EQUAL(BLE_PROFILE_DRIVING, p.profile());
+  TEST_ASSERT_EQUAL_UINT32(0, p.profileSwitches());
+}
+
+static void test_reconnect_time_recorded_per_profile(void) {
+  BlePowerPolicy p;
+  p.setIgnition(0, 0);
+  p.update(0);
+  p.setConnected(true, 300);  /* first connect after boot is not a reconnect */
+  TEST_ASSERT_EQUAL_UINT32(0, p.reconnectStats(BLE_PROFILE_APPROACH).count);
+  p.setConnected(false, 10000);
+  p.setConnected(true, 10080);
+  const BleReconnectStats &a = p.reconnectStats(BLE_PROFILE_APPROACH);
+  TEST_ASSERT_EQUAL_UINT32(1, a.count);
+  TEST_ASSERT_EQUAL_UINT32(80, a.lastMs);
+
+  /* Phone leaves; hours later the driver unlocks the car and the phone reconnects. */
+  p.setConnected(false, 20000);
+  p.update(20000 + BlePowerPolicy::kApproachHoldMs);
+  TEST_ASSERT_EQUAL(BLE_PROFILE_PARKED, p.profile());
+  p.noteActivity(5000000);
+  p.update(5000000);
+  p.setConnected(true, 5000120);
+  TEST_ASSERT_EQUAL_UINT32(120, p.reconnectStats(BLE_PROFILE_APPROACH).lastMs);
+  TEST_ASSERT_EQUAL_UINT32(2, p.reconnectStats(BLE_PROFILE_APPROACH).count);
+  TEST_ASSERT_EQUAL_UINT32(100, p.reconnectStats(BLE_PROFILE_APPROACH).avgMs());
+}
+
+static void test_duty_cycle_ordering(void) {
+  const BleProfileParams &parked = bleProfileParams(BLE_PROFILE_PARKED);
+  const BleProfileParams &approach = bleProfileParams(BLE_PROFILE_APPROACH);
+  const BleProfileParams &driving = bleProfileParams(BLE_PROFILE_DRIVING);
+  TEST_ASSERT_TRUE(bleProfileRadioDutyCycle(parked, false) < bleProfileRadioDutyCycle(driving, false));
+  TEST_ASSERT_TRUE(bleProfileRadioDutyCycle(driving, false) < bleProfileRadioDutyCycle(approach, false));
+  TEST_ASSERT_TRUE(bleProfileRadioDutyCycle(parked, true) < bleProfileRadioDutyCycle(driving, true));
+  TEST_ASSERT_TRUE(bleProfileExpectedDiscoveryMs(approach) < bleProfileExpectedDiscoveryMs(parked));
+  /* Supervision timeout must exceed (1 + latency) * interval * 2 (Core spec). */
+  for (int i = 0; i < BLE_PROFILE_COUNT; i++) {
+    const BleProfileParams &q = bleProfileParams((BlePowerProfile)i);
+    uint32_t minTimeoutMs = (1u + q.slaveLatency) * q.connIntervalMax * 125u / 100u * 2u;
+    TEST_ASSERT_GREATER_THAN(minTimeoutMs, q.supervisionTimeout * 10u);
+  }
+}
+
+/* Overnight scenario: drive 30 min, park 10 h, unlock, drive. Prints per-profile table. */
+static void test_overnight_duty_cycle_report(void) {
+  BlePowerPolicy p;
+  uint32_t t = 0;
+  p.setIgnition(2, t);
+  p.update(t);
+  p.setConnected(true, t + 150);
+  t += 30u * 60u * 1000u;
+  p.setIgnition(0, t);
+  p.update(t);
+  for (uint32_t k = 0; k < 10u * 3600u; k++) {
+    t += 1000;
+    if (k == 20)
+      p.setConnected(false, t);  /* driver walks away */
+    p.update(t);
+  }
+  TEST_ASSERT_EQUAL(BLE_PROFILE_PARKED, p.profile());
+  float parkedDuty = p.averageDutyCycle(t);
+  p.noteActivity(t);
+  p.update(t);
+  p.setConnected(true, t + bleProfileExpectedDiscoveryMs(p.params()));
+  p.setIgnition(2, t + 60000);
+  p.update(t + 60000);
+
+  printf("\n  profile  | adv ms | conn ms | lat | adv duty %% | conn duty %% | discovery ms | time s\n");
+  for (int i = 0; i < BLE_PROFILE_COUNT; i++) {
+    BlePowerProfile pr = (BlePowerProfile)i;
+    const BleProfileParams &q = bleProfileParams(pr);
+    printf("  %-8s | %6.0f | %7.1f | %3u | %10.3f | %11.3f | %12u | %6u\n", bleProfileName(pr),
+           q.advIntervalMin * 0.625f, q.connIntervalMin * 1.25f, q.slaveLatency,
+           bleProfileRadioDutyCycle(q, false) * 100.0f, bleProfileRadioDutyCycle(q, true) * 100.0f,
+           (unsigned)bleProfileExpectedDiscoveryMs(q),
+           (unsigned)(p.timeInProfileMs(pr, t + 60000) / 1000u));
+  }
+  printf("  average duty over scenario: %.3f%% (parked-only segment ends at %.3f%%)\n",
+         p.averageDutyCycle(t + 60000) * 100.0f, parkedDuty * 100.0f);
+  TEST_ASSERT_TRUE(p.averageDutyCycle(t + 60000) < bleProfileRadioDutyCycle(bleProfileParams(BLE_PROFILE_DRIVING), false));
+  TEST_ASSERT_EQUAL_UINT32(1, p.reconnectStats(BLE_PROFILE_APPROACH).count);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_boot_is_approach_then_parked_after_hold);
+  RUN_TEST(test_ignition_on_is_driving_off_is_approach);
+  RUN_TEST(test_activity_reenters_approach);
+  RUN_TEST(test_low_battery_forces_parked_unless_driving);
+  RUN_TEST(test_dwell_suppresses_ignition_bounce);
+  RUN_TEST(test_reconnect_time_recorded_per_profile);
+  RUN_TEST(test_duty_cycle_ordering);
+  RUN_TEST(test_overnight_duty_cycle_report);
+  return UNITY_END();
+}
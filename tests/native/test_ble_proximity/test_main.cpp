@@ -0,0 +1,235 @@
+/*
+ * Host tests: BLE RSSI proximity filter and state machine (BleProximity.cpp).
+ * Traces are generated from a log-distance model with seeded noise: 4 dB Gaussian shadowing plus
+ * 12-20 dB body-block dips, sampled every 200 ms like BleKeyService.
+ * Run: pio test -e native -f native/test_ble_proximity
+ */
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include "BleProximity.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static const uint32_t kSampleMs = 200;
+
+struct TraceRng {
+  uint32_t s;
+  explicit TraceRng(uint32_t seed) : s(seed ? seed : 1) {}
+  uint32_t next() {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+  }
+  float uniform() { return (float)(next() & 0xFFFFFF) / 16777216.0f; }
+  float gauss() {
+    float u1 = uniform() + 1e-7f, u2 = uniform();
+    return sqrtf(-2.0f * logf(u1)) * cosf(6.2831853f * u2);
+  }
+};
+
+/** One RSSI reading of a phone at distanceM with the given true rssiAt1m. */
+static int sampleRssi(TraceRng &rng, float distanceM, float trueAt1m) {
+  float mean = trueAt1m - 22.0f * log10f(distanceM < 0.3f ? 0.3f : distanceM);
+  float v = mean + 4.0f * rng.gauss();
+  if (rng.uniform() < 0.08f)
+    v -= 12.0f + 8.0f * rng.uniform();  /* pocket / body block */
+  int r = (int)lroundf(v);
+  return r > -20 ? -20 : (r < -110 ? -110 : r);
+}
+
+static BleProximityTracker makeTracker() {
+  BleProximityTracker t;
+  t.setCalibration(BleProximityCalibration());
+  return t;
+}
+
+static void test_kalman_reduces_noise(void) {
+  TraceRng rng(7);
+  BleRssiKalman kf;
+  double sumSqRaw = 0, sumSqFilt = 0;
+  int n = 0;
+  for (uint32_t i = 0; i < 600; i++) {
+    float z = -70.0f + 4.0f * rng.gauss();
+    float f = kf.update(z, i * kSampleMs);
+    if (i >= 20) {
+      sumSqRaw += (z + 70.0f) * (z + 70.0f);
+      sumSqFilt += (f + 70.0f) * (f + 70.0f);
+      n++;
+    }
+  }
+  float rawSd = (float)sqrt(sumSqRaw / n), filtSd = (float)sqrt(sumSqFilt / n);
+  printf("\n  stationary: raw sd %.2f dB -> filtered sd %.2f dB\n", rawSd, filtSd);
+  TEST_ASSERT_TRUE(filtSd < rawSd * 0.5f);
+}
+
+static void test_kalman_tracks_trend(void) {
+  BleRssiKalman kf;
+  for (uint32_t i = 0; i < 50; i++)
+    kf.update(-80.0f + 0.5f * (float)i, i * kSampleMs);  /* +2.5 dB/s */
+  TEST_ASSERT_FLOAT_WITHIN(0.6f, 2.5f, kf.rateDbPerS());
+  TEST_ASSERT_FLOAT_WITHIN(1.5f, -55.5f, kf.level());
+}
+
+static void test_dip_does_not_leave(void) {
+  BleProximityTracker t = makeTracker();
+  uint32_t now = 0;
+  for (int i = 0; i < 20; i++, now += kSampleMs)
+    t.addSample(-58, now);
+  TEST_ASSERT_EQUAL(PROX_NEAR, t.state());
+  /* 1 s hand-over-phone dip of 20 dB. */
+  for (int i = 0; i < 5; i++, now += kSampleMs)
+    TEST_ASSERT_EQUAL(PROX_EVT_NONE, t.addSample(-78, now));
+  for (int i = 0; i < 20; i++, now += kSampleMs)
+    t.addSample(-58, now);
+  TEST_ASSERT_EQUAL(PROX_NEAR, t.state());
+}
+
+/* Walk from 25 m to 0.5 m at 1.3 m/s and back out; many seeds. */
+static void test_walk_up_and_away_latency(void) {
+  const int kRuns = 200;
+  int nearOk = 0, leaveOk = 0, earlyNear = 0;
+  float nearLatSum = 0, nearLatMax = -1e9f, leaveLatSum = 0, leaveLatMax = -1e9f;
+  for (int run = 0; run < kRuns; run++) {
+    TraceRng rng(1000 + run);
+    BleProximityTracker t = makeTracker();
+    const float speed = 1.3f;
+    float d = 25.0f;
+    uint32_t now = 0;
+    int32_t crossNearMs = -1, nearEvtMs = -1, crossLeaveMs = -1, leaveEvtMs = -1;
+    bool approachSeen = false;
+    /* In. */
+    while (d > 0.5f) {
+      if (crossNearMs < 0 && d <= BleProximityTracker::kNearM)
+        crossNearMs = (int32_t)now;
+      BleProximityEvent e = t.addSample(sampleRssi(rng, d, -62.0f), now);
+      if (e == PROX_EVT_APPROACH)
+        approachSeen = true;
+      if (e == PROX_EVT_NEAR && nearEvtMs < 0) {
+        nearEvtMs = (int32_t)now;
+        if (d > 4.0f)
+          earlyNear++;
+      }
+      now += kSampleMs;
+      d -= speed * kSampleMs / 1000.0f;
+    }
+    /* At the door for 5 s, then walk away. */
+    for (int i = 0; i < 25; i++, now += kSampleMs)
+      if (t.addSample(sampleRssi(rng, 0.5f, -62.0f), now) == PROX_EVT_NEAR && nearEvtMs < 0)
+        nearEvtMs = (int32_t)now;
+    while (d < 25.0f) {
+      if (crossLeaveMs < 0 && d >= BleProximityTracker::kLeaveM)
+        crossLeaveMs = (int32_t)now;
+      BleProximityEvent e = t.addSample(sampleRssi(rng, d, -62.0f), now);
+      if (e == PROX_EVT_LEAVING && leaveEvtMs < 0)
+        leaveEvtMs = (int32_t)now;
+      now += kSampleMs;
+      d += speed * kSampleMs / 1000.0f;
+    }
+    TEST_ASSERT_TRUE(approachSeen);
+    if (nearEvtMs >= 0) {
+      nearOk++;
+      float lat = (float)(nearEvtMs - crossNearMs);
+      nearLatSum += lat;
+      if (lat > nearLatMax)
+        nearLatMax = lat;
+    }
+    if (leaveEvtMs >= 0) {
+      leaveOk++;
+      float lat = (float)(leaveEvtMs - crossLeaveMs);
+      leaveLatSum += lat;
+      if (lat > leaveLatMax)
+        leaveLatMax = lat;
+    }
+  }
+  printf("\n  walk-up: NEAR in %d/%d runs, latency after crossing %.1f m: avg %.0f ms, max %.0f ms, "
+         "early (>4 m) %d\n",
+         nearOk, kRuns, BleProximityTracker::kNearM, nearLatSum / nearOk, nearLatMax, earlyNear);
+  printf("  walk-away: LEAVING in %d/%d runs, latency after crossing %.1f m: avg %.0f ms, max %.0f ms\n",
+         leaveOk, kRuns, BleProximityTracker::kLeaveM, leaveLatSum / leaveOk, leaveLatMax);
+  /* Baseline: disconnect at ~30 m range edge + 2500 ms debounce, walking at 1.3 m/s. */
+  printf("  baseline (disconnect + 2.5 s debounce): ~%.0f ms after crossing %.1f m\n",
+         (30.0f - BleProximityTracker::kLeaveM) / 1.3f * 1000.0f + 2500.0f, BleProximityTracker::kLeaveM);
+  TEST_ASSERT_EQUAL(kRuns, nearOk);
+  TEST_ASSERT_EQUAL(kRuns, leaveOk);
+  TEST_ASSERT_TRUE(nearLatMax < 4000.0f);
+  TEST_ASSERT_TRUE(leaveLatSum / leaveOk < 6000.0f);
+  TEST_ASSERT_TRUE(earlyNear <= kRuns / 50);
+}
+
+/* Phone left on a table 3 m from the car for 10 min: count spurious NEAR/LEAVING events. */
+static void test_edge_of_range_false_triggers(void) {
+  const int kRuns = 20;
+  int filtered = 0, raw = 0;
+  for (int run = 0; run < kRuns; run++) {
+    TraceRng rng(5000 + run);
+    BleProximityTracker t = makeTracker();
+    const float nearDbm = t.nearThresholdDbm(), leaveDbm = t.leaveThresholdDbm();
+    bool rawNear = false;
+    for (uint32_t now = 0; now < 600000; now += kSampleMs) {
+      int r = sampleRssi(rng, 3.0f, -62.0f);
+      BleProximityEvent e = t.addSample(r, now);
+      if (e == PROX_EVT_NEAR || e == PROX_EVT_LEAVING)
+        filtered++;
+      /* Raw thresholds with the same hysteresis but no filter / dwell. */
+      if (!rawNear && r >= nearDbm) {
+        rawNear = true;
+        raw++;
+      } else if (rawNear && r < leaveDbm) {
+        rawNear = false;
+        raw++;
+      }
+    }
+  }
+  printf("\n  3 m for 10 min x %d: filtered NEAR/LEAVING events %d (%.2f per run), raw threshold %d\n",
+         kRuns, filtered, (float)filtered / kRuns, raw);
+  TEST_ASSERT_TRUE(filtered <= kRuns / 4);
+  TEST_ASSERT_TRUE(raw > filtered * 20);
+}
+
+/* Weak phone (true -76 dBm at 1 m) never reaches NEAR with default calibration; calibration fixes it. */
+static void test_per_phone_calibration(void) {
+  TraceRng rng(42);
+  BleProximityTracker t = makeTracker();
+  uint32_t now = 0;
+  for (int i = 0; i < 50; i++, now += kSampleMs)
+    t.addSample(sampleRssi(rng, 1.0f, -76.0f), now);
+  TEST_ASSERT_NOT_EQUAL(PROX_NEAR, t.state());
+  TEST_ASSERT_TRUE(t.calibrateAt(1.0f));
+  TEST_ASSERT_INT_WITHIN(4, -76, t.calibration().rssiAt1m);
+  int nearEvents = 0;
+  for (int i = 0; i < 50; i++, now += kSampleMs)
+    if (t.addSample(sampleRssi(rng, 1.0f, -76.0f), now) == PROX_EVT_NEAR)
+      nearEvents++;
+  TEST_ASSERT_EQUAL(1, nearEvents);
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 1.0f, t.estimatedDistanceM());
+}
+
+static void test_reset_and_invalid_samples(void) {
+  BleProximityTracker t = makeTracker();
+  TEST_ASSERT_EQUAL(PROX_EVT_NONE, t.addSample(0, 0));
+  TEST_ASSERT_EQUAL(PROX_EVT_NONE, t.addSample(127, 200));
+  TEST_ASSERT_FALSE(t.warm());
+  for (uint32_t now = 0; now < 4000; now += kSampleMs)
+    t.addSample(-55, now);
+  TEST_ASSERT_EQUAL(PROX_NEAR, t.state());
+  t.reset();
+  TEST_ASSERT_EQUAL(PROX_AWAY, t.state());
+  TEST_ASSERT_FALSE(t.warm());
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_kalman_reduces_noise);
+  RUN_TEST(test_kalman_tracks_trend);
+  RUN_TEST(test_dip_does_not_leave);
+  RUN_TEST(test_walk_up_and_away_latency);
+  RUN_TEST(test_edge_of_range_false_triggers);
+  RUN_TEST(test_per_phone_calibration);
+  RUN_TEST(test_reset_and_invalid_samples);
+  return UNITY_END();
+}
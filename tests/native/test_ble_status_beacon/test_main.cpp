@@ -0,0 +1,285 @@
+/*
+ * Host tests: BLE status beacon encoder / decoder (BleStatusBeacon.cpp).
+ * Time-to-status: beacon (first advertisement heard) vs connect + GATT read, per power profile.
+ * Run: pio test -e native -f native/test_ble_status_beacon
+ */
+#include <unity.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "BlePowerProfile.h"
+#include "BleStatusBeacon.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static const uint8_t kKey[BLE_BEACON_KEY_LEN] = {0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE,
+                                                 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+
+static BleBeaconStatus parkedLocked(void) {
+  BleBeaconStatus s;
+  s.ibusSynced = true;
+  s.lockState = 1;
+  s.ignition = 0;
+  s.doorByte1 = 0x00;
+  s.doorByte2 = 0x00;
+  s.coolantC = 21;
+  s.oilC = 20;
+  s.odometerKm = 48211;
+  return s;
+}
+
+static void test_round_trip_with_scan_response(void) {
+  BleStatusBeacon b;
+  b.setKey(kKey);
+  b.setNonce(0x1234);
+  BleBeaconStatus s = parkedLocked();
+  s.coolantC = -12;
+  TEST_ASSERT_TRUE(b.update(s, 0));
+  BleBeaconStatus d;
+  uint8_t seq = 0xAA;
+  TEST_ASSERT_TRUE(bleBeaconDecode(kKey, b.advData(), BLE_BEACON_ADV_LEN, b.scanData(), BLE_BEACON_SCAN_LEN,
+                                   &d, &seq));
+  TEST_ASSERT_EQUAL(0, seq);
+  TEST_ASSERT_TRUE(d.ibusSynced);
+  TEST_ASSERT_FALSE(d.obdConnected);
+  TEST_ASSERT_EQUAL(1, d.lockState);
+  TEST_ASSERT_EQUAL(0, d.ignition);
+  TEST_ASSERT_EQUAL(-12, d.coolantC);
+  TEST_ASSERT_EQUAL(20, d.oilC);
+  TEST_ASSERT_EQUAL(48211, d.odometerKm);
+  /* Company ID little-endian, nonce in clear, status not. */
+  TEST_ASSERT_EQUAL_HEX8(0xFF, b.advData()[0]);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, b.advData()[1]);
+  TEST_ASSERT_EQUAL(0x1235, b.advData()[2] | (b.advData()[3] << 8));
+}
+
+static void test_unknown_values_and_passive_scan(void) {
+  BleStatusBeacon b;
+  b.setKey(kKey);
+  TEST_ASSERT_TRUE(b.update(BleBeaconStatus(), 0));
+  BleBeaconStatus d;
+  /* Passive scan: advertising packet only, no ext, not authenticated. */
+  TEST_ASSERT_TRUE(bleBeaconDecode(kKey, b.advData(), BLE_BEACON_ADV_LEN, nullptr, 0, &d, nullptr));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, d.lockState);
+  TEST_ASSERT_EQUAL(-1, d.ignition);
+  TEST_ASSERT_EQUAL(-1, d.odometerKm);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, d.doorByte1);
+}
+
+static void test_wrong_key_and_tamper_rejected(void) {
+  BleStatusBeacon b;
+  b.setKey(kKey);
+  b.update(parkedLocked(), 0);
+  uint8_t other[BLE_BEACON_KEY_LEN];
+  memcpy(other, kKey, sizeof(other));
+  other[15] ^= 1;
+  TEST_ASSERT_FALSE(bleBeaconDecode(other, b.advData(), BLE_BEACON_ADV_LEN, b.scanData(), BLE_BEACON_SCAN_LEN,
+                                    nullptr, nullptr));
+  uint8_t adv[BLE_BEACON_ADV_LEN], scan[BLE_BEACON_SCAN_LEN];
+  for (size_t i = 4; i < BLE_BEACON_ADV_LEN; i++) {
+    memcpy(adv, b.advData(), sizeof(adv));
+    adv[i] ^= 0x08;  /* e.g. flip "locked" to something else */
+    TEST_ASSERT_FALSE(bleBeaconDecode(kKey, adv, sizeof(adv), b.scanData(), BLE_BEACON_SCAN_LEN, nullptr, nullptr));
+  }
+  memcpy(scan, b.scanData(), sizeof(scan));
+  scan[3] ^= 1;  /* scan response from another advertising event */
+  TEST_ASSERT_FALSE(bleBeaconDecode(kKey, b.advData(), BLE_BEACON_ADV_LEN, scan, sizeof(scan), nullptr, nullptr));
+  memcpy(adv, b.advData(), sizeof(adv));
+  adv[0] = 0x4C;  /* someone else's manufacturer data */
+  TEST_ASSERT_FALSE(bleBeaconDecode(kKey, adv, sizeof(adv), nullptr, 0, nullptr, nullptr));
+}
+
+static void test_updates_only_on_change_and_rotation(void) {
+  BleStatusBeacon b;
+  b.setKey(kKey);
+  BleBeaconStatus s = parkedLocked();
+  TEST_ASSERT_TRUE(b.update(s, 0));
+  uint8_t advBefore[BLE_BEACON_ADV_LEN];
+  memcpy(advBefore, b.advData(), sizeof(advBefore));
+  /* Nothing changed: no update for a whole rotation period. */
+  for (uint32_t t = 50; t < BleStatusBeacon::kRotateMs; t += 50)
+    TEST_ASSERT_FALSE(b.update(s, t));
+  /* Rotation: new nonce and ciphertext, same stateSeq. */
+  TEST_ASSERT_TRUE(b.update(s, BleStatusBeacon::kRotateMs));
+  TEST_ASSERT_EQUAL(0, b.stateSeq());
+  TEST_ASSERT_EQUAL(1, (int)b.rotations());
+  TEST_ASSERT_TRUE(memcmp(advBefore + 4, b.advData() + 4, 4) != 0);
+  /* Door opens: immediate update, stateSeq advances. */
+  s.doorByte1 = 0x01;
+  TEST_ASSERT_TRUE(b.update(s, BleStatusBeacon::kRotateMs + 10));
+  TEST_ASSERT_EQUAL(1, b.stateSeq());
+  /* Coolant alone: rate-limited. */
+  s.coolantC = 22;
+  TEST_ASSERT_FALSE(b.update(s, BleStatusBeacon::kRotateMs + 20));
+  TEST_ASSERT_TRUE(b.update(s, BleStatusBeacon::kRotateMs + 10 + BleStatusBeacon::kExtMinIntervalMs));
+  TEST_ASSERT_EQUAL(2, b.stateSeq());
+  BleBeaconStatus d;
+  uint8_t seq;
+  TEST_ASSERT_TRUE(bleBeaconDecode(kKey, b.advData(), BLE_BEACON_ADV_LEN, b.scanData(), BLE_BEACON_SCAN_LEN,
+                                   &d, &seq));
+  TEST_ASSERT_EQUAL(2, seq);
+  TEST_ASSERT_EQUAL(22, d.coolantC);
+  TEST_ASSERT_EQUAL_HEX8(0x01, d.doorByte1);
+  TEST_ASSERT_EQUAL(4, (int)b.updates());
+}
+
+static void test_same_state_looks_different_every_nonce(void) {
+  BleStatusBeacon b;
+  b.setKey(kKey);
+  BleBeaconStatus s = parkedLocked();
+  b.update(s, 0);
+  int identical = 0;
+  uint8_t prev[4];
+  memcpy(prev, b.advData() + 4, 4);
+  for (int i = 1; i <= 200; i++) {
+    b.update(s, (uint32_t)i * BleStatusBeacon::kRotateMs);
+    if (memcmp(prev, b.advData() + 4, 4) == 0)
+      identical++;
+    memcpy(prev, b.advData() + 4, 4);
+  }
+  TEST_ASSERT_EQUAL(0, identical);
+}
+
+/* Same key across restarts: the persisted mark must keep every nonce unique, with few NVS writes. */
+static void test_nonce_survives_restart(void) {
+  static bool used[65536];
+  memset(used, 0, sizeof(used));
+  uint16_t stored = 0; /* NVS value, 0 on first boot */
+  int writes = 0, reused = 0;
+  uint32_t t = 0;
+  const int runs[] = {1, 3, 255, 256, 257, 700, 2};
+  for (int run : runs) {
+    BleStatusBeacon b;
+    b.setKey(kKey);
+    b.setNonce(stored);
+    for (int i = 0; i < run; i++) {
+      t += BleStatusBeacon::kRotateMs;
+      TEST_ASSERT_TRUE(b.update(parkedLocked(), t));
+      uint16_t mark;
+      if (b.takeNonceReserve(&mark)) {
+        stored = mark;
+        writes++;
+      }
+      TEST_ASSERT_TRUE((uint16_t)(stored - b.nonce()) < BleStatusBeacon::kNonceReserve);
+      if (used[b.nonce()])
+        reused++;
+      used[b.nonce()] = true;
+    }
+  }
+  TEST_ASSERT_EQUAL(0, reused);
+  /* One write per boot plus one per kNonceReserve updates. */
+  TEST_ASSERT_EQUAL(7 + 1 + 2, writes);
+}
+
+static void test_fits_legacy_advertising(void) {
+  /* Flags (3) + 128-bit service UUID (2 + 16) + manufacturer data AD (2 + len). */
+  TEST_ASSERT_TRUE(3 + 18 + 2 + BLE_BEACON_ADV_LEN <= 31);
+  /* Name "BMW E39 Key" (2 + 11) + manufacturer data AD. */
+  TEST_ASSERT_TRUE(2 + 11 + 2 + BLE_BEACON_SCAN_LEN <= 31);
+}
+
+/* ── Time to status: beacon vs connect + read ──────────────────────────── */
+
+struct Rng {
+  uint32_t s;
+  double next() {
+    s = s * 1664525u + 1013904223u;
+    return (double)(s >> 8) / (double)(1u << 24);
+  }
+};
+
+/* Phone scanning continuously from a random moment; each advertising event (interval + 0..10 ms
+ * advDelay) is lost with probability loss. Returns ms until the first event heard. */
+static double timeToFirstAdv(const BleProfileParams &p, double loss, Rng &r) {
+  const double minMs = p.advIntervalMin * 0.625, maxMs = p.advIntervalMax * 0.625;
+  double t = -r.next() * maxMs;  /* scan starts somewhere inside an interval */
+  for (;;) {
+    t += minMs + r.next() * (maxMs - minMs) + r.next() * 10.0;
+    if (t >= 0 && r.next() >= loss)
+      return t;
+  }
+}
+
+/* Connect + read: CONNECT_IND, transmit window, then one connection event per exchange (LL feature /
+ * version / length procedures, ATT MTU, discovery unless cached, read); lost events are retried a CI later. */
+static double connectAndRead(double advMs, int exchanges, double ciMs, double loss, Rng &r) {
+  double t = advMs + 1.25 + r.next() * ciMs;  /* transmitWindowOffset + first anchor */
+  for (int i = 0; i < exchanges; i++) {
+    t += ciMs;
+    while (r.next() < loss)
+      t += ciMs;
+  }
+  return t;
+}
+
+static void test_time_to_status_beacon_vs_connect(void) {
+  const double kLoss = 0.1;
+  const double kPhoneCiMs = 45.0;  /* Android's initial connection interval (30..50 ms) before our update */
+  /* LL control: 3; ATT: MTU 1 + discovery (services 2, characteristics 4, descriptors 3) + read 1. */
+  const int kExchangesFresh = 3 + 1 + 9 + 1;
+  const int kExchangesCached = 3 + 1 + 1;
+  const int kTrials = 20000;
+  printf("\n  profile  | beacon avg/p95 ms | connect+read cached avg/p95 | uncached avg/p95\n");
+  for (int pi = 0; pi < BLE_PROFILE_COUNT; pi++) {
+    const BleProfileParams &p = bleProfileParams((BlePowerProfile)pi);
+    Rng r = {(uint32_t)(77 + pi)};
+    static double beacon[kTrials], cached[kTrials], fresh[kTrials];
+    double sb = 0, sc = 0, sf = 0;
+    for (int i = 0; i < kTrials; i++) {
+      double adv = timeToFirstAdv(p, kLoss, r);
+      beacon[i] = adv + 0.4;  /* scan response in the same advertising event */
+      cached[i] = connectAndRead(adv, kExchangesCached, kPhoneCiMs, kLoss, r);
+      fresh[i] = connectAndRead(adv, kExchangesFresh, kPhoneCiMs, kLoss, r);
+      sb += beacon[i];
+      sc += cached[i];
+      sf += fresh[i];
+    }
+    auto p95 = [](double *v, int n) {
+      std::sort(v, v + n);
+      return v[(int)(n * 0.95)];
+    };
+    const double ab = sb / kTrials, ac = sc / kTrials, af = sf / kTrials;
+    printf("  %-8s | %6.0f / %6.0f     | %6.0f / %6.0f             | %6.0f / %6.0f\n",
+           bleProfileName((BlePowerProfile)pi), ab, p95(beacon, kTrials), ac, p95(cached, kTrials), af,
+           p95(fresh, kTrials));
+    TEST_ASSERT_TRUE(ab < ac);
+    TEST_ASSERT_TRUE(ac - ab > 5 * kPhoneCiMs * 0.9);
+  }
+}
+
+static volatile uint8_t g_sink;
+
+static void test_encoder_cost(void) {
+  BleStatusBeacon b;
+  b.setKey(kKey);
+  BleBeaconStatus s = parkedLocked();
+  const int kN = 200000;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < kN; i++) {
+    s.doorByte1 = (uint8_t)i;  /* every call re-encodes */
+    b.update(s, (uint32_t)i);
+    g_sink ^= b.advData()[5];
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / kN;
+  printf("\n  encode (keystream + tag, 3 XTEA blocks): %.0f ns/update on host\n", ns);
+  TEST_ASSERT_EQUAL((uint32_t)kN, b.updates());
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip_with_scan_response);
+  RUN_TEST(test_unknown_values_and_passive_scan);
+  RUN_TEST(test_wrong_key_and_tamper_rejected);
+  RUN_TEST(test_updates_only_on_change_and_rotation);
+  RUN_TEST(test_same_state_looks_different_every_nonce);
+  RUN_TEST(test_nonce_survives_restart);
+  RUN_TEST(test_fits_legacy_advertising);
+  RUN_TEST(test_time_to_status_beacon_vs_connect);
+  RUN_TEST(test_encoder_cost);
+  return UNITY_END();
+}
@@ -0,0 +1,276 @@
+/*
+ * Host tests: BLE telemetry packer / stream (BleTelemetry.cpp).
+ * Run: pio test -e native -f native/test_ble_telemetry
+ */
+#include <unity.h>
+#include <cstdio>
+#include "BleTelemetry.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static BleTelemetrySample makeSample(uint32_t t, int32_t rpm, int32_t speed, int32_t cool,
+                                     int32_t oil, int32_t odo) {
+  BleTelemetrySample s;
+  s.tMs = t;
+  s.v[0] = rpm;
+  s.v[1] = speed;
+  s.v[2] = cool;
+  s.v[3] = oil;
+  s.v[4] = odo;
+  return s;
+}
+
+static void test_roundtrip_all_signals(void) {
+  uint8_t buf[244];
+  BleTelemetryPacker p;
+  p.begin(buf, sizeof(buf), 0x1234, BLE_TLM_SIG_ALL);
+  BleTelemetrySample in[6];
+  for (int i = 0; i < 6; i++) {
+    in[i] = makeSample(100000u + i * 20u, 800 + i * 350, 40 + i, 88, 91 - i, 123456 + i / 3);
+    TEST_ASSERT_TRUE(p.add(in[i]));
+  }
+  size_t len = p.finish();
+  TEST_ASSERT_GREATER_THAN(BLE_TELEMETRY_HEADER_LEN, len);
+
+  BleTelemetryFrameHeader h;
+  BleTelemetrySample out[8];
+  size_t n = 0;
+  TEST_ASSERT_TRUE(bleTelemetryDecode(buf, len, &h, out, 8, &n));
+  TEST_ASSERT_EQUAL_UINT16(0x1234, h.seq);
+  TEST_ASSERT_EQUAL_UINT8(BLE_TLM_SIG_ALL, h.mask);
+  TEST_ASSERT_EQUAL(6, (int)n);
+  for (int i = 0; i < 6; i++) {
+    TEST_ASSERT_EQUAL_UINT32(in[i].tMs, out[i].tMs);
+    for (int k = 0; k < BLE_TELEMETRY_SIGNAL_COUNT; k++)
+      TEST_ASSERT_EQUAL_INT32(in[i].v[k], out[i].v[k]);
+  }
+}
+
+static void test_no_data_and_extremes_roundtrip(void) {
+  uint8_t buf[64];
+  BleTelemetryPacker p;
+  p.begin(buf, sizeof(buf), 7, BLE_TLM_SIG_RPM | BLE_TLM_SIG_ODOMETER);
+  BleTelemetrySample a = makeSample(5, kTelemetryNoData, 0, 0, 0, INT32_MAX);
+  BleTelemetrySample b = makeSample(25, 6500, 0, 0, 0, kTelemetryNoData);
+  BleTelemetrySample c = makeSample(45, 6600, 0, 0, 0, 42);
+  TEST_ASSERT_TRUE(p.add(a));
+  TEST_ASSERT_TRUE(p.add(b));
+  TEST_ASSERT_TRUE(p.add(c));
+  size_t len = p.finish();
+  BleTelemetrySample out[3];
+  size_t n = 0;
+  TEST_ASSERT_TRUE(bleTelemetryDecode(buf, len, nullptr, out, 3, &n));
+  TEST_ASSERT_EQUAL(3, (int)n);
+  TEST_ASSERT_EQUAL_INT32(kTelemetryNoData, out[0].v[0]);
+  TEST_ASSERT_EQUAL_INT32(INT32_MAX, out[0].v[4]);
+  TEST_ASSERT_EQUAL_INT32(6500, out[1].v[0]);
+  TEST_ASSERT_EQUAL_INT32(kTelemetryNoData, out[1].v[4]);
+  /* Present again after a gap: sent absolute, not as a delta from the missing value. */
+  TEST_ASSERT_EQUAL_INT32(6600, out[2].v[0]);
+  TEST_ASSERT_EQUAL_INT32(42, out[2].v[4]);
+  /* Masked-out signals stay "no data" after decode. */
+  TEST_ASSERT_EQUAL_INT32(kTelemetryNoData, out[1].v[1]);
+  /* A no-data value costs one byte: two samples of one missing signal and one odometer delta. */
+  p.begin(buf, sizeof(buf), 8, BLE_TLM_SIG_ALL);
+  TEST_ASSERT_TRUE(p.add(makeSample(0, kTelemetryNoData, kTelemetryNoData, kTelemetryNoData,
+                                    kTelemetryNoData, kTelemetryNoData)));
+  TEST_ASSERT_EQUAL(BLE_TELEMETRY_HEADER_LEN + 5, (int)p.length());
+  /* Extreme delta (INT32_MIN) still round-trips past the sentinel. */
+  p.begin(buf, sizeof(buf), 9, BLE_TLM_SIG_RPM);
+  TEST_ASSERT_TRUE(p.add(makeSample(0, INT32_MAX, 0, 0, 0, 0)));
+  TEST_ASSERT_TRUE(p.add(makeSample(20, -1, 0, 0, 0, 0)));
+  len = p.finish();
+  TEST_ASSERT_TRUE(bleTelemetryDecode(buf, len, nullptr, out, 3, &n));
+  TEST_ASSERT_EQUAL_INT32(-1, out[1].v[0]);
+}
+
+/* In frame v1 each missing value was a 5-byte INT32_MIN varint: at MTU 23 two of them did not fit an
+ * empty frame and the stream returned "ready" with nothing in it. */
+static void test_stream_mtu23_with_missing_signals(void) {
+  static BleTelemetryStream s;
+  s = BleTelemetryStream();
+  s.setMtu(BLE_TLM_MTU_DEFAULT);
+  s.configure(50, BLE_TLM_SIG_ALL, 1000);
+  size_t decoded = 0;
+  for (uint32_t t = 0; t < 1000; t += 20) {
+    /* No oil sensor, no odometer yet, coolant only every other sample. */
+    BleTelemetrySample cur = makeSample(0, 800 + (int32_t)t, (int32_t)(t / 100),
+                                        (t / 20) % 2 ? kTelemetryNoData : 85, kTelemetryNoData,
+                                        kTelemetryNoData);
+    if (s.offer(cur, t)) {
+      TEST_ASSERT_GREATER_THAN(BLE_TELEMETRY_HEADER_LEN, s.frameLen());
+      TEST_ASSERT_LESS_OR_EQUAL(s.payloadCapacity(), s.frameLen());
+      BleTelemetrySample out[8];
+      size_t n = 0;
+      TEST_ASSERT_TRUE(bleTelemetryDecode(s.frame(), s.frameLen(), nullptr, out, 8, &n));
+      for (size_t i = 0; i < n; i++) {
+        TEST_ASSERT_EQUAL_INT32(800 + (int32_t)out[i].tMs, out[i].v[0]);
+        TEST_ASSERT_EQUAL_INT32((out[i].tMs / 20) % 2 ? kTelemetryNoData : 85, out[i].v[2]);
+        TEST_ASSERT_EQUAL_INT32(kTelemetryNoData, out[i].v[3]);
+        TEST_ASSERT_EQUAL_INT32(kTelemetryNoData, out[i].v[4]);
+      }
+      decoded += n;
+      s.consume();
+    }
+  }
+  TEST_ASSERT_TRUE(s.flush());
+  decoded += s.frame()[4];
+  TEST_ASSERT_EQUAL(50, (int)decoded);
+  TEST_ASSERT_EQUAL_UINT32(50, s.samplesSent());
+  TEST_ASSERT_EQUAL_UINT32(0, s.samplesDropped());
+}
+
+/* A sample that cannot fit even an empty frame is counted, never reported as a ready frame. */
+static void test_stream_oversized_sample_dropped(void) {
+  static BleTelemetryStream s;
+  s = BleTelemetryStream();
+  s.setMtu(BLE_TLM_MTU_DEFAULT);
+  s.configure(50, BLE_TLM_SIG_ALL, 1000);
+  BleTelemetrySample huge = makeSample(0, INT32_MIN + 1, INT32_MAX, INT32_MIN + 1, INT32_MAX, INT32_MAX);
+  TEST_ASSERT_FALSE(s.offer(huge, 0));
+  TEST_ASSERT_EQUAL(0, (int)s.frameLen());
+  TEST_ASSERT_EQUAL_UINT32(1, s.samplesDropped());
+  TEST_ASSERT_FALSE(s.offer(makeSample(0, 900, 0, 80, 80, 1000), 20));
+  TEST_ASSERT_TRUE(s.flush());
+  TEST_ASSERT_EQUAL_UINT32(1, s.samplesSent());
+}
+
+static void test_packer_respects_capacity(void) {
+  const size_t cap = BLE_TLM_MTU_DEFAULT - BLE_TLM_NOTIFY_OVERHEAD;
+  uint8_t buf[cap];
+  BleTelemetryPacker p;
+  p.begin(buf, cap, 0, BLE_TLM_SIG_ALL);
+  int added = 0;
+  for (int i = 0; i < 50; i++) {
+    if (!p.add(makeSample(i * 20u, 3000 + i * 40, 100 + i, 90, 95, 200000)))
+      break;
+    added++;
+  }
+  TEST_ASSERT_GREATER_THAN(0, added);
+  TEST_ASSERT_LESS_OR_EQUAL(cap, p.finish());
+  TEST_ASSERT_TRUE(bleTelemetryDecode(buf, p.finish(), nullptr, nullptr, 0, nullptr));
+}
+
+static void test_decode_rejects_truncated(void) {
+  uint8_t buf[64];
+  BleTelemetryPacker p;
+  p.begin(buf, sizeof(buf), 0, BLE_TLM_SIG_RPM);
+  p.add(makeSample(0, 1000, 0, 0, 0, 0));
+  p.add(makeSample(20, 90000, 0, 0, 0, 0));
+  size_t len = p.finish();
+  TEST_ASSERT_FALSE(bleTelemetryDecode(buf, len - 1, nullptr, nullptr, 0, nullptr));
+  buf[0] = 0x7E;
+  TEST_ASSERT_FALSE(bleTelemetryDecode(buf, len, nullptr, nullptr, 0, nullptr));
+}
+
+static void test_stream_rate_and_sequence(void) {
+  static BleTelemetryStream s;
+  s = BleTelemetryStream();
+  s.setMtu(247);
+  const uint8_t ctrl[] = {20, BLE_TLM_SIG_RPM | BLE_TLM_SIG_SPEED, 10};  /* 20 Hz, 100 ms batch */
+  TEST_ASSERT_TRUE(s.configureFromWrite(ctrl, sizeof(ctrl)));
+  int frames = 0;
+  uint16_t expectSeq = 0;
+  size_t totalSamples = 0;
+  /* Loop ticks every 3 ms for 2 s. */
+  for (uint32_t t = 0; t < 2000; t += 3) {
+    BleTelemetrySample cur = makeSample(0, 1000 + (int32_t)t, (int32_t)(t / 50), 0, 0, 0);
+    if (s.offer(cur, t)) {
+      BleTelemetryFrameHeader h;
+      BleTelemetrySample out[32];
+      size_t n = 0;
+      TEST_ASSERT_TRUE(bleTelemetryDecode(s.frame(), s.frameLen(), &h, out, 32, &n));
+      TEST_ASSERT_EQUAL_UINT16(expectSeq, h.seq);
+      expectSeq++;
+      /* Latency bound: oldest sample in a frame is at most batchMs (+1 tick) old. */
+      TEST_ASSERT_LESS_OR_EQUAL(103u, t - h.firstMs);
+      for (size_t i = 1; i < n; i++)
+        TEST_ASSERT_UINT32_WITHIN(3, 50, out[i].tMs - out[i - 1].tMs);
+      totalSamples += n;
+      frames++;
+      s.consume();
+    }
+  }
+  if (s.flush())
+    totalSamples += s.frame()[4];
+  /* 20 Hz for 2 s = 40 samples; a 100 ms batch carries 2..3 of them. */
+  TEST_ASSERT_INT_WITHIN(1, 40, (int)totalSamples);
+  TEST_ASSERT_GREATER_OR_EQUAL(13, frames);
+  TEST_ASSERT_LESS_OR_EQUAL(20, frames);
+}
+
+static void test_stream_stall_does_not_burst(void) {
+  static BleTelemetryStream s;
+  s = BleTelemetryStream();
+  s.configure(50, BLE_TLM_SIG_RPM, 1000);
+  BleTelemetrySample cur;
+  cur.v[0] = 900;
+  s.offer(cur, 0);
+  /* Loop stalls for 400 ms: only one sample must be taken at resume, not 20. */
+  s.offer(cur, 400);
+  s.offer(cur, 401);
+  s.offer(cur, 402);
+  TEST_ASSERT_TRUE(s.flush());
+  TEST_ASSERT_EQUAL_UINT32(2, s.samplesSent());
+}
+
+static void test_stream_mtu_shrink_closes_batch(void) {
+  static BleTelemetryStream s;
+  s = BleTelemetryStream();
+  s.setMtu(517);
+  s.configure(50, BLE_TLM_SIG_ALL, 2000);
+  BleTelemetrySample cur = makeSample(0, 1000, 10, 80, 80, 5000);
+  for (uint32_t t = 0; t < 400; t += 20)
+    s.offer(cur, t);
+  s.setMtu(23);
+  TEST_ASSERT_GREATER_THAN(0, (int)s.frameLen());
+  TEST_ASSERT_LESS_OR_EQUAL(514, (int)s.frameLen());
+}
+
+/* Throughput table: samples per notification and payload bytes/s at 50 Hz, per MTU. */
+static void test_throughput_table_per_mtu(void) {
+  const uint16_t mtus[] = {23, 185, 247, 517};
+  const uint8_t masks[] = {BLE_TLM_SIG_RPM, BLE_TLM_SIG_RPM | BLE_TLM_SIG_SPEED, BLE_TLM_SIG_ALL};
+  printf("\n  MTU | mask | samples/notif | bytes/notif | notif/s @50Hz | B/s @50Hz\n");
+  for (uint16_t mtu : mtus) {
+    for (uint8_t mask : masks) {
+      static BleTelemetryStream s;
+      s = BleTelemetryStream();
+      s.setMtu(mtu);
+      s.configure(50, mask, 60000);  /* batch bounded by MTU only */
+      for (uint32_t t = 0; t < 60000; t += 20) {
+        /* Realistic ramp: RPM +35/sample with noise, speed +0..1, temps steady. */
+        BleTelemetrySample cur = makeSample(0, 1500 + (int32_t)((t / 20) * 35 % 5000) + (int32_t)(t % 7),
+                                            (int32_t)(t / 900), 89, 94, 123456 + (int32_t)(t / 30000));
+        if (s.offer(cur, t))
+          s.consume();
+      }
+      s.flush();
+      double spn = (double)s.samplesSent() / s.framesSent();
+      double bpn = (double)s.bytesSent() / s.framesSent();
+      printf("  %3u | 0x%02X | %13.1f | %11.1f | %13.1f | %9.0f\n", mtu, mask, spn, bpn,
+             50.0 / spn, 50.0 / spn * bpn);
+      TEST_ASSERT_GREATER_OR_EQUAL(1.0, spn);
+      if (mtu >= 185)
+        TEST_ASSERT_GREATER_THAN(10.0, spn);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_roundtrip_all_signals);
+  RUN_TEST(test_no_data_and_extremes_roundtrip);
+  RUN_TEST(test_stream_mtu23_with_missing_signals);
+  RUN_TEST(test_stream_oversized_sample_dropped);
+  RUN_TEST(test_packer_respects_capacity);
+  RUN_TEST(test_decode_rejects_truncated);
+  RUN_TEST(test_stream_rate_and_sequence);
+  RUN_TEST(test_stream_stall_does_not_burst);
+  RUN_TEST(test_stream_mtu_shrink_closes_batch);
+  RUN_TEST(test_throughput_table_per_mtu);
+  return UNITY_END();
+}
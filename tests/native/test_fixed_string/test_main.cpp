@@ -0,0 +1,171 @@
+/*
+ * Host tests: FixedString (include/nocturne/FixedString.h) — capacity, UTF-8-safe truncation, equality,
+ * copies across capacities — and the steady-state heap allocation count of AppState text while JSON and
+ * binary monitor payloads with changing names, artist and track are applied and the RAM scene's name is
+ * prepared as SceneManager does it. Every malloc/calloc/realloc in the process is counted.
+ * Run: pio test -e native -f native/test_fixed_string
+ */
+#include <unity.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "MonitorBinary.h"
+#include "MonitorDecoder.h"
+#include "nocturne/Types.h"
+
+/* ── Allocation counter (as in test_monitor_decoder) ── */
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void __libc_free(void *);
+static size_t s_allocs = 0;
+extern "C" void *malloc(size_t n) {
+  s_allocs++;
+  return __libc_malloc(n);
+}
+extern "C" void *calloc(size_t n, size_t m) {
+  s_allocs++;
+  return __libc_calloc(n, m);
+}
+extern "C" void *realloc(void *p, size_t n) {
+  s_allocs++;
+  return __libc_realloc(p, n);
+}
+extern "C" void free(void *p) { __libc_free(p); }
+void *operator new(size_t n) {
+  void *p = malloc(n);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_assign_and_compare(void) {
+  FixedString<8> s;
+  TEST_ASSERT_TRUE(s.empty());
+  TEST_ASSERT_EQUAL_UINT(8, s.capacity());
+  TEST_ASSERT_TRUE(s.assign("chrome"));
+  TEST_ASSERT_FALSE(s.assign("chrome")); /* unchanged */
+  TEST_ASSERT_TRUE(s == "chrome");
+  TEST_ASSERT_TRUE(s != "chrom");
+  TEST_ASSERT_TRUE(s != "chromeX");
+  TEST_ASSERT_FALSE(s.truncated());
+  s = "python.exe";
+  TEST_ASSERT_EQUAL_STRING("python.e", s.c_str());
+  TEST_ASSERT_EQUAL_UINT(8, s.length());
+  TEST_ASSERT_TRUE(s.truncated());
+  s = nullptr;
+  TEST_ASSERT_TRUE(s.empty());
+  TEST_ASSERT_TRUE(s == "");
+  TEST_ASSERT_FALSE(s == nullptr);
+
+  /* Across capacities: cut on assignment, equal by content. */
+  FixedString<63> wide("Code.exe");
+  FixedString<4> narrow;
+  narrow = wide;
+  TEST_ASSERT_EQUAL_STRING("Code", narrow.c_str());
+  FixedString<16> mid(wide.c_str());
+  TEST_ASSERT_TRUE(mid == wide);
+  narrow.toUpperCase();
+  TEST_ASSERT_EQUAL_STRING("CODE", narrow.c_str());
+
+  /* Self-assignment through the base keeps the text. */
+  FixedStringBase &base = mid;
+  base.assign(base.c_str() + 5, 3);
+  TEST_ASSERT_EQUAL_STRING("exe", mid.c_str());
+}
+
+void test_utf8_truncation(void) {
+  /* "Облачно" = 7 two-byte letters; 5 bytes keep two letters, never half of the third. */
+  FixedString<5> ru;
+  ru = "\xD0\x9E\xD0\xB1\xD0\xBB\xD0\xB0";
+  TEST_ASSERT_EQUAL_UINT(4, ru.length());
+  TEST_ASSERT_EQUAL_STRING("\xD0\x9E\xD0\xB1", ru.c_str());
+  TEST_ASSERT_TRUE(ru.truncated());
+  /* 3-byte (€) and 4-byte (😀) sequences. */
+  FixedString<5> euro;
+  euro = "a\xE2\x82\xAC\xE2\x82\xAC";
+  TEST_ASSERT_EQUAL_STRING("a\xE2\x82\xAC", euro.c_str());
+  FixedString<4> emoji;
+  emoji = "\xF0\x9F\x98\x80!";
+  TEST_ASSERT_EQUAL_STRING("\xF0\x9F\x98\x80", emoji.c_str());
+  FixedString<3> none;
+  none = "\xF0\x9F\x98\x80";
+  TEST_ASSERT_TRUE(none.empty());
+  /* toUpperCase leaves multibyte text alone. */
+  FixedString<16> mixed("\xD0\xB0" "bc");
+  mixed.toUpperCase();
+  TEST_ASSERT_EQUAL_STRING("\xD0\xB0" "BC", mixed.c_str());
+  TEST_ASSERT_EQUAL_UINT(2, FixedStringBase::utf8Fit("ab\xD0\xB0", 4, 3));
+}
+
+void test_appstate_copies_are_independent(void) {
+  AppState a;
+  TEST_ASSERT_TRUE(a.media.mediaStatus == "PAUSED");
+  a.media.artist = "Perturbator";
+  a.process.ramNames[1] = "firefox.exe";
+  AppState b = a;
+  b.media.artist = "Dance With The Dead";
+  TEST_ASSERT_EQUAL_STRING("Perturbator", a.media.artist.c_str());
+  TEST_ASSERT_EQUAL_STRING("firefox.exe", b.process.ramNames[1].c_str());
+  a = b;
+  TEST_ASSERT_EQUAL_STRING("Dance With The Dead", a.media.artist.c_str());
+  TEST_ASSERT_TRUE(a.media.artist.c_str() != b.media.artist.c_str()); /* own storage */
+}
+
+void test_steady_state_allocations(void) {
+  static const char *kArtists[] = {"Carpenter Brut", "Perturbator", "Gunship", "\\u041a\\u0438\\u043d\\u043e"};
+  static const char *kProcs[] = {"chrome.exe", "Code.exe", "python.exe", "explorer.exe", "a-very-long-process-name.exe"};
+  MonitorDecoder json;
+  MonitorBinaryEncoder enc;
+  MonitorBinaryDecoder bin;
+  AppState st, src;
+  static char line[1024];
+  static uint8_t frame[MonitorBinary::kFrameMax];
+  const int kPayloads = 20000;
+  size_t before = 0;
+  for (int i = 0; i < kPayloads; i++) {
+    if (i == 100)
+      before = s_allocs; /* warm-up done (stdio buffers etc.) */
+    snprintf(line, sizeof(line),
+             "{\"ct\":%d,\"art\":\"%s\",\"trk\":\"Track %d\",\"wd\":\"rain %d\","
+             "\"tp\":[{\"n\":\"%s\",\"c\":%d},{\"n\":\"%s\",\"c\":3}],\"tr\":[{\"n\":\"%s\",\"r\":%d}],"
+             "\"media_status\":\"%s\"}",
+             i % 90, kArtists[i % 4], i, i % 7, kProcs[i % 5], i % 100, kProcs[(i + 1) % 5], kProcs[(i + 2) % 5],
+             i, (i & 1) ? "PLAYING" : "PAUSED");
+    TEST_ASSERT_TRUE(json.decode(line, strlen(line), &st));
+
+    src.media.track = st.media.track;
+    src.process.cpuNames[0] = st.process.cpuNames[0];
+    const size_t n = enc.encode(src, frame, sizeof(frame));
+    TEST_ASSERT_TRUE(bin.decode(frame + MonitorBinary::kHeader, n - MonitorBinary::kHeader, &st));
+
+    /* drawRam: name cut to the column and upper-cased. */
+    FixedString<6> name;
+    name.assign(st.process.ramNames[0]);
+    name.toUpperCase();
+    TEST_ASSERT_TRUE(name.length() <= 6);
+  }
+  const size_t allocs = s_allocs - before;
+  printf("  steady state: %d payloads (JSON + binary, changing text) -> %u heap allocations\n",
+         kPayloads - 100, (unsigned)allocs);
+  TEST_ASSERT_EQUAL_UINT(0, allocs);
+  TEST_ASSERT_EQUAL_STRING("a-very-long-process-nam", st.process.cpuNames[0].c_str());
+  TEST_ASSERT_EQUAL_UINT(NOCT_PROC_NAME_MAX, st.process.cpuNames[0].length());
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_assign_and_compare);
+  RUN_TEST(test_utf8_truncation);
+  RUN_TEST(test_appstate_copies_are_independent);
+  RUN_TEST(test_steady_state_allocations);
+  return UNITY_END();
+}
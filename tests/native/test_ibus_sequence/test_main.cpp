@@ -0,0 +1,364 @@
+/*
+ * Host tests: timed I-Bus sequences (IbusSequence.cpp) — script validation, built-ins, control flow, and
+ * timing under a loaded main loop vs on a timer-driven task.
+ * Run: pio test -e native -f native/test_ibus_sequence
+ */
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include "IbusSequence.h"
+#include "ibus/IbusCodes.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* ── Recording sink ─────────────────────────────────────────────────────── */
+struct Sink {
+  static const int kMax = 1024;
+  uint32_t nowMs = 0;
+  uint32_t at[kMax];
+  uint8_t first[kMax];
+  uint8_t len[kMax];
+  int count = 0;
+  uint8_t vars[IBUS_SEQ_VAR_COUNT];
+  bool accept = true;
+
+  Sink() { memset(vars, 0xFF, sizeof(vars)); }
+  void clear() { count = 0; }
+};
+
+static bool sinkSend(const uint8_t *frame, uint8_t len, void *ctx) {
+  Sink *s = (Sink *)ctx;
+  if (!s->accept)
+    return false;
+  if (s->count < Sink::kMax) {
+    s->at[s->count] = s->nowMs;
+    s->first[s->count] = len > 8 ? frame[8] : frame[len - 1];
+    s->len[s->count] = len;
+    s->count++;
+  }
+  return true;
+}
+
+static uint8_t sinkQuery(uint8_t var, void *ctx) {
+  return ((Sink *)ctx)->vars[var];
+}
+
+static void run(IbusSeqEngine &e, Sink &s, uint32_t fromMs, uint32_t toMs) {
+  for (uint32_t t = fromMs; t <= toMs; t++) {
+    s.nowMs = t;
+    e.step(t, sinkSend, sinkQuery, &s);
+  }
+}
+
+static uint32_t rng = 0xC0FFEE;
+static uint32_t nextRand() {
+  rng = rng * 1103515245u + 12345u;
+  return (rng >> 16) & 0x7FFF;
+}
+
+/* ── Tests ──────────────────────────────────────────────────────────────── */
+
+void test_builtins_validate_and_codes_match(void) {
+  const uint8_t ids[] = {IBUS_SEQ_LIGHT_SHOW, IBUS_SEQ_WIG_WAG, IBUS_SEQ_PANIC, IBUS_SEQ_GOODBYE,
+                         IBUS_SEQ_COMFORT_CLOSE};
+  for (uint8_t id : ids) {
+    size_t n = 0;
+    const uint8_t *p = ibusSeqBuiltin(id, &n);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_OK, ibusSeqValidate(p, n));
+  }
+  TEST_ASSERT_NULL(ibusSeqBuiltin(0, nullptr));
+  TEST_ASSERT_NULL(ibusSeqBuiltin(IBUS_SEQ_FILE_FIRST, nullptr));
+  uint8_t len = 0;
+  TEST_ASSERT_TRUE(ibusSeqCodeFrame(IBUS_SEQ_CODE_HAZARD, &len) == HazardLights);
+  TEST_ASSERT_EQUAL_UINT8(sizeof(HazardLights), len);
+  TEST_ASSERT_TRUE(ibusSeqCodeFrame(IBUS_SEQ_CODE_LIGHTS_OFF, &len) == TurnOffLights);
+  TEST_ASSERT_EQUAL_UINT8(sizeof(TurnOffLights), len);
+  TEST_ASSERT_NULL(ibusSeqCodeFrame(IBUS_SEQ_CODE_COUNT, &len));
+}
+
+void test_validator_rejects_bad_scripts(void) {
+  const uint8_t badOp[] = {0x42};
+  const uint8_t truncated[] = {IBUS_SEQ_OP_WAIT, 10};
+  const uint8_t sendTooLong[] = {IBUS_SEQ_OP_SEND, 3, 1, 2};
+  const uint8_t badCode[] = {IBUS_SEQ_OP_SEND_CODE, IBUS_SEQ_CODE_COUNT};
+  const uint8_t wait0[] = {IBUS_SEQ_OP_WAIT, 0, 0};
+  const uint8_t midJump[] = {IBUS_SEQ_OP_WAIT, 10, 0, IBUS_SEQ_OP_JUMP, 1};
+  const uint8_t pastEnd[] = {IBUS_SEQ_OP_JUMP, 9};
+  const uint8_t spin[] = {IBUS_SEQ_OP_SEND_CODE, 0, IBUS_SEQ_OP_JUMP, 0};
+  const uint8_t foreverNoWait[] = {IBUS_SEQ_OP_REPEAT, 0, IBUS_SEQ_OP_SEND_CODE, 0, IBUS_SEQ_OP_LOOP};
+  const uint8_t unbalanced[] = {IBUS_SEQ_OP_REPEAT, 2, IBUS_SEQ_OP_SEND_CODE, 0};
+  const uint8_t loopOnly[] = {IBUS_SEQ_OP_LOOP};
+  const uint8_t tooDeep[] = {IBUS_SEQ_OP_REPEAT, 2, IBUS_SEQ_OP_REPEAT, 2, IBUS_SEQ_OP_REPEAT, 2,
+                             IBUS_SEQ_OP_REPEAT, 2, IBUS_SEQ_OP_REPEAT, 2, IBUS_SEQ_OP_LOOP,
+                             IBUS_SEQ_OP_LOOP, IBUS_SEQ_OP_LOOP, IBUS_SEQ_OP_LOOP, IBUS_SEQ_OP_LOOP};
+  const uint8_t badVar[] = {IBUS_SEQ_OP_JUMP_IF, IBUS_SEQ_VAR_COUNT, 0, 0, 0};
+  const uint8_t finiteNoWait[] = {IBUS_SEQ_OP_REPEAT, 3, IBUS_SEQ_OP_SEND_CODE, 0, IBUS_SEQ_OP_LOOP};
+
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_LENGTH, ibusSeqValidate(badOp, 0));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_OPCODE, ibusSeqValidate(badOp, sizeof(badOp)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_LENGTH, ibusSeqValidate(truncated, sizeof(truncated)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_LENGTH, ibusSeqValidate(sendTooLong, sizeof(sendTooLong)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_OPERAND, ibusSeqValidate(badCode, sizeof(badCode)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_OPERAND, ibusSeqValidate(wait0, sizeof(wait0)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_TARGET, ibusSeqValidate(midJump, sizeof(midJump)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_TARGET, ibusSeqValidate(pastEnd, sizeof(pastEnd)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_NO_WAIT, ibusSeqValidate(spin, sizeof(spin)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_NO_WAIT, ibusSeqValidate(foreverNoWait, sizeof(foreverNoWait)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_NESTING, ibusSeqValidate(unbalanced, sizeof(unbalanced)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_NESTING, ibusSeqValidate(loopOnly, sizeof(loopOnly)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_NESTING, ibusSeqValidate(tooDeep, sizeof(tooDeep)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_OPERAND, ibusSeqValidate(badVar, sizeof(badVar)));
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_OK, ibusSeqValidate(finiteNoWait, sizeof(finiteNoWait)));
+
+  IbusSeqEngine e;
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_ERR_NO_WAIT, e.start(9, spin, sizeof(spin), 0));
+  TEST_ASSERT_FALSE(e.running());
+}
+
+void test_light_show_order_marks_and_stop(void) {
+  IbusSeqEngine e;
+  Sink s;
+  size_t n = 0;
+  const uint8_t *p = ibusSeqBuiltin(IBUS_SEQ_LIGHT_SHOW, &n);
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_OK, e.start(IBUS_SEQ_LIGHT_SHOW, p, n, 1000));
+  run(e, s, 1000, 1000 + 800 * 6);
+  /* Hazard, Park, Goodbye, LowBeam, Off, Hazard, Park at 0, 800, ... 4800 */
+  TEST_ASSERT_EQUAL_INT(7, s.count);
+  const uint8_t *order[] = {HazardLights, ParkLights_And_Signals, GoodbyeLights, Low_Beams, TurnOffLights,
+                            HazardLights, ParkLights_And_Signals};
+  for (int i = 0; i < 7; i++) {
+    TEST_ASSERT_EQUAL_UINT32(1000 + 800 * (uint32_t)i, s.at[i]);
+    TEST_ASSERT_EQUAL_UINT8(order[i][8], s.first[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT8(1, e.mark());
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_LIGHT_SHOW, e.id());
+
+  s.clear();
+  e.stop(sinkSend, &s);
+  TEST_ASSERT_FALSE(e.running());
+  TEST_ASSERT_EQUAL_UINT8(0, e.id());
+  TEST_ASSERT_EQUAL_INT(1, s.count);
+  TEST_ASSERT_EQUAL_UINT8(sizeof(TurnOffLights), s.len[0]);
+  e.stop(sinkSend, &s);  /* not running: nothing more */
+  TEST_ASSERT_EQUAL_INT(1, s.count);
+}
+
+void test_repeat_branch_and_end(void) {
+  IbusSeqEngine e;
+  Sink s;
+  size_t n = 0;
+  const uint8_t *panic = ibusSeqBuiltin(IBUS_SEQ_PANIC, &n);
+  /* Lock state unknown: all 30 cycles (3 frames each) then the final off. */
+  e.start(IBUS_SEQ_PANIC, panic, n, 0);
+  run(e, s, 0, 30000);
+  TEST_ASSERT_FALSE(e.running());
+  TEST_ASSERT_EQUAL_INT(30 * 3 + 1, s.count);
+  TEST_ASSERT_EQUAL_UINT32(30 * 900, s.at[s.count - 1]);
+
+  /* Unlocked after 2 s: ends at the next cycle start with lights off. */
+  s.clear();
+  e.start(IBUS_SEQ_PANIC, panic, n, 0);
+  run(e, s, 0, 2000);
+  s.vars[IBUS_SEQ_VAR_LOCK] = 0;
+  run(e, s, 2001, 5000);
+  TEST_ASSERT_FALSE(e.running());
+  TEST_ASSERT_EQUAL_UINT32(2700, s.at[s.count - 1]);
+  TEST_ASSERT_EQUAL_UINT8(sizeof(TurnOffLights), s.len[s.count - 1]);
+
+  /* Comfort close: runs without speed data, skipped while moving. */
+  const uint8_t *cc = ibusSeqBuiltin(IBUS_SEQ_COMFORT_CLOSE, &n);
+  s.clear();
+  s.vars[IBUS_SEQ_VAR_SPEED] = 0xFF;
+  e.start(IBUS_SEQ_COMFORT_CLOSE, cc, n, 0);
+  run(e, s, 0, 2000);
+  TEST_ASSERT_EQUAL_INT(4, s.count);
+  TEST_ASSERT_EQUAL_UINT32(1200, s.at[3]);
+  s.clear();
+  s.vars[IBUS_SEQ_VAR_SPEED] = 40;
+  e.start(IBUS_SEQ_COMFORT_CLOSE, cc, n, 0);
+  run(e, s, 0, 2000);
+  TEST_ASSERT_EQUAL_INT(0, s.count);
+  TEST_ASSERT_FALSE(e.running());
+}
+
+void test_custom_script_raw_frames_and_drops(void) {
+  /* SEND raw, nested REPEAT 2 x 3, WAIT 50. */
+  const uint8_t script[] = {
+      IBUS_SEQ_OP_REPEAT, 2,
+      IBUS_SEQ_OP_SEND, 3, 0x3F, 0x03, 0xD0,
+      IBUS_SEQ_OP_REPEAT, 3,
+      IBUS_SEQ_OP_LCM, 1, 0x0C,
+      IBUS_SEQ_OP_WAIT, 50, 0,
+      IBUS_SEQ_OP_LOOP,
+      IBUS_SEQ_OP_LOOP,
+      IBUS_SEQ_OP_END,
+  };
+  IbusSeqEngine e;
+  Sink s;
+  TEST_ASSERT_EQUAL_UINT8(IBUS_SEQ_OK, e.start(0x10, script, sizeof(script), 0));
+  run(e, s, 0, 1000);
+  TEST_ASSERT_FALSE(e.running());
+  TEST_ASSERT_EQUAL_INT(2 * (1 + 3), s.count);
+  TEST_ASSERT_EQUAL_UINT8(3, s.len[0]);
+  TEST_ASSERT_EQUAL_UINT8(4, s.len[1]);  /* D0 02 00 0C */
+  TEST_ASSERT_EQUAL_UINT32(150, s.at[4]);
+  TEST_ASSERT_EQUAL_UINT32(8, e.framesSent());
+
+  /* TX queue full: frames are counted as dropped, timing goes on. */
+  s.clear();
+  s.accept = false;
+  e.start(0x10, script, sizeof(script), 0);
+  run(e, s, 0, 1000);
+  TEST_ASSERT_EQUAL_UINT32(8, e.framesDropped());
+  TEST_ASSERT_FALSE(e.running());
+}
+
+/*
+ * Timing under load. The main loop takes 2-10 ms per pass, 20-60 ms when OLED/BLE work piles up and
+ * 120-400 ms on rare stalls (flash writes, reconnects). Three ways to step the 300 ms wig-wag:
+ *  legacy  — old tickWigWag(): if (now - last >= 300) { last = now; ... } from the loop
+ *  loop    — engine stepped from the same loop (absolute schedule)
+ *  task    — engine on its own task: wakes at dueMs() + 0-1 ms tick quantisation, 2 % chance of being
+ *            held 1-4 ms by a higher-priority task (BLE host); the loop load does not apply
+ */
+struct TimingResult {
+  uint32_t steps;
+  double meanErrMs;   /* |actual interval - 300| averaged */
+  uint32_t maxErrMs;
+  int32_t driftMs;    /* last step time - where the ideal 300 ms grid puts it */
+};
+
+static uint32_t loopPassMs() {
+  const uint32_t r = nextRand() % 1000;
+  if (r < 5)
+    return 120 + nextRand() % 281;
+  if (r < 200)
+    return 20 + nextRand() % 41;
+  return 2 + nextRand() % 9;
+}
+
+static TimingResult summarize(const Sink &s, uint32_t t0, uint32_t periodMs) {
+  TimingResult r = {};
+  uint64_t sum = 0;
+  int steps = 0;
+  for (int i = 1; i < s.count; i++) {
+    const uint32_t iv = s.at[i] - s.at[i - 1];
+    const uint32_t err = iv > periodMs ? iv - periodMs : periodMs - iv;
+    sum += err;
+    if (err > r.maxErrMs)
+      r.maxErrMs = err;
+    steps++;
+  }
+  r.steps = (uint32_t)steps;
+  r.meanErrMs = steps ? (double)sum / steps : 0;
+  r.driftMs = (int32_t)(s.at[s.count - 1] - (t0 + periodMs * (uint32_t)(s.count - 1)));
+  return r;
+}
+
+void test_timing_under_loop_load(void) {
+  const uint32_t kRunMs = 120000;
+  const uint32_t kPeriod = 300;
+  size_t n = 0;
+  const uint8_t *wig = ibusSeqBuiltin(IBUS_SEQ_WIG_WAG, &n);
+
+  /* legacy */
+  Sink legacy;
+  rng = 0xC0FFEE;
+  {
+    uint32_t now = 0, last = 0;
+    bool first = true;
+    while (now < kRunMs) {
+      if (first || now - last >= kPeriod) {
+        first = false;
+        last = now;
+        legacy.nowMs = now;
+        sinkSend(TurnOffLights, sizeof(TurnOffLights), &legacy);
+      }
+      now += loopPassMs();
+    }
+  }
+  /* engine from the loop */
+  Sink loop;
+  IbusSeqEngine eLoop;
+  rng = 0xC0FFEE;
+  eLoop.start(IBUS_SEQ_WIG_WAG, wig, n, 0);
+  for (uint32_t now = 0; now < kRunMs; now += loopPassMs()) {
+    loop.nowMs = now;
+    eLoop.step(now, sinkSend, sinkQuery, &loop);
+  }
+  /* engine on a task */
+  Sink task;
+  IbusSeqEngine eTask;
+  rng = 0xC0FFEE;
+  eTask.start(IBUS_SEQ_WIG_WAG, wig, n, 0);
+  uint32_t now = 0;
+  while (now < kRunMs) {
+    task.nowMs = now;
+    eTask.step(now, sinkSend, sinkQuery, &task);
+    now = eTask.dueMs() + nextRand() % 2;
+    if (nextRand() % 100 < 2)
+      now += 1 + nextRand() % 4;
+  }
+
+  const TimingResult L = summarize(legacy, 0, kPeriod);
+  const TimingResult E = summarize(loop, 0, kPeriod);
+  const TimingResult T = summarize(task, 0, kPeriod);
+  printf("  wig-wag 300 ms over %u s, loaded loop:\n", (unsigned)(kRunMs / 1000));
+  printf("    legacy millis(): %u steps, interval err mean %.1f / max %u ms, drift %+d ms\n",
+         (unsigned)L.steps, L.meanErrMs, (unsigned)L.maxErrMs, (int)L.driftMs);
+  printf("    engine in loop : %u steps, interval err mean %.1f / max %u ms, drift %+d ms, late max %u, reanchors %u\n",
+         (unsigned)E.steps, E.meanErrMs, (unsigned)E.maxErrMs, (int)E.driftMs, (unsigned)eLoop.lateMaxMs(),
+         (unsigned)eLoop.reanchors());
+  printf("    engine on task : %u steps, interval err mean %.2f / max %u ms, drift %+d ms, late max %u\n",
+         (unsigned)T.steps, T.meanErrMs, (unsigned)T.maxErrMs, (int)T.driftMs, (unsigned)eTask.lateMaxMs());
+
+  /* Legacy loses the lateness of every step; the schedule only loses the re-anchored stalls. */
+  TEST_ASSERT_TRUE(L.driftMs > 5000);
+  TEST_ASSERT_TRUE(E.driftMs < L.driftMs / 2);
+  TEST_ASSERT_TRUE(L.steps < T.steps - 20);
+  /* On the task: within the tick and the odd preemption, no drift. */
+  TEST_ASSERT_TRUE(T.maxErrMs <= 6);
+  TEST_ASSERT_TRUE(T.meanErrMs < 1.5);
+  TEST_ASSERT_TRUE(T.driftMs >= 0 && T.driftMs <= 5);
+  TEST_ASSERT_EQUAL_UINT32(0, eTask.reanchors());
+  TEST_ASSERT_EQUAL_UINT32(kRunMs / kPeriod - 1, T.steps);
+}
+
+void test_late_step_catches_up_or_reanchors(void) {
+  const uint8_t script[] = {
+      IBUS_SEQ_OP_SEND_CODE, 0, IBUS_SEQ_OP_WAIT, 100, 0, IBUS_SEQ_OP_JUMP, 0,
+  };
+  IbusSeqEngine e;
+  Sink s;
+  e.start(0x10, script, sizeof(script), 0);
+  s.nowMs = 0;
+  e.step(0, sinkSend, sinkQuery, &s);
+  /* 60 ms late: that step runs late, the next one is back on the 100 ms grid. */
+  s.nowMs = 160;
+  e.step(160, sinkSend, sinkQuery, &s);
+  TEST_ASSERT_EQUAL_INT(2, s.count);
+  TEST_ASSERT_EQUAL_UINT32(200, e.dueMs());
+  /* 250 ms late: caught up in one burst would be 3 frames; re-anchored instead, one frame. */
+  s.nowMs = 450;
+  e.step(450, sinkSend, sinkQuery, &s);
+  TEST_ASSERT_EQUAL_INT(3, s.count);
+  TEST_ASSERT_EQUAL_UINT32(550, e.dueMs());
+  TEST_ASSERT_EQUAL_UINT32(1, e.reanchors());
+  TEST_ASSERT_EQUAL_UINT32(250, e.lateMaxMs());
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_builtins_validate_and_codes_match);
+  RUN_TEST(test_validator_rejects_bad_scripts);
+  RUN_TEST(test_light_show_order_marks_and_stop);
+  RUN_TEST(test_repeat_branch_and_end);
+  RUN_TEST(test_custom_script_raw_frames_and_drops);
+  RUN_TEST(test_timing_under_loop_load);
+  RUN_TEST(test_late_step_catches_up_or_reanchors);
+  return UNITY_END();
+}
@@ -0,0 +1,354 @@
+/*
+ * Host tests: monitor stream framing (LineFramer.cpp) — split and merged segments, newest-line-wins, every
+ * line in order once subscribed, oversized line resync, time budget — and a bursty synthetic stream
+ * through framer + MonitorDecoder against the per-byte read/append loop main.cpp ran before: worst loop
+ * stall and bytes per µs.
+ * Run: pio test -e native -f native/test_line_framer
+ */
+#include <unity.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "LineFramer.h"
+#include "MonitorDecoder.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* Socket stand-in: data up to `avail` is readable, at most `seg` bytes per read (one TCP segment). */
+struct Source {
+  std::string data;
+  size_t avail = 0;
+  size_t pos = 0;
+  size_t seg = 1460;
+  size_t reads = 0;
+};
+
+static size_t readSource(void *ctx, char *dst, size_t cap) {
+  Source *s = (Source *)ctx;
+  const size_t n = std::min(std::min(cap, s->seg), s->avail - s->pos);
+  memcpy(dst, s->data.data() + s->pos, n);
+  s->pos += n;
+  if (n)
+    s->reads++;
+  return n;
+}
+
+/* Fake clock: every read costs 100 us. */
+static uint32_t s_fakeUs = 0;
+static uint32_t fakeClock() { return s_fakeUs; }
+static size_t readSlow(void *ctx, char *dst, size_t cap) {
+  s_fakeUs += 100;
+  return readSource(ctx, dst, cap);
+}
+
+static uint32_t steadyUs() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static std::string takeAll(LineFramer &f, Source &src) {
+  std::string out;
+  char *line;
+  size_t len;
+  while (f.pump(readSource, &src, fakeClock, 1000000) || src.pos < src.avail) {
+    if (f.takeLine(&line, &len)) {
+      TEST_ASSERT_EQUAL_UINT(strlen(line), len);
+      out += line;
+      out += '|';
+    }
+  }
+  return out;
+}
+
+void test_split_segments(void) {
+  /* Byte-by-byte and 3-byte segments: every line is seen when taken as soon as it completes. */
+  for (size_t seg : {(size_t)1, (size_t)3, (size_t)1460}) {
+    LineFramer f;
+    Source src;
+    src.data = "{\"a\":1}\n\n{\"b\":2}\r\n{\"c\":3}\n{\"d\"";
+    src.seg = seg;
+    char *line;
+    size_t len;
+    std::string got;
+    for (src.avail = 1; src.avail <= src.data.size(); src.avail++)
+      if (f.pump(readSource, &src, fakeClock, 1000000) && f.takeLine(&line, &len))
+        got += std::string(line) + "|";
+    TEST_ASSERT_EQUAL_STRING("{\"a\":1}|{\"b\":2}\r|{\"c\":3}|", got.c_str());
+    TEST_ASSERT_EQUAL_UINT32(0, f.superseded());
+    /* The unterminated rest survives and completes later. */
+    src.data += ":4}\n";
+    src.avail = src.data.size();
+    TEST_ASSERT_EQUAL_STRING("{\"d\":4}|", takeAll(f, src).c_str());
+  }
+}
+
+void test_newest_line_wins(void) {
+  LineFramer f;
+  Source src;
+  for (int i = 0; i < 5; i++)
+    src.data += "{\"ct\":" + std::to_string(i) + "}\n";
+  src.data += "{\"ct\":9";
+  src.avail = src.data.size();
+  char *line;
+  size_t len;
+  TEST_ASSERT_TRUE(f.pump(readSource, &src, fakeClock, 1000000));
+  TEST_ASSERT_TRUE(f.takeLine(&line, &len));
+  TEST_ASSERT_EQUAL_STRING("{\"ct\":4}", line);
+  TEST_ASSERT_EQUAL_UINT32(4, f.superseded());
+  TEST_ASSERT_FALSE(f.takeLine(&line, &len));
+  /* reset() forgets the partial line (new connection). */
+  f.reset();
+  src.data += "}\n{\"ct\":10}\n";
+  src.avail = src.data.size();
+  TEST_ASSERT_EQUAL_STRING("{\"ct\":10}|", takeAll(f, src).c_str());
+}
+
+void test_every_line_in_order(void) {
+  /* Partial lines (subscribed): every queued line comes out, oldest first, none superseded. */
+  LineFramer f;
+  f.setEveryLine(true);
+  Source src;
+  for (int i = 0; i < 5; i++)
+    src.data += "{\"sb\":1,\"ct\":" + std::to_string(i) + "}\n\n";
+  src.data += "{\"sb\":1,\"gt\":9";
+  src.avail = src.data.size();
+  std::string want;
+  for (int i = 0; i < 5; i++)
+    want += "{\"sb\":1,\"ct\":" + std::to_string(i) + "}|";
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), takeAll(f, src).c_str());
+  src.data += "}\n";
+  src.avail = src.data.size();
+  TEST_ASSERT_EQUAL_STRING("{\"sb\":1,\"gt\":9}|", takeAll(f, src).c_str());
+
+  /* A burst longer than the buffer: reading stops until the queued lines are taken, nothing is lost. */
+  std::string burst;
+  for (int i = 0; i < 100; i++)
+    burst += "{\"sb\":1,\"ct\":" + std::to_string(i) + ",\"pad\":\"" + std::string(100, 'p') + "\"}\n";
+  src.data += burst;
+  src.avail = src.data.size();
+  char *line;
+  size_t len;
+  int next = 0;
+  while (f.pump(readSource, &src, fakeClock, 1000000))
+    while (f.takeLine(&line, &len))
+      TEST_ASSERT_EQUAL_INT(next++, atoi(line + 13));
+  TEST_ASSERT_EQUAL_INT(100, next);
+  TEST_ASSERT_EQUAL_UINT(src.avail, src.pos);
+  TEST_ASSERT_EQUAL_UINT32(0, f.superseded());
+  TEST_ASSERT_EQUAL_UINT32(0, f.oversized());
+}
+
+void test_oversized_line_resyncs(void) {
+  LineFramer f;
+  Source src;
+  const std::string fits = "{\"p\":\"" + std::string(LineFramer::kCap - 9, 'x') + "\"}";
+  TEST_ASSERT_EQUAL_UINT(LineFramer::kCap - 1, fits.size());
+  src.data = std::string(3 * LineFramer::kCap + 17, 'y') + "\n{\"ok\":1}\n" + fits + "\n" +
+             std::string(LineFramer::kCap, 'z') + "\n{\"ok\":2}\n";
+  src.seg = 1000;
+  /* Arriving 1000 bytes per loop iteration, each line taken as it completes. */
+  std::string got;
+  char *line;
+  size_t len;
+  while (src.avail < src.data.size()) {
+    src.avail = std::min(src.avail + 1000, src.data.size());
+    if (f.pump(readSource, &src, fakeClock, 1000000) && f.takeLine(&line, &len))
+      got += std::string(line) + "|";
+  }
+  TEST_ASSERT_EQUAL_STRING(("{\"ok\":1}|" + fits + "|{\"ok\":2}|").c_str(), got.c_str());
+  TEST_ASSERT_EQUAL_UINT32(0, f.superseded());
+  TEST_ASSERT_EQUAL_UINT32(2, f.oversized());
+  TEST_ASSERT_TRUE(f.bytes() == src.data.size());
+}
+
+void test_full_buffer_keeps_reading(void) {
+  LineFramer f;
+  Source src;
+  /* A burst longer than the buffer: pending lines give way to the newer ones behind them. */
+  for (int i = 0; i < 100; i++)
+    src.data += "{\"ct\":" + std::to_string(i) + ",\"pad\":\"" + std::string(300, 'p') + "\"}\n";
+  src.avail = src.data.size();
+  char *line;
+  size_t len;
+  TEST_ASSERT_TRUE(f.pump(readSource, &src, fakeClock, 1000000));
+  TEST_ASSERT_EQUAL_UINT(src.avail, src.pos);
+  TEST_ASSERT_TRUE(f.takeLine(&line, &len));
+  TEST_ASSERT_EQUAL_STRING_LEN("{\"ct\":99,", line, 9);
+  TEST_ASSERT_EQUAL_UINT32(99, f.superseded());
+
+  /* A long line behind a pending one costs the pending one; framing resumes after it. */
+  src.data += "{\"a\":1}\n" + std::string(LineFramer::kCap + 100, 'q') + "\n{\"b\":2}\n";
+  src.avail = src.data.size();
+  TEST_ASSERT_EQUAL_STRING("{\"b\":2}|", takeAll(f, src).c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, f.oversized());
+
+  /* A single line of exactly the maximum size still comes out whole. */
+  const std::string fits(LineFramer::kCap - 1, 'm');
+  src.data += fits + "\n";
+  src.avail = src.data.size();
+  TEST_ASSERT_EQUAL_STRING((fits + "|").c_str(), takeAll(f, src).c_str());
+}
+
+void test_time_budget(void) {
+  LineFramer f;
+  Source src;
+  for (int i = 0; i < 40; i++)
+    src.data += "{\"ct\":" + std::to_string(i) + ",\"pad\":\"" + std::string(200, 'p') + "\"}\n";
+  src.avail = src.data.size();
+  src.seg = 512;
+  s_fakeUs = 0;
+  char *line;
+  size_t len;
+  int calls = 0;
+  std::string last;
+  while (src.pos < src.avail) {
+    const uint32_t before = s_fakeUs;
+    if (f.pump(readSlow, &src, fakeClock, 1000) && f.takeLine(&line, &len))
+      last = line;
+    TEST_ASSERT_TRUE(s_fakeUs - before <= 1000);
+    calls++;
+  }
+  TEST_ASSERT_TRUE(calls > 1);
+  TEST_ASSERT_EQUAL_UINT32(calls - 1, f.budgetStops());
+  TEST_ASSERT_EQUAL_STRING_LEN("{\"ct\":39,", last.c_str(), 9);
+}
+
+/* ── Bursty stream: old per-byte loop vs framer ── */
+
+static const char kPayload[] =
+    "{\"ct\":%d,\"gt\":61,\"cl\":23,\"gl\":41,\"cc\":4650,\"pw\":87,\"gh\":58,\"gv\":71,\"gclock\":1905,"
+    "\"vclock\":9501,\"gtdp\":163,\"ru\":11.4,\"ra\":20.6,\"nd\":1530,\"nu\":212,\"pg\":9,\"cf\":1210,"
+    "\"s1\":980,\"s2\":0,\"gf\":1440,\"fans\":[1210,2480,1440,860],\"fan_controls\":[45,80,52,30],"
+    "\"hdd\":[{\"n\":\"C\",\"u\":412.5,\"tot\":931.0,\"t\":38},{\"n\":\"D\",\"u\":1620.0,\"tot\":3726.0,\"t\":33}],"
+    "\"vu\":6.2,\"vt\":12.0,\"ch\":47,\"mb_sys\":36,\"mb_vsoc\":44,\"mb_vrm\":52,\"mb_chipset\":48,"
+    "\"dr\":120,\"dw\":38,\"wt\":7,\"wd\":\"\\u041e\\u0431\\u043b\\u0430\\u0447\\u043d\\u043e\",\"wi\":3,"
+    "\"tp\":[{\"n\":\"chrome.exe\",\"c\":12},{\"n\":\"Code.exe\",\"c\":6},{\"n\":\"python.exe\",\"c\":3}],"
+    "\"tr\":[{\"n\":\"chrome.exe\",\"r\":2350},{\"n\":\"Code.exe\",\"r\":1180}],"
+    "\"art\":\"Carpenter Brut\",\"trk\":\"Turbo Killer\",\"mp\":true,\"idle\":false,"
+    "\"media_status\":\"PLAYING\",\"alert\":\"OK\"}\n";
+
+/* One byte per call, as WiFiClient::read() was called. */
+static int __attribute__((noinline)) readByte(Source *s) {
+  return s->pos < s->avail ? (uint8_t)s->data[s->pos++] : -1;
+}
+
+struct LegacyRx {
+  char buf[NOCT_TCP_LINE_MAX];
+  size_t len = 0;
+};
+
+/* main.cpp before: drain the socket byte by byte, decode every line on the way. */
+static int legacyIteration(LegacyRx &rx, Source &src, MonitorDecoder &dec, AppState *st) {
+  int decoded = 0;
+  int c;
+  while ((c = readByte(&src)) >= 0) {
+    if (c == '\n') {
+      if (rx.len > 0 && dec.decode(rx.buf, rx.len, st))
+        decoded++;
+      rx.len = 0;
+    } else if (rx.len < NOCT_TCP_LINE_MAX - 1) {
+      rx.buf[rx.len++] = (char)c;
+    } else {
+      rx.len = 0;
+    }
+  }
+  return decoded;
+}
+
+static int framerIteration(LineFramer &f, Source &src, MonitorDecoder &dec, AppState *st, uint32_t budgetUs) {
+  char *line;
+  size_t len;
+  return f.pump(readSource, &src, steadyUs, budgetUs) && f.takeLine(&line, &len) && dec.decode(line, len, st)
+             ? 1
+             : 0;
+}
+
+struct RunStats {
+  double worstUs = 0;
+  double totalUs = 0;
+  int decoded = 0;
+  int iterations = 0;
+  int lastCt = -1;
+};
+
+/* 1 payload per 50 iterations normally; every 400 iterations a 60-payload burst (server caught up
+ * after a Wi-Fi stall); a few over-long garbage lines in between. */
+template <typename Iter>
+static RunStats runBursty(Iter iter) {
+  Source src;
+  src.seg = 1460;
+  std::string tmp(sizeof(kPayload) + 16, '\0');
+  int ct = 0;
+  RunStats r;
+  AppState st;
+  const int kIterations = 4000;
+  for (int i = 0; i < kIterations + 200; i++) {
+    if (i < kIterations) {
+      const int n = i % 400 == 399 ? 60 : i % 50 == 0 ? 1 : 0;
+      for (int k = 0; k < n; k++) {
+        const int w = snprintf(&tmp[0], tmp.size(), kPayload, ct++);
+        src.data.append(tmp.data(), (size_t)w);
+      }
+      if (i % 1000 == 500)
+        src.data += std::string(NOCT_TCP_LINE_MAX + 300, 'g') + "\n";
+      src.avail = src.data.size();
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    r.decoded += iter(src, &st);
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    r.worstUs = std::max(r.worstUs, us);
+    r.totalUs += us;
+    r.iterations++;
+  }
+  TEST_ASSERT_EQUAL_UINT(src.data.size(), src.pos);
+  r.lastCt = st.hw.ct;
+  TEST_ASSERT_EQUAL_INT(ct - 1, r.lastCt);
+  return r;
+}
+
+void test_bursty_stream_stall(void) {
+  MonitorDecoder legacyDec, framerDec;
+  LegacyRx rx;
+  LineFramer f;
+  size_t bytes = 0;
+  const RunStats legacy = runBursty([&](Source &src, AppState *st) {
+    bytes = src.data.size();
+    return legacyIteration(rx, src, legacyDec, st);
+  });
+  /* Host budget scaled to the host: one ESP32-S3 iteration budget is NOCT_TCP_RX_BUDGET_US. */
+  const uint32_t kHostBudgetUs = 20;
+  const RunStats framer = runBursty([&](Source &src, AppState *st) {
+    return framerIteration(f, src, framerDec, st, kHostBudgetUs);
+  });
+
+  printf("  bursty stream, %u bytes, %d iterations (host):\n", (unsigned)bytes, legacy.iterations);
+  printf("    per-byte + decode all:  worst stall %7.1f us, %6.1f B/us, %d decodes\n", legacy.worstUs,
+         bytes / legacy.totalUs, legacy.decoded);
+  printf("    bulk + newest line:     worst stall %7.1f us, %6.1f B/us, %d decodes, %u superseded, "
+         "%u budget stops, %u oversized\n",
+         framer.worstUs, bytes / framer.totalUs, framer.decoded, (unsigned)f.superseded(),
+         (unsigned)f.budgetStops(), (unsigned)f.oversized());
+  TEST_ASSERT_TRUE(framer.worstUs < legacy.worstUs);
+  TEST_ASSERT_TRUE(framer.totalUs < legacy.totalUs);
+  TEST_ASSERT_TRUE(framer.decoded < legacy.decoded);
+  TEST_ASSERT_EQUAL_UINT32(4, f.oversized());
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_split_segments);
+  RUN_TEST(test_newest_line_wins);
+  RUN_TEST(test_every_line_in_order);
+  RUN_TEST(test_oversized_line_resyncs);
+  RUN_TEST(test_full_buffer_keeps_reading);
+  RUN_TEST(test_time_budget);
+  RUN_TEST(test_bursty_stream_stall);
+  return UNITY_END();
+}
@@ -0,0 +1,140 @@
+/*
+ * Host tests: link markers (LinkMarks.cpp) and the "ln" line number they echo (MonitorDecoder.cpp) — the
+ * number is read but changes nothing in AppState, @ack carries parse deltas once per new number, @frm once
+ * per acknowledged number, a host switch only sets the baseline, and the server side parses exactly what
+ * the device prints.
+ * Run: pio test -e native -f native/test_link_marks
+ */
+#include <unity.h>
+#include <cstring>
+#include "LinkMarks.h"
+#include "MonitorDecoder.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static bool decode(MonitorDecoder &d, const char *line, AppState *st) { return d.decode(line, strlen(line), st); }
+
+void test_line_number_in_payload(void) {
+  MonitorDecoder d;
+  AppState st;
+  TEST_ASSERT_TRUE(decode(d, "{\"ct\":50,\"gt\":60}", &st));
+  TEST_ASSERT_EQUAL_INT(-1, d.mark());
+
+  /* At the end of a full line, as the server stamps it, with a padding key the decoder steps over. */
+  TEST_ASSERT_TRUE(decode(d, "{\"ct\":50,\"gt\":60,\"ln\":41,\"pd\":\"xxxxxxxx\"}", &st));
+  TEST_ASSERT_EQUAL_INT(41, d.mark());
+  TEST_ASSERT_TRUE(d.changed() == 0); /* same values: the number is no field */
+  TEST_ASSERT_EQUAL_INT(50, st.hw.ct);
+
+  /* Partial line: still partial with "ln" after "sb". */
+  TEST_ASSERT_TRUE(decode(d, "{\"sb\":3,\"cl\":17,\"ln\":42}", &st));
+  TEST_ASSERT_EQUAL_INT(42, d.mark());
+  TEST_ASSERT_EQUAL_INT(3, d.subscription());
+  TEST_ASSERT_EQUAL_INT(60, st.hw.gt);
+  TEST_ASSERT_TRUE(d.changed() == fieldBit(SF_CL));
+
+  /* A rejected line keeps the last number; a line without one clears it. */
+  TEST_ASSERT_FALSE(decode(d, "{\"sb\":3,\"cl\":18,\"ln\":43", &st));
+  TEST_ASSERT_EQUAL_INT(42, d.mark());
+  TEST_ASSERT_TRUE(decode(d, "{\"sb\":3,\"cl\":18}", &st));
+  TEST_ASSERT_EQUAL_INT(-1, d.mark());
+}
+
+void test_ack_and_frame_marks(void) {
+  LinkMarks marks;
+  char out[LinkMarks::kLineMax];
+  MonitorSnapshot s;
+  /* Nothing to acknowledge or show without a line number. */
+  s.parsed = 3;
+  s.parseUs = 90;
+  TEST_ASSERT_EQUAL_UINT32(0, marks.ack(s, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_UINT32(0, marks.frame(1500, out, sizeof(out)));
+
+  s.mark = 10;
+  s.parsed = 5;
+  s.rejected = 1;
+  s.parseUs = 150;
+  TEST_ASSERT_EQUAL_UINT32(strlen("@ack 10 5 1 150\n"), marks.ack(s, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_STRING("@ack 10 5 1 150\n", out);
+  TEST_ASSERT_EQUAL_UINT32(0, marks.ack(s, out, sizeof(out))); /* same line again */
+
+  /* Deltas since the last @ack; the frame names the newest line acknowledged, once. */
+  s.mark = 14;
+  s.parsed = 9;
+  s.parseUs = 270;
+  TEST_ASSERT_TRUE(marks.ack(s, out, sizeof(out)) > 0);
+  TEST_ASSERT_EQUAL_STRING("@ack 14 4 0 120\n", out);
+  TEST_ASSERT_TRUE(marks.frame(2100, out, sizeof(out)) > 0);
+  TEST_ASSERT_EQUAL_STRING("@frm 14 2100\n", out);
+  TEST_ASSERT_EQUAL_UINT32(0, marks.frame(2100, out, sizeof(out)));
+
+  /* Too small: nothing printed, nothing consumed. */
+  s.mark = 15;
+  s.parsed = 10;
+  TEST_ASSERT_EQUAL_UINT32(0, marks.ack(s, out, 8));
+  TEST_ASSERT_TRUE(marks.ack(s, out, sizeof(out)) > 0);
+  TEST_ASSERT_EQUAL_STRING("@ack 15 1 0 0\n", out);
+
+  /* Host switch: another link's counters only set the baseline. */
+  marks.reset();
+  MonitorSnapshot other;
+  other.mark = 900;
+  other.parsed = 2000;
+  other.parseUs = 64000;
+  TEST_ASSERT_EQUAL_UINT32(0, marks.ack(other, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_UINT32(0, marks.frame(1800, out, sizeof(out)));
+  other.mark = 901;
+  other.parsed = 2002;
+  other.parseUs = 64050;
+  TEST_ASSERT_TRUE(marks.ack(other, out, sizeof(out)) > 0);
+  TEST_ASSERT_EQUAL_STRING("@ack 901 2 0 50\n", out);
+}
+
+void test_parse_marks(void) {
+  LinkMarks marks;
+  char out[LinkMarks::kLineMax];
+  MonitorSnapshot s;
+  s.mark = 123456;
+  s.parsed = 40;
+  s.rejected = 2;
+  s.parseUs = 1234;
+  const size_t n = marks.ack(s, out, sizeof(out));
+  LinkMark m;
+  TEST_ASSERT_TRUE(LinkMarks::parse(out, n - 1, &m)); /* without the newline */
+  TEST_ASSERT_EQUAL_INT(LinkMark::ACK, m.kind);
+  TEST_ASSERT_EQUAL_INT32(123456, m.ln);
+  TEST_ASSERT_EQUAL_UINT32(40, m.lines);
+  TEST_ASSERT_EQUAL_UINT32(2, m.rejected);
+  TEST_ASSERT_EQUAL_UINT32(1234, m.parseUs);
+
+  const char *frm = "@frm 123456 8800\r"; /* println() on the device */
+  TEST_ASSERT_TRUE(LinkMarks::parse(frm, strlen(frm), &m));
+  TEST_ASSERT_EQUAL_INT(LinkMark::FRAME, m.kind);
+  TEST_ASSERT_EQUAL_INT32(123456, m.ln);
+  TEST_ASSERT_EQUAL_UINT32(8800, m.frameUs);
+
+  /* Anything else on Serial is left alone and leaves m as it was. */
+  static const char *const kNot[] = {
+      "[NET] 2 host(s), 14560 bytes each", "@ack 1 2 3", "@ack 1 2 3 4 5", "@frm -1 10", "@frm 5 10x",
+      "@xyz 1 2", "@", "",
+  };
+  for (const char *line : kNot)
+    TEST_ASSERT_FALSE_MESSAGE(LinkMarks::parse(line, strlen(line), &m), line);
+  TEST_ASSERT_EQUAL_UINT32(8800, m.frameUs);
+  char longLine[LinkMarks::kLineMax + 8];
+  memset(longLine, '1', sizeof(longLine));
+  memcpy(longLine, "@frm ", 5);
+  TEST_ASSERT_FALSE(LinkMarks::parse(longLine, sizeof(longLine), &m));
+  TEST_ASSERT_FALSE(LinkMarks::parse(nullptr, 4, &m));
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_line_number_in_payload);
+  RUN_TEST(test_ack_and_frame_marks);
+  RUN_TEST(test_parse_marks);
+  return UNITY_END();
+}
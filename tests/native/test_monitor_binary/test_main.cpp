@@ -0,0 +1,362 @@
+/*
+ * Host tests: binary monitor protocol (MonitorBinary.cpp) — round trip, delta frames, string dictionary,
+ * malformed and unknown fields, the "BIN 1" switch in LineFramer — and bytes per update and decode time
+ * against the JSON line path (MonitorDecoder) over a simulated session.
+ * Run: pio test -e native -f native/test_monitor_binary
+ */
+#include <unity.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "LineFramer.h"
+#include "MonitorBinary.h"
+#include "MonitorDecoder.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static AppState sample() {
+  AppState s;
+  HardwareData &hw = s.hw;
+  hw.ct = 54, hw.gt = 61, hw.cl = 23, hw.gl = 41, hw.cc = 4650, hw.pw = 87, hw.gh = 58, hw.gv = 71;
+  hw.gclock = 1905, hw.vclock = 9501, hw.gtdp = 163, hw.ru = 11.4f, hw.ra = 20.6f;
+  hw.nd = 1530, hw.nu = 212, hw.pg = 9, hw.cf = 1210, hw.s1 = 980, hw.s2 = 0, hw.gf = 1440;
+  const int fans[] = {1210, 2480, 1440, 860}, ctl[] = {45, 80, 52, 30};
+  for (int i = 0; i < NOCT_FAN_COUNT; i++)
+    hw.fans[i] = fans[i], hw.fan_controls[i] = ctl[i];
+  for (int i = 0; i < NOCT_HDD_COUNT; i++)
+    hw.hdd[i].name[0] = (char)('C' + i);
+  hw.hdd[0].used_gb = 412.5f, hw.hdd[0].total_gb = 931.0f, hw.hdd[0].temp = 38;
+  hw.hdd[1].used_gb = 1620.0f, hw.hdd[1].total_gb = 3726.0f, hw.hdd[1].temp = 33;
+  hw.vu = 6.2f, hw.vt = 12.0f, hw.ch = 47, hw.mb_sys = 36, hw.mb_vsoc = 44, hw.mb_vrm = 52, hw.mb_chipset = 48;
+  hw.dr = 120, hw.dw = 38;
+  s.weather.temp = 7, s.weather.desc = "Облачно", s.weather.wmoCode = 3;
+  const char *cpu[] = {"chrome.exe", "Code.exe", "python.exe"};
+  const int pct[] = {12, 6, 3};
+  for (int i = 0; i < 3; i++)
+    s.process.cpuNames[i] = cpu[i], s.process.cpuPercent[i] = pct[i];
+  s.process.ramNames[0] = "chrome.exe", s.process.ramMb[0] = 2350;
+  s.process.ramNames[1] = "Code.exe", s.process.ramMb[1] = 1180;
+  s.media.artist = "Carpenter Brut", s.media.track = "Turbo Killer";
+  s.media.isPlaying = true, s.media.mediaStatus = "PLAYING";
+  return s;
+}
+
+static void assertSame(const AppState &a, const AppState &b) {
+  TEST_ASSERT_EQUAL_MEMORY(&a.hw.ct, &b.hw.ct, sizeof(int) * 11); /* ct .. gtdp */
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, a.hw.ru, b.hw.ru);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, a.hw.ra, b.hw.ra);
+  TEST_ASSERT_EQUAL_MEMORY(&a.hw.nd, &b.hw.nd, sizeof(int) * 7); /* nd .. gf */
+  TEST_ASSERT_EQUAL_INT_ARRAY(a.hw.fans, b.hw.fans, NOCT_FAN_COUNT);
+  TEST_ASSERT_EQUAL_INT_ARRAY(a.hw.fan_controls, b.hw.fan_controls, NOCT_FAN_COUNT);
+  for (int i = 0; i < NOCT_HDD_COUNT; i++) {
+    TEST_ASSERT_EQUAL_INT(a.hw.hdd[i].name[0], b.hw.hdd[i].name[0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, a.hw.hdd[i].used_gb, b.hw.hdd[i].used_gb);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, a.hw.hdd[i].total_gb, b.hw.hdd[i].total_gb);
+    TEST_ASSERT_EQUAL_INT(a.hw.hdd[i].temp, b.hw.hdd[i].temp);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, a.hw.vu, b.hw.vu);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, a.hw.vt, b.hw.vt);
+  TEST_ASSERT_EQUAL_MEMORY(&a.hw.ch, &b.hw.ch, sizeof(int) * 7); /* ch .. dw */
+  TEST_ASSERT_EQUAL_INT(a.weather.temp, b.weather.temp);
+  TEST_ASSERT_EQUAL_STRING(a.weather.desc.c_str(), b.weather.desc.c_str());
+  TEST_ASSERT_EQUAL_INT(a.weather.wmoCode, b.weather.wmoCode);
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_STRING(a.process.cpuNames[i].c_str(), b.process.cpuNames[i].c_str());
+    TEST_ASSERT_EQUAL_INT(a.process.cpuPercent[i], b.process.cpuPercent[i]);
+  }
+  for (int i = 0; i < 2; i++) {
+    TEST_ASSERT_EQUAL_STRING(a.process.ramNames[i].c_str(), b.process.ramNames[i].c_str());
+    TEST_ASSERT_EQUAL_INT(a.process.ramMb[i], b.process.ramMb[i]);
+  }
+  TEST_ASSERT_EQUAL_STRING(a.media.artist.c_str(), b.media.artist.c_str());
+  TEST_ASSERT_EQUAL_STRING(a.media.track.c_str(), b.media.track.c_str());
+  TEST_ASSERT_EQUAL_STRING(a.media.mediaStatus.c_str(), b.media.mediaStatus.c_str());
+  TEST_ASSERT_EQUAL(a.media.isPlaying, b.media.isPlaying);
+  TEST_ASSERT_EQUAL(a.media.isIdle, b.media.isIdle);
+  TEST_ASSERT_EQUAL(a.alertActive, b.alertActive);
+  TEST_ASSERT_EQUAL_INT(a.alertTargetScene, b.alertTargetScene);
+  TEST_ASSERT_EQUAL_INT(a.alertMetric, b.alertMetric);
+}
+
+struct Link {
+  MonitorBinaryEncoder enc;
+  MonitorBinaryDecoder dec;
+  uint8_t frame[MonitorBinary::kFrameMax];
+  size_t last = 0;
+
+  bool send(const AppState &s, AppState *dst) {
+    last = enc.encode(s, frame, sizeof(frame));
+    TEST_ASSERT_TRUE(last >= MonitorBinary::kHeader + 2);
+    TEST_ASSERT_EQUAL_HEX8(MonitorBinary::kMagic, frame[0]);
+    TEST_ASSERT_EQUAL_UINT(last - MonitorBinary::kHeader, frame[1] | frame[2] << 8);
+    return dec.decode(frame + MonitorBinary::kHeader, last - MonitorBinary::kHeader, dst);
+  }
+};
+
+void test_round_trip_and_deltas(void) {
+  Link l;
+  AppState src = sample(), dst;
+  TEST_ASSERT_TRUE(l.send(src, &dst));
+  assertSame(src, dst);
+  TEST_ASSERT_TRUE(dst.weatherReceived);
+  const size_t keyframe = l.last;
+
+  /* Nothing changed: header, flags and sequence only. */
+  TEST_ASSERT_TRUE(l.send(src, &dst));
+  TEST_ASSERT_EQUAL_UINT(MonitorBinary::kHeader + 2, l.last);
+
+  /* Two values and a negative one: three small fields. */
+  src.hw.ct = 55, src.hw.cl = 24, src.hw.gv = -12, src.hw.ru = 11.5f;
+  TEST_ASSERT_TRUE(l.send(src, &dst));
+  TEST_ASSERT_TRUE(l.last <= MonitorBinary::kHeader + 2 + 4 * 3);
+  assertSame(src, dst);
+
+  src.alertActive = true, src.alertTargetScene = NOCT_SCENE_GPU, src.alertMetric = NOCT_ALERT_GT;
+  src.media.mediaStatus = "PAUSED", src.media.isPlaying = false;
+  src.hw.hdd[3].name[0] = 'Z';
+  TEST_ASSERT_TRUE(l.send(src, &dst));
+  assertSame(src, dst);
+  printf("  keyframe %u B, unchanged %u B\n", (unsigned)keyframe, (unsigned)(MonitorBinary::kHeader + 2));
+  TEST_ASSERT_EQUAL_UINT32(0, l.dec.gaps());
+}
+
+void test_string_dictionary(void) {
+  Link l;
+  AppState src = sample(), dst;
+  TEST_ASSERT_TRUE(l.send(src, &dst));
+  /* The same names move between slots: references only, one byte each. */
+  src.process.cpuNames[0] = "Code.exe", src.process.cpuNames[1] = "chrome.exe";
+  src.process.ramNames[0] = "Code.exe", src.process.ramNames[1] = "chrome.exe";
+  TEST_ASSERT_TRUE(l.send(src, &dst));
+  TEST_ASSERT_EQUAL_UINT(MonitorBinary::kHeader + 2 + 4 * 2, l.last);
+  assertSame(src, dst);
+
+  /* More distinct names than slots: old ones are evicted and defined again when they come back. */
+  char name[32];
+  for (int i = 0; i < 3 * MonitorBinary::kDictSlots; i++) {
+    snprintf(name, sizeof(name), "proc%02d.exe", i);
+    src.process.cpuNames[i % 3] = name;
+    if (i % 7 == 0)
+      src.process.cpuNames[(i + 1) % 3] = "chrome.exe";
+    TEST_ASSERT_TRUE(l.send(src, &dst));
+    assertSame(src, dst);
+  }
+  /* Over-long text is cut on a UTF-8 boundary (2-byte letters: 31 whole ones fit 63 bytes). */
+  std::string longText;
+  for (int i = 0; i < 40; i++)
+    longText += "ж";
+  src.media.track = longText.c_str();
+  TEST_ASSERT_TRUE(l.send(src, &dst));
+  TEST_ASSERT_EQUAL_UINT(62, dst.media.track.length());
+  TEST_ASSERT_EQUAL_MEMORY(longText.data(), dst.media.track.c_str(), 62);
+  src.media.track = "";
+  TEST_ASSERT_TRUE(l.send(src, &dst));
+  TEST_ASSERT_EQUAL_STRING("", dst.media.track.c_str());
+
+  /* Keyframes come back on their own: a fresh decoder picks the stream up at the next one. */
+  MonitorBinaryDecoder late;
+  AppState lateDst;
+  bool synced = false;
+  for (int i = 0; i < MonitorBinary::kKeyframeEvery + 1 && !synced; i++) {
+    src.hw.ct = i;
+    l.last = l.enc.encode(src, l.frame, sizeof(l.frame));
+    if (l.frame[MonitorBinary::kHeader] & MonitorBinary::kFlagKey) {
+      TEST_ASSERT_TRUE(late.decode(l.frame + MonitorBinary::kHeader, l.last - MonitorBinary::kHeader, &lateDst));
+      synced = true;
+    }
+  }
+  TEST_ASSERT_TRUE(synced);
+  assertSame(src, lateDst);
+}
+
+void test_malformed_and_unknown(void) {
+  Link l;
+  AppState src = sample(), dst;
+  TEST_ASSERT_TRUE(l.send(src, &dst));
+  const AppState before = dst;
+  const uint8_t bad[][8] = {
+      {0x00, 0x01, 0x00, 0x80},                /* varint cut short */
+      {0x00, 0x01, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, /* varint too long */
+      {0x01, 0x01, 0x00, 0x02, 0x86, 0x01},    /* keyframe cleared the dictionary: slot 0 unknown */
+      {0x00, 0x01, 0x87, 0x50},                /* define slot 16: out of range */
+      {0x00, 0x01, 0x87, 0x41, 0x05, 'a', 'b'}, /* text shorter than its length */
+      {0x00, 0x01, 0x87, 0x20},                /* reference to slot 32 */
+  };
+  const size_t lens[] = {4, 8, 6, 4, 7, 4};
+  for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+    TEST_ASSERT_FALSE(l.dec.decode(bad[i], lens[i], &dst));
+  TEST_ASSERT_FALSE(l.dec.decode(bad[0], 1, &dst));
+  TEST_ASSERT_EQUAL_UINT32(7, l.dec.errors());
+  TEST_ASSERT_EQUAL_INT(before.hw.ct, dst.hw.ct); /* the first field of the first bad frame */
+  assertSame(before, dst);
+
+  /* Fields a newer server sends: skipped by id range, the rest applies. */
+  const uint8_t newer[] = {0x00, 0x01, 0x7E, 0xAC, 0x02, 0xF0, 0x43, 0x02, 'h', 'i', 0x00, 0x0A, 0xF1, 0x04};
+  TEST_ASSERT_TRUE(l.dec.decode(newer, sizeof(newer), &dst));
+  TEST_ASSERT_EQUAL_INT(5, dst.hw.ct);
+  TEST_ASSERT_EQUAL_UINT32(3, l.dec.unknownFields());
+}
+
+static size_t readString(void *ctx, char *dst, size_t cap) {
+  std::string *s = (std::string *)ctx;
+  const size_t n = std::min(cap, std::min(s->size(), (size_t)97));
+  memcpy(dst, s->data(), n);
+  s->erase(0, n);
+  return n;
+}
+static uint32_t zeroClock() { return 0; }
+
+void test_framer_switches_to_frames(void) {
+  MonitorBinaryEncoder enc;
+  MonitorBinaryDecoder dec;
+  AppState src = sample(), dst;
+  uint8_t frame[MonitorBinary::kFrameMax];
+  std::string stream = "{\"ct\":1}\nBIN 1\n";
+  std::vector<int> sent;
+  for (int i = 0; i < 40; i++) {
+    src.hw.ct = 100 + i;
+    src.hw.nd = i * 37;
+    const size_t n = enc.encode(src, frame, sizeof(frame));
+    stream.append((const char *)frame, n);
+    if (i == 20)
+      stream += "garbage\n"; /* not a frame: cut out up to the next magic byte */
+    sent.push_back(src.hw.ct);
+  }
+  LineFramer f;
+  char *p;
+  size_t len;
+  std::vector<int> got;
+  while (!stream.empty())
+    if (f.pump(readString, &stream, zeroClock, 1000000))
+      while (f.takeLine(&p, &len)) {
+        TEST_ASSERT_TRUE(f.binary());
+        TEST_ASSERT_TRUE(dec.decode((const uint8_t *)p, len, &dst));
+        got.push_back(dst.hw.ct);
+      }
+  /* Every frame, in order: deltas cannot be skipped. The JSON line before the switch gives way. */
+  TEST_ASSERT_EQUAL_UINT(sent.size(), got.size());
+  TEST_ASSERT_EQUAL_INT_ARRAY(sent.data(), got.data(), sent.size());
+  TEST_ASSERT_EQUAL_UINT32(8, f.resyncBytes());
+  TEST_ASSERT_EQUAL_UINT32(0, dec.gaps());
+  assertSame(src, dst);
+  f.reset();
+  TEST_ASSERT_FALSE(f.binary());
+}
+
+/* What the PC server writes for the same state (key order and formatting as monitor.py). */
+static size_t toJson(const AppState &s, char *out, size_t cap) {
+  const HardwareData &h = s.hw;
+  int n = snprintf(out, cap,
+                   "{\"ct\":%d,\"gt\":%d,\"cl\":%d,\"gl\":%d,\"cc\":%d,\"pw\":%d,\"gh\":%d,\"gv\":%d,\"gclock\":%d,"
+                   "\"vclock\":%d,\"gtdp\":%d,\"ru\":%.1f,\"ra\":%.1f,\"nd\":%d,\"nu\":%d,\"pg\":%d,\"cf\":%d,"
+                   "\"s1\":%d,\"s2\":%d,\"gf\":%d,\"fans\":[%d,%d,%d,%d],\"fan_controls\":[%d,%d,%d,%d],\"hdd\":[",
+                   h.ct, h.gt, h.cl, h.gl, h.cc, h.pw, h.gh, h.gv, h.gclock, h.vclock, h.gtdp, h.ru, h.ra, h.nd,
+                   h.nu, h.pg, h.cf, h.s1, h.s2, h.gf, h.fans[0], h.fans[1], h.fans[2], h.fans[3],
+                   h.fan_controls[0], h.fan_controls[1], h.fan_controls[2], h.fan_controls[3]);
+  for (int i = 0; i < 2; i++)
+    n += snprintf(out + n, cap - n, "%s{\"n\":\"%c\",\"u\":%.1f,\"tot\":%.1f,\"t\":%d}", i ? "," : "",
+                  h.hdd[i].name[0], h.hdd[i].used_gb, h.hdd[i].total_gb, h.hdd[i].temp);
+  n += snprintf(out + n, cap - n,
+                "],\"vu\":%.1f,\"vt\":%.1f,\"ch\":%d,\"mb_sys\":%d,\"mb_vsoc\":%d,\"mb_vrm\":%d,\"mb_chipset\":%d,"
+                "\"dr\":%d,\"dw\":%d,\"wt\":%d,\"wd\":\"%s\",\"wi\":%d,\"tp\":[",
+                h.vu, h.vt, h.ch, h.mb_sys, h.mb_vsoc, h.mb_vrm, h.mb_chipset, h.dr, h.dw, s.weather.temp,
+                "\\u041e\\u0431\\u043b\\u0430\\u0447\\u043d\\u043e", s.weather.wmoCode);
+  for (int i = 0; i < 3; i++)
+    n += snprintf(out + n, cap - n, "%s{\"n\":\"%s\",\"c\":%d}", i ? "," : "", s.process.cpuNames[i].c_str(),
+                  s.process.cpuPercent[i]);
+  n += snprintf(out + n, cap - n, "],\"tr\":[");
+  for (int i = 0; i < 2; i++)
+    n += snprintf(out + n, cap - n, "%s{\"n\":\"%s\",\"r\":%d}", i ? "," : "", s.process.ramNames[i].c_str(),
+                  s.process.ramMb[i]);
+  n += snprintf(out + n, cap - n,
+                "],\"art\":\"%s\",\"trk\":\"%s\",\"mp\":%s,\"idle\":false,\"media_status\":\"%s\",\"alert\":\"OK\"}",
+                s.media.artist.c_str(), s.media.track.c_str(), s.media.isPlaying ? "true" : "false",
+                s.media.mediaStatus.c_str());
+  return (size_t)n;
+}
+
+/* One second per update: loads and clocks move every time, temperatures often, names now and then. */
+static void step(AppState &s, int t, uint32_t &rng) {
+  auto rnd = [&rng](int n) {
+    rng = rng * 1103515245u + 12345u;
+    return (int)((rng >> 16) % (uint32_t)n);
+  };
+  HardwareData &h = s.hw;
+  h.cl = 5 + rnd(60), h.gl = rnd(99), h.cc = 3600 + rnd(1200), h.gclock = 1400 + rnd(600);
+  h.pw = 40 + rnd(150), h.nd = rnd(20000), h.nu = rnd(3000), h.dr = rnd(400), h.dw = rnd(200);
+  h.ru = 10.0f + rnd(30) / 10.0f, h.ra = 32.0f - h.ru;
+  for (int i = 0; i < NOCT_FAN_COUNT; i++)
+    h.fans[i] = 800 + rnd(1800);
+  if (t % 3 == 0)
+    h.ct = 45 + rnd(30), h.gt = 40 + rnd(35), h.gh = h.gt + 8, h.ch = h.ct - 5;
+  if (t % 10 == 0)
+    h.mb_sys = 33 + rnd(5), h.mb_vrm = 45 + rnd(12), h.hdd[0].temp = 36 + rnd(4);
+  for (int i = 0; i < 3; i++)
+    s.process.cpuPercent[i] = 1 + rnd(25);
+  static const char *kProcs[] = {"chrome.exe", "Code.exe", "python.exe", "explorer.exe", "dwm.exe",
+                                 "Discord.exe", "steam.exe"};
+  if (t % 4 == 0)
+    for (int i = 0; i < 3; i++)
+      s.process.cpuNames[i] = kProcs[rnd(7)];
+  s.process.ramMb[0] = 2000 + rnd(600);
+  if (t % 180 == 0) {
+    char trk[32];
+    snprintf(trk, sizeof(trk), "Track %d", t / 180);
+    s.media.track = trk;
+  }
+}
+
+void test_session_bytes_and_decode_time(void) {
+  const int kUpdates = 3600;
+  AppState src = sample(), dstJson, dstBin;
+  MonitorBinaryEncoder enc;
+  MonitorBinaryDecoder dec;
+  MonitorDecoder json;
+  std::vector<std::string> lines, frames;
+  uint8_t frame[MonitorBinary::kFrameMax];
+  char line[NOCT_TCP_LINE_MAX];
+  size_t jsonBytes = 0, binBytes = 0;
+  uint32_t rng = 1;
+  for (int t = 0; t < kUpdates; t++) {
+    step(src, t, rng);
+    const size_t jn = toJson(src, line, sizeof(line));
+    lines.emplace_back(line, jn);
+    jsonBytes += jn + 1; /* newline */
+    const size_t bn = enc.encode(src, frame, sizeof(frame));
+    frames.emplace_back((const char *)frame, bn);
+    binBytes += bn;
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (const std::string &l : lines)
+    TEST_ASSERT_TRUE(json.decode(l.data(), l.size(), &dstJson));
+  const double jsonUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  t0 = std::chrono::steady_clock::now();
+  for (const std::string &f : frames)
+    TEST_ASSERT_TRUE(dec.decode((const uint8_t *)f.data() + MonitorBinary::kHeader, f.size() - MonitorBinary::kHeader,
+                                &dstBin));
+  const double binUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+
+  printf("  simulated session, %d updates (host):\n", kUpdates);
+  printf("    JSON lines:    %6.1f B/update, %5.2f us/update\n", (double)jsonBytes / kUpdates, jsonUs / kUpdates);
+  printf("    binary frames: %6.1f B/update, %5.2f us/update (%.1fx fewer bytes, %.1fx faster)\n",
+         (double)binBytes / kUpdates, binUs / kUpdates, (double)jsonBytes / binBytes, jsonUs / binUs);
+  assertSame(dstJson, dstBin);
+  TEST_ASSERT_TRUE(binBytes * 4 < jsonBytes);
+  TEST_ASSERT_TRUE(binUs < jsonUs);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip_and_deltas);
+  RUN_TEST(test_string_dictionary);
+  RUN_TEST(test_malformed_and_unknown);
+  RUN_TEST(test_framer_switches_to_frames);
+  RUN_TEST(test_session_bytes_and_decode_time);
+  return UNITY_END();
+}
@@ -0,0 +1,389 @@
+/*
+ * Host tests: monitor payload decoder (MonitorDecoder.cpp) — every field, defaults, escapes, malformed
+ * lines — and cost per payload (µs, heap allocations) for a typical and a NOCT_TCP_LINE_MAX line. With
+ * ArduinoJson available the old path (validate + parse, two JsonDocuments) is measured alongside.
+ * Run: pio test -e native -f native/test_monitor_decoder
+ */
+#include <unity.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include "MonitorDecoder.h"
+#include "nocturne/config.h"
+
+#if __has_include(<ArduinoJson.h>)
+#include <ArduinoJson.h>
+#define HAVE_ARDUINOJSON 1
+#else
+#define HAVE_ARDUINOJSON 0
+#endif
+
+/* ── Allocation counter: every malloc/calloc/realloc (String, JsonDocument, operator new) ── */
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void __libc_free(void *);
+static size_t s_allocs = 0;
+extern "C" void *malloc(size_t n) {
+  s_allocs++;
+  return __libc_malloc(n);
+}
+extern "C" void *calloc(size_t n, size_t m) {
+  s_allocs++;
+  return __libc_calloc(n, m);
+}
+extern "C" void *realloc(void *p, size_t n) {
+  s_allocs++;
+  return __libc_realloc(p, n);
+}
+extern "C" void free(void *p) { __libc_free(p); }
+void *operator new(size_t n) {
+  void *p = malloc(n);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* What the Python server sends on the main screen. */
+static const char kTypical[] =
+    "{\"ct\":54,\"gt\":61,\"cl\":23,\"gl\":41,\"cc\":4650,\"pw\":87,\"gh\":58,\"gv\":71,\"gclock\":1905,"
+    "\"vclock\":9501,\"gtdp\":163,\"ru\":11.4,\"ra\":20.6,\"nd\":1530,\"nu\":212,\"pg\":9,\"cf\":1210,"
+    "\"s1\":980,\"s2\":0,\"gf\":1440,\"fans\":[1210,2480,1440,860],\"fan_controls\":[45,80,52,30],"
+    "\"hdd\":[{\"n\":\"C\",\"u\":412.5,\"tot\":931.0,\"t\":38},{\"n\":\"D\",\"u\":1620.0,\"tot\":3726.0,\"t\":33}],"
+    "\"vu\":6.2,\"vt\":12.0,\"ch\":47,\"mb_sys\":36,\"mb_vsoc\":44,\"mb_vrm\":52,\"mb_chipset\":48,"
+    "\"dr\":120,\"dw\":38,\"wt\":7,\"wd\":\"\\u041e\\u0431\\u043b\\u0430\\u0447\\u043d\\u043e\",\"wi\":3,"
+    "\"tp\":[{\"n\":\"chrome.exe\",\"c\":12},{\"n\":\"Code.exe\",\"c\":6},{\"n\":\"python.exe\",\"c\":3}],"
+    "\"tr\":[{\"n\":\"chrome.exe\",\"r\":2350},{\"n\":\"Code.exe\",\"r\":1180}],"
+    "\"art\":\"Carpenter Brut\",\"trk\":\"Turbo Killer\",\"mp\":true,\"idle\":false,"
+    "\"media_status\":\"PLAYING\",\"alert\":\"OK\"}";
+
+static bool decode(MonitorDecoder &d, const char *s, AppState *st) { return d.decode(s, strlen(s), st); }
+
+/* kTypical grown to the line limit with fields the decoder does not know (a newer server). */
+static std::string maxLine() {
+  std::string s(kTypical, sizeof(kTypical) - 2);
+  for (int i = 0; s.size() < NOCT_TCP_LINE_MAX - 120; i++) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), ",\"x%d\":{\"a\":[%d,%d.5,\"pad-%d\"],\"b\":null}", i, i, i, i);
+    s += buf;
+  }
+  s += ",\"pad\":\"";
+  s.append(NOCT_TCP_LINE_MAX - 1 - s.size() - 2, 'z');
+  s += "\"}";
+  return s;
+}
+
+void test_full_payload(void) {
+  MonitorDecoder d;
+  AppState st;
+  TEST_ASSERT_TRUE(decode(d, kTypical, &st));
+  TEST_ASSERT_EQUAL_INT(54, st.hw.ct);
+  TEST_ASSERT_EQUAL_INT(4650, st.hw.cc);
+  TEST_ASSERT_EQUAL_INT(9501, st.hw.vclock);
+  TEST_ASSERT_EQUAL_FLOAT(11.4f, st.hw.ru);
+  TEST_ASSERT_EQUAL_FLOAT(20.6f, st.hw.ra);
+  TEST_ASSERT_EQUAL_INT(1530, st.hw.nd);
+  TEST_ASSERT_EQUAL_INT(1440, st.hw.gf);
+  TEST_ASSERT_EQUAL_INT(860, st.hw.fans[3]);
+  TEST_ASSERT_EQUAL_INT(80, st.hw.fan_controls[1]);
+  TEST_ASSERT_EQUAL_INT('D', st.hw.hdd[1].name[0]);
+  TEST_ASSERT_EQUAL_FLOAT(3726.0f, st.hw.hdd[1].total_gb);
+  TEST_ASSERT_EQUAL_INT(38, st.hw.hdd[0].temp);
+  TEST_ASSERT_EQUAL_INT('E', st.hw.hdd[2].name[0]); /* absent drives: letter by position, zeros */
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, st.hw.hdd[3].used_gb);
+  TEST_ASSERT_EQUAL_FLOAT(6.2f, st.hw.vu);
+  TEST_ASSERT_EQUAL_INT(52, st.hw.mb_vrm);
+  TEST_ASSERT_EQUAL_INT(38, st.hw.dw);
+  TEST_ASSERT_EQUAL_INT(7, st.weather.temp);
+  TEST_ASSERT_EQUAL_STRING("Облачно", st.weather.desc.c_str());
+  TEST_ASSERT_EQUAL_INT(3, st.weather.wmoCode);
+  TEST_ASSERT_TRUE(st.weatherReceived);
+  TEST_ASSERT_EQUAL_STRING("python.exe", st.process.cpuNames[2].c_str());
+  TEST_ASSERT_EQUAL_INT(6, st.process.cpuPercent[1]);
+  TEST_ASSERT_EQUAL_STRING("Code.exe", st.process.ramNames[1].c_str());
+  TEST_ASSERT_EQUAL_INT(2350, st.process.ramMb[0]);
+  TEST_ASSERT_EQUAL_STRING("Carpenter Brut", st.media.artist.c_str());
+  TEST_ASSERT_EQUAL_STRING("Turbo Killer", st.media.track.c_str());
+  TEST_ASSERT_TRUE(st.media.isPlaying);
+  TEST_ASSERT_FALSE(st.media.isIdle);
+  TEST_ASSERT_EQUAL_STRING("PLAYING", st.media.mediaStatus.c_str());
+  TEST_ASSERT_FALSE(st.alertActive);
+  TEST_ASSERT_EQUAL_UINT32(0, d.unknownKeys());
+}
+
+void test_absent_fields_reset_like_before(void) {
+  MonitorDecoder d;
+  AppState st;
+  TEST_ASSERT_TRUE(decode(d, kTypical, &st));
+  /* The old parser defaulted every absent field; weather only moves when "wt" is there. */
+  TEST_ASSERT_TRUE(decode(d, "{\"ct\":50,\"tp\":[{\"n\":\"a\"}],\"wt\":null,\"fans\":[1,2]}", &st));
+  TEST_ASSERT_EQUAL_INT(50, st.hw.ct);
+  TEST_ASSERT_EQUAL_INT(0, st.hw.gt);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, st.hw.ru);
+  TEST_ASSERT_EQUAL_INT(2, st.hw.fans[1]);
+  TEST_ASSERT_EQUAL_INT(0, st.hw.fans[2]);
+  TEST_ASSERT_EQUAL_INT('C', st.hw.hdd[0].name[0]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, st.hw.hdd[0].total_gb);
+  TEST_ASSERT_EQUAL_STRING("a", st.process.cpuNames[0].c_str());
+  TEST_ASSERT_EQUAL_INT(0, st.process.cpuPercent[0]);
+  TEST_ASSERT_EQUAL_STRING("", st.process.cpuNames[1].c_str());
+  TEST_ASSERT_EQUAL_STRING("", st.process.ramNames[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("", st.media.artist.c_str());
+  TEST_ASSERT_EQUAL_STRING("PAUSED", st.media.mediaStatus.c_str());
+  TEST_ASSERT_FALSE(st.media.isPlaying);
+  TEST_ASSERT_EQUAL_INT(7, st.weather.temp);
+  TEST_ASSERT_EQUAL_STRING("Облачно", st.weather.desc.c_str());
+
+  /* Wrong types keep the default; unknown keys of any shape are stepped over. */
+  TEST_ASSERT_TRUE(decode(d,
+                          "{\"ct\":\"hot\",\"gt\":null,\"cl\":12.9,\"gl\":-3e1,\"mp\":1,\"art\":42,"
+                          "\"zz\":[{\"a\":[1,{\"b\":\"}\"}]}],\"c\":true,\"tp\":{\"n\":\"x\"},"
+                          "\"hdd\":[7,{\"n\":\"\",\"u\":1}],\"fans\":[1,2,3,4,5,6]}",
+                          &st));
+  TEST_ASSERT_EQUAL_INT(0, st.hw.ct);
+  TEST_ASSERT_EQUAL_INT(0, st.hw.gt);
+  TEST_ASSERT_EQUAL_INT(12, st.hw.cl);
+  TEST_ASSERT_EQUAL_INT(-30, st.hw.gl);
+  TEST_ASSERT_TRUE(st.media.isPlaying);
+  TEST_ASSERT_EQUAL_STRING("", st.media.artist.c_str());
+  TEST_ASSERT_EQUAL_STRING("", st.process.cpuNames[0].c_str());
+  TEST_ASSERT_EQUAL_INT('C', st.hw.hdd[0].name[0]);
+  TEST_ASSERT_EQUAL_INT('D', st.hw.hdd[1].name[0]);
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, st.hw.hdd[1].used_gb);
+  TEST_ASSERT_EQUAL_INT(4, st.hw.fans[3]);
+  TEST_ASSERT_EQUAL_UINT32(2, d.unknownKeys());
+}
+
+void test_strings_escapes_and_truncation(void) {
+  MonitorDecoder d;
+  AppState st;
+  TEST_ASSERT_TRUE(decode(d, "{\"art\":\"a\\\"b\\\\c\\/d\\te\",\"trk\":\"\\ud83c\\udfb5 \\u00e9\\ud800x\"}", &st));
+  TEST_ASSERT_EQUAL_STRING("a\"b\\c/d\te", st.media.artist.c_str());
+  TEST_ASSERT_EQUAL_STRING("\xF0\x9F\x8E\xB5 \xC3\xA9\xEF\xBF\xBDx", st.media.track.c_str());
+
+  /* 62 ASCII + a 2-byte letter does not fit 63 bytes: the letter goes whole. */
+  std::string line = "{\"art\":\"" + std::string(62, 'a') + "\\u00e9\",\"tp\":[{\"n\":\"";
+  line += std::string(30, 'p') + "\"}]}";
+  TEST_ASSERT_TRUE(decode(d, line.c_str(), &st));
+  TEST_ASSERT_EQUAL_UINT(62, st.media.artist.length());
+  TEST_ASSERT_EQUAL_UINT(MonitorDecoder::kNameMax - 1, st.process.cpuNames[0].length());
+  line = "{\"art\":\"" + std::string(61, 'a') + "\\u00e9\"}";
+  TEST_ASSERT_TRUE(decode(d, line.c_str(), &st));
+  TEST_ASSERT_EQUAL_UINT(63, st.media.artist.length());
+}
+
+void test_malformed_line_leaves_state(void) {
+  MonitorDecoder d;
+  AppState st;
+  TEST_ASSERT_TRUE(decode(d, kTypical, &st));
+  const char *bad[] = {
+      "",
+      "[1,2]",
+      "{\"ct\":1",
+      "{\"ct\":1,}",
+      "{\"ct\":1} x",
+      "{\"ct\":01x}",
+      "{\"ct\":-}",
+      "{\"art\":\"abc}",
+      "{\"art\":\"\\q\"}",
+      "{\"art\":\"\\u12G4\"}",
+      "{\"zz\":tru}",
+      "{\"zz\":[[[[[[[[[[[1]]]]]]]]]]]}",
+      "{\"ct\" 1}",
+      "{ct:1}",
+  };
+  /* Cut anywhere: every prefix of a real line is rejected. */
+  for (size_t n = 1; n < sizeof(kTypical) - 1; n += 7)
+    TEST_ASSERT_FALSE(d.decode(kTypical, n, &st));
+  for (const char *b : bad)
+    TEST_ASSERT_TRUE_MESSAGE(!decode(d, b, &st), b);
+  TEST_ASSERT_EQUAL_INT(54, st.hw.ct);
+  TEST_ASSERT_EQUAL_STRING("Turbo Killer", st.media.track.c_str());
+  TEST_ASSERT_EQUAL_UINT32(d.lines() - 1, d.errors());
+  TEST_ASSERT_TRUE(decode(d, " {\"zz\":[[[[[[[[[1]]]]]]]]]} \r", &st));
+  TEST_ASSERT_EQUAL_INT(0, st.hw.ct);
+}
+
+void test_alert_mapping(void) {
+  MonitorDecoder d;
+  AppState st;
+  TEST_ASSERT_TRUE(decode(d, "{\"alert\":\"CRITICAL\",\"target_screen\":\"GPU\",\"alert_metric\":\"gt\"}", &st));
+  TEST_ASSERT_TRUE(st.alertActive);
+  TEST_ASSERT_EQUAL_INT(NOCT_SCENE_GPU, st.alertTargetScene);
+  TEST_ASSERT_EQUAL_INT(NOCT_ALERT_GT, st.alertMetric);
+  /* Absent target and metric keep the previous ones, unknown ones fall back. */
+  TEST_ASSERT_TRUE(decode(d, "{\"alert\":\"CRITICAL\"}", &st));
+  TEST_ASSERT_EQUAL_INT(NOCT_SCENE_GPU, st.alertTargetScene);
+  TEST_ASSERT_EQUAL_INT(NOCT_ALERT_GT, st.alertMetric);
+  TEST_ASSERT_TRUE(decode(d, "{\"alert_metric\":\"vram\",\"target_screen\":\"NOPE\",\"alert\":\"CRITICAL\"}", &st));
+  TEST_ASSERT_EQUAL_INT(NOCT_SCENE_MAIN, st.alertTargetScene);
+  TEST_ASSERT_EQUAL_INT(-1, st.alertMetric);
+  TEST_ASSERT_TRUE(decode(d, "{\"alert\":\"CRITICAL\",\"target_screen\":\"MOTHERBOARD\",\"alert_metric\":\"ram\"}", &st));
+  TEST_ASSERT_EQUAL_INT(NOCT_SCENE_MOTHERBOARD, st.alertTargetScene);
+  TEST_ASSERT_EQUAL_INT(NOCT_ALERT_RAM, st.alertMetric);
+  TEST_ASSERT_TRUE(decode(d, "{\"alert\":\"WARN\",\"target_screen\":\"GPU\",\"alert_metric\":\"gt\"}", &st));
+  TEST_ASSERT_FALSE(st.alertActive);
+  TEST_ASSERT_EQUAL_INT(NOCT_SCENE_MAIN, st.alertTargetScene);
+  TEST_ASSERT_EQUAL_INT(-1, st.alertMetric);
+}
+
+#if HAVE_ARDUINOJSON
+/* The path main.cpp + NetManager::parsePayload took before: validate, then parse again and copy. */
+static bool legacyParse(const char *line, size_t len, AppState *state) {
+  {
+    JsonDocument check;
+    if (deserializeJson(check, line, len))
+      return false;
+  }
+  JsonDocument doc;
+  if (deserializeJson(doc, line, len))
+    return false;
+  HardwareData &hw = state->hw;
+  hw.ct = doc["ct"] | 0;
+  hw.gt = doc["gt"] | 0;
+  hw.cl = doc["cl"] | 0;
+  hw.gl = doc["gl"] | 0;
+  hw.cc = doc["cc"] | 0;
+  hw.pw = doc["pw"] | 0;
+  hw.gh = doc["gh"] | 0;
+  hw.gv = doc["gv"] | 0;
+  hw.gclock = doc["gclock"] | 0;
+  hw.vclock = doc["vclock"] | 0;
+  hw.gtdp = doc["gtdp"] | 0;
+  hw.ru = doc["ru"] | 0.0f;
+  hw.ra = doc["ra"] | 0.0f;
+  hw.nd = doc["nd"] | 0;
+  hw.nu = doc["nu"] | 0;
+  hw.pg = doc["pg"] | 0;
+  hw.cf = doc["cf"] | 0;
+  hw.s1 = doc["s1"] | 0;
+  hw.s2 = doc["s2"] | 0;
+  hw.gf = doc["gf"] | 0;
+  JsonArray fans = doc["fans"];
+  for (int i = 0; i < NOCT_FAN_COUNT && i < (int)fans.size(); i++)
+    hw.fans[i] = fans[i] | 0;
+  JsonArray fanControls = doc["fan_controls"];
+  for (int i = 0; i < NOCT_FAN_COUNT && i < (int)fanControls.size(); i++)
+    hw.fan_controls[i] = fanControls[i] | 0;
+  JsonArray hdd = doc["hdd"];
+  for (int i = 0; i < NOCT_HDD_COUNT; i++) {
+    const char *n = i < (int)hdd.size() ? (const char *)hdd[i]["n"] : nullptr;
+    hw.hdd[i].name[0] = n && n[0] ? n[0] : (char)('C' + i);
+    hw.hdd[i].used_gb = i < (int)hdd.size() ? (hdd[i]["u"] | 0.0f) : 0.0f;
+    hw.hdd[i].total_gb = i < (int)hdd.size() ? (hdd[i]["tot"] | 0.0f) : 0.0f;
+    hw.hdd[i].temp = i < (int)hdd.size() ? (hdd[i]["t"] | 0) : 0;
+  }
+  hw.vu = doc["vu"] | 0.0f;
+  hw.vt = doc["vt"] | 0.0f;
+  hw.ch = doc["ch"] | 0;
+  hw.mb_sys = doc["mb_sys"] | 0;
+  hw.mb_vsoc = doc["mb_vsoc"] | 0;
+  hw.mb_vrm = doc["mb_vrm"] | 0;
+  hw.mb_chipset = doc["mb_chipset"] | 0;
+  hw.dr = doc["dr"] | 0;
+  hw.dw = doc["dw"] | 0;
+  if (!doc["wt"].isNull()) {
+    state->weather.temp = doc["wt"] | 0;
+    const char *wd = doc["wd"];
+    state->weather.desc = String(wd ? wd : "");
+    state->weather.wmoCode = doc["wi"] | 0;
+  }
+  JsonArray tp = doc["tp"];
+  for (int i = 0; i < 3; i++) {
+    const char *n = i < (int)tp.size() ? (const char *)tp[i]["n"] : nullptr;
+    state->process.cpuNames[i] = String(n ? n : "");
+    state->process.cpuPercent[i] = i < (int)tp.size() ? (tp[i]["c"] | 0) : 0;
+  }
+  JsonArray tr = doc["tr"];
+  for (int i = 0; i < 2; i++) {
+    const char *n = i < (int)tr.size() ? (const char *)tr[i]["n"] : nullptr;
+    state->process.ramNames[i] = String(n ? n : "");
+    state->process.ramMb[i] = i < (int)tr.size() ? (tr[i]["r"] | 0) : 0;
+  }
+  const char *art = doc["art"];
+  const char *trk = doc["trk"];
+  state->media.artist = String(art ? art : "");
+  state->media.track = String(trk ? trk : "");
+  state->media.isPlaying = doc["mp"] | false;
+  state->media.isIdle = doc["idle"] | false;
+  const char *ms = doc["media_status"];
+  state->media.mediaStatus = String(ms && strcmp(ms, "PLAYING") == 0 ? "PLAYING" : "PAUSED");
+  const char *alert = doc["alert"];
+  state->alertActive = alert && strcmp(alert, "CRITICAL") == 0;
+  return true;
+}
+#endif
+
+struct Cost {
+  double us;
+  double allocs;
+};
+
+template <typename F>
+static Cost measure(const char *line, size_t len, F parse) {
+  const int kIter = 20000;
+  AppState st;
+  parse(line, len, &st); /* warm: Strings hold the current texts */
+  const size_t a0 = s_allocs;
+  const auto t0 = std::chrono::steady_clock::now();
+  int ok = 0;
+  for (int i = 0; i < kIter; i++)
+    ok += parse(line, len, &st) ? 1 : 0;
+  const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  TEST_ASSERT_EQUAL_INT(kIter, ok);
+  return {us / kIter, (double)(s_allocs - a0) / kIter};
+}
+
+void test_cost_per_payload(void) {
+  const std::string big = maxLine();
+  TEST_ASSERT_EQUAL_UINT(NOCT_TCP_LINE_MAX - 1, big.size()); /* NetManager keeps at most this much */
+  MonitorDecoder d;
+  auto single = [&d](const char *l, size_t n, AppState *st) { return d.decode(l, n, st); };
+  const Cost typ = measure(kTypical, sizeof(kTypical) - 1, single);
+  const Cost max = measure(big.c_str(), big.size(), single);
+
+  printf("  cost per payload (host):\n");
+  printf("    single pass, typical %4u B: %7.2f us, %.2f allocs\n", (unsigned)sizeof(kTypical) - 1, typ.us,
+         typ.allocs);
+  printf("    single pass, max     %4u B: %7.2f us, %.2f allocs\n", (unsigned)big.size(), max.us, max.allocs);
+#if HAVE_ARDUINOJSON
+  const Cost ltyp = measure(kTypical, sizeof(kTypical) - 1, legacyParse);
+  const Cost lmax = measure(big.c_str(), big.size(), legacyParse);
+  printf("    ArduinoJson x2, typical:    %7.2f us, %.2f allocs (x%.1f)\n", ltyp.us, ltyp.allocs, ltyp.us / typ.us);
+  printf("    ArduinoJson x2, max:        %7.2f us, %.2f allocs (x%.1f)\n", lmax.us, lmax.allocs, lmax.us / max.us);
+  TEST_ASSERT_TRUE(typ.us < ltyp.us);
+#else
+  printf("    (ArduinoJson not installed: old double-parse path not measured)\n");
+#endif
+  /* Same texts every line: nothing to allocate. A changed track costs at most its own String. */
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, (float)typ.allocs);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, (float)max.allocs);
+  AppState st;
+  TEST_ASSERT_TRUE(d.decode(kTypical, sizeof(kTypical) - 1, &st));
+  std::string next(kTypical);
+  next.replace(next.find("Turbo Killer"), 12, "Roller Mobster");
+  const size_t a0 = s_allocs;
+  TEST_ASSERT_TRUE(d.decode(next.c_str(), next.size(), &st));
+  TEST_ASSERT_TRUE(s_allocs - a0 <= 1);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_full_payload);
+  RUN_TEST(test_absent_fields_reset_like_before);
+  RUN_TEST(test_strings_escapes_and_truncation);
+  RUN_TEST(test_malformed_line_leaves_state);
+  RUN_TEST(test_alert_mapping);
+  RUN_TEST(test_cost_per_payload);
+  return UNITY_END();
+}
@@ -0,0 +1,201 @@
+/*
+ * Host tests: several monitor servers (MonitorHosts.cpp) — host list parsing, per-host status, signal loss
+ * and load history, the overview across hosts (worst temperatures, highest loads, lost hosts left out),
+ * selection and rotation, alerts on other hosts, and what the overview scene subscribes to and redraws on.
+ * Run: pio test -e native -f native/test_monitor_hosts
+ */
+#include <unity.h>
+#include <cstring>
+#include "MonitorHosts.h"
+#include "MonitorSubscription.h"
+#include "RedrawGate.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static MonitorSnapshot live(uint32_t updates, uint32_t nowMs, int ct, int gt, int cl, int gl) {
+  MonitorSnapshot s;
+  s.wifi = true;
+  s.tcp = true;
+  s.firstData = true;
+  s.tcpConnectMs = 1;
+  s.lastDataMs = nowMs;
+  s.updates = updates;
+  s.state.hw.ct = ct;
+  s.state.hw.gt = gt;
+  s.state.hw.cl = cl;
+  s.state.hw.gl = gl;
+  return s;
+}
+
+void test_parse_host_list(void) {
+  HostAddr h[4];
+  TEST_ASSERT_EQUAL_INT(3, MonitorHosts::parse("desk=192.168.1.2:8888, 10.0.0.7:9000 ,workstation1=10.0.0.8:1", h, 4));
+  TEST_ASSERT_EQUAL_STRING("desk", h[0].name);
+  TEST_ASSERT_EQUAL_STRING("192.168.1.2", h[0].ip);
+  TEST_ASSERT_EQUAL_UINT16(8888, h[0].port);
+  TEST_ASSERT_EQUAL_STRING("PC2", h[1].name); /* no name: its position */
+  TEST_ASSERT_EQUAL_STRING("10.0.0.7", h[1].ip);
+  TEST_ASSERT_EQUAL_UINT16(9000, h[1].port);
+  TEST_ASSERT_EQUAL_STRING("worksta", h[2].name); /* what a row shows */
+  TEST_ASSERT_EQUAL_UINT16(1, h[2].port);
+
+  /* Past max: dropped, not an error. */
+  TEST_ASSERT_EQUAL_INT(2, MonitorHosts::parse("a=1.2.3.4:1,b=1.2.3.5:2,c=1.2.3.6:3", h, 2));
+  TEST_ASSERT_EQUAL_INT(0, MonitorHosts::parse("", h, 4));
+  TEST_ASSERT_EQUAL_INT(0, MonitorHosts::parse("  ", h, 4));
+
+  static const char *const kBad[] = {
+      "desk=192.168.1.2",       /* no port */
+      "desk=192.168.1.2:",      /* empty port */
+      "desk=192.168.1.2:0",     /* port 0 */
+      "desk=192.168.1.2:65536", /* port too big */
+      "desk=192.168.1.2:88x",   /* not a number */
+      "desk=pc.local:8888",     /* not an address */
+      "desk=192.168.1:8888",    /* three parts */
+      "desk=1.2.3.4:1,,nas=1.2.3.5:2", /* empty entry */
+      "desk=1.2.3.4:1,",        /* trailing comma */
+  };
+  for (const char *spec : kBad)
+    TEST_ASSERT_EQUAL_INT_MESSAGE(-1, MonitorHosts::parse(spec, h, 4), spec);
+  TEST_ASSERT_EQUAL_INT(-1, MonitorHosts::parse(nullptr, h, 4));
+}
+
+void test_slots_status_and_history(void) {
+  MonitorHosts hosts;
+  TEST_ASSERT_EQUAL_INT(0, hosts.count());
+  TEST_ASSERT_EQUAL_STRING("", hosts.host(0).name); /* an empty slot, never out of range */
+  for (int i = 0; i < MonitorHosts::kMax; i++)
+    TEST_ASSERT_TRUE(hosts.add(i == 0 ? "desk" : nullptr));
+  TEST_ASSERT_FALSE(hosts.add("extra"));
+  TEST_ASSERT_EQUAL_INT(MonitorHosts::kMax, hosts.count());
+  TEST_ASSERT_EQUAL_STRING("desk", hosts.host(0).name);
+  TEST_ASSERT_EQUAL_STRING("PC2", hosts.host(1).name);
+  hosts.takeChanged();
+
+  /* Status only: no history sample. */
+  MonitorSnapshot s;
+  s.wifi = true;
+  s.tcp = true;
+  s.tcpConnectMs = 1000;
+  TEST_ASSERT_FALSE(hosts.update(0, s));
+  TEST_ASSERT_TRUE(hosts.takeChanged());
+  TEST_ASSERT_TRUE(hosts.host(0).linkUp());
+  TEST_ASSERT_EQUAL_UINT8(0, hosts.host(0).count);
+  TEST_ASSERT_FALSE(hosts.host(0).signalLost(1000 + NOCT_SIGNAL_GRACE_MS - 1)); /* still in grace */
+  TEST_ASSERT_TRUE(hosts.host(0).signalLost(1000 + NOCT_SIGNAL_GRACE_MS + 1));  /* never any data */
+
+  /* One sample per new update, clamped; the same update twice adds nothing. */
+  for (uint32_t u = 1; u <= HostSlot::kHistory + 5; u++) {
+    MonitorSnapshot d = live(u, 2000 + u * 100, 60, 70, (int)u, 200);
+    d.state.hw.nd = 70000;
+    d.state.hw.nu = (int)u;
+    TEST_ASSERT_TRUE(hosts.update(0, d));
+    TEST_ASSERT_FALSE(hosts.update(0, d));
+  }
+  const HostSlot &h = hosts.host(0);
+  TEST_ASSERT_EQUAL_UINT8(HostSlot::kHistory, h.count);
+  TEST_ASSERT_EQUAL_INT(HostSlot::kHistory + 5, h.cpuAt(0)); /* newest */
+  TEST_ASSERT_EQUAL_INT(6, h.cpuAt(HostSlot::kHistory - 1)); /* oldest kept */
+  TEST_ASSERT_EQUAL_INT(100, h.gpuAt(0));
+  TEST_ASSERT_EQUAL_INT(65535, h.netDownAt(3));
+  TEST_ASSERT_EQUAL_INT(HostSlot::kHistory + 4, h.netUpAt(1));
+
+  /* Loss by time since the last data; a snapshot a little ahead of the loop's clock is not lost. */
+  const uint32_t last = h.lastDataMs;
+  TEST_ASSERT_FALSE(h.signalLost(last - 50));
+  TEST_ASSERT_FALSE(h.signalLost(last + NOCT_SIGNAL_TIMEOUT_MS));
+  TEST_ASSERT_TRUE(h.signalLost(last + NOCT_SIGNAL_TIMEOUT_MS + 1));
+
+  /* Another host's slot is untouched. */
+  TEST_ASSERT_EQUAL_UINT8(0, hosts.host(1).count);
+  TEST_ASSERT_FALSE(hosts.update(-1, s));
+  TEST_ASSERT_FALSE(hosts.update(MonitorHosts::kMax, s));
+}
+
+void test_overview_and_alerts(void) {
+  MonitorHosts hosts;
+  hosts.add("desk");
+  hosts.add("nas");
+  hosts.add("render");
+  const uint32_t now = 50000;
+
+  HostOverview o = hosts.overview(now);
+  TEST_ASSERT_EQUAL_INT(3, o.hosts);
+  TEST_ASSERT_EQUAL_INT(0, o.live);
+  TEST_ASSERT_EQUAL_INT(-1, o.cpuTempHost);
+  TEST_ASSERT_EQUAL_INT(-1, o.gpuLoadHost);
+
+  hosts.update(0, live(1, now, 55, 60, 20, 90));
+  hosts.update(1, live(1, now, 71, 40, 85, 0));
+  /* Hottest of all, but its data stopped: not in the overview. */
+  hosts.update(2, live(1, now - NOCT_SIGNAL_TIMEOUT_MS - 100, 99, 99, 100, 100));
+  o = hosts.overview(now);
+  TEST_ASSERT_EQUAL_INT(2, o.live);
+  TEST_ASSERT_EQUAL_INT(71, o.cpuTemp);
+  TEST_ASSERT_EQUAL_INT(1, o.cpuTempHost);
+  TEST_ASSERT_EQUAL_INT(60, o.gpuTemp);
+  TEST_ASSERT_EQUAL_INT(0, o.gpuTempHost);
+  TEST_ASSERT_EQUAL_INT(85, o.cpuLoad);
+  TEST_ASSERT_EQUAL_INT(1, o.cpuLoadHost);
+  TEST_ASSERT_EQUAL_INT(90, o.gpuLoad);
+  TEST_ASSERT_EQUAL_INT(0, o.gpuLoadHost);
+
+  /* Back with fresh data: counts again. */
+  hosts.takeChanged();
+  hosts.update(2, live(2, now, 80, 45, 10, 10));
+  TEST_ASSERT_TRUE(hosts.takeChanged());
+  o = hosts.overview(now);
+  TEST_ASSERT_EQUAL_INT(3, o.live);
+  TEST_ASSERT_EQUAL_INT(80, o.cpuTemp);
+  TEST_ASSERT_EQUAL_INT(2, o.cpuTempHost);
+  /* Same values again: nothing for the overview to redraw. */
+  hosts.update(2, live(3, now, 80, 45, 10, 10));
+  TEST_ASSERT_FALSE(hosts.takeChanged());
+
+  /* Selection and rotation. */
+  TEST_ASSERT_EQUAL_INT(0, hosts.selected());
+  TEST_ASSERT_EQUAL_INT(1, hosts.next());
+  TEST_ASSERT_FALSE(hosts.select(0)); /* already */
+  TEST_ASSERT_FALSE(hosts.select(3));
+  TEST_ASSERT_TRUE(hosts.select(2));
+  TEST_ASSERT_EQUAL_INT(0, hosts.next());
+
+  /* An alert elsewhere is reported; on the selected host it is the loop's own. */
+  TEST_ASSERT_EQUAL_INT(-1, hosts.alerting());
+  MonitorSnapshot a = live(2, now, 90, 40, 85, 0);
+  a.state.alertActive = true;
+  hosts.update(1, a);
+  TEST_ASSERT_EQUAL_INT(1, hosts.alerting());
+  hosts.select(1);
+  TEST_ASSERT_EQUAL_INT(-1, hosts.alerting());
+}
+
+void test_overview_scene_fields(void) {
+  /* Every host that is not selected runs on this set: the overview's values plus the net graphs. */
+  MonitorSubscription sub;
+  sub.forScene(NOCT_SCENE_HOSTS, NOCT_SCENE_HOSTS);
+  const FieldMask want = fieldBit(SF_CT) | fieldBit(SF_GT) | fieldBit(SF_CL) | fieldBit(SF_GL) |
+                         fieldBit(SF_ND) | fieldBit(SF_NU) | fieldBit(SF_ALERT);
+  TEST_ASSERT_TRUE(sub.fields() == want);
+  TEST_ASSERT_EQUAL_UINT32(500, sub.period(SF_CL));
+  TEST_ASSERT_EQUAL_UINT32(1000, sub.period(SF_CT));
+
+  /* The scene draws the selected host's values, not its net rates. */
+  const FieldMask f = RedrawGate::sceneFields(NOCT_SCENE_HOSTS);
+  TEST_ASSERT_TRUE((f & fieldBit(SF_CL)) != 0);
+  TEST_ASSERT_TRUE((f & fieldBit(SF_GT)) != 0);
+  TEST_ASSERT_TRUE((f & fieldBit(SF_ND)) == 0);
+  TEST_ASSERT_TRUE((f & fieldBit(SF_WEATHER)) == 0);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_host_list);
+  RUN_TEST(test_slots_status_and_history);
+  RUN_TEST(test_overview_and_alerts);
+  RUN_TEST(test_overview_scene_fields);
+  return UNITY_END();
+}
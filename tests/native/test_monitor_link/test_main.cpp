@@ -0,0 +1,282 @@
+/*
+ * Host tests: the monitor link's network side (MonitorLink.cpp, MonitorTcp.cpp, TcpStream.cpp,
+ * TripleBuffer.h) — triple buffer hand-off (newest wins, never torn under a writer thread), non-blocking
+ * connect to a refused and a blackholed server, and a loopback session: HELO, screen and subscription,
+ * full and partial lines, changes carried over a snapshot the reader missed, parse counters and line
+ * numbers, peer close and a disconnect request.
+ * Run: pio test -e native -f native/test_monitor_link
+ */
+#include <unity.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include "MonitorLink.h"
+#include "MonitorTcp.h"
+#include "TripleBuffer.h"
+#include "../TcpTestUtil.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static std::string recvAll(int fd) {
+  std::string out;
+  char buf[512];
+  ssize_t n;
+  while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+    out.append(buf, (size_t)n);
+  return out;
+}
+
+static void sendStr(int fd, const std::string &s) {
+  TEST_ASSERT_EQUAL_INT((int)s.size(), (int)send(fd, s.data(), s.size(), MSG_NOSIGNAL));
+}
+
+void test_triple_buffer_handoff(void) {
+  TripleBuffer<int> tb;
+  TEST_ASSERT_FALSE(tb.take());
+  TEST_ASSERT_FALSE(tb.pending());
+  tb.back() = 1;
+  TEST_ASSERT_FALSE(tb.publish());
+  TEST_ASSERT_TRUE(tb.pending());
+  TEST_ASSERT_TRUE(tb.take());
+  TEST_ASSERT_EQUAL_INT(1, tb.front());
+  TEST_ASSERT_FALSE(tb.pending());
+  TEST_ASSERT_FALSE(tb.take());
+  TEST_ASSERT_EQUAL_INT(1, tb.front());
+  /* Two publishes before a take: the reader gets the newest, the older one was replaced. */
+  tb.back() = 2;
+  tb.publish();
+  tb.back() = 3;
+  TEST_ASSERT_TRUE(tb.publish());
+  TEST_ASSERT_EQUAL_UINT32(1, tb.replaced());
+  TEST_ASSERT_EQUAL_INT(1, tb.front()); /* until the next take */
+  TEST_ASSERT_TRUE(tb.take());
+  TEST_ASSERT_EQUAL_INT(3, tb.front());
+  TEST_ASSERT_FALSE(tb.take());
+}
+
+/* A value that shows tearing: every word carries the sequence number. */
+struct Wide {
+  uint32_t seq = 0;
+  uint32_t words[256] = {};
+};
+
+void test_triple_buffer_threads_never_tear(void) {
+  TripleBuffer<Wide> tb;
+  const uint32_t kCount = 200000;
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (uint32_t i = 1; i <= kCount; i++) {
+      Wide &w = tb.back();
+      w.seq = i;
+      for (uint32_t &x : w.words)
+        x = i;
+      tb.publish();
+    }
+    done.store(true);
+  });
+  uint32_t last = 0, taken = 0, torn = 0, backwards = 0;
+  for (;;) {
+    const bool finished = done.load();
+    if (tb.take()) {
+      const Wide &w = tb.front();
+      for (uint32_t x : w.words)
+        if (x != w.seq)
+          torn++;
+      if (w.seq <= last)
+        backwards++;
+      last = w.seq;
+      taken++;
+    } else if (finished) {
+      break;
+    }
+  }
+  writer.join();
+  printf("  %u published, %u taken, %u replaced, last %u\n", (unsigned)kCount, (unsigned)taken,
+         (unsigned)tb.replaced(), (unsigned)last);
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_EQUAL_UINT32(0, backwards);
+  TEST_ASSERT_EQUAL_UINT32(kCount, last);
+  TEST_ASSERT_EQUAL_UINT32(kCount, taken + tb.replaced());
+}
+
+void test_connect_never_blocks(void) {
+  s_pollMaxUs = 0;
+  /* Refused: a port nobody listens on. Fails at once, retried after kRetryMs. */
+  uint16_t closedPort;
+  {
+    Listener gone;
+    closedPort = gone.port;
+  }
+  MonitorTcp refused;
+  TEST_ASSERT_FALSE(refused.setServer("999.1.1.1", closedPort));
+  TEST_ASSERT_TRUE(refused.setServer("127.0.0.1", closedPort));
+  uint32_t now = 1000;
+  for (int i = 0; i < 20 && refused.failures() == 0; i++, now++) {
+    timedPoll(refused, now);
+    usleep(500);
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, refused.failures());
+  TEST_ASSERT_FALSE(refused.connecting());
+  timedPoll(refused, now + MonitorTcp::kRetryMs / 2);
+  TEST_ASSERT_FALSE(refused.connecting());
+  TEST_ASSERT_EQUAL_UINT32(1, refused.failures());
+
+  /* Blackholed: the connect stays pending until the timeout; no poll waits for it. */
+  Listener hole(true);
+  MonitorTcp t;
+  TEST_ASSERT_TRUE(t.setServer("127.0.0.1", hole.port));
+  now = 1000;
+  timedPoll(t, now);
+  TEST_ASSERT_TRUE(t.connecting());
+  for (uint32_t ms = 0; ms < MonitorTcp::kConnectTimeoutMs - 1; ms += 250)
+    timedPoll(t, now + ms);
+  TEST_ASSERT_TRUE(t.connecting());
+  timedPoll(t, now + MonitorTcp::kConnectTimeoutMs);
+  TEST_ASSERT_FALSE(t.connecting());
+  TEST_ASSERT_EQUAL_UINT32(1, t.failures());
+  TEST_ASSERT_EQUAL_UINT32(0, t.connects());
+  printf("  slowest poll: %.0f us\n", s_pollMaxUs);
+  TEST_ASSERT_TRUE(s_pollMaxUs < 5000);
+}
+
+/** Service the link until cond() (real time: loopback needs a few ms), at most ~1 s. */
+template <typename Cond>
+static bool serviceUntil(MonitorLink &link, uint32_t &now, Cond cond) {
+  for (int i = 0; i < 500; i++) {
+    link.service(now, true, -50);
+    if (cond())
+      return true;
+    link.wait(2);
+    now += 2;
+  }
+  return false;
+}
+
+void test_link_session(void) {
+  Listener l;
+  MonitorLink link;
+  TEST_ASSERT_TRUE(link.setServer("127.0.0.1", l.port));
+  uint32_t now = 5000;
+  /* Inactive: nothing is opened, the status still goes out. */
+  TEST_ASSERT_TRUE(link.service(now, true, -50));
+  TEST_ASSERT_TRUE(link.take());
+  TEST_ASSERT_TRUE(link.snapshot().wifi);
+  TEST_ASSERT_FALSE(link.snapshot().tcp);
+  TEST_ASSERT_EQUAL_INT(-50, link.snapshot().rssi);
+  TEST_ASSERT_FALSE(link.service(now, true, -50)); /* nothing changed */
+
+  link.setActive(true);
+  link.setScreen(1, 2);
+  int srv = -1;
+  TEST_ASSERT_TRUE(serviceUntil(link, now, [&] {
+    if (srv < 0)
+      srv = l.accept();
+    return srv >= 0 && link.tcp().connected();
+  }));
+  std::string rx;
+  TEST_ASSERT_TRUE(serviceUntil(link, now, [&] {
+    rx += recvAll(srv);
+    return rx.find("sub:") != std::string::npos && rx.back() == '\n';
+  }));
+  TEST_ASSERT_EQUAL_INT(0, (int)rx.find(NOCT_MONITOR_BINARY ? "HELO bin=1\nscreen:1\n" : "HELO\nscreen:1\n"));
+  TEST_ASSERT_TRUE(link.take());
+  TEST_ASSERT_TRUE(link.snapshot().tcp);
+  TEST_ASSERT_FALSE(link.snapshot().firstData);
+
+  /* A full line, then a partial one: the snapshot holds both, the second on top of the first. */
+  sendStr(srv, "{\"ct\":55,\"gt\":61,\"cl\":20}\n");
+  TEST_ASSERT_TRUE(serviceUntil(link, now, [&] { return link.take() && link.snapshot().updates == 1; }));
+  TEST_ASSERT_EQUAL_INT(55, link.snapshot().state.hw.ct);
+  TEST_ASSERT_TRUE(link.snapshot().changed & fieldBit(SF_CT));
+  TEST_ASSERT_TRUE(link.snapshot().firstData);
+  TEST_ASSERT_EQUAL_UINT32(now, link.snapshot().lastDataMs);
+
+  /* Two updates before the reader looks: the newest state, and the changes of both. */
+  sendStr(srv, "{\"sb\":1,\"ct\":56}\n");
+  TEST_ASSERT_TRUE(serviceUntil(link, now, [&] { return link.framer().lines() >= 2; }));
+  sendStr(srv, "{\"sb\":1,\"cl\":21}\n");
+  TEST_ASSERT_TRUE(serviceUntil(link, now, [&] { return link.framer().lines() >= 3; }));
+  TEST_ASSERT_TRUE(link.take());
+  const MonitorSnapshot &s = link.snapshot();
+  TEST_ASSERT_EQUAL_UINT32(3, s.updates);
+  TEST_ASSERT_EQUAL_INT(56, s.state.hw.ct);
+  TEST_ASSERT_EQUAL_INT(61, s.state.hw.gt);
+  TEST_ASSERT_EQUAL_INT(21, s.state.hw.cl);
+  TEST_ASSERT_TRUE(s.changed & fieldBit(SF_CT));
+  TEST_ASSERT_TRUE(s.changed & fieldBit(SF_CL));
+  TEST_ASSERT_FALSE(s.changed & fieldBit(SF_GT));
+  TEST_ASSERT_TRUE(link.replaced() >= 1);
+  TEST_ASSERT_EQUAL_INT32(-1, s.mark);
+
+  /* Parse counters and a load generator's line number (LinkMarks): a rejected line is counted, nothing
+   * else. */
+  sendStr(srv, "{\"sb\":1,\"ct\":\n{\"sb\":1,\"cl\":22,\"ln\":7}\n");
+  TEST_ASSERT_TRUE(serviceUntil(link, now, [&] { return link.take() && link.snapshot().updates == 4; }));
+  TEST_ASSERT_EQUAL_INT32(7, link.snapshot().mark);
+  TEST_ASSERT_EQUAL_UINT32(5, link.snapshot().parsed);
+  TEST_ASSERT_EQUAL_UINT32(1, link.snapshot().rejected);
+  TEST_ASSERT_EQUAL_INT(56, link.snapshot().state.hw.ct);
+  TEST_ASSERT_EQUAL_INT(22, link.snapshot().state.hw.cl);
+
+  /* A new screen goes out once. */
+  link.setScreen(2, 3);
+  rx.clear();
+  TEST_ASSERT_TRUE(serviceUntil(link, now, [&] {
+    rx += recvAll(srv);
+    return rx.find("sub:") != std::string::npos && rx.back() == '\n';
+  }));
+  TEST_ASSERT_EQUAL_INT(0, (int)rx.find("screen:2\n"));
+  for (int i = 0; i < 5; i++)
+    link.service(now++, true, -50);
+  TEST_ASSERT_EQUAL_STRING("", recvAll(srv).c_str());
+
+  /* Peer closes: search mode until it is back. */
+  close(srv);
+  TEST_ASSERT_TRUE(serviceUntil(link, now, [&] { return link.take() && !link.snapshot().tcp; }));
+  TEST_ASSERT_TRUE(link.snapshot().search);
+  TEST_ASSERT_EQUAL_UINT32(0, link.snapshot().tcpConnectMs);
+
+  /* Reconnect (after the retry interval), screen resent; then a disconnect request drops it. */
+  now += MonitorTcp::kRetryMs;
+  srv = -1;
+  rx.clear();
+  TEST_ASSERT_TRUE(serviceUntil(link, now, [&] {
+    if (srv < 0)
+      srv = l.accept();
+    if (srv >= 0)
+      rx += recvAll(srv);
+    return rx.find("screen:2\n") != std::string::npos;
+  }));
+  TEST_ASSERT_TRUE(link.take());
+  TEST_ASSERT_TRUE(link.snapshot().tcp);
+  TEST_ASSERT_FALSE(link.snapshot().search);
+  link.requestDisconnect();
+  link.service(now, true, -50);
+  TEST_ASSERT_TRUE(link.take());
+  TEST_ASSERT_FALSE(link.snapshot().tcp);
+  TEST_ASSERT_EQUAL_UINT32(1, link.tcp().drops());
+  close(srv);
+
+  /* Inactive again: sockets closed. */
+  link.setActive(false);
+  link.service(now, true, -50);
+  TEST_ASSERT_EQUAL_INT(-1, link.tcp().fd());
+  TEST_ASSERT_FALSE(link.udp().isOpen());
+  TEST_ASSERT_FALSE(link.wait(1));
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_triple_buffer_handoff);
+  RUN_TEST(test_triple_buffer_threads_never_tear);
+  RUN_TEST(test_connect_never_blocks);
+  RUN_TEST(test_link_session);
+  return UNITY_END();
+}
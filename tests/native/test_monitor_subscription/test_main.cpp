@@ -0,0 +1,161 @@
+/*
+ * Host tests: scene-scoped subscriptions — the "sub:" command MonitorSubscription.cpp formats and parses,
+ * the per-scene sets against what each scene draws (RedrawGate::sceneFields), and partial "sb" lines in
+ * MonitorDecoder.cpp, which change only the keys they carry.
+ * Run: pio test -e native -f native/test_monitor_subscription
+ */
+#include <unity.h>
+#include <cstring>
+#include <string>
+#include "MonitorDecoder.h"
+#include "MonitorSubscription.h"
+#include "RedrawGate.h"
+#include "nocturne/config.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static bool decode(MonitorDecoder &d, const char *s, AppState *st) { return d.decode(s, strlen(s), st); }
+
+void test_format_and_parse(void) {
+  MonitorSubscription dev;
+  dev.forScene(NOCT_SCENE_CPU, NOCT_SCENE_GPU);
+  char line[MonitorSubscription::kLineMax];
+  const size_t n = dev.format(7, line, sizeof(line));
+  TEST_ASSERT_TRUE(n > 0 && line[n - 1] == '\n');
+  TEST_ASSERT_EQUAL_STRING("sub:7 ct@500,cl@100,gl@2000,cc@250,pw@250,gh@2000,gclock@2000,vu@2000,alert@0\n", line);
+
+  MonitorSubscription srv;
+  TEST_ASSERT_TRUE(srv.parse(line, n - 1));
+  TEST_ASSERT_EQUAL_UINT32(7, srv.generation());
+  TEST_ASSERT_TRUE(srv.fields() == dev.fields());
+  for (int f = 0; f < SF_COUNT; f++)
+    TEST_ASSERT_EQUAL_UINT32(dev.period((StateField)f), srv.period((StateField)f));
+
+  /* Too small a buffer: nothing, not a cut line. */
+  TEST_ASSERT_EQUAL_UINT32(0, dev.format(7, line, 20));
+  /* Unknown keys are skipped; an empty set is valid. */
+  const char *fwd = "sub:8 ct@100,zz@5,wt@60000\r";
+  TEST_ASSERT_TRUE(srv.parse(fwd, strlen(fwd)));
+  TEST_ASSERT_TRUE(srv.fields() == (fieldBit(SF_CT) | fieldBit(SF_WEATHER)));
+  TEST_ASSERT_EQUAL_UINT32(60000, srv.period(SF_WEATHER));
+  TEST_ASSERT_TRUE(srv.parse("sub:9", 5));
+  TEST_ASSERT_TRUE(srv.fields() == 0);
+  TEST_ASSERT_EQUAL_UINT32(9, srv.generation());
+}
+
+void test_malformed_keeps_set(void) {
+  MonitorSubscription srv;
+  const char *ok = "sub:3 cl@100,alert@0";
+  TEST_ASSERT_TRUE(srv.parse(ok, strlen(ok)));
+  static const char *const kBad[] = {"screen:3", "sub:", "sub:x cl@1", "sub:70000 cl@1", "sub:4 cl",
+                                     "sub:4 cl@", "sub:4 cl@100;gl@1", "sub:4 @100", "sub:4 cl@9999999",
+                                     "sub:4 cl@100,gl@100x"};
+  for (const char *b : kBad) {
+    TEST_ASSERT_FALSE_MESSAGE(srv.parse(b, strlen(b)), b);
+    /* Atomic: a rejected line leaves the previous set whole. */
+    TEST_ASSERT_EQUAL_UINT32(3, srv.generation());
+    TEST_ASSERT_TRUE(srv.fields() == (fieldBit(SF_CL) | fieldBit(SF_ALERT)));
+    TEST_ASSERT_EQUAL_UINT32(100, srv.period(SF_CL));
+  }
+}
+
+void test_scene_sets(void) {
+  const FieldMask local = fieldBit(SF_BATTERY);
+  for (int s = 0; s < NOCT_TOTAL_SCENES; s++) {
+    const int next = (s + 1) % NOCT_TOTAL_SCENES;
+    MonitorSubscription sub;
+    sub.forScene(s, next);
+    /* Everything either scene draws, nothing that only the device knows. */
+    const FieldMask want = (RedrawGate::sceneFields(s) | RedrawGate::sceneFields(next)) & ~local;
+    TEST_ASSERT_TRUE(sub.fields() == want);
+    TEST_ASSERT_EQUAL_UINT32(MonitorSubscription::kOnChange, sub.period(SF_ALERT));
+    for (int f = 0; f < SF_COUNT; f++) {
+      if (!sub.has((StateField)f) || (RedrawGate::sceneFields(s) & fieldBit((StateField)f)))
+        continue;
+      /* Prefetch only: never faster than kPrefetchMs. */
+      TEST_ASSERT_TRUE(sub.period((StateField)f) >= MonitorSubscription::kPrefetchMs);
+    }
+    char line[MonitorSubscription::kLineMax];
+    TEST_ASSERT_TRUE(sub.format(65535, line, sizeof(line)) > 0);
+  }
+  MonitorSubscription sub;
+  sub.forScene(NOCT_SCENE_CPU, NOCT_SCENE_GPU);
+  TEST_ASSERT_EQUAL_UINT32(100, sub.period(SF_CL)); /* 10 Hz load on its own scene */
+  TEST_ASSERT_FALSE(sub.has(SF_WEATHER));
+  TEST_ASSERT_FALSE(sub.has(SF_ND)); /* net graphs are drawn nowhere */
+  sub.forScene(NOCT_SCENE_WEATHER, NOCT_SCENE_MAIN);
+  TEST_ASSERT_EQUAL_UINT32(60000, sub.period(SF_WEATHER));
+  TEST_ASSERT_EQUAL_UINT32(MonitorSubscription::kPrefetchMs, sub.period(SF_CL));
+  TEST_ASSERT_TRUE(MonitorSubscription::keyName(SF_BATTERY) == nullptr);
+  TEST_ASSERT_EQUAL_STRING("mp", MonitorSubscription::keyName(SF_MEDIA_STATE));
+}
+
+void test_partial_lines(void) {
+  MonitorDecoder d;
+  AppState st;
+  const char *full =
+      "{\"ct\":55,\"cl\":20,\"gl\":40,\"hdd\":[{\"n\":\"D\",\"u\":10.5,\"tot\":100,\"t\":33}],\"wt\":7,"
+      "\"wd\":\"Cloudy\",\"wi\":3,\"tp\":[{\"n\":\"chrome.exe\",\"c\":12}],\"tr\":[{\"n\":\"Code.exe\",\"r\":900}],"
+      "\"art\":\"Carpenter Brut\",\"trk\":\"Turbo Killer\",\"mp\":true,\"media_status\":\"PLAYING\","
+      "\"alert\":\"CRITICAL\",\"target_screen\":\"GPU\",\"alert_metric\":\"gt\"}";
+  TEST_ASSERT_TRUE(decode(d, full, &st));
+  TEST_ASSERT_EQUAL_INT(-1, d.subscription());
+
+  TEST_ASSERT_TRUE(decode(d, "{\"sb\":4,\"cl\":21}", &st));
+  TEST_ASSERT_EQUAL_INT(4, d.subscription());
+  TEST_ASSERT_TRUE(d.changed() == fieldBit(SF_CL));
+  TEST_ASSERT_EQUAL_INT(21, st.hw.cl);
+  TEST_ASSERT_EQUAL_INT(55, st.hw.ct);
+  TEST_ASSERT_EQUAL_INT(40, st.hw.gl);
+  TEST_ASSERT_EQUAL_STRING("D", st.hw.hdd[0].name);
+  TEST_ASSERT_EQUAL_INT(33, st.hw.hdd[0].temp);
+  TEST_ASSERT_EQUAL_STRING("Cloudy", st.weather.desc.c_str());
+  TEST_ASSERT_EQUAL_STRING("chrome.exe", st.process.cpuNames[0].c_str());
+  TEST_ASSERT_EQUAL_INT(900, st.process.ramMb[0]);
+  TEST_ASSERT_EQUAL_STRING("Turbo Killer", st.media.track.c_str());
+  TEST_ASSERT_TRUE(st.media.isPlaying);
+  TEST_ASSERT_TRUE(st.media.mediaStatus == "PLAYING");
+  TEST_ASSERT_TRUE(st.alertActive);
+  TEST_ASSERT_EQUAL_INT(NOCT_SCENE_GPU, st.alertTargetScene);
+  TEST_ASSERT_EQUAL_INT(NOCT_ALERT_GT, st.alertMetric);
+
+  /* Keepalive: valid, changes nothing. */
+  TEST_ASSERT_TRUE(decode(d, "{\"sb\":4}", &st));
+  TEST_ASSERT_TRUE(d.changed() == 0);
+
+  /* Groups arrive whole: weather, alert clear. */
+  TEST_ASSERT_TRUE(decode(d, "{\"sb\":5,\"wt\":-2,\"wd\":\"Snow\",\"wi\":71,\"alert\":\"OK\"}", &st));
+  TEST_ASSERT_TRUE(d.changed() == (fieldBit(SF_WEATHER) | fieldBit(SF_ALERT)));
+  TEST_ASSERT_EQUAL_INT(-2, st.weather.temp);
+  TEST_ASSERT_FALSE(st.alertActive);
+  TEST_ASSERT_EQUAL_INT(NOCT_SCENE_MAIN, st.alertTargetScene);
+  TEST_ASSERT_EQUAL_INT(21, st.hw.cl);
+
+  /* A malformed partial line is dropped whole. */
+  TEST_ASSERT_FALSE(decode(d, "{\"sb\":5,\"ct\":90,", &st));
+  TEST_ASSERT_EQUAL_INT(55, st.hw.ct);
+  TEST_ASSERT_EQUAL_INT(5, d.subscription());
+
+  /* "sb" anywhere but first is not a partial line: the old full-line semantics apply. */
+  TEST_ASSERT_TRUE(decode(d, "{\"ct\":60,\"sb\":5}", &st));
+  TEST_ASSERT_EQUAL_INT(60, st.hw.ct);
+  TEST_ASSERT_EQUAL_INT(0, st.hw.cl);
+  TEST_ASSERT_TRUE(st.media.track.empty());
+
+  /* A server that ignores "sub:" keeps sending full lines. */
+  TEST_ASSERT_TRUE(decode(d, full, &st));
+  TEST_ASSERT_EQUAL_INT(-1, d.subscription());
+  TEST_ASSERT_EQUAL_INT(20, st.hw.cl);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_format_and_parse);
+  RUN_TEST(test_malformed_keeps_set);
+  RUN_TEST(test_scene_sets);
+  RUN_TEST(test_partial_lines);
+  return UNITY_END();
+}
@@ -0,0 +1,267 @@
+/*
+ * Host tests: monitor UDP transport (MonitorUdp.cpp) — sequence accounting, a loopback sender standing in
+ * for the PC server that drops, delays, reorders and duplicates datagrams, heartbeat and silence — and
+ * data age at render time over UDP against the TCP stream (head-of-line blocking) on one loss trace.
+ * Run: pio test -e native -f native/test_monitor_udp
+ */
+#include <unity.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include "MonitorUdp.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_sequence_accounting(void) {
+  UdpSequence s;
+  TEST_ASSERT_TRUE(s.accept(10));
+  TEST_ASSERT_TRUE(s.accept(11));
+  TEST_ASSERT_TRUE(s.accept(14)); /* 12, 13 missing */
+  TEST_ASSERT_EQUAL_UINT32(2, s.lost());
+  TEST_ASSERT_FALSE(s.accept(12)); /* late: dropped, no longer lost */
+  TEST_ASSERT_EQUAL_UINT32(1, s.lost());
+  TEST_ASSERT_EQUAL_UINT32(1, s.reordered());
+  TEST_ASSERT_FALSE(s.accept(12));
+  TEST_ASSERT_FALSE(s.accept(14));
+  TEST_ASSERT_EQUAL_UINT32(2, s.duplicates());
+  TEST_ASSERT_FALSE(s.accept(11));
+  TEST_ASSERT_EQUAL_UINT32(3, s.duplicates());
+  /* Wraps at 16 bits. */
+  UdpSequence w;
+  TEST_ASSERT_TRUE(w.accept(65534));
+  TEST_ASSERT_TRUE(w.accept(65535));
+  TEST_ASSERT_TRUE(w.accept(1));
+  TEST_ASSERT_EQUAL_UINT32(1, w.lost());
+  TEST_ASSERT_FALSE(w.accept(0));
+  TEST_ASSERT_EQUAL_UINT32(0, w.lost());
+  TEST_ASSERT_FALSE(w.accept(65000));
+  TEST_ASSERT_EQUAL_UINT32(3, w.accepted());
+}
+
+/* PC server stand-in on 127.0.0.1: learns the device from its HELO, sends snapshots with injected faults. */
+struct LoopbackSender {
+  int fd = -1;
+  uint16_t port = 0;
+  sockaddr_in device;
+  bool known = false;
+  std::vector<std::string> received;
+  MonitorBinaryEncoder enc;
+  uint16_t seq = 0;
+
+  LoopbackSender() {
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, (sockaddr *)&sa, sizeof(sa));
+    socklen_t len = sizeof(sa);
+    getsockname(fd, (sockaddr *)&sa, &len);
+    port = ntohs(sa.sin_port);
+    enc.setKeyframesOnly(true);
+  }
+  ~LoopbackSender() { close(fd); }
+
+  void drain() {
+    char buf[256];
+    sockaddr_in from;
+    socklen_t flen = sizeof(from);
+    ssize_t n;
+    while ((n = recvfrom(fd, buf, sizeof(buf), MSG_DONTWAIT, (sockaddr *)&from, &flen)) > 0) {
+      received.emplace_back(buf, (size_t)n);
+      device = from;
+      known = true;
+      flen = sizeof(from);
+    }
+  }
+  std::string snapshot(const AppState &s, uint16_t sq, uint32_t sentMs) {
+    uint8_t frame[MonitorBinary::kFrameMax], dgram[MonitorUdp::kDatagramMax];
+    const size_t n = enc.encode(s, frame, sizeof(frame));
+    const size_t d = MonitorUdp::pack(MonitorUdp::kTypeBinary, sq, sentMs, frame + MonitorBinary::kHeader,
+                                      n - MonitorBinary::kHeader, dgram, sizeof(dgram));
+    return std::string((const char *)dgram, d);
+  }
+  void sendRaw(const std::string &d) {
+    TEST_ASSERT_TRUE(known);
+    TEST_ASSERT_EQUAL_INT((int)d.size(), (int)sendto(fd, d.data(), d.size(), 0, (sockaddr *)&device, sizeof(device)));
+  }
+};
+
+void test_loopback_faults(void) {
+  LoopbackSender srv;
+  MonitorUdp dev;
+  TEST_ASSERT_TRUE(dev.begin(0));
+  TEST_ASSERT_TRUE(dev.setServer("127.0.0.1", srv.port));
+  AppState st;
+  uint32_t now = 1000;
+  TEST_ASSERT_FALSE(dev.poll(now, &st)); /* sends HELO, nothing to read yet */
+  srv.drain();
+  TEST_ASSERT_EQUAL_UINT(1, srv.received.size());
+  TEST_ASSERT_EQUAL_STRING("HELO udp=1\n", srv.received[0].c_str());
+  TEST_ASSERT_FALSE(dev.alive(now));
+
+  /* 200 updates. Faults: every 10th dropped, every 7th held back two updates (late), every 13th doubled. */
+  AppState src;
+  std::vector<std::string> held;
+  int dropped = 0, late = 0, doubled = 0, applied = 0;
+  for (int i = 0; i < 200; i++) {
+    src.hw.ct = i;
+    const std::string d = srv.snapshot(src, (uint16_t)i, now);
+    if (i % 10 == 5) {
+      dropped++;
+    } else if (i % 7 == 3) {
+      held.push_back(d);
+    } else {
+      srv.sendRaw(d);
+      if (i % 13 == 0) {
+        srv.sendRaw(d);
+        doubled++;
+      }
+    }
+    if (i % 7 == 5 && !held.empty()) {
+      for (const std::string &h : held)
+        srv.sendRaw(h);
+      late += (int)held.size();
+      held.clear();
+    }
+    now += 50;
+    if (dev.poll(now, &st)) {
+      applied++;
+      TEST_ASSERT_TRUE(dev.alive(now));
+    }
+  }
+  for (const std::string &h : held) /* tail: nothing newer was sent, so these are in order */
+    srv.sendRaw(h);
+  if (dev.poll(now, &st))
+    applied++;
+  srv.sendRaw("Nxx"); /* runt */
+  TEST_ASSERT_FALSE(dev.poll(now, &st));
+  const UdpSequence &q = dev.sequence();
+  printf("  loopback: %d sent (%d dropped, %d late, %d doubled) -> accepted %u, lost %u, reordered %u, "
+         "duplicates %u, malformed %u\n",
+         200, dropped, late, doubled, (unsigned)q.accepted(), (unsigned)q.lost(), (unsigned)q.reordered(),
+         (unsigned)q.duplicates(), (unsigned)dev.malformed());
+  TEST_ASSERT_EQUAL_INT(199, st.hw.ct);
+  TEST_ASSERT_EQUAL_UINT32(200 - dropped - late, q.accepted());
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)dropped, q.lost());
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)late, q.reordered());
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)doubled, q.duplicates());
+  TEST_ASSERT_EQUAL_UINT32(1, dev.malformed());
+  TEST_ASSERT_EQUAL_INT((int)q.accepted(), applied);
+
+  /* JSON datagrams work too; the newest of a queued pair wins. */
+  const char *j1 = "{\"ct\":70}", *j2 = "{\"ct\":71}";
+  uint8_t dg[64];
+  srv.sendRaw(std::string((const char *)dg, MonitorUdp::pack(MonitorUdp::kTypeJson, 200, now, (const uint8_t *)j1,
+                                                              strlen(j1), dg, sizeof(dg))));
+  srv.sendRaw(std::string((const char *)dg, MonitorUdp::pack(MonitorUdp::kTypeJson, 201, now, (const uint8_t *)j2,
+                                                              strlen(j2), dg, sizeof(dg))));
+  TEST_ASSERT_TRUE(dev.poll(now, &st));
+  TEST_ASSERT_EQUAL_INT(71, st.hw.ct);
+
+  /* Heartbeat once a second; commands go the same way; silence ends the session. */
+  srv.drain();
+  srv.received.clear();
+  TEST_ASSERT_TRUE(dev.send("screen:3\n"));
+  dev.poll(now + MonitorUdp::kHeartbeatMs, &st);
+  srv.drain();
+  TEST_ASSERT_EQUAL_UINT(2, srv.received.size());
+  TEST_ASSERT_EQUAL_STRING("screen:3\n", srv.received[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("HELO udp=1\n", srv.received[1].c_str());
+  TEST_ASSERT_TRUE(dev.alive(now + MonitorUdp::kSilentMs - 1));
+  TEST_ASSERT_FALSE(dev.alive(now + MonitorUdp::kSilentMs));
+}
+
+/* ── Data age at render time: UDP (newest wins) vs TCP (in order, lost segment waits for RTO) ── */
+
+struct AgeStats {
+  double mean = 0;
+  uint32_t p99 = 0;
+  uint32_t max = 0;
+};
+
+static AgeStats ageStats(std::vector<uint32_t> &ages) {
+  AgeStats a;
+  double sum = 0;
+  for (uint32_t v : ages)
+    sum += v;
+  a.mean = sum / ages.size();
+  std::sort(ages.begin(), ages.end());
+  a.p99 = ages[ages.size() * 99 / 100];
+  a.max = ages.back();
+  return a;
+}
+
+void test_render_age_udp_vs_tcp(void) {
+  /* 10 updates/s for 10 min, one-way 3 ms + 0..25 ms Wi-Fi jitter, 2% loss; render at 30 fps.
+   * TCP: a lost segment is resent after the RTO (250 ms here, optimistic for lwIP) and every later
+   * update waits behind it. UDP: the lost update is just missing; late ones are dropped by UdpSequence. */
+  const uint32_t kPeriodMs = 100, kDurationMs = 600000, kRtoMs = 250, kFrameMs = 33;
+  uint32_t rng = 7;
+  auto rnd = [&rng](uint32_t n) {
+    rng = rng * 1103515245u + 12345u;
+    return (rng >> 8) % n;
+  };
+  struct Arrival {
+    uint32_t at;
+    uint32_t sent;
+    uint16_t seq;
+  };
+  std::vector<Arrival> udp, tcp;
+  uint32_t tcpReady = 0;
+  for (uint32_t t = 0, i = 0; t < kDurationMs; t += kPeriodMs, i++) {
+    const bool lost = rnd(1000) < 20;
+    const uint32_t oneWay = 3 + rnd(26);
+    if (!lost)
+      udp.push_back({t + oneWay, t, (uint16_t)i});
+    uint32_t at = t + oneWay + (lost ? kRtoMs + 3 + rnd(26) : 0);
+    at = std::max(at, tcpReady); /* in order: not before the one ahead of it */
+    tcpReady = at;
+    tcp.push_back({at, t, (uint16_t)i});
+  }
+  std::sort(udp.begin(), udp.end(), [](const Arrival &a, const Arrival &b) { return a.at < b.at; });
+
+  auto render = [&](const std::vector<Arrival> &arr, bool useSeq, UdpSequence *seq) {
+    std::vector<uint32_t> ages;
+    size_t k = 0;
+    uint32_t newestSent = 0;
+    bool have = false;
+    for (uint32_t now = 1000; now < kDurationMs; now += kFrameMs) {
+      for (; k < arr.size() && arr[k].at <= now; k++)
+        if (!useSeq || seq->accept(arr[k].seq)) {
+          newestSent = arr[k].sent;
+          have = true;
+        }
+      if (have)
+        ages.push_back(now - newestSent);
+    }
+    return ageStats(ages);
+  };
+  UdpSequence seq;
+  const AgeStats u = render(udp, true, &seq);
+  const AgeStats c = render(tcp, false, nullptr);
+  printf("  data age at render, 2%% loss, %u updates:\n", (unsigned)(kDurationMs / kPeriodMs));
+  printf("    TCP: mean %5.1f ms, p99 %4u ms, max %4u ms\n", c.mean, (unsigned)c.p99, (unsigned)c.max);
+  printf("    UDP: mean %5.1f ms, p99 %4u ms, max %4u ms (lost %u, reordered %u)\n", u.mean, (unsigned)u.p99,
+         (unsigned)u.max, (unsigned)seq.lost(), (unsigned)seq.reordered());
+  TEST_ASSERT_TRUE(u.mean < c.mean);
+  TEST_ASSERT_TRUE(u.p99 < c.p99);
+  TEST_ASSERT_TRUE(u.max < c.max);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_sequence_accounting);
+  RUN_TEST(test_loopback_faults);
+  RUN_TEST(test_render_age_udp_vs_tcp);
+  return UNITY_END();
+}
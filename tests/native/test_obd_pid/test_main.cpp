@@ -0,0 +1,235 @@
+/*
+ * Host tests: OBD PID table, hex tokenizer, ISO-TP reassembly and one-pass decoding (ObdPid.cpp), and
+ * parse cost per response against the strstr/sscanf parsers ObdClient used before.
+ * Run: pio test -e native -f native/test_obd_pid
+ */
+#include <unity.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "ObdPid.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static uint8_t lineOf(ObdIsoTp &tp, const char *s) {
+  return tp.line(s, strlen(s));
+}
+
+void test_table_scaling(void) {
+  struct Case {
+    uint8_t pid;
+    uint8_t d[2];
+    int32_t expect;
+  } cases[] = {
+      {0x0C, {0x1A, 0xF8}, 1726},  /* rpm */
+      {0x05, {0x7B}, 83},          /* coolant degC */
+      {0x5C, {0x00}, -40},         /* oil degC */
+      {0x0D, {0xFF}, 255},         /* km/h */
+      {0x04, {0xFF}, 100},         /* load % */
+      {0x06, {0x80}, 0},           /* fuel trim % */
+      {0x06, {0x00}, -100},
+      {0x0E, {0x80}, 0},           /* timing, 0.5 deg */
+      {0x0E, {0x94}, 20},          /* +10 deg */
+      {0x10, {0x01, 0x2C}, 300},   /* MAF 3.00 g/s */
+      {0x42, {0x37, 0x14}, 14100}, /* mV */
+  };
+  for (const Case &c : cases) {
+    const ObdPidDef *def = obdPidFind(c.pid);
+    TEST_ASSERT_NOT_NULL(def);
+    TEST_ASSERT_EQUAL_INT32(c.expect, obdPidValue(*def, c.d));
+  }
+  const uint8_t bm[] = {0xBE, 0x3F, 0xA8, 0x13};
+  TEST_ASSERT_EQUAL_HEX32(0xBE3FA813, (uint32_t)obdPidValue(*obdPidFind(0x00), bm));
+  TEST_ASSERT_NULL(obdPidFind(0x01));
+  TEST_ASSERT_NULL(obdPidFind(0xFF));
+  for (size_t i = 0; i < kObdPidCount; i++)
+    TEST_ASSERT_TRUE(obdPidFind(kObdPids[i].pid) == &kObdPids[i]);
+  TEST_ASSERT_EQUAL_STRING("rpm", obdUnitName(obdPidFind(0x0C)->unit));
+}
+
+void test_hex_tokenizer(void) {
+  uint8_t b[8];
+  TEST_ASSERT_EQUAL_INT(4, obdParseHex("41 0C 1A F8", 11, b, sizeof(b)));
+  TEST_ASSERT_EQUAL_HEX8(0xF8, b[3]);
+  TEST_ASSERT_EQUAL_INT(4, obdParseHex("410c1af8", 8, b, sizeof(b)));
+  TEST_ASSERT_EQUAL_HEX8(0x0C, b[1]);
+  TEST_ASSERT_EQUAL_INT(0, obdParseHex("  ", 2, b, sizeof(b)));
+  TEST_ASSERT_EQUAL_INT(-1, obdParseHex("410", 3, b, sizeof(b)));        /* odd digit count */
+  TEST_ASSERT_EQUAL_INT(-1, obdParseHex("OK", 2, b, sizeof(b)));
+  TEST_ASSERT_EQUAL_INT(-1, obdParseHex("41 0C:", 6, b, sizeof(b)));
+  TEST_ASSERT_EQUAL_INT(-1, obdParseHex("0102030405", 10, b, 4));       /* over capacity */
+}
+
+void test_decode_multi_pid_one_pass(void) {
+  const uint8_t msg[] = {0x41, 0x0C, 0x1A, 0xF8, 0x0D, 0x3F, 0x05, 0x7B, 0x5C, 0x89};
+  ObdValue v[8];
+  TEST_ASSERT_EQUAL_UINT(4, obdDecode01(msg, sizeof(msg), v, 8));
+  TEST_ASSERT_EQUAL_HEX8(0x0C, v[0].pid);
+  TEST_ASSERT_EQUAL_INT32(1726, v[0].value);
+  TEST_ASSERT_EQUAL_UINT8(OBD_UNIT_RPM, v[0].unit);
+  TEST_ASSERT_EQUAL_INT32(63, v[1].value);
+  TEST_ASSERT_EQUAL_UINT8(OBD_UNIT_KMH, v[1].unit);
+  TEST_ASSERT_EQUAL_INT32(83, v[2].value);
+  TEST_ASSERT_EQUAL_INT32(97, v[3].value);
+  /* Output capacity, truncation, unknown PID, not a mode 01 reply. */
+  TEST_ASSERT_EQUAL_UINT(2, obdDecode01(msg, sizeof(msg), v, 2));
+  TEST_ASSERT_EQUAL_UINT(1, obdDecode01(msg, 5, v, 8));
+  const uint8_t unknown[] = {0x41, 0x0D, 0x10, 0x03, 0x02, 0x05, 0x7B};
+  TEST_ASSERT_EQUAL_UINT(1, obdDecode01(unknown, sizeof(unknown), v, 8));
+  const uint8_t other[] = {0x43, 0x01, 0x33};
+  TEST_ASSERT_EQUAL_UINT(0, obdDecode01(other, sizeof(other), v, 8));
+}
+
+void test_isotp_headers_off(void) {
+  ObdIsoTp tp;
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_DONE, lineOf(tp, "410C1AF8"));
+  TEST_ASSERT_EQUAL_UINT(4, tp.size());
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_NONE, lineOf(tp, "ELM327 v1.5"));
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_NONE, lineOf(tp, "OK"));
+
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_MORE, lineOf(tp, "00A"));
+  TEST_ASSERT_TRUE(tp.pending());
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_MORE, lineOf(tp, "0: 41 0C 1A F8 0D 3F"));
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_DONE, lineOf(tp, "1: 05 7B 5C 89 00 00 00"));
+  TEST_ASSERT_EQUAL_UINT(10, tp.size());  /* padding dropped */
+  TEST_ASSERT_EQUAL_HEX8(0x89, tp.data()[9]);
+  TEST_ASSERT_FALSE(tp.pending());
+
+  /* 0x16 bytes: three frames; a skipped frame drops the message. */
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_MORE, lineOf(tp, "016"));
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_MORE, lineOf(tp, "0:410C1AF80D3F"));
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_ERROR, lineOf(tp, "2:057B5C89000000"));
+  TEST_ASSERT_EQUAL_UINT32(1, tp.errors());
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_NONE, lineOf(tp, "3:057B5C89000000"));  /* stray frame */
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_ERROR, lineOf(tp, "FFF"));               /* longer than kMax */
+  TEST_ASSERT_EQUAL_UINT32(2, tp.errors());
+  /* Incomplete at the prompt. */
+  lineOf(tp, "00A");
+  lineOf(tp, "0:410C1AF80D3F");
+  tp.abort();
+  TEST_ASSERT_EQUAL_UINT32(3, tp.errors());
+  TEST_ASSERT_FALSE(tp.pending());
+}
+
+void test_isotp_headers_on(void) {
+  ObdIsoTp tp;
+  tp.setHeaders(true);
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_DONE, lineOf(tp, "7E8 04 41 0C 1A F8"));
+  TEST_ASSERT_EQUAL_UINT(4, tp.size());
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_DONE, lineOf(tp, "7E803410D3F"));  /* spaces off */
+  TEST_ASSERT_EQUAL_HEX8(0x3F, tp.data()[2]);
+
+  /* First frame, a second ECU's single frame in between (ignored), consecutive frames. */
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_MORE, lineOf(tp, "7E8 10 0A 41 0C 1A F8 0D 3F"));
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_NONE, lineOf(tp, "7E9 03 41 0D 3F"));
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_DONE, lineOf(tp, "7E8 21 05 7B 5C 89 AA AA AA"));
+  TEST_ASSERT_EQUAL_UINT(10, tp.size());
+  ObdValue v[8];
+  TEST_ASSERT_EQUAL_UINT(4, obdDecode01(tp.data(), tp.size(), v, 8));
+  TEST_ASSERT_EQUAL_INT32(97, v[3].value);
+
+  /* Sequence error, bad single-frame length. */
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_MORE, lineOf(tp, "7E8 10 14 41 0C 1A F8 0D 3F"));
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_ERROR, lineOf(tp, "7E8 22 05 7B 5C 89 AA AA AA"));
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_ERROR, lineOf(tp, "7E8 07 41 0C"));
+  TEST_ASSERT_EQUAL_UINT32(2, tp.errors());
+  TEST_ASSERT_EQUAL_UINT8(OBD_ISOTP_NONE, lineOf(tp, "NO DATA"));
+}
+
+/* ── Parse cost: the removed ObdClient parsers, verbatim ────────────────── */
+
+static int legacyParseRpm(const char *line) {
+  const char *p = strstr(line, "41 0C");
+  if (p)
+    p += 6;
+  else {
+    p = strstr(line, "410C");
+    if (p)
+      p += 4;
+    else
+      return -1;
+  }
+  unsigned int a = 0, b = 0;
+  if (sscanf(p, "%x %x", &a, &b) >= 2)
+    return (int)((a * 256u + b) / 4);
+  return -1;
+}
+
+static int legacyParseTemp(const char *line, const char *spaced, const char *packed) {
+  const char *p = strstr(line, spaced);
+  if (p)
+    p += 6;
+  else {
+    p = strstr(line, packed);
+    if (p)
+      p += 4;
+    else
+      return -1;
+  }
+  unsigned int x = 0;
+  if (sscanf(p, "%x", &x) >= 1)
+    return (int)x - 40;
+  return -1;
+}
+
+static volatile int32_t s_sink;
+
+void test_parse_cost_vs_sscanf(void) {
+  const int kIter = 200000;
+  /* Old client: one line per PID, parser chosen by the PID it asked for. */
+  const char *lines[] = {"41 0C 1A F8", "41 05 7B", "41 5C 89"};
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIter; i++) {
+    s_sink = legacyParseRpm(lines[0]);
+    s_sink = legacyParseTemp(lines[1], "41 05", "4105");
+    s_sink = legacyParseTemp(lines[2], "41 5C", "415C");
+  }
+  const double legacyNs =
+      std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / (kIter * 3.0);
+
+  /* Table decoder, same three single-PID lines (what a K-line session gets). */
+  ObdIsoTp tp;
+  ObdValue v[8];
+  t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIter; i++)
+    for (const char *l : lines)
+      if (tp.line(l, strlen(l)) == OBD_ISOTP_DONE && obdDecode01(tp.data(), tp.size(), v, 8) == 1)
+        s_sink = v[0].value;
+  const double tableNs =
+      std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / (kIter * 3.0);
+
+  /* One CAN multi-frame reply carrying four PIDs (what a CAN session gets). */
+  const char *mf[] = {"00A", "0:410C1AF80D3F", "1:057B5C89000000"};
+  size_t decoded = 0;
+  t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIter; i++)
+    for (const char *l : mf)
+      if (tp.line(l, strlen(l)) == OBD_ISOTP_DONE) {
+        decoded += obdDecode01(tp.data(), tp.size(), v, 8);
+        s_sink = v[3].value;
+      }
+  const double multiNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / kIter;
+
+  printf("  parse cost per response (host, %d iterations):\n", kIter);
+  printf("    strstr + sscanf, 1 PID per line:      %6.1f ns/value\n", legacyNs);
+  printf("    hex tokenizer + table, 1 PID per line: %6.1f ns/value (x%.1f)\n", tableNs, legacyNs / tableNs);
+  printf("    ISO-TP 3 lines + table, 4 PIDs:        %6.1f ns/reply, %5.1f ns/value\n", multiNs, multiNs / 4);
+  TEST_ASSERT_EQUAL_UINT((size_t)kIter * 4, decoded);
+  TEST_ASSERT_EQUAL_UINT32(0, tp.errors());
+  TEST_ASSERT_TRUE(tableNs < legacyNs);
+  TEST_ASSERT_TRUE(multiNs / 4 < legacyNs);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_table_scaling);
+  RUN_TEST(test_hex_tokenizer);
+  RUN_TEST(test_decode_multi_pid_one_pass);
+  RUN_TEST(test_isotp_headers_off);
+  RUN_TEST(test_isotp_headers_on);
+  RUN_TEST(test_parse_cost_vs_sscanf);
+  return UNITY_END();
+}
@@ -0,0 +1,513 @@
+/*
+ * Host tests: ELM327 session (ObdSession.cpp) — line assembly, init, multi-PID scheduling, recovery, and
+ * throughput against a simulated adapter compared with the old blocking ObdClient loop.
+ * The adapter model: 38400 baud (3.84 bytes/ms), ECU answers after a fixed latency, then the ELM waits
+ * for further ECUs (adaptive timeout) unless the request carries a response count.
+ * Run: pio test -e native -f native/test_obd_session
+ */
+#include <unity.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include "ObdSession.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* ── Simulated ELM327 ───────────────────────────────────────────────────── */
+struct SimElm {
+  /* Config */
+  bool can = true;            /* ISO 15765; false = ISO 9141 K-line (one PID per request) */
+  bool multiPid = true;       /* false: clone answers '?' to multi-PID requests */
+  bool ecuOn = true;          /* false: NO DATA (ignition off) */
+  bool mute = false;          /* swallow commands (adapter hung / unplugged) */
+  uint32_t ecuLatencyMs = 25;
+  uint32_t supported[3] = {
+      /* 0100: 05, 0C, 0D, 20 */
+      (1u << (32 - 0x05)) | (1u << (32 - 0x0C)) | (1u << (32 - 0x0D)) | 1u,
+      /* 0120: 40 */
+      1u,
+      /* 0140: 5C */
+      1u << (32 - (0x5C - 0x40)),
+  };
+  /* AT state */
+  bool echo = true, spaces = true, linefeeds = true;
+  int adaptive = 1;
+
+  std::deque<std::pair<uint32_t, char>> out;
+  std::string cmd;
+  uint32_t requests = 0;
+  int rpm = 800;
+
+  uint32_t adaptiveWaitMs() const { return adaptive == 0 ? 200 : adaptive == 1 ? 60 : 30; }
+
+  void emit(uint32_t at, const std::string &s) {
+    /* 10 bits per byte at 38400 baud */
+    for (size_t i = 0; i < s.size(); i++)
+      out.push_back({at + (uint32_t)(i * 10 / 38), s[i]});
+  }
+  std::string eol() const { return linefeeds ? "\r\n" : "\r"; }
+  std::string hex(uint8_t b) const {
+    char t[3];
+    snprintf(t, sizeof(t), "%02X", b);
+    return t;
+  }
+  std::string bytes(const uint8_t *b, size_t n) const {
+    std::string s;
+    for (size_t i = 0; i < n; i++) {
+      if (spaces && i)
+        s += ' ';
+      s += hex(b[i]);
+    }
+    return s;
+  }
+
+  void write(const char *data, size_t len, uint32_t now) {
+    for (size_t i = 0; i < len; i++) {
+      if (data[i] == '\r') {
+        handle(now);
+        cmd.clear();
+      } else if (data[i] != ' ') {
+        cmd += data[i];
+      }
+    }
+  }
+
+  size_t read(char *buf, size_t cap, uint32_t now) {
+    size_t n = 0;
+    while (n < cap && !out.empty() && out.front().first <= now) {
+      buf[n++] = out.front().second;
+      out.pop_front();
+    }
+    return n;
+  }
+
+  int pidSize(uint8_t pid) const {
+    switch (pid) {
+      case 0x00: case 0x20: case 0x40: return 4;
+      case 0x0C: return 2;
+      case 0x05: case 0x0D: case 0x5C: return 1;
+      default: return -1;
+    }
+  }
+  bool isSupported(uint8_t pid) const {
+    if (pid == 0)
+      return true;
+    const int idx = (pid - 1) / 32;
+    return idx < 3 && ((supported[idx] >> (31 - (pid - 1) % 32)) & 1u);
+  }
+
+  void handle(uint32_t now) {
+    if (mute)
+      return;
+    if (!out.empty() && out.back().first > now) {
+      /* Input while a reply is still coming: the ELM aborts it. */
+      while (!out.empty() && out.back().first > now)
+        out.pop_back();
+      emit(now + 1, "STOPPED" + eol() + eol() + ">");
+      return;
+    }
+    std::string prefix = echo ? cmd + eol() : "";
+    if (cmd.empty()) {
+      emit(now, prefix + ">");
+      return;
+    }
+    if (cmd.rfind("AT", 0) == 0) {
+      std::string c = cmd.substr(2), reply = "OK";
+      uint32_t delay = 1;
+      if (c == "Z") {
+        echo = spaces = linefeeds = true;
+        adaptive = 1;
+        reply = eol() + "ELM327 v1.5";
+        delay = 800;
+      } else if (c == "E0") {
+        echo = false;
+      } else if (c == "L0") {
+        linefeeds = false;
+      } else if (c == "S0") {
+        spaces = false;
+      } else if (c.rfind("AT", 0) == 0) {
+        adaptive = c[2] - '0';
+      } else if (c == "DPN") {
+        reply = can ? "A6" : "A3";
+      }
+      emit(now + delay, prefix + reply + eol() + eol() + ">");
+      return;
+    }
+    /* Mode 01: "01" + PID pairs + optional response count digit */
+    requests++;
+    const bool count = cmd.size() % 2 == 1;
+    const size_t pairs = (cmd.size() - 2) / 2;
+    uint8_t pids[8];
+    size_t np = 0;
+    for (size_t i = 0; i < pairs && np < 8; i++)
+      pids[np++] = (uint8_t)strtol(cmd.substr(2 + 2 * i, 2).c_str(), nullptr, 16);
+    uint32_t t = now + ecuLatencyMs;
+    if (!ecuOn) {
+      emit(t + adaptiveWaitMs(), prefix + "NO DATA" + eol() + eol() + ">");
+      return;
+    }
+    if (np > 1 && (!multiPid || !can)) {
+      if (!multiPid) {
+        emit(now + 1, prefix + "?" + eol() + eol() + ">");
+        return;
+      }
+      np = 1;  /* K-line ECU answers the first PID only */
+    }
+    uint8_t reply[48];
+    size_t n = 0;
+    reply[n++] = 0x41;
+    for (size_t i = 0; i < np; i++) {
+      if (pidSize(pids[i]) < 0 || !isSupported(pids[i]))
+        continue;
+      reply[n++] = pids[i];
+      switch (pids[i]) {
+        case 0x00: case 0x20: case 0x40: {
+          const uint32_t m = supported[pids[i] / 32];
+          reply[n++] = (uint8_t)(m >> 24);
+          reply[n++] = (uint8_t)(m >> 16);
+          reply[n++] = (uint8_t)(m >> 8);
+          reply[n++] = (uint8_t)m;
+          break;
+        }
+        case 0x0C:
+          rpm = rpm >= 6500 ? 800 : rpm + 37;
+          reply[n++] = (uint8_t)((rpm * 4) >> 8);
+          reply[n++] = (uint8_t)(rpm * 4);
+          break;
+        case 0x05: reply[n++] = 88 + 40; break;
+        case 0x0D: reply[n++] = 63; break;
+        case 0x5C: reply[n++] = 97 + 40; break;
+      }
+    }
+    if (n == 1) {
+      emit(t + adaptiveWaitMs(), prefix + "NO DATA" + eol() + eol() + ">");
+      return;
+    }
+    if (!can)
+      t += 30;  /* K-line: 10.4 kbaud frames + P2 gap */
+    std::string body;
+    if (!can || n <= 7) {
+      body = bytes(reply, n) + eol();
+    } else {
+      /* ISO-TP as the ELM prints it with headers off: length, then indexed 6 / 7 byte frames. */
+      char len[8];
+      snprintf(len, sizeof(len), "%03X", (unsigned)n);
+      body = std::string(len) + eol();
+      size_t off = 0;
+      for (int idx = 0; off < n; idx++) {
+        const size_t take = idx == 0 ? 6 : 7;
+        const size_t k = n - off < take ? n - off : take;
+        char ix[4];
+        snprintf(ix, sizeof(ix), "%X:", idx & 0xF);
+        body += std::string(ix) + (spaces ? " " : "") + bytes(reply + off, k) + eol();
+        off += k;
+        t += 1;  /* consecutive frame spacing */
+      }
+    }
+    if (!count)
+      t += adaptiveWaitMs();
+    emit(t, prefix + body + eol() + ">");
+  }
+};
+
+/* ── Drivers ────────────────────────────────────────────────────────────── */
+struct RunStats {
+  uint32_t rpmSamples = 0;
+  uint32_t coolantSamples = 0;
+  uint32_t oilSamples = 0;
+  uint32_t speedSamples = 0;
+  uint32_t maxStallMs = 0;     /* simulated time one tick() held the loop */
+  double maxTickUs = 0;        /* host wall time of one session tick */
+};
+
+static void configure(ObdSession &s) {
+  s.addPid(OBD_PID_RPM, 0);
+  s.addPid(OBD_PID_SPEED, 200);
+  s.addPid(OBD_PID_COOLANT, 2000);
+  s.addPid(OBD_PID_OIL, 2000);
+}
+
+/** What the new ObdClient::tick() does: drain, feed, maybe send. Loop passes every loopMs. */
+static RunStats runSession(SimElm &elm, ObdSession &s, uint32_t fromMs, uint32_t toMs, uint32_t loopMs) {
+  RunStats r;
+  char buf[64], cmd[32];
+  const uint32_t rpm0 = s.samples(OBD_PID_RPM), cool0 = s.samples(OBD_PID_COOLANT);
+  const uint32_t oil0 = s.samples(OBD_PID_OIL), spd0 = s.samples(OBD_PID_SPEED);
+  for (uint32_t now = fromMs; now < toMs; now += loopMs) {
+    const auto t0 = std::chrono::steady_clock::now();
+    size_t n;
+    while ((n = elm.read(buf, sizeof(buf), now)) > 0)
+      s.feed(buf, n, now);
+    const size_t c = s.poll(now, cmd, sizeof(cmd));
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    if (c)
+      elm.write(cmd, c, now);
+    if (us > r.maxTickUs)
+      r.maxTickUs = us;
+  }
+  r.rpmSamples = s.samples(OBD_PID_RPM) - rpm0;
+  r.coolantSamples = s.samples(OBD_PID_COOLANT) - cool0;
+  r.oilSamples = s.samples(OBD_PID_OIL) - oil0;
+  r.speedSamples = s.samples(OBD_PID_SPEED) - spd0;
+  return r;
+}
+
+/** The previous ObdClient: one PID per request, readLine() busy-waiting up to 200 ms inside tick(). */
+struct LegacyClient {
+  enum State { IDLE, INIT, REQ_RPM, WAIT_RPM, REQ_COOLANT, WAIT_COOLANT, REQ_OIL, WAIT_OIL };
+  /* Starts past its ATZ: with echo on (the ATZ default) the first readLine() returns the echo and RPM
+   * is never parsed. Measured with echo off, its best case. */
+  State state = IDLE;
+  uint32_t stateStartMs = 0;
+  int lastRpm = 0;
+  RunStats stats;
+
+  bool readLine(SimElm &elm, uint32_t &clock, char *line, size_t max, uint32_t timeoutMs) {
+    const uint32_t start = clock;
+    size_t i = 0;
+    while (clock - start < timeoutMs && i < max - 1) {
+      char c;
+      if (elm.read(&c, 1, clock) == 1) {
+        if (c == '\r' || c == '\n') {
+          if (i > 0)
+            break;
+          continue;
+        }
+        if (c >= ' ' && c <= '~')
+          line[i++] = c;
+      } else {
+        clock++;
+      }
+    }
+    line[i] = '\0';
+    return i > 0;
+  }
+  static int parse(const char *line, const char *key, const char *key2, int bytes) {
+    const char *p = strstr(line, key);
+    if (p)
+      p += 6;
+    else if ((p = strstr(line, key2)) != nullptr)
+      p += 4;
+    else
+      return -1;
+    unsigned a = 0, b = 0;
+    if (bytes == 2)
+      return sscanf(p, "%x %x", &a, &b) >= 2 ? (int)((a * 256u + b) / 4) : -1;
+    return sscanf(p, "%x", &a) >= 1 ? (int)a - 40 : -1;
+  }
+  void send(SimElm &elm, const char *c, uint32_t now) {
+    std::string s = std::string(c) + "\r";
+    elm.write(s.c_str(), s.size(), now);
+  }
+  void tick(SimElm &elm, uint32_t &clock) {
+    const uint32_t now = clock;
+    char line[64];
+    switch (state) {
+      case IDLE:
+        if (now - stateStartMs >= 500) { state = REQ_RPM; stateStartMs = now; }
+        break;
+      case INIT:
+        if (now - stateStartMs >= 500) { send(elm, "ATZ", now); state = REQ_RPM; stateStartMs = now; }
+        break;
+      case REQ_RPM: send(elm, "01 0C", now); state = WAIT_RPM; stateStartMs = now; break;
+      case WAIT_RPM:
+        if (readLine(elm, clock, line, sizeof(line), 200)) {
+          const int r = parse(line, "41 0C", "410C", 2);
+          if (r >= 0) { lastRpm = r; stats.rpmSamples++; }
+        }
+        if (now - stateStartMs >= 1500 || lastRpm >= 0 || now - stateStartMs > 300) {
+          state = REQ_COOLANT;
+          stateStartMs = now;
+        }
+        break;
+      case REQ_COOLANT: send(elm, "01 05", now); state = WAIT_COOLANT; stateStartMs = now; break;
+      case WAIT_COOLANT:
+        if (readLine(elm, clock, line, sizeof(line), 200) && parse(line, "41 05", "4105", 1) >= -40)
+          stats.coolantSamples++;
+        if (now - stateStartMs > 300) { state = REQ_OIL; stateStartMs = now; }
+        break;
+      case REQ_OIL: send(elm, "01 5C", now); state = WAIT_OIL; stateStartMs = now; break;
+      case WAIT_OIL:
+        if (readLine(elm, clock, line, sizeof(line), 200) && parse(line, "41 5C", "415C", 1) >= -40)
+          stats.oilSamples++;
+        if (now - stateStartMs > 300) { state = IDLE; stateStartMs = now; }
+        break;
+    }
+    const uint32_t stall = clock - now;
+    if (stall > stats.maxStallMs)
+      stats.maxStallMs = stall;
+  }
+};
+
+/* ── Tests ──────────────────────────────────────────────────────────────── */
+
+void test_line_assembly_any_chunking(void) {
+  ObdSession s;
+  configure(s);
+  s.reset(0);
+  /* Drive init by hand: every command answered OK, 0100 with a bitmap, ATDPN with CAN. */
+  char cmd[32];
+  const char *replies[] = {"\r\rELM327 v1.5\r\r>", "OK\r\r>", "OK\r\r>", "OK\r\r>", "OK\r\r>", "OK\r\r>",
+                           "OK\r\r>", "SEARCHING...\r4100BE3FA813\r\r>", "A6\r\r>"};
+  uint32_t t = 0;
+  for (const char *r : replies) {
+    TEST_ASSERT_TRUE(s.poll(t, cmd, sizeof(cmd)) > 0);
+    /* one byte at a time */
+    for (const char *p = r; *p; p++)
+      s.feed(p, 1, t);
+    t += 10;
+  }
+  /* 0x20 bit of the bitmap is set (0x13 ends in 1) and oil 0x5C is configured: 0120 then ... */
+  TEST_ASSERT_TRUE(s.poll(t, cmd, sizeof(cmd)) > 0);
+  TEST_ASSERT_EQUAL_STRING("0120\r", cmd);
+  s.feed("4120A005B011\r\r>", 15, t);
+  TEST_ASSERT_TRUE(s.poll(t, cmd, sizeof(cmd)) > 0);
+  TEST_ASSERT_EQUAL_STRING("0140\r", cmd);
+  s.feed("414044CC0010\r\r>", 15, t);
+  TEST_ASSERT_TRUE(s.initialized());
+  TEST_ASSERT_TRUE(s.canBus());
+  /* 0x5C is bit 4 of the 0140 bitmap (0x...10). */
+  TEST_ASSERT_TRUE(s.pidActive(OBD_PID_OIL));
+
+  /* All four due: one request; 8-byte reply is multi-frame, so no response count. */
+  TEST_ASSERT_TRUE(s.poll(t, cmd, sizeof(cmd)) > 0);
+  TEST_ASSERT_EQUAL_STRING("010C0D055C\r", cmd);
+  const char *mf = "00A\r0:410C1AF80D3F\r1:057B5C89000000\r\r>";
+  s.feed(mf, 20, t + 30);
+  s.feed(mf + 20, strlen(mf) - 20, t + 31);
+  int32_t v = 0;
+  TEST_ASSERT_TRUE(s.value(OBD_PID_RPM, &v));
+  TEST_ASSERT_EQUAL_INT32(0x1AF8 / 4, v);
+  TEST_ASSERT_TRUE(s.value(OBD_PID_SPEED, &v));
+  TEST_ASSERT_EQUAL_INT32(63, v);
+  TEST_ASSERT_TRUE(s.value(OBD_PID_COOLANT, &v));
+  TEST_ASSERT_EQUAL_INT32(0x7B - 40, v);
+  TEST_ASSERT_TRUE(s.value(OBD_PID_OIL, &v));
+  TEST_ASSERT_EQUAL_INT32(0x89 - 40, v);
+  TEST_ASSERT_TRUE(s.takeUpdate());
+  TEST_ASSERT_FALSE(s.takeUpdate());
+  TEST_ASSERT_EQUAL_UINT32(31, s.rttLastMs());
+
+  /* Only RPM due now: single-frame reply, so the request asks for one response. */
+  TEST_ASSERT_TRUE(s.poll(t + 40, cmd, sizeof(cmd)) > 0);
+  TEST_ASSERT_EQUAL_STRING("010C1\r", cmd);
+  /* Spaces and an extra ECU line are fine too. */
+  const char *sp = "41 0C 0F A0\r41 0C 0F A4\r\r>";
+  s.feed(sp, strlen(sp), t + 60);
+  TEST_ASSERT_TRUE(s.value(OBD_PID_RPM, &v));
+  TEST_ASSERT_EQUAL_INT32(0x0FA4 / 4, v);
+}
+
+void test_unsupported_pid_dropped_and_clone_fallback(void) {
+  SimElm elm;
+  elm.supported[2] = 0;  /* no oil temperature */
+  elm.multiPid = false;  /* clone: '?' on multi-PID */
+  ObdSession s;
+  configure(s);
+  s.reset(0);
+  runSession(elm, s, 0, 20000, 5);
+  TEST_ASSERT_TRUE(s.initialized());
+  TEST_ASSERT_FALSE(s.pidActive(OBD_PID_OIL));
+  TEST_ASSERT_TRUE(s.pidActive(OBD_PID_RPM));
+  TEST_ASSERT_TRUE(s.samples(OBD_PID_RPM) > 100);
+  TEST_ASSERT_TRUE(s.samples(OBD_PID_COOLANT) >= 5);
+  TEST_ASSERT_EQUAL_UINT32(0, s.samples(OBD_PID_OIL));
+}
+
+void test_ignition_off_timeout_and_reset_recovery(void) {
+  SimElm elm;
+  ObdSession s;
+  configure(s);
+  s.reset(0);
+  runSession(elm, s, 0, 10000, 5);
+  TEST_ASSERT_TRUE(s.connected());
+
+  /* Ignition off: NO DATA, disconnected after kEcuLostMs, requests slow down. */
+  elm.ecuOn = false;
+  runSession(elm, s, 10000, 15000, 5);
+  TEST_ASSERT_FALSE(s.connected());
+  TEST_ASSERT_EQUAL_UINT8(OBD_RESP_NO_DATA, s.lastStatus());
+  const uint32_t req0 = elm.requests;
+  runSession(elm, s, 15000, 30000, 5);
+  TEST_ASSERT_TRUE(elm.requests - req0 <= 15000 / ObdSession::kIdleRetryMs + 1);
+
+  elm.ecuOn = true;
+  runSession(elm, s, 30000, 34000, 5);
+  TEST_ASSERT_TRUE(s.connected());
+
+  /* Adapter hangs: timeouts, CR resync, then ATZ and a full re-init once it is back. */
+  elm.mute = true;
+  runSession(elm, s, 34000, 40000, 5);
+  TEST_ASSERT_TRUE(s.timeouts() >= 3);
+  TEST_ASSERT_TRUE(s.resets() >= 1);
+  TEST_ASSERT_FALSE(s.connected());
+  elm.mute = false;
+  const uint32_t rpm0 = s.samples(OBD_PID_RPM);
+  runSession(elm, s, 40000, 60000, 5);
+  TEST_ASSERT_TRUE(s.initialized());
+  TEST_ASSERT_TRUE(s.connected());
+  TEST_ASSERT_TRUE(s.samples(OBD_PID_RPM) > rpm0 + 100);
+}
+
+void test_throughput_vs_legacy(void) {
+  const uint32_t kRunMs = 60000;
+  /* Legacy loop: 5 ms loop, blocking readLine. */
+  SimElm legacyElm;
+  legacyElm.echo = false;  /* the old client never sent ATE0; echo off gives it its best case */
+  LegacyClient legacy;
+  for (uint32_t clock = 0; clock < kRunMs;) {
+    legacy.tick(legacyElm, clock);
+    clock += 5;
+  }
+  const double secs = kRunMs / 1000.0;
+
+  struct Case {
+    const char *name;
+    bool can;
+    bool multi;
+  } cases[] = {{"CAN, multi-PID", true, true}, {"CAN, clone (1 PID)", true, false}, {"K-line", false, true}};
+  printf("  60 s, 5 ms loop, ECU latency 25 ms:\n");
+  printf("    %-22s rpm %5.1f/s  speed %4.1f/s  coolant %4.2f/s  oil %4.2f/s  stall max %u ms\n", "legacy blocking",
+         legacy.stats.rpmSamples / secs, 0.0, legacy.stats.coolantSamples / secs, legacy.stats.oilSamples / secs,
+         (unsigned)legacy.stats.maxStallMs);
+  double canRpm = 0;
+  for (const Case &c : cases) {
+    SimElm elm;
+    elm.can = c.can;
+    elm.multiPid = c.multi;
+    ObdSession s;
+    configure(s);
+    s.reset(0);
+    /* Rates measured after init (ATZ + search). */
+    runSession(elm, s, 0, 5000, 5);
+    RunStats r = runSession(elm, s, 5000, 5000 + kRunMs, 5);
+    printf("    %-22s rpm %5.1f/s  speed %4.1f/s  coolant %4.2f/s  oil %4.2f/s  stall max 0 ms (tick %.1f us), "
+           "rtt avg %u max %u ms\n",
+           c.name, r.rpmSamples / secs, r.speedSamples / secs, r.coolantSamples / secs, r.oilSamples / secs,
+           r.maxTickUs, (unsigned)s.rttAvgMs(), (unsigned)s.rttMaxMs());
+    TEST_ASSERT_TRUE(s.rate(OBD_PID_RPM) > 0);
+    if (c.can && c.multi)
+      canRpm = r.rpmSamples / secs;
+    /* Per-PID rates hold on every bus. */
+    TEST_ASSERT_TRUE(r.coolantSamples / secs > 0.4);
+    TEST_ASSERT_TRUE(r.speedSamples / secs > (c.can ? 4.0 : 2.0));
+  }
+  /* Old loop: ~2 Hz RPM and a 200 ms stall; new: many times the RPM rate and no stall. */
+  TEST_ASSERT_TRUE(legacy.stats.maxStallMs >= 150);
+  TEST_ASSERT_TRUE(canRpm > 5 * (legacy.stats.rpmSamples / secs));
+  TEST_ASSERT_TRUE(canRpm > 15.0);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_line_assembly_any_chunking);
+  RUN_TEST(test_unsupported_pid_dropped_and_clone_fallback);
+  RUN_TEST(test_ignition_off_timeout_and_reset_recovery);
+  RUN_TEST(test_throughput_vs_legacy);
+  return UNITY_END();
+}
@@ -0,0 +1,215 @@
+/*
+ * Host tests: ELM327 TCP transport (ObdTcpTransport.cpp, TcpStream.cpp) against a loopback listener
+ * standing in for a Wi-Fi adapter: non-blocking connect, refused / unreachable servers with backoff, peer close and
+ * reconnect, a silent peer, and a session running over it. Time is passed in, so retry delays and
+ * timeouts take no wall time; every poll() is also timed to show that none of them waits.
+ * Run: pio test -e native -f native/test_obd_tcp
+ */
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "ObdSession.h"
+#include "ObdTcpTransport.h"
+#include "../TcpTestUtil.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/** Poll until up (loopback connects within a few polls); returns the server side socket. */
+static int connectTo(ObdTcpTransport &t, Listener &l, uint32_t &now) {
+  int srv = -1;
+  for (int i = 0; i < 200 && (!t.ready() || srv < 0); i++) {
+    timedPoll(t, now);
+    if (srv < 0)
+      srv = l.accept();
+    now += 1;
+    usleep(200);
+  }
+  return srv;
+}
+
+void test_connect_exchange_and_peer_close(void) {
+  Listener l;
+  ObdTcpTransport t;
+  TEST_ASSERT_FALSE(t.setServer("not an ip", l.port));
+  TEST_ASSERT_TRUE(t.setServer("127.0.0.1", l.port));
+  uint32_t now = 1000;
+  const int srv = connectTo(t, l, now);
+  TEST_ASSERT_TRUE(srv >= 0);
+  TEST_ASSERT_TRUE(t.ready());
+  TEST_ASSERT_TRUE(t.takeConnected());
+  TEST_ASSERT_FALSE(t.takeConnected());
+  TEST_ASSERT_EQUAL_UINT32(1, t.connects());
+
+  TEST_ASSERT_TRUE(t.write("010C\r", 5));
+  char buf[32];
+  ssize_t n = -1;
+  for (int i = 0; i < 100 && n <= 0; i++, usleep(200))
+    n = recv(srv, buf, sizeof(buf), 0);
+  TEST_ASSERT_EQUAL_INT(5, (int)n);
+  TEST_ASSERT_EQUAL_MEMORY("010C\r", buf, 5);
+  TEST_ASSERT_EQUAL_UINT(0, t.read(buf, sizeof(buf)));  /* nothing yet: returns at once */
+  TEST_ASSERT_EQUAL_INT(12, (int)send(srv, "410C1AF8\r\r>", 12, 0));
+  size_t got = 0;
+  for (int i = 0; i < 100 && got < 12; i++, usleep(200))
+    got += t.read(buf + got, sizeof(buf) - got);
+  TEST_ASSERT_EQUAL_UINT(12, got);
+  TEST_ASSERT_EQUAL_MEMORY("410C1AF8\r\r>", buf, 12);
+
+  /* Adapter closes the connection: dropped, reconnected after the retry delay. */
+  close(srv);
+  for (int i = 0; i < 100 && t.ready(); i++, usleep(200))
+    t.read(buf, sizeof(buf));
+  TEST_ASSERT_FALSE(t.ready());
+  TEST_ASSERT_EQUAL_UINT32(1, t.drops());
+  TEST_ASSERT_FALSE(t.write("010C\r", 5));
+  timedPoll(t, now + ObdTcpTransport::kRetryMinMs - 10);
+  TEST_ASSERT_FALSE(t.connecting() || t.ready());
+  now += ObdTcpTransport::kRetryMinMs;
+  const int srv2 = connectTo(t, l, now);
+  TEST_ASSERT_TRUE(srv2 >= 0 && t.ready());
+  TEST_ASSERT_TRUE(t.takeConnected());
+  TEST_ASSERT_EQUAL_UINT32(2, t.connects());
+  close(srv2);
+}
+
+void test_refused_backoff_never_blocks(void) {
+  uint16_t port;
+  {
+    Listener gone;  /* bound then closed: nothing listens there */
+    port = gone.port;
+  }
+  ObdTcpTransport t;
+  TEST_ASSERT_TRUE(t.setServer("127.0.0.1", port));
+  s_pollMaxUs = 0;
+  uint32_t now = 0;
+  uint32_t attempts[6];
+  uint32_t n = 0;
+  for (; now < 20000 && n < 6; now += 5) {
+    const uint32_t f0 = t.failures();
+    timedPoll(t, now);
+    if (t.failures() != f0)
+      attempts[n++] = now;
+  }
+  TEST_ASSERT_EQUAL_UINT32(6, n);
+  printf("    refused: attempts at %u %u %u %u %u %u ms, slowest poll %.0f us\n", (unsigned)attempts[0],
+         (unsigned)attempts[1], (unsigned)attempts[2], (unsigned)attempts[3], (unsigned)attempts[4],
+         (unsigned)attempts[5], s_pollMaxUs);
+  /* 500, 1000, 2000, 4000, 8000, 8000 (+ loop granularity). */
+  TEST_ASSERT_UINT32_WITHIN(10, 500, attempts[1] - attempts[0]);
+  TEST_ASSERT_UINT32_WITHIN(10, 1000, attempts[2] - attempts[1]);
+  TEST_ASSERT_UINT32_WITHIN(10, 2000, attempts[3] - attempts[2]);
+  TEST_ASSERT_UINT32_WITHIN(10, 8000, attempts[5] - attempts[4]);
+  TEST_ASSERT_TRUE(s_pollMaxUs < 2000);
+
+  /* Network down: no attempts at all; back up: first attempt at once. */
+  t.setNetworkUp(false);
+  const uint32_t f0 = t.failures();
+  for (uint32_t i = 0; i < 100; i++)
+    timedPoll(t, now += 100);
+  TEST_ASSERT_EQUAL_UINT32(f0, t.failures());
+  t.setNetworkUp(true);
+  timedPoll(t, now);
+  TEST_ASSERT_TRUE(t.connecting() || t.failures() == f0 + 1);
+  timedPoll(t, now + 5);
+  TEST_ASSERT_EQUAL_UINT32(f0 + 1, t.failures());
+}
+
+void test_unreachable_times_out(void) {
+  /* TEST-NET-1: either the stack refuses at once (no route) or the SYN goes nowhere until the
+   * connect timeout. Either way it fails without ever waiting in poll(). */
+  ObdTcpTransport t;
+  TEST_ASSERT_TRUE(t.setServer("192.0.2.1", 35000));
+  s_pollMaxUs = 0;
+  for (uint32_t now = 0; now <= ObdTcpTransport::kConnectTimeoutMs; now += 50)
+    timedPoll(t, now);
+  printf("    unreachable: %u failure(s), slowest poll %.0f us\n", (unsigned)t.failures(), s_pollMaxUs);
+  TEST_ASSERT_TRUE(t.failures() >= 1);
+  TEST_ASSERT_FALSE(t.ready());
+  TEST_ASSERT_TRUE(s_pollMaxUs < 2000);
+}
+
+void test_silent_peer_dropped(void) {
+  Listener l;
+  ObdTcpTransport t;
+  t.setServer("127.0.0.1", l.port);
+  uint32_t now = 0;
+  const int srv = connectTo(t, l, now);
+  TEST_ASSERT_TRUE(srv >= 0);
+  timedPoll(t, now);
+  TEST_ASSERT_TRUE(t.write("ATZ\r", 4));
+  /* Adapter out of Wi-Fi range: no FIN, no reply. */
+  timedPoll(t, now + ObdTcpTransport::kSilentDropMs - 1);
+  TEST_ASSERT_TRUE(t.ready());
+  timedPoll(t, now + ObdTcpTransport::kSilentDropMs);
+  TEST_ASSERT_FALSE(t.ready());
+  TEST_ASSERT_EQUAL_UINT32(1, t.drops());
+  close(srv);
+}
+
+/* ObdSession over the transport: ObdClient::tick() in miniature against a scripted adapter. */
+void test_session_over_tcp(void) {
+  Listener l;
+  ObdTcpTransport t;
+  t.setServer("127.0.0.1", l.port);
+  ObdSession s;
+  s.addPid(OBD_PID_RPM, 0);
+  uint32_t now = 0;
+  const int srv = connectTo(t, l, now);
+  TEST_ASSERT_TRUE(srv >= 0 && t.takeConnected());
+  s.reset(now);
+  char in[128];
+  size_t inLen = 0;
+  for (int i = 0; i < 4000 && s.samples(OBD_PID_RPM) < 5; i++, now++) {
+    t.poll(now);
+    char buf[64];
+    size_t n;
+    while ((n = t.read(buf, sizeof(buf))) > 0)
+      s.feed(buf, n, now);
+    char cmd[24];
+    const size_t len = s.poll(now, cmd, sizeof(cmd));
+    if (len > 0)
+      TEST_ASSERT_TRUE(t.write(cmd, len));
+    /* Adapter: one reply per CR-terminated command. */
+    const ssize_t r = recv(srv, in + inLen, sizeof(in) - inLen, MSG_DONTWAIT);
+    if (r > 0)
+      inLen += (size_t)r;
+    char *cr;
+    while ((cr = (char *)memchr(in, '\r', inLen)) != nullptr) {
+      *cr = '\0';
+      const char *reply = "OK\r\r>";
+      if (!strcmp(in, "ATZ"))
+        reply = "\r\rELM327 v1.5\r\r>";
+      else if (!strcmp(in, "ATDPN"))
+        reply = "A6\r\r>";
+      else if (!strncmp(in, "0100", 4))
+        reply = "4100BE3EB811\r\r>";
+      else if (!strncmp(in, "01", 2))
+        reply = "410C1AF8\r\r>";
+      send(srv, reply, strlen(reply), 0);
+      inLen -= (size_t)(cr + 1 - in);
+      memmove(in, cr + 1, inLen);
+    }
+    usleep(100);
+  }
+  int32_t v = 0;
+  TEST_ASSERT_TRUE(s.initialized());
+  TEST_ASSERT_TRUE(s.value(OBD_PID_RPM, &v));
+  TEST_ASSERT_EQUAL_INT32(1726, v);
+  TEST_ASSERT_EQUAL_UINT32(0, t.drops());
+  close(srv);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_exchange_and_peer_close);
+  RUN_TEST(test_refused_backoff_never_blocks);
+  RUN_TEST(test_unreachable_times_out);
+  RUN_TEST(test_silent_peer_dropped);
+  RUN_TEST(test_session_over_tcp);
+  return UNITY_END();
+}
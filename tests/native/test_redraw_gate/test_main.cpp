@@ -0,0 +1,218 @@
+/*
+ * Host tests: field-level change tracking — change bits from both monitor decoders (MonitorDecoder,
+ * MonitorBinaryDecoder), the scene → field map and draw decision of RedrawGate.cpp — and frames drawn,
+ * frames avoided and I2C bytes saved per minute on every scene under a realistic payload stream.
+ * Run: pio test -e native -f native/test_redraw_gate
+ */
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include "MonitorBinary.h"
+#include "MonitorDecoder.h"
+#include "RedrawGate.h"
+#include "nocturne/config.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static bool decode(MonitorDecoder &d, const char *s, AppState *st) { return d.decode(s, strlen(s), st); }
+
+void test_scene_fields(void) {
+  const FieldMask common = fieldBit(SF_BATTERY) | fieldBit(SF_ALERT);
+  for (int s = 0; s < NOCT_TOTAL_SCENES; s++)
+    TEST_ASSERT_TRUE((RedrawGate::sceneFields(s) & common) == common);
+  const FieldMask main = RedrawGate::sceneFields(NOCT_SCENE_MAIN);
+  TEST_ASSERT_TRUE(main & fieldBit(SF_CT));
+  TEST_ASSERT_TRUE(main & fieldBit(SF_RU));
+  TEST_ASSERT_FALSE(main & fieldBit(SF_ND)); /* net graphs are not on any scene */
+  TEST_ASSERT_FALSE(main & fieldBit(SF_WEATHER));
+  TEST_ASSERT_TRUE(RedrawGate::sceneFields(NOCT_SCENE_WEATHER) == (common | fieldBit(SF_WEATHER)));
+  TEST_ASSERT_TRUE(RedrawGate::sceneFields(NOCT_SCENE_GPU) & fieldBit(SF_GH));
+  TEST_ASSERT_FALSE(RedrawGate::sceneFields(NOCT_SCENE_GPU) & fieldBit(SF_GT));
+  TEST_ASSERT_TRUE(RedrawGate::sceneFields(NOCT_SCENE_MEDIA) & fieldBit(SF_TRACK));
+  TEST_ASSERT_TRUE(RedrawGate::sceneFields(99) == main);
+}
+
+void test_json_change_bits(void) {
+  MonitorDecoder d;
+  AppState st;
+  TEST_ASSERT_TRUE(decode(d, "{\"ct\":50,\"cl\":10,\"art\":\"A\",\"wt\":5,\"tr\":[{\"n\":\"x\",\"r\":1}]}", &st));
+  const FieldMask first = d.changed();
+  TEST_ASSERT_TRUE(first & fieldBit(SF_CT));
+  TEST_ASSERT_TRUE(first & fieldBit(SF_ARTIST));
+  TEST_ASSERT_TRUE(first & fieldBit(SF_WEATHER));
+  TEST_ASSERT_TRUE(first & fieldBit(SF_TOP_RAM));
+  TEST_ASSERT_FALSE(first & fieldBit(SF_GT));
+  TEST_ASSERT_TRUE(decode(d, "{\"ct\":50,\"cl\":10,\"art\":\"A\",\"wt\":5,\"tr\":[{\"n\":\"x\",\"r\":1}]}", &st));
+  TEST_ASSERT_TRUE(d.changed() == 0);
+  TEST_ASSERT_TRUE(decode(d, "{\"ct\":51,\"cl\":10,\"art\":\"A\",\"wt\":5,\"tr\":[{\"n\":\"x\",\"r\":1}]}", &st));
+  TEST_ASSERT_TRUE(d.changed() == fieldBit(SF_CT));
+  TEST_ASSERT_TRUE(decode(d, "{\"ct\":51,\"cl\":10,\"art\":\"A\",\"wt\":5,\"tr\":[{\"n\":\"x\",\"r\":2}],"
+                             "\"hdd\":[{\"n\":\"C\",\"t\":40}]}", &st));
+  TEST_ASSERT_TRUE(d.changed() == (fieldBit(SF_TOP_RAM) | fieldBit(SF_HDD)));
+  TEST_ASSERT_TRUE(decode(d, "{\"ct\":51,\"cl\":10,\"art\":\"A\",\"wt\":5,\"tr\":[{\"n\":\"x\",\"r\":2}],"
+                             "\"hdd\":[{\"n\":\"C\",\"t\":40}],\"alert\":\"CRITICAL\",\"target_screen\":\"GPU\"}", &st));
+  TEST_ASSERT_TRUE(d.changed() == fieldBit(SF_ALERT));
+  /* A malformed line changes nothing and leaves the last mask. */
+  TEST_ASSERT_FALSE(decode(d, "{\"ct\":99", &st));
+  TEST_ASSERT_EQUAL_INT(51, st.hw.ct);
+}
+
+void test_binary_change_bits(void) {
+  MonitorBinaryEncoder enc;
+  MonitorBinaryDecoder dec;
+  AppState src, st;
+  uint8_t frame[MonitorBinary::kFrameMax];
+  src.hw.ct = 40;
+  src.media.track = "Turbo Killer";
+  size_t n = enc.encode(src, frame, sizeof(frame));
+  TEST_ASSERT_TRUE(dec.decode(frame + MonitorBinary::kHeader, n - MonitorBinary::kHeader, &st));
+  TEST_ASSERT_TRUE(dec.changed() == (fieldBit(SF_CT) | fieldBit(SF_TRACK)));
+  n = enc.encode(src, frame, sizeof(frame));
+  TEST_ASSERT_TRUE(dec.decode(frame + MonitorBinary::kHeader, n - MonitorBinary::kHeader, &st));
+  TEST_ASSERT_TRUE(dec.changed() == 0);
+  src.hw.fan_controls[2] = 55;
+  src.hw.ru = 12.3f;
+  src.media.mediaStatus = "PLAYING";
+  src.process.cpuNames[1] = "Code.exe";
+  n = enc.encode(src, frame, sizeof(frame));
+  TEST_ASSERT_TRUE(dec.decode(frame + MonitorBinary::kHeader, n - MonitorBinary::kHeader, &st));
+  TEST_ASSERT_TRUE(dec.changed() == (fieldBit(SF_FAN_CONTROLS) | fieldBit(SF_RU) | fieldBit(SF_MEDIA_STATE) |
+                                     fieldBit(SF_TOP_CPU)));
+  /* Keyframe resends everything; only what differs counts. */
+  enc.setKeyframesOnly(true);
+  n = enc.encode(src, frame, sizeof(frame));
+  TEST_ASSERT_TRUE(dec.decode(frame + MonitorBinary::kHeader, n - MonitorBinary::kHeader, &st));
+  TEST_ASSERT_TRUE(dec.changed() == 0);
+}
+
+void test_gate_decisions(void) {
+  RedrawGate g;
+  TEST_ASSERT_TRUE(g.shouldDraw(NOCT_SCENE_CPU, 0)); /* first frame */
+  TEST_ASSERT_FALSE(g.shouldDraw(NOCT_SCENE_CPU, 0));
+  g.markChanged(fieldBit(SF_GH) | fieldBit(SF_WEATHER)); /* not on the CPU scene */
+  TEST_ASSERT_FALSE(g.shouldDraw(NOCT_SCENE_CPU, 0));
+  g.markChanged(fieldBit(SF_PW));
+  TEST_ASSERT_TRUE(g.shouldDraw(NOCT_SCENE_CPU, 0));
+  TEST_ASSERT_FALSE(g.shouldDraw(NOCT_SCENE_CPU, 0));
+  TEST_ASSERT_TRUE(g.shouldDraw(NOCT_SCENE_CPU, 1)); /* animation step */
+  TEST_ASSERT_TRUE(g.shouldDraw(NOCT_SCENE_GPU, 1)); /* scene switch */
+  g.invalidate();
+  TEST_ASSERT_TRUE(g.shouldDraw(NOCT_SCENE_GPU, 1));
+  g.markChanged(fieldBit(SF_BATTERY));
+  TEST_ASSERT_TRUE(g.shouldDraw(NOCT_SCENE_GPU, 1));
+  TEST_ASSERT_EQUAL_UINT32(6, g.drawn());
+  TEST_ASSERT_EQUAL_UINT32(3, g.skipped());
+  TEST_ASSERT_TRUE(g.i2cBytesSaved() == 3ull * RedrawGate::kFrameI2cBytes);
+  uint32_t drawn = 0, skipped = 0;
+  TEST_ASSERT_FALSE(g.report(1000, &drawn, &skipped));
+  TEST_ASSERT_FALSE(g.report(1000 + RedrawGate::kReportMs - 1, &drawn, &skipped));
+  TEST_ASSERT_TRUE(g.report(1000 + RedrawGate::kReportMs, &drawn, &skipped));
+  TEST_ASSERT_EQUAL_UINT32(6, drawn);
+  TEST_ASSERT_EQUAL_UINT32(3, skipped);
+}
+
+/* ── One minute per scene: 2 Hz payloads (assumed server cadence) with realistic change rates ── */
+
+struct Sim {
+  uint32_t rng = 12345;
+  int ct = 55, gt = 60, cl = 12, gl = 30, cc = 4200, pw = 65, gh = 58, gclock = 1800, vu10 = 42, ru10 = 114;
+  int cf = 1200, s1 = 900, gf = 1400, s2 = 0, fc = 45, hddT = 36, mbSys = 38, mbVrm = 50, tp = 12, tr = 2300;
+  int procA = 0;
+
+  uint32_t rnd(uint32_t n) {
+    rng = rng * 1103515245u + 12345u;
+    return (rng >> 8) % n;
+  }
+  /* With probability pct, step v by -1..+1 times step (step 0 excluded). */
+  void walk(int &v, int pct, int step) {
+    if ((int)rnd(100) < pct)
+      v += rnd(2) ? step : -step;
+  }
+  void step() {
+    walk(ct, 30, 1);
+    walk(gt, 25, 1);
+    walk(cl, 90, 3);
+    walk(gl, 80, 2);
+    walk(cc, 70, 25);
+    walk(pw, 80, 2);
+    walk(gh, 25, 1);
+    walk(gclock, 60, 15);
+    walk(vu10, 10, 1);
+    walk(ru10, 30, 1);
+    walk(cf, 50, 10);
+    walk(s1, 50, 10);
+    walk(gf, 50, 10);
+    walk(fc, 10, 1);
+    walk(hddT, 2, 1);
+    walk(mbSys, 10, 1);
+    walk(mbVrm, 10, 1);
+    walk(tp, 60, 1);
+    walk(tr, 50, 10);
+    if (rnd(100) < 5)
+      procA ^= 1;
+  }
+  size_t json(char *out, size_t cap) const {
+    static const char *names[] = {"chrome.exe", "Code.exe"};
+    return (size_t)snprintf(
+        out, cap,
+        "{\"ct\":%d,\"gt\":%d,\"cl\":%d,\"gl\":%d,\"cc\":%d,\"pw\":%d,\"gh\":%d,\"gclock\":%d,\"vu\":%d.%d,"
+        "\"ru\":%d.%d,\"ra\":32.0,\"nd\":%d,\"nu\":%d,\"cf\":%d,\"s1\":%d,\"s2\":%d,\"gf\":%d,"
+        "\"fan_controls\":[%d,80,52,30],\"hdd\":[{\"n\":\"C\",\"u\":412.5,\"tot\":931.0,\"t\":%d}],"
+        "\"mb_sys\":%d,\"mb_vrm\":%d,\"wt\":7,\"wd\":\"Cloudy\",\"wi\":3,"
+        "\"tp\":[{\"n\":\"%s\",\"c\":%d}],\"tr\":[{\"n\":\"%s\",\"r\":%d}],"
+        "\"art\":\"Carpenter Brut\",\"trk\":\"Turbo Killer\",\"mp\":true,\"media_status\":\"PLAYING\","
+        "\"alert\":\"OK\"}",
+        ct, gt, cl, gl, cc, pw, gh, gclock, vu10 / 10, vu10 % 10, ru10 / 10, ru10 % 10, cl * 37, cl * 5, cf, s1, s2,
+        gf, fc, hddT, mbSys, mbVrm, names[procA], tp, names[procA ^ 1], tr);
+  }
+};
+
+void test_realistic_stream(void) {
+  static const char *kNames[NOCT_TOTAL_SCENES] = {"MAIN", "CPU", "GPU", "RAM", "DISKS", "MEDIA", "FANS", "MB", "WEATHER"};
+  const uint32_t kMinuteMs = 60000, kTickMs = NOCT_REDRAW_INTERVAL_MS, kPayloadMs = 500;
+  printf("  one minute per scene, payload every %u ms, GUI tick %u ms:\n", (unsigned)kPayloadMs, (unsigned)kTickMs);
+  printf("    scene     before  drawn  avoided  I2C saved/min\n");
+  uint32_t totalBefore = 0, totalDrawn = 0;
+  for (int scene = 0; scene < NOCT_TOTAL_SCENES; scene++) {
+    Sim sim;
+    MonitorDecoder dec;
+    AppState st;
+    RedrawGate gate;
+    char line[1024];
+    uint32_t before = 0, nextPayload = 0;
+    for (uint32_t now = 0; now < kMinuteMs; now += kTickMs) {
+      while (nextPayload <= now) {
+        sim.step();
+        const size_t n = sim.json(line, sizeof(line));
+        TEST_ASSERT_TRUE(dec.decode(line, n, &st));
+        gate.markChanged(dec.changed());
+        nextPayload += kPayloadMs;
+      }
+      before++; /* old loop: every GUI tick draws and sends */
+      gate.shouldDraw(scene, now / 1000); /* header heartbeat */
+    }
+    printf("    %-8s  %6u  %5u  %6.1f%%  %8.1f KB\n", kNames[scene], (unsigned)before, (unsigned)gate.drawn(),
+           100.0 * gate.skipped() / before, gate.i2cBytesSaved() / 1024.0);
+    TEST_ASSERT_EQUAL_UINT32(before, gate.drawn() + gate.skipped());
+    /* At most one frame per payload plus one per heartbeat second. */
+    TEST_ASSERT_TRUE(gate.drawn() <= kMinuteMs / kPayloadMs + kMinuteMs / 1000 + 1);
+    totalBefore += before;
+    totalDrawn += gate.drawn();
+    if (scene == NOCT_SCENE_WEATHER || scene == NOCT_SCENE_MEDIA)
+      TEST_ASSERT_TRUE(gate.drawn() <= kMinuteMs / 1000 + 2);
+  }
+  printf("    all scenes: %.1f%% of frames avoided\n", 100.0 * (totalBefore - totalDrawn) / totalBefore);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_scene_fields);
+  RUN_TEST(test_json_change_bits);
+  RUN_TEST(test_binary_change_bits);
+  RUN_TEST(test_gate_decisions);
+  RUN_TEST(test_realistic_stream);
+  return UNITY_END();
+}
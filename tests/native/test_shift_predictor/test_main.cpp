@@ -0,0 +1,272 @@
+/*
+ * Host tests: predictive shift light (ShiftPredictor.cpp). RPM traces are replayed through a model of the
+ * firmware pipeline: the ECU samples RPM, the reply arrives a little later (ObdClient stamps it half a
+ * round trip back), the loop runs every few ms and the cue needs output latency to become visible. The
+ * cue time is compared with the moment the true RPM crosses the threshold, for the predictor and for the
+ * naive "last value >= threshold" check BmwManager used before.
+ *
+ * Traces come from a deterministic full-throttle model of an E39 with the 5-speed (per-gear rpm/s from
+ * the torque curve, +-25 rpm noise), not from a car log, so the numbers are reproducible.
+ * Run: pio test -e native -f native/test_shift_predictor
+ */
+#include <unity.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "ShiftPredictor.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* km/h per 1000 rpm * 10, E39 5-speed with 3.15 final drive. */
+static const uint16_t kRatios[] = {0, 92, 155, 236, 321, 391};
+static const uint16_t kThresholds[] = {5500, 5300, 5500, 5700, 5800, 5800};
+static const uint32_t kLoopMs = 5;
+static const uint16_t kOutputMs = 40;
+
+static uint32_t s_rng = 1;
+static int noise(int amp) {
+  s_rng = s_rng * 1103515245u + 12345u;
+  return (int)((s_rng >> 16) % (2 * amp + 1)) - amp;
+}
+
+static void configure(ShiftPredictor &p) {
+  for (uint8_t g = 0; g <= 5; g++) {
+    p.setThreshold(g, kThresholds[g]);
+    p.setGearRatio(g, kRatios[g]);
+  }
+  p.setHysteresis(300);
+  p.setOutputLatency(kOutputMs);
+}
+
+/** True RPM at 1 ms resolution. */
+struct Trace {
+  static const size_t kMax = 6000;
+  float rpm[kMax];
+  size_t len = 0;
+  uint8_t gear = 0;
+  /** First ms at which the true RPM reaches rpmThr, -1 if never. */
+  int crossing(int rpmThr) const {
+    for (size_t i = 0; i < len; i++)
+      if (rpm[i] >= rpmThr)
+        return (int)i;
+    return -1;
+  }
+};
+
+/** Full-throttle pull in a gear from 2500 rpm to 6300 rpm (rpm/s shaped by the torque curve). */
+static void pull(Trace &t, uint8_t gear, float rpmPerS) {
+  t.gear = gear;
+  t.len = 0;
+  float r = 2500;
+  while (t.len < Trace::kMax && r < 6300) {
+    const float k = (r - 4000) / 2500;
+    r += rpmPerS * (1.1f - 0.4f * k * k) / 1000.0f;
+    t.rpm[t.len++] = r;
+  }
+}
+
+/** Part throttle easing up to just under the threshold and holding there. */
+static void plateau(Trace &t, uint8_t gear, float top) {
+  t.gear = gear;
+  t.len = 4000;
+  for (size_t i = 0; i < t.len; i++)
+    t.rpm[i] = top - 2000.0f * expf(-(float)i / 700.0f);
+}
+
+/** Pull in 2nd up to 5600, then the upshift: clutch in, revs fall to 3700 over 250 ms, pull in 3rd. */
+static void upshift(Trace &t) {
+  pull(t, 2, 2000);
+  size_t i = 0;
+  while (i < t.len && t.rpm[i] < 5600)
+    i++;
+  const float top = t.rpm[i];
+  for (size_t k = 0; k < 250 && i < Trace::kMax; k++)
+    t.rpm[i++] = top - (top - 3700) * (float)k / 250.0f;
+  for (size_t k = 0; k < 1000 && i < Trace::kMax; k++)
+    t.rpm[i++] = 3700 + 1.2f * (float)k;
+  t.len = i;
+}
+
+struct Pipeline {
+  uint32_t periodMs = 30;   /* OBD RPM sample interval (CAN multi-PID ~30 ms, K-line ~110 ms) */
+  uint32_t jitterMs = 8;
+  uint32_t arrivalMs = 16;  /* ECU sample -> reply parsed */
+  bool gearFromSpeed = true;
+};
+
+struct Result {
+  int naiveMs = -1;      /* cue visible, naive */
+  int predictMs = -1;    /* cue visible, predictor */
+  int crossMs = -1;      /* true crossing */
+  uint8_t gear = 0;      /* predictor's gear estimate at the cue */
+  int offMs = -1;        /* predictor cue off after it fired */
+  uint32_t cues = 0;
+  uint32_t naiveCues = 0;
+};
+
+static Result replay(const Trace &t, const Pipeline &pl, int noiseAmp = 25) {
+  ShiftPredictor p;
+  configure(p);
+  Result res;
+  res.crossMs = t.crossing(kThresholds[t.gear]);
+
+  /* ECU sample times and their arrival in the loop. */
+  uint32_t nextSample = 7, pendingArrive = 0;
+  int pendingRpm = 0;
+  bool pending = false;
+  int lastRpm = -1;
+  bool naiveOn = false;
+  for (uint32_t now = 0; now < t.len; now += kLoopMs) {
+    while (!pending && nextSample < t.len && nextSample <= now) {
+      pendingRpm = (int)t.rpm[nextSample] + noise(noiseAmp);
+      pendingArrive = nextSample + pl.arrivalMs + (uint32_t)noise((int)pl.jitterMs / 2 + 1) + pl.jitterMs / 2;
+      pending = true;
+      nextSample += pl.periodMs + (uint32_t)(noise((int)pl.jitterMs / 2));
+    }
+    if (pending && pendingArrive <= now) {
+      /* ObdClient: sample time = arrival - rtt/2, with rtt ~ 2 * arrival. */
+      p.addSample(pendingRpm, pendingArrive - pl.arrivalMs);
+      if (pl.gearFromSpeed)
+        p.setSpeed((int)lroundf(pendingRpm * kRatios[t.gear] / 10000.0f));
+      lastRpm = pendingRpm;
+      pending = false;
+    }
+    const bool was = p.active();
+    p.update(now);
+    if (p.active() && !was && res.predictMs < 0) {
+      res.predictMs = (int)(now + kOutputMs);
+      res.gear = p.gear();
+    }
+    if (!p.active() && was && res.offMs < 0)
+      res.offMs = (int)now;
+    const bool naive = lastRpm >= kThresholds[0];
+    if (naive && !naiveOn) {
+      res.naiveCues++;
+      if (res.naiveMs < 0)
+        res.naiveMs = (int)(now + kOutputMs);
+    }
+    naiveOn = naive;
+  }
+  res.cues = p.cues();
+  return res;
+}
+
+/* Per-gear rpm/s at the torque peak, full throttle. */
+static const float kPullRate[] = {0, 3200, 2000, 1300, 900, 650};
+
+void test_pulls_predictive_vs_naive(void) {
+  static Trace t;
+  Pipeline pl;
+  printf("    gear  rpm/s  thr   naive late   predictive err  (ms, vs true crossing; CAN ~30 ms samples)\n");
+  int naiveSum = 0, predSum = 0, predAbsMax = 0;
+  for (uint8_t g = 1; g <= 4; g++) {
+    s_rng = g;
+    pull(t, g, kPullRate[g]);
+    const Result r = replay(t, pl);
+    /* The naive check only knows the single 5500 threshold; compare it against that crossing. */
+    const int naiveCross = t.crossing(kThresholds[0]);
+    printf("    %4u  %5.0f  %4u  %10d   %14d\n", g, kPullRate[g], kThresholds[g], r.naiveMs - naiveCross,
+           r.predictMs - r.crossMs);
+    TEST_ASSERT_TRUE(r.crossMs > 0 && r.predictMs > 0 && r.naiveMs > 0);
+    TEST_ASSERT_EQUAL_UINT8(g, r.gear);
+    TEST_ASSERT_EQUAL_UINT32(1, r.cues);
+    naiveSum += r.naiveMs - naiveCross;
+    predSum += r.predictMs - r.crossMs;
+    predAbsMax = std::max(predAbsMax, std::abs(r.predictMs - r.crossMs));
+  }
+  printf("    mean: naive %d ms late, predictive %+d ms, worst |err| %d ms\n", naiveSum / 4, predSum / 4, predAbsMax);
+  TEST_ASSERT_TRUE(naiveSum / 4 >= 50);
+  TEST_ASSERT_TRUE(std::abs(predSum / 4) <= 20);
+  TEST_ASSERT_TRUE(predAbsMax <= 35);
+}
+
+void test_kline_slow_samples(void) {
+  static Trace t;
+  Pipeline pl;
+  pl.periodMs = 110;
+  pl.jitterMs = 20;
+  pl.arrivalMs = 45;
+  s_rng = 7;
+  pull(t, 2, kPullRate[2]);
+  const Result r = replay(t, pl);
+  const int naiveCross = t.crossing(kThresholds[0]);
+  printf("    K-line 2nd gear: naive %d ms late, predictive %+d ms\n", r.naiveMs - naiveCross, r.predictMs - r.crossMs);
+  TEST_ASSERT_TRUE(r.naiveMs - naiveCross >= 100);
+  TEST_ASSERT_TRUE(std::abs(r.predictMs - r.crossMs) <= 60);
+}
+
+void test_plateau_below_threshold_no_cue(void) {
+  static Trace t;
+  Pipeline pl;
+  for (int top = 5200; top <= 5350; top += 50) {
+    s_rng = (uint32_t)top;
+    plateau(t, 2, (float)top);
+    const Result r = replay(t, pl, 30);
+    TEST_ASSERT_EQUAL_UINT32(0, r.cues);
+  }
+  /* Noise around the threshold itself: hysteresis keeps it to one cue, the naive check flickers. */
+  s_rng = 99;
+  plateau(t, 2, (float)kThresholds[2]);
+  const Result r = replay(t, pl, 40);
+  printf("    holding at the threshold: predictive %u cue(s), naive %u\n", (unsigned)r.cues, (unsigned)r.naiveCues);
+  TEST_ASSERT_TRUE(r.cues <= 1);
+  TEST_ASSERT_TRUE(r.naiveCues > 1);
+}
+
+void test_upshift_turns_cue_off(void) {
+  static Trace t;
+  Pipeline pl;
+  s_rng = 3;
+  upshift(t);
+  const Result r = replay(t, pl);
+  size_t drop = 0;
+  while (drop + 1 < t.len && t.rpm[drop + 1] >= t.rpm[drop])
+    drop++;
+  printf("    upshift: cue %d ms, revs fall at %u ms, cue off %d ms later\n", r.predictMs, (unsigned)drop,
+         r.offMs - (int)drop);
+  TEST_ASSERT_TRUE(r.predictMs > 0 && r.offMs > r.predictMs);
+  TEST_ASSERT_TRUE(r.offMs - (int)drop <= 150);
+  TEST_ASSERT_EQUAL_UINT32(1, r.cues);
+}
+
+void test_unknown_gear_and_stale(void) {
+  ShiftPredictor p;
+  configure(p);
+  /* No speed: default threshold (gear 0). Slope 2000 rpm/s, last sample 5400 at t=100. */
+  for (uint32_t ms = 0; ms <= 100; ms += 20)
+    p.addSample(5200 + (int)ms * 2, ms);
+  TEST_ASSERT_EQUAL_INT(2000, p.slope());
+  p.update(100);
+  TEST_ASSERT_EQUAL_UINT8(0, p.gear());
+  TEST_ASSERT_EQUAL_INT(5400 + 2000 * kOutputMs / 1000, p.predictedRpm());
+  TEST_ASSERT_FALSE(p.active());
+  p.update(120);  /* 20 ms older + 40 ms output: 5400 + 120 = 5520 >= 5500 */
+  TEST_ASSERT_TRUE(p.active());
+  TEST_ASSERT_TRUE(p.takeRising());
+  TEST_ASSERT_FALSE(p.takeRising());
+  TEST_ASSERT_EQUAL_UINT32(60, p.horizonMs());
+  /* Samples stop: cue off after kStaleMs. */
+  TEST_ASSERT_TRUE(p.update(100 + ShiftPredictor::kStaleMs));
+  TEST_ASSERT_FALSE(p.update(101 + ShiftPredictor::kStaleMs));
+  /* Out-of-order and duplicate timestamps are ignored. */
+  p.reset();
+  p.addSample(3000, 50);
+  p.addSample(9000, 50);
+  p.addSample(9000, 40);
+  p.update(60);
+  TEST_ASSERT_EQUAL_INT(3000, p.predictedRpm());
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_pulls_predictive_vs_naive);
+  RUN_TEST(test_kline_slow_samples);
+  RUN_TEST(test_plateau_below_threshold_no_cue);
+  RUN_TEST(test_upshift_turns_cue_off);
+  RUN_TEST(test_unknown_gear_and_stale);
+  return UNITY_END();
+}
@@ -0,0 +1,230 @@
+/*
+ * Host tests: telemetry arbitration (TelemetryArbiter.cpp). Priority and confidence decay, rejects, fallback
+ * when a source goes quiet and return when it comes back, and a minute of interleaved synthetic OBD and
+ * IKE traffic with ECU dropouts read by a 20 ms consumer loop. The data age the consumer got is compared
+ * with the selection BmwManager used before (OBD value while the session says connected, else IKE).
+ * Run: pio test -e native -f native/test_telemetry_arbiter
+ */
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "TelemetryArbiter.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_priority_decay_and_rejects(void) {
+  TelemetryArbiter a;
+  TEST_ASSERT_FALSE(a.read(TELEM_SIG_RPM, 0).valid);
+  TEST_ASSERT_EQUAL_UINT8(TELEM_SRC_NONE, a.read(TELEM_SIG_RPM, 0).source);
+
+  TEST_ASSERT_TRUE(a.publish(TELEM_SRC_IKE, TELEM_SIG_RPM, 2100, 1000));
+  TEST_ASSERT_TRUE(a.publish(TELEM_SRC_OBD, TELEM_SIG_RPM, 2143, 1000));
+  TelemetryReading r = a.read(TELEM_SIG_RPM, 1000);
+  TEST_ASSERT_TRUE(r.valid);
+  TEST_ASSERT_EQUAL_UINT8(TELEM_SRC_OBD, r.source);
+  TEST_ASSERT_EQUAL_INT32(2143, r.value);
+  TEST_ASSERT_EQUAL_UINT8(100, r.confidence);
+
+  /* Confidence halves over the max age (1000 ms for OBD RPM). */
+  r = a.read(TELEM_SIG_RPM, 1500);
+  TEST_ASSERT_EQUAL_UINT8(TELEM_SRC_OBD, r.source);
+  TEST_ASSERT_EQUAL_UINT32(500, r.ageMs);
+  TEST_ASSERT_EQUAL_UINT8(75, r.confidence);
+
+  /* Fresh IKE (60) vs lagging OBD: kept until IKE leads by the margin, i.e. OBD below 50 = stale. */
+  TEST_ASSERT_TRUE(a.publish(TELEM_SRC_IKE, TELEM_SIG_RPM, 2200, 1900));
+  r = a.read(TELEM_SIG_RPM, 1900);
+  TEST_ASSERT_EQUAL_UINT8(TELEM_SRC_OBD, r.source);
+  TEST_ASSERT_EQUAL_UINT8(55, r.confidence);
+  r = a.read(TELEM_SIG_RPM, 2001);
+  TEST_ASSERT_EQUAL_UINT8(TELEM_SRC_IKE, r.source);
+  TEST_ASSERT_EQUAL_INT32(2200, r.value);
+  TEST_ASSERT_EQUAL_UINT32(1, a.stats(TELEM_SIG_RPM).switches);
+
+  /* Implausible, out of order, not provided. */
+  TEST_ASSERT_FALSE(a.publish(TELEM_SRC_OBD, TELEM_SIG_RPM, 20000, 2100));
+  TEST_ASSERT_FALSE(a.publish(TELEM_SRC_OBD, TELEM_SIG_COOLANT, -41, 2100));
+  TEST_ASSERT_FALSE(a.publish(TELEM_SRC_IKE, TELEM_SIG_RPM, 2300, 1899));
+  TEST_ASSERT_FALSE(a.publish(TELEM_SRC_IKE, TELEM_SIG_OIL, 90, 2100));
+  TEST_ASSERT_FALSE(a.publish(TELEM_SRC_COUNT, TELEM_SIG_RPM, 900, 2100));
+  TEST_ASSERT_EQUAL_UINT32(4, a.rejected(TELEM_SRC_OBD) + a.rejected(TELEM_SRC_IKE));
+  TEST_ASSERT_EQUAL_INT32(2200, a.read(TELEM_SIG_RPM, 2100).value);
+
+  /* Sample time slightly ahead of now (estimated ECU time): age 0, not a wrap to 4 billion. */
+  TEST_ASSERT_TRUE(a.publish(TELEM_SRC_OBD, TELEM_SIG_SPEED, 50, 3005));
+  r = a.read(TELEM_SIG_SPEED, 3000);
+  TEST_ASSERT_TRUE(r.valid);
+  TEST_ASSERT_EQUAL_UINT32(0, r.ageMs);
+}
+
+void test_fallback_and_return(void) {
+  TelemetryArbiter a;
+  /* Game mode: Forza at 60 Hz over the demo task at 2 Hz. */
+  uint32_t now = 0;
+  for (; now < 1000; now += 16) {
+    a.publish(TELEM_SRC_FORZA, TELEM_SIG_RPM, 6000, now);
+    if (now % 500 < 16)
+      a.publish(TELEM_SRC_DEMO, TELEM_SIG_RPM, 800, now);
+    TEST_ASSERT_EQUAL_UINT8(TELEM_SRC_FORZA, a.read(TELEM_SIG_RPM, now).source);
+  }
+  /* Forza stops (game paused): demo after Forza's 500 ms max age, not before. */
+  const uint32_t lastForza = now - 16;
+  uint32_t fellBackAt = 0;
+  for (; now < 3000 && !fellBackAt; now += 10) {
+    if (now % 500 < 10)
+      a.publish(TELEM_SRC_DEMO, TELEM_SIG_RPM, 800, now);
+    const TelemetryReading r = a.read(TELEM_SIG_RPM, now);
+    TEST_ASSERT_TRUE(r.valid);
+    if (r.source == TELEM_SRC_DEMO)
+      fellBackAt = now;
+  }
+  TEST_ASSERT_TRUE(fellBackAt > lastForza + 500 && fellBackAt <= lastForza + 510);
+
+  /* Forza back: takes over with its first sample (90 vs <= 30). */
+  a.publish(TELEM_SRC_FORZA, TELEM_SIG_RPM, 6100, now);
+  TEST_ASSERT_EQUAL_INT32(6100, a.read(TELEM_SIG_RPM, now).value);
+  TEST_ASSERT_EQUAL_UINT32(2, a.stats(TELEM_SIG_RPM).switches);
+
+  /* drop(): no waiting for the max age. */
+  a.drop(TELEM_SRC_FORZA);
+  TEST_ASSERT_EQUAL_UINT8(TELEM_SRC_DEMO, a.read(TELEM_SIG_RPM, now).source);
+
+  /* Everything quiet: last value, flagged, with its age. */
+  a.drop(TELEM_SRC_DEMO);
+  a.publish(TELEM_SRC_OBD, TELEM_SIG_COOLANT, 91, now);
+  TelemetryReading r = a.read(TELEM_SIG_COOLANT, now + 7000);
+  TEST_ASSERT_FALSE(r.valid);
+  TEST_ASSERT_EQUAL_INT32(91, r.value);
+  TEST_ASSERT_EQUAL_UINT32(7000, r.ageMs);
+  TEST_ASSERT_EQUAL_UINT8(TELEM_SRC_OBD, r.source);
+  TEST_ASSERT_EQUAL_UINT8(0, r.confidence);
+  TEST_ASSERT_EQUAL_UINT32(1, a.stats(TELEM_SIG_COOLANT).staleReads);
+}
+
+/* Engine speed in the synthetic drive: slow swings with gear changes, 800..5800 rpm. */
+static int trueRpm(uint32_t t) {
+  const double s = t / 1000.0;
+  return (int)(3300 + 1800 * sin(s / 3.0) + 700 * sin(s * 1.7));
+}
+
+static uint32_t s_rng = 7;
+static uint32_t jitter(uint32_t span) {
+  s_rng = s_rng * 1103515245u + 12345u;
+  return (s_rng >> 16) % (span + 1);
+}
+
+struct AgeStats {
+  uint32_t n = 0, maxMs = 0, over1s = 0;
+  uint64_t sumMs = 0, errSum = 0;
+  void add(uint32_t age, int err) {
+    n++;
+    sumMs += age;
+    errSum += (uint64_t)abs(err);
+    if (age > maxMs)
+      maxMs = age;
+    if (age > 1000)
+      over1s++;
+  }
+};
+
+void test_interleaved_sources_consumer_age(void) {
+  TelemetryArbiter a;
+  const uint32_t kRunMs = 60000, kTickMs = 20;
+  /* ECU silent 15.0-19.0 s (longer than ObdSession::kEcuLostMs, the session drops) and 40.0-41.5 s
+   * (shorter: the session never notices). */
+  const auto ecuUp = [](uint32_t t) { return !(t >= 15000 && t < 19000) && !(t >= 40000 && t < 41500); };
+  const uint32_t kEcuLostMs = 3000;
+
+  uint32_t nextObd = 10, nextSpeed = 10, nextTemp = 10, nextIke = 700, nextIkeTemp = 1300;
+  uint32_t obdLastReply = 0;
+  int obdRpm = -1, ikeRpm = -1;
+  uint32_t obdAt = 0, ikeAt = 0;
+  AgeStats legacy, arb;
+  uint32_t validReads = 0, reads = 0;
+
+  for (uint32_t now = kTickMs; now <= kRunMs; now += kTickMs) {
+    /* OBD: one RPM reply every 25-40 ms, sampled half a round trip (~10 ms) before it arrives. */
+    while (nextObd <= now) {
+      if (ecuUp(nextObd)) {
+        const uint32_t at = nextObd - 10;
+        obdRpm = trueRpm(at);
+        obdAt = at;
+        obdLastReply = nextObd;
+        a.publish(TELEM_SRC_OBD, TELEM_SIG_RPM, obdRpm, at);
+      }
+      nextObd += 25 + jitter(15);
+    }
+    while (nextSpeed <= now) {
+      if (ecuUp(nextSpeed))
+        a.publish(TELEM_SRC_OBD, TELEM_SIG_SPEED, trueRpm(nextSpeed) / 60, nextSpeed - 10);
+      nextSpeed += 200;
+    }
+    while (nextTemp <= now) {
+      if (ecuUp(nextTemp))
+        a.publish(TELEM_SRC_OBD, TELEM_SIG_COOLANT, 90, nextTemp - 10);
+      nextTemp += 2000;
+    }
+    /* IKE 0x18 every ~2 s (RPM / 100, speed / 2), 0x19 every ~10 s; the bus does not care about OBD. */
+    while (nextIke <= now) {
+      ikeRpm = trueRpm(nextIke) / 100 * 100;
+      ikeAt = nextIke;
+      a.publish(TELEM_SRC_IKE, TELEM_SIG_RPM, ikeRpm, nextIke);
+      a.publish(TELEM_SRC_IKE, TELEM_SIG_SPEED, trueRpm(nextIke) / 60 / 2 * 2, nextIke);
+      nextIke += 1900 + jitter(200);
+    }
+    while (nextIkeTemp <= now) {
+      a.publish(TELEM_SRC_IKE, TELEM_SIG_COOLANT, 89, nextIkeTemp);
+      nextIkeTemp += 10000;
+    }
+
+    /* Consumer (BmwManager::tick): before = OBD while connected, else IKE; now = the arbiter. */
+    const bool obdConnected = obdRpm >= 0 && now - obdLastReply < kEcuLostMs;
+    if (obdConnected)
+      legacy.add(now - obdAt, obdRpm - trueRpm(now));
+    else if (ikeRpm >= 0)
+      legacy.add(now - ikeAt, ikeRpm - trueRpm(now));
+    const TelemetryReading r = a.read(TELEM_SIG_RPM, now);
+    reads++;
+    if (r.valid) {
+      validReads++;
+      arb.add(r.ageMs, r.value - trueRpm(now));
+    }
+    a.read(TELEM_SIG_SPEED, now);
+    a.read(TELEM_SIG_COOLANT, now);
+  }
+
+  printf("    rpm age seen by a 20 ms consumer over 60 s, ECU gaps of 4.0 s and 1.5 s:\n");
+  printf("      before (OBD while connected): avg %u ms, max %u ms, reads older than 1 s %u, mean |err| %u rpm\n",
+         (unsigned)(legacy.sumMs / legacy.n), (unsigned)legacy.maxMs, (unsigned)legacy.over1s,
+         (unsigned)(legacy.errSum / legacy.n));
+  printf("      arbiter:                      avg %u ms, max %u ms, reads older than 1 s %u, mean |err| %u rpm\n",
+         (unsigned)(arb.sumMs / arb.n), (unsigned)arb.maxMs, (unsigned)arb.over1s, (unsigned)(arb.errSum / arb.n));
+  for (uint8_t s = TELEM_SIG_RPM; s <= TELEM_SIG_COOLANT; s++) {
+    const TelemetryArbiter::SignalStats &st = a.stats(s);
+    printf("      %-7s p50 <= %u ms, p99 <= %u ms, max %u ms, switches %u, stale reads %u/%u\n",
+           TelemetryArbiter::signalName(s), (unsigned)a.agePercentileMs(s, 50), (unsigned)a.agePercentileMs(s, 99),
+           (unsigned)st.ageMaxMs, (unsigned)st.switches, (unsigned)st.staleReads, (unsigned)st.reads);
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(reads, validReads);            /* IKE always covers the gaps */
+  TEST_ASSERT_EQUAL_UINT32(arb.maxMs, a.stats(TELEM_SIG_RPM).ageMaxMs);
+  TEST_ASSERT_TRUE(legacy.maxMs >= kEcuLostMs - kTickMs);  /* frozen OBD value until the session drops */
+  TEST_ASSERT_TRUE(arb.maxMs <= 2100 + kTickMs);           /* worst case: an IKE frame just before it is due */
+  TEST_ASSERT_TRUE(arb.over1s < legacy.over1s);
+  TEST_ASSERT_TRUE(arb.errSum < legacy.errSum);
+  TEST_ASSERT_TRUE(a.agePercentileMs(TELEM_SIG_RPM, 50) <= 64);
+  /* Two gaps: out to IKE and back to OBD each time. */
+  TEST_ASSERT_EQUAL_UINT32(4, a.stats(TELEM_SIG_RPM).switches);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_priority_decay_and_rejects);
+  RUN_TEST(test_fallback_and_return);
+  RUN_TEST(test_interleaved_sources_consumer_age);
+  return UNITY_END();
+}
@@ -0,0 +1,86 @@
+/*
+ * Host tests: Wi-Fi re-join policy (WifiRetry.cpp) — monitoring and OBD over TCP as station users,
+ * retry interval, resume. BMW mode runs with monitoring off and OBD TCP wanting Wi-Fi.
+ * Run: pio test -e native -f native/test_wifi_retry
+ */
+#include <unity.h>
+#include "WifiRetry.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static const uint32_t kInterval = 30000;
+
+/* Attempts over [fromMs, toMs) stepping every 10 ms with the station down. */
+static int attemptsWhileDown(WifiRetry &r, uint32_t fromMs, uint32_t toMs) {
+  int n = 0;
+  for (uint32_t t = fromMs; t < toMs; t += 10)
+    n += r.step(t, false) ? 1 : 0;
+  return n;
+}
+
+void test_no_user_no_retry(void) {
+  WifiRetry r(kInterval);
+  TEST_ASSERT_FALSE(r.wanted());
+  TEST_ASSERT_EQUAL(0, attemptsWhileDown(r, 0, 5 * kInterval));
+  r.retryNow();
+  TEST_ASSERT_FALSE(r.step(5 * kInterval, false));
+}
+
+void test_bmw_mode_obd_keeps_wifi(void) {
+  WifiRetry r(kInterval);
+  /* Normal mode: monitoring joins the station, then the user switches to BMW mode. */
+  r.setWanted(NOCT_WIFI_USER_MONITOR, true);
+  TEST_ASSERT_FALSE(r.step(40000, true));
+  r.setWanted(NOCT_WIFI_USER_OBD, true);
+  r.setWanted(NOCT_WIFI_USER_MONITOR, false);
+  TEST_ASSERT_TRUE(r.wanted());
+  /* Adapter AP drops (ignition off): re-joined every interval, not at every step. */
+  const uint32_t t0 = 100000;
+  TEST_ASSERT_TRUE(r.step(t0, false));
+  TEST_ASSERT_EQUAL(2, attemptsWhileDown(r, t0 + 10, t0 + 2 * kInterval + 100));
+  /* Back: no more attempts while connected. */
+  for (uint32_t t = t0 + 3 * kInterval; t < t0 + 6 * kInterval; t += 10)
+    TEST_ASSERT_FALSE(r.step(t, true));
+  TEST_ASSERT_EQUAL(3, (int)r.attempts());
+  /* Leaving BMW mode for a mode without Wi-Fi users: no retries. */
+  r.setWanted(NOCT_WIFI_USER_OBD, false);
+  TEST_ASSERT_EQUAL(0, attemptsWhileDown(r, t0 + 6 * kInterval, t0 + 10 * kInterval));
+}
+
+void test_users_are_independent(void) {
+  WifiRetry r(kInterval);
+  r.setWanted(NOCT_WIFI_USER_MONITOR, true);
+  r.setWanted(NOCT_WIFI_USER_OBD, true);
+  r.setWanted(NOCT_WIFI_USER_OBD, false);
+  TEST_ASSERT_TRUE(r.wanted());
+  r.setWanted(NOCT_WIFI_USER_MONITOR, false);
+  TEST_ASSERT_FALSE(r.wanted());
+}
+
+void test_resume_retries_at_once(void) {
+  WifiRetry r(kInterval);
+  r.setWanted(NOCT_WIFI_USER_MONITOR, true);
+  TEST_ASSERT_TRUE(r.step(50000, false));
+  TEST_ASSERT_FALSE(r.step(50010, false));
+  r.retryNow();
+  TEST_ASSERT_TRUE(r.step(50020, false));
+  TEST_ASSERT_FALSE(r.step(50030, false));
+  /* Interval counts from the last attempt; millis() wrap included. */
+  WifiRetry w(kInterval);
+  w.setWanted(NOCT_WIFI_USER_OBD, true);
+  TEST_ASSERT_TRUE(w.step(0xFFFFFF00u, false));
+  TEST_ASSERT_FALSE(w.step(0xFFFFFF00u + kInterval, false));
+  TEST_ASSERT_TRUE(w.step(0xFFFFFF00u + kInterval + 1, false));
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_no_user_no_retry);
+  RUN_TEST(test_bmw_mode_obd_keeps_wifi);
+  RUN_TEST(test_users_are_independent);
+  RUN_TEST(test_resume_retries_at_once);
+  return UNITY_END();
+}
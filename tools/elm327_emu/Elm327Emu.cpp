@@ -0,0 +1,344 @@
+/*
+ * NOCTURNE_OS — ELM327 adapter emulator: command interpreter and reply timing.
+ */
+#include "Elm327Emu.h"
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+static const char *kBanner = "ELM327 v1.5";
+
+/* PIDs the emulated ECU answers: 0x20 / 0x40 chain the bitmaps. */
+static const uint8_t kSupported[] = {0x04, 0x05, 0x0B, 0x0C, 0x0D, 0x0F, 0x10, 0x11,
+                                     0x1F, 0x20, 0x40, 0x42, 0x46, 0x5C};
+
+Elm327Emu::Elm327Emu(const Elm327EmuConfig &cfg) : cfg_(cfg), rng_(cfg.seed) {}
+
+bool Elm327Emu::supported(uint8_t pid) const {
+  for (uint8_t p : kSupported)
+    if (p == pid)
+      return true;
+  return pid == 0x00;
+}
+
+uint32_t Elm327Emu::bitmap(uint8_t base) const {
+  uint32_t m = 0;
+  for (uint8_t p : kSupported)
+    if (p > base && p <= base + 32)
+      m |= 1u << (31 - (p - base - 1));
+  return m;
+}
+
+/* Engine model: RPM sweeps 800..6000 over 12 s, temperatures warm up. Returns data bytes, -1 if none. */
+int Elm327Emu::pidData(uint8_t pid, uint32_t nowMs, uint8_t *out) {
+  const double t = (nowMs - startMs_) / 1000.0;
+  const double rpm = 800.0 + 2600.0 * (1.0 - cos(2.0 * M_PI * t / 12.0));
+  const double load = (rpm - 800.0) / 52.0;
+  switch (pid) {
+    case 0x00:
+    case 0x20:
+    case 0x40: {
+      const uint32_t m = bitmap(pid);
+      out[0] = (uint8_t)(m >> 24);
+      out[1] = (uint8_t)(m >> 16);
+      out[2] = (uint8_t)(m >> 8);
+      out[3] = (uint8_t)m;
+      return 4;
+    }
+    case 0x04: out[0] = (uint8_t)(load * 2.55); return 1;
+    case 0x05: out[0] = (uint8_t)((t < 70 ? 20 + t : 90) + 40); return 1;
+    case 0x0B: out[0] = (uint8_t)(35 + load * 0.65); return 1;
+    case 0x0C: {
+      const uint16_t v = (uint16_t)(rpm * 4);
+      out[0] = (uint8_t)(v >> 8);
+      out[1] = (uint8_t)v;
+      return 2;
+    }
+    case 0x0D: out[0] = (uint8_t)(rpm / 45.0); return 1;
+    case 0x0F: out[0] = 25 + 40; return 1;
+    case 0x10: {
+      const uint16_t v = (uint16_t)(rpm * 2.5);  /* g/s * 100 */
+      out[0] = (uint8_t)(v >> 8);
+      out[1] = (uint8_t)v;
+      return 2;
+    }
+    case 0x11: out[0] = (uint8_t)(load * 2.55); return 1;
+    case 0x1F: {
+      const uint16_t v = (uint16_t)t;
+      out[0] = (uint8_t)(v >> 8);
+      out[1] = (uint8_t)v;
+      return 2;
+    }
+    case 0x42: out[0] = 0x37; out[1] = 0x14; return 2;  /* 14.1 V */
+    case 0x46: out[0] = 18 + 40; return 1;
+    case 0x5C: out[0] = (uint8_t)((t < 110 ? 20 + t * 0.7 : 97) + 40); return 1;
+    default: return -1;
+  }
+}
+
+uint32_t Elm327Emu::ecuLatency() {
+  if (cfg_.jitterMs == 0 || cfg_.jitterMs >= cfg_.latencyMs)
+    return cfg_.latencyMs;
+  std::uniform_int_distribution<int> d(-(int)cfg_.jitterMs, (int)cfg_.jitterMs);
+  return (uint32_t)((int)cfg_.latencyMs + d(rng_));
+}
+
+/* After the last response the ELM waits for more ECUs: the full ATST timeout, or a learned one. */
+uint32_t Elm327Emu::adaptiveWaitMs() const {
+  uint32_t w = timeoutMs_;
+  if (adaptive_ == 1)
+    w = cfg_.latencyMs * 2 + 20;
+  else if (adaptive_ == 2)
+    w = cfg_.latencyMs + cfg_.jitterMs + 5;
+  return w < timeoutMs_ ? w : timeoutMs_;
+}
+
+void Elm327Emu::emit(uint32_t atMs, const std::string &s) {
+  /* 10 bits per byte on the UART; bytes queue behind whatever is still going out. */
+  const double byteMs = 10000.0 / cfg_.baud;
+  double t = atMs > lastOutMs_ ? atMs : lastOutMs_;
+  for (char c : s) {
+    out_.push_back({(uint32_t)t, c});
+    t += byteMs;
+  }
+  lastOutMs_ = (uint32_t)t;
+}
+
+size_t Elm327Emu::read(char *buf, size_t cap, uint32_t nowMs) {
+  size_t n = 0;
+  while (n < cap && !out_.empty() && (int32_t)(out_.front().first - nowMs) <= 0) {
+    buf[n++] = out_.front().second;
+    out_.pop_front();
+  }
+  return n;
+}
+
+bool Elm327Emu::nextDue(uint32_t *atMs) const {
+  if (out_.empty())
+    return false;
+  *atMs = out_.front().first;
+  return true;
+}
+
+void Elm327Emu::write(const char *data, size_t len, uint32_t nowMs) {
+  for (size_t i = 0; i < len; i++) {
+    const char c = data[i];
+    if (mute)
+      continue;
+    if (!out_.empty() && (int32_t)(out_.back().first - nowMs) > 0) {
+      /* Any byte while a reply is still being produced aborts it; the byte itself is lost. */
+      while (!out_.empty() && (int32_t)(out_.back().first - nowMs) > 0)
+        out_.pop_back();
+      lastOutMs_ = nowMs;
+      stopped_++;
+      cmd_.clear();
+      emit(nowMs + 1, "STOPPED" + eol() + eol() + ">");
+      continue;
+    }
+    if (c == '\r') {
+      handle(cmd_, nowMs);
+      cmd_.clear();
+    } else if (c != '\n' && cmd_.size() < 64) {
+      cmd_ += c;
+    }
+  }
+}
+
+std::string Elm327Emu::hexBytes(const uint8_t *b, size_t n) const {
+  std::string s;
+  char t[4];
+  for (size_t i = 0; i < n; i++) {
+    snprintf(t, sizeof(t), spaces_ && i + 1 < n ? "%02X " : "%02X", b[i]);
+    s += t;
+  }
+  return s;
+}
+
+std::string Elm327Emu::frameLine(const uint8_t *b, size_t n) const {
+  std::string s = hexBytes(b, n);
+  return s + eol();
+}
+
+void Elm327Emu::handle(const std::string &raw, uint32_t nowMs) {
+  const std::string echo = echo_ ? raw + eol() : "";
+  std::string c;
+  for (char ch : raw)
+    if (ch != ' ')
+      c += (char)toupper((unsigned char)ch);
+  /* A bare CR repeats the previous command. */
+  if (c.empty())
+    c = lastCmd_;
+  if (c.empty()) {
+    emit(nowMs + 1, echo + ">");
+    return;
+  }
+  lastCmd_ = c;
+  if (c.compare(0, 2, "AT") == 0)
+    handleAt(c.substr(2), echo, nowMs);
+  else if (c.compare(0, 2, "01") == 0)
+    handleMode01(c.substr(2), echo, nowMs);
+  else
+    emit(nowMs + 1, echo + "?" + eol() + eol() + ">");
+}
+
+void Elm327Emu::handleAt(const std::string &c, const std::string &echo, uint32_t nowMs) {
+  std::string reply = "OK";
+  uint32_t delay = 1;
+  auto flag = [&](const char *name, bool *v) {
+    const size_t n = strlen(name);
+    if (c.size() == n + 1 && c.compare(0, n, name) == 0 && (c[n] == '0' || c[n] == '1')) {
+      *v = c[n] == '1';
+      return true;
+    }
+    return false;
+  };
+  if (c == "Z" || c == "D") {
+    echo_ = linefeeds_ = spaces_ = true;
+    headers_ = false;
+    adaptive_ = 1;
+    timeoutMs_ = 200;
+    searched_ = false;
+    if (c == "Z") {
+      startMs_ = nowMs;
+      reply = eol() + kBanner;
+      delay = cfg_.resetMs;
+    }
+  } else if (c == "I") {
+    reply = kBanner;
+  } else if (c == "@1") {
+    reply = "OBDII to RS232 Interpreter";
+  } else if (c == "RV") {
+    reply = ignitionOff ? "12.4V" : "14.1V";
+  } else if (flag("E", &echo_) || flag("L", &linefeeds_) || flag("S", &spaces_) || flag("H", &headers_)) {
+  } else if (c.size() == 3 && c.compare(0, 2, "AT") == 0 && c[2] >= '0' && c[2] <= '2') {
+    adaptive_ = (uint8_t)(c[2] - '0');
+  } else if (c.size() == 4 && c.compare(0, 2, "ST") == 0 && isxdigit((unsigned char)c[2]) &&
+             isxdigit((unsigned char)c[3])) {
+    const uint32_t v = (uint32_t)strtoul(c.substr(2).c_str(), nullptr, 16);
+    timeoutMs_ = v ? v * 4 : 200;
+  } else if (c.compare(0, 2, "SP") == 0 && c.size() >= 3) {
+    searched_ = false;
+  } else if (c == "DPN") {
+    reply = cfg_.can ? "A6" : "A3";
+  } else if (c == "DP") {
+    reply = cfg_.can ? "AUTO, ISO 15765-4 (CAN 11/500)" : "AUTO, ISO 9141-2";
+  } else {
+    reply = "?";
+  }
+  emit(nowMs + delay, echo + reply + eol() + eol() + ">");
+}
+
+void Elm327Emu::handleMode01(const std::string &c, const std::string &echo, uint32_t nowMs) {
+  requests_++;
+  for (char ch : c)
+    if (!isxdigit((unsigned char)ch)) {
+      emit(nowMs + 1, echo + "?" + eol() + eol() + ">");
+      return;
+    }
+  const size_t pairs = c.size() / 2;
+  const int count = c.size() % 2 ? c.back() - '0' : 0;
+  if (pairs == 0 || pairs > 6 || (pairs > 1 && !cfg_.multiPid)) {
+    emit(nowMs + 1, echo + "?" + eol() + eol() + ">");
+    return;
+  }
+  uint32_t t = nowMs;
+  std::string body;
+  if (!searched_) {
+    /* Protocol search: the ELM says so right away, then tries the buses. */
+    emit(nowMs + 1, echo + "SEARCHING..." + eol());
+    t += cfg_.searchMs;
+    if (ignitionOff) {
+      emit(t, "UNABLE TO CONNECT" + eol() + eol() + ">");
+      return;
+    }
+    searched_ = true;
+  } else {
+    body = echo;
+  }
+  if (busError) {
+    emit(t + 5, body + (cfg_.can ? "CAN ERROR" : "BUS ERROR") + eol() + eol() + ">");
+    return;
+  }
+  if (ignitionOff) {
+    emit(t + timeoutMs_, body + "NO DATA" + eol() + eol() + ">");
+    return;
+  }
+  uint8_t reply[64];
+  size_t n = 0;
+  reply[n++] = 0x41;
+  /* K-line ECUs answer the first PID of a multi-PID request only. */
+  const size_t answer = cfg_.can ? pairs : 1;
+  for (size_t i = 0; i < answer; i++) {
+    const uint8_t pid = (uint8_t)strtoul(c.substr(2 * i, 2).c_str(), nullptr, 16);
+    uint8_t d[4];
+    const int k = supported(pid) ? pidData(pid, nowMs, d) : -1;
+    if (k < 0)
+      continue;
+    reply[n++] = pid;
+    memcpy(reply + n, d, (size_t)k);
+    n += (size_t)k;
+  }
+  if (n == 1) {
+    emit(t + timeoutMs_, body + "NO DATA" + eol() + eol() + ">");
+    return;
+  }
+  t += ecuLatency();
+  if (!cfg_.can) {
+    /* 10.4 kbaud: ~1 ms per byte on the K-line, 3 header bytes and a checksum. */
+    t += (uint32_t)n + 4;
+    if (headers_) {
+      uint8_t f[68] = {0x48, 0x6B, 0x10};
+      memcpy(f + 3, reply, n);
+      uint8_t sum = 0;
+      for (size_t i = 0; i < n + 3; i++)
+        sum += f[i];
+      f[n + 3] = sum;
+      body += frameLine(f, n + 4);
+    } else {
+      body += frameLine(reply, n);
+    }
+  } else if (n <= 7) {
+    if (headers_) {
+      uint8_t f[8] = {(uint8_t)n};
+      memcpy(f + 1, reply, n);
+      body += std::string(spaces_ ? "7E8 " : "7E8") + frameLine(f, n + 1);
+    } else {
+      body += frameLine(reply, n);
+    }
+  } else {
+    /* ISO-TP: first frame with 6 data bytes, flow control from the ELM, consecutive frames of 7. */
+    char len[8];
+    if (!headers_) {
+      snprintf(len, sizeof(len), "%03X", (unsigned)n);
+      body += std::string(len) + eol();
+    }
+    size_t off = 0;
+    for (unsigned idx = 0; off < n; idx++) {
+      const size_t take = idx == 0 ? 6 : 7;
+      const size_t k = n - off < take ? n - off : take;
+      if (headers_) {
+        uint8_t f[8];
+        size_t fl = 0;
+        if (idx == 0) {
+          f[fl++] = (uint8_t)(0x10 | (n >> 8));
+          f[fl++] = (uint8_t)n;
+        } else {
+          f[fl++] = (uint8_t)(0x20 | (idx & 0x0F));
+        }
+        memcpy(f + fl, reply + off, k);
+        body += std::string(spaces_ ? "7E8 " : "7E8") + frameLine(f, fl + k);
+      } else {
+        snprintf(len, sizeof(len), spaces_ ? "%X: " : "%X:", idx & 0x0F);
+        body += std::string(len) + frameLine(reply + off, k);
+      }
+      off += k;
+      if (idx > 0)
+        t += 1;
+    }
+  }
+  if (count == 0)
+    t += adaptiveWaitMs();
+  emit(t, body + eol() + ">");
+}
@@ -0,0 +1,79 @@
+/*
+ * NOCTURNE_OS — ELM327 adapter emulator (Linux tool): AT and mode 01 over CAN or K-line, replies paced at
+ * the UART baud rate. Transport-free: elm327_emu puts it behind a pty, obd_bench drives it from a thread.
+ */
+#ifndef NOCTURNE_ELM327_EMU_H
+#define NOCTURNE_ELM327_EMU_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+
+struct Elm327EmuConfig {
+  bool can = true;                 /* false: ISO 9141-2 K-line */
+  bool multiPid = true;            /* false: '?' on multi-PID requests (cheap clones) */
+  uint32_t baud = 38400;
+  uint32_t latencyMs = 25;         /* ECU answer after the request is on the bus */
+  uint32_t jitterMs = 5;           /* +/- uniform */
+  uint32_t searchMs = 1500;        /* protocol search on the first request after ATZ / ATSP0 */
+  uint32_t resetMs = 800;          /* ATZ until the banner */
+  uint32_t seed = 1;
+};
+
+class Elm327Emu {
+ public:
+  /** Fault switches: set from any thread, read on the next command. */
+  std::atomic<bool> ignitionOff{false};  /* ECU silent: NO DATA (UNABLE TO CONNECT while searching) */
+  std::atomic<bool> mute{false};         /* adapter swallows everything (hung / unplugged) */
+  std::atomic<bool> busError{false};     /* CAN ERROR on every request */
+
+  explicit Elm327Emu(const Elm327EmuConfig &cfg);
+
+  /** Bytes from the host at nowMs. */
+  void write(const char *data, size_t len, uint32_t nowMs);
+  /** Reply bytes due by nowMs (paced at the baud rate). */
+  size_t read(char *buf, size_t cap, uint32_t nowMs);
+  /** When the next reply byte is due; false if nothing is pending. */
+  bool nextDue(uint32_t *atMs) const;
+
+  uint32_t requests() const { return requests_.load(); }
+  uint32_t stopped() const { return stopped_.load(); }
+
+ private:
+  void handle(const std::string &cmd, uint32_t nowMs);
+  void handleAt(const std::string &c, const std::string &echo, uint32_t nowMs);
+  void handleMode01(const std::string &c, const std::string &echo, uint32_t nowMs);
+  void emit(uint32_t atMs, const std::string &s);
+  std::string eol() const { return linefeeds_ ? "\r\n" : "\r"; }
+  std::string hexBytes(const uint8_t *b, size_t n) const;
+  std::string frameLine(const uint8_t *b, size_t n) const;
+  bool supported(uint8_t pid) const;
+  uint32_t bitmap(uint8_t base) const;
+  int pidData(uint8_t pid, uint32_t nowMs, uint8_t *out);
+  uint32_t adaptiveWaitMs() const;
+  uint32_t ecuLatency();
+
+  Elm327EmuConfig cfg_;
+  std::mt19937 rng_;
+  std::string cmd_;
+  std::string lastCmd_;            /* a bare CR repeats it */
+  std::deque<std::pair<uint32_t, char>> out_;
+  uint32_t lastOutMs_ = 0;
+
+  bool echo_ = true;
+  bool linefeeds_ = true;
+  bool spaces_ = true;
+  bool headers_ = false;
+  uint8_t adaptive_ = 1;
+  uint32_t timeoutMs_ = 200;       /* ATST, 4 ms units */
+  bool searched_ = false;
+  uint32_t startMs_ = 0;
+
+  std::atomic<uint32_t> requests_{0};
+  std::atomic<uint32_t> stopped_{0};
+};
+
+#endif
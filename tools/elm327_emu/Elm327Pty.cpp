@@ -0,0 +1,80 @@
+/*
+ * NOCTURNE_OS — ELM327 emulator on a pseudo-terminal.
+ */
+#include "Elm327Pty.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+uint32_t elmMonoMs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000ull + ts.tv_nsec / 1000000);
+}
+
+bool elmSetRaw(int fd) {
+  termios t;
+  if (tcgetattr(fd, &t) != 0)
+    return false;
+  cfmakeraw(&t);
+  cfsetispeed(&t, B38400);
+  cfsetospeed(&t, B38400);
+  return tcsetattr(fd, TCSANOW, &t) == 0;
+}
+
+int elmOpenPty(std::string *slavePath, int *slaveKeep) {
+  const int m = posix_openpt(O_RDWR | O_NOCTTY);
+  if (m < 0)
+    return -1;
+  if (grantpt(m) != 0 || unlockpt(m) != 0) {
+    close(m);
+    return -1;
+  }
+  const char *name = ptsname(m);
+  if (!name) {
+    close(m);
+    return -1;
+  }
+  *slavePath = name;
+  *slaveKeep = open(name, O_RDWR | O_NOCTTY);
+  if (*slaveKeep < 0 || !elmSetRaw(*slaveKeep)) {
+    close(m);
+    return -1;
+  }
+  fcntl(m, F_SETFL, fcntl(m, F_GETFL) | O_NONBLOCK);
+  return m;
+}
+
+void elmServe(Elm327Emu &emu, int masterFd, const std::atomic<bool> &stop) {
+  char buf[256];
+  while (!stop) {
+    uint32_t now = elmMonoMs();
+    uint32_t due;
+    int waitMs = 20;
+    if (emu.nextDue(&due)) {
+      const int32_t d = (int32_t)(due - now);
+      waitMs = d <= 0 ? 0 : d < waitMs ? d : waitMs;
+    }
+    pollfd p = {masterFd, POLLIN, 0};
+    if (poll(&p, 1, waitMs) > 0 && (p.revents & POLLIN)) {
+      const ssize_t n = ::read(masterFd, buf, sizeof(buf));
+      if (n > 0)
+        emu.write(buf, (size_t)n, elmMonoMs());
+    }
+    now = elmMonoMs();
+    size_t n;
+    while ((n = emu.read(buf, sizeof(buf), now)) > 0) {
+      size_t off = 0;
+      while (off < n) {
+        const ssize_t w = ::write(masterFd, buf + off, n - off);
+        if (w > 0)
+          off += (size_t)w;
+        else
+          usleep(200);
+      }
+    }
+  }
+}
@@ -0,0 +1,23 @@
+/*
+ * NOCTURNE_OS — ELM327 emulator on a pseudo-terminal (Linux): the host side opens the slave like
+ * a USB-serial adapter (/dev/pts/N).
+ */
+#ifndef NOCTURNE_ELM327_PTY_H
+#define NOCTURNE_ELM327_PTY_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "Elm327Emu.h"
+
+/** Monotonic milliseconds. */
+uint32_t elmMonoMs();
+/** Raw 8N1 on a tty fd. */
+bool elmSetRaw(int fd);
+/** New PTY pair: master fd (non-blocking) and the slave path; -1 on error. The slave is opened once and
+ *  kept in *slaveKeep so the master does not see EIO while no client is attached. */
+int elmOpenPty(std::string *slavePath, int *slaveKeep);
+/** Serve the emulator on the master until stop is set. */
+void elmServe(Elm327Emu &emu, int masterFd, const std::atomic<bool> &stop);
+
+#endif
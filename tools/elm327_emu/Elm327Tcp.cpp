@@ -0,0 +1,131 @@
+/*
+ * NOCTURNE_OS — ELM327 emulator behind a TCP socket.
+ */
+#include "Elm327Tcp.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "Elm327Pty.h"
+
+int elmListenTcp(uint16_t port, bool anyAddr, uint16_t *boundPort) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = htonl(anyAddr ? INADDR_ANY : INADDR_LOOPBACK);
+  socklen_t len = sizeof(sa);
+  if (bind(fd, (sockaddr *)&sa, sizeof(sa)) != 0 || listen(fd, 2) != 0 ||
+      getsockname(fd, (sockaddr *)&sa, &len) != 0) {
+    close(fd);
+    return -1;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  if (boundPort)
+    *boundPort = ntohs(sa.sin_port);
+  return fd;
+}
+
+namespace {
+/** Bytes in flight over the simulated Wi-Fi hop, in order. */
+struct DelayLine {
+  std::deque<std::pair<uint32_t, std::string>> q;
+  void push(uint32_t atMs, const char *d, size_t n) {
+    if (!q.empty() && q.back().first == atMs)
+      q.back().second.append(d, n);
+    else
+      q.emplace_back(atMs, std::string(d, n));
+  }
+  bool due(uint32_t now) const { return !q.empty() && (int32_t)(now - q.front().first) >= 0; }
+};
+
+void sendAll(int fd, const std::string &s) {
+  size_t off = 0;
+  while (off < s.size()) {
+    const ssize_t w = send(fd, s.data() + off, s.size() - off, MSG_NOSIGNAL);
+    if (w > 0)
+      off += (size_t)w;
+    else if (w < 0 && errno != EAGAIN && errno != EINTR)
+      return;
+    else
+      usleep(200);
+  }
+}
+}  // namespace
+
+void elmServeTcp(Elm327Emu &emu, int listenFd, const std::atomic<bool> &stop, ElmTcpOptions &opt) {
+  int cli = -1;
+  DelayLine toEmu, toNet;
+  char buf[256];
+  while (!stop) {
+    uint32_t now = elmMonoMs();
+    if (cli >= 0 && opt.dropClient.exchange(false)) {
+      close(cli);
+      cli = -1;
+    }
+    if (cli < 0) {
+      toEmu.q.clear();
+      toNet.q.clear();
+      pollfd p = {listenFd, POLLIN, 0};
+      if (poll(&p, 1, 20) <= 0)
+        continue;
+      cli = accept(listenFd, nullptr, nullptr);
+      if (cli < 0)
+        continue;
+      fcntl(cli, F_SETFL, fcntl(cli, F_GETFL) | O_NONBLOCK);
+      int nd = opt.noDelay ? 1 : 0;
+      setsockopt(cli, IPPROTO_TCP, TCP_NODELAY, &nd, sizeof(nd));
+      opt.accepted++;
+    }
+
+    int waitMs = 20;
+    uint32_t due;
+    const auto limit = [&](uint32_t at) {
+      const int32_t d = (int32_t)(at - now);
+      waitMs = d <= 0 ? 0 : d < waitMs ? d : waitMs;
+    };
+    if (emu.nextDue(&due))
+      limit(due);
+    if (!toEmu.q.empty())
+      limit(toEmu.q.front().first);
+    if (!toNet.q.empty())
+      limit(toNet.q.front().first);
+    pollfd p = {cli, POLLIN, 0};
+    if (poll(&p, 1, waitMs) > 0 && (p.revents & (POLLIN | POLLHUP | POLLERR))) {
+      const ssize_t n = recv(cli, buf, sizeof(buf), 0);
+      if (n > 0) {
+        toEmu.push(elmMonoMs() + opt.netDelayMs, buf, (size_t)n);
+      } else if (n == 0 || errno != EAGAIN) {
+        close(cli);
+        cli = -1;
+        continue;
+      }
+    }
+    now = elmMonoMs();
+    while (toEmu.due(now)) {
+      emu.write(toEmu.q.front().second.data(), toEmu.q.front().second.size(), now);
+      toEmu.q.pop_front();
+    }
+    size_t n;
+    while ((n = emu.read(buf, sizeof(buf), now)) > 0)
+      toNet.push(now + opt.netDelayMs, buf, n);
+    while (toNet.due(now)) {
+      sendAll(cli, toNet.q.front().second);
+      toNet.q.pop_front();
+    }
+  }
+  if (cli >= 0)
+    close(cli);
+}
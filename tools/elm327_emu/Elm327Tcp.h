@@ -0,0 +1,24 @@
+/*
+ * NOCTURNE_OS — ELM327 emulator behind a TCP socket (Linux), like a Wi-Fi OBD adapter on port 35000.
+ * One client at a time; an optional one-way delay stands in for the Wi-Fi hop.
+ */
+#ifndef NOCTURNE_ELM327_TCP_H
+#define NOCTURNE_ELM327_TCP_H
+
+#include <atomic>
+#include <cstdint>
+#include "Elm327Emu.h"
+
+struct ElmTcpOptions {
+  uint32_t netDelayMs = 0;             /* added to every byte in both directions */
+  bool noDelay = true;                 /* TCP_NODELAY on the adapter side */
+  std::atomic<bool> dropClient{false}; /* close the current connection (adapter rebooted / out of range) */
+  std::atomic<uint32_t> accepted{0};
+};
+
+/** Non-blocking listening socket; port 0 = ephemeral. Loopback only unless anyAddr. -1 on error. */
+int elmListenTcp(uint16_t port, bool anyAddr, uint16_t *boundPort);
+/** Serve the emulator on accepted connections until stop is set. */
+void elmServeTcp(Elm327Emu &emu, int listenFd, const std::atomic<bool> &stop, ElmTcpOptions &opt);
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * NOCTURNE_OS — ELM327 emulator on a pseudo-terminal, or on TCP like a Wi-Fi adapter (--tcp 35000).
+ * Prints the slave device to open at 38400 8N1 (or the port). Faults are toggled from stdin:
+ *   off / on     ignition (NO DATA, UNABLE TO CONNECT while searching)
+ *   mute / unmute  adapter stops answering
+ *   err / ok     CAN ERROR on every request
+ *   drop         close the TCP connection (adapter out of range)
+ *   stats        requests and interrupted (STOPPED) replies
+ */
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "Elm327Emu.h"
+#include "Elm327Pty.h"
+#include "Elm327Tcp.h"
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--kline] [--no-multi] [--latency MS] [--jitter MS] [--search MS] [--seed N] "
+          "[--link PATH] [--tcp PORT [--net-delay MS]]\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  Elm327EmuConfig cfg;
+  const char *link = nullptr;
+  int tcpPort = -1;
+  ElmTcpOptions tcpOpt;
+  for (int i = 1; i < argc; i++) {
+    const bool more = i + 1 < argc;
+    if (!strcmp(argv[i], "--kline")) {
+      cfg.can = false;
+    } else if (!strcmp(argv[i], "--no-multi")) {
+      cfg.multiPid = false;
+    } else if (!strcmp(argv[i], "--latency") && more) {
+      cfg.latencyMs = (uint32_t)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--jitter") && more) {
+      cfg.jitterMs = (uint32_t)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--search") && more) {
+      cfg.searchMs = (uint32_t)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && more) {
+      cfg.seed = (uint32_t)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--link") && more) {
+      link = argv[++i];
+    } else if (!strcmp(argv[i], "--tcp") && more) {
+      tcpPort = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--net-delay") && more) {
+      tcpOpt.netDelayMs = (uint32_t)atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  std::string slave;
+  int keep = -1;
+  int master = -1;
+  uint16_t port = 0;
+  if (tcpPort >= 0) {
+    master = elmListenTcp((uint16_t)tcpPort, true, &port);
+    if (master < 0) {
+      perror("tcp");
+      return 1;
+    }
+    slave = "tcp port " + std::to_string(port);
+  } else {
+    master = elmOpenPty(&slave, &keep);
+    if (master < 0) {
+      perror("pty");
+      return 1;
+    }
+    if (link) {
+      unlink(link);
+      if (symlink(slave.c_str(), link) != 0)
+        perror("symlink");
+    }
+  }
+  printf("ELM327 (%s%s, latency %u+-%u ms) on %s\n", cfg.can ? "CAN" : "K-line", cfg.multiPid ? "" : ", no multi-PID",
+         (unsigned)cfg.latencyMs, (unsigned)cfg.jitterMs, link && tcpPort < 0 ? link : slave.c_str());
+  fflush(stdout);
+
+  Elm327Emu emu(cfg);
+  std::atomic<bool> stop{false};
+  std::thread server([&] {
+    if (tcpPort >= 0)
+      elmServeTcp(emu, master, stop, tcpOpt);
+    else
+      elmServe(emu, master, stop);
+  });
+
+  char line[64];
+  while (fgets(line, sizeof(line), stdin)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (!strcmp(line, "off"))
+      emu.ignitionOff = true;
+    else if (!strcmp(line, "on"))
+      emu.ignitionOff = false;
+    else if (!strcmp(line, "mute"))
+      emu.mute = true;
+    else if (!strcmp(line, "unmute"))
+      emu.mute = false;
+    else if (!strcmp(line, "err"))
+      emu.busError = true;
+    else if (!strcmp(line, "ok"))
+      emu.busError = false;
+    else if (!strcmp(line, "drop"))
+      tcpOpt.dropClient = true;
+    else if (!strcmp(line, "stats"))
+      printf("requests %u, stopped %u\n", (unsigned)emu.requests(), (unsigned)emu.stopped());
+    else if (line[0])
+      printf("? off|on|mute|unmute|err|ok|drop|stats\n");
+    fflush(stdout);
+  }
+  stop = true;
+  server.join();
+  if (link && tcpPort < 0)
+    unlink(link);
+  if (keep >= 0)
+    close(keep);
+  close(master);
+  return 0;
+}
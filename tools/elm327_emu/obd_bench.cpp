@@ -0,0 +1,376 @@
+/*
+ * NOCTURNE_OS — OBD throughput / latency / recovery benchmark against the ELM327 emulator.
+ * The emulator serves a pseudo-terminal (UART adapter) or a loopback TCP socket (Wi-Fi adapter) from a
+ * thread; the client runs the firmware's ObdSession over an ObdTransport exactly as ObdClient::tick() does
+ * (poll the link, drain up to 256 bytes, feed, poll, write), once per loop pass. The TCP side is the
+ * firmware's ObdTcpTransport.
+ *
+ * Reports per scenario: requests/s and samples/s per PID, request -> prompt round trip (p50/p90/p99/max),
+ * RPM update interval (p50/p99/max) and the longest client tick. Transports: UART vs TCP, with a simulated
+ * Wi-Fi hop and with Nagle left on. Recovery: cold start with protocol search, ignition off/on, hung
+ * adapter, CAN errors, TCP connection lost.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "Elm327Emu.h"
+#include "Elm327Pty.h"
+#include "Elm327Tcp.h"
+#include "ObdSession.h"
+#include "ObdTcpTransport.h"
+
+static uint32_t s_loopMs = 2;
+static const uint8_t kPidList[] = {OBD_PID_RPM, OBD_PID_SPEED, OBD_PID_COOLANT, OBD_PID_OIL};
+static const size_t kPids = sizeof(kPidList);
+
+struct Percentiles {
+  std::vector<uint32_t> v;
+  uint32_t at(double q) {
+    if (v.empty())
+      return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(q * (v.size() - 1) + 0.5))];
+  }
+};
+
+/** PTY slave as the firmware sees its UART (ObdSerialTransport): always up, non-blocking. */
+class PtyTransport : public ObdTransport {
+ public:
+  explicit PtyTransport(int fd) : fd_(fd) {}
+  void poll(uint32_t) override {}
+  bool ready() const override { return true; }
+  size_t read(char *buf, size_t cap) override {
+    const ssize_t n = ::read(fd_, buf, cap);
+    return n > 0 ? (size_t)n : 0;
+  }
+  bool write(const char *data, size_t len) override { return ::write(fd_, data, len) == (ssize_t)len; }
+  bool takeConnected() override {
+    const bool c = first_;
+    first_ = false;
+    return c;
+  }
+  const char *name() const override { return "uart"; }
+
+ private:
+  int fd_;
+  bool first_ = true;
+};
+
+/** Adapter link for a Rig: PTY, or TCP with an optional Wi-Fi delay and Nagle left on. */
+struct LinkConfig {
+  bool tcp = false;
+  uint32_t netDelayMs = 0;
+  bool nagleClient = false;
+  bool nagleAdapter = false;
+};
+
+/** One client on a PTY or TCP link served by an emulator thread. */
+class Rig {
+ public:
+  explicit Rig(const Elm327EmuConfig &cfg, const LinkConfig &link = LinkConfig()) : emu(cfg) {
+    if (link.tcp) {
+      uint16_t port = 0;
+      master_ = elmListenTcp(0, false, &port);
+      if (master_ < 0) {
+        perror("tcp");
+        exit(1);
+      }
+      tcpOpt.netDelayMs = link.netDelayMs;
+      tcpOpt.noDelay = !link.nagleAdapter;
+      tcp_.setNoDelay(!link.nagleClient);
+      tcp_.setServer("127.0.0.1", port);
+      transport_ = &tcp_;
+      server_ = std::thread([this] { elmServeTcp(emu, master_, stop_, tcpOpt); });
+    } else {
+      master_ = elmOpenPty(&slavePath_, &keep_);
+      if (master_ < 0) {
+        perror("pty");
+        exit(1);
+      }
+      fd_ = open(slavePath_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+      if (fd_ < 0 || !elmSetRaw(fd_)) {
+        perror(slavePath_.c_str());
+        exit(1);
+      }
+      pty_.reset(new PtyTransport(fd_));
+      transport_ = pty_.get();
+      server_ = std::thread([this] { elmServe(emu, master_, stop_); });
+    }
+    session.addPid(OBD_PID_RPM, 0);
+    session.addPid(OBD_PID_SPEED, 200);
+    session.addPid(OBD_PID_COOLANT, 2000);
+    session.addPid(OBD_PID_OIL, 2000);
+    session.reset(elmMonoMs());
+  }
+  ~Rig() {
+    stop_ = true;
+    server_.join();
+    tcp_.close();
+    if (fd_ >= 0)
+      close(fd_);
+    if (keep_ >= 0)
+      close(keep_);
+    close(master_);
+  }
+
+  /** One ObdClient::tick(). */
+  void tick() {
+    const auto t0 = std::chrono::steady_clock::now();
+    const uint32_t now = elmMonoMs();
+    transport_->poll(now);
+    if (transport_->takeConnected()) {
+      session.reset(now);
+      linkUp_ = true;
+      pending_ = false;
+    } else if (linkUp_ && !transport_->ready()) {
+      session.reset(now);
+      linkUp_ = false;
+    }
+    if (linkUp_) {
+      char buf[64];
+      size_t budget = 256;
+      while (budget > 0) {
+        const size_t n = transport_->read(buf, std::min(sizeof(buf), budget));
+        if (n == 0)
+          break;
+        session.feed(buf, n, now);
+        budget -= n;
+        if (pending_ && memchr(buf, '>', n)) {
+          rtt.v.push_back(now - sentMs_);
+          pending_ = false;
+        }
+      }
+      char cmd[24];
+      const size_t len = session.poll(now, cmd, sizeof(cmd));
+      if (len > 0) {
+        if (!transport_->write(cmd, len))
+          fprintf(stderr, "write failed\n");
+        /* PID requests only; init and resync commands are not part of the latency figures. */
+        pending_ = session.initialized() && cmd[0] == '0' && cmd[1] == '1';
+        sentMs_ = now;
+      }
+    }
+    if (session.takeUpdate()) {
+      for (size_t i = 0; i < kPids; i++) {
+        uint32_t at;
+        if (!session.value(kPidList[i], nullptr, &at) || at == lastAt_[i])
+          continue;
+        if (lastAt_[i]) {
+          gapSum_[i] += at - lastAt_[i];
+          gapCount_[i]++;
+          if (i == 0)
+            rpmGap.v.push_back(at - lastAt_[i]);
+        }
+        lastAt_[i] = at;
+      }
+    }
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    tickMaxUs = std::max(tickMaxUs, us);
+  }
+
+  /** Loop for ms, or until done() returns true; returns elapsed ms. */
+  template <class F>
+  uint32_t run(uint32_t ms, F done) {
+    const uint32_t start = elmMonoMs();
+    while (elmMonoMs() - start < ms) {
+      tick();
+      if (done())
+        break;
+      usleep(s_loopMs * 1000);
+    }
+    return elmMonoMs() - start;
+  }
+  uint32_t run(uint32_t ms) {
+    return run(ms, [] { return false; });
+  }
+
+  void clearStats() {
+    rtt.v.clear();
+    rpmGap.v.clear();
+    tickMaxUs = 0;
+    for (size_t i = 0; i < kPids; i++)
+      gapSum_[i] = gapCount_[i] = 0;
+  }
+  /** Samples per second from the mean update interval (no window edge effects for slow PIDs). */
+  double rate(size_t i) const { return gapSum_[i] ? gapCount_[i] * 1000.0 / gapSum_[i] : 0.0; }
+
+  Elm327Emu emu;
+  ElmTcpOptions tcpOpt;
+  ObdSession session;
+  Percentiles rtt;
+  Percentiles rpmGap;
+  double tickMaxUs = 0;
+  const ObdTcpTransport &tcp() const { return tcp_; }
+
+ private:
+  std::string slavePath_;
+  int master_ = -1;
+  int keep_ = -1;
+  int fd_ = -1;
+  std::unique_ptr<PtyTransport> pty_;
+  ObdTcpTransport tcp_;
+  ObdTransport *transport_ = nullptr;
+  std::thread server_;
+  std::atomic<bool> stop_{false};
+  bool linkUp_ = false;
+  bool pending_ = false;
+  uint32_t sentMs_ = 0;
+  uint32_t lastAt_[kPids] = {};
+  uint64_t gapSum_[kPids] = {};
+  uint32_t gapCount_[kPids] = {};
+};
+
+static bool waitInit(Rig &rig) {
+  return rig.run(20000, [&] { return rig.session.initialized() && rig.session.samples(OBD_PID_RPM) > 0; }) < 20000;
+}
+
+static void throughput(const char *name, bool can, bool multi, uint32_t latencyMs, uint32_t seconds,
+                       const LinkConfig &link = LinkConfig()) {
+  Elm327EmuConfig cfg;
+  cfg.can = can;
+  cfg.multiPid = multi;
+  cfg.latencyMs = latencyMs;
+  cfg.jitterMs = latencyMs / 5;
+  cfg.searchMs = 300;
+  Rig rig(cfg, link);
+  if (!waitInit(rig)) {
+    printf("  %-16s %3u ms  init failed\n", name, (unsigned)latencyMs);
+    return;
+  }
+  rig.clearStats();
+  ObdSession &s = rig.session;
+  const uint32_t req0 = s.requests(), stop0 = rig.emu.stopped();
+  const double secs = rig.run(seconds * 1000) / 1000.0;
+  printf("  %-16s %3u ms  %5.1f  %5.1f  %4.1f  %4.2f  %4.2f   %3u/%3u/%3u/%3u   %3u/%3u/%4u  %6.1f  %u\n", name,
+         (unsigned)latencyMs, (s.requests() - req0) / secs, rig.rate(0), rig.rate(1), rig.rate(2), rig.rate(3),
+         rig.rtt.at(0.5), rig.rtt.at(0.9), rig.rtt.at(0.99),
+         rig.rtt.at(1.0), rig.rpmGap.at(0.5), rig.rpmGap.at(0.99), rig.rpmGap.at(1.0), rig.tickMaxUs,
+         (unsigned)(rig.emu.stopped() - stop0));
+}
+
+/** Time from now until a new RPM sample arrives (and the session says connected). */
+static uint32_t untilRpm(Rig &rig, uint32_t limitMs) {
+  const uint32_t n0 = rig.session.samples(OBD_PID_RPM);
+  return rig.run(limitMs, [&] { return rig.session.connected() && rig.session.samples(OBD_PID_RPM) > n0; });
+}
+
+static void recovery() {
+  Elm327EmuConfig cfg;
+  cfg.searchMs = 1500;
+
+  {
+    Rig rig(cfg);
+    const uint32_t t = untilRpm(rig, 20000);
+    printf("  cold start (ATZ %u ms, search %u ms): first RPM after %u ms, %u commands\n", (unsigned)cfg.resetMs,
+           (unsigned)cfg.searchMs, (unsigned)t, (unsigned)rig.session.requests());
+  }
+  {
+    Rig rig(cfg);
+    rig.emu.ignitionOff = true;
+    rig.run(6000);
+    const bool initWhileOff = rig.session.initialized();
+    rig.emu.ignitionOff = false;
+    const uint32_t t = untilRpm(rig, 20000);
+    printf("  start with ignition off 6 s: initialized while off %s, first RPM %u ms after ignition on\n",
+           initWhileOff ? "yes" : "no", (unsigned)t);
+  }
+  {
+    Rig rig(cfg);
+    waitInit(rig);
+    rig.run(1000);
+    rig.emu.ignitionOff = true;
+    const uint32_t r0 = rig.emu.requests();
+    const uint32_t lost = rig.run(10000, [&] { return !rig.session.connected(); });
+    rig.run(8000 - lost);
+    const uint32_t reqOff = rig.emu.requests() - r0;
+    rig.emu.ignitionOff = false;
+    const uint32_t t = untilRpm(rig, 10000);
+    printf("  ignition off 8 s: disconnected after %u ms, %u requests while off, first RPM %u ms after on\n",
+           (unsigned)lost, (unsigned)reqOff, (unsigned)t);
+  }
+  {
+    Rig rig(cfg);
+    waitInit(rig);
+    rig.run(1000);
+    rig.emu.mute = true;
+    const uint32_t t0 = rig.session.timeouts(), x0 = rig.session.resets();
+    rig.run(6000);
+    rig.emu.mute = false;
+    const uint32_t t = untilRpm(rig, 20000);
+    printf("  adapter hung 6 s: %u timeouts, %u resets, first RPM %u ms after it answers again\n",
+           (unsigned)(rig.session.timeouts() - t0), (unsigned)(rig.session.resets() - x0), (unsigned)t);
+  }
+  {
+    Rig rig(cfg);
+    waitInit(rig);
+    rig.run(1000);
+    rig.emu.busError = true;
+    rig.run(3000);
+    const uint8_t st = rig.session.lastStatus();
+    rig.emu.busError = false;
+    const uint32_t t = untilRpm(rig, 10000);
+    printf("  CAN ERROR 3 s: status %s, first RPM %u ms after the bus is back\n",
+           st == OBD_RESP_BUS_ERROR ? "BUS_ERROR" : "other", (unsigned)t);
+  }
+  {
+    LinkConfig link;
+    link.tcp = true;
+    Rig rig(cfg, link);
+    waitInit(rig);
+    rig.run(1000);
+    rig.tcpOpt.dropClient = true;
+    const uint32_t lost = rig.run(5000, [&] { return !rig.session.connected(); });
+    const uint32_t t = untilRpm(rig, 20000);
+    printf("  Wi-Fi adapter drops TCP: noticed after %u ms, first RPM %u ms later (%u connects, %u drops), "
+           "tick max %.0f us\n",
+           (unsigned)lost, (unsigned)t, (unsigned)rig.tcp().connects(), (unsigned)rig.tcp().drops(), rig.tickMaxUs);
+  }
+}
+
+int main(int argc, char **argv) {
+  uint32_t seconds = 8;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = (uint32_t)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--loop-ms") && i + 1 < argc) {
+      s_loopMs = (uint32_t)atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--seconds N] [--loop-ms N]\n", argv[0]);
+      return 2;
+    }
+  }
+  printf("Throughput, %u s per row, loop every %u ms (38400 baud, jitter latency/5):\n", (unsigned)seconds,
+         (unsigned)s_loopMs);
+  printf("  %-16s %6s  %5s  %5s  %4s  %4s  %4s   %-15s   %-12s  %6s  %s\n", "bus", "ecu", "req/s", "rpm/s",
+         "spd", "cool", "oil", "rtt p50/90/99/max", "rpm gap 50/99/max", "tick us", "STOPPED");
+  const uint32_t latencies[] = {10, 25, 50};
+  for (uint32_t lat : latencies) {
+    throughput("CAN multi-PID", true, true, lat, seconds);
+    throughput("CAN single-PID", true, false, lat, seconds);
+    throughput("K-line", false, true, lat, seconds);
+  }
+  printf("Transports (CAN multi-PID, 25 ms ECU, adapter UART 38400):\n");
+  {
+    LinkConfig tcp, wifi, nagleClient, nagleBoth;
+    tcp.tcp = wifi.tcp = nagleClient.tcp = nagleBoth.tcp = true;
+    wifi.netDelayMs = nagleClient.netDelayMs = nagleBoth.netDelayMs = 3;
+    nagleClient.nagleClient = nagleBoth.nagleClient = nagleBoth.nagleAdapter = true;
+    throughput("UART (PTY)", true, true, 25, seconds);
+    throughput("TCP loopback", true, true, 25, seconds, tcp);
+    throughput("TCP +3 ms Wi-Fi", true, true, 25, seconds, wifi);
+    throughput(" Nagle on here", true, true, 25, seconds, nagleClient);
+    throughput(" Nagle on both", true, true, 25, seconds, nagleBoth);
+  }
+  printf("Recovery (CAN, 25 ms):\n");
+  recovery();
+  return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * NOCTURNE_OS — load generator for the reference monitor server.
+ */
+#include "LoadGen.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "nocturne/config.h"
+
+namespace {
+
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+/** [0, end) of line without the trailing newline and blanks. */
+size_t trimmedEnd(const char *line, size_t n) {
+  while (n > 0 && isSpace(line[n - 1]))
+    n--;
+  return n;
+}
+
+uint32_t nextRand(uint32_t *s) {
+  *s = *s * 1664525u + 1013904223u;
+  return *s >> 8;
+}
+
+double percentile(std::vector<uint32_t> &v, double p) {
+  if (v.empty())
+    return 0;
+  const size_t i = (size_t)(p * (double)(v.size() - 1) + 0.5);
+  std::nth_element(v.begin(), v.begin() + (long)i, v.end());
+  return v[i];
+}
+
+void printDist(FILE *f, const char *what, std::vector<uint32_t> &v) {
+  if (v.empty())
+    return;
+  const double maxV = *std::max_element(v.begin(), v.end());
+  fprintf(f, " %s p50 %.1f p99 %.1f max %.1f ms;", what, percentile(v, 0.5) / 1000.0, percentile(v, 0.99) / 1000.0,
+          maxV / 1000.0);
+}
+
+}  // namespace
+
+bool stampLine(const char *line, size_t n, uint32_t ln, size_t size, std::string *out) {
+  n = trimmedEnd(line, n);
+  size_t start = 0;
+  while (start < n && isSpace(line[start]))
+    start++;
+  if (n - start < 2 || line[start] != '{' || line[n - 1] != '}')
+    return false;
+  size_t body = n - 1; /* the closing brace */
+  size_t last = body;
+  while (last > start + 1 && isSpace(line[last - 1]))
+    last--;
+  const bool empty = last == start + 1;
+  out->assign(line + start, body - start);
+  char num[24];
+  snprintf(num, sizeof(num), "%s\"ln\":%u", empty ? "" : ",", (unsigned)ln);
+  out->append(num);
+  static const size_t kPadOverhead = sizeof(",\"pd\":\"\"") - 1;
+  if (size > out->size() + kPadOverhead + 2) {
+    out->append(",\"pd\":\"");
+    out->append(size - out->size() - 3, 'x'); /* closing quote, brace, newline */
+    out->push_back('"');
+  }
+  out->append("}\n");
+  return true;
+}
+
+const char *malformedName(Malformed kind) {
+  static const char *const kNames[MF_COUNT] = {"truncated", "unclosed", "garbage", "trailing", "overlong"};
+  return kind < MF_COUNT ? kNames[kind] : "?";
+}
+
+std::string malformedLine(const char *line, size_t n, Malformed kind, uint32_t seed) {
+  n = trimmedEnd(line, n);
+  std::string s;
+  switch (kind) {
+    case MF_TRUNCATED: {
+      /* Just after a colon past the middle: the value is missing, the object is not closed. */
+      const char *colon = n > 2 ? (const char *)memchr(line + n / 2, ':', n - n / 2) : nullptr;
+      s.assign(line, colon ? (size_t)(colon - line) + 1 : n / 2);
+      break;
+    }
+    case MF_UNCLOSED:
+      s.assign(line, n > 0 && line[n - 1] == '}' ? n - 1 : n);
+      s.append(",\"trk\":\"never closed}");
+      break;
+    case MF_GARBAGE: {
+      const size_t len = 16 + seed % 48;
+      for (size_t i = 0; i < len; i++) {
+        const char c = (char)(1 + nextRand(&seed) % 255);
+        s.push_back(c == '\n' ? '{' : c);
+      }
+      break;
+    }
+    case MF_TRAILING:
+      s.assign(line, n);
+      s.append(",{\"ct\":1}");
+      break;
+    case MF_OVERLONG:
+    default:
+      s.assign("{\"pd\":\"");
+      s.append(NOCT_TCP_LINE_MAX, 'x');
+      s.append("\"}");
+      break;
+  }
+  s.push_back('\n');
+  return s;
+}
+
+bool Replay::load(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return false;
+  lines_.clear();
+  pos_ = 0;
+  char *buf = nullptr;
+  size_t cap = 0;
+  ssize_t len;
+  while ((len = getline(&buf, &cap, f)) >= 0) {
+    const size_t end = trimmedEnd(buf, (size_t)len);
+    size_t start = 0;
+    while (start < end && isSpace(buf[start]))
+      start++;
+    if (start < end && buf[start] == '{')
+      lines_.emplace_back(buf + start, end - start);
+  }
+  free(buf);
+  fclose(f);
+  return !lines_.empty();
+}
+
+const std::string &Replay::next() {
+  const std::string &s = lines_[pos_];
+  pos_ = (pos_ + 1) % lines_.size();
+  return s;
+}
+
+void MarkStats::sent(uint32_t ln, uint64_t nowUs, size_t bytes) {
+  Sent &s = ring_[ln % kRing];
+  s.ln = ln;
+  s.us = nowUs;
+  lines_++;
+  bytes_ += bytes;
+}
+
+void MarkStats::mark(const LinkMark &m, uint64_t nowUs) {
+  const Sent &s = ring_[(uint32_t)m.ln % kRing];
+  const bool known = s.ln == (uint32_t)m.ln;
+  if (m.kind == LinkMark::ACK) {
+    acks_++;
+    parsed_ += m.lines;
+    rejected_ += m.rejected;
+    parseUs_ += m.parseUs;
+    if (known)
+      ackUs_.push_back((uint32_t)(nowUs - s.us));
+  } else {
+    frames_++;
+    frameUs_.push_back(m.frameUs);
+    if (known)
+      frameLatUs_.push_back((uint32_t)(nowUs - s.us));
+  }
+  if (!known)
+    unmatched_++;
+}
+
+bool MarkStats::report(FILE *f, double seconds) {
+  const bool any = acks_ || frames_;
+  fprintf(f, "[marks] sent %llu lines, %.0f B avg, %llu malformed;", (unsigned long long)lines_,
+          lines_ ? (double)bytes_ / (double)lines_ : 0.0, (unsigned long long)bad_);
+  if (!any) {
+    fprintf(f, " no markers from the device (NOCT_LINK_MARKS=1, env pc_companion_linkmarks)\n");
+  } else {
+    const double perLine = parsed_ ? (double)parseUs_ / (double)parsed_ : 0.0;
+    const double perKb = bytes_ && lines_ ? perLine * 1024.0 / ((double)bytes_ / (double)lines_) : 0.0;
+    fprintf(f, " device parsed %llu (%llu rejected), %.1f us/line, %.1f us/KB; %.1f acks/s, %.1f frames/s",
+            (unsigned long long)parsed_, (unsigned long long)rejected_, perLine, perKb, acks_ / seconds,
+            frames_ / seconds);
+    if (unmatched_)
+      fprintf(f, ", %llu unmatched", (unsigned long long)unmatched_);
+    fprintf(f, "\n[marks]");
+    printDist(f, "ack", ackUs_);
+    printDist(f, "line->frame", frameLatUs_);
+    printDist(f, "frame", frameUs_);
+    fprintf(f, "\n");
+  }
+  ackUs_.clear();
+  frameLatUs_.clear();
+  frameUs_.clear();
+  lines_ = bytes_ = bad_ = parsed_ = rejected_ = parseUs_ = acks_ = frames_ = unmatched_ = 0;
+  return any;
+}
@@ -0,0 +1,67 @@
+/*
+ * NOCTURNE_OS — load generator for the reference monitor server (Linux): stamped and padded lines, replay,
+ * malformed lines, and statistics from the device's link markers (LinkMarks.h).
+ */
+#ifndef NOCTURNE_LOAD_GEN_H
+#define NOCTURNE_LOAD_GEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "LinkMarks.h"
+
+/** line (one JSON object, '\n' optional) with ,"ln":<ln> before the closing brace and, if that leaves it
+ *  shorter than size bytes with the newline, ,"pd":"xxx..." to make it size. False if line is no object. */
+bool stampLine(const char *line, size_t n, uint32_t ln, size_t size, std::string *out);
+
+/** Faults the device must survive without changing what it shows. */
+enum Malformed : uint8_t {
+  MF_TRUNCATED, /* cut in the middle of a value */
+  MF_UNCLOSED,  /* string never closed */
+  MF_GARBAGE,   /* binary noise */
+  MF_TRAILING,  /* a valid object, then junk */
+  MF_OVERLONG,  /* longer than NOCT_TCP_LINE_MAX: the framer drops it before the decoder */
+  MF_COUNT
+};
+const char *malformedName(Malformed kind);
+/** A malformed variant of line (with '\n'). */
+std::string malformedLine(const char *line, size_t n, Malformed kind, uint32_t seed);
+
+/** Lines recorded from a server (--record, or one JSON object per line from anywhere), replayed in a loop. */
+class Replay {
+ public:
+  /** False if the file cannot be read or holds no object. */
+  bool load(const char *path);
+  size_t size() const { return lines_.size(); }
+  /** The next line (without '\n'), from the first after the last. */
+  const std::string &next();
+
+ private:
+  std::vector<std::string> lines_;
+  size_t pos_ = 0;
+};
+
+/** Lines sent, matched with the device's @ack / @frm by line number; report() prints a window and clears it. */
+class MarkStats {
+ public:
+  void sent(uint32_t ln, uint64_t nowUs, size_t bytes);
+  void malformed() { bad_++; }
+  void mark(const LinkMark &m, uint64_t nowUs);
+  /** True if any marker arrived in the window. */
+  bool report(FILE *f, double seconds);
+
+ private:
+  static const size_t kRing = 16384; /* lines in flight: 80 s at 200 lines/s */
+  struct Sent {
+    uint32_t ln = 0xFFFFFFFFu;
+    uint64_t us = 0;
+  };
+  Sent ring_[kRing];
+  std::vector<uint32_t> ackUs_, frameLatUs_, frameUs_;
+  uint64_t lines_ = 0, bytes_ = 0, bad_ = 0;
+  uint64_t parsed_ = 0, rejected_ = 0, parseUs_ = 0, acks_ = 0, frames_ = 0, unmatched_ = 0;
+};
+
+#endif
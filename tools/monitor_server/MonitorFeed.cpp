@@ -0,0 +1,406 @@
+/*
+ * NOCTURNE_OS — reference PC side of the monitor link: synthetic PC and line scheduler.
+ */
+#include "MonitorFeed.h"
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "nocturne/config.h"
+
+namespace {
+
+/** Appends to a fixed buffer; stays failed once something did not fit. */
+struct Out {
+  char *p;
+  size_t cap;
+  size_t n = 0;
+  bool ok = true;
+
+  Out(char *buf, size_t c) : p(buf), cap(c) {
+    if (cap)
+      p[0] = '\0';
+    else
+      ok = false;
+  }
+  void f(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    if (!ok)
+      return;
+    va_list ap;
+    va_start(ap, fmt);
+    const int w = vsnprintf(p + n, cap - n, fmt, ap);
+    va_end(ap);
+    if (w < 0 || (size_t)w >= cap - n)
+      ok = false;
+    else
+      n += (size_t)w;
+  }
+  /** JSON string literal; control characters and non-ASCII bytes as \u00XX like Python's json.dumps
+   *  would for Latin-1 (the model only produces ASCII). */
+  void str(const char *s) {
+    f("\"");
+    for (; ok && *s; s++) {
+      const unsigned char c = (unsigned char)*s;
+      if (c == '"' || c == '\\')
+        f("\\%c", c);
+      else if (c < 0x20 || c >= 0x7F)
+        f("\\u%04x", c);
+      else
+        f("%c", c);
+    }
+    f("\"");
+  }
+  size_t done() const { return ok ? n : 0; }
+};
+
+const char *const kSceneNames[] = {"MAIN", "CPU", "GPU", "RAM", "DISKS", "MEDIA", "FANS", "MOTHERBOARD"};
+const char *const kMetricNames[] = {"ct", "gt", "cl", "gl", "gv", "ram"};
+
+const char *const kCpuProcs[] = {"chrome.exe", "Code.exe", "cl.exe", "obs64.exe", "Discord.exe", "explorer.exe"};
+const char *const kRamProcs[] = {"chrome.exe", "Code.exe", "blender.exe", "Teams.exe"};
+const char *const kArtists[] = {"Carpenter Brut", "Perturbator", "Kavinsky", "Daft Punk"};
+const char *const kTracks[] = {"Turbo Killer", "Future Club", "Nightcall", "Contact"};
+const char *const kWeather[] = {"Cloudy", "Light rain", "Clear sky", "Fog"};
+const int kWeatherCodes[] = {3, 61, 0, 45};
+
+const int kCpuLimit = 75; /* server config.json "limits" defaults */
+const int kGpuLimit = 80;
+
+int clampi(int v, int lo, int hi) { return v < lo ? lo : v > hi ? hi : v; }
+int roundTo(float v, int step) { return (int)lroundf(v / (float)step) * step; }
+
+}  // namespace
+
+/* ── PcModel ── */
+
+PcModel::PcModel(uint32_t seed) : rng_(seed ? seed : 1) {
+  st_.hw.hdd[0].name[0] = 'C';
+  st_.hw.hdd[0].total_gb = 931.5f;
+  st_.hw.hdd[0].used_gb = 412.3f;
+  st_.hw.hdd[0].temp = 36;
+  st_.hw.hdd[1].name[0] = 'D';
+  st_.hw.hdd[1].total_gb = 1863.0f;
+  st_.hw.hdd[1].used_gb = 1204.8f;
+  st_.hw.hdd[1].temp = 31;
+  st_.hw.vt = 12.0f;
+  st_.hw.gtdp = 220;
+  sample();
+}
+
+uint32_t PcModel::rnd(uint32_t n) {
+  rng_ = rng_ * 1103515245u + 12345u;
+  return (rng_ >> 8) % n;
+}
+
+float PcModel::noise(float amp) { return amp * ((float)rnd(2001) / 1000.0f - 1.0f); }
+
+void PcModel::advance(uint32_t nowMs) {
+  while (nowMs - t_ >= kSampleMs) {
+    t_ += kSampleMs;
+    sample();
+  }
+}
+
+void PcModel::sample() {
+  samples_++;
+  HardwareData &hw = st_.hw;
+  /* Load: a new working set every ~20 s, jitter on top. */
+  static const float kCpuTargets[] = {8, 22, 65, 95, 35, 12};
+  static const float kGpuTargets[] = {5, 40, 97, 60, 20, 85};
+  const uint32_t phase = samples_ / 200;
+  cpuLoad_ += (kCpuTargets[phase % 6] - cpuLoad_) * 0.08f + noise(4);
+  gpuLoad_ += (kGpuTargets[(phase + 2) % 6] - gpuLoad_) * 0.06f + noise(3);
+  cpuLoad_ = cpuLoad_ < 1 ? 1 : cpuLoad_ > 100 ? 100 : cpuLoad_;
+  gpuLoad_ = gpuLoad_ < 0 ? 0 : gpuLoad_ > 100 ? 100 : gpuLoad_;
+  cpuTemp_ += (38 + 0.5f * cpuLoad_ - cpuTemp_) * 0.02f;
+  gpuTemp_ += (36 + 0.5f * gpuLoad_ - gpuTemp_) * 0.015f;
+
+  hw.cl = (int)lroundf(cpuLoad_);
+  hw.gl = (int)lroundf(gpuLoad_);
+  hw.ct = (int)lroundf(cpuTemp_);
+  hw.gt = (int)lroundf(gpuTemp_);
+  hw.gh = hw.gt + 11;
+  hw.cc = roundTo(3600 + 12 * cpuLoad_ + noise(60), 25);
+  hw.pw = (int)lroundf(18 + 1.1f * cpuLoad_ + noise(2));
+  hw.gclock = gpuLoad_ < 3 ? 210 : roundTo(1400 + 12 * gpuLoad_ + noise(30), 15);
+  hw.vclock = gpuLoad_ < 3 ? 405 : 10501;
+  hw.gv = (int)lroundf(700 + 3 * gpuLoad_);
+  hw.vu = roundf((2.1f + 0.06f * gpuLoad_) * 10) / 10;
+  hw.ch = (int)lroundf(cpuTemp_ - 4);
+
+  if (rnd(10) == 0)
+    ramUsed_ += noise(0.15f);
+  hw.ru = roundf(ramUsed_ * 10) / 10;
+  hw.ra = roundf((31.9f - ramUsed_) * 10) / 10;
+
+  hw.nd = rnd(8) == 0 ? (int)rnd(4000) : (int)rnd(40);
+  hw.nu = (int)rnd(30);
+  hw.pg = 12 + (int)rnd(3);
+  hw.dr = rnd(6) == 0 ? (int)rnd(180) : 0;
+  hw.dw = rnd(5) == 0 ? (int)rnd(90) : 0;
+
+  /* Fans follow temperatures, read back with a few rpm of jitter. */
+  hw.cf = roundTo(500 + 14 * (cpuTemp_ - 30) + noise(12), 10);
+  hw.s1 = roundTo(2100 + noise(15), 10);
+  hw.gf = gpuTemp_ < 50 ? 0 : roundTo(900 + 25 * (gpuTemp_ - 50) + noise(12), 10);
+  hw.s2 = roundTo(850 + noise(10), 10);
+  hw.fans[0] = hw.cf;
+  hw.fans[1] = hw.s1;
+  hw.fans[2] = hw.gf;
+  hw.fans[3] = hw.s2;
+  hw.fan_controls[0] = clampi((int)lroundf(2 * (cpuTemp_ - 30)), 20, 100);
+  hw.fan_controls[1] = 80;
+  hw.fan_controls[2] = gpuTemp_ < 50 ? 0 : clampi((int)lroundf(3 * (gpuTemp_ - 45)), 30, 100);
+  hw.fan_controls[3] = 45;
+
+  hw.mb_sys = (int)lroundf(31 + cpuLoad_ / 25);
+  hw.mb_vrm = (int)lroundf(40 + cpuLoad_ / 6);
+  hw.mb_vsoc = (int)lroundf(42 + cpuLoad_ / 12);
+  hw.mb_chipset = (int)lroundf(47 + cpuLoad_ / 30);
+
+  if (rnd(600) == 0)
+    hw.hdd[rnd(2)].temp += rnd(2) ? 1 : -1;
+  if (rnd(3000) == 0)
+    hw.hdd[0].used_gb += 0.1f;
+
+  /* Processes: sampled every second like Task Manager, reordered now and then. */
+  if (samples_ % 10 == 0) {
+    if (rnd(30) == 0)
+      procs_++;
+    for (int i = 0; i < 3; i++) {
+      st_.process.cpuNames[i] = kCpuProcs[(procs_ + i) % 6];
+      st_.process.cpuPercent[i] = clampi((int)lroundf(cpuLoad_ / (2 + i) + noise(3)), 0, 100);
+    }
+    for (int i = 0; i < 2; i++) {
+      st_.process.ramNames[i] = kRamProcs[(procs_ + i) % 4];
+      st_.process.ramMb[i] = (2400 - 900 * i) + (int)rnd(40);
+    }
+  }
+
+  /* Media: a new track every 3 min; weather refreshed every 10 min. */
+  if (samples_ % 1800 == 1) {
+    st_.media.artist = kArtists[track_ % 4];
+    st_.media.track = kTracks[track_ % 4];
+    st_.media.isPlaying = true;
+    st_.media.mediaStatus = "PLAYING";
+    track_++;
+  }
+  if (samples_ % 6000 == 1) {
+    st_.weatherReceived = true;
+    st_.weather.temp = 7 + (int)rnd(3) - 1;
+    st_.weather.desc = kWeather[weather_ % 4];
+    st_.weather.wmoCode = kWeatherCodes[weather_ % 4];
+    weather_++;
+  }
+
+  /* Alerts as the Python server raises them: the hotter of CPU / GPU over its limit. */
+  if (hw.gt >= kGpuLimit) {
+    st_.alertActive = true;
+    st_.alertTargetScene = NOCT_SCENE_GPU;
+    st_.alertMetric = NOCT_ALERT_GT;
+  } else if (hw.ct >= kCpuLimit) {
+    st_.alertActive = true;
+    st_.alertTargetScene = NOCT_SCENE_CPU;
+    st_.alertMetric = NOCT_ALERT_CT;
+  } else {
+    st_.alertActive = false;
+    st_.alertTargetScene = NOCT_SCENE_MAIN;
+    st_.alertMetric = -1;
+  }
+}
+
+/* ── JSON ── */
+
+size_t writeField(StateField f, const AppState &st, char *buf, size_t cap) {
+  const HardwareData &hw = st.hw;
+  Out o(buf, cap);
+  switch (f) {
+    case SF_CT: o.f("\"ct\":%d", hw.ct); break;
+    case SF_GT: o.f("\"gt\":%d", hw.gt); break;
+    case SF_CL: o.f("\"cl\":%d", hw.cl); break;
+    case SF_GL: o.f("\"gl\":%d", hw.gl); break;
+    case SF_CC: o.f("\"cc\":%d", hw.cc); break;
+    case SF_PW: o.f("\"pw\":%d", hw.pw); break;
+    case SF_GH: o.f("\"gh\":%d", hw.gh); break;
+    case SF_GV: o.f("\"gv\":%d", hw.gv); break;
+    case SF_GCLOCK: o.f("\"gclock\":%d", hw.gclock); break;
+    case SF_VCLOCK: o.f("\"vclock\":%d", hw.vclock); break;
+    case SF_GTDP: o.f("\"gtdp\":%d", hw.gtdp); break;
+    case SF_RU: o.f("\"ru\":%.1f", hw.ru); break;
+    case SF_RA: o.f("\"ra\":%.1f", hw.ra); break;
+    case SF_ND: o.f("\"nd\":%d", hw.nd); break;
+    case SF_NU: o.f("\"nu\":%d", hw.nu); break;
+    case SF_PG: o.f("\"pg\":%d", hw.pg); break;
+    case SF_CF: o.f("\"cf\":%d", hw.cf); break;
+    case SF_S1: o.f("\"s1\":%d", hw.s1); break;
+    case SF_S2: o.f("\"s2\":%d", hw.s2); break;
+    case SF_GF: o.f("\"gf\":%d", hw.gf); break;
+    case SF_FANS:
+    case SF_FAN_CONTROLS: {
+      const int *v = f == SF_FANS ? hw.fans : hw.fan_controls;
+      o.f("\"%s\":[%d,%d,%d,%d]", f == SF_FANS ? "fans" : "fan_controls", v[0], v[1], v[2], v[3]);
+      break;
+    }
+    case SF_HDD: {
+      o.f("\"hdd\":[");
+      bool first = true;
+      for (int i = 0; i < NOCT_HDD_COUNT; i++) {
+        const HddEntry &d = hw.hdd[i];
+        if (d.total_gb <= 0)
+          continue;
+        o.f("%s{\"n\":\"%c\",\"u\":%.1f,\"tot\":%.1f,\"t\":%d}", first ? "" : ",", d.name[0], d.used_gb,
+            d.total_gb, d.temp);
+        first = false;
+      }
+      o.f("]");
+      break;
+    }
+    case SF_VU: o.f("\"vu\":%.1f", hw.vu); break;
+    case SF_VT: o.f("\"vt\":%.1f", hw.vt); break;
+    case SF_CH: o.f("\"ch\":%d", hw.ch); break;
+    case SF_MB_SYS: o.f("\"mb_sys\":%d", hw.mb_sys); break;
+    case SF_MB_VSOC: o.f("\"mb_vsoc\":%d", hw.mb_vsoc); break;
+    case SF_MB_VRM: o.f("\"mb_vrm\":%d", hw.mb_vrm); break;
+    case SF_MB_CHIPSET: o.f("\"mb_chipset\":%d", hw.mb_chipset); break;
+    case SF_DR: o.f("\"dr\":%d", hw.dr); break;
+    case SF_DW: o.f("\"dw\":%d", hw.dw); break;
+    case SF_WEATHER:
+      if (!st.weatherReceived) {
+        o.f("\"wt\":null");
+        break;
+      }
+      o.f("\"wt\":%d,\"wd\":", st.weather.temp);
+      o.str(st.weather.desc.c_str());
+      o.f(",\"wi\":%d", st.weather.wmoCode);
+      break;
+    case SF_TOP_CPU:
+    case SF_TOP_RAM: {
+      const bool cpu = f == SF_TOP_CPU;
+      o.f("\"%s\":[", cpu ? "tp" : "tr");
+      for (int i = 0; i < (cpu ? 3 : 2); i++) {
+        o.f("%s{\"n\":", i ? "," : "");
+        o.str(cpu ? st.process.cpuNames[i].c_str() : st.process.ramNames[i].c_str());
+        o.f(",\"%c\":%d}", cpu ? 'c' : 'r', cpu ? st.process.cpuPercent[i] : st.process.ramMb[i]);
+      }
+      o.f("]");
+      break;
+    }
+    case SF_ARTIST:
+      o.f("\"art\":");
+      o.str(st.media.artist.c_str());
+      break;
+    case SF_TRACK:
+      o.f("\"trk\":");
+      o.str(st.media.track.c_str());
+      break;
+    case SF_MEDIA_STATE:
+      o.f("\"mp\":%s,\"idle\":%s,\"media_status\":", st.media.isPlaying ? "true" : "false",
+          st.media.isIdle ? "true" : "false");
+      o.str(st.media.mediaStatus.c_str());
+      break;
+    case SF_ALERT:
+      if (!st.alertActive) {
+        o.f("\"alert\":\"OK\"");
+        break;
+      }
+      o.f("\"alert\":\"CRITICAL\"");
+      if (st.alertTargetScene >= 0 && st.alertTargetScene < (int)(sizeof(kSceneNames) / sizeof(kSceneNames[0])))
+        o.f(",\"target_screen\":\"%s\"", kSceneNames[st.alertTargetScene]);
+      if (st.alertMetric >= 0 && st.alertMetric < (int)(sizeof(kMetricNames) / sizeof(kMetricNames[0])))
+        o.f(",\"alert_metric\":\"%s\"", kMetricNames[st.alertMetric]);
+      break;
+    default:
+      return 0; /* battery: device-local */
+  }
+  return o.done();
+}
+
+size_t writeFullLine(const AppState &st, char *buf, size_t cap) {
+  Out o(buf, cap);
+  char frag[512];
+  o.f("{");
+  bool first = true;
+  for (int f = 0; f < SF_COUNT; f++) {
+    if (!writeField((StateField)f, st, frag, sizeof(frag)))
+      continue;
+    o.f("%s%s", first ? "" : ",", frag);
+    first = false;
+  }
+  o.f("}\n");
+  return o.done();
+}
+
+/* ── MonitorFeed ── */
+
+void MonitorFeed::reset() {
+  sub_.clear();
+  active_ = false;
+  fresh_ = false;
+  screen_ = -1;
+  started_ = false;
+  for (int i = 0; i < SF_COUNT; i++)
+    sent_[i].clear();
+}
+
+bool MonitorFeed::command(const char *line, size_t len) {
+  while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == '\n'))
+    len--;
+  if (len >= 4 && memcmp(line, "HELO", 4) == 0) {
+    reset();
+    return true;
+  }
+  if (len > 7 && memcmp(line, "screen:", 7) == 0) {
+    screen_ = atoi(std::string(line + 7, len - 7).c_str());
+    return true;
+  }
+  if (len >= 4 && memcmp(line, "sub:", 4) == 0) {
+    if (!subOn_ || !sub_.parse(line, len))
+      return false;
+    active_ = true;
+    fresh_ = true;
+    return true;
+  }
+  return false;
+}
+
+size_t MonitorFeed::poll(uint32_t nowMs, const AppState &pc, char *out, size_t cap) {
+  if (active_)
+    return partial(nowMs, pc, out, cap);
+  if (fullPeriodMs_ == 0 || (started_ && nowMs - lastLineMs_ < fullPeriodMs_))
+    return 0;
+  /* Fixed cadence; after a stall, start over from now instead of bursting to catch up. */
+  lastLineMs_ = started_ && nowMs - lastLineMs_ < 2 * fullPeriodMs_ ? lastLineMs_ + fullPeriodMs_ : nowMs;
+  started_ = true;
+  return writeFullLine(pc, out, cap);
+}
+
+size_t MonitorFeed::partial(uint32_t nowMs, const AppState &pc, char *buf, size_t cap) {
+  Out o(buf, cap);
+  char frag[512];
+  o.f("{\"sb\":%u", (unsigned)sub_.generation());
+  bool any = false;
+  for (int i = 0; i < SF_COUNT; i++) {
+    const StateField f = (StateField)i;
+    if (!sub_.has(f))
+      continue;
+    const uint32_t period = sub_.period(f);
+    if (!fresh_ && period != MonitorSubscription::kOnChange && (int32_t)(nowMs - due_[i]) < 0)
+      continue;
+    due_[i] = fresh_ || nowMs - due_[i] >= period ? nowMs + period : due_[i] + period;
+    if (!writeField(f, pc, frag, sizeof(frag)))
+      continue;
+    if (!fresh_ && sent_[i] == frag)
+      continue;
+    sent_[i] = frag;
+    o.f(",%s", frag);
+    any = true;
+  }
+  if (!any && !fresh_ && started_ && nowMs - lastLineMs_ < MonitorSubscription::kKeepaliveMs)
+    return 0;
+  o.f("}\n");
+  fresh_ = false;
+  started_ = true;
+  lastLineMs_ = nowMs;
+  return o.done();
+}
@@ -0,0 +1,79 @@
+/*
+ * NOCTURNE_OS — reference PC side of the monitor link (Linux): a synthetic PC (PcModel) and the line
+ * scheduler (MonitorFeed), full lines at a fixed rate or partial lines per the device's subscription.
+ */
+#ifndef NOCTURNE_MONITOR_FEED_H
+#define NOCTURNE_MONITOR_FEED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "MonitorSubscription.h"
+#include "nocturne/Types.h"
+
+/** Sensor values that move like a desktop under mixed load: loads jitter every sample, temperatures and
+ *  fans follow them slowly, processes, tracks and weather change every few minutes. */
+class PcModel {
+ public:
+  static const uint32_t kSampleMs = 100; /* sensor poll: 10 Hz */
+
+  explicit PcModel(uint32_t seed = 1);
+  /** Advance to nowMs (whole samples). */
+  void advance(uint32_t nowMs);
+  const AppState &state() const { return st_; }
+
+ private:
+  void sample();
+  uint32_t rnd(uint32_t n);
+  float noise(float amp);
+
+  AppState st_;
+  uint32_t rng_;
+  uint32_t t_ = 0;
+  uint32_t samples_ = 0;
+  float cpuLoad_ = 15, gpuLoad_ = 30, cpuTemp_ = 50, gpuTemp_ = 55, ramUsed_ = 11.4f;
+  int track_ = 0, weather_ = 0, procs_ = 0;
+};
+
+/** JSON for one field group (key and value, no separators), as the firmware decoder reads it. */
+size_t writeField(StateField f, const AppState &st, char *out, size_t cap);
+/** A whole line as the Python server sends it: every key, then '\n'. */
+size_t writeFullLine(const AppState &st, char *out, size_t cap);
+
+class MonitorFeed {
+ public:
+  static const size_t kLineMax = 2048;
+
+  /** Full lines every periodMs while no subscription is active (0 = never). */
+  void setFullPeriod(uint32_t periodMs) { fullPeriodMs_ = periodMs; }
+  /** Ignore "sub:" like a server that predates it. */
+  void setSubscriptions(bool on) { subOn_ = on; }
+
+  /** A command line from the device (without the newline): HELO, screen:N, sub:... False if unknown. */
+  bool command(const char *line, size_t len);
+  /** New connection: no subscription, full lines. */
+  void reset();
+
+  /** The line due at nowMs for this PC state (with '\n') into out; 0 if nothing is due. */
+  size_t poll(uint32_t nowMs, const AppState &pc, char *out, size_t cap);
+
+  bool subscribed() const { return active_; }
+  int screen() const { return screen_; }
+  const MonitorSubscription &subscription() const { return sub_; }
+
+ private:
+  size_t partial(uint32_t nowMs, const AppState &pc, char *out, size_t cap);
+
+  MonitorSubscription sub_;
+  bool subOn_ = true;
+  bool active_ = false;
+  bool fresh_ = false;
+  int screen_ = -1;
+  uint32_t fullPeriodMs_ = 500;
+  bool started_ = false;
+  uint32_t lastLineMs_ = 0;
+  uint32_t due_[SF_COUNT] = {};
+  std::string sent_[SF_COUNT]; /* last fragment sent per field */
+};
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * NOCTURNE_OS — the device's side of the link on the host, for monitor_server --serial without a board:
+ * the firmware's MonitorLink in a network thread (NOCT_NET_TASK=1) and a render loop every 5 ms taking its
+ * snapshots, printing the same link markers (LinkMarks) on stdout that NOCT_LINK_MARKS prints on Serial.
+ *
+ *   ./device_sim --port 8090 | ./monitor_server --serial - --no-sub --hz 200
+ *
+ * Parse time and acknowledgment latency are the host's. A frame here is the loop taking a changed
+ * snapshot on a redraw tick (NOCT_REDRAW_INTERVAL_MS) and copying AppState, as NetManager::receive() does;
+ * U8g2 drawing and the I2C transfer exist only on the device, so @frm times are not panel times.
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+#include "LinkMarks.h"
+#include "MonitorLink.h"
+#include "nocturne/config.h"
+
+static const uint32_t kLoopMs = 5;
+
+static uint32_t nowMs() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t nowUs() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv) {
+  const char *ip = "127.0.0.1";
+  int port = 8090, scene = NOCT_SCENE_MAIN;
+  double seconds = 0;
+  for (int i = 1; i < argc; i++) {
+    const bool more = i + 1 < argc;
+    if (!strcmp(argv[i], "--ip") && more)
+      ip = argv[++i];
+    else if (!strcmp(argv[i], "--port") && more)
+      port = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--scene") && more)
+      scene = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--seconds") && more)
+      seconds = atof(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--ip 127.0.0.1] [--port 8090] [--scene 0] [--seconds 0 = forever]\n", argv[0]);
+      return 2;
+    }
+  }
+  static MonitorLink link;
+  if (port <= 0 || port > 65535 || scene < 0 || scene >= NOCT_TOTAL_SCENES || !link.setServer(ip, (uint16_t)port)) {
+    fprintf(stderr, "device_sim: bad server %s:%d or scene %d\n", ip, port, scene);
+    return 2;
+  }
+  link.setActive(true);
+  link.setScreen(scene, (scene + 1) % NOCT_TOTAL_SCENES);
+
+  std::atomic<bool> stop{false};
+  std::thread net([&] {
+    while (!stop.load(std::memory_order_relaxed)) {
+      link.service(nowMs(), true, -40);
+      if (!link.wait(NOCT_NET_WAIT_MS))
+        usleep(NOCT_NET_WAIT_MS * 1000);
+    }
+  });
+
+  static AppState state;
+  LinkMarks marks;
+  char out[LinkMarks::kLineMax];
+  const uint32_t start = nowMs();
+  uint32_t lastFrame = start;
+  bool changed = false, tcp = false;
+  while (seconds <= 0 || nowMs() - start < (uint32_t)(seconds * 1000)) {
+    const uint32_t now = nowMs();
+    if (link.take()) {
+      const MonitorSnapshot &s = link.snapshot();
+      if (s.tcp != tcp)
+        fprintf(stderr, "device_sim: %s\n", s.tcp ? "connected" : "link down");
+      tcp = s.tcp;
+      changed |= s.changed != 0;
+      if (marks.ack(s, out, sizeof(out))) {
+        fputs(out, stdout);
+        fflush(stdout);
+      }
+    }
+    if (now - lastFrame >= NOCT_REDRAW_INTERVAL_MS && changed) {
+      const uint32_t t0 = nowUs();
+      state = link.snapshot().state;
+      if (marks.frame(nowUs() - t0, out, sizeof(out))) {
+        fputs(out, stdout);
+        fflush(stdout);
+      }
+      lastFrame = now;
+      changed = false;
+    }
+    usleep(kLoopMs * 1000);
+  }
+  stop = true;
+  net.join();
+  const MonitorSnapshot &s = link.snapshot();
+  fprintf(stderr, "device_sim: %u lines parsed, %u rejected, %.2f us/line\n", (unsigned)s.parsed,
+          (unsigned)s.rejected, s.parsed ? (double)s.parseUs / s.parsed : 0.0);
+  return 0;
+}
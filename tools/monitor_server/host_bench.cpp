@@ -0,0 +1,374 @@
+/*
+ * NOCTURNE_OS — multi-host benchmark: memory per host and what the render loop and the network task cost
+ * as the monitored PCs (PC_HOSTS, MonitorHosts) go from 1 to 8.
+ *
+ * A server thread simulates N PCs on loopback ports (MonitorFeed over PcModel, one seed each, full lines at
+ * 2 Hz until the device subscribes). A network thread runs N MonitorLinks as NetManager's task does: each
+ * one serviced, then one select over all of them. The loop runs every 5 ms and does what main.cpp and
+ * NetManager::receive() do: take each host's snapshot into MonitorHosts, copy the selected host into
+ * AppState and push the graphs, send the screens (the selected host the scene, the others the overview),
+ * and, on the overview scene, what drawHosts() computes. The carousel is fast (a scene every 500 ms) so
+ * host switches and the overview come up within a run. U8g2 drawing is not included: per frame it is the
+ * same for any number of hosts (the overview draws at most three host rows).
+ */
+#include <arpa/inet.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "MonitorFeed.h"
+#include "MonitorHosts.h"
+#include "MonitorLink.h"
+#include "RollingGraph.h"
+
+static const uint32_t kLoopMs = 5;
+static const uint32_t kSceneMs = 500;
+
+static uint32_t nowMs() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t nowNs() {
+  using namespace std::chrono;
+  return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void nonBlocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK); }
+
+/* ── Server: N simulated PCs, one device session each ── */
+
+class HostsServer {
+ public:
+  explicit HostsServer(int n) {
+    for (int i = 0; i < n; i++) {
+      hosts_.emplace_back(new Host((uint32_t)(11 + i)));
+      listen(*hosts_.back());
+    }
+    thread_ = std::thread([this] { run(); });
+  }
+  ~HostsServer() {
+    stop_.store(true);
+    thread_.join();
+    for (auto &h : hosts_) {
+      if (h->cfd >= 0)
+        close(h->cfd);
+      close(h->lfd);
+      delete h;
+    }
+  }
+  uint16_t port(int i) const { return hosts_[(size_t)i]->port; }
+  uint64_t bytes() const { return bytes_.load(); }
+
+ private:
+  struct Host {
+    explicit Host(uint32_t seed) : pc(seed) {}
+    PcModel pc;
+    MonitorFeed feed;
+    std::string rx;
+    uint16_t port = 0;
+    int lfd = -1, cfd = -1;
+  };
+
+  static void listen(Host &h) {
+    h.lfd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(h.lfd, (sockaddr *)&sa, sizeof(sa)) != 0 || ::listen(h.lfd, 2) != 0) {
+      perror("bench server");
+      exit(1);
+    }
+    socklen_t len = sizeof(sa);
+    getsockname(h.lfd, (sockaddr *)&sa, &len);
+    h.port = ntohs(sa.sin_port);
+    nonBlocking(h.lfd);
+    h.feed.setFullPeriod(500);
+  }
+
+  void run() {
+    static char line[MonitorFeed::kLineMax];
+    const uint32_t t0 = nowMs();
+    std::vector<pollfd> fds;
+    while (!stop_.load()) {
+      fds.clear();
+      for (Host *h : hosts_)
+        fds.push_back({h->cfd >= 0 ? h->cfd : h->lfd, POLLIN, 0});
+      poll(fds.data(), fds.size(), 2);
+      const uint32_t t = nowMs() - t0;
+      for (Host *h : hosts_) {
+        if (h->cfd < 0) {
+          if ((h->cfd = accept(h->lfd, nullptr, nullptr)) >= 0) {
+            nonBlocking(h->cfd);
+            int one = 1;
+            setsockopt(h->cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            h->feed.reset();
+            h->rx.clear();
+          }
+          continue;
+        }
+        char buf[512];
+        const ssize_t n = recv(h->cfd, buf, sizeof(buf), 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN)) {
+          close(h->cfd);
+          h->cfd = -1;
+          continue;
+        }
+        if (n > 0)
+          h->rx.append(buf, (size_t)n);
+        size_t nl;
+        while ((nl = h->rx.find('\n')) != std::string::npos) {
+          h->feed.command(h->rx.data(), nl);
+          h->rx.erase(0, nl + 1);
+        }
+        h->pc.advance(t);
+        const size_t len = h->feed.poll(t, h->pc.state(), line, sizeof(line));
+        if (!len)
+          continue;
+        if (send(h->cfd, line, len, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)len) {
+          close(h->cfd);
+          h->cfd = -1;
+          continue;
+        }
+        bytes_ += len;
+      }
+    }
+  }
+
+  std::vector<Host *> hosts_;
+  std::atomic<uint64_t> bytes_{0};
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+/* ── One run: N hosts for the given time ── */
+
+struct Result {
+  int hosts;
+  double loopP50, loopP99, loopMax; /* µs of loop work per iteration */
+  double overviewUs;                /* per frame on the overview scene */
+  double netCpu;                    /* network thread, share of one core */
+  double updates;                   /* snapshots with new data taken per second, all hosts */
+  double bytes;                     /* server to device, per second */
+  int switches;
+  int lost; /* host-seconds with the signal lost (should stay 0) */
+};
+
+static double pct(std::vector<uint32_t> &v, double p) {
+  if (v.empty())
+    return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+static Result runHosts(int n, uint32_t seconds) {
+  HostsServer server(n);
+  static MonitorLink links[NOCT_MAX_HOSTS];
+  MonitorHosts hosts;
+  for (int i = 0; i < n; i++) {
+    char name[kHostNameMax];
+    snprintf(name, sizeof(name), "pc%u", (unsigned)(uint8_t)(i + 1));
+    links[i].setServer("127.0.0.1", server.port(i));
+    links[i].setActive(true);
+    hosts.add(name);
+  }
+
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> netBusyNs{0};
+  std::thread net([&] {
+    while (!stop.load()) {
+      const uint64_t t = nowNs();
+      for (int i = 0; i < n; i++)
+        links[i].service(nowMs(), true, -50);
+      netBusyNs += nowNs() - t;
+      if (!MonitorLink::waitAny(links, n, NOCT_NET_WAIT_MS))
+        std::this_thread::sleep_for(std::chrono::milliseconds(NOCT_NET_WAIT_MS));
+    }
+  });
+
+  AppState state;
+  RollingGraph cpuGraph, gpuGraph, downGraph, upGraph;
+  downGraph.setMax(2048);
+  upGraph.setMax(2048);
+  std::vector<uint32_t> loopNs;
+  uint64_t overviewNs = 0, overviewFrames = 0, updates = 0;
+  int scene = 0, switches = 0, lost = 0;
+  bool reload = false;
+  const int scenes = n > 1 ? NOCT_TOTAL_SCENES + 1 : NOCT_TOTAL_SCENES;
+
+  const uint32_t start = nowMs();
+  const uint64_t bytes0 = server.bytes();
+  uint32_t nextScene = start + kSceneMs, nextLostCheck = start + 1000;
+  uint32_t next = start + kLoopMs;
+  while (nowMs() - start < seconds * 1000) {
+    const uint32_t now = nowMs();
+    const uint64_t t = nowNs();
+
+    /* Carousel: past the last scene, the next host. */
+    if ((int32_t)(now - nextScene) >= 0) {
+      scene = (scene + 1) % scenes;
+      if (scene == 0 && n > 1 && hosts.select(hosts.next())) {
+        reload = true;
+        switches++;
+      }
+      nextScene += kSceneMs;
+    }
+    for (int i = 0; i < n; i++) {
+      if (i == hosts.selected())
+        links[i].setScreen(scene, (scene + 1) % scenes);
+      else
+        links[i].setScreen(NOCT_SCENE_HOSTS, NOCT_SCENE_HOSTS);
+    }
+
+    /* NetManager::receive() */
+    const int sel = hosts.selected();
+    bool fresh = false;
+    for (int i = 0; i < n; i++) {
+      if (!links[i].take())
+        continue;
+      const bool data = hosts.update(i, links[i].snapshot());
+      updates += data;
+      if (i == sel)
+        fresh = data;
+    }
+    if (reload)
+      fresh = true;
+    if (fresh) {
+      const AppState &src = links[sel].snapshot().state;
+      state.hw = src.hw;
+      state.weather = src.weather;
+      state.media = src.media;
+      state.process = src.process;
+      state.weatherReceived = src.weatherReceived;
+      state.alertActive = src.alertActive;
+      state.alertTargetScene = src.alertTargetScene;
+      state.alertMetric = src.alertMetric;
+      if (reload) {
+        /* main.cpp loadHostGraphs() */
+        const HostSlot &h = hosts.host(sel);
+        cpuGraph.clear();
+        gpuGraph.clear();
+        downGraph.clear();
+        upGraph.clear();
+        for (int age = h.count - 1; age >= 0; age--) {
+          cpuGraph.push((float)h.cpuAt(age));
+          gpuGraph.push((float)h.gpuAt(age));
+          downGraph.push((float)h.netDownAt(age));
+          upGraph.push((float)h.netUpAt(age));
+        }
+        reload = false;
+      } else {
+        cpuGraph.push((float)state.hw.cl);
+        gpuGraph.push((float)state.hw.gl);
+        downGraph.push((float)state.hw.nd);
+        upGraph.push((float)state.hw.nu);
+      }
+    }
+    hosts.takeChanged();
+
+    /* drawHosts() without the pixels: the overview and the text of the visible rows. */
+    if (scene == NOCT_SCENE_HOSTS) {
+      const uint64_t o0 = nowNs();
+      const HostOverview o = hosts.overview(now);
+      char buf[24];
+      volatile size_t sink = 0;
+      if (o.live > 0) {
+        sink += (size_t)snprintf(buf, sizeof(buf), "CPU %d %.4s", o.cpuTemp, hosts.host(o.cpuTempHost).name);
+        sink += (size_t)snprintf(buf, sizeof(buf), "GPU %d %.4s", o.gpuTemp, hosts.host(o.gpuTempHost).name);
+        sink += (size_t)snprintf(buf, sizeof(buf), "CL %d%% %.4s", o.cpuLoad, hosts.host(o.cpuLoadHost).name);
+        sink += (size_t)snprintf(buf, sizeof(buf), "GL %d%% %.4s", o.gpuLoad, hosts.host(o.gpuLoadHost).name);
+      }
+      const int first = (int)((now / NOCT_HOSTS_PAGE_MS) % (uint32_t)((n + 2) / 3)) * 3;
+      for (int i = first; i < first + 3 && i < n; i++) {
+        const HostSlot &h = hosts.host(i);
+        if (h.signalLost(now))
+          continue;
+        sink += (size_t)snprintf(buf, sizeof(buf), "%d%% %d%% %d/%d", h.cl, h.gl, h.ct, h.gt);
+      }
+      (void)sink;
+      overviewNs += nowNs() - o0;
+      overviewFrames++;
+    }
+    loopNs.push_back((uint32_t)(nowNs() - t));
+
+    if ((int32_t)(now - nextLostCheck) >= 0) {
+      if (now - start > NOCT_SIGNAL_GRACE_MS / 2)
+        for (int i = 0; i < n; i++)
+          lost += hosts.host(i).signalLost(now);
+      nextLostCheck += 1000;
+    }
+    const int32_t wait = (int32_t)(next - nowMs());
+    if (wait > 0)
+      usleep((useconds_t)wait * 1000);
+    next += kLoopMs;
+  }
+  const double secs = (nowMs() - start) / 1000.0;
+  stop.store(true);
+  net.join();
+  for (int i = 0; i < n; i++) {
+    links[i].setActive(false);
+    links[i].close();
+  }
+
+  Result r;
+  r.hosts = n;
+  r.loopP50 = pct(loopNs, 0.50) / 1000;
+  r.loopP99 = pct(loopNs, 0.99) / 1000;
+  r.loopMax = loopNs.empty() ? 0 : loopNs.back() / 1000.0;
+  r.overviewUs = overviewFrames ? (double)overviewNs / overviewFrames / 1000 : 0;
+  r.netCpu = netBusyNs.load() / (secs * 1e9);
+  r.updates = updates / secs;
+  r.bytes = (server.bytes() - bytes0) / secs;
+  r.switches = switches;
+  r.lost = lost;
+  return r;
+}
+
+int main(int argc, char **argv) {
+  uint32_t seconds = 12;
+  int maxHosts = 8;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = (uint32_t)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--hosts") && i + 1 < argc) {
+      maxHosts = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--seconds 12] [--hosts 8]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (maxHosts < 1 || maxHosts > NOCT_MAX_HOSTS || seconds == 0) {
+    fprintf(stderr, "--hosts 1..%d (NOCT_MAX_HOSTS), --seconds > 0\n", NOCT_MAX_HOSTS);
+    return 2;
+  }
+
+  const size_t perHost = sizeof(MonitorLink) + sizeof(HostSlot);
+  printf("memory per host: MonitorLink %zu B (framer %zu, UDP %zu, decoders %zu, snapshots 3 x %zu, work %zu)\n",
+         sizeof(MonitorLink), sizeof(LineFramer), sizeof(MonitorUdp),
+         sizeof(MonitorDecoder) + sizeof(MonitorBinaryDecoder), sizeof(MonitorSnapshot), sizeof(AppState));
+  printf("                 + HostSlot %zu B = %zu B, static (NetManager with NOCT_MAX_HOSTS = hosts)\n\n",
+         sizeof(HostSlot), perHost);
+  printf("%-5s %9s %9s %9s %9s %11s %8s %9s %8s %6s %9s\n", "hosts", "static B", "loop p50", "loop p99",
+         "loop max", "overview", "net CPU", "updates", "B/s", "swaps", "lost h*s");
+  for (int n = 1; n <= maxHosts; n++) {
+    const Result r = runHosts(n, seconds);
+    printf("%-5d %9zu %7.2fus %7.2fus %7.0fus %9.2fus %7.2f%% %7.1f/s %8.0f %6d %9d\n", r.hosts,
+           n * perHost, r.loopP50, r.loopP99, r.loopMax, r.overviewUs,
+           r.netCpu * 100, r.updates, r.bytes, r.switches, r.lost);
+    fflush(stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,358 @@
+/*
+ * NOCTURNE_OS — network task benchmark: how long the render loop stalls on the monitor link with the
+ * server healthy, down and flapping, for the old blocking connect in loop(), the non-blocking link
+ * (MonitorLink) run inline in loop() (NOCT_NET_TASK=0) and the link in its own thread handing snapshots
+ * over (NOCT_NET_TASK=1).
+ *
+ * A server thread (MonitorFeed over PcModel, full lines at 10 Hz for every link) listens on loopback.
+ * "Down" is a PC that is off: the port drops SYNs (listen backlog 0 with one connection never accepted),
+ * so a connect hangs until its timeout. "Flapping" is up 3 s, down 3 s. The loop runs every 5 ms, changes
+ * scene every 2 s and does what main.cpp does with the link; the gaps between loop iterations are the
+ * stall distribution (5 ms is no stall).
+ */
+#include <arpa/inet.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "LineFramer.h"
+#include "MonitorDecoder.h"
+#include "MonitorFeed.h"
+#include "MonitorLink.h"
+
+static const uint32_t kLoopMs = 5;
+static const uint32_t kSceneMs = 2000;
+static const uint32_t kFlapMs = 3000;
+
+static uint32_t nowMs() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t nowUs() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void nonBlocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK); }
+
+/* ── Server: up (accepting, streaming) or down (SYNs dropped) on one loopback port ── */
+
+enum Scenario { HEALTHY, DOWN, FLAPPING };
+
+class BenchServer {
+ public:
+  explicit BenchServer(Scenario sc) : sc_(sc) {
+    listen(!wantUp(0));
+    thread_ = std::thread([this] { run(); });
+  }
+  ~BenchServer() {
+    stop_.store(true);
+    thread_.join();
+    closeAll();
+  }
+  uint16_t port() const { return port_; }
+
+ private:
+  bool wantUp(uint32_t t) const { return sc_ == HEALTHY || (sc_ == FLAPPING && (t / kFlapMs) % 2 == 0); }
+
+  void listen(bool blackhole) {
+    lfd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(lfd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa.sin_port = htons(port_);
+    if (bind(lfd_, (sockaddr *)&sa, sizeof(sa)) != 0 || ::listen(lfd_, blackhole ? 0 : 2) != 0) {
+      perror("bench server");
+      exit(1);
+    }
+    socklen_t len = sizeof(sa);
+    getsockname(lfd_, (sockaddr *)&sa, &len);
+    port_ = ntohs(sa.sin_port);
+    nonBlocking(lfd_);
+    if (blackhole) {
+      filler_ = socket(AF_INET, SOCK_STREAM, 0);
+      connect(filler_, (sockaddr *)&sa, sizeof(sa));
+    }
+    up_ = !blackhole;
+  }
+
+  void closeAll() {
+    for (int *fd : {&cfd_, &filler_, &lfd_})
+      if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+      }
+  }
+
+  void run() {
+    PcModel pc(3);
+    MonitorFeed feed;
+    feed.setFullPeriod(100);
+    feed.setSubscriptions(false); /* the same lines for every link */
+    static char line[MonitorFeed::kLineMax];
+    std::string rx;
+    const uint32_t t0 = nowMs();
+    while (!stop_.load()) {
+      const uint32_t t = nowMs() - t0;
+      if (wantUp(t) != up_) {
+        closeAll();
+        listen(up_);
+      }
+      if (up_ && cfd_ < 0 && (cfd_ = accept(lfd_, nullptr, nullptr)) >= 0) {
+        nonBlocking(cfd_);
+        int one = 1;
+        setsockopt(cfd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        feed.reset();
+        rx.clear();
+      }
+      if (cfd_ >= 0) {
+        char buf[512];
+        const ssize_t n = recv(cfd_, buf, sizeof(buf), 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN)) {
+          close(cfd_);
+          cfd_ = -1;
+          continue;
+        }
+        if (n > 0)
+          rx.append(buf, (size_t)n);
+        size_t nl;
+        while ((nl = rx.find('\n')) != std::string::npos) {
+          feed.command(rx.data(), nl);
+          rx.erase(0, nl + 1);
+        }
+        pc.advance(t);
+        const size_t len = feed.poll(t, pc.state(), line, sizeof(line));
+        if (len && send(cfd_, line, len, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)len) {
+          close(cfd_);
+          cfd_ = -1;
+        }
+      }
+      usleep(1000);
+    }
+  }
+
+  Scenario sc_;
+  uint16_t port_ = 0;
+  int lfd_ = -1, filler_ = -1, cfd_ = -1;
+  bool up_ = false;
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+/* ── The link as NetManager::tick() / receive() ran it before: WiFiClient::connect() blocks ── */
+
+class LegacyLink {
+ public:
+  explicit LegacyLink(uint16_t port) : port_(port) {}
+  ~LegacyLink() { drop(); }
+
+  void tick(uint32_t now) {
+    if (fd_ >= 0 || now - lastAttempt_ < NOCT_TCP_RECONNECT_INTERVAL_MS)
+      return;
+    lastAttempt_ = now;
+    /* What WiFiClient::connect(ip, port) does with setTimeout(): connect, wait for it (select). */
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    nonBlocking(fd_);
+    sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa.sin_port = htons(port_);
+    int err = connect(fd_, (sockaddr *)&sa, sizeof(sa)) == 0 ? 0 : errno;
+    if (err == EINPROGRESS) {
+      fd_set wr;
+      FD_ZERO(&wr);
+      FD_SET(fd_, &wr);
+      timeval tv = {NOCT_TCP_CONNECT_TIMEOUT_MS / 1000, 0};
+      socklen_t len = sizeof(err);
+      err = select(fd_ + 1, nullptr, &wr, nullptr, &tv) == 1 &&
+                    getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len) == 0
+                ? err
+                : ETIMEDOUT;
+    }
+    if (err != 0) {
+      drop();
+      return;
+    }
+    framer_.reset();
+    sent_ = -1;
+    send(fd_, "HELO\n", 5, MSG_NOSIGNAL);
+  }
+
+  bool receive(AppState *st) {
+    if (fd_ < 0)
+      return false;
+    char *line;
+    size_t len;
+    bool updated = false;
+    if (framer_.pump(readFd, this, nowUs, NOCT_TCP_RX_BUDGET_US) && framer_.takeLine(&line, &len))
+      updated = dec_.decode(line, len, st);
+    return updated;
+  }
+
+  void sendScreen(int scene) {
+    if (fd_ < 0 || sent_ == scene)
+      return;
+    char msg[16];
+    send(fd_, msg, (size_t)snprintf(msg, sizeof(msg), "screen:%d\n", scene), MSG_NOSIGNAL);
+    sent_ = scene;
+  }
+
+ private:
+  static size_t readFd(void *ctx, char *dst, size_t cap) {
+    LegacyLink *l = (LegacyLink *)ctx;
+    const ssize_t n = recv(l->fd_, dst, cap, MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN))
+      l->drop();
+    return n > 0 ? (size_t)n : 0;
+  }
+  void drop() {
+    if (fd_ >= 0)
+      close(fd_);
+    fd_ = -1;
+  }
+
+  uint16_t port_;
+  int fd_ = -1;
+  uint32_t lastAttempt_ = 0;
+  int sent_ = -1;
+  LineFramer framer_;
+  MonitorDecoder dec_;
+};
+
+/* ── Loop ── */
+
+enum Mode { BLOCKING, INLINE, TASK };
+
+struct Stats {
+  std::vector<double> gapsMs;
+  uint32_t updates = 0;
+  double seconds = 0;
+};
+
+static double pct(const std::vector<double> &v, double p) {
+  return v.empty() ? 0 : v[std::min(v.size() - 1, (size_t)(p / 100.0 * (double)v.size()))];
+}
+
+/** What NetManager::receive() copies out of a snapshot. */
+static void copyMonitor(const AppState &from, AppState *to) {
+  to->hw = from.hw;
+  to->weather = from.weather;
+  to->media = from.media;
+  to->process = from.process;
+  to->alertActive = from.alertActive;
+}
+
+static Stats runLoop(Mode mode, Scenario sc, uint32_t seconds) {
+  BenchServer server(sc);
+  LegacyLink legacy(server.port());
+  MonitorLink link;
+  link.setServer("127.0.0.1", server.port());
+  link.setActive(true);
+  std::atomic<bool> stop{false};
+  std::thread task;
+  if (mode == TASK)
+    task = std::thread([&] {
+      while (!stop.load()) {
+        link.service(nowMs(), true, -55);
+        if (!link.wait(NOCT_NET_WAIT_MS))
+          usleep(NOCT_NET_WAIT_MS * 1000);
+      }
+    });
+
+  Stats s;
+  AppState st;
+  uint32_t seen = 0;
+  const auto start = std::chrono::steady_clock::now();
+  auto next = start + std::chrono::milliseconds(kLoopMs), prev = start;
+  const auto end = start + std::chrono::seconds(seconds);
+  while (next < end) {
+    std::this_thread::sleep_until(next);
+    const auto t = std::chrono::steady_clock::now();
+    if (t != prev)
+      s.gapsMs.push_back(std::chrono::duration<double, std::milli>(t - prev).count());
+    prev = t;
+    const uint32_t now = nowMs();
+    const int scene = (int)(std::chrono::duration_cast<std::chrono::milliseconds>(t - start).count() / kSceneMs) %
+                      NOCT_TOTAL_SCENES;
+    switch (mode) {
+      case BLOCKING:
+        legacy.tick(now);
+        if (legacy.receive(&st))
+          s.updates++;
+        legacy.sendScreen(scene);
+        break;
+      case INLINE:
+        link.service(now, true, -55);
+        /* fall through */
+      case TASK:
+        link.setScreen(scene, (scene + 1) % NOCT_TOTAL_SCENES);
+        if (link.take() && link.snapshot().updates != seen) {
+          s.updates += link.snapshot().updates - seen;
+          seen = link.snapshot().updates;
+          copyMonitor(link.snapshot().state, &st);
+        }
+        break;
+    }
+    /* Iterations missed while stalled are not made up: the next one starts kLoopMs after this. */
+    next = std::max(next + std::chrono::milliseconds(kLoopMs), std::chrono::steady_clock::now());
+  }
+  s.gapsMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - prev).count());
+  stop.store(true);
+  if (task.joinable())
+    task.join();
+  s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::sort(s.gapsMs.begin(), s.gapsMs.end());
+  return s;
+}
+
+int main(int argc, char **argv) {
+  uint32_t seconds = 12;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = (uint32_t)atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--seconds 12]\n", argv[0]);
+      return 2;
+    }
+  }
+  static const char *const kScenarios[] = {"healthy", "down", "flapping"};
+  static const char *const kModes[] = {"blocking", "inline", "task"};
+  printf("Loop every %u ms, %u s per run, full lines at 10 Hz, connect timeout %u ms, retry %u ms.\n",
+         kLoopMs, seconds, NOCT_TCP_CONNECT_TIMEOUT_MS, NOCT_TCP_RECONNECT_INTERVAL_MS);
+  printf("Loop gap (ms; %u = no stall):\n", kLoopMs);
+  printf("  %-9s %-9s %7s %7s %7s %8s %8s %7s %10s\n", "server", "link", "p50", "p99", "p99.9", "max", "stalled",
+         ">50ms", "updates/s");
+  for (int sc = 0; sc < 3; sc++) {
+    for (int m = 0; m < 3; m++) {
+      const Stats s = runLoop((Mode)m, (Scenario)sc, seconds);
+      double stalled = 0;
+      size_t over50 = 0;
+      for (double g : s.gapsMs) {
+        stalled += g > kLoopMs ? g - kLoopMs : 0;
+        over50 += g > 50;
+      }
+      printf("  %-9s %-9s %7.2f %7.2f %7.2f %8.1f %7.1f%% %7zu %10.1f\n", m == 0 ? kScenarios[sc] : "", kModes[m],
+             pct(s.gapsMs, 50), pct(s.gapsMs, 99), pct(s.gapsMs, 99.9), s.gapsMs.empty() ? 0 : s.gapsMs.back(),
+             100.0 * stalled / (s.seconds * 1000), over50, s.updates / s.seconds);
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,397 @@
+/*
+ * NOCTURNE_OS — reference monitor server (Linux): speaks the PC side of the monitor link to the firmware
+ * (or any client) on a TCP port, with a synthetic PC (PcModel) behind it.
+ *
+ * The device's "HELO" starts a session; full JSON lines follow at --hz (the Python server's behaviour,
+ * binary and UDP are declined) until a "sub:" command arrives, then partial lines per the subscription
+ * (MonitorSubscription). --no-sub ignores "sub:" like a server that predates it. Every 10 s: bytes/s,
+ * lines/s and the current screen / subscription on stderr.
+ *
+ * --hosts N simulates N PCs for the firmware's PC_HOSTS: ports --port .. --port + N - 1, each its own
+ * synthetic PC (seed + i) and its own session, all in one poll loop.
+ *
+ * Load generator (LoadGen.h): --burst sends each due line several times back to back, --size pads lines,
+ * --replay sends recorded lines instead of the synthetic PC (--record writes them), --bad replaces that
+ * share of lines with malformed ones and --drop-every closes the session periodically. --serial reads the
+ * device's link markers (NOCT_LINK_MARKS) from its serial port, or "-" from stdin; every line then carries
+ * "ln":<n> and every 10 s the parse time per line and the acknowledgment and frame latency go to stderr.
+ */
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+#include "LoadGen.h"
+#include "MonitorFeed.h"
+#include "nocturne/config.h"
+
+static uint64_t nowUs() {
+  using namespace std::chrono;
+  return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t nowMs() { return (uint32_t)(nowUs() / 1000); }
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--port 8090] [--hz 2] [--no-sub] [--seed N] [--hosts 1] [--quiet]\n"
+          "          [--burst 1] [--size B] [--replay FILE] [--record FILE] [--bad PCT] [--drop-every S]\n"
+          "          [--serial DEV|-]\n",
+          argv0);
+}
+
+/** Serial port raw at 115200 (USB CDC ignores the rate), or stdin for "-"; non-blocking. */
+static int openSerial(const char *path) {
+  if (!strcmp(path, "-")) {
+    fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_NONBLOCK);
+    return 0;
+  }
+  const int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0)
+    return -1;
+  termios t;
+  if (tcgetattr(fd, &t) == 0) {
+    cfmakeraw(&t);
+    cfsetispeed(&t, B115200);
+    cfsetospeed(&t, B115200);
+    tcsetattr(fd, TCSANOW, &t);
+  }
+  return fd;
+}
+
+static int listenTcp(uint16_t port) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (sockaddr *)&sa, sizeof(sa)) != 0 || listen(fd, 2) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/** Whole line or nothing: a device that stops reading is dropped rather than sent half a line. */
+static bool sendLine(int fd, const char *s, size_t n) {
+  size_t off = 0;
+  const uint32_t start = nowMs();
+  while (off < n) {
+    const ssize_t w = send(fd, s + off, n - off, MSG_NOSIGNAL);
+    if (w > 0)
+      off += (size_t)w;
+    else if (w < 0 && errno != EAGAIN && errno != EINTR)
+      return false;
+    else if (nowMs() - start > 2000)
+      return false;
+    else
+      usleep(1000);
+  }
+  return true;
+}
+
+/** What goes out on top of the lines themselves. */
+struct Load {
+  int burst = 1;
+  size_t size = 0;
+  int badPercent = 0;
+  uint32_t dropEveryMs = 0;
+  bool stamp = false; /* "ln" on every line (--serial, --size) */
+  Replay *replay = nullptr;
+  FILE *record = nullptr;
+  MarkStats *marks = nullptr;
+};
+
+/** One simulated PC: its port, its device session and what it sends. */
+struct Host {
+  explicit Host(uint32_t seed) : pc(seed) {}
+  uint16_t port = 0;
+  int lfd = -1;
+  int cfd = -1;
+  PcModel pc;
+  MonitorFeed feed;
+  Replay replay;
+  std::string rx;
+  uint32_t connectedMs = 0;
+  uint32_t replayDueMs = 0;
+  uint64_t bytes = 0, lines = 0, bad = 0;
+};
+
+static void dropClient(Host &h) {
+  close(h.cfd);
+  h.cfd = -1;
+  fprintf(stderr, ":%u client gone\n", h.port);
+}
+
+/** The due line, burst times: each stamped with the next line number or, at --bad, malformed instead. */
+static bool sendBurst(Host &h, const char *line, size_t n, const Load &load) {
+  static uint32_t nextLn = 0;
+  static uint32_t rng = 12345;
+  static uint32_t badKind = 0;
+  std::string out;
+  for (int i = 0; i < load.burst; i++) {
+    rng = rng * 1664525u + 1013904223u;
+    const bool bad = load.badPercent > 0 && (int)((rng >> 8) % 100) < load.badPercent;
+    const uint32_t ln = nextLn;
+    if (bad)
+      out = malformedLine(line, n, (Malformed)(badKind++ % MF_COUNT), rng);
+    else if (!load.stamp || !stampLine(line, n, nextLn++, load.size, &out))
+      out.assign(line, n);
+    if (!sendLine(h.cfd, out.data(), out.size()))
+      return false;
+    h.bytes += out.size();
+    h.lines++;
+    if (bad) {
+      h.bad++;
+      if (load.marks)
+        load.marks->malformed();
+    } else if (load.stamp && load.marks && ln != nextLn) {
+      load.marks->sent(ln, nowUs(), out.size());
+    }
+  }
+  return true;
+}
+
+/** Commands from the device; false once it is gone. */
+static bool readCommands(Host &h, bool quiet) {
+  char buf[512];
+  const ssize_t n = recv(h.cfd, buf, sizeof(buf), 0);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+    return false;
+  if (n > 0)
+    h.rx.append(buf, (size_t)n);
+  size_t nl;
+  while ((nl = h.rx.find('\n')) != std::string::npos) {
+    const std::string cmd = h.rx.substr(0, nl);
+    h.rx.erase(0, nl + 1);
+    const bool ok = h.feed.command(cmd.data(), cmd.size());
+    if (!quiet)
+      fprintf(stderr, ":%u < %s%s\n", h.port, cmd.c_str(), ok ? "" : "  (ignored)");
+  }
+  if (h.rx.size() > 4096)
+    h.rx.clear();
+  return true;
+}
+
+/** Serial lines from the device: link markers into marks, the rest echoed; false at end of input. */
+static bool readSerial(int fd, std::string &rx, MarkStats &marks, bool quiet) {
+  char buf[1024];
+  const ssize_t n = read(fd, buf, sizeof(buf));
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+    return false;
+  if (n > 0)
+    rx.append(buf, (size_t)n);
+  const uint64_t t = nowUs();
+  size_t nl;
+  while ((nl = rx.find('\n')) != std::string::npos) {
+    LinkMark m;
+    if (LinkMarks::parse(rx.data(), nl, &m))
+      marks.mark(m, t);
+    else if (!quiet && nl > 0)
+      fprintf(stderr, "dev| %.*s\n", (int)nl, rx.data());
+    rx.erase(0, nl + 1);
+  }
+  if (rx.size() > 4096)
+    rx.clear();
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int port = 8090;
+  double hz = 2;
+  bool sub = true, quiet = false;
+  uint32_t seed = 1;
+  int hostCount = 1;
+  Load load;
+  const char *replayPath = nullptr, *recordPath = nullptr, *serialPath = nullptr;
+  for (int i = 1; i < argc; i++) {
+    const bool more = i + 1 < argc;
+    if (!strcmp(argv[i], "--port") && more) {
+      port = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--hz") && more) {
+      hz = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--no-sub")) {
+      sub = false;
+    } else if (!strcmp(argv[i], "--seed") && more) {
+      seed = (uint32_t)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--hosts") && more) {
+      hostCount = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--quiet")) {
+      quiet = true;
+    } else if (!strcmp(argv[i], "--burst") && more) {
+      load.burst = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--size") && more) {
+      load.size = (size_t)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--replay") && more) {
+      replayPath = argv[++i];
+    } else if (!strcmp(argv[i], "--record") && more) {
+      recordPath = argv[++i];
+    } else if (!strcmp(argv[i], "--bad") && more) {
+      load.badPercent = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--drop-every") && more) {
+      load.dropEveryMs = (uint32_t)(atof(argv[++i]) * 1000);
+    } else if (!strcmp(argv[i], "--serial") && more) {
+      serialPath = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (hz < 1 || hz > 200 || port <= 0 || hostCount < 1 || hostCount > 8 || port + hostCount - 1 > 65535 ||
+      load.burst < 1 || load.burst > 64 || load.size >= NOCT_TCP_LINE_MAX || load.badPercent < 0 ||
+      load.badPercent > 100) {
+    usage(argv[0]);
+    return 2;
+  }
+  static Replay replay;
+  if (replayPath) {
+    if (!replay.load(replayPath)) {
+      fprintf(stderr, "monitor_server: no JSON lines in %s\n", replayPath);
+      return 1;
+    }
+    load.replay = &replay;
+  }
+  if (recordPath && !(load.record = fopen(recordPath, "w"))) {
+    perror(recordPath);
+    return 1;
+  }
+  static MarkStats marks;
+  int serialFd = -1;
+  std::string serialRx;
+  if (serialPath) {
+    if ((serialFd = openSerial(serialPath)) < 0) {
+      perror(serialPath);
+      return 1;
+    }
+    load.marks = &marks;
+  }
+  load.stamp = serialPath || load.size;
+
+  std::vector<Host> hosts;
+  hosts.reserve((size_t)hostCount);
+  for (int i = 0; i < hostCount; i++) {
+    hosts.emplace_back(seed + (uint32_t)i);
+    Host &h = hosts.back();
+    h.port = (uint16_t)(port + i);
+    h.lfd = listenTcp(h.port);
+    if (h.lfd < 0) {
+      perror("listen");
+      return 1;
+    }
+    h.feed.setFullPeriod((uint32_t)(1000.0 / hz + 0.5));
+    h.feed.setSubscriptions(sub && !load.replay);
+  }
+  fprintf(stderr, "monitor_server: tcp port %d", port);
+  if (hostCount > 1)
+    fprintf(stderr, "..%d (%d hosts)", port + hostCount - 1, hostCount);
+  if (load.replay)
+    fprintf(stderr, ", %zu recorded lines at %.1f Hz\n", load.replay->size(), hz);
+  else
+    fprintf(stderr, ", full lines at %.1f Hz, subscriptions %s\n", hz, sub ? "on" : "off");
+  if (load.burst > 1 || load.size || load.badPercent || load.dropEveryMs || serialPath)
+    fprintf(stderr, "load: burst %d, size %zu B, %d%% malformed, disconnect every %u ms%s%s\n", load.burst,
+            load.size, load.badPercent, (unsigned)load.dropEveryMs, serialPath ? ", markers from " : "",
+            serialPath ? serialPath : "");
+  const uint32_t periodMs = (uint32_t)(1000.0 / hz + 0.5);
+  const int pollMs = periodMs < 20 ? 1 : 5;
+
+  const uint32_t t0 = nowMs();
+  uint32_t statStart = t0;
+  static char line[MonitorFeed::kLineMax];
+  std::vector<pollfd> fds;
+
+  for (;;) {
+    /* One device per port: the listener while none is connected, its session while one is. */
+    fds.clear();
+    for (const Host &h : hosts)
+      fds.push_back({h.cfd >= 0 ? h.cfd : h.lfd, POLLIN, 0});
+    if (serialFd >= 0)
+      fds.push_back({serialFd, POLLIN, 0});
+    if (poll(fds.data(), fds.size(), pollMs) < 0 && errno != EINTR) {
+      perror("poll");
+      return 1;
+    }
+    const uint32_t now = nowMs();
+    if (serialFd >= 0 && (fds.back().revents & (POLLIN | POLLHUP)) &&
+        !readSerial(serialFd, serialRx, marks, quiet)) {
+      fprintf(stderr, "monitor_server: %s closed\n", serialPath);
+      close(serialFd);
+      serialFd = -1;
+    }
+    for (size_t i = 0; i < hosts.size(); i++) {
+      Host &h = hosts[i];
+      const short ev = fds[i].revents;
+      if (h.cfd < 0) {
+        if (!(ev & POLLIN) || (h.cfd = accept(h.lfd, nullptr, nullptr)) < 0)
+          continue;
+        int one = 1;
+        setsockopt(h.cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(h.cfd, F_SETFL, fcntl(h.cfd, F_GETFL) | O_NONBLOCK);
+        fprintf(stderr, ":%u client connected\n", h.port);
+        h.feed.reset();
+        h.rx.clear();
+        h.connectedMs = now;
+        h.replayDueMs = now;
+        continue;
+      }
+      if ((ev & (POLLIN | POLLHUP | POLLERR)) && !readCommands(h, quiet)) {
+        dropClient(h);
+        continue;
+      }
+      if (load.dropEveryMs && now - h.connectedMs >= load.dropEveryMs) {
+        fprintf(stderr, ":%u fault: disconnect\n", h.port);
+        dropClient(h);
+        continue;
+      }
+      size_t n = 0;
+      if (load.replay) {
+        /* Fixed cadence like MonitorFeed; after a stall, from now. */
+        if ((int32_t)(now - h.replayDueMs) >= 0) {
+          h.replayDueMs = now - h.replayDueMs < 2 * periodMs ? h.replayDueMs + periodMs : now + periodMs;
+          const std::string &r = load.replay->next();
+          n = snprintf(line, sizeof(line), "%.*s\n", (int)std::min(r.size(), sizeof(line) - 2), r.c_str());
+        }
+      } else {
+        h.pc.advance(now - t0);
+        n = h.feed.poll(now, h.pc.state(), line, sizeof(line));
+      }
+      if (!n)
+        continue;
+      if (load.record && i == 0) {
+        fwrite(line, 1, n, load.record);
+        fflush(load.record);
+      }
+      if (!sendBurst(h, line, n, load))
+        dropClient(h);
+    }
+    if (now - statStart >= 10000) {
+      const double sec = (now - statStart) / 1000.0;
+      for (Host &h : hosts) {
+        if (h.cfd >= 0)
+          fprintf(stderr, "[stats] :%u %.0f B/s, %.1f lines/s (%.1f malformed), screen %d, %s\n", h.port,
+                  h.bytes / sec, h.lines / sec, h.bad / sec, h.feed.screen(),
+                  load.replay ? "replay" : h.feed.subscribed() ? "subscribed" : "full lines");
+        h.bytes = h.lines = h.bad = 0;
+      }
+      if (load.marks)
+        marks.report(stderr, sec);
+      statStart = now;
+    }
+  }
+}
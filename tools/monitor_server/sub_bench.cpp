@@ -0,0 +1,156 @@
+/*
+ * NOCTURNE_OS — subscription benchmark: what each scene costs the device per second with full lines versus
+ * scene-scoped subscriptions. The reference server (MonitorFeed over PcModel) and the firmware's decoder
+ * (MonitorDecoder, MonitorSubscription) and RedrawGate run in one process on simulated time.
+ *
+ * Per scene, one minute each of: full lines at 2 Hz, full lines at 10 Hz (what 10 Hz CPU load costs without
+ * subscriptions) and the scene's subscription (prefetching the next scene). Reports bytes/s and lines/s
+ * on the link, host decode time per second of stream (best of several passes over the recorded lines;
+ * the decoder is single-pass, so device time scales with the bytes), frames RedrawGate lets through per
+ * minute, and whether every field the scene draws ended equal to the PC's value. Then a carousel:
+ * 10 s per scene, twice round.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "MonitorDecoder.h"
+#include "MonitorFeed.h"
+#include "MonitorSubscription.h"
+#include "RedrawGate.h"
+#include "nocturne/config.h"
+
+static const uint32_t kServerTickMs = 5;
+static const uint32_t kGuiTickMs = NOCT_REDRAW_INTERVAL_MS;
+static const char *const kNames[NOCT_TOTAL_SCENES] = {"MAIN", "CPU",  "GPU", "RAM",    "DISKS",
+                                                      "MEDIA", "FANS", "MB",  "WEATHER"};
+
+struct Result {
+  uint64_t bytes = 0;
+  uint32_t lines = 0;
+  double decodeUs = 0; /* per second of stream */
+  uint32_t drawn = 0;  /* per minute */
+  bool consistent = true;
+};
+
+enum Mode { FULL_2HZ, FULL_10HZ, SUBSCRIBED };
+
+static void subscribe(MonitorFeed &feed, int scene, uint16_t gen) {
+  MonitorSubscription sub;
+  sub.forScene(scene, (scene + 1) % NOCT_TOTAL_SCENES);
+  char cmd[MonitorSubscription::kLineMax];
+  const size_t n = sub.format(gen, cmd, sizeof(cmd));
+  feed.command(cmd, n);
+}
+
+/** Decode the recorded lines from a fresh state several times; best pass, in us. */
+static double timeDecode(const std::vector<std::string> &lines) {
+  double best = 1e18;
+  for (int pass = 0; pass < 15; pass++) {
+    MonitorDecoder dec;
+    AppState st;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (const std::string &l : lines)
+      dec.decode(l.data(), l.size() - 1, &st);
+    const auto t1 = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::micro>(t1 - t0).count());
+  }
+  return best;
+}
+
+/** Run scenes[i] for secondsEach seconds in turn. */
+static Result run(Mode mode, const std::vector<int> &scenes, uint32_t secondsEach) {
+  PcModel pc(7);
+  MonitorFeed feed;
+  MonitorDecoder dec;
+  RedrawGate gate;
+  AppState dev;
+  Result r;
+  std::vector<std::string> recorded;
+  char line[MonitorFeed::kLineMax];
+
+  feed.setFullPeriod(mode == FULL_10HZ ? 100 : 500);
+  feed.command("HELO", 4);
+  const uint32_t total = secondsEach * 1000 * (uint32_t)scenes.size();
+  uint16_t gen = 0;
+  int scene = -1;
+  uint32_t nextGui = 0;
+  /* Skip the first minute of the model so every slow field (weather, track) is populated. */
+  const uint32_t t0 = 60000;
+  for (uint32_t t = 0; t < total; t += kServerTickMs) {
+    const int want = scenes[t / (secondsEach * 1000)];
+    if (want != scene) {
+      scene = want;
+      char cmd[16];
+      feed.command(cmd, (size_t)snprintf(cmd, sizeof(cmd), "screen:%d", scene));
+      if (mode == SUBSCRIBED)
+        subscribe(feed, scene, ++gen);
+    }
+    pc.advance(t0 + t);
+    const size_t n = feed.poll(t0 + t, pc.state(), line, sizeof(line));
+    if (n) {
+      r.bytes += n;
+      r.lines++;
+      recorded.emplace_back(line, n);
+      if (dec.decode(line, n - 1, &dev))
+        gate.markChanged(dec.changed());
+    }
+    if (t >= nextGui) {
+      gate.shouldDraw(scene, t / 1000);
+      nextGui += kGuiTickMs;
+    }
+  }
+  /* Let every period elapse with the PC frozen: what the scene draws must now match the PC. */
+  for (uint32_t t = total; t < total + MonitorSubscription::kPeriodMax / 10 + 1000; t += kServerTickMs) {
+    const size_t n = feed.poll(t0 + t, pc.state(), line, sizeof(line));
+    if (n)
+      dec.decode(line, n - 1, &dev);
+  }
+  char a[512], b[512];
+  for (int f = 0; f < SF_COUNT; f++) {
+    if (!(RedrawGate::sceneFields(scene) & fieldBit((StateField)f)))
+      continue;
+    const size_t na = writeField((StateField)f, pc.state(), a, sizeof(a));
+    const size_t nb = writeField((StateField)f, dev, b, sizeof(b));
+    if (na != nb || memcmp(a, b, na) != 0)
+      r.consistent = false;
+  }
+  const double seconds = total / 1000.0;
+  r.decodeUs = timeDecode(recorded) / seconds;
+  r.drawn = (uint32_t)(gate.drawn() * 60.0 / seconds + 0.5);
+  return r;
+}
+
+static void row(const char *label, const char *mode, const Result &r, double seconds) {
+  printf("  %-8s %-10s %8.0f %8.1f %10.1f %8u   %s\n", label, mode, r.bytes / seconds, r.lines / seconds,
+         r.decodeUs, r.drawn, r.consistent ? "yes" : "NO");
+}
+
+int main() {
+  static const char *const kModes[] = {"full 2Hz", "full 10Hz", "sub"};
+  printf("Per scene, 60 s each (server tick %u ms, sensors %u ms, GUI %u ms):\n", kServerTickMs,
+         PcModel::kSampleMs, kGuiTickMs);
+  printf("  %-8s %-10s %8s %8s %10s %8s   %s\n", "scene", "mode", "B/s", "lines/s", "decode us/s", "draws/min",
+         "matches PC");
+  double full2 = 0, full10 = 0, subd = 0;
+  for (int s = 0; s < NOCT_TOTAL_SCENES; s++) {
+    for (int m = 0; m < 3; m++) {
+      const Result r = run((Mode)m, {s}, 60);
+      row(m == 0 ? kNames[s] : "", kModes[m], r, 60);
+      (m == 0 ? full2 : m == 1 ? full10 : subd) += r.bytes / 60.0 / NOCT_TOTAL_SCENES;
+    }
+  }
+  printf("  mean over scenes: full 2Hz %.0f B/s, full 10Hz %.0f B/s, sub %.0f B/s\n\n", full2, full10, subd);
+
+  std::vector<int> carousel;
+  for (int round = 0; round < 2; round++)
+    for (int s = 0; s < NOCT_TOTAL_SCENES; s++)
+      carousel.push_back(s);
+  const double seconds = 10.0 * carousel.size();
+  printf("Carousel, 10 s per scene, twice round (%.0f s):\n", seconds);
+  for (int m = 0; m < 3; m++)
+    row("carousel", kModes[m], run((Mode)m, carousel, 10), seconds);
+  return 0;
+}